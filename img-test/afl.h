@@ -0,0 +1,82 @@
+#ifndef AFL_H
+#define AFL_H
+
+#include <stdio.h>
+#include <unistd.h>
+
+/*
+ * AFL++ persistent mode without afl-cc. The runtime lives in the QOL
+ * libc (qol/musl/src/qnxsupport/afl.c); the references are weak so the
+ * harness links against the QNX SDK libc and, run anywhere else, goes
+ * through the loop once, with the test case read from stdin. afl-fuzz
+ * decides deferred and persistent mode and whether the target is
+ * instrumented by finding these strings in the binary.
+ *
+ * As with afl-cc, __AFL_FUZZ_INIT() goes at file scope and the test
+ * case buffer is taken after __AFL_INIT(), its length in each pass.
+ */
+
+extern int __afl_persistent_loop(unsigned int) __attribute__((weak));
+extern void __afl_manual_init(void) __attribute__((weak));
+extern void __afl_fuzz_init(void) __attribute__((weak));
+extern unsigned char *__afl_fuzz_buf(void) __attribute__((weak));
+extern unsigned int __afl_fuzz_size(void) __attribute__((weak));
+
+static volatile const char *__afl_sig_shm __attribute__((used)) = "__AFL_SHM_ID";
+
+static inline int __afl_loop_once(unsigned int max_cnt)
+{
+    static int done;
+
+    (void)max_cnt;
+    return !done++;
+}
+
+#define AFL_MAX_INPUT (1 << 20)
+
+static inline unsigned char *__afl_fuzz_shm(void)
+{
+    return __afl_fuzz_buf ? __afl_fuzz_buf() : NULL;
+}
+
+static inline unsigned int __afl_fuzz_read_alt(unsigned char *buf)
+{
+    unsigned int len = 0;
+    ssize_t n;
+
+    unsigned char c;
+
+    while (len < AFL_MAX_INPUT && (n = read(0, buf + len, AFL_MAX_INPUT - len)) > 0)
+        len += n;
+    if (len == AFL_MAX_INPUT && read(0, &c, 1) > 0)
+        fprintf(stderr, "input truncated to %u bytes\n", len);
+    return len;
+}
+
+#define __AFL_FUZZ_INIT()                                                                                              \
+    static unsigned char __afl_fuzz_alt[AFL_MAX_INPUT];                                                                \
+    __attribute__((constructor)) static void __afl_fuzz_ctor(void)                                                     \
+    {                                                                                                                  \
+        if (__afl_fuzz_init)                                                                                           \
+            __afl_fuzz_init();                                                                                         \
+    }
+
+#define __AFL_FUZZ_TESTCASE_BUF (__afl_fuzz_shm() ? __afl_fuzz_shm() : __afl_fuzz_alt)
+#define __AFL_FUZZ_TESTCASE_LEN (__afl_fuzz_shm() ? __afl_fuzz_size() : __afl_fuzz_read_alt(__afl_fuzz_alt))
+
+#define __AFL_LOOP(n)                                                                                                  \
+    ({                                                                                                                 \
+        static volatile const char *__afl_sig_persist __attribute__((used)) = "##SIG_AFL_PERSISTENT##";                \
+        static volatile const char *__afl_sig_defer __attribute__((used)) = "##SIG_AFL_DEFER_FORKSRV##";               \
+        __afl_persistent_loop ? __afl_persistent_loop(n) : __afl_loop_once(n);                                         \
+    })
+
+#define __AFL_INIT()                                                                                                   \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        static volatile const char *__afl_sig_defer __attribute__((used)) = "##SIG_AFL_DEFER_FORKSRV##";               \
+        if (__afl_manual_init)                                                                                         \
+            __afl_manual_init();                                                                                       \
+    } while (0)
+
+#endif
@@ -0,0 +1,121 @@
+#!/bin/bash
+#
+# Decode throughput of libimg (decode-bench, from decode_bench.c)
+# under QOL in the rootfs, optionally on QNX in the qemu-demo VM and
+# with each QOL loader option turned on in turn. Each run prints one
+# JSON line: images/sec, p50/p99 latency, img_lib_attach time and peak
+# RSS, with "config" naming the configuration.
+
+print_help() {
+    echo "Usage: $0 [-hqT] [-n passes] [-i image dir] [-o out]"
+    echo "   -h: print this help message"
+    echo "   -n: timed passes over the image set (default: 20)"
+    echo "   -i: image set on the host (default: cases/seeds, or cases)"
+    echo "   -q: also run on QNX in qemu-demo (start it first with"
+    echo "       ../qemu-demo/scripts/start-qemu.sh -enable-kvm -cpu host)"
+    echo "   -T: also run QOL with each loader option in TOGGLES set"
+    echo "   -o: append the JSON lines to this file too"
+}
+
+if [ $(id -u) -ne 0 ]; then
+    echo "Please run as root"
+    exit 1
+fi
+
+DIST=dist
+PASSES=20
+SET=
+OUT=/dev/null
+QEMU=../qemu-demo
+
+# One QOL run each, on top of the defaults. LD_QNX_SNAPSHOT records on
+# the untimed first run and restores on the timed one.
+TOGGLES=(
+    LD_QNX_LAZY=1
+    LD_QNX_NOSYMCACHE=1
+    LD_QNX_HUGEPAGE=1
+    LD_QNX_POPULATE=1
+    LD_QNX_DEFER_CTORS=1
+    LD_QNX_PARALLEL=4
+    LD_QNX_SNAPSHOT=/root/decode-bench.snap
+)
+
+while getopts "hn:i:qTo:" opt; do
+    case $opt in
+    h)
+        print_help
+        exit 0
+        ;;
+    n)
+        PASSES=$OPTARG
+        ;;
+    i)
+        SET=$OPTARG
+        ;;
+    q)
+        QNX=1
+        ;;
+    T)
+        TOGGLE=1
+        ;;
+    o)
+        OUT=$OPTARG
+        ;;
+    \?)
+        print_help
+        exit 1
+        ;;
+    esac
+done
+
+if [ -z "$SET" ]; then
+    SET=cases
+    [ -d cases/seeds ] && SET=cases/seeds
+fi
+if [ ! -x $DIST/opt/qol/bin/decode-bench -o ! -f decode-bench ]; then
+    echo "decode-bench not built; run build.sh first"
+    exit 1
+fi
+
+# The same files in the rootfs and, with -q, on the target; files that
+# are no image are dropped by decode-bench itself.
+rm -rf $DIST/root/bench-set
+mkdir -p $DIST/root/bench-set
+find $SET -maxdepth 1 -type f -exec cp {} $DIST/root/bench-set \;
+./mount-dev.sh mount > /dev/null
+
+# qol <config> [VAR=value]: one run in the rootfs, after an untimed one.
+qol() {
+    local config=$1
+    shift
+    chroot $DIST env "$@" /bin/sh -c \
+        "/opt/qol/bin/decode-bench -n 1 -c warmup /root/bench-set/*" \
+        > /dev/null 2>&1
+    chroot $DIST env "$@" /bin/sh -c \
+        "/opt/qol/bin/decode-bench -n $PASSES -c $config /root/bench-set/*" \
+        2> /dev/null | tee -a $OUT
+}
+
+qol qol
+
+if [ -n "$TOGGLE" ]; then
+    for t in "${TOGGLES[@]}"; do
+        qol "qol+${t%%=*}" $t
+    done
+    rm -f $DIST/root/decode-bench.snap
+fi
+
+if [ -n "$QNX" ]; then
+    if [ ! -f $QEMU/.port ]; then
+        echo "qemu-demo is not running" >&2
+        exit 1
+    fi
+    if ! pgrep -af qemu-system-x86_64 | grep -q -- -enable-kvm; then
+        echo "warning: qemu-demo runs without KVM" >&2
+    fi
+    $QEMU/scripts/connect.sh "rm -rf /tmp/bench-set; mkdir -p /tmp/bench-set"
+    $QEMU/scripts/scp-to.sh decode-bench /tmp/ > /dev/null
+    $QEMU/scripts/scp-to.sh $DIST/root/bench-set/* /tmp/bench-set/ > /dev/null
+    $QEMU/scripts/connect.sh "/tmp/decode-bench -n 1 -c warmup /tmp/bench-set/* > /dev/null 2>&1;" \
+        "/tmp/decode-bench -n $PASSES -c qnx-kvm /tmp/bench-set/* 2> /dev/null" | tee -a $OUT
+fi
@@ -1,5 +1,71 @@
 #!/bin/bash
 #
+print_help() {
+	echo "Usage: $0 [-hbs] [-a arch]"
+	echo "   -h: print this help message"
+	echo "   -a: QNX target, x86_64 (default), aarch64le or armle-v7;"
+	echo "       ../qol/musl has to be built for the same architecture"
+	echo "   -b: also pack fuzz-test, its libraries and the codecs into"
+	echo "       /opt/qol/fuzz-test.qb, a bundle for LD_QNX_BUNDLE"
+	echo "   -s: also link fuzz-test-static, fuzz-test with libimg, its"
+	echo "       libraries and codecs and the QOL libc.a in one static-PIE"
+}
+
+QNX_ARCH=x86_64
+
+while getopts "hbsa:" opt; do
+	case $opt in
+	h)
+		print_help
+		exit 0
+		;;
+	a)
+		QNX_ARCH=$OPTARG
+		;;
+	b)
+		BUNDLE=1
+		;;
+	s)
+		STATIC=1
+		;;
+	\?)
+		print_help
+		exit 1
+		;;
+	esac
+done
+
+# Compiler driver and musl's name for each target.
+case $QNX_ARCH in
+x86_64)
+	QCC=$QCC
+	MUSL_ARCH=x86_64
+	;;
+aarch64le)
+	QCC=ntoaarch64-gcc
+	MUSL_ARCH=aarch64
+	;;
+armle-v7)
+	QCC=ntoarmv7-gcc
+	MUSL_ARCH=arm
+	;;
+*)
+	echo "unknown architecture $QNX_ARCH"
+	exit 1
+	;;
+esac
+
+# qnxstatic.py only links x86_64 objects, mkbundle.py only reads
+# 64-bit ELF files.
+if [ -n "$STATIC" ] && [ "$QNX_ARCH" != x86_64 ]; then
+	echo "-s is only supported on x86_64"
+	exit 1
+fi
+if [ -n "$BUNDLE" ] && [ "$QNX_ARCH" = armle-v7 ]; then
+	echo "-b is not supported on armle-v7"
+	exit 1
+fi
+
 DIST=dist
 
 I_LOCAL_BIN=/opt/qol/bin
@@ -13,22 +79,15 @@ if [ -z "$QNX_TARGET" ]; then
 	exit 1
 fi
 
-patch_qnx_bin() {
-	PROG=$1
-	if file "$PROG" | grep -q "interpreter"; then
-		sudo chmod +x "$PROG"
-		sudo patchelf --set-interpreter ${I_LOCAL_LIB}/libc.so $PROG
-	fi
-	sudo patchelf --replace-needed libc.so.4 ${I_LOCAL_LIB}/libc.so $PROG
-	sudo patchelf --add-rpath ${I_LOCAL_LIB} $PROG
-}
+# Files copied into dist, patched by one qnxpatch run at the end.
+QNX_FILES=()
 
 copy_and_patch() {
 	PROG=$1
 	DEST=$2
 
 	sudo cp "$PROG" "$DEST"
-	patch_qnx_bin ${DEST}/$(basename "$PROG")
+	QNX_FILES+=("${DEST}/$(basename "$PROG")")
 }
 
 copy_bin() {
@@ -45,25 +104,98 @@ sudo mkdir -p $DIST/etc/system/config $LOCAL_BIN $LOCAL_LIB
 sudo cp ../qol/musl/lib/libc.so $LOCAL_LIB
 
 # build test bin  ^^^^^^
-ntox86_64-gcc -g3 -O0 -o fuzz-test test.c -limg
+$QCC -g3 -O0 -o fuzz-test test.c -limg
 copy_bin fuzz-test
 rm fuzz-test
+# decode-bench stays here too, unpatched, for bench.sh -q to run on QNX.
+$QCC -O2 -o decode-bench decode_bench.c -limg
+copy_bin decode-bench
+# diff-decode too, for diff.py to run the same binary on both.
+$QCC -O2 -o diff-decode diff_decode.c -limg
+copy_bin diff-decode
+# snap-repro only runs on QNX, under ../qemu-demo/scripts/snap_repro.py.
+$QCC -g3 -O0 -o snap-repro snap_repro.c -limg
+$QCC -g3 -O0 -o fuzz-driver fuzz_driver.c
+copy_bin fuzz-driver
+rm fuzz-driver
+$QCC -g3 -O0 -shared -fPIC -o libfuzz_img.so fuzz_img_entry.c -limg
+copy_lib libfuzz_img.so
+rm libfuzz_img.so
+for lib in ${QNX_TARGET}/${QNX_ARCH}/lib/dll/img_codec_*.so; do
+	codec=$(basename $lib .so)
+	codec=${codec#img_codec_}
+	$QCC -g3 -O0 -shared -fPIC -DIMG_FUZZ_CODEC="\"$codec\"" \
+		-o libfuzz_img_$codec.so fuzz_img_entry.c -limg
+	copy_lib libfuzz_img_$codec.so
+	rm libfuzz_img_$codec.so
+done
 # build test bin  $$$$$$
 
-copy_lib ${QNX_TARGET}/x86_64/lib/libimg.so.1
-copy_lib ${QNX_TARGET}/x86_64/usr/lib/libtiff.so.5
-copy_lib ${QNX_TARGET}/x86_64/usr/lib/libpng16.so.0
-copy_lib ${QNX_TARGET}/x86_64/lib/libjpeg.so.4
-copy_lib ${QNX_TARGET}/x86_64/usr/lib/libgif.so.5
-copy_lib ${QNX_TARGET}/x86_64/usr/lib/libz.so.2
-copy_lib ${QNX_TARGET}/x86_64/usr/lib/liblzma.so.5
-copy_lib ${QNX_TARGET}/x86_64/lib/libm.so.3
+# The custom mutator is loaded by afl-fuzz, so it is built in the rootfs.
+sudo cp img_mutator.c $DIST/root
+sudo chroot $DIST gcc -O2 -shared -fPIC -o /root/libimg_mutator.so /root/img_mutator.c
+sudo rm $DIST/root/img_mutator.c
+
+copy_lib ${QNX_TARGET}/${QNX_ARCH}/lib/libimg.so.1
+copy_lib ${QNX_TARGET}/${QNX_ARCH}/usr/lib/libtiff.so.5
+copy_lib ${QNX_TARGET}/${QNX_ARCH}/usr/lib/libpng16.so.0
+copy_lib ${QNX_TARGET}/${QNX_ARCH}/lib/libjpeg.so.4
+copy_lib ${QNX_TARGET}/${QNX_ARCH}/usr/lib/libgif.so.5
+copy_lib ${QNX_TARGET}/${QNX_ARCH}/usr/lib/libz.so.2
+copy_lib ${QNX_TARGET}/${QNX_ARCH}/usr/lib/liblzma.so.5
+copy_lib ${QNX_TARGET}/${QNX_ARCH}/lib/libm.so.3
+
+# fuzz-test-static: no interpreter and no DSO, so no dlopen and no
+# symbol lookup at startup; libimg's codec dlopens are served from the
+# table qnxstatic.py links in. This needs the SDP's static archives.
+find_archive() {
+	for dir in lib usr/lib lib/dll; do
+		if [ -f ${QNX_TARGET}/${QNX_ARCH}/$dir/$1.a ]; then
+			echo ${QNX_TARGET}/${QNX_ARCH}/$dir/$1.a
+			return 0
+		fi
+	done
+	echo "$1.a not found in ${QNX_TARGET}/${QNX_ARCH}" >&2
+	return 1
+}
+
+if [ -n "$STATIC" ]; then
+	ARCHIVES=()
+	for lib in libimg libtiff libpng16 libjpeg libgif libz liblzma; do
+		ARCHIVES+=($(find_archive $lib)) || exit 1
+	done
+	PLUGINS=()
+	for lib in ${QNX_TARGET}/${QNX_ARCH}/lib/dll/img_codec_*.so; do
+		codec=$(basename $lib .so)
+		PLUGINS+=(-p $codec.so=$(find_archive $codec)) || exit 1
+	done
+	$QCC -g3 -O0 -fPIE -c -o fuzz-test.o test.c
+	python3 ../qol/qnxstatic.py -m ../qol/musl -o fuzz-test-static \
+		"${PLUGINS[@]}" fuzz-test.o "${ARCHIVES[@]}" || exit 1
+	sudo cp fuzz-test-static $LOCAL_BIN
+	rm fuzz-test.o fuzz-test-static
+fi
 
 sudo cp ${QNX_TARGET}/etc/system/config/img.conf $DIST/etc/system/config
-for lib in ${QNX_TARGET}/x86_64/lib/dll/img_codec_*.so; do
+for lib in ${QNX_TARGET}/${QNX_ARCH}/lib/dll/img_codec_*.so; do
 	copy_lib $lib
 done
 
+# Interpreter, libc.so.4 and rpath for everything in one pass, one
+# worker per core.
+cc -O2 -o ../qol/qnxpatch ../qol/qnxpatch.c
+sudo ../qol/qnxpatch -a $QNX_ARCH -l ${I_LOCAL_LIB}/libc.so -r ${I_LOCAL_LIB} "${QNX_FILES[@]}"
+
+sudo mkdir -p ${DIST}/opt/qol/etc
+sudo python3 ../qol/mkldcache.py --root $DIST \
+	-o ${DIST}/opt/qol/etc/ld-musl-${MUSL_ARCH}.cache ${I_LOCAL_LIB}
+
+if [ -n "$BUNDLE" ]; then
+	sudo python3 ../qol/mkbundle.py --root $DIST -o ${DIST}/opt/qol/fuzz-test.qb \
+		-m ${I_LOCAL_BIN}/fuzz-test -L ${I_LOCAL_LIB} \
+		$(cd $DIST && ls ${I_LOCAL_LIB}/img_codec_*.so)
+fi
+
 sudo cp -r cases $DIST/root
 
 cat <<EOF | sudo tee $DIST/root/env.sh > /dev/null
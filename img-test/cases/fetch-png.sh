@@ -1,4 +0,0 @@
-#!/bin/bash
-wget -O pngsuite.tgz http://www.schaik.com/pngsuite/PngSuite-2017jul19.tgz
-mkdir -p pngsuite
-tar xf pngsuite.tgz -C pngsuite
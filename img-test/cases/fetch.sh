@@ -0,0 +1,67 @@
+#!/bin/bash
+#
+# Fetch seed images into seeds/: every URL in sources.txt, downloaded in
+# parallel, plus the image testcases of the AFL++ checkout in the rootfs.
+# corpus.sh dedupes and minimizes them.
+
+print_help() {
+    echo "Usage: $0 [-h] [-j jobs]"
+    echo "   -h: print this help message"
+    echo "   -j: parallel downloads (default: 8)"
+}
+
+JOBS=8
+
+while getopts "hj:" opt; do
+    case $opt in
+    h)
+        print_help
+        exit 0
+        ;;
+    j)
+        JOBS=$OPTARG
+        ;;
+    \?)
+        print_help
+        exit 1
+        ;;
+    esac
+done
+
+cd $(dirname $0)
+mkdir -p downloads seeds
+
+fetch_one() {
+    url=$1
+    file=downloads/$(basename $url)
+    dir=seeds/$(basename $url | sed 's/\.\(tgz\|tar\.gz\|zip\)$//')
+    if [ ! -s $file ] && ! wget -q -O $file $url; then
+        echo "failed: $url"
+        rm -f $file
+        return
+    fi
+    mkdir -p $dir
+    case $file in
+    *.tgz | *.tar.gz)
+        tar xf $file -C $dir
+        ;;
+    *.zip)
+        unzip -qo $file -d $dir
+        ;;
+    *)
+        cp $file $dir
+        ;;
+    esac
+    echo "fetched: $url"
+}
+export -f fetch_one
+
+grep -v '^\s*\(#\|$\)' sources.txt | xargs -P $JOBS -I{} bash -c 'fetch_one {}'
+
+AFL_CASES=../dist/root/AFLplusplus/testcases/images
+if [ -d $AFL_CASES ]; then
+    mkdir -p seeds/afl
+    cp -r $AFL_CASES/. seeds/afl
+fi
+
+echo "$(find seeds -type f | wc -l) seed files in seeds/"
@@ -0,0 +1,101 @@
+#!/bin/bash
+#
+# Build a compact corpus for the fuzz targets inside the rootfs: the
+# seeds from cases/ (see cases/fetch.sh) deduped by content hash, reduced
+# with afl-cmin to the files that add coverage, then each shrunk with
+# afl-tmin, one per core. The result is /root/corpus/min, the input to
+# use with fuzz.sh -i.
+
+print_help() {
+    echo "Usage: $0 [-h] [-j jobs] [-s seed dir] [-T] [--] [target [args]]"
+    echo "   -h: print this help message"
+    echo "   -j: parallel jobs (default: all cores)"
+    echo "   -s: seed dir, searched recursively (default: cases)"
+    echo "   -T: skip afl-tmin, keep the afl-cmin output as is"
+    echo "   target defaults to fuzz-test; @@ is appended"
+}
+
+if [ $(id -u) -ne 0 ]; then
+    echo "Please run as root"
+    exit 1
+fi
+
+DIST=dist
+JOBS=$(nproc)
+SEEDS=cases
+CORPUS=/root/corpus
+# afl-fuzz does not take inputs over 1 MiB.
+MAX_SIZE=1048576
+
+while getopts "hj:s:T" opt; do
+    case $opt in
+    h)
+        print_help
+        exit 0
+        ;;
+    j)
+        JOBS=$OPTARG
+        ;;
+    s)
+        SEEDS=$OPTARG
+        ;;
+    T)
+        NO_TMIN=1
+        ;;
+    \?)
+        print_help
+        exit 1
+        ;;
+    esac
+done
+
+shift $((OPTIND - 1))
+
+if [ "$1" = "--" ]; then
+    shift
+fi
+
+if [ $# -eq 0 ]; then
+    set -- fuzz-test
+fi
+
+./mount-dev.sh mount
+
+OUT=${DIST}${CORPUS}
+rm -rf $OUT
+mkdir -p $OUT/unique $OUT/min
+
+# One copy per content hash, named by it; scripts and lists are not seeds.
+find $SEEDS -type f -size -$((MAX_SIZE + 1))c \
+    -not -name '*.sh' -not -name '*.txt' -not -name '.gitignore' -print0 |
+    xargs -0 -P $JOBS sha256sum |
+    sort -k1,1 -u |
+    while read hash file; do
+        cp "$file" $OUT/unique/$hash
+    done
+echo "$(ls $OUT/unique | wc -l) unique seeds"
+
+in_rootfs() {
+    chroot ${DIST} env AFL_SKIP_CPUFREQ=1 AFL_NO_AFFINITY=1 \
+        bash -c "source /root/env.sh && $*"
+}
+
+in_rootfs afl-cmin -T $JOBS -i $CORPUS/unique -o $CORPUS/cmin -- "$*" @@ \
+    > $OUT/cmin.log 2>&1 || {
+    echo "afl-cmin failed, see $OUT/cmin.log"
+    exit 1
+}
+echo "$(ls $OUT/cmin | wc -l) seeds after afl-cmin"
+
+if [ -n "$NO_TMIN" ]; then
+    cp $OUT/cmin/* $OUT/min
+else
+    export -f in_rootfs
+    export DIST CORPUS
+    ls $OUT/cmin | xargs -P $JOBS -I{} bash -c \
+        "in_rootfs afl-tmin -i $CORPUS/cmin/{} -o $CORPUS/min/{} -- '$*' @@ \
+            > /dev/null 2>&1 || cp $OUT/cmin/{} $OUT/min/{}"
+fi
+
+echo "$(ls $OUT/min | wc -l) seeds, $(du -sb $OUT/min | cut -f1) bytes" \
+    "(from $(du -sbc $OUT/unique/* | tail -1 | cut -f1)) in $CORPUS/min"
@@ -0,0 +1,121 @@
+#include <img/img.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+/*
+ * Decode throughput of libimg: every file given is decoded with
+ * img_load_file, once untimed to warm the caches and the codecs, then
+ * for -n timed passes. Prints one JSON object with images/sec over the
+ * timed passes, p50 and p99 per-image latency, the time img_lib_attach
+ * took and the peak RSS as getrusage reports it. The same binary runs
+ * under QOL and on QNX, so that the two can be compared.
+ */
+
+static double now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Decode one file; its time in us, or -1 if it failed. */
+static double decode(img_lib_t ilib, const char *path)
+{
+    img_t img;
+    double t = now_us();
+    int rc;
+
+    memset(&img, 0, sizeof img);
+    if ((rc = img_load_file(ilib, path, NULL, &img)) != IMG_ERR_OK)
+    {
+        fprintf(stderr, "%s: img_load_file() failed: %d\n", path, rc);
+        return -1;
+    }
+    t = now_us() - t;
+    if (img.flags & IMG_DIRECT)
+        free(img.access.direct.data);
+    return t;
+}
+
+int main(int argc, char **argv)
+{
+    const char *config = "default";
+    img_lib_t ilib = NULL;
+    struct rusage ru;
+    double *lat, t, total = 0, attach;
+    int passes = 20, n = 0, i, p, c, rc;
+
+    while ((c = getopt(argc, argv, "n:c:")) != -1)
+    {
+        switch (c)
+        {
+        case 'n':
+            passes = atoi(optarg);
+            break;
+        case 'c':
+            config = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n passes] [-c config] image...\n", argv[0]);
+            return -1;
+        }
+    }
+    argv += optind;
+    argc -= optind;
+    if (argc < 1 || passes < 1)
+    {
+        fprintf(stderr, "Usage: decode-bench [-n passes] [-c config] image...\n");
+        return -1;
+    }
+
+    attach = now_us();
+    if ((rc = img_lib_attach(&ilib)) != IMG_ERR_OK)
+    {
+        fprintf(stderr, "img_lib_attach() failed: %d\n", rc);
+        return -1;
+    }
+    attach = now_us() - attach;
+
+    /* Files that do not decode are left out of the set. */
+    for (i = 0; i < argc; i++)
+        if (decode(ilib, argv[i]) >= 0)
+            argv[n++] = argv[i];
+    if (!n || !(lat = malloc(sizeof *lat * n * passes)))
+    {
+        fprintf(stderr, "no image could be decoded\n");
+        return -1;
+    }
+
+    for (p = 0; p < passes; p++)
+        for (i = 0; i < n; i++)
+        {
+            if ((t = decode(ilib, argv[i])) < 0)
+                return -1;
+            lat[p * n + i] = t;
+            total += t;
+        }
+    qsort(lat, n * passes, sizeof *lat, cmp_double);
+    getrusage(RUSAGE_SELF, &ru);
+
+    printf("{\"config\": \"%s\", \"images\": %d, \"decodes\": %d, "
+           "\"images_per_sec\": %.1f, \"p50_us\": %.1f, \"p99_us\": %.1f, "
+           "\"attach_ms\": %.3f, \"maxrss_kb\": %ld}\n",
+           config, n, n * passes, n * passes / (total / 1e6),
+           lat[n * passes / 2], lat[(n * passes - 1) * 99 / 100],
+           attach / 1e3, (long)ru.ru_maxrss);
+
+    img_lib_detach(ilib);
+    return 0;
+}
@@ -0,0 +1,195 @@
+#!/usr/bin/env python3
+"""Decode a corpus under QOL and on QNX and report where they differ.
+
+Usage: diff.py [-i DIR] [-r ROOT] [-j JOBS] [-c CHUNK] [-o REPORT]
+
+Every file of the corpus (-i, default cases/seeds, or cases) is decoded
+by diff-decode (diff_decode.c, built by build.sh) twice: under QOL in
+the rootfs (ROOT, default dist), JOBS processes at a time, and on QNX
+by the unpatched copy left in this directory, on the VMs of
+../qemu-demo/scripts/pool.py (or the single qemu-demo VM when no pool
+is up), CHUNK files per run. An input differs when the return of
+img_load_file, errno or the image (size, format and pixel hash) is not
+the same on both.
+
+Each differing input is then decoded again alone under QOL with
+LD_QNX_SHIMSTATS, and the shims it called are counted: shims are
+listed by how many differing inputs went through them, the first
+suspects for a fast path that changed behavior. -o writes the inputs,
+both results and their shims as JSON. Run as root.
+"""
+
+import argparse
+import json
+import os
+import queue
+import shutil
+import subprocess
+import sys
+import threading
+from concurrent.futures import ThreadPoolExecutor
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEMO = os.path.join(HERE, "..", "qemu-demo")
+sys.path.insert(0, os.path.join(DEMO, "scripts"))
+sys.path.insert(0, os.path.join(HERE, "..", "qol"))
+
+import pool  # noqa: E402
+import shimstats  # noqa: E402
+
+SET = "/root/diff-set"
+KEYS = ("rc", "errno", "w", "h", "format", "hash")
+
+
+def parse(out):
+    res = {}
+    for line in out.splitlines():
+        try:
+            r = json.loads(line)
+        except ValueError:
+            continue
+        res[os.path.basename(r["file"])] = r
+    return res
+
+
+def qol(root, names, env=None):
+    cmd = ["chroot", root, "env", *(env or []), "bash", "-c",
+           "source /root/env.sh && exec diff-decode " +
+           " ".join(f"{SET}/{n}" for n in names) + " 2>/dev/null"]
+    return parse(subprocess.run(cmd, capture_output=True, text=True).stdout)
+
+
+def chunks(names, n):
+    return [names[i:i + n] for i in range(0, len(names), n)]
+
+
+def guest(port, cmd):
+    env = dict(os.environ, PORT=port)
+    r = subprocess.run([os.path.join(DEMO, "scripts", "connect.sh"), cmd], env=env,
+                       capture_output=True, text=True)
+    return r.returncode, r.stdout
+
+
+def qnx(corpus, names, size):
+    """Results on QNX, the chunks spread over the VMs."""
+    vms = [pool.read(vm, "port") for vm in pool.instances() if pool.alive(vm)]
+    if not vms and os.path.isfile(os.path.join(DEMO, ".port")):
+        with open(os.path.join(DEMO, ".port")) as f:
+            vms = [f.read().strip()]
+    if not vms:
+        sys.exit("no QNX VM is up: run pool.py up or start-qemu.sh")
+    jobs = queue.Queue()
+    for c in chunks(names, size):
+        jobs.put(c)
+    res, lock = {}, threading.Lock()
+
+    def worker(port):
+        env = dict(os.environ, PORT=port)
+        if guest(port, "rm -rf /tmp/diff-set; mkdir -p /tmp/diff-set")[0] or subprocess.run(
+                [os.path.join(DEMO, "scripts", "scp-to.sh"), os.path.join(HERE, "diff-decode"),
+                 "/tmp/"], env=env, capture_output=True).returncode:
+            print(f"vm on port {port}: setup failed", file=sys.stderr)
+            return
+        while True:
+            try:
+                c = jobs.get_nowait()
+            except queue.Empty:
+                return
+            paths = [os.path.join(corpus, n) for n in c]
+            if subprocess.run([os.path.join(DEMO, "scripts", "scp-to.sh"), *paths,
+                               "/tmp/diff-set/"], env=env, capture_output=True).returncode:
+                jobs.put(c)
+                print(f"vm on port {port}: lost", file=sys.stderr)
+                return
+            _, out = guest(port, "/tmp/diff-decode " + " ".join(f"/tmp/diff-set/{n}" for n in c)
+                           + " 2>/dev/null; rm -f " + " ".join(f"/tmp/diff-set/{n}" for n in c))
+            with lock:
+                res.update(parse(out))
+
+    threads = [threading.Thread(target=worker, args=(p,)) for p in vms]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    return res
+
+
+def shims_of(root, name):
+    """The shims one QOL decode of name called."""
+    r = qol(root, [name], ["LD_QNX_SHIMSTATS=1"]).get(name)
+    if not r:
+        return []
+    for path in (f"/dev/shm/qnx-shimstats.{r['pid']}",
+                 os.path.join(root, f"dev/shm/qnx-shimstats.{r['pid']}")):
+        if os.path.exists(path):
+            st = shimstats.open_stats(path)
+            os.unlink(path)
+            if st:
+                return [st["names"][i] for i, t in enumerate(shimstats.totals(st)) if t[0]]
+    return []
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Diff libimg decodes between QOL and QNX.")
+    parser.add_argument("-i", dest="corpus", help="input dir (default cases/seeds, or cases)")
+    parser.add_argument("-r", dest="root", default="dist", help="rootfs (default dist)")
+    parser.add_argument("-j", dest="jobs", type=int, default=os.cpu_count(),
+                        help="QOL processes at a time (default: one per core)")
+    parser.add_argument("-c", dest="chunk", type=int, default=64,
+                        help="files per diff-decode run (default 64)")
+    parser.add_argument("-o", dest="report", help="write the differing inputs as JSON")
+    args = parser.parse_args()
+    if os.getuid() != 0:
+        sys.exit("Please run as root")
+    corpus = args.corpus or next(d for d in ("cases/seeds", "cases") if os.path.isdir(d))
+    names = sorted(n for n in os.listdir(corpus) if os.path.isfile(os.path.join(corpus, n)))
+    if not names:
+        sys.exit(f"{corpus}: no inputs")
+
+    dest = os.path.join(args.root, SET.lstrip("/"))
+    shutil.rmtree(dest, ignore_errors=True)
+    os.makedirs(dest)
+    for n in names:
+        shutil.copy(os.path.join(corpus, n), dest)
+
+    with ThreadPoolExecutor(args.jobs) as ex:
+        qol_res = {}
+        for r in ex.map(lambda c: qol(args.root, c), chunks(names, args.chunk)):
+            qol_res.update(r)
+    qnx_res = qnx(corpus, names, args.chunk)
+
+    diffs, missing = [], []
+    for n in names:
+        a, b = qol_res.get(n), qnx_res.get(n)
+        if not a or not b:
+            # A crash on one side leaves no line for the file.
+            missing.append(n)
+        elif any(a[k] != b[k] for k in KEYS):
+            diffs.append({"input": n, "qol": {k: a[k] for k in KEYS},
+                          "qnx": {k: b[k] for k in KEYS}})
+
+    by_shim = {}
+    for d in diffs:
+        d["shims"] = shims_of(args.root, d["input"])
+        for s in d["shims"]:
+            by_shim[s] = by_shim.get(s, 0) + 1
+        q, x = d["qol"], d["qnx"]
+        print(f"{d['input']}: qol rc={q['rc']} errno={q['errno']} {q['w']}x{q['h']} {q['hash']} | "
+              f"qnx rc={x['rc']} errno={x['errno']} {x['w']}x{x['h']} {x['hash']}")
+    for n in missing:
+        print(f"{n}: no result on {'QOL' if n not in qol_res else 'QNX'}")
+    if by_shim:
+        print("differing inputs per shim:")
+        for s, c in sorted(by_shim.items(), key=lambda x: (-x[1], x[0])):
+            print(f"{c:8d}  {s}")
+    print(f"[x] {len(names)} inputs, {len(diffs)} differ, {len(missing)} without a result")
+
+    if args.report:
+        with open(args.report, "w") as f:
+            json.dump({"diffs": diffs, "missing": missing, "shims": by_shim}, f, indent=1)
+    shutil.rmtree(dest, ignore_errors=True)
+    return 1 if diffs or missing else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
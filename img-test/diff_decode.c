@@ -0,0 +1,66 @@
+#include <img/img.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * The outcome of decoding each file given, for diff.py to compare
+ * between QOL and QNX: one JSON object per file with img_load_file's
+ * return, errno after it, the size and format of the image and an
+ * FNV-1a hash of its pixel rows (without the stride padding). pid is
+ * the process, for finding its LD_QNX_SHIMSTATS file.
+ */
+
+static uint64_t fnv1a(uint64_t h, const uint8_t *p, size_t n)
+{
+    while (n--)
+        h = (h ^ *p++) * 0x100000001b3ULL;
+    return h;
+}
+
+int main(int argc, char **argv)
+{
+    img_lib_t ilib = NULL;
+    img_t img;
+    uint64_t h;
+    unsigned y;
+    int i, rc, err;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s image...\n", argv[0]);
+        return -1;
+    }
+    if ((rc = img_lib_attach(&ilib)) != IMG_ERR_OK)
+    {
+        fprintf(stderr, "img_lib_attach() failed: %d\n", rc);
+        return -1;
+    }
+
+    for (i = 1; i < argc; i++)
+    {
+        memset(&img, 0, sizeof img);
+        errno = 0;
+        rc = img_load_file(ilib, argv[i], NULL, &img);
+        err = errno;
+        h = 0xcbf29ce484222325ULL;
+        if (rc == IMG_ERR_OK && img.flags & IMG_DIRECT)
+        {
+            for (y = 0; y < img.h; y++)
+                h = fnv1a(h, img.access.direct.data + (size_t)y * img.access.direct.stride,
+                          IMG_FMT_BPL(img.format, img.w));
+            free(img.access.direct.data);
+        }
+        printf("{\"file\": \"%s\", \"pid\": %d, \"rc\": %d, \"errno\": %d, \"w\": %u, \"h\": %u, "
+               "\"format\": %u, \"hash\": \"%016llx\"}\n",
+               argv[i], (int)getpid(), rc, err, rc == IMG_ERR_OK ? (unsigned)img.w : 0,
+               rc == IMG_ERR_OK ? (unsigned)img.h : 0, rc == IMG_ERR_OK ? (unsigned)img.format : 0,
+               (unsigned long long)h);
+    }
+
+    img_lib_detach(ilib);
+    return 0;
+}
@@ -0,0 +1,130 @@
+#!/bin/bash
+#
+# Run one AFL++ instance per core on a target inside the rootfs: a main
+# (-M) and secondaries (-S), each bound to its own CPU, syncing through
+# one output dir on tmpfs. Prints aggregated execs/sec until stopped.
+
+print_help() {
+    echo "Usage: $0 [-hmO] [-j jobs] [-c first cpu] [-i input dir] [-x dict] [-N node] [--] [target [args]]"
+    echo "   -h: print this help message"
+    echo "   -j: number of instances (default: all cores)"
+    echo "   -c: CPU the first instance is bound to (default: 0)"
+    echo "   -i: input corpus inside the rootfs (default: /root/cases)"
+    echo "   -x: AFL dictionary inside the rootfs (mkdict.py writes /root/img.dict)"
+    echo "   -N: name the instances after this node, for sync.py across hosts"
+    echo "   -O: run each instance in its own image.sh overlay root"
+    echo "   -m: also mutate with the PNG/GIF/SGI mutator (libimg_mutator.so)"
+    echo "   target defaults to fuzz-test"
+}
+
+if [ $(id -u) -ne 0 ]; then
+    echo "Please run as root"
+    exit 1
+fi
+
+DIST=dist
+JOBS=$(nproc)
+FIRST_CPU=0
+INPUT=/root/cases
+OUTPUT=/root/out
+
+while getopts "hj:c:i:x:N:mO" opt; do
+    case $opt in
+    h)
+        print_help
+        exit 0
+        ;;
+    j)
+        JOBS=$OPTARG
+        ;;
+    c)
+        FIRST_CPU=$OPTARG
+        ;;
+    i)
+        INPUT=$OPTARG
+        ;;
+    x)
+        DICT="-x $OPTARG"
+        ;;
+    N)
+        NODE=$OPTARG-
+        ;;
+    O)
+        OVERLAY=1
+        ;;
+    m)
+        MUTATOR=AFL_CUSTOM_MUTATOR_LIBRARY=/root/libimg_mutator.so
+        ;;
+    \?)
+        print_help
+        exit 1
+        ;;
+    esac
+done
+
+shift $((OPTIND - 1))
+
+if [ "$1" = "--" ]; then
+    shift
+fi
+
+if [ $# -eq 0 ]; then
+    set -- fuzz-test
+fi
+
+# Queue and bitmap churn stays in memory, and so do the scratch files
+# of the target: an overlay root writes to a tmpfs (see image.sh), and
+# dist gets one on /tmp.
+if [ -n "$OVERLAY" ]; then
+    OUT_DIR=images/out
+else
+    OUT_DIR=${DIST}${OUTPUT}
+    ./mount-dev.sh mount
+    mountpoint -q ${DIST}/tmp || mount -t tmpfs -o size=1g tmpfs ${DIST}/tmp
+fi
+mkdir -p $OUT_DIR
+if ! mountpoint -q $OUT_DIR; then
+    mount -t tmpfs -o size=4g tmpfs $OUT_DIR
+fi
+
+# Every instance root sees the one output dir, for syncing.
+root_of() {
+    if [ -n "$OVERLAY" ]; then
+        echo images/inst/$1/root
+    else
+        echo ${DIST}
+    fi
+}
+if [ -n "$OVERLAY" ]; then
+    ./image.sh up $JOBS || exit 1
+    for ((i = 0; i < JOBS; i++)); do
+        mkdir -p $(root_of $i)${OUTPUT}
+        mountpoint -q $(root_of $i)${OUTPUT} ||
+            mount --bind $OUT_DIR $(root_of $i)${OUTPUT}
+    done
+fi
+
+PIDS=()
+trap 'kill ${PIDS[@]} 2>/dev/null; wait' EXIT
+
+for ((i = 0; i < JOBS; i++)); do
+    if [ $i -eq 0 ]; then
+        ROLE="-M ${NODE}main"
+    else
+        ROLE="-S ${NODE}sec$i"
+    fi
+    chroot $(root_of $i) env AFL_NO_UI=1 AFL_SKIP_CPUFREQ=1 $MUTATOR \
+        bash -c "source /root/env.sh && exec afl-fuzz -b $((FIRST_CPU + i)) \
+            -i $INPUT -o $OUTPUT $DICT $ROLE -- $*" \
+        > $OUT_DIR/instance$i.log 2>&1 &
+    PIDS+=($!)
+done
+
+while sleep 10; do
+    cat $OUT_DIR/*/fuzzer_stats 2>/dev/null | awk -F: -v n=$JOBS '
+        /^execs_per_sec/ { eps += $2; up++ }
+        /^execs_done/ { done += $2 }
+        /^saved_crashes/ { crashes += $2 }
+        END { printf "%d/%d up, %.0f execs/sec, %d execs, %d crashes\n",
+                     up, n, eps, done, crashes }'
+done
@@ -0,0 +1,80 @@
+#include <dlfcn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "afl.h"
+
+/*
+ * Generic runner for libFuzzer-style targets built as QNX shared
+ * objects and loaded through the QOL ldso. With input files it runs
+ * each of them once; without, it takes inputs from afl-fuzz in
+ * persistent mode (or one from stdin).
+ */
+
+#define PERSIST_COUNT 10000
+
+typedef int (*init_fn)(int *, char ***);
+typedef int (*test_fn)(const uint8_t *, size_t);
+
+__AFL_FUZZ_INIT();
+
+static int run_file(test_fn test, const char *path)
+{
+    static unsigned char buf[AFL_MAX_INPUT];
+    size_t len;
+    FILE *f;
+
+    if ((f = fopen(path, "rb")) == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    len = fread(buf, 1, sizeof buf, f);
+    if (len == sizeof buf && fgetc(f) != EOF)
+        fprintf(stderr, "%s: truncated to %zu bytes\n", path, len);
+    fclose(f);
+    test(buf, len);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    void *target;
+    init_fn init;
+    test_fn test;
+    unsigned char *buf;
+    int i, rc = 0;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <target.so> [input file...]\n", argv[0]);
+        return -1;
+    }
+
+    if ((target = dlopen(argv[1], RTLD_NOW)) == NULL)
+    {
+        fprintf(stderr, "dlopen(%s) failed: %s\n", argv[1], dlerror());
+        return -1;
+    }
+    if ((test = (test_fn)dlsym(target, "LLVMFuzzerTestOneInput")) == NULL)
+    {
+        fprintf(stderr, "%s has no LLVMFuzzerTestOneInput\n", argv[1]);
+        return -1;
+    }
+    if ((init = (init_fn)dlsym(target, "LLVMFuzzerInitialize")) != NULL)
+        init(&argc, &argv);
+
+    if (argc > 2)
+    {
+        for (i = 2; i < argc; i++)
+            rc |= run_file(test, argv[i]);
+        return rc;
+    }
+
+    __AFL_INIT();
+    buf = __AFL_FUZZ_TESTCASE_BUF;
+    while (__AFL_LOOP(PERSIST_COUNT))
+        test(buf, __AFL_FUZZ_TESTCASE_LEN);
+    return 0;
+}
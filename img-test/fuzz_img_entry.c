@@ -0,0 +1,105 @@
+#include <img/img.h>
+#include <io/io.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * libFuzzer-style entry points for libimg. Any engine or runner that
+ * calls LLVMFuzzerInitialize once and LLVMFuzzerTestOneInput per input
+ * can drive it: fuzz-driver loads it as a shared object, see
+ * fuzz_driver.c.
+ *
+ * A target for one codec (built with -DIMG_FUZZ_CODEC='"png"', or any
+ * target run with IMG_FUZZ_CODEC=png) attaches that img_codec_<name>.so
+ * alone, through a one-entry config, and decodes every input with it
+ * directly, skipping the per-input probe of each codec's magic.
+ */
+
+static img_lib_t ilib;
+static img_codec_t codec;
+static int single;
+
+static const char *codec_name(void)
+{
+    const char *name = getenv("IMG_FUZZ_CODEC");
+
+#ifdef IMG_FUZZ_CODEC
+    if (name == NULL || *name == '\0')
+        name = IMG_FUZZ_CODEC;
+#endif
+    return name != NULL && *name != '\0' ? name : NULL;
+}
+
+/* LIBIMG_CFGFILE is read by img_lib_attach in place of img.conf. */
+static void single_codec_config(const char *name)
+{
+    char path[64];
+    FILE *f;
+
+    snprintf(path, sizeof path, "/tmp/img-fuzz-%s.conf", name);
+    if ((f = fopen(path, "w")) == NULL)
+        abort();
+    fprintf(f, "[img_codec_%s.so]\next=%s\n", name, name);
+    fclose(f);
+    setenv("LIBIMG_CFGFILE", path, 1);
+}
+
+/* Attaching reads the config and loads the codecs, once per process. */
+int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+    const char *name = codec_name();
+
+    (void)argc;
+    (void)argv;
+
+    if (ilib != NULL)
+        return 0;
+    if (name != NULL)
+        single_codec_config(name);
+    if (img_lib_attach(&ilib) != IMG_ERR_OK)
+        abort();
+    if (name != NULL)
+    {
+        if (img_codec_list_byext(ilib, name, &codec, 1) != 1)
+        {
+            fprintf(stderr, "no codec for %s\n", name);
+            abort();
+        }
+        single = 1;
+    }
+    return 0;
+}
+
+static int decode_single(io_stream_t *input, img_t *img)
+{
+    uintptr_t decode_data;
+    int rc;
+
+    if ((rc = img_decode_begin(codec, input, &decode_data)) != IMG_ERR_OK)
+        return rc;
+    rc = img_decode_frame(ilib, codec, input, NULL, img, &decode_data);
+    img_decode_finish(codec, input, &decode_data);
+    return rc;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    io_stream_t *input;
+    img_t img;
+    int rc;
+
+    if (ilib == NULL)
+        LLVMFuzzerInitialize(NULL, NULL);
+
+    if ((input = io_open(IO_MEM, IO_READ, size, data)) == NULL)
+        return 0;
+    memset(&img, 0, sizeof img);
+    rc = single ? decode_single(input, &img) : img_load(ilib, input, NULL, &img);
+    if (rc == IMG_ERR_OK && (img.flags & IMG_DIRECT))
+        free(img.access.direct.data);
+    io_close(input);
+    return 0;
+}
@@ -0,0 +1,164 @@
+#!/bin/bash
+#
+# Pack the rootfs into read-only squashfs images, a base system
+# (debootstrap, AFL++), a QNX layer (harnesses, cases) and a store of
+# the patched libraries, and give each fuzz instance its own overlayfs
+# root on top of them. Instances share the images and only write to
+# their own upper dir, which is on a tmpfs of its own, so that queue
+# files, scratch files and logs never reach the disk.
+#
+# The store holds each distinct library once, under its sha256, with
+# the library names as symlinks to it, and is itself named by the hash
+# of that list. A rebuild that leaves the libraries alone gives the
+# same store image, which instances of old and new builds mount once
+# between them, so every instance maps the same library inodes and
+# their text is in the page cache once however many run.
+
+print_help() {
+    echo "Usage: $0 [-h] build | up <n> | down"
+    echo "   -h: print this help message"
+    echo "   build: pack dist into images/base.sqfs, images/qnx.sqfs and"
+    echo "          the library store images/lib-<hash>.sqfs"
+    echo "   up: mount n instance roots at images/inst/<i>/root"
+    echo "   down: unmount every instance and the images"
+}
+
+if [ $(id -u) -ne 0 ]; then
+    echo "Please run as root"
+    exit 1
+fi
+
+DIST=dist
+IMAGES=images
+# What build.sh installs; everything else in dist is the base system.
+QNX_PATHS="opt/qol etc/system root/cases root/env.sh root/libimg_mutator.so"
+# Bind-mounted from the store over the QNX layer's copy.
+LIB_PATH=opt/qol/lib
+# A cap, not a reservation: tmpfs takes memory as it is written.
+INST_SIZE=1g
+
+while getopts "h" opt; do
+    case $opt in
+    h)
+        print_help
+        exit 0
+        ;;
+    \?)
+        print_help
+        exit 1
+        ;;
+    esac
+done
+
+shift $((OPTIND - 1))
+
+# Same inputs give the same images: fixed times, owners and order.
+SQUASH_OPTS="-noappend -all-root -mkfs-time 0 -all-time 0 -comp zstd -quiet"
+
+# The patched libraries as a content-addressed tree in $1:
+# .objects/<sha256> and one symlink per name.
+store() {
+    local dir=$1 f name sum
+
+    mkdir -p $dir/.objects
+    for f in $DIST/$LIB_PATH/*; do
+        name=$(basename $f)
+        if [ -L $f ]; then
+            cp -P $f $dir/$name
+            continue
+        fi
+        [ -f $f ] || continue
+        sum=$(sha256sum $f | cut -d' ' -f1)
+        [ -e $dir/.objects/$sum ] || cp $f $dir/.objects/$sum
+        ln -s .objects/$sum $dir/$name
+    done
+}
+
+build() {
+    local excludes=(proc sys dev root/out root/corpus root/triage $QNX_PATHS)
+    local qnx=$(mktemp -d) lib=$(mktemp -d) hash
+
+    mkdir -p $IMAGES
+    mksquashfs $DIST $IMAGES/base.sqfs $SQUASH_OPTS -wildcards \
+        -e "${excludes[@]}" || exit 1
+    for path in $QNX_PATHS; do
+        if [ -e $DIST/$path ]; then
+            mkdir -p $qnx/$(dirname $path)
+            cp -a $DIST/$path $qnx/$path
+        fi
+    done
+    rm -rf $qnx/$LIB_PATH
+    mkdir -p $qnx/$LIB_PATH
+    mksquashfs $qnx $IMAGES/qnx.sqfs $SQUASH_OPTS || exit 1
+    rm -rf $qnx
+
+    store $lib
+    hash=$(cd $lib && find . \( -type l -o -type f \) -printf '%p %l\n' |
+        sort | sha256sum | cut -c1-16)
+    if [ ! -e $IMAGES/lib-$hash.sqfs ]; then
+        mksquashfs $lib $IMAGES/lib-$hash.sqfs $SQUASH_OPTS || exit 1
+    fi
+    rm -rf $lib
+    ln -sfn lib-$hash.sqfs $IMAGES/lib.sqfs
+    ls -l $IMAGES/*.sqfs
+}
+
+up() {
+    local n=$1 i root opts lib
+
+    if [ ! -L $IMAGES/lib.sqfs ]; then
+        echo "no library store in $IMAGES, run $0 build"
+        exit 1
+    fi
+    mount_images
+    lib=$IMAGES/mnt/$(readlink $IMAGES/lib.sqfs | sed 's/\.sqfs$//')
+    for ((i = 0; i < n; i++)); do
+        root=$IMAGES/inst/$i/root
+        mkdir -p $IMAGES/inst/$i
+        mountpoint -q $IMAGES/inst/$i ||
+            mount -t tmpfs -o size=$INST_SIZE tmpfs $IMAGES/inst/$i || exit 1
+        mkdir -p $IMAGES/inst/$i/upper $IMAGES/inst/$i/work $root
+        mountpoint -q $root && continue
+        opts=lowerdir=$IMAGES/mnt/qnx:$IMAGES/mnt/base
+        opts+=,upperdir=$IMAGES/inst/$i/upper,workdir=$IMAGES/inst/$i/work
+        mount -t overlay overlay -o $opts $root || exit 1
+        mount --bind $lib $root/$LIB_PATH || exit 1
+        mkdir -p $root/proc $root/dev
+        DIST=$root ./mount-dev.sh mount > /dev/null
+    done
+    echo "$n instance roots in $IMAGES/inst"
+}
+
+down() {
+    local root
+
+    for root in $IMAGES/inst/*/root; do
+        if mountpoint -q $root; then
+            umount $root/root/out 2> /dev/null
+            DIST=$root ./mount-dev.sh umount > /dev/null
+            umount $root/$LIB_PATH
+            umount $root
+        fi
+        mountpoint -q ${root%/root} && umount ${root%/root}
+    done
+    rm -rf $IMAGES/inst
+    for image in $IMAGES/mnt/*; do
+        mountpoint -q $image && umount $image
+    done
+}
+
+case "$1" in
+build)
+    build
+    ;;
+up)
+    up ${2:-$(nproc)}
+    ;;
+down)
+    down
+    ;;
+*)
+    print_help
+    exit 1
+    ;;
+esac
@@ -0,0 +1,614 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * AFL++ custom mutator (AFL_CUSTOM_MUTATOR_LIBRARY) for the formats
+ * whose codecs reject most byte-level mutations before decoding: PNG
+ * (chunk CRCs), GIF (sub-block lengths) and SGI (RLE offset and length
+ * tables). Each input is parsed, one structural or field mutation is
+ * applied, and the file is written back out consistent again, so the
+ * codec gets past its checks. Other inputs get plain byte mutations.
+ * afl_custom_post_process also fixes the chunk CRCs of PNGs after
+ * afl-fuzz's own mutations.
+ *
+ * Built for Linux (afl-fuzz runs there), not for QNX.
+ */
+
+#define MAX_PARTS 1024
+
+struct part
+{
+    const uint8_t *data;
+    size_t len;
+    uint8_t type[4]; /* PNG chunk type */
+    int mutate;
+};
+
+struct state
+{
+    uint64_t rnd;
+    uint8_t *out;
+    size_t out_size;
+    struct part parts[MAX_PARTS];
+    size_t nparts;
+};
+
+static uint32_t rnd(struct state *st, uint32_t n)
+{
+    st->rnd ^= st->rnd << 13;
+    st->rnd ^= st->rnd >> 7;
+    st->rnd ^= st->rnd << 17;
+    return n ? (uint32_t)(st->rnd >> 32) % n : 0;
+}
+
+static uint32_t get_be32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static uint16_t get_be16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static void put_be16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static uint32_t crc32(const uint8_t *p, size_t n)
+{
+    static uint32_t table[256];
+    uint32_t c = 0xffffffff;
+    size_t i;
+    int k;
+
+    if (!table[1])
+    {
+        for (i = 0; i < 256; i++)
+        {
+            c = (uint32_t)i;
+            for (k = 0; k < 8; k++)
+                c = c & 1 ? 0xedb88320 ^ c >> 1 : c >> 1;
+            table[i] = c;
+        }
+        c = 0xffffffff;
+    }
+    for (i = 0; i < n; i++)
+        c = table[(c ^ p[i]) & 0xff] ^ c >> 8;
+    return c ^ 0xffffffff;
+}
+
+static const uint32_t interesting[] = {0, 1, 2, 3, 4, 7, 8, 15, 16, 31, 32, 63, 64, 127, 128, 255, 256,
+                                       1023, 1024, 4096, 32767, 32768, 65535, 65536, 0x7fffffff, 0x80000000,
+                                       0xffffffff};
+
+static uint32_t pick_interesting(struct state *st)
+{
+    return interesting[rnd(st, sizeof interesting / sizeof *interesting)];
+}
+
+/* A few havoc-style changes inside p[0..n). */
+static void mutate_bytes(struct state *st, uint8_t *p, size_t n)
+{
+    int i, count = 1 + rnd(st, 4);
+    size_t at;
+
+    if (!n)
+        return;
+    for (i = 0; i < count; i++)
+    {
+        at = rnd(st, (uint32_t)n);
+        switch (rnd(st, 5))
+        {
+        case 0:
+            p[at] ^= 1 << rnd(st, 8);
+            break;
+        case 1:
+            p[at] = (uint8_t)pick_interesting(st);
+            break;
+        case 2:
+            p[at] += (uint8_t)(rnd(st, 35) - 17);
+            break;
+        case 3:
+            if (at + 2 <= n)
+                put_be16(p + at, (uint16_t)pick_interesting(st));
+            break;
+        default:
+            if (at + 4 <= n)
+                put_be32(p + at, pick_interesting(st));
+            break;
+        }
+    }
+}
+
+static void add_part(struct state *st, const uint8_t *data, size_t len, const uint8_t *type)
+{
+    struct part *p;
+
+    if (st->nparts == MAX_PARTS)
+        return;
+    p = &st->parts[st->nparts++];
+    p->data = data;
+    p->len = len;
+    p->mutate = 0;
+    if (type)
+        memcpy(p->type, type, 4);
+}
+
+/* Reorder, drop or repeat the parts from first on. */
+static void shuffle_parts(struct state *st, size_t first, const struct part *extra)
+{
+    size_t n = st->nparts - first, i, j;
+    struct part t;
+
+    if (!n)
+        return;
+    i = first + rnd(st, (uint32_t)n);
+    switch (rnd(st, extra ? 4 : 3))
+    {
+    case 0:
+        if (n > 1)
+        {
+            memmove(&st->parts[i], &st->parts[i + 1], (st->nparts - i - 1) * sizeof *st->parts);
+            st->nparts--;
+        }
+        break;
+    case 1:
+        if (st->nparts < MAX_PARTS)
+        {
+            memmove(&st->parts[i + 1], &st->parts[i], (st->nparts - i) * sizeof *st->parts);
+            st->nparts++;
+        }
+        break;
+    case 2:
+        j = first + rnd(st, (uint32_t)n);
+        t = st->parts[i];
+        st->parts[i] = st->parts[j];
+        st->parts[j] = t;
+        break;
+    default:
+        if (st->nparts < MAX_PARTS)
+        {
+            memmove(&st->parts[i + 1], &st->parts[i], (st->nparts - i) * sizeof *st->parts);
+            st->parts[i] = *extra;
+            st->nparts++;
+        }
+        break;
+    }
+}
+
+/* PNG: the signature, then length, type, data and CRC per chunk. */
+
+static const uint8_t png_sig[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+static int png_parse(struct state *st, const uint8_t *buf, size_t size)
+{
+    size_t pos = 8, len;
+
+    st->nparts = 0;
+    if (size < 8 || memcmp(buf, png_sig, 8))
+        return -1;
+    while (pos + 12 <= size)
+    {
+        len = get_be32(buf + pos);
+        if (len > size - pos - 12)
+            break;
+        add_part(st, buf + pos + 8, len, buf + pos + 4);
+        pos += 12 + len;
+    }
+    return 0;
+}
+
+static void png_fix_crcs(uint8_t *buf, size_t size)
+{
+    size_t pos = 8, len;
+
+    while (pos + 12 <= size)
+    {
+        len = get_be32(buf + pos);
+        if (len > size - pos - 12)
+            break;
+        put_be32(buf + pos + 8 + len, crc32(buf + pos + 4, len + 4));
+        pos += 12 + len;
+    }
+}
+
+static const char *const png_types[] = {"IHDR", "PLTE", "IDAT", "IEND", "tRNS", "gAMA", "cHRM", "sRGB",
+                                        "iCCP", "sBIT", "bKGD", "hIST", "pHYs", "sPLT", "tEXt", "zTXt",
+                                        "iTXt", "tIME", "acTL", "fcTL", "fdAT", "eXIf"};
+
+static size_t png_fuzz(struct state *st, const uint8_t *buf, size_t size, const uint8_t *add, size_t add_size,
+                       size_t max)
+{
+    static uint8_t random_data[64];
+    struct part extra, *p;
+    size_t i, pos, len;
+    uint8_t *o = st->out;
+    int op = rnd(st, 5), ihdr = -1, resize = -1;
+    size_t newlen = 0;
+
+    if (png_parse(st, buf, size) || !st->nparts)
+        return 0;
+    p = &st->parts[rnd(st, (uint32_t)st->nparts)];
+    switch (op)
+    {
+    case 0:
+        p->mutate = 1;
+        break;
+    case 1:
+        for (i = 0; i < st->nparts; i++)
+            if (!memcmp(st->parts[i].type, "IHDR", 4) && st->parts[i].len >= 13)
+                ihdr = (int)i;
+        if (ihdr < 0)
+            p->mutate = 1;
+        break;
+    case 2:
+        /* New length, with random bytes past the old data. */
+        resize = (int)(p - st->parts);
+        newlen = rnd(st, 2) ? rnd(st, (uint32_t)p->len + 1) : p->len + 1 + rnd(st, 64);
+        break;
+    default:
+        extra.mutate = 0;
+        if (add && !png_parse(st, add, add_size) && st->nparts)
+        {
+            extra = st->parts[rnd(st, (uint32_t)st->nparts)];
+        }
+        else
+        {
+            for (i = 0; i < sizeof random_data; i++)
+                random_data[i] = (uint8_t)rnd(st, 256);
+            memcpy(extra.type, png_types[rnd(st, sizeof png_types / sizeof *png_types)], 4);
+            extra.data = random_data;
+            extra.len = rnd(st, sizeof random_data + 1);
+        }
+        /* Leave the leading IHDR, which codecs require first. */
+        png_parse(st, buf, size);
+        shuffle_parts(st, st->nparts > 1 ? 1 : 0, &extra);
+        break;
+    }
+
+    if (max < 8)
+        return 0;
+    memcpy(o, png_sig, 8);
+    pos = 8;
+    for (i = 0; i < st->nparts; i++)
+    {
+        p = &st->parts[i];
+        len = (int)i == resize ? newlen : p->len;
+        if (pos + 12 + len > max)
+            break;
+        put_be32(o + pos, (uint32_t)len);
+        memcpy(o + pos + 4, p->type, 4);
+        memcpy(o + pos + 8, p->data, len < p->len ? len : p->len);
+        if (len > p->len)
+            mutate_bytes(st, memset(o + pos + 8 + p->len, 0, len - p->len), len - p->len);
+        if (p->mutate)
+            mutate_bytes(st, o + pos + 8, len);
+        if ((int)i == ihdr)
+        {
+            uint8_t *h = o + pos + 8;
+            static const uint8_t depths[] = {1, 2, 4, 8, 16, 0, 3, 255};
+            static const uint8_t colors[] = {0, 2, 3, 4, 6, 1, 7, 255};
+            switch (rnd(st, 5))
+            {
+            case 0:
+                put_be32(h + rnd(st, 2) * 4, pick_interesting(st));
+                break;
+            case 1:
+                h[8] = depths[rnd(st, sizeof depths)];
+                break;
+            case 2:
+                h[9] = colors[rnd(st, sizeof colors)];
+                break;
+            case 3:
+                h[12] = (uint8_t)rnd(st, 3);
+                break;
+            default:
+                h[10 + rnd(st, 2)] = (uint8_t)rnd(st, 2);
+                break;
+            }
+        }
+        put_be32(o + pos + 8 + len, crc32(o + pos + 4, len + 4));
+        pos += 12 + len;
+    }
+    return pos;
+}
+
+/* GIF: header, screen descriptor and color table, then blocks. */
+
+struct gif
+{
+    size_t prefix;
+    size_t ranges[MAX_PARTS][2]; /* bytes that are not lengths */
+    size_t nranges;
+};
+
+static void gif_range(struct gif *g, size_t off, size_t len)
+{
+    if (len && g->nranges < MAX_PARTS)
+    {
+        g->ranges[g->nranges][0] = off;
+        g->ranges[g->nranges++][1] = len;
+    }
+}
+
+/* Sub-blocks from pos: returns the end, or 0 if they run past size. */
+static size_t gif_subblocks(struct gif *g, const uint8_t *buf, size_t size, size_t pos)
+{
+    while (pos < size)
+    {
+        size_t n = buf[pos];
+        if (!n)
+            return pos + 1;
+        if (pos + 1 + n > size)
+            return 0;
+        gif_range(g, pos + 1, n);
+        pos += 1 + n;
+    }
+    return 0;
+}
+
+static int gif_parse(struct state *st, struct gif *g, const uint8_t *buf, size_t size)
+{
+    size_t pos = 13, start;
+
+    st->nparts = 0;
+    g->nranges = 0;
+    if (size < 13 || (memcmp(buf, "GIF87a", 6) && memcmp(buf, "GIF89a", 6)))
+        return -1;
+    gif_range(g, 6, 7);
+    if (buf[10] & 0x80)
+    {
+        gif_range(g, pos, 3u << ((buf[10] & 7) + 1));
+        pos += 3u << ((buf[10] & 7) + 1);
+    }
+    g->prefix = pos < size ? pos : size;
+    while (pos < size && buf[pos] != 0x3b)
+    {
+        start = pos;
+        if (buf[pos] == 0x21 && pos + 2 <= size)
+        {
+            gif_range(g, pos + 1, 1);
+            pos = gif_subblocks(g, buf, size, pos + 2);
+        }
+        else if (buf[pos] == 0x2c && pos + 11 <= size)
+        {
+            gif_range(g, pos + 1, 9);
+            pos += 10;
+            if (buf[pos - 1] & 0x80)
+            {
+                gif_range(g, pos, 3u << ((buf[pos - 1] & 7) + 1));
+                pos += 3u << ((buf[pos - 1] & 7) + 1);
+            }
+            /* The LZW minimum code size, then the image data. */
+            gif_range(g, pos, 1);
+            pos = pos + 1 < size ? gif_subblocks(g, buf, size, pos + 1) : 0;
+        }
+        else
+        {
+            pos = 0;
+        }
+        if (!pos)
+            break;
+        add_part(st, buf + start, pos - start, NULL);
+    }
+    return 0;
+}
+
+static size_t gif_fuzz(struct state *st, const uint8_t *buf, size_t size, const uint8_t *add, size_t add_size,
+                       size_t max)
+{
+    static struct gif g, a;
+    struct part extra;
+    size_t i, pos, r;
+
+    if (gif_parse(st, &g, buf, size))
+        return 0;
+    if (rnd(st, 2) && g.nranges)
+    {
+        /* In place: only bytes that are not block lengths. */
+        size = size < max ? size : max;
+        memcpy(st->out, buf, size);
+        r = rnd(st, (uint32_t)g.nranges);
+        if (g.ranges[r][0] + g.ranges[r][1] <= size)
+            mutate_bytes(st, st->out + g.ranges[r][0], g.ranges[r][1]);
+        return size;
+    }
+    if (add && !gif_parse(st, &a, add, add_size) && st->nparts)
+    {
+        extra = st->parts[rnd(st, (uint32_t)st->nparts)];
+        gif_parse(st, &g, buf, size);
+        shuffle_parts(st, 0, &extra);
+    }
+    else
+    {
+        gif_parse(st, &g, buf, size);
+        shuffle_parts(st, 0, NULL);
+    }
+    if (g.prefix + 1 > max)
+        return 0;
+    memcpy(st->out, buf, g.prefix);
+    pos = g.prefix;
+    for (i = 0; i < st->nparts && pos + st->parts[i].len + 1 <= max; i++)
+    {
+        memcpy(st->out + pos, st->parts[i].data, st->parts[i].len);
+        pos += st->parts[i].len;
+    }
+    st->out[pos++] = 0x3b;
+    return pos;
+}
+
+/*
+ * SGI: a 512 byte header; RLE images follow it with a table of row
+ * offsets and one of row lengths, ysize * zsize entries each.
+ */
+
+#define SGI_MAX_ROWS 65536
+
+static size_t sgi_fuzz(struct state *st, const uint8_t *buf, size_t size, size_t max)
+{
+    static const uint8_t *row_data[SGI_MAX_ROWS];
+    static uint32_t row_len[SGI_MAX_ROWS];
+    static const uint8_t fields[] = {2, 3, 4, 6, 8, 10, 12, 16, 104};
+    uint8_t *o = st->out, *h;
+    size_t rows, newrows, i, pos, r;
+    int edit = -1;
+
+    if (max < 512)
+        return 0;
+    memcpy(o, buf, 512);
+    h = o;
+    rows = (size_t)get_be16(buf + 8) * (get_be16(buf + 10) ? get_be16(buf + 10) : 1);
+    if (buf[2] != 1 || !rows || rows > SGI_MAX_ROWS || 512 + rows * 8 > size)
+    {
+        /* Verbatim, or tables we cannot follow: fields and bytes. */
+        size = size < max ? size : max;
+        memcpy(o + 512, buf + 512, size - 512);
+        if (rnd(st, 2))
+            mutate_bytes(st, o + 512, size - 512);
+        else
+            put_be16(h + fields[rnd(st, sizeof fields)], (uint16_t)pick_interesting(st));
+        return size;
+    }
+    for (i = 0; i < rows; i++)
+    {
+        uint32_t start = get_be32(buf + 512 + i * 4), len = get_be32(buf + 512 + (rows + i) * 4);
+        if (start > size)
+            start = (uint32_t)size;
+        if (len > size - start)
+            len = (uint32_t)(size - start);
+        row_data[i] = buf + start;
+        row_len[i] = len;
+    }
+
+    newrows = rows;
+    r = rnd(st, (uint32_t)rows);
+    switch (rnd(st, 5))
+    {
+    case 0:
+        edit = (int)r;
+        break;
+    case 1:
+        /* Shorter or longer: the tables follow. */
+        row_len[r] = rnd(st, 2) ? rnd(st, row_len[r] + 1) : row_len[r] + 1 + rnd(st, 32);
+        break;
+    case 2:
+        i = rnd(st, (uint32_t)rows);
+        row_data[r] = row_data[i];
+        row_len[r] = row_len[i];
+        break;
+    case 3:
+        /* New dimensions; rows are reused to fill the new tables. */
+        put_be16(h + (rnd(st, 2) ? 8 : 10), (uint16_t)(1 + rnd(st, 2 * get_be16(buf + 8) + 4)));
+        newrows = (size_t)get_be16(h + 8) * (get_be16(h + 10) ? get_be16(h + 10) : 1);
+        if (newrows > SGI_MAX_ROWS || 512 + newrows * 8 > max)
+        {
+            memcpy(h + 8, buf + 8, 4);
+            newrows = rows;
+        }
+        for (i = rows; i < newrows; i++)
+        {
+            row_data[i] = row_data[i % rows];
+            row_len[i] = row_len[i % rows];
+        }
+        break;
+    default:
+        h[rnd(st, 2) ? 3 : 5] = (uint8_t)pick_interesting(st);
+        break;
+    }
+
+    pos = 512 + newrows * 8;
+    if (pos > max)
+        return 0;
+    for (i = 0; i < newrows; i++)
+    {
+        size_t len = row_len[i], have = row_data[i] + len <= buf + size ? len : (size_t)(buf + size - row_data[i]);
+        if (pos + len > max)
+            len = have = 0;
+        memcpy(o + pos, row_data[i], have);
+        if (len > have)
+            mutate_bytes(st, memset(o + pos + have, 0, len - have), len - have);
+        if ((int)i == edit)
+            mutate_bytes(st, o + pos, len);
+        put_be32(o + 512 + i * 4, (uint32_t)pos);
+        put_be32(o + 512 + (newrows + i) * 4, (uint32_t)len);
+        pos += len;
+    }
+    return pos;
+}
+
+void *afl_custom_init(void *afl, unsigned int seed)
+{
+    struct state *st = calloc(1, sizeof *st);
+
+    (void)afl;
+    if (st)
+        st->rnd = 0x9e3779b97f4a7c15ULL ^ seed;
+    return st;
+}
+
+static uint8_t *reserve(uint8_t **buf, size_t *have, size_t want)
+{
+    uint8_t *p;
+
+    if (*have >= want)
+        return *buf;
+    if ((p = realloc(*buf, want)) == NULL)
+        return NULL;
+    *have = want;
+    return *buf = p;
+}
+
+size_t afl_custom_fuzz(void *data, uint8_t *buf, size_t buf_size, uint8_t **out_buf, uint8_t *add_buf,
+                       size_t add_buf_size, size_t max_size)
+{
+    struct state *st = data;
+    size_t len = 0;
+
+    *out_buf = buf;
+    if (!reserve(&st->out, &st->out_size, max_size))
+        return buf_size;
+    if (buf_size >= 8 && !memcmp(buf, png_sig, 8))
+        len = png_fuzz(st, buf, buf_size, add_buf, add_buf_size, max_size);
+    else if (buf_size >= 6 && (!memcmp(buf, "GIF87a", 6) || !memcmp(buf, "GIF89a", 6)))
+        len = gif_fuzz(st, buf, buf_size, add_buf, add_buf_size, max_size);
+    else if (buf_size >= 512 && get_be16(buf) == 474)
+        len = sgi_fuzz(st, buf, buf_size, max_size);
+    if (!len)
+    {
+        len = buf_size < max_size ? buf_size : max_size;
+        memcpy(st->out, buf, len);
+        mutate_bytes(st, st->out, len);
+    }
+    *out_buf = st->out;
+    return len;
+}
+
+/* After any mutation, afl-fuzz's own included: PNG chunk CRCs. */
+size_t afl_custom_post_process(void *data, uint8_t *buf, size_t buf_size, uint8_t **out_buf)
+{
+    (void)data;
+    if (buf_size >= 8 && !memcmp(buf, png_sig, 8))
+        png_fix_crcs(buf, buf_size);
+    *out_buf = buf;
+    return buf_size;
+}
+
+void afl_custom_deinit(void *data)
+{
+    struct state *st = data;
+
+    free(st->out);
+    free(st);
+}
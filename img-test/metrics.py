@@ -0,0 +1,225 @@
+#!/usr/bin/env python3
+"""Export fuzzing and loader metrics in the Prometheus text format.
+
+Usage: metrics.py [-d DIR]... [-p TARGET] [-r ROOT] [-P N]
+                  [-o FILE -w SECS | -l PORT]
+
+Reads the fuzzer_stats of every AFL++ instance under the output dirs
+of fuzz.sh (default dist/root/out and images/out) and prints, per
+instance, execs/sec, execs done, stability, coverage, corpus size,
+crashes, hangs and peak RSS. With -p it also runs TARGET once in the
+rootfs (ROOT, default dist) on /root/cases/test.sgi with
+LD_QNX_PROFILE set and exports the loader's startup phases. It also
+exports their sum divided by the inputs each persistent child runs
+(-P, default 10000, PERSIST_COUNT in test.c), as the startup time per
+exec. qol_build_info carries the git commit of the tree, so that
+changes to the ldso or the shims can be lined up with throughput.
+
+Without -o or -l, the metrics are printed once. -o FILE -w SECS
+rewrites FILE every SECS seconds, for node_exporter's textfile
+collector. -l PORT serves them at http://host:PORT/metrics, collected
+on each scrape.
+"""
+
+import argparse
+import glob
+import http.server
+import os
+import subprocess
+import sys
+import time
+
+# fuzzer_stats key: (metric, type, help, scale)
+AFL_METRICS = {
+    "execs_per_sec": ("afl_execs_per_second", "gauge", "Executions per second since the start", 1),
+    "execs_ps_last_min": ("afl_execs_per_second_last_min", "gauge", "Executions per second over the last minute", 1),
+    "execs_done": ("afl_execs_total", "counter", "Executions done", 1),
+    "stability": ("afl_stability_ratio", "gauge", "Share of edges that are stable", 0.01),
+    "bitmap_cvg": ("afl_bitmap_coverage_ratio", "gauge", "Share of the coverage map hit", 0.01),
+    "corpus_count": ("afl_corpus_count", "gauge", "Inputs in the queue", 1),
+    "saved_crashes": ("afl_crashes_total", "counter", "Unique crashes saved", 1),
+    "saved_hangs": ("afl_hangs_total", "counter", "Unique hangs saved", 1),
+    "peak_rss_mb": ("afl_peak_rss_bytes", "gauge", "Peak RSS of the target", 1 << 20),
+    "slowest_exec_ms": ("afl_slowest_exec_seconds", "gauge", "Slowest execution", 1e-3),
+    "last_update": ("afl_last_update_timestamp_seconds", "gauge", "When the instance last wrote its stats", 1),
+}
+
+# An instance that has not written its stats for this long is down;
+# afl-fuzz rewrites them every few seconds.
+STALE_SECS = 60
+
+
+def read_stats(path):
+    stats = {}
+    try:
+        with open(path) as f:
+            for line in f:
+                key, sep, value = line.partition(":")
+                if sep:
+                    stats[key.strip()] = value.strip()
+    except OSError:
+        return None
+    return stats
+
+
+def number(value):
+    try:
+        return float(value.rstrip("%"))
+    except ValueError:
+        return None
+
+
+def afl_samples(dirs):
+    """(metric, labels, value) of every instance under dirs."""
+    out = []
+    now = time.time()
+    for d in dirs:
+        for path in sorted(glob.glob(os.path.join(d, "*", "fuzzer_stats"))):
+            stats = read_stats(path)
+            if stats is None:
+                continue
+            labels = {"instance": os.path.basename(os.path.dirname(path))}
+            for key, (metric, _, _, scale) in AFL_METRICS.items():
+                v = number(stats.get(key, ""))
+                if v is not None:
+                    out.append((metric, labels, v * scale))
+            last = number(stats.get("last_update", "")) or 0
+            out.append(("afl_instance_up", labels, float(now - last < STALE_SECS)))
+    return out
+
+
+def profile_samples(root, target, persist):
+    """Startup phases from one LD_QNX_PROFILE run of target in root."""
+    cmd = ["chroot", root, "env", "LD_QNX_PROFILE=3", "bash", "-c",
+           f"source /root/env.sh && exec {target} /root/cases/test.sgi 3>&1 >/dev/null 2>&1"]
+    try:
+        text = subprocess.run(cmd, capture_output=True, text=True, timeout=30).stdout
+    except (OSError, subprocess.TimeoutExpired) as e:
+        print(f"warning: profile run: {e}", file=sys.stderr)
+        return []
+    out = []
+    labels = {"target": target}
+    for line in text.splitlines():
+        f = line.split()
+        if len(f) < 2 or f[0] != "qnxprof":
+            continue
+        kv = dict(x.split("=", 1) for x in f[2:] if "=" in x)
+        if f[1] == "phase":
+            total = 0
+            for phase in ("load", "reloc", "init"):
+                ns = number(kv.get(f"{phase}_ns", ""))
+                if ns is not None:
+                    total += ns
+                    out.append(("qol_startup_seconds", dict(labels, phase=phase), ns * 1e-9))
+            out.append(("qol_startup_per_exec_seconds", labels, total * 1e-9 / persist))
+        elif f[1] == "total":
+            for key, metric in (("dsos", "qol_startup_dsos"), ("lookups", "qol_startup_lookups"),
+                                ("redirects", "qol_startup_redirects")):
+                v = number(kv.get(key, ""))
+                if v is not None:
+                    out.append((metric, labels, v))
+        elif f[1] == "faults":
+            for key in ("minflt", "majflt"):
+                v = number(kv.get(key, ""))
+                if v is not None:
+                    out.append(("qol_startup_page_faults", dict(labels, kind=key), v))
+    return out
+
+
+PROFILE_HELP = {
+    "qol_startup_seconds": ("gauge", "Loader startup phase time of one run"),
+    "qol_startup_per_exec_seconds": ("gauge", "Loader startup time divided by the inputs per persistent child"),
+    "qol_startup_dsos": ("gauge", "DSOs loaded at startup"),
+    "qol_startup_lookups": ("gauge", "Symbol lookups at startup"),
+    "qol_startup_redirects": ("gauge", "QNX redirects applied at startup"),
+    "qol_startup_page_faults": ("gauge", "Page faults taken during startup"),
+    "afl_instance_up": ("gauge", "Whether the instance updated its stats in the last minute"),
+    "qol_build_info": ("gauge", "Git commit of the QOL tree"),
+}
+
+
+def build_info():
+    here = os.path.dirname(os.path.abspath(__file__))
+    try:
+        commit = subprocess.run(["git", "-C", here, "describe", "--always", "--dirty"],
+                                capture_output=True, text=True).stdout.strip()
+    except OSError:
+        commit = ""
+    return [("qol_build_info", {"commit": commit or "unknown"}, 1.0)]
+
+
+def render(samples):
+    types = {m: (t, h) for m, t, h, _ in AFL_METRICS.values()}
+    types.update(PROFILE_HELP)
+    lines, seen = [], set()
+    for metric, labels, value in sorted(samples, key=lambda s: s[0]):
+        if metric not in seen:
+            seen.add(metric)
+            t, h = types.get(metric, ("gauge", metric))
+            lines.append(f"# HELP {metric} {h}")
+            lines.append(f"# TYPE {metric} {t}")
+        lab = ",".join(f'{k}="{v}"' for k, v in sorted(labels.items()))
+        v = int(value) if value.is_integer() else value
+        lines.append(f"{metric}{{{lab}}} {v}")
+    return "\n".join(lines) + "\n"
+
+
+def collect(args):
+    samples = build_info() + afl_samples(args.dirs)
+    if args.profile:
+        samples += profile_samples(args.root, args.profile, args.persist)
+    return render(samples)
+
+
+def serve(args):
+    class Handler(http.server.BaseHTTPRequestHandler):
+        def do_GET(self):
+            if self.path != "/metrics":
+                self.send_error(404)
+                return
+            body = collect(args).encode()
+            self.send_response(200)
+            self.send_header("Content-Type", "text/plain; version=0.0.4")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+        def log_message(self, *a):
+            pass
+
+    http.server.HTTPServer(("", args.listen), Handler).serve_forever()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Export img-test fuzzing metrics for Prometheus.")
+    parser.add_argument("-d", dest="dirs", action="append", help="AFL++ output dir (repeatable)")
+    parser.add_argument("-p", dest="profile", metavar="TARGET", help="probe loader startup with this target")
+    parser.add_argument("-r", dest="root", default="dist", help="rootfs for -p (default dist)")
+    parser.add_argument("-P", dest="persist", type=int, default=10000,
+                        help="inputs per persistent child (default 10000)")
+    parser.add_argument("-o", dest="out", help="write the metrics to this file")
+    parser.add_argument("-w", dest="every", type=float, help="with -o, rewrite it every SECS seconds")
+    parser.add_argument("-l", dest="listen", type=int, metavar="PORT", help="serve /metrics on PORT")
+    args = parser.parse_args()
+    if not args.dirs:
+        args.dirs = [d for d in ("dist/root/out", "images/out") if os.path.isdir(d)]
+
+    if args.listen:
+        serve(args)
+        return 0
+    while True:
+        text = collect(args)
+        if not args.out:
+            sys.stdout.write(text)
+            return 0
+        tmp = args.out + ".tmp"
+        with open(tmp, "w") as f:
+            f.write(text)
+        os.replace(tmp, args.out)
+        if not args.every:
+            return 0
+        time.sleep(args.every)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,206 @@
+#!/usr/bin/env python3
+"""Write an AFL dictionary of the tokens the codecs look for.
+
+Usage: mkdict.py [-r ROOT] [-c CACHE] [-o DICT] [LIB...]
+
+The tokens of each codec (LIBs, default every img_codec_*.so under
+ROOT/opt/qol/lib, ROOT defaulting to dist) are its short string
+constants and, on x86_64, the 16- and 32-bit immediates it compares
+registers and memory with: the magic numbers and chunk names that an inlined
+memcmp or strncmp, or a switch on a tag, tests without a string to
+show for it. The MIME types and extensions of ROOT/etc/system/config/
+img.conf are added to them.
+
+Scanning a codec is done once per build: its tokens are kept in
+CACHE/<build-id> (default .dict-cache here), named by the GNU build-id
+note, or by the file's SHA-256 when it has none. DICT (default
+ROOT/root/img.dict) is rewritten on every run; fuzz it with
+`./fuzz.sh -x /root/img.dict`.
+
+Cache format: one token per line, in the dictionary's own escaped
+form, without the quotes.
+"""
+
+import argparse
+import glob
+import hashlib
+import os
+import re
+import struct
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+SHT_NOTE = 7
+NT_GNU_BUILD_ID = 3
+EM_X86_64 = 62
+
+MIN_STR, MAX_STR = 3, 16
+# Whole NUL-terminated strings without spaces or printf conversions:
+# messages would only crowd out the names and tags a parser compares.
+WORD = re.compile(rb"(?<=\0)[\x21-\x7e]{%d,%d}(?=\0)" % (MIN_STR, MAX_STR))
+
+
+class Elf:
+    """The sections of a little-endian ELF file, 32- or 64-bit."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = d = f.read()
+        if d[:4] != b"\x7fELF" or d[5] != 1:
+            raise ValueError("not a little-endian ELF file")
+        self.is64 = d[4] == 2
+        self.machine, = struct.unpack_from("<H", d, 0x12)
+        if self.is64:
+            shoff, = struct.unpack_from("<Q", d, 0x28)
+            shentsize, shnum, shstrndx = struct.unpack_from("<HHH", d, 0x3A)
+            fmt = "<IIQQQQ"
+        else:
+            shoff, = struct.unpack_from("<I", d, 0x20)
+            shentsize, shnum, shstrndx = struct.unpack_from("<HHH", d, 0x2E)
+            fmt = "<IIIIII"
+        hdrs = [struct.unpack_from(fmt, d, shoff + i * shentsize)
+                for i in range(shnum)]
+        names = hdrs[shstrndx][4] if shnum else 0
+        self.sections = {}
+        for sh_name, sh_type, _, _, sh_offset, sh_size in hdrs:
+            name = d[names + sh_name:d.index(b"\0", names + sh_name)].decode()
+            self.sections[name] = (sh_type, d[sh_offset:sh_offset + sh_size])
+
+    def build_id(self):
+        for sh_type, b in self.sections.values():
+            off = 0
+            while sh_type == SHT_NOTE and off + 12 <= len(b):
+                namesz, descsz, n_type = struct.unpack_from("<III", b, off)
+                desc = off + 12 + (namesz + 3 & ~3)
+                if n_type == NT_GNU_BUILD_ID and b[off + 12:off + 12 + namesz] == b"GNU\0":
+                    return b[desc:desc + descsz].hex()
+                off = desc + (descsz + 3 & ~3)
+        return None
+
+    def section(self, prefix):
+        return b"".join(b for name, (_, b) in self.sections.items()
+                        if name == prefix or name.startswith(prefix + "."))
+
+
+def strings(elf):
+    for m in WORD.finditer(b"\0" + elf.section(".rodata")):
+        if b"%" not in m.group():
+            yield m.group()
+
+
+def magic(v):
+    """Whether a compared value looks like file bytes rather than a
+    count or a mask: mostly printable, or with a high byte in front of
+    printable ones, as in PNG's."""
+    printable = sum(0x20 <= c < 0x7F for c in v)
+    return printable >= len(v) - 1 and len(set(v)) > 1 and v.count(0) <= 1
+
+
+def modrm_len(b, i):
+    """The length of a ModRM byte at i and the SIB and displacement that
+    follow it."""
+    mod, rm = b[i] >> 6, b[i] & 7
+    n = 1 + (mod != 3 and rm == 4)
+    if mod == 0 and (rm == 5 or rm == 4 and i + 1 < len(b) and b[i + 1] & 7 == 5):
+        return n + 4
+    return n + {1: 1, 2: 4}.get(mod, 0)
+
+
+def immediates(elf):
+    """The operands of every byte sequence in .text that decodes as
+    cmp eax/ax with an immediate, or cmp r/m32 or r/m16 with one (81 /7).
+    Compares of loaded file bytes see them in memory order, so the
+    operand's own bytes are the token. Not knowing where instructions
+    start, this also finds some in the middle of others; magic() drops
+    most of those."""
+    if elf.machine != EM_X86_64:
+        return
+    b = elf.section(".text")
+    for i in range(1, len(b) - 6):
+        width = 2 if b[i - 1] == 0x66 or (b[i - 1] & 0xF0 == 0x40 and b[i - 2] == 0x66) else 4
+        if b[i] == 0x3D:
+            op = i + 1
+        elif b[i] == 0x81 and b[i + 1] & 0x38 == 0x38:
+            op = i + 1 + modrm_len(b, i + 1)
+        else:
+            continue
+        v = b[op:op + width]
+        if len(v) == width and magic(v):
+            yield v
+
+
+def escape(b):
+    return "".join(chr(c) if 0x20 <= c < 0x7F and c not in b'"\\' else f"\\x{c:02x}"
+                   for c in b)
+
+
+def codec_tokens(path, cache):
+    try:
+        elf = Elf(path)
+    except (OSError, ValueError, struct.error) as e:
+        print(f"warning: {path}: {e}", file=sys.stderr)
+        return []
+    key = elf.build_id() or hashlib.sha256(elf.data).hexdigest()
+    cached = os.path.join(cache, key)
+    if os.path.exists(cached):
+        with open(cached) as f:
+            return f.read().split("\n")[:-1]
+    tokens = list(dict.fromkeys(escape(t) for t in (*strings(elf), *immediates(elf))))
+    os.makedirs(cache, exist_ok=True)
+    with open(cached + ".tmp", "w") as f:
+        f.write("".join(t + "\n" for t in tokens))
+    os.replace(cached + ".tmp", cached)
+    return tokens
+
+
+def conf_tokens(path):
+    """The MIME types and extensions of img.conf, a [codec] line and its
+    mime= and ext= lists of ':'-separated values for each codec."""
+    tokens = []
+    try:
+        with open(path) as f:
+            for line in f:
+                key, _, val = line.strip().partition("=")
+                if key in ("mime", "ext"):
+                    tokens += [escape(v.encode()) for v in val.split(":") if v]
+    except OSError as e:
+        print(f"warning: {e}", file=sys.stderr)
+    return tokens
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Write an AFL dictionary for the codecs")
+    parser.add_argument("-r", "--root", default="dist", help="rootfs (default dist)")
+    parser.add_argument("-c", "--cache", default=os.path.join(HERE, ".dict-cache"),
+                        help="token cache dir")
+    parser.add_argument("-o", "--output", help="dictionary (default ROOT/root/img.dict)")
+    parser.add_argument("libs", nargs="*", help="codecs (default ROOT/opt/qol/lib/img_codec_*.so)")
+    args = parser.parse_args()
+
+    libs = args.libs or sorted(glob.glob(os.path.join(args.root, "opt/qol/lib/img_codec_*.so")))
+    if not libs:
+        print("no codecs found", file=sys.stderr)
+        return 1
+    entries = {}
+    for lib in libs:
+        name = os.path.basename(lib).removeprefix("img_codec_").removesuffix(".so")
+        name = re.sub(r"\W", "_", name)
+        for t in codec_tokens(lib, args.cache):
+            entries.setdefault(t, name)
+    for t in conf_tokens(os.path.join(args.root, "etc/system/config/img.conf")):
+        entries.setdefault(t, "conf")
+
+    out = args.output or os.path.join(args.root, "root/img.dict")
+    count = {}
+    with open(out, "w") as f:
+        for t, name in entries.items():
+            count[name] = count.get(name, 0) + 1
+            f.write(f'{name}_{count[name]}="{t}"\n')
+    print(f"{out}: {len(entries)} tokens from " +
+          ", ".join(f"{n} {c}" for n, c in count.items()))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -5,7 +5,8 @@ if [ $(id -u) -ne 0 ]; then
 	exit 1
 fi
 
-DIST=dist
+# DIST=<root> mounts them into another rootfs, e.g. an image.sh instance.
+DIST=${DIST:-dist}
 
 if [ "$1" = "umount" ]; then
     if ! mount | grep -q ${DIST}/dev; then
@@ -0,0 +1,109 @@
+#include <img/img.h>
+#include <io/io.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/*
+ * The QNX side of qemu-demo/scripts/snap_repro.py: the same decode as
+ * fuzz-test, with the input handed over in guest memory rather than
+ * through a file. The mailbox is physically contiguous, so the host
+ * reaches it in the RAM file of `start-qemu.sh --snap` at the physical
+ * address printed at startup. The host snapshots the VM while the
+ * harness waits in SNAP_READY, writes an input and sets SNAP_GO, and
+ * reads the outcome back once the state is SNAP_DONE or SNAP_CRASH.
+ * After a crash or a hang it restores the snapshot; otherwise the next
+ * input is simply written and SNAP_GO set again.
+ */
+
+#define SNAP_MAGIC 0x50414e53 /* "SNAP" */
+#define SNAP_MAX_INPUT (1 << 20)
+
+enum
+{
+    SNAP_READY = 1,
+    SNAP_GO,
+    SNAP_DONE,
+    SNAP_CRASH,
+};
+
+struct snap_mailbox
+{
+    uint32_t magic;
+    volatile uint32_t state;
+    uint32_t len;
+    int32_t result; /* img_load's return, or the signal on SNAP_CRASH */
+    unsigned char data[SNAP_MAX_INPUT];
+};
+
+static struct snap_mailbox *mb;
+
+/* Report the signal and wait for the host to restore the snapshot. */
+static void crash(int sig)
+{
+    mb->result = sig;
+    mb->state = SNAP_CRASH;
+    for (;;)
+        ;
+}
+
+int main(void)
+{
+    static const int sigs[] = {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT};
+    img_lib_t ilib = NULL;
+    io_stream_t *input;
+    img_t img;
+    off64_t pa;
+    size_t contig;
+    unsigned i;
+    int rc;
+
+    if ((rc = img_lib_attach(&ilib)) != IMG_ERR_OK)
+    {
+        fprintf(stderr, "img_lib_attach() failed: %d\n", rc);
+        return -1;
+    }
+
+    mb = mmap(NULL, sizeof *mb, PROT_READ | PROT_WRITE, MAP_PHYS | MAP_ANON | MAP_SHARED, NOFD, 0);
+    if (mb == MAP_FAILED)
+    {
+        perror("mmap");
+        return -1;
+    }
+    if (mem_offset64(mb, NOFD, sizeof *mb, &pa, &contig) == -1 || contig < sizeof *mb)
+    {
+        fprintf(stderr, "mailbox is not physically contiguous\n");
+        return -1;
+    }
+
+    /* The ssh session that started us does not survive a restore. */
+    signal(SIGHUP, SIG_IGN);
+    for (i = 0; i < sizeof sigs / sizeof *sigs; i++)
+        signal(sigs[i], crash);
+
+    printf("snap-repro: mailbox 0x%llx size 0x%zx\n", (unsigned long long)pa, sizeof *mb);
+    fflush(stdout);
+
+    mb->magic = SNAP_MAGIC;
+    mb->state = SNAP_READY;
+    for (;;)
+    {
+        while (mb->state != SNAP_GO)
+            ;
+        if ((input = io_open(IO_MEM, IO_READ, mb->len, mb->data)) == NULL)
+            rc = IMG_ERR_MEM;
+        else
+        {
+            memset(&img, 0, sizeof img);
+            if ((rc = img_load(ilib, input, NULL, &img)) == IMG_ERR_OK && img.flags & IMG_DIRECT)
+                free(img.access.direct.data);
+            io_close(input);
+        }
+        mb->result = rc;
+        mb->state = SNAP_DONE;
+    }
+}
@@ -0,0 +1,245 @@
+#!/usr/bin/env python3
+"""Share the queue entries and crashes of fuzz.sh between hosts.
+
+Usage: sync.py [-p HOST:PORT]... [-d DIR] [-l PORT] [-w SECS]
+            [-b KBPS]
+
+Run one on every node, beside `fuzz.sh -N NODE`, with the other nodes
+as peers (-p, repeatable). Each serves at http://host:PORT (-l, default
+8390) the inputs of its own instances under the output dir (-d, default
+dist/root/out, or images/out for fuzz.sh -O): the queue entries that
+found new edges (+cov in the name) and the crashes. The queue entries
+that only changed hit counts are left home: they add little once the
+edges are known, and the bandwidth is better spent on the ones that do.
+
+Every SECS seconds (-w, default 30) each peer is asked for the entries
+added since the last ask, and those whose SHA-256 this node does not
+hold already are fetched into DIR/node-HOST_PORT/queue and crashes/. That
+dir looks like one more instance to afl-fuzz: the main instance of the
+node imports the queue entries that are new coverage there, and
+triage.sh finds the crashes. Entries another node fetched are not
+offered on again, so with every node the peer of every other, each
+input crosses each link once.
+
+-b caps what is sent and what is fetched, each, at KBPS kilobytes a
+second (default no cap).
+
+Endpoints:
+    /index?since=N   "seq sha256 kind size" lines of the entries after
+                     seq N, kind queue or crashes
+    /file/SHA256     the content of one of them
+"""
+
+import argparse
+import hashlib
+import http.server
+import os
+import sys
+import threading
+import time
+import urllib.request
+from socketserver import ThreadingMixIn
+
+CHUNK = 65536
+# In the name of a queue entry that took a new edge.
+NEW_COVERAGE = "+cov"
+
+
+class Limit:
+    """A token bucket of bytes, refilled at rate a second; one second's
+    worth at most is held."""
+
+    def __init__(self, rate):
+        self.rate, self.lock = rate, threading.Lock()
+        self.level, self.last = rate, time.monotonic()
+
+    def take(self, n):
+        if not self.rate:
+            return
+        with self.lock:
+            now = time.monotonic()
+            self.level = min(self.rate, self.level + (now - self.last) * self.rate) - n
+            self.last = now
+            wait = -self.level / self.rate
+        if wait > 0:
+            time.sleep(wait)
+
+
+class Store:
+    """The entries of the local instances, in the order found, and the
+    hash of every input this node holds, its own or fetched."""
+
+    def __init__(self, root):
+        self.root, self.lock = root, threading.Lock()
+        self.entries, self.by_sha, self.seen = [], {}, set()
+        self.known = set()
+
+    def scan(self):
+        try:
+            names = sorted(os.listdir(self.root))
+        except OSError:
+            return
+        for inst in names:
+            if inst.startswith(("node-", ".")):
+                self.index_fetched(inst)
+                continue
+            for kind in ("queue", "crashes"):
+                d = os.path.join(self.root, inst, kind)
+                try:
+                    files = sorted(os.listdir(d))
+                except OSError:
+                    continue
+                for f in files:
+                    if not f.startswith("id:") or kind == "queue" and NEW_COVERAGE not in f:
+                        continue
+                    self.add(os.path.join(d, f), kind)
+
+    def index_fetched(self, inst):
+        """Hashes of the inputs fetched before a restart, so that they are
+        not fetched again."""
+        if inst in self.seen:
+            return
+        self.seen.add(inst)
+        for kind in ("queue", "crashes"):
+            d = os.path.join(self.root, inst, kind)
+            for f in os.listdir(d) if os.path.isdir(d) else ():
+                sha = sha_of(os.path.join(d, f))
+                if sha:
+                    self.known.add(sha)
+
+    def add(self, path, kind):
+        if path in self.seen:
+            return
+        sha = sha_of(path)
+        if not sha:
+            return
+        self.seen.add(path)
+        with self.lock:
+            self.known.add(sha)
+            if sha in self.by_sha:
+                return
+            self.by_sha[sha] = path
+            self.entries.append((sha, kind, os.path.getsize(path)))
+
+    def since(self, n):
+        with self.lock:
+            return [(i + 1, *e) for i, e in enumerate(self.entries[n:], n)]
+
+
+def sha_of(path):
+    try:
+        with open(path, "rb") as f:
+            return hashlib.sha256(f.read()).hexdigest()
+    except OSError:
+        return None
+
+
+def serve(store, port, limit):
+    class Handler(http.server.BaseHTTPRequestHandler):
+        def do_GET(self):
+            if self.path.startswith("/index"):
+                since = int(self.path.partition("since=")[2] or 0)
+                body = "".join(f"{i} {sha} {kind} {size}\n"
+                               for i, sha, kind, size in store.since(since)).encode()
+                self.reply(body)
+            elif self.path.startswith("/file/"):
+                path = store.by_sha.get(self.path[6:])
+                try:
+                    with open(path or "", "rb") as f:
+                        body = f.read()
+                except OSError:
+                    self.send_error(404)
+                    return
+                self.reply(body)
+            else:
+                self.send_error(404)
+
+        def reply(self, body):
+            self.send_response(200)
+            self.send_header("Content-Type", "application/octet-stream")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            for off in range(0, len(body), CHUNK):
+                limit.take(len(body[off:off + CHUNK]))
+                self.wfile.write(body[off:off + CHUNK])
+
+        def log_message(self, *a):
+            pass
+
+    class Server(ThreadingMixIn, http.server.HTTPServer):
+        daemon_threads = True
+
+    Server(("", port), Handler).serve_forever()
+
+
+class Peer:
+    def __init__(self, addr, root):
+        self.addr, self.seq = addr, 0
+        self.dir = os.path.join(root, "node-" + addr.replace(":", "_"))
+        # afl-fuzz imports ids above the last it saw from this dir.
+        self.next_id = {kind: len(os.listdir(os.path.join(self.dir, kind)))
+                        if os.path.isdir(os.path.join(self.dir, kind)) else 0
+                        for kind in ("queue", "crashes")}
+
+    def get(self, path, limit):
+        with urllib.request.urlopen(f"http://{self.addr}{path}", timeout=30) as r:
+            out = b""
+            while chunk := r.read(CHUNK):
+                limit.take(len(chunk))
+                out += chunk
+            return out
+
+    def pull(self, store, limit):
+        fetched = 0
+        for line in self.get(f"/index?since={self.seq}", limit).decode().splitlines():
+            seq, sha, kind, _ = line.split()
+            if kind in self.next_id and sha not in store.known:
+                data = self.get(f"/file/{sha}", limit)
+                if hashlib.sha256(data).hexdigest() != sha:
+                    break
+                d = os.path.join(self.dir, kind)
+                os.makedirs(d, exist_ok=True)
+                name = f"id:{self.next_id[kind]:06d},sync:{self.addr}"
+                with open(os.path.join(d, ".tmp"), "wb") as f:
+                    f.write(data)
+                os.replace(os.path.join(d, ".tmp"), os.path.join(d, name))
+                self.next_id[kind] += 1
+                store.known.add(sha)
+                fetched += 1
+            self.seq = int(seq)
+        return fetched
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Share fuzzing inputs between nodes")
+    parser.add_argument("-p", dest="peers", action="append", default=[], metavar="HOST:PORT",
+                        help="another node (repeatable)")
+    parser.add_argument("-d", dest="dir", help="fuzz.sh output dir")
+    parser.add_argument("-l", dest="listen", type=int, default=8390, help="port to serve on")
+    parser.add_argument("-w", dest="every", type=float, default=30, help="seconds between pulls")
+    parser.add_argument("-b", dest="kbps", type=float, default=0, help="bandwidth cap, KB/s each way")
+    args = parser.parse_args()
+    if not args.dir:
+        args.dir = "images/out" if os.path.isdir("images/out") else "dist/root/out"
+
+    store = Store(args.dir)
+    store.scan()
+    threading.Thread(target=serve, daemon=True,
+                     args=(store, args.listen, Limit(args.kbps * 1000))).start()
+    peers = [Peer(p, args.dir) for p in args.peers]
+    pull_limit = Limit(args.kbps * 1000)
+    while True:
+        time.sleep(args.every)
+        store.scan()
+        for p in peers:
+            try:
+                n = p.pull(store, pull_limit)
+            except (OSError, ValueError) as e:
+                print(f"warning: {p.addr}: {e}", file=sys.stderr)
+                continue
+            if n:
+                print(f"{n} new from {p.addr}")
+
+
+if __name__ == "__main__":
+    sys.exit(main())
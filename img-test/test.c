@@ -1,35 +1,80 @@
 #include <img/img.h>
 #include <io/io.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "afl.h"
+
+/* Inputs per fuzzing child before the fork server starts a fresh one. */
+#define PERSIST_COUNT 10000
+
+__AFL_FUZZ_INIT();
+
 int main(int argc, char **argv)
 {
-    int rc;
-    img_t img = {0};
+    int rc = IMG_ERR_OK;
+    img_t img;
     img_lib_t ilib = NULL;
+    io_stream_t *input;
     const char *filename;
+    unsigned char *buf;
+    unsigned int len;
 
-    if (argc != 2)
+    if (argc > 2)
     {
-        fprintf(stderr, "Usage: %s <image file>\n", argv[0]);
+        fprintf(stderr, "Usage: %s [image file]\n", argv[0]);
         return -1;
     }
 
-    filename = argv[1];
-
     if ((rc = img_lib_attach(&ilib)) != IMG_ERR_OK)
     {
         fprintf(stderr, "img_lib_attach() failed: %d\n", rc);
         return -1;
     }
 
-    if ((rc = img_load_file(ilib, filename, NULL, &img)) != IMG_ERR_OK)
+    __AFL_INIT();
+
+    /* A file, by hand or as afl-fuzz's @@, is loaded whole, whatever its size. */
+    if (argc == 2)
+    {
+        filename = argv[1];
+        while (__AFL_LOOP(PERSIST_COUNT))
+        {
+            memset(&img, 0, sizeof img);
+            if ((rc = img_load_file(ilib, filename, NULL, &img)) != IMG_ERR_OK)
+            {
+                fprintf(stderr, "img_load_file() (load) failed: %d\n", rc);
+                perror("img_load_file");
+                continue;
+            }
+            if (img.flags & IMG_DIRECT)
+                free(img.access.direct.data);
+        }
+        img_lib_detach(ilib);
+        return rc != IMG_ERR_OK ? -1 : 0;
+    }
+
+    buf = __AFL_FUZZ_TESTCASE_BUF;
+
+    /* Otherwise the library and its codecs stay attached across inputs, decoded straight
+     * from shared memory, or read once from stdin. */
+    while (__AFL_LOOP(PERSIST_COUNT))
     {
-        fprintf(stderr, "img_load_file() (load) failed: %d\n", rc);
-        perror("img_load_file");
-        return -1;
+        len = __AFL_FUZZ_TESTCASE_LEN;
+        if ((input = io_open(IO_MEM, IO_READ, len, buf)) == NULL)
+        {
+            rc = IMG_ERR_MEM;
+            continue;
+        }
+        memset(&img, 0, sizeof img);
+        if ((rc = img_load(ilib, input, NULL, &img)) != IMG_ERR_OK)
+            fprintf(stderr, "img_load() failed: %d\n", rc);
+        else if (img.flags & IMG_DIRECT)
+            free(img.access.direct.data);
+        io_close(input);
     }
 
     img_lib_detach(ilib);
+    return rc != IMG_ERR_OK ? -1 : 0;
 }
@@ -0,0 +1,120 @@
+#!/bin/bash
+#
+# Bucket AFL++ crashes by stack: rerun each crash input in the rootfs,
+# one per core, with QNX_CRASH_TRACE set so the QOL libc writes the
+# crashing stack and its hash (see qol/musl/src/qnxsupport/crash.c),
+# then group the inputs by hash under /root/triage/<hash> with one
+# symbolized trace each.
+
+print_help() {
+    echo "Usage: $0 [-h] [-j jobs] [-n frames] [-c crash dir] [--] [target [args]]"
+    echo "   -h: print this help message"
+    echo "   -j: parallel jobs (default: all cores)"
+    echo "   -n: frames hashed into a bucket (default: 5)"
+    echo "   -c: dir of crash inputs (default: every crashes/ dir of fuzz.sh)"
+    echo "   target defaults to fuzz-test; the input path is appended"
+}
+
+if [ $(id -u) -ne 0 ]; then
+    echo "Please run as root"
+    exit 1
+fi
+
+DIST=dist
+JOBS=$(nproc)
+FRAMES=5
+TRIAGE=/root/triage
+CRASHES=()
+
+while getopts "hj:n:c:" opt; do
+    case $opt in
+    h)
+        print_help
+        exit 0
+        ;;
+    j)
+        JOBS=$OPTARG
+        ;;
+    n)
+        FRAMES=$OPTARG
+        ;;
+    c)
+        CRASHES+=("$OPTARG")
+        ;;
+    \?)
+        print_help
+        exit 1
+        ;;
+    esac
+done
+
+shift $((OPTIND - 1))
+
+if [ "$1" = "--" ]; then
+    shift
+fi
+
+if [ $# -eq 0 ]; then
+    set -- fuzz-test
+fi
+
+if [ ${#CRASHES[@]} -eq 0 ]; then
+    CRASHES=(${DIST}/root/out/*/crashes)
+fi
+
+./mount-dev.sh mount
+
+OUT=${DIST}${TRIAGE}
+rm -rf $OUT
+mkdir -p $OUT/inputs $OUT/traces
+
+# Identical inputs from different instances are run once.
+find "${CRASHES[@]}" -type f -name 'id:*' -print0 2>/dev/null |
+    xargs -0 -r sha256sum | sort -k1,1 -u |
+    while read hash file; do
+        cp "$file" $OUT/inputs/$hash
+    done
+echo "$(ls $OUT/inputs | wc -l) distinct crash inputs"
+
+run_one() {
+    chroot ${DIST} env QNX_CRASH_TRACE=2 QNX_CRASH_FRAMES=$FRAMES \
+        bash -c "source /root/env.sh && exec timeout 10 $TARGET $TRIAGE/inputs/$1" \
+        > /dev/null 2> ${DIST}${TRIAGE}/traces/$1
+}
+export -f run_one
+export DIST TRIAGE FRAMES TARGET="$*"
+ls $OUT/inputs | xargs -P $JOBS -I{} bash -c 'run_one {}'
+
+# A run that crashes again inside the handler keeps its first hash.
+for trace in $OUT/traces/*; do
+    hash=$(grep -m1 '^qnxcrash hash' $trace | cut -d' ' -f3)
+    bucket=$OUT/${hash:-no-crash}
+    mkdir -p $bucket
+    ln -f $OUT/inputs/$(basename $trace) $bucket/
+    [ -e $bucket/trace.txt ] || cp $trace $bucket/trace.txt
+done
+
+# Offsets into the objects, resolved with their full symbol tables.
+if command -v addr2line > /dev/null; then
+    for trace in $OUT/*/trace.txt; do
+        grep '^qnxcrash frame' $trace | while read _ _ i _ loc _; do
+            obj=${loc%+*}
+            [ -f ${DIST}$obj ] || continue
+            echo "#$i $(addr2line -f -C -e ${DIST}$obj ${loc##*+} | paste -sd' ')"
+        done > ${trace%.txt}.sym
+    done
+fi
+
+echo "$(ls -d $OUT/*/ | grep -vc '/inputs/\|/traces/') buckets:"
+for bucket in $OUT/*/; do
+    case $bucket in
+    */inputs/ | */traces/)
+        continue
+        ;;
+    esac
+    n=$(ls $bucket | grep -vc '^trace')
+    top=$(grep -m1 '^qnxcrash assert' $bucket/trace.txt 2>/dev/null | cut -d' ' -f3-)
+    [ -n "$top" ] ||
+        top=$(grep -m1 '^qnxcrash frame 0' $bucket/trace.txt 2>/dev/null | cut -d' ' -f5-)
+    echo "$n $(basename $bucket) $top"
+done | sort -rn
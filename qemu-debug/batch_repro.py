@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+"""
+Rerun a directory of crashing inputs under ntox86_64-gdb on the VMs of
+qemu-demo/scripts/pool.py.
+
+Usage: batch_repro.py [-b TEST] [-g GDB] [-t SECS] [-n FRAMES] -o OUTDIR
+                      INPUT_DIR
+
+Start the pool first (`pool.py up -n N`). On every VM, TEST (default:
+./test, built by deploy.sh) is copied to /tmp, and pdebug is started
+before each run and reached through a forward on the VM's ssh master
+connection. The inputs of INPUT_DIR are handed out from one queue to
+the VMs; each runs as `TEST /tmp/repro-in` under gdb with the symbols
+of qnxsyms.py, and collect.py writes OUTDIR/<input>.json: the exit
+code, or the signal with the backtrace and the registers. A run that
+takes longer than -t seconds is killed and recorded as a timeout.
+Crashes are then listed grouped by their top -n frames.
+"""
+import hashlib
+import json
+import os
+import queue
+import subprocess
+import sys
+import threading
+from argparse import ArgumentParser
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEMO = os.path.join(HERE, "..", "qemu-demo")
+sys.path.insert(0, os.path.join(DEMO, "scripts"))
+
+from pool import alive, free_port, instances, read, scp_to, ssh  # noqa: E402
+
+PDEBUG_PORT = 8000
+GUEST_INPUT = "/tmp/repro-in"
+
+
+def forward(vm):
+    """A local port forwarded to pdebug on vm, over its ssh master."""
+    port = free_port()
+    ssh(vm, "true")
+    subprocess.run(
+        ["ssh", "-F", os.path.join(DEMO, "scripts", "ssh_config"),
+         "-i", os.path.join(DEMO, "ssh", "client.rsa"), "-p", read(vm, "port"),
+         "-O", "forward", "-L", f"{port}:127.0.0.1:{PDEBUG_PORT}", "qemu-demo"],
+        check=True, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL,
+    )
+    return port
+
+
+def run_one(args, vm, port, path, out):
+    name = os.path.basename(args.binary)
+    if os.path.exists(out):
+        os.unlink(out)
+    if ssh(vm, f"cat > {GUEST_INPUT}", stdin=path) != 0:
+        return None
+    # A fresh pdebug per run; the last one may still hold a hung test.
+    ssh(vm, f"slay -f -Q {name} pdebug; nohup pdebug {PDEBUG_PORT} > /dev/null 2>&1 & sleep 1")
+    env = dict(os.environ, REPRO_INPUT=path, REPRO_JSON=out)
+    cmd = [args.gdb, "-batch", "-nx",
+           "-ex", "set pagination off",
+           "-ex", f"target qnx 127.0.0.1:{port}",
+           "-ex", f"set nto-executable /tmp/{name}",
+           "-ex", f"file {args.binary}",
+           "-ex", f"source {os.path.join(HERE, 'qnxsyms.py')}",
+           "-ex", f"run {GUEST_INPUT}",
+           "-x", os.path.join(HERE, "collect.py")]
+    try:
+        subprocess.run(cmd, env=env, cwd=HERE, timeout=args.timeout,
+                       stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    except subprocess.TimeoutExpired:
+        with open(out, "w") as f:
+            json.dump({"input": path, "status": "timeout"}, f, indent=1)
+    try:
+        with open(out) as f:
+            return json.load(f)
+    except (OSError, ValueError):
+        return {"input": path, "status": "error"}
+
+
+def bucket(result, n):
+    top = [f.get("function") or f.get("object") or f["pc"] for f in result["frames"][:n]]
+    return hashlib.sha1("\n".join(top).encode()).hexdigest()[:12], top
+
+
+def main():
+    parser = ArgumentParser(description="Batch crash reproduction over target qnx")
+    parser.add_argument("-b", "--binary", default=os.path.join(HERE, "test"),
+                        help="QNX binary taking the input path, default: ./test")
+    parser.add_argument("-g", "--gdb", default="ntox86_64-gdb", help="gdb, default: ntox86_64-gdb")
+    parser.add_argument("-t", "--timeout", type=float, default=60,
+                        help="seconds per run, default: 60")
+    parser.add_argument("-n", "--frames", type=int, default=3,
+                        help="frames a crash is grouped by, default: 3")
+    parser.add_argument("-o", "--outdir", required=True, help="directory for the JSON results")
+    parser.add_argument("inputs", help="directory of crashing inputs")
+    args = parser.parse_args()
+    args.binary = os.path.abspath(args.binary)
+
+    vms = [vm for vm in instances() if alive(vm)]
+    if not vms:
+        sys.exit("no VM is up; run qemu-demo/scripts/pool.py up first")
+    os.makedirs(args.outdir, exist_ok=True)
+    jobs = queue.Queue()
+    for name in sorted(os.listdir(args.inputs)):
+        path = os.path.join(args.inputs, name)
+        if os.path.isfile(path):
+            jobs.put(path)
+    lock = threading.Lock()
+    results = []
+
+    def worker(vm):
+        vname = os.path.basename(vm)
+        try:
+            port = forward(vm)
+        except subprocess.CalledProcessError:
+            print(f"vm {vname}: no pdebug forward", file=sys.stderr)
+            return
+        if scp_to(vm, args.binary, "/tmp/") != 0:
+            print(f"vm {vname}: setup failed", file=sys.stderr)
+            return
+        while True:
+            try:
+                path = jobs.get_nowait()
+            except queue.Empty:
+                return
+            out = os.path.join(args.outdir, os.path.basename(path) + ".json")
+            r = run_one(args, vm, port, path, out)
+            if r is None:
+                # The VM is gone: another one takes the input.
+                print(f"vm {vname}: lost, requeueing {path}", file=sys.stderr)
+                jobs.put(path)
+                return
+            with lock:
+                results.append(r)
+                what = r.get("signal") or r.get("code")
+                print(f"{path}: {r['status']} {'' if what is None else what} (vm {vname})",
+                      flush=True)
+
+    threads = [threading.Thread(target=worker, args=(vm,)) for vm in vms]
+    for th in threads:
+        th.start()
+    for th in threads:
+        th.join()
+
+    buckets = {}
+    for r in results:
+        if r["status"] == "signal" and r.get("frames"):
+            h, top = bucket(r, args.frames)
+            buckets.setdefault(h, (top, []))[1].append(r["input"])
+    for h, (top, inputs) in sorted(buckets.items(), key=lambda b: -len(b[1][1])):
+        print(f"{h} {len(inputs):5d}  {' <- '.join(top)}")
+    lost = jobs.qsize()
+    if lost:
+        print(f"{lost} inputs not run", file=sys.stderr)
+    return 1 if buckets or lost else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,55 @@
+"""
+Write the outcome of one batch_repro.py run as JSON: how the process
+ended and, if a signal stopped it, its backtrace and registers. Run by
+ntox86_64-gdb after `run` returns; the input and the output file come
+from REPRO_INPUT and REPRO_JSON.
+"""
+import json
+import os
+import re
+
+import gdb
+
+REGS = ("rax", "rbx", "rcx", "rdx", "rsi", "rdi", "rbp", "rsp",
+        "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15", "rip", "eflags")
+MAX_FRAMES = 64
+
+
+def frames():
+    out, frame = [], gdb.newest_frame()
+    while frame and len(out) < MAX_FRAMES:
+        pc = frame.pc()
+        sal = frame.find_sal()
+        f = {"pc": f"{pc:#x}", "function": frame.name()}
+        if sal.symtab:
+            f["file"], f["line"] = sal.symtab.filename, sal.line
+        sym = gdb.execute(f"info symbol {pc:#x}", to_string=True).strip()
+        m = re.search(r" in section \S+(?: of (\S+))?", sym)
+        if m and m.group(1):
+            f["object"] = m.group(1)
+        out.append(f)
+        try:
+            frame = frame.older()
+        except gdb.error:
+            break
+    return out
+
+
+def registers():
+    frame = gdb.newest_frame()
+    return {r: f"{int(frame.read_register(r)) & (1 << 64) - 1:#x}" for r in REGS}
+
+
+result = {"input": os.environ.get("REPRO_INPUT")}
+if not gdb.selected_inferior().pid:
+    code = gdb.convenience_variable("_exitcode")
+    result["status"] = "exit"
+    result["code"] = int(code) if code is not None else None
+else:
+    m = re.search(r"signal (SIG\w+)", gdb.execute("info program", to_string=True))
+    result["status"] = "signal"
+    result["signal"] = m.group(1) if m else None
+    result["frames"] = frames()
+    result["registers"] = registers()
+with open(os.environ["REPRO_JSON"], "w") as f:
+    json.dump(result, f, indent=1)
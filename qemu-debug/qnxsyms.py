@@ -0,0 +1,270 @@
+"""
+Load the symbols of a QNX process's shared objects into ntox86_64-gdb.
+
+Source it from a gdb script (`source qnxsyms.py`) once the process runs.
+The loaded objects and their text bases come from `info meminfo` over
+the `target qnx` connection, read straight into Python, with no log
+file in between. Each object's symbol file is matched by the build-id
+read from the target's copy of the object, so that a stale .sym next to
+a newer library is not picked up; the build-ids of the files under the
+symbol directories are kept in ~/.cache/qnxsyms.json and only files
+whose size or mtime changed are read again, and of those only the
+headers and notes.
+
+Symbols are added lazily: when the process stops, every frame of the
+stack that has no symbols gets those of the object it is in, and
+nothing else is loaded. `qnx-symbols NAME...` loads the objects whose
+name contains a NAME right away (before setting breakpoints in them),
+and `qnx-symbols` alone loads all of them.
+
+The symbol directories are the ones in QNX_SYM_PATH (colon-separated),
+or $QNX_TARGET/x86_64, and every .so and .sym file below them is
+indexed, so that libpng16, libjpeg and the others libimg pulls in are
+found wherever the SDK keeps them.
+"""
+import json
+import os
+import re
+import struct
+
+import gdb
+
+PT_LOAD, PT_NOTE = 1, 4
+NT_GNU_BUILD_ID = 3
+CACHE = os.path.expanduser("~/.cache/qnxsyms.json")
+# Frames looked at on each stop
+MAX_FRAMES = 64
+
+
+def sym_dirs():
+    if os.environ.get("QNX_SYM_PATH"):
+        return os.environ["QNX_SYM_PATH"].split(":")
+    return [os.path.join(os.environ.get("QNX_TARGET", ""), "x86_64")]
+
+
+def elf_build_id(read, mapped):
+    """
+    The build-id of an ELF image, or None. read(off, n) reads the image:
+    the file when mapped is false, or its loaded segments from their
+    base otherwise.
+    """
+    eh = read(0, 64)
+    if eh[:4] != b"\x7fELF":
+        return None
+    phoff, = struct.unpack_from("<Q", eh, 0x20)
+    phentsize, phnum = struct.unpack_from("<HH", eh, 0x36)
+    ph = read(phoff, phentsize * phnum)
+    loads, notes = [], []
+    for i in range(phnum):
+        p_type, _, p_offset, p_vaddr, _, p_filesz = struct.unpack_from(
+            "<IIQQQQ", ph, i * phentsize
+        )
+        if p_type == PT_LOAD:
+            loads.append(p_vaddr)
+        elif p_type == PT_NOTE:
+            notes.append((p_offset, p_vaddr, p_filesz))
+    bias = min(loads, default=0)
+    for off, vaddr, size in notes:
+        d = read(vaddr - bias if mapped else off, size)
+        o = 0
+        while o + 12 <= len(d):
+            namesz, descsz, ntype = struct.unpack_from("<III", d, o)
+            name = d[o + 12 : o + 12 + namesz]
+            desc = o + 12 + (namesz + 3 & ~3)
+            if ntype == NT_GNU_BUILD_ID and name == b"GNU\0":
+                return d[desc : desc + descsz].hex()
+            o = desc + (descsz + 3 & ~3)
+    return None
+
+
+def text_offset(path):
+    """Address of .text relative to the first PT_LOAD of the file."""
+    with open(path, "rb") as f:
+        d = f.read()
+    phoff, shoff = struct.unpack_from("<QQ", d, 0x20)
+    phentsize, phnum, shentsize, shnum, shstrndx = struct.unpack_from("<HHHHH", d, 0x36)
+    loads = [
+        struct.unpack_from("<IIQQ", d, phoff + i * phentsize)[3]
+        for i in range(phnum)
+        if struct.unpack_from("<I", d, phoff + i * phentsize)[0] == PT_LOAD
+    ]
+    strtab, = struct.unpack_from("<Q", d, shoff + shstrndx * shentsize + 0x18)
+    for i in range(shnum):
+        sh = shoff + i * shentsize
+        sh_name, = struct.unpack_from("<I", d, sh)
+        name = d[strtab + sh_name : d.index(b"\0", strtab + sh_name)]
+        if name == b".text":
+            return struct.unpack_from("<Q", d, sh + 0x10)[0] - min(loads, default=0)
+    return 0
+
+
+def file_build_id(path):
+    """The build-id of an ELF file, reading only its headers and notes."""
+    with open(path, "rb") as f:
+        def read(off, n):
+            f.seek(off)
+            return f.read(n)
+
+        try:
+            return elf_build_id(read, False)
+        except struct.error:
+            return None
+
+
+def sym_files():
+    """Every library and symbol file below the symbol directories."""
+    for top in sym_dirs():
+        for d, subdirs, names in os.walk(top):
+            subdirs.sort()
+            for name in sorted(names):
+                path = os.path.join(d, name)
+                if (".so" in name or name.endswith(".sym")) and os.path.isfile(path):
+                    yield path
+
+
+class BuildIdIndex:
+    """build-id -> symbol file, over the symbol directories."""
+
+    def __init__(self):
+        self.ids = None
+
+    def scan(self):
+        try:
+            with open(CACHE) as f:
+                cache = json.load(f)
+        except (OSError, ValueError):
+            cache = {}
+        files, changed = {}, False
+        for path in sym_files():
+            st = os.stat(path)
+            key = [st.st_size, int(st.st_mtime)]
+            entry = cache.get(path)
+            if not entry or entry[:2] != key:
+                entry = key + [file_build_id(path)]
+                changed = True
+            files[path] = entry
+        if changed or len(files) != len(cache):
+            os.makedirs(os.path.dirname(CACHE), exist_ok=True)
+            with open(CACHE, "w") as f:
+                json.dump(files, f)
+        self.ids, self.names = {}, {}
+        # .sym files carry the debug info, so they win over the library.
+        for path, (_, _, bid) in sorted(files.items(), key=lambda x: x[0].endswith(".sym")):
+            if bid:
+                self.ids[bid] = path
+        for path in sorted(files, key=lambda p: not p.endswith(".sym")):
+            self.names.setdefault(os.path.basename(path).removesuffix(".sym"), path)
+
+    def find(self, bid, name):
+        if self.ids is None:
+            self.scan()
+        # Unreadable on the target: the first file by that name.
+        return self.ids.get(bid) or self.names.get(name)
+
+
+class Objects:
+    """The shared objects of the inferior and which have symbols."""
+
+    def __init__(self):
+        self.index = BuildIdIndex()
+        self.objs = []
+        self.loaded = set()
+        self.pid = None
+
+    def refresh(self):
+        inf = gdb.selected_inferior()
+        if inf.pid != self.pid:
+            self.pid, self.loaded = inf.pid, set()
+        out = gdb.execute("info meminfo", to_string=True)
+        self.objs, path = [], None
+        for line in out.splitlines():
+            if line.startswith("/"):
+                path = line.strip()
+                continue
+            m = re.search(r"text=([0-9a-fA-F]+) bytes @ (0x[0-9a-fA-F]+)", line)
+            if m and path:
+                self.objs.append((path, int(m.group(2), 16), int(m.group(1), 16)))
+                path = None
+        try:
+            exe = gdb.parameter("nto-executable")
+        except (gdb.error, RuntimeError):
+            exe = None
+        self.objs = [o for o in self.objs if o[0] != exe]
+
+    def containing(self, pc):
+        for obj in self.objs:
+            if obj[1] <= pc < obj[1] + obj[2]:
+                return obj
+        return None
+
+    def load(self, obj):
+        path, base, _ = obj
+        if path in self.loaded:
+            return False
+        self.loaded.add(path)
+        inf = gdb.selected_inferior()
+        try:
+            bid = elf_build_id(lambda o, n: bytes(inf.read_memory(base + o, n)), True)
+        except gdb.MemoryError:
+            bid = None
+        sym = self.index.find(bid, os.path.basename(path))
+        if not sym:
+            print(f"qnxsyms: no symbol file for {path}")
+            return False
+        addr = base + text_offset(sym)
+        confirm = gdb.parameter("confirm")
+        gdb.execute("set confirm off")
+        try:
+            gdb.execute(f"add-symbol-file {sym} {addr:#x}", to_string=True)
+        finally:
+            gdb.execute(f"set confirm {'on' if confirm else 'off'}")
+        print(f"qnxsyms: {os.path.basename(sym)} @ {addr:#x}")
+        return True
+
+
+objects = Objects()
+
+
+def no_symbols(pc):
+    return gdb.find_pc_line(pc).symtab is None and gdb.execute(
+        f"info symbol {pc:#x}", to_string=True
+    ).startswith("No symbol")
+
+
+def on_stop(event):
+    try:
+        frame, pcs = gdb.newest_frame(), []
+        while frame and len(pcs) < MAX_FRAMES:
+            pcs.append(frame.pc())
+            frame = frame.older()
+    except gdb.error:
+        return
+    pcs = [pc for pc in pcs if no_symbols(pc)]
+    if not pcs:
+        return
+    if not objects.objs or any(objects.containing(pc) is None for pc in pcs):
+        objects.refresh()
+    for pc in pcs:
+        obj = objects.containing(pc)
+        if obj:
+            objects.load(obj)
+
+
+class QnxSymbols(gdb.Command):
+    """Load the symbols of the shared objects whose name contains an argument, or of all of them."""
+
+    def __init__(self):
+        super().__init__("qnx-symbols", gdb.COMMAND_FILES)
+
+    def invoke(self, arg, from_tty):
+        objects.refresh()
+        names = arg.split()
+        n = 0
+        for obj in objects.objs:
+            if not names or any(x in os.path.basename(obj[0]) for x in names):
+                n += objects.load(obj)
+        print(f"qnxsyms: {n} symbol files added")
+
+
+QnxSymbols()
+gdb.events.stop.connect(on_stop)
@@ -21,7 +21,8 @@ int main(int argc, char **argv)
         fprintf(stderr, "img_load_file() (init) returned: %d\n", rc);
     }
 
-    if ((rc = img_load_file(ilib, "/mnt/poc1", NULL, &img)) != IMG_ERR_OK)
+    /* The input under test: batch_repro.py passes each one in turn. */
+    if ((rc = img_load_file(ilib, argc > 1 ? argv[1] : "/mnt/poc1", NULL, &img)) != IMG_ERR_OK)
     {
         fprintf(stderr, "img_load_file() (load) failed: %d\n", rc);
         perror("img_load_file");
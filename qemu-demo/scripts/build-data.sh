@@ -0,0 +1,20 @@
+#!/bin/bash
+
+DIR=$(realpath ${BASH_SOURCE%/*}/..)
+
+cd $DIR
+
+mkdir -p output data
+
+# Every file under data/ goes to the same path on the data disk, which
+# mount-data.sh mounts at /data in the guest. The marker tells it which
+# disk is this one.
+touch data/.qemu-demo-data
+(
+	echo "[perms=0755 dperms=0755]"
+	find data -type f | sort | while read -r f; do
+		echo "${f#data/}=$f"
+	done
+) >output/data.build
+
+mkqnx6fsimg ./output/data.build ./output/data.img
@@ -1,38 +1,51 @@
 #!/bin/env python3
+"""
+Usage: calc.py [VA [MEMFILE CR3 [SIZE]]]
+
+Print the page-table indices of VA. With the guest RAM file of
+start-qemu.sh --shm and a CR3, also translate VA to its physical address,
+and with SIZE, hex dump SIZE bytes from VA.
+"""
+import asyncio
 import sys
 
+from ptwalk import FileMemory, indices, translate
+
 
 def calculate_page_table_entry(virtual_address):
-    # 页表相关参数
-    page_size = 4096  # 页大小
-    page_table_size = 1 << 9  # 页表项数目
-    page_offset_bits = 12  # 页内偏移位数
-    level_1_bits = 9  # 一级页表位数
-    level_2_bits = 9  # 二级页表位数
-    level_3_bits = 9  # 三级页表位数
-
-    # 计算页表索引
-    offset = virtual_address & (page_size - 1)
-    level_1_index = (virtual_address >> page_offset_bits) & (page_table_size - 1)
-    level_2_index = (virtual_address >> (page_offset_bits + level_1_bits)) & (
-        page_table_size - 1
-    )
-    level_3_index = (
-        virtual_address >> (page_offset_bits + level_1_bits + level_2_bits)
-    ) & (page_table_size - 1)
-    level_4_index = (
-        virtual_address
-        >> (page_offset_bits + level_1_bits + level_2_bits + level_3_bits)
-    ) & (page_table_size - 1)
+    level_indices, offset = indices(virtual_address)
 
     # 打印结果
     print("Virtual Address: 0x{:X} 0b{:b}".format(virtual_address, virtual_address))
 
     print("Offset: 0x{:X}".format(offset))
-    print("Level 4 Index: 0x{:X}\tOffset: 0x{:X}".format(level_4_index, level_4_index << 3))
-    print("Level 3 Index: 0x{:X}\tOffset: 0x{:X}".format(level_3_index, level_3_index << 3))
-    print("Level 2 Index: 0x{:X}\tOffset: 0x{:X}".format(level_2_index, level_2_index << 3))
-    print("Level 1 Index: 0x{:X}\tOffset: 0x{:X}".format(level_1_index, level_1_index << 3))
+    for level, index in zip((4, 3, 2, 1), level_indices):
+        print("Level {} Index: 0x{:X}\tOffset: 0x{:X}".format(level, index, index << 3))
+
+
+async def dump(memfile, cr3, virtual_address, size):
+    mem = FileMemory(memfile)
+    _, pa = await translate(mem, cr3, virtual_address)
+    if pa is None:
+        print("Physical Address: not mapped")
+        return
+    print("Physical Address: 0x{:X}".format(pa))
+
+    # 逐页翻译, 读取物理内存
+    va, end, data = virtual_address, virtual_address + size, b""
+    while va < end:
+        _, pa = await translate(mem, cr3, va)
+        n = min(end, (va | 0xFFF) + 1) - va
+        if pa is None:
+            print("0x{:X}: not mapped".format(va))
+            break
+        data += await mem.read(pa, n)
+        va += n
+    for i in range(0, len(data), 16):
+        line = data[i : i + 16]
+        print("{:016X}: {}".format(virtual_address + i, line.hex(" ")))
+    mem.close()
+
 
 # 输入虚拟地址并计算页表项
 if len(sys.argv) > 1:
@@ -41,3 +54,7 @@ else:
     virtual_address = int(input("Input vaddr (HEX): "), 16)
 
 calculate_page_table_entry(virtual_address)
+
+if len(sys.argv) > 3:
+    size = int(sys.argv[4], 0) if len(sys.argv) > 4 else 0
+    asyncio.run(dump(sys.argv[2], int(sys.argv[3], 16), virtual_address, size))
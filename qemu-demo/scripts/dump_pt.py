@@ -3,104 +3,51 @@ from qemu.qmp import QMPClient
 import asyncio
 import re
 from argparse import ArgumentParser
+from ptwalk import FileMemory, QMPMemory, mappings, ranges, paging_levels, PTE_NX, PTE_RW, PTE_US
 
 debug = False
 
 
-def calculate_page_table_entry(virtual_address):
-    # 页表相关参数
-    page_size = 4096  # 页大小
-    page_table_size = 1 << 9  # 页表项数目
-    page_offset_bits = 12  # 页内偏移位数
-    level_1_bits = 9  # 一级页表位数
-    level_2_bits = 9  # 二级页表位数
-    level_3_bits = 9  # 三级页表位数
-
-    # 计算页表索引
-    level_1_index = (virtual_address >> page_offset_bits) & (page_table_size - 1)
-    level_2_index = (virtual_address >> (page_offset_bits + level_1_bits)) & (
-        page_table_size - 1
-    )
-    level_3_index = (
-        virtual_address >> (page_offset_bits + level_1_bits + level_2_bits)
-    ) & (page_table_size - 1)
-    level_4_index = (
-        virtual_address
-        >> (page_offset_bits + level_1_bits + level_2_bits + level_3_bits)
-    ) & (page_table_size - 1)
-
-    return (
-        level_4_index << 3,
-        level_3_index << 3,
-        level_2_index << 3,
-        level_1_index << 3,
-    )
-
-
-def get_data(resp: str):
-    d = resp.split(":")[1].strip()
-    d = int(d, 16)
-    return d, d & 0xFFFFFFFFFF000, (d & 0x8000000000000000) >> 63
-
-
-async def find_cr3(addr, start, end):
+async def find_cr3(addr, start, end, memfile=None, cr3=None, levels=4, merge=False):
     """
-    Find the virtual address of CR3 register through QEMU monitor.
+    Dump the page-table entries mapping [start, end) of the current CR3
+    through QEMU monitor, or of CR3 in the guest RAM file.
     """
 
-    qmp = QMPClient("")
-    await qmp.connect(addr)
-
-    # Get the virtual address of CR3 register
-    regs = await qmp.execute(
-        "human-monitor-command", {"command-line": "info registers"}
-    )
-    cr3 = re.search(r"CR3=([0-9a-fA-F]+)", str(regs)).group(1)
-    # from hex to int
-    cr3 = int(cr3, 16)
-    print("CR3: 0x{:x}".format(cr3))
-
-    for addr in range(start, end, 0x1000):
-        print("Virtual Address: 0x{:x}".format(addr), end=" | ")
-        i4, i3, i2, i1 = calculate_page_table_entry(addr)
-
-        # print("i4: 0x{:x}".format(i4), end=" ")
-        # print("i3: 0x{:x}".format(i3), end=" ")
-        # print("i2: 0x{:x}".format(i2), end=" ")
-        # print("i1: 0x{:x}".format(i1))
-
-        # Get 4-level page table
-        pte4 = await qmp.execute(
-            "human-monitor-command",
-            {"command-line": "xp/1gx 0x{:x}".format(cr3 + i4)},
-        )
-        pte4, pte4_a, pte4_nx = get_data(str(pte4))
-
-        # Get 3-level page table
-        pte3 = await qmp.execute(
-            "human-monitor-command",
-            {"command-line": "xp/1gx 0x{:x}".format(pte4_a + i3)},
-        )
-        pte3, pte3_a, pte3_nx = get_data(str(pte3))
+    if cr3 is None:
+        qmp = QMPClient("")
+        await qmp.connect(addr)
 
-        # Get 2-level page table
-        pte2 = await qmp.execute(
-            "human-monitor-command",
-            {"command-line": "xp/1gx 0x{:x}".format(pte3_a + i2)},
+        # Get the virtual address of CR3 register
+        regs = await qmp.execute(
+            "human-monitor-command", {"command-line": "info registers"}
         )
-        pte2, pte2_a, pte2_nx = get_data(str(pte2))
-
-        # Get 1-level page table
-        pte1 = await qmp.execute(
-            "human-monitor-command",
-            {"command-line": "xp/1gx 0x{:x}".format(pte2_a + i1)},
-        )
-        pte1, pte1_a, pte1_nx = get_data(str(pte1))
+        cr3 = re.search(r"CR3=([0-9a-fA-F]+)", str(regs)).group(1)
+        # from hex to int
+        cr3 = int(cr3, 16)
+        levels = paging_levels(regs)
+    print("CR3: 0x{:x}".format(cr3))
 
-        print("PTE4: 0x{:x} NX: {:x}".format(pte4, pte4_nx), end=" | ")
-        print("PTE3: 0x{:x} NX: {:x}".format(pte3, pte3_nx), end=" | ")
-        print("PTE2: 0x{:x} NX: {:x}".format(pte2, pte2_nx), end=" | ")
-        print("PTE1: 0x{:x} NX: {:x}".format(pte1, pte1_nx))
+    # Walk the tables locally, from the RAM file or one pmemsave per
+    # table page
+    mem = FileMemory(memfile) if memfile else QMPMemory(qmp)
+    try:
+        if merge:
+            async for va, pa, size, bits in ranges(mem, cr3, start, end, levels):
+                print("0x{:016x}-0x{:016x} -> 0x{:x} {}{}{}".format(
+                    va, va + size, pa, "w" if bits & PTE_RW else "-",
+                    "u" if bits & PTE_US else "-", "-" if bits & PTE_NX else "x"))
+            return
+        async for va, size, ptes, pa in mappings(mem, cr3, start, end, levels):
+            print("Virtual Address: 0x{:x}".format(va), end=" | ")
+            for level, pte in zip(range(levels, 0, -1), ptes):
+                nx = (pte & PTE_NX) >> 63
+                print("PTE{}: 0x{:x} NX: {:x}".format(level, pte, nx), end=" | ")
+            print("PA: 0x{:x} Size: 0x{:x}".format(pa, size))
+    finally:
+        mem.close()
+    if debug:
+        print("{} table pages read".format(mem.reads))
 
 
 if __name__ == "__main__":
@@ -117,10 +64,59 @@ if __name__ == "__main__":
     parser.add_argument(
         "-p", "--port", help="QEMU monitor port, default: 4444", default=4444, type=int
     )
+    parser.add_argument(
+        "-s",
+        "--start",
+        help="first virtual address, default: 0xFFFF800006589000",
+        default=0xFFFF800006589000,
+        type=lambda x: int(x, 16),
+    )
+    parser.add_argument(
+        "-e",
+        "--end",
+        help="end virtual address, default: 0xFFFF800006789000",
+        default=0xFFFF800006789000,
+        type=lambda x: int(x, 16),
+    )
+    parser.add_argument(
+        "-f",
+        "--memfile",
+        help="guest RAM file of start-qemu.sh --shm (see .mem)",
+    )
+    parser.add_argument(
+        "-c",
+        "--cr3",
+        help="walk this CR3 instead of the current one (needs -f, no monitor)",
+        type=lambda x: int(x, 16),
+    )
+    parser.add_argument(
+        "-5",
+        dest="levels",
+        action="store_const",
+        const=5,
+        default=4,
+        help="5-level paging, for -c (read from CR4 otherwise)",
+    )
+    parser.add_argument(
+        "-r",
+        "--ranges",
+        action="store_true",
+        help="print the contiguous VA to PA ranges instead of every entry",
+    )
     args = parser.parse_args()
+    if args.cr3 is not None and not args.memfile:
+        parser.error("-c needs -f")
 
     debug = args.debug
 
     asyncio.run(
-        find_cr3((args.host, args.port), 0xFFFF800006589000, 0xFFFF800006789000)
+        find_cr3(
+            (args.host, args.port),
+            args.start,
+            args.end,
+            args.memfile,
+            args.cr3,
+            args.levels,
+            args.ranges,
+        )
     )
@@ -3,6 +3,7 @@ from qemu.qmp import QMPClient
 import asyncio
 import re
 from argparse import ArgumentParser
+from ptwalk import QMPMemory, ranges, paging_levels, PTE_ADDR
 
 debug = False
 
@@ -26,31 +27,22 @@ async def find_cr3(addr):
 
     print(f"[x] CR3={hex(cr3)}")
 
-    mem = await qmp.execute("human-monitor-command", {"command-line": "info mem"})
-    # format: 0000000008045000-0000000008048000 0000000000003000 urw
-    # parse it
-    for line in str(mem).split("\n"):
-        if not line:
-            continue
-        mem, size, perm = line.split(" ")
-        start, end = mem.split("-")
-        start = int(start, 16)
-        end = int(end, 16)
-        size = int(size, 16)
-        pa = await qmp.execute(
-            "human-monitor-command",
-            {"command-line": f"gva2gpa {hex(start)}"},
-        )
-        pa = int(str(pa).split(" ")[1], 16)
-        if debug:
-            print(
-                f"[-] start={hex(start)} end={hex(end)} size={hex(size)} pa={hex(pa)} pa_end={hex(pa+size)} perm={perm.strip()}"
-            )
-
-        if pa <= cr3 <= pa + size:
-            print(f"CR3={hex(cr3)} is in {hex(start)}-{hex(end)}")
-            break
-    else:
+    # Walk every mapping locally, one pmemsave per table page, for the
+    # ranges that map the top-level table itself
+    mem = QMPMemory(qmp)
+    found = False
+    try:
+        async for va, pa, size, _ in ranges(mem, cr3, levels=paging_levels(regs)):
+            if debug:
+                print(f"[-] va={hex(va)} size={hex(size)} pa={hex(pa)}")
+            if pa <= cr3 & PTE_ADDR < pa + size:
+                print(f"CR3={hex(cr3)} is mapped at {hex(va + (cr3 & PTE_ADDR) - pa)}")
+                found = True
+    finally:
+        mem.close()
+    if debug:
+        print(f"[x] {mem.reads} table pages read")
+    if not found:
         print(f"CR3={hex(cr3)} is not in any memory region")
 
 
@@ -0,0 +1,11 @@
+#!/bin/bash
+DIR=$(realpath ${BASH_SOURCE%/*}/..)
+
+# (Re)mount the data disk of build-data.sh at /data in the guest, after
+# `make data` changed it.
+$DIR/scripts/connect.sh "umount /data 2>/dev/null; mkdir -p /data;" \
+	"for d in /dev/hd*; do" \
+	"  mount -r -t qnx6 \$d /data 2>/dev/null || continue;" \
+	"  [ -e /data/.qemu-demo-data ] && exit 0;" \
+	"  umount /data;" \
+	"done; echo no data disk >&2; exit 1"
@@ -0,0 +1,251 @@
+#!/usr/bin/env python3
+"""
+A pool of QNX VMs for reproducing crashes in parallel.
+
+Usage: pool.py up -n N [-c CPUS] [-m MEM] [--no-kvm]
+       pool.py run [-u FILE]... [-t SECS] -e CMD INPUT...
+       pool.py status
+       pool.py down
+
+`up` starts N VMs in the background, each from output/system.ifs with
+its own state dir output/pool/<i>: ssh, QMP and gdb ports picked free
+on 127.0.0.1, a qcow2 overlay of output/ifs.img (when `make disk` built
+it) so that no VM writes the shared image, output/data.img of `make
+data` read-only, and CPUS host CPUs of its own (VM i gets CPUs i*CPUS
+to i*CPUS+CPUS-1) with taskset. It returns once every VM answers ssh.
+
+`run` copies the -u FILEs to /tmp on every VM, then hands the INPUTs out
+from one queue to whichever VM is free. Each input is written to
+/tmp/pool-in/ by the same ssh session that then runs CMD, with `{}`
+replaced by its path there. One line is printed per input: its exit
+status, or the signal it died of.
+An input whose VM stops answering is given to another one.
+
+connect.sh, scp-to.sh and scp-from.sh take the port of VM i with
+PORT=$(cat output/pool/<i>/port).
+"""
+import os
+import queue
+import signal
+import socket
+import subprocess
+import sys
+import threading
+import time
+from argparse import ArgumentParser
+
+DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+POOL = os.path.join(DIR, "output", "pool")
+
+# ssh's own exit status when it could not connect or lost the session
+SSH_ERROR = 255
+
+
+def free_port():
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+def instances():
+    """The state dirs of the running VMs, in order."""
+    if not os.path.isdir(POOL):
+        return []
+    dirs = [os.path.join(POOL, d) for d in os.listdir(POOL) if d.isdigit()]
+    return sorted(dirs, key=lambda d: int(os.path.basename(d)))
+
+
+def read(vm, name):
+    with open(os.path.join(vm, name)) as f:
+        return f.read().strip()
+
+
+def alive(vm):
+    try:
+        os.kill(int(read(vm, "pid")), 0)
+        return True
+    except (OSError, ValueError):
+        return False
+
+
+def ssh(vm, cmd, timeout=None, stdin=None):
+    env = dict(os.environ, PORT=read(vm, "port"))
+    try:
+        with open(stdin or os.devnull, "rb") as f:
+            return subprocess.run(
+                [f"{DIR}/scripts/connect.sh", cmd],
+                env=env,
+                stdin=f,
+                stdout=subprocess.DEVNULL,
+                stderr=subprocess.DEVNULL,
+                timeout=timeout,
+            ).returncode
+    except subprocess.TimeoutExpired:
+        return None
+
+
+def scp_to(vm, *paths):
+    """Copy paths to the last of them in the guest, in one transfer."""
+    env = dict(os.environ, PORT=read(vm, "port"))
+    return subprocess.run(
+        [f"{DIR}/scripts/scp-to.sh", *paths],
+        env=env,
+        stdout=subprocess.DEVNULL,
+        stderr=subprocess.DEVNULL,
+    ).returncode
+
+
+def up(args):
+    if any(alive(vm) for vm in instances()):
+        sys.exit("the pool is already up; run pool.py down first")
+    ncpu = os.cpu_count()
+    if args.n * args.cpus > ncpu:
+        print(f"warning: {args.n} VMs x {args.cpus} CPUs > {ncpu} CPUs", file=sys.stderr)
+    disk = os.path.join(DIR, "output", "ifs.img")
+    data = os.path.join(DIR, "output", "data.img")
+
+    vms = []
+    for i in range(args.n):
+        vm = os.path.join(POOL, str(i))
+        os.makedirs(vm, exist_ok=True)
+        port, qmp, gdb = free_port(), free_port(), free_port()
+        cpus = ",".join(str((i * args.cpus + c) % ncpu) for c in range(args.cpus))
+        cmd = ["taskset", "-c", cpus, "qemu-system-x86_64",
+               "-m", args.mem, "-smp", str(args.cpus),
+               "-kernel", os.path.join(DIR, "output", "system.ifs"),
+               "-nic", f"user,model=e1000,hostfwd=tcp:127.0.0.1:{port}-:22",
+               "-qmp", f"tcp:127.0.0.1:{qmp},server=on,wait=off",
+               "-gdb", f"tcp:127.0.0.1:{gdb}",
+               "-display", "none", "-serial", f"file:{vm}/console.log",
+               "-daemonize", "-pidfile", f"{vm}/pid"]
+        if not args.no_kvm:
+            cmd += ["-enable-kvm", "-cpu", "host"]
+        if os.path.isfile(disk):
+            overlay = os.path.join(vm, "disk.qcow2")
+            subprocess.run(["qemu-img", "create", "-q", "-f", "qcow2", "-F", "raw",
+                            "-b", disk, overlay], check=True)
+            cmd += ["-drive", f"file={overlay},format=qcow2,if=ide"]
+        if os.path.isfile(data):
+            cmd += ["-drive", f"file={data},format=raw,if=ide,index=1,readonly=on"]
+        for name, value in (("port", port), ("qmp", qmp), ("gdb", gdb), ("cpus", cpus)):
+            with open(os.path.join(vm, name), "w") as f:
+                f.write(f"{value}\n")
+        if subprocess.run(cmd).returncode:
+            sys.exit(f"VM {i} did not start, see {vm}/console.log")
+        vms.append(vm)
+
+    end = time.monotonic() + args.boot_timeout
+    pending = list(vms)
+    while pending and time.monotonic() < end:
+        pending = [vm for vm in pending if ssh(vm, "true", timeout=10) != 0]
+        if pending:
+            time.sleep(1)
+    for vm in vms:
+        state = "down" if vm in pending else "up"
+        print(f"vm {os.path.basename(vm)}: {state} ssh={read(vm, 'port')} "
+              f"qmp={read(vm, 'qmp')} gdb={read(vm, 'gdb')} cpus={read(vm, 'cpus')}")
+    return 1 if pending else 0
+
+
+def down(args):
+    for vm in instances():
+        if alive(vm):
+            os.kill(int(read(vm, "pid")), signal.SIGTERM)
+        for name in os.listdir(vm):
+            os.unlink(os.path.join(vm, name))
+        os.rmdir(vm)
+    return 0
+
+
+def status(args):
+    for vm in instances():
+        state = "up" if alive(vm) else "dead"
+        print(f"vm {os.path.basename(vm)}: {state} ssh={read(vm, 'port')} "
+              f"qmp={read(vm, 'qmp')} cpus={read(vm, 'cpus')}")
+    return 0
+
+
+def run(args):
+    vms = [vm for vm in instances() if alive(vm)]
+    if not vms:
+        sys.exit("no VM is up; run pool.py up first")
+
+    jobs = queue.Queue()
+    for path in args.inputs:
+        jobs.put(path)
+    lock = threading.Lock()
+    results = {}
+
+    def worker(vm):
+        name = os.path.basename(vm)
+        if ssh(vm, "mkdir -p /tmp/pool-in") != 0 or (
+            args.upload and scp_to(vm, *args.upload, "/tmp/")
+        ):
+            print(f"vm {name}: setup failed", file=sys.stderr)
+            return
+        while True:
+            try:
+                path = jobs.get_nowait()
+            except queue.Empty:
+                return
+            dest = "/tmp/pool-in/" + os.path.basename(path)
+            # The input goes over the same session as the command.
+            cmd = args.exec.replace("{}", dest)
+            rc = ssh(vm, f"cat > {dest} && {{ {cmd}; }} < /dev/null; rc=$?; rm -f {dest}; exit $rc",
+                     timeout=args.timeout, stdin=path)
+            if rc == SSH_ERROR or (rc is None and not alive(vm)):
+                # The VM is gone: another one takes the input.
+                print(f"vm {name}: lost, requeueing {path}", file=sys.stderr)
+                jobs.put(path)
+                return
+            if rc is None:
+                result = "hang"
+            elif rc > 128:
+                result = f"signal {rc - 128}"
+            else:
+                result = f"exit {rc}"
+            with lock:
+                results[path] = result
+                print(f"{path}: {result} (vm {name})", flush=True)
+
+    t = time.monotonic()
+    threads = [threading.Thread(target=worker, args=(vm,)) for vm in vms]
+    for th in threads:
+        th.start()
+    for th in threads:
+        th.join()
+    t = time.monotonic() - t
+
+    lost = jobs.qsize()
+    crashes = sum(r.startswith("signal") for r in results.values())
+    hangs = sum(r == "hang" for r in results.values())
+    print(f"[x] {len(results)} inputs on {len(vms)} VMs in {t:.1f}s, {crashes} crashed, "
+          f"{hangs} hung" + (f", {lost} not run" if lost else ""))
+    return 1 if crashes or hangs or lost else 0
+
+
+if __name__ == "__main__":
+    parser = ArgumentParser(description="A pool of QNX VMs for parallel crash reproduction")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+    p = sub.add_parser("up", help="start the VMs")
+    p.add_argument("-n", type=int, required=True, help="number of VMs")
+    p.add_argument("-c", "--cpus", type=int, default=1, help="host CPUs per VM, default: 1")
+    p.add_argument("-m", "--mem", default="1G", help="RAM per VM, default: 1G")
+    p.add_argument("--no-kvm", action="store_true", help="use TCG")
+    p.add_argument("--boot-timeout", type=int, default=120,
+                   help="seconds to wait for ssh, default: 120")
+    p.set_defaults(func=up)
+    p = sub.add_parser("run", help="run a command on every input")
+    p.add_argument("-u", "--upload", action="append", default=[],
+                   help="copy this file to /tmp on every VM first")
+    p.add_argument("-e", "--exec", required=True, help="command, {} is the input")
+    p.add_argument("-t", "--timeout", type=float, default=30,
+                   help="seconds before an input counts as a hang, default: 30")
+    p.add_argument("inputs", nargs="+", help="input files")
+    p.set_defaults(func=run)
+    p = sub.add_parser("status", help="list the VMs")
+    p.set_defaults(func=status)
+    p = sub.add_parser("down", help="stop the VMs")
+    p.set_defaults(func=down)
+    args = parser.parse_args()
+    sys.exit(args.func(args))
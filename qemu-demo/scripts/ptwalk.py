@@ -0,0 +1,217 @@
+#!/usr/bin/env python3
+"""
+x86_64 page-table walker over guest physical memory, 4-level or, with
+levels=5 (CR4.LA57), 5-level.
+
+Each page-table page is fetched once with QMP `pmemsave` (512 entries per
+round trip instead of one `xp/1gx` per entry) and cached by its physical
+address, so walking a range touches each table page a single time. The
+file pmemsave writes is created by QEMU, so the script must run on the
+QEMU host.
+
+When QEMU runs with `start-qemu.sh --shm`, FileMemory instead maps the
+guest RAM file and reads tables and data straight from it, with no
+monitor round trip at all.
+
+mappings() yields every leaf, 1G and 2M pages included; ranges() merges
+them into runs contiguous in both address spaces with the same access,
+the compact VA to PA map of a whole address space in one pass.
+"""
+import mmap
+import os
+import re
+import struct
+import tempfile
+
+PAGE_SIZE = 0x1000
+ENTRIES = 512
+
+PTE_P = 1 << 0
+PTE_RW = 1 << 1
+PTE_US = 1 << 2
+PTE_PS = 1 << 7
+PTE_NX = 1 << 63
+PTE_ADDR = 0xFFFFFFFFFF000
+
+# RAM below 4G with `max-ram-below-4g=3G`; the rest is at 4G and up
+LOWMEM = 0xC0000000
+HIGHMEM = 1 << 32
+
+# Bytes mapped by one entry at each level, PML4 first; 5-level paging
+# adds the PML5 in front
+LEVEL_SIZE = (1 << 39, 1 << 30, 1 << 21, 1 << 12)
+VA_MASK = (1 << 48) - 1
+# Levels whose entries map a page themselves when PS is set
+LARGE = (1 << 30, 1 << 21)
+CR4_LA57 = 1 << 12
+
+
+def paging_levels(regs):
+    """4 or 5, from the CR4 in `info registers` output."""
+    cr4 = re.search(r"CR4=([0-9a-fA-F]+)", str(regs))
+    return 5 if cr4 and int(cr4.group(1), 16) & CR4_LA57 else 4
+
+
+def level_sizes(levels=4):
+    return LEVEL_SIZE if levels == 4 else (1 << 48,) + LEVEL_SIZE
+
+
+def va_bits(levels=4):
+    return 12 + 9 * levels
+
+
+def sign_extend(va, levels=4):
+    """Canonical form of a 48-bit (57-bit with 5 levels) virtual address."""
+    top = 1 << va_bits(levels) - 1
+    return va | ~(2 * top - 1) & (1 << 64) - 1 if va & top else va
+
+
+def indices(va, levels=4):
+    """The table index of va at each level, top first, and the offset in
+    its 4K page."""
+    return [(va // size) % ENTRIES for size in level_sizes(levels)], va & PAGE_SIZE - 1
+
+
+def is_leaf(pte, size):
+    return size == PAGE_SIZE or size in LARGE and pte & PTE_PS
+
+
+def access(ptes):
+    """PTE_RW and PTE_US if every level grants them, and PTE_NX if any
+    level sets it."""
+    bits = PTE_RW | PTE_US
+    for pte in ptes:
+        bits &= pte | ~(PTE_RW | PTE_US)
+    return bits | (PTE_NX if any(pte & PTE_NX for pte in ptes) else 0)
+
+
+class QMPMemory:
+    """Guest physical pages read through QMP pmemsave."""
+
+    def __init__(self, qmp):
+        self.qmp = qmp
+        self.cache = {}
+        self.reads = 0
+        fd, self.path = tempfile.mkstemp(prefix="ptwalk-")
+        os.close(fd)
+        os.chmod(self.path, 0o666)
+
+    async def read(self, pa, size):
+        await self.qmp.execute(
+            "pmemsave", {"val": pa, "size": size, "filename": self.path}
+        )
+        self.reads += 1
+        with open(self.path, "rb") as f:
+            return f.read()
+
+    async def table(self, pa):
+        """The 512 entries of the page-table page at pa."""
+        pa &= PTE_ADDR
+        t = self.cache.get(pa)
+        if t is None:
+            t = struct.unpack(f"<{ENTRIES}Q", await self.read(pa, PAGE_SIZE))
+            self.cache[pa] = t
+        return t
+
+    def close(self):
+        os.unlink(self.path)
+
+
+class FileMemory:
+    """Guest physical memory mapped from its memory-backend-file."""
+
+    def __init__(self, path, lowmem=LOWMEM, writable=False):
+        self.lowmem = lowmem
+        self.reads = 0
+        prot = mmap.PROT_READ | (mmap.PROT_WRITE if writable else 0)
+        with open(path, "r+b" if writable else "rb") as f:
+            self.map = mmap.mmap(f.fileno(), 0, prot=prot)
+
+    def offset(self, pa):
+        if pa < self.lowmem:
+            return pa
+        if pa >= HIGHMEM:
+            return pa - HIGHMEM + self.lowmem
+        raise ValueError(f"{hex(pa)} is in the PCI hole")
+
+    async def read(self, pa, size):
+        off = self.offset(pa)
+        if off + size > len(self.map):
+            raise ValueError(f"{hex(pa)} is past the end of RAM")
+        return self.map[off : off + size]
+
+    async def table(self, pa):
+        self.reads += 1
+        off = self.offset(pa & PTE_ADDR)
+        return struct.unpack_from(f"<{ENTRIES}Q", self.map, off)
+
+    def close(self):
+        self.map.close()
+
+
+async def translate(mem, cr3, va, levels=4):
+    """
+    Walk the tables for va. Returns the entries walked, top level first,
+    and the physical address, or None if va is not mapped.
+    """
+    table, ptes = cr3 & PTE_ADDR, []
+    for size in level_sizes(levels):
+        pte = (await mem.table(table))[(va // size) % ENTRIES]
+        ptes.append(pte)
+        if not pte & PTE_P:
+            return ptes, None
+        if is_leaf(pte, size):
+            base = pte & PTE_ADDR & ~(size - 1)
+            return ptes, base | (va & (size - 1))
+        table = pte & PTE_ADDR
+    return ptes, None
+
+
+async def mappings(mem, cr3, start=0, end=None, levels=4):
+    """
+    Yield (va, size, ptes, pa) for every present leaf overlapping
+    [start, end), in table order. Non-present subtrees are skipped whole,
+    and each table page is read once.
+    """
+    sizes, mask = level_sizes(levels), (1 << va_bits(levels)) - 1
+    start = start & mask
+    end = mask + 1 if end is None else ((end - 1) & mask) + 1
+
+    async def walk(table, level, base, ptes):
+        size = sizes[level]
+        entries = await mem.table(table)
+        first = max(0, (start - base) // size)
+        last = min(ENTRIES, (end - base + size - 1) // size)
+        for i in range(first, last):
+            pte = entries[i]
+            if not pte & PTE_P:
+                continue
+            va = base + i * size
+            if is_leaf(pte, size):
+                yield (sign_extend(va, levels), size, ptes + [pte],
+                       pte & PTE_ADDR & ~(size - 1))
+            else:
+                async for m in walk(pte & PTE_ADDR, level + 1, va, ptes + [pte]):
+                    yield m
+
+    async for m in walk(cr3 & PTE_ADDR, 0, 0, []):
+        yield m
+
+
+async def ranges(mem, cr3, start=0, end=None, levels=4):
+    """
+    Yield (va, pa, size, access) for the runs of [start, end) that are
+    contiguous in both virtual and physical memory and have the same
+    access() bits, in address order.
+    """
+    run = None
+    async for va, size, ptes, pa in mappings(mem, cr3, start, end, levels):
+        bits = access(ptes)
+        if run and run[0] + run[2] == va and run[1] + run[2] == pa and run[3] == bits:
+            run[2] += size
+            continue
+        if run:
+            yield tuple(run)
+        run = [va, pa, size, bits]
+    if run:
+        yield tuple(run)
@@ -4,4 +4,4 @@ cd $DIR
 
 [ -z $2 ] && set -- "$1" "./"
 
-scp -o StrictHostKeyChecking=no -o UserKnownHostsFile=/dev/null -i ./ssh/client.rsa -P $(cat .port) root@127.0.0.1:"$1" "$2"
+scp -F ./scripts/ssh_config -i ./ssh/client.rsa -P ${PORT:-$(cat .port)} qemu-demo:"$1" "$2"
@@ -1,6 +1,8 @@
 #!/bin/bash
 DIR=$(realpath ${BASH_SOURCE%/*}/..)
 
-[ -z $1 ] && set -- "$1" "/mnt/"
+# scp-to.sh FILE [DEST], or FILE... DEST: all files in one transfer.
+[ -z "$2" ] && set -- "$1" "/mnt/"
+dest=${!#}
 
-scp -o StrictHostKeyChecking=no -o UserKnownHostsFile=/dev/null -i ${DIR}/ssh/client.rsa -P $(cat ${DIR}/.port) "$1" root@127.0.0.1:"$2"
+scp -F ${DIR}/scripts/ssh_config -i ${DIR}/ssh/client.rsa -P ${PORT:-$(cat ${DIR}/.port)} "${@:1:$#-1}" qemu-demo:"$dest"
@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+"""
+Rerun fuzzing inputs on QNX in a KVM snapshot of the VM.
+
+Usage: snap_repro.py [-H HOST] [-p PORT] [-f MEMFILE] [-b HARNESS]
+                     [-s NAME] [-t MS] [-r] INPUT...
+
+Start the VM with `start-qemu.sh --snap` first. The harness
+(img-test/snap-repro, built by img-test/build.sh) is copied to the VM
+and started over ssh; it attaches libimg and waits on a mailbox in
+physically contiguous memory, at the address it prints. The VM is then
+saved with savevm, right before the decode loop. Each INPUT is written
+into the mailbox through the guest RAM file, and the outcome is read
+back from it: the img_load return, the signal of a crash, or a hang
+after -t milliseconds. After a crash or a hang, or before every input
+with -r, the snapshot is restored with loadvm, so that every input runs
+on the same, fresh process. Exits 1 if an input crashed or hung.
+"""
+import asyncio
+import os
+import struct
+import subprocess
+import sys
+import time
+from argparse import ArgumentParser
+
+from qemu.qmp import QMPClient
+from ptwalk import FileMemory
+
+DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# struct snap_mailbox in img-test/snap_repro.c
+SNAP_MAGIC = 0x50414E53
+SNAP_MAX_INPUT = 1 << 20
+SNAP_READY, SNAP_GO, SNAP_DONE, SNAP_CRASH = 1, 2, 3, 4
+OFF_STATE, OFF_LEN, OFF_RESULT, OFF_DATA = 4, 8, 12, 16
+
+
+async def hmp(qmp, cmd):
+    out = str(await qmp.execute("human-monitor-command", {"command-line": cmd}))
+    if "Error" in out:
+        sys.exit(f"{cmd}: {out.strip()}")
+    return out
+
+
+def start_harness(harness):
+    """Start the harness on QNX; its ssh session and mailbox address."""
+    subprocess.run(
+        [f"{DIR}/scripts/scp-to.sh", harness, "/tmp/"],
+        check=True,
+        stdout=subprocess.DEVNULL,
+    )
+    name = os.path.basename(harness)
+    ssh = subprocess.Popen(
+        [f"{DIR}/scripts/connect.sh", f"/tmp/{name}"],
+        stdout=subprocess.PIPE,
+        text=True,
+    )
+    line = ssh.stdout.readline()
+    if "mailbox" not in line:
+        ssh.kill()
+        sys.exit(f"{name}: did not start")
+    return ssh, int(line.split()[2], 16)
+
+
+def wait_state(mem, mb, states, timeout):
+    """The mailbox state once it is in states, or None after timeout."""
+    end = time.monotonic() + timeout
+    while True:
+        magic, state = struct.unpack("<II", mem.map[mb : mb + 8])
+        if magic == SNAP_MAGIC and state in states:
+            return state
+        if time.monotonic() > end:
+            return None
+        time.sleep(0.0001)
+
+
+async def repro(addr, memfile, harness, snap, timeout, restore_all, inputs):
+    qmp = QMPClient("")
+    await qmp.connect(addr)
+    mem = FileMemory(memfile, writable=True)
+
+    ssh, pa = start_harness(harness)
+    mb = mem.offset(pa)
+    print(f"[x] mailbox at {hex(pa)}")
+    if wait_state(mem, mb, (SNAP_READY,), 30) is None:
+        sys.exit("harness never became ready")
+
+    await qmp.execute("stop")
+    await hmp(qmp, f"savevm {snap}")
+    print(f"[x] saved {snap}")
+
+    # The VM stays stopped in the snapshot until the first input is in.
+    crashes, hangs, restore, stopped = [], [], False, True
+    t = time.monotonic()
+    for path in inputs:
+        with open(path, "rb") as f:
+            data = f.read(SNAP_MAX_INPUT)
+        if (restore or restore_all) and not stopped:
+            await qmp.execute("stop")
+            await hmp(qmp, f"loadvm {snap}")
+            stopped = True
+        mem.map[mb + OFF_DATA : mb + OFF_DATA + len(data)] = data
+        struct.pack_into("<I", mem.map, mb + OFF_LEN, len(data))
+        struct.pack_into("<I", mem.map, mb + OFF_STATE, SNAP_GO)
+        if stopped:
+            await qmp.execute("cont")
+            stopped = False
+
+        state = wait_state(mem, mb, (SNAP_DONE, SNAP_CRASH), timeout / 1000)
+        result, = struct.unpack_from("<i", mem.map, mb + OFF_RESULT)
+        restore = state != SNAP_DONE
+        if state == SNAP_DONE:
+            print(f"{path}: ok rc={result}")
+        elif state == SNAP_CRASH:
+            print(f"{path}: crash signal {result}")
+            crashes.append(path)
+        else:
+            print(f"{path}: hang")
+            hangs.append(path)
+    t = time.monotonic() - t
+
+    ssh.kill()
+    mem.close()
+    print(
+        f"[x] {len(inputs)} inputs, {len(crashes)} crashes, {len(hangs)} hangs,"
+        f" {len(inputs) / t:.1f} execs/sec"
+    )
+    return 1 if crashes or hangs else 0
+
+
+if __name__ == "__main__":
+    parser = ArgumentParser(description="Rerun inputs on QNX from a KVM snapshot")
+    parser.add_argument(
+        "-H",
+        "--host",
+        help="QEMU monitor host, default: 127.0.0.1",
+        default="127.0.0.1",
+    )
+    parser.add_argument(
+        "-p", "--port", help="QEMU monitor port, default: 4444", default=4444, type=int
+    )
+    parser.add_argument(
+        "-f", "--memfile", help="guest RAM file, default: the one in .mem"
+    )
+    parser.add_argument(
+        "-b",
+        "--harness",
+        help="QNX harness, default: ../img-test/snap-repro",
+        default=os.path.join(DIR, "..", "img-test", "snap-repro"),
+    )
+    parser.add_argument(
+        "-s", "--snapshot", help="snapshot name, default: repro", default="repro"
+    )
+    parser.add_argument(
+        "-t",
+        "--timeout",
+        help="hang timeout in ms, default: 1000",
+        default=1000,
+        type=int,
+    )
+    parser.add_argument(
+        "-r",
+        "--restore-all",
+        action="store_true",
+        help="restore the snapshot before every input, not only after crashes",
+    )
+    parser.add_argument("inputs", nargs="+", help="input files")
+    args = parser.parse_args()
+
+    if not args.memfile:
+        try:
+            with open(os.path.join(DIR, ".mem")) as f:
+                args.memfile = f.read().strip()
+        except OSError:
+            parser.error("no .mem: start the VM with start-qemu.sh --snap or pass -f")
+
+    sys.exit(
+        asyncio.run(
+            repro(
+                (args.host, args.port),
+                args.memfile,
+                args.harness,
+                args.snapshot,
+                args.timeout,
+                args.restore_all,
+                args.inputs,
+            )
+        )
+    )
@@ -8,14 +8,48 @@ port=$(($RANDOM % 30000 + 30000))
 
 echo $port >.port
 
+# --shm: back the guest RAM with a shared file in /dev/shm, so that the
+# scripts can mmap guest physical memory (see scripts/ptwalk.py). RAM
+# below 4G is fixed at 3G; the rest of it is mapped from 4G up.
+# --snap: --shm with 512M of RAM, KVM, a QMP socket on 127.0.0.1:4444
+# and output/snap.qcow2 to hold the snapshots of scripts/snap_repro.py.
+size=4G
+mem=()
+while [[ $1 == --shm || $1 == --snap ]]; do
+	if [[ $1 == --snap ]]; then
+		size=512M
+		[[ -f output/snap.qcow2 ]] || qemu-img create -q -f qcow2 output/snap.qcow2 16M
+		mem+=(-enable-kvm -cpu host
+			-drive if=none,id=snap,format=qcow2,file=output/snap.qcow2
+			-qmp tcp:127.0.0.1:4444,server=on,wait=off)
+	fi
+	shift
+	memfile=/dev/shm/qemu-demo-$port
+done
+
+if [[ -n $memfile ]]; then
+	echo $memfile >.mem
+	mem+=(-object memory-backend-file,id=pc.ram,size=$size,mem-path=$memfile,share=on
+		-machine pc,memory-backend=pc.ram,max-ram-below-4g=3G)
+fi
+
+# The data disk of `make data`, mounted by scripts/mount-data.sh.
+if [[ -f output/data.img ]]; then
+	mem+=(-drive file=output/data.img,format=raw,if=ide,index=1)
+fi
+
 qemu-system-x86_64 \
-	-m 4G \
+	-m $size \
+	"${mem[@]}" \
 	-kernel ./output/system.ifs \
 	-nic user,model=e1000,hostfwd=tcp::$port-:22,hostfwd=tcp::6666-:6666 \
 	-s -nographic \
 	$*
 
 rm .port
+if [[ -n $memfile ]]; then
+	rm -f .mem $memfile
+fi
 
 # -d exec,nochain -D /tmp/qemu-log \
 # -rtc clock=vm -icount shift=1,align=off \
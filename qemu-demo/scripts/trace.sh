@@ -0,0 +1,52 @@
+#!/bin/bash
+#
+print_help() {
+	echo "Usage: $0 [-h] [-s SECS] [-o FILE] -- COMMAND..."
+	echo "   -h: print this help message"
+	echo "   -s: seconds tracelogger records for (default 5), COMMAND"
+	echo "       is started once it runs"
+	echo "   -o: where the traceprinter output goes on the host"
+	echo "       (default output/trace.txt)"
+	echo "Runs COMMAND in the guest under kernel event tracing (the IFS"
+	echo "must boot procnto-smp-instr) and summarizes its events with"
+	echo "tracesum.py."
+}
+
+DIR=$(realpath ${BASH_SOURCE%/*}/..)
+SECS=5
+OUT=$DIR/output/trace.txt
+
+while getopts "hs:o:" opt; do
+	case $opt in
+	h)
+		print_help
+		exit 0
+		;;
+	s)
+		SECS=$OPTARG
+		;;
+	o)
+		OUT=$OPTARG
+		;;
+	\?)
+		print_help
+		exit 1
+		;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -eq 0 ]; then
+	print_help
+	exit 1
+fi
+
+mkdir -p $(dirname $OUT)
+# tracelogger writes to the guest's /tmp; only the decoded text comes
+# back, over the ssh session that ran it.
+$DIR/scripts/connect.sh "rm -f /tmp/trace.kev;" \
+	"tracelogger -w -s $SECS -f /tmp/trace.kev > /dev/null 2>&1 & sleep 1;" \
+	"$* > /dev/null 2>&1; wait;" \
+	"traceprinter -f /tmp/trace.kev; rm -f /tmp/trace.kev" >$OUT || exit 1
+
+python3 $DIR/scripts/tracesum.py -p $(basename $1) $OUT
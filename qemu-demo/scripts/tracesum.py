@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""
+Summarize a QNX kernel event trace for one process.
+
+Usage: tracesum.py [-p NAME] [-n N] [-j] [FILE]
+
+FILE (default stdin) is the traceprinter output of a tracelogger run
+on procnto-smp-instr, as trace.sh fetches it. The process is found by
+the name of its PROCCREATE_NAME event (-p, a suffix of the path), and
+its events by the thread running on each CPU. For it, kernel calls are
+printed most total time first as "calls total_ms mean_us name", the
+time of a call being from its KER_CALL to its KER_EXIT on the same CPU,
+then the message passing events by kind and the page faults, to set
+against what qol/shimstats.py counts for the same program under QOL.
+-j prints the summary as JSON instead.
+"""
+import json
+import re
+import sys
+from argparse import ArgumentParser
+
+EVENT = re.compile(r"^t:(0x[0-9a-fA-F]+)\s+CPU:\s*(\d+)\s+(\S+)\s*:\s*(\S+)\s*(.*)$")
+FIELD = re.compile(r"(\w+):(\S+)")
+
+
+def events(lines, header):
+    """(t, cpu, class, event, fields) of each event; fields may continue
+    on the indented lines after it."""
+    cur = None
+    for line in lines:
+        m = EVENT.match(line)
+        if m:
+            if cur:
+                yield cur
+            cur = (int(m.group(1), 16), int(m.group(2)), m.group(3), m.group(4),
+                   dict(FIELD.findall(m.group(5))))
+        elif cur and line[:1].isspace():
+            cur[4].update(FIELD.findall(line))
+        elif "::" in line:
+            key, _, value = line.partition("::")
+            header[key.strip()] = value.strip()
+    if cur:
+        yield cur
+
+
+def summarize(lines, name):
+    header = {}
+    pids, running = {}, {}
+    target = None
+    calls, pending = {}, {}
+    comm, faults, other = {}, 0, 0
+    for t, cpu, cls, ev, fields in events(lines, header):
+        if cls == "PROCESS" and ev == "PROCCREATE_NAME" and "pid" in fields:
+            path = fields.get("name", "")
+            pids[int(fields["pid"])] = path
+            if name and path.endswith(name) and target is None:
+                target = int(fields["pid"])
+            continue
+        if cls == "THREAD" and ev == "THRUNNING" and "pid" in fields:
+            running[cpu] = int(fields["pid"])
+            continue
+        pid = running.get(cpu)
+        if pid is None or (target is not None and pid != target) or (target is None and name):
+            continue
+        if cls == "KER_CALL":
+            pending[cpu] = (ev.split("/")[0], t)
+        elif cls == "KER_EXIT":
+            call, start = pending.pop(cpu, (ev.split("/")[0], None))
+            c = calls.setdefault(call, [0, 0])
+            c[0] += 1
+            if start is not None:
+                c[1] += t - start
+        elif cls == "COMM":
+            comm[ev] = comm.get(ev, 0) + 1
+        elif "FAULT" in cls or "FAULT" in ev:
+            faults += 1
+        else:
+            other += 1
+    try:
+        cycles = int(header.get("TRACE_CYCLES_PER_SEC", "").split()[0])
+    except (IndexError, ValueError):
+        cycles = None
+    scale = 1e6 / cycles if cycles else None
+    return {
+        "pid": target,
+        "name": pids.get(target, name),
+        "cycles_per_sec": cycles,
+        "kernel_calls": {
+            k: {"calls": n, "us": round(c * scale, 3) if scale else None}
+            for k, (n, c) in sorted(calls.items(), key=lambda x: -x[1][1])
+        },
+        "messages": dict(sorted(comm.items(), key=lambda x: -x[1])),
+        "page_faults": faults,
+        "other_events": other,
+    }
+
+
+def main():
+    parser = ArgumentParser(description="Summarize a QNX kernel trace for one process")
+    parser.add_argument("-p", "--process", help="process name (suffix of its path)")
+    parser.add_argument("-n", type=int, default=30, help="kernel calls to print, default: 30")
+    parser.add_argument("-j", "--json", action="store_true", help="print JSON")
+    parser.add_argument("file", nargs="?", help="traceprinter output, default: stdin")
+    args = parser.parse_args()
+
+    f = open(args.file, errors="replace") if args.file else sys.stdin
+    s = summarize(f, args.process)
+    if args.process and s["pid"] is None:
+        sys.exit(f"{args.process}: no PROCCREATE_NAME event in the trace")
+    if args.json:
+        json.dump(s, sys.stdout, indent=1)
+        print()
+        return 0
+
+    print(f"pid {s['pid']} {s['name'] or ''}")
+    for k, c in list(s["kernel_calls"].items())[: args.n]:
+        ms = c["us"] / 1e3 if c["us"] is not None else 0
+        mean = c["us"] / c["calls"] if c["us"] is not None else 0
+        print(f"{c['calls']:8d} {ms:10.3f} {mean:10.3f} {k}")
+    for k, n in s["messages"].items():
+        print(f"{n:8d} {k}")
+    print(f"{s['page_faults']:8d} page faults")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
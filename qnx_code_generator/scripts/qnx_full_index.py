@@ -16,6 +16,10 @@ sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
 from qnx_rag import QNXFunctionRAG
 import logging
 
+sys.path.insert(0, str(Path(__file__).resolve().parent.parent / "src" / "qnx_mcp"))
+from vector_store import VectorStore
+from qnx_web_crawler import QNXWebCrawler
+
 # 配置日志
 logging.basicConfig(
     level=logging.INFO,
@@ -32,123 +36,54 @@ class QNXFullIndexer(QNXFunctionRAG):
         # 修改集合名称避免冲突
         self.collection_name = "qnx_functions_full"
         
-        # 重新初始化集合
-        try:
-            self.collection = self.chroma_client.get_collection(name=self.collection_name)
+        # 重新初始化集合（量化向量 + HNSW 图，内存映射打开）
+        self.store = VectorStore.from_config(getattr(self, "config", {}), self.collection_name)
+        if self.store.exists:
+            self.collection = self.store
             logger.info(f"加载完整函数集合: {self.collection_name}")
-        except (ValueError, Exception):
+        else:
             self.collection = None
             logger.info("将创建完整函数集合")
     
     def _discover_all_functions_with_duplicates(self):
-        """发现所有QNX函数，保留重复函数的所有URL"""
-        # 检查缓存
-        cache_file = self.cache_dir / "function_urls_full.json"
-        if cache_file.exists():
-            logger.info("从缓存加载完整函数URL映射")
-            with open(cache_file, 'r', encoding='utf-8') as f:
-                return json.load(f)
-        
-        logger.info("发现所有QNX函数文档（包含重复）...")
-        function_urls = {}  # Dict[func_name, List[url]]
-        
-        import string
-        import requests
-        from bs4 import BeautifulSoup
-        from urllib.parse import urljoin
-        
-        # 遍历所有字母页面
-        for letter in string.ascii_lowercase:
-            list_url = f"{self.base_url}lib-{letter}.html"
-            logger.info(f"处理字母页面: {letter}")
-            
-            try:
-                response = requests.get(list_url, timeout=15)
-                if response.status_code != 200:
-                    continue
-                
-                soup = BeautifulSoup(response.text, 'html.parser')
-                
-                # 查找函数链接
-                content_div = soup.find('div', class_='related-links')
-                if not content_div:
-                    continue
-                
-                for link in content_div.find_all('a', href=True):
-                    href = link['href']
-                    link_text = link.get_text().strip()
-                    
-                    # 检查是否是函数链接
-                    if '()' in link_text and href.endswith('.html'):
-                        # 构建完整URL
-                        if href.startswith('../../'):
-                            full_url = f"https://www.qnx.com/developers/docs/7.1/com.qnx.doc.neutrino.lib_ref/topic/{href.split('/')[-2]}/{href.split('/')[-1]}"
-                        elif href.count('/') == 1:
-                            full_url = urljoin(list_url, href)
-                        else:
-                            full_url = urljoin(list_url, href)
-                        
-                        # 提取函数名 - 可能有多个函数在同一链接中
-                        func_names = link_text.replace('()', '').split(',')
-                        for func_name in func_names:
-                            func_name = func_name.strip()
-                            if func_name:
-                                if func_name not in function_urls:
-                                    function_urls[func_name] = []
-                                if full_url not in function_urls[func_name]:
-                                    function_urls[func_name].append(full_url)
-                
-            except Exception as e:
-                logger.error(f"处理字母 {letter} 时出错: {e}")
-                continue
+        """发现所有QNX函数，保留重复函数的所有URL
+
+        与步骤处理器共用爬虫的索引发现（并发抓取、进程池解析、带TTL的缓存）
+        """
+        function_urls = QNXWebCrawler().discover_function_urls()
         
-        # 统计
-        total_functions = len(function_urls)
-        total_urls = sum(len(urls) for urls in function_urls.values())
         duplicates = {name: urls for name, urls in function_urls.items() if len(urls) > 1}
-        
-        logger.info(f"发现 {total_functions} 个不同函数名")
-        logger.info(f"总共 {total_urls} 个文档URL")
+        logger.info(f"发现 {len(function_urls)} 个不同函数名")
+        logger.info(f"总共 {sum(len(urls) for urls in function_urls.values())} 个文档URL")
         logger.info(f"有 {len(duplicates)} 个函数名有多个文档")
-        
-        # 显示重复函数的例子
-        if duplicates:
-            logger.info("重复函数示例:")
-            for name, urls in list(duplicates.items())[:5]:
-                logger.info(f"  {name}: {len(urls)} 个文档")
-                for url in urls:
-                    logger.info(f"    - {url}")
-        
-        # 保存到缓存
-        with open(cache_file, 'w', encoding='utf-8') as f:
-            json.dump(function_urls, f, indent=2, ensure_ascii=False)
+        for name, urls in list(duplicates.items())[:5]:
+            logger.info(f"  {name}: {len(urls)} 个文档")
         
         return function_urls
     
+    def _content_hash(self, func_name: str) -> str:
+        """被向量化文本（函数名）与模型的哈希：相同则已有向量可直接复用"""
+        model = getattr(self, "embedding_model", "")
+        return hashlib.sha256(f"{model}\0{func_name}".encode('utf-8')).hexdigest()
+    
     def build_full_index(self, force_rebuild: bool = False):
-        """构建包含所有函数文档的完整索引"""
+        """构建包含所有函数文档的完整索引
+        
+        force_rebuild 时增量刷新：只为新增或变化的文档计算向量，
+        仅文档/元数据变化的记录原地更新，已不存在的文档被删除
+        """
         if self.collection and not force_rebuild:
             count = self.collection.count()
-            logger.info(f"完整函数集合已存在，包含 {count} 个文档。使用 force_rebuild=True 重建")
+            logger.info(f"完整函数集合已存在，包含 {count} 个文档。使用 force_rebuild=True 刷新")
             return
         
         logger.info("开始构建完整QNX函数RAG索引...")
         
-        # 重建时删除现有集合
-        if force_rebuild and self.collection:
-            try:
-                self.chroma_client.delete_collection(name=self.collection_name)
-            except:
-                pass
-        
-        # 创建新集合
-        self.collection = self.chroma_client.create_collection(
-            name=self.collection_name,
-            metadata={
-                "hnsw:space": "cosine", 
-                "description": "All QNX functions with all document variants"
-            }
-        )
+        # 现有记录：doc_id -> (文档, 元数据)
+        self.collection = self.store
+        stored = self.store.get()
+        existing = {doc_id: (stored['documents'][i], stored['metadatas'][i])
+                    for i, doc_id in enumerate(stored['ids'])}
         
         # 发现所有函数（包含重复）
         function_urls_map = self._discover_all_functions_with_duplicates()
@@ -156,9 +91,12 @@ class QNXFullIndexer(QNXFunctionRAG):
         # 准备批量处理
         from tqdm import tqdm
         
-        batch_size = 10  # 减小批次大小以处理更多文档
+        batch_size = 100  # 每批写一次向量文件和图
         successful_count = 0
         failed_count = 0
+        unchanged_count = 0
+        updated_count = 0
+        seen_ids = set()
         
         # 展开所有函数文档
         all_function_docs = []
@@ -179,25 +117,19 @@ class QNXFullIndexer(QNXFunctionRAG):
             batch_embeddings = []
             batch_documents = []
             batch_metadatas = []
+            update_ids, update_documents, update_metadatas = [], [], []
             
             for doc_id, func_name, url in batch:
+                # 获取失败的文档保留旧记录，不算作过期
+                seen_ids.add(doc_id)
+                
                 # 获取函数文档
                 func_info = self._fetch_and_parse_function(func_name, url)
                 if not func_info or len(func_info['full_content']) < 50:
                     failed_count += 1
                     continue
                 
-                # 对函数名进行向量化
-                embedding = self._get_function_name_embedding(func_name)
-                if not embedding:
-                    failed_count += 1
-                    continue
-                
-                # 准备数据
-                batch_ids.append(doc_id)
-                batch_embeddings.append(embedding)
-                batch_documents.append(func_info['full_content'])
-                batch_metadatas.append({
+                metadata = {
                     "function_name": func_name,
                     "doc_id": doc_id,
                     "url": url,
@@ -208,25 +140,59 @@ class QNXFullIndexer(QNXFunctionRAG):
                     "has_examples": len(func_info.get('examples', [])) > 0,
                     "headers": json.dumps(func_info.get('headers', [])),
                     "parameters": json.dumps(func_info.get('parameters', [])),
-                    "return_values": json.dumps(func_info.get('return_values', []))
-                })
+                    "return_values": json.dumps(func_info.get('return_values', [])),
+                    "content_hash": self._content_hash(func_name)
+                }
+                
+                # 向量未变：文档或元数据有变化时原地更新
+                old = existing.get(doc_id)
+                if old and old[1].get("content_hash") == metadata["content_hash"]:
+                    if old[0] != func_info['full_content'] or old[1] != metadata:
+                        update_ids.append(doc_id)
+                        update_documents.append(func_info['full_content'])
+                        update_metadatas.append(metadata)
+                    else:
+                        unchanged_count += 1
+                    continue
+                
+                # 对函数名进行向量化
+                embedding = self._get_function_name_embedding(func_name)
+                if not embedding:
+                    failed_count += 1
+                    continue
+                
+                # 准备数据
+                batch_ids.append(doc_id)
+                batch_embeddings.append(embedding)
+                batch_documents.append(func_info['full_content'])
+                batch_metadatas.append(metadata)
             
-            # 批量添加到集合
-            if batch_ids:
-                try:
-                    self.collection.add(
+            # 批量写入集合
+            try:
+                if batch_ids:
+                    self.collection.upsert(
                         ids=batch_ids,
                         embeddings=batch_embeddings,
                         documents=batch_documents,
                         metadatas=batch_metadatas
                     )
                     successful_count += len(batch_ids)
-                except Exception as e:
-                    logger.error(f"批量添加文档时出错: {e}")
-                    failed_count += len(batch_ids)
+                if update_ids:
+                    self.collection.update(update_ids, update_documents, update_metadatas)
+                    updated_count += len(update_ids)
+            except Exception as e:
+                logger.error(f"批量写入文档时出错: {e}")
+                failed_count += len(batch_ids)
+        
+        # 删除已不存在的文档
+        stale_ids = [doc_id for doc_id in existing if doc_id not in seen_ids]
+        deleted_count = self.collection.delete(stale_ids) if stale_ids else 0
         
         logger.info(f"完整索引构建完成:")
-        logger.info(f"  成功: {successful_count} 个文档")
+        logger.info(f"  新增/重新向量化: {successful_count} 个文档")
+        logger.info(f"  原地更新: {updated_count} 个文档")
+        logger.info(f"  未变化: {unchanged_count} 个文档")
+        logger.info(f"  删除: {deleted_count} 个文档")
         logger.info(f"  失败: {failed_count} 个文档")
     
     def get_function_all_variants(self, function_name: str):
@@ -236,10 +202,7 @@ class QNXFullIndexer(QNXFunctionRAG):
         
         try:
             # 查询所有匹配该函数名的文档
-            results = self.collection.get(
-                where={"function_name": function_name},
-                include=['documents', 'metadatas']
-            )
+            results = self.collection.get(where={"function_name": function_name})
             
             variants = []
             if results['ids']:
@@ -275,7 +238,7 @@ class QNXFullIndexer(QNXFunctionRAG):
             count = self.collection.count()
             
             # 统计函数名分布
-            all_metadata = self.collection.get(include=['metadatas'])['metadatas']
+            all_metadata = self.collection.get()['metadatas']
             function_names = [meta['function_name'] for meta in all_metadata]
             
             from collections import Counter
@@ -0,0 +1,322 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+QNX/musl ABI comparison for the glue generators: a function whose types
+and flag constants are identical on both sides needs no _qnx_ wrapper and
+no QNX_REDIRECT entry, QNX binaries can bind the musl symbol directly.
+"""
+
+import logging
+import os
+import re
+import sys
+from pathlib import Path
+from typing import Any, Dict, List, Optional, Set, Tuple
+
+sys.path.insert(0, str(Path(__file__).resolve().parent.parent / "qnx_mcp"))
+from qnx_type_index import QNXTypeIndex
+
+logger = logging.getLogger(__name__)
+
+# musl's arch/ directory for each qnx_system.preferred_architecture
+MUSL_ARCHES = {'x86_64': 'x86_64', 'aarch64le': 'aarch64', 'armle-v7': 'arm'}
+
+def musl_arch(config: Dict[str, Any]) -> str:
+    """musl arch name of qnx_system.preferred_architecture (x86_64 by default)"""
+    arch = config.get("qnx_system", {}).get("preferred_architecture", "x86_64")
+    return MUSL_ARCHES.get(arch, arch)
+
+# Macro families a function's arguments or results are made of; every
+# member QNX defines must have the same value in musl. Extended or
+# overridden by processing_settings.glue.abi_constants.
+FUNCTION_CONSTANTS = {
+    'open': ['O_'], 'openat': ['O_', 'AT_'], 'creat': ['O_'],
+    'fcntl': ['O_', 'F_', 'FD_'], 'access': ['R_OK', 'W_OK', 'X_OK', 'F_OK'],
+    'faccessat': ['R_OK', 'W_OK', 'X_OK', 'F_OK', 'AT_'], 'lseek': ['SEEK_'], 'lseek64': ['SEEK_'],
+    'mmap': ['PROT_', 'MAP_'], 'mmap64': ['PROT_', 'MAP_'], 'mprotect': ['PROT_'],
+    'msync': ['MS_'], 'madvise': ['MADV_'], 'posix_madvise': ['POSIX_MADV_'],
+    'kill': ['SIG'], 'raise': ['SIG'], 'signal': ['SIG'], 'sigaction': ['SIG', 'SA_'],
+    'sigprocmask': ['SIG'], 'pthread_sigmask': ['SIG'], 'pthread_kill': ['SIG'],
+    'sigaddset': ['SIG'], 'sigdelset': ['SIG'], 'sigismember': ['SIG'],
+    'socket': ['AF_', 'PF_', 'SOCK_'], 'socketpair': ['AF_', 'PF_', 'SOCK_'],
+    'setsockopt': ['SOL_', 'SO_', 'IPPROTO_'], 'getsockopt': ['SOL_', 'SO_', 'IPPROTO_'],
+    'send': ['MSG_'], 'recv': ['MSG_'], 'sendto': ['MSG_'], 'recvfrom': ['MSG_'],
+    'sendmsg': ['MSG_'], 'recvmsg': ['MSG_'], 'shutdown': ['SHUT_'],
+    'poll': ['POLL'], 'waitpid': ['WNOHANG', 'WUNTRACED', 'WCONTINUED'],
+    'clock_gettime': ['CLOCK_'], 'clock_settime': ['CLOCK_'], 'clock_getres': ['CLOCK_'],
+    'clock_nanosleep': ['CLOCK_', 'TIMER_'], 'timer_create': ['CLOCK_', 'SIGEV_'],
+    'dlopen': ['RTLD_'], 'dlsym': ['RTLD_'],
+}
+# C spellings that need no index entry
+C_TYPE_WORDS = {'void', 'char', 'short', 'int', 'long', 'float', 'double', 'signed', 'unsigned',
+                '_Bool', 'bool', 'const', 'volatile', 'restrict', 'struct', 'union', 'enum'}
+
+DEFINE_RE = re.compile(r'^[ \t]*#[ \t]*define[ \t]+([A-Za-z_]\w*)[ \t]+(.+?)[ \t]*$', re.M)
+EXPANSION_TOKEN_RE = re.compile(r'0[xX][0-9a-fA-F]+|\d+|[A-Za-z_]\w*|<<|>>|[-+~|&^*()]|\S')
+
+def parse_defines(content: str) -> Dict[str, str]:
+    """Object-like #define name -> expansion text, first definition wins"""
+    content = re.sub(r'/\*.*?\*/', ' ', content, flags=re.S)
+    content = re.sub(r'//[^\n]*', '', content)
+    defines = {}
+    for m in DEFINE_RE.finditer(content.replace('\\\n', ' ')):
+        defines.setdefault(m.group(1), m.group(2))
+    return defines
+
+class MacroTable:
+    """Integer values of the macros defined in a set of header directories
+
+    Headers are read on first use; among several definitions of a name
+    (arch variants, #ifdef branches) the first in search order is used.
+    """
+
+    def __init__(self, header_paths: List[str]):
+        self.header_paths = header_paths
+        self._defines: Optional[Dict[str, str]] = None
+        self._values: Dict[str, Optional[int]] = {}
+
+    def _load(self) -> Dict[str, str]:
+        if self._defines is None:
+            defines: Dict[str, str] = {}
+            for root in self.header_paths:
+                for dirpath, dirs, files in os.walk(root) if os.path.isdir(root) else ():
+                    dirs.sort()
+                    for name in sorted(files):
+                        if not name.endswith('.h'):
+                            continue
+                        try:
+                            with open(os.path.join(dirpath, name), 'r', encoding='utf-8', errors='ignore') as f:
+                                for key, value in parse_defines(f.read()).items():
+                                    defines.setdefault(key, value)
+                        except OSError:
+                            continue
+            self._defines = defines
+            logger.info(f"Read {len(defines)} macros from {len(self.header_paths)} header paths")
+        return self._defines
+
+    def value(self, name: str, depth: int = 0) -> Optional[int]:
+        """Integer value of a macro, None if it is not an integer constant expression"""
+        if name in self._values:
+            return self._values[name]
+        expansion = self._load().get(name)
+        result = None
+        if expansion is not None and depth < 16:
+            result = self._evaluate(expansion, depth)
+        self._values[name] = result
+        return result
+
+    def _evaluate(self, expansion: str, depth: int) -> Optional[int]:
+        parts = []
+        for token in EXPANSION_TOKEN_RE.findall(expansion):
+            if token[0].isdigit():
+                # Integer suffixes come out as words of their own: 0100u -> 0100 u
+                parts.append(str(int(token, 0) if token.startswith(('0x', '0X')) or token == '0'
+                                 else int(token, 8) if token.startswith('0') else int(token)))
+            elif token[0].isalpha() or token[0] == '_':
+                if token in ('U', 'L', 'UL', 'LL', 'ULL', 'u', 'l', 'ul', 'll', 'ull'):
+                    continue
+                if token in C_TYPE_WORDS:
+                    # A cast such as (int)0x80000000
+                    parts.append('')
+                    continue
+                value = self.value(token, depth + 1)
+                if value is None:
+                    return None
+                parts.append(str(value))
+            elif token in ('<<', '>>', '-', '+', '~', '|', '&', '^', '*', '(', ')'):
+                parts.append(token)
+            else:
+                return None
+        expression = re.sub(r'\(\s*\)', '', ' '.join(parts))
+        try:
+            return int(eval(expression, {"__builtins__": {}}, {})) if expression.strip() else None
+        except Exception:
+            return None
+
+    def is_alias(self, name: str) -> bool:
+        """Whether a macro is only another macro's name (#define O_RSYNC O_SYNC)"""
+        return bool(re.fullmatch(r'\(?\s*[A-Za-z_]\w*\s*\)?', self._load().get(name, '')))
+
+    def family(self, prefix: str) -> Dict[str, int]:
+        """Every integer macro whose name starts with prefix"""
+        return {name: value for name in self._load() if name.startswith(prefix)
+                for value in [self.value(name)] if value is not None}
+
+def macro_tables(config: Dict[str, Any]) -> Tuple[MacroTable, MacroTable]:
+    """(QNX, musl) macro tables: qnx_system.header_search_paths and the musl arch and include trees"""
+    qnx_config = config.get("qnx_system", {})
+    linux_config = config.get("linux_system", {})
+    musl_path = linux_config.get("musl_source_path", "../qol/musl")
+    arch = musl_arch(config)
+    linux_headers = linux_config.get("header_search_paths") or [
+        os.path.join(musl_path, "arch", arch), os.path.join(musl_path, "arch", "generic"),
+        os.path.join(musl_path, "include")]
+    return MacroTable(qnx_config.get("header_search_paths", [])), MacroTable(linux_headers)
+
+class AbiComparator:
+    """Type layouts from the two type indexes and flag values from the two header trees"""
+
+    def __init__(self, qnx_types: Optional[QNXTypeIndex], linux_types: Optional[QNXTypeIndex],
+                 qnx_macros: MacroTable, linux_macros: MacroTable,
+                 function_constants: Optional[Dict[str, List[str]]] = None):
+        self.qnx_types = qnx_types
+        self.linux_types = linux_types
+        self.qnx_macros = qnx_macros
+        self.linux_macros = linux_macros
+        self.function_constants = dict(FUNCTION_CONSTANTS, **(function_constants or {}))
+        self._type_results: Dict[str, List[str]] = {}
+
+    @classmethod
+    def from_config(cls, config: Dict[str, Any]) -> "AbiComparator":
+        qnx_config = config.get("qnx_system", {})
+        linux_config = config.get("linux_system", {})
+        qnx_macros, linux_macros = macro_tables(config)
+        return cls(QNXTypeIndex.open(qnx_config.get("type_index_path", "./data/qnx_type_index.db")),
+                   QNXTypeIndex.open(linux_config.get("type_index_path", "./data/linux_type_index.db")),
+                   qnx_macros, linux_macros,
+                   config.get("processing_settings", {}).get("glue", {}).get("abi_constants"))
+
+    @property
+    def available(self) -> bool:
+        return self.qnx_types is not None and self.linux_types is not None
+
+    @staticmethod
+    def _base(type_name: str) -> str:
+        """The named type under qualifiers, pointers and array bounds"""
+        t = re.sub(r'\[[^\]]*\]|\*|\b(const|volatile|restrict)\b', ' ', type_name or '')
+        return ' '.join(t.split())
+
+    def compare_type(self, type_name: str) -> List[str]:
+        """Differences between the QNX and the musl definition of a type, [] if identical"""
+        name = self._base(type_name)
+        if name not in self._type_results:
+            self._type_results[name] = self._compare(name, name, set())
+        return self._type_results[name]
+
+    @staticmethod
+    def _scalar_words(name: str) -> frozenset:
+        """long unsigned int and unsigned long are the same type"""
+        words = set(name.split()) - {'signed'}
+        return frozenset(words - {'int'} if len(words) > 1 else words)
+
+    def _compare(self, q_name: str, l_name: str, seen: Set[tuple]) -> List[str]:
+        """Differences between QNX type q_name and musl type l_name"""
+        if '(' in q_name or '(' in l_name or (q_name, l_name) in seen:
+            # Function pointers are compared as pointers; pointer cycles end here
+            return []
+        seen = seen | {(q_name, l_name)}
+        label = q_name if q_name == l_name else f"{q_name}/{l_name}"
+        qnx, linux = self.qnx_types.get(q_name), self.linux_types.get(l_name)
+        if qnx and linux and qnx["size"] != linux["size"]:
+            return [f"{label}: size {qnx['size']} on QNX, {linux['size']} on musl"]
+        # A typedef is what it stands for, whatever it is called on the other side
+        if qnx and qnx["kind"] == 'typedef' and qnx.get("target"):
+            return self._compare(self._base(qnx["target"]), l_name, seen)
+        if linux and linux["kind"] == 'typedef' and linux.get("target"):
+            return self._compare(q_name, self._base(linux["target"]), seen)
+        q_scalar = (qnx is None or qnx["kind"] == 'base') and all(w in C_TYPE_WORDS for w in q_name.split())
+        l_scalar = (linux is None or linux["kind"] == 'base') and all(w in C_TYPE_WORDS for w in l_name.split())
+        if q_scalar and l_scalar:
+            if self._scalar_words(q_name) != self._scalar_words(l_name):
+                return [f"{label}: {q_name} on QNX, {l_name} on musl"]
+            return []
+        if qnx is None or linux is None:
+            if qnx is None and linux is None:
+                return [f"{label}: in neither type index"]
+            return [f"{label}: only in the {'QNX' if linux is None else 'musl'} type index"]
+        if qnx["kind"] != linux["kind"]:
+            return [f"{label}: {qnx['kind']} on QNX, {linux['kind']} on musl"]
+        if qnx["kind"] == 'enum':
+            l_values = {f["name"]: f.get("value") for f in linux["fields"]}
+            return [f"{label}.{f['name']}: {f.get('value')} on QNX, {l_values.get(f['name'], 'undefined')} on musl"
+                    for f in qnx["fields"] if l_values.get(f["name"], object()) != f.get("value")]
+        if qnx["kind"] in ('struct', 'union'):
+            if len(qnx["fields"]) != len(linux["fields"]):
+                return [f"{label}: {len(qnx['fields'])} fields on QNX, {len(linux['fields'])} on musl"]
+            differences = []
+            layout = ("name", "offset", "size", "bit_size")
+            for q, l in zip(qnx["fields"], linux["fields"]):
+                if any(q.get(k) != l.get(k) for k in layout):
+                    differences.append(f"{label}.{q['name']}: " + ", ".join(
+                        f"{k} {q.get(k)} on QNX, {l.get(k)} on musl" for k in layout if q.get(k) != l.get(k)))
+                else:
+                    differences += self._compare(self._base(q["type"]), self._base(l["type"]), seen)
+            return differences
+        return []
+
+    def compare_constants(self, prefixes: List[str]) -> List[str]:
+        """QNX macros of the families whose musl value differs or is missing"""
+        differences = []
+        for prefix in prefixes:
+            linux_values = self.linux_macros.family(prefix)
+            for name, value in sorted(self.qnx_macros.family(prefix).items()):
+                if linux_values.get(name) != value:
+                    differences.append(f"{name}: {value:#x} on QNX, "
+                                       f"{format(linux_values[name], '#x') if name in linux_values else 'undefined'}"
+                                       f" on musl")
+        return differences
+
+    @classmethod
+    def signature_types(cls, func_name: str, signature: str) -> Optional[List[str]]:
+        """Types of the return value and parameters of a prototype, None if it is not one of func_name"""
+        m = re.search(rf'\b{re.escape(func_name)}\s*\(', signature or '')
+        if not m:
+            return None
+        depth, end = 1, m.end()
+        while end < len(signature) and depth:
+            depth += {'(': 1, ')': -1}.get(signature[end], 0)
+            end += 1
+        declarations = [re.sub(r'\b(extern|static|inline|__inline)\b', ' ', signature[:m.start()])]
+        parts, depth, current = [], 0, ''
+        for ch in signature[m.end():end - 1]:
+            if ch == ',' and depth == 0:
+                parts.append(current)
+                current = ''
+                continue
+            depth += {'(': 1, ')': -1}.get(ch, 0)
+            current += ch
+        parts.append(current)
+        for part in parts:
+            part = re.sub(r'\[[^\]]*\]', ' ', part).strip()
+            if not part or part in ('void', '...'):
+                continue
+            fnptr = re.match(r'(.*?)\(\s*\*\s*\w*\s*\)\s*\(', part)
+            if fnptr:
+                # Only the return type of a callback; its own parameters are the caller's business
+                declarations.append(fnptr.group(1) + ' *')
+                continue
+            words = re.findall(r'[A-Za-z_]\w*', part)
+            named = len([w for w in words if w not in ('const', 'volatile', 'restrict', 'struct', 'union', 'enum')]) > 1
+            if named and words[-1] not in C_TYPE_WORDS:
+                part = part[:part.rindex(words[-1])]
+            declarations.append(part)
+        types = []
+        for declaration in declarations:
+            words = ' '.join(re.sub(r'[*&]', ' ', declaration).split())
+            for t in re.finditer(r'\b(?:(?:struct|union|enum)\s+[A-Za-z_]\w*'
+                                 r'|(?:(?:unsigned|signed|long|short|int|char|float|double|_Bool|void)\s*)+'
+                                 r'|[A-Za-z_]\w*)', words):
+                name = ' '.join(t.group(0).split())
+                if name in ('const', 'volatile', 'restrict') or name in types:
+                    continue
+                if name != 'void':
+                    types.append(name)
+        return types
+
+    def check_function(self, func_name: str, signature: str) -> Dict[str, Any]:
+        """{"identical", "types", "constants", "differences"} for one QNX prototype"""
+        result = {"identical": False, "types": [], "constants": [], "differences": []}
+        if not self.available:
+            result["differences"].append("type indexes not built")
+            return result
+        types = self.signature_types(func_name, signature)
+        if types is None:
+            result["differences"].append(f"no prototype of {func_name}")
+            return result
+        result["types"] = types
+        result["constants"] = self.function_constants.get(func_name, [])
+        for type_name in types:
+            result["differences"] += self.compare_type(type_name)
+        result["differences"] += self.compare_constants(result["constants"])
+        result["identical"] = not result["differences"]
+        return result
@@ -0,0 +1,33 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Structured gcc and ld messages for the build and validation steps.
+"""
+
+import re
+from typing import Any, Dict, List
+
+COMPILER_DIAGNOSTIC_RE = re.compile(
+    r'^(?P<file>[^\s:][^:]*):(?P<line>\d+):(?:(?P<column>\d+):)?\s*'
+    r'(?P<severity>fatal error|error|warning|note):\s*(?P<message>.*)$')
+LINKER_DIAGNOSTIC_RE = re.compile(r'^(?P<file>[^\s:][^:]*):(?:\([^)]*\)|\d+):\s*(?P<message>(?:undefined|multiple) .*)$')
+
+def parse_compiler_diagnostics(output: str) -> List[Dict[str, Any]]:
+    """gcc/ld messages as [{"file", "line", "column", "severity", "message"}]"""
+    diagnostics = []
+    for line in output.splitlines():
+        m = COMPILER_DIAGNOSTIC_RE.match(line)
+        if m:
+            diagnostics.append({
+                "file": m.group("file"),
+                "line": int(m.group("line")),
+                "column": int(m.group("column")) if m.group("column") else None,
+                "severity": m.group("severity"),
+                "message": m.group("message")
+            })
+            continue
+        m = LINKER_DIAGNOSTIC_RE.match(line)
+        if m:
+            diagnostics.append({"file": m.group("file"), "line": None, "column": None,
+                                "severity": "error", "message": m.group("message")})
+    return diagnostics
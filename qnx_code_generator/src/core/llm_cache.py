@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Persistent cache of LLM responses shared by the QNX and Linux MCP pipelines.
+"""
+
+import json
+import hashlib
+import logging
+import sqlite3
+import time
+from pathlib import Path
+from typing import Any, Dict, Optional
+
+logger = logging.getLogger(__name__)
+
+class LLMCache:
+    """LLM responses in one SQLite database (WAL, so concurrent runs share it)
+
+    An entry is keyed by the hash of the prompt inputs together with the
+    model, the sampling parameters and a version of the prompt template:
+    callers bump their template version when the prompt or the way its
+    answer is used changes, which retires all older entries at once.
+    """
+
+    def __init__(self, db_path: str = "./data/llm_cache.db", enabled: bool = True):
+        self.db_path = Path(db_path)
+        self.enabled = enabled
+        self.hits = 0
+        self.misses = 0
+        if not enabled:
+            return
+        self.db_path.parent.mkdir(parents=True, exist_ok=True)
+        conn = self._connect()
+        try:
+            conn.execute("PRAGMA journal_mode=WAL")
+            conn.execute('''
+                CREATE TABLE IF NOT EXISTS responses (
+                    key TEXT PRIMARY KEY,
+                    namespace TEXT NOT NULL,
+                    model TEXT,
+                    response TEXT NOT NULL,
+                    created_at REAL
+                )
+            ''')
+            conn.commit()
+        finally:
+            conn.close()
+
+    @classmethod
+    def from_config(cls, config: Dict[str, Any]) -> "LLMCache":
+        """ai_settings.cache: {"enabled": true, "path": "./data/llm_cache.db"}"""
+        cache_config = config.get("ai_settings", {}).get("cache", {})
+        return cls(cache_config.get("path", "./data/llm_cache.db"), cache_config.get("enabled", True))
+
+    def _connect(self) -> sqlite3.Connection:
+        return sqlite3.connect(str(self.db_path), timeout=30)
+
+    @staticmethod
+    def _key(namespace: str, version: str, model: str, prompt: str,
+             params: Optional[Dict[str, Any]]) -> str:
+        material = json.dumps([namespace, version, model, params or {}, prompt],
+                              sort_keys=True, ensure_ascii=False)
+        return hashlib.sha256(material.encode('utf-8')).hexdigest()
+
+    def get(self, namespace: str, version: str, model: str, prompt: str,
+            params: Optional[Dict[str, Any]] = None) -> Optional[str]:
+        if not self.enabled:
+            return None
+        try:
+            conn = self._connect()
+            try:
+                row = conn.execute("SELECT response FROM responses WHERE key = ?",
+                                   (self._key(namespace, version, model, prompt, params),)).fetchone()
+            finally:
+                conn.close()
+        except sqlite3.Error as e:
+            logger.warning(f"LLM cache lookup failed: {e}")
+            return None
+        if row:
+            self.hits += 1
+            logger.debug(f"LLM cache hit ({namespace})")
+            return row[0]
+        self.misses += 1
+        return None
+
+    def put(self, namespace: str, version: str, model: str, prompt: str, response: str,
+            params: Optional[Dict[str, Any]] = None):
+        if not self.enabled or not response:
+            return
+        try:
+            conn = self._connect()
+            try:
+                conn.execute('''
+                    INSERT OR REPLACE INTO responses (key, namespace, model, response, created_at)
+                    VALUES (?, ?, ?, ?, ?)
+                ''', (self._key(namespace, version, model, prompt, params), namespace, model,
+                      response, time.time()))
+                conn.commit()
+            finally:
+                conn.close()
+        except sqlite3.Error as e:
+            logger.warning(f"LLM cache store failed: {e}")
+
+    def delete(self, namespace: str, version: str, model: str, prompt: str,
+               params: Optional[Dict[str, Any]] = None):
+        """Drop an entry whose response turned out to be unusable"""
+        if not self.enabled:
+            return
+        try:
+            conn = self._connect()
+            try:
+                conn.execute("DELETE FROM responses WHERE key = ?",
+                             (self._key(namespace, version, model, prompt, params),))
+                conn.commit()
+            finally:
+                conn.close()
+        except sqlite3.Error as e:
+            logger.warning(f"LLM cache delete failed: {e}")
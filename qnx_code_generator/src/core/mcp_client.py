@@ -2,24 +2,294 @@
 # -*- coding: utf-8 -*-
 """
 MCP Client utilities for connecting to QNX and Linux MCP servers.
+
+Servers are spoken to over JSON-RPC 2.0, either on the stdin/stdout of a
+child process (newline-delimited messages) or over HTTP with server-sent
+events. A connection stays open for the lifetime of the client and carries
+any number of concurrent requests, matched to their responses by id; a pool
+opens further connections to the same server when the open ones are busy.
 """
 
 import asyncio
+import itertools
 import json
 import logging
+import os
+import sys
 from typing import Dict, List, Optional, Any
 from dataclasses import dataclass
+from urllib.parse import urljoin
 
 logger = logging.getLogger(__name__)
 
+PROTOCOL_VERSION = "2024-11-05"
+CLIENT_INFO = {"name": "qnx-code-generator", "version": "1.0.0"}
+
+class MCPError(Exception):
+    """A JSON-RPC error response, or a connection that went away"""
+
 @dataclass
 class MCPServerConfig:
-    """Configuration for MCP server connection"""
+    """Configuration for MCP server connection
+    
+    With url set the server is reached over SSE at that address, otherwise
+    command and args are started as a child process speaking stdio.
+    """
     name: str
     command: str
     args: List[str]
     cwd: Optional[str] = None
     env: Optional[Dict[str, str]] = None
+    url: Optional[str] = None
+    max_connections: int = 2
+    max_in_flight: int = 8
+    request_timeout: float = 120.0
+
+class StdioTransport:
+    """Newline-delimited JSON-RPC on the stdin/stdout of a server process"""
+    
+    def __init__(self, config: MCPServerConfig):
+        self.config = config
+        self.process = None
+        self._write_lock = asyncio.Lock()
+        self._stderr_task = None
+    
+    async def start(self):
+        env = dict(os.environ, **(self.config.env or {}))
+        self.process = await asyncio.create_subprocess_exec(
+            self.config.command, *self.config.args, cwd=self.config.cwd, env=env,
+            stdin=asyncio.subprocess.PIPE, stdout=asyncio.subprocess.PIPE, stderr=asyncio.subprocess.PIPE,
+            limit=64 * 1024 * 1024)
+        self._stderr_task = asyncio.create_task(self._drain_stderr())
+    
+    async def _drain_stderr(self):
+        # The servers log to stderr; keep the pipe from filling up
+        while True:
+            line = await self.process.stderr.readline()
+            if not line:
+                return
+            logger.debug(f"[{self.config.name}] {line.decode('utf-8', 'replace').rstrip()}")
+    
+    async def send(self, message: Dict[str, Any]):
+        data = (json.dumps(message, ensure_ascii=False) + "\n").encode('utf-8')
+        async with self._write_lock:
+            self.process.stdin.write(data)
+            await self.process.stdin.drain()
+    
+    async def receive(self) -> Optional[Dict[str, Any]]:
+        """Next message, or None once the server has exited"""
+        while True:
+            line = await self.process.stdout.readline()
+            if not line:
+                return None
+            try:
+                return json.loads(line)
+            except json.JSONDecodeError:
+                logger.debug(f"[{self.config.name}] ignoring non-JSON output: {line[:200]!r}")
+    
+    async def close(self):
+        if self.process is None:
+            return
+        if self.process.returncode is None:
+            try:
+                self.process.stdin.close()
+                await asyncio.wait_for(self.process.wait(), timeout=5)
+            except (asyncio.TimeoutError, ProcessLookupError, BrokenPipeError, ConnectionResetError):
+                try:
+                    self.process.terminate()
+                    await asyncio.wait_for(self.process.wait(), timeout=5)
+                except (asyncio.TimeoutError, ProcessLookupError):
+                    self.process.kill()
+                    await self.process.wait()
+        if self._stderr_task:
+            self._stderr_task.cancel()
+
+class SSETransport:
+    """JSON-RPC over HTTP: responses arrive on an event stream, requests are POSTed
+    to the endpoint the server announces on it"""
+    
+    def __init__(self, config: MCPServerConfig):
+        self.config = config
+        self.client = None
+        self.endpoint = None
+        self._messages: asyncio.Queue = asyncio.Queue()
+        self._reader_task = None
+    
+    async def start(self):
+        import httpx
+        self.client = httpx.AsyncClient(timeout=httpx.Timeout(self.config.request_timeout, read=None))
+        ready = asyncio.get_running_loop().create_future()
+        self._reader_task = asyncio.create_task(self._read_events(ready))
+        self.endpoint = await asyncio.wait_for(ready, timeout=self.config.request_timeout)
+    
+    async def _read_events(self, ready: asyncio.Future):
+        try:
+            async with self.client.stream("GET", self.config.url, headers={"Accept": "text/event-stream"}) as response:
+                response.raise_for_status()
+                event, data = "message", []
+                async for line in response.aiter_lines():
+                    if line:
+                        field, _, value = line.partition(":")
+                        value = value[1:] if value.startswith(" ") else value
+                        if field == "event":
+                            event = value
+                        elif field == "data":
+                            data.append(value)
+                        continue
+                    # A blank line ends the event
+                    payload = "\n".join(data)
+                    if event == "endpoint" and not ready.done():
+                        ready.set_result(urljoin(self.config.url, payload))
+                    elif event == "message" and payload:
+                        try:
+                            await self._messages.put(json.loads(payload))
+                        except json.JSONDecodeError:
+                            logger.debug(f"[{self.config.name}] ignoring malformed event: {payload[:200]!r}")
+                    event, data = "message", []
+        except Exception as e:
+            if not ready.done():
+                ready.set_exception(MCPError(f"SSE connection to {self.config.url} failed: {e}"))
+            logger.debug(f"[{self.config.name}] event stream ended: {e}")
+        finally:
+            await self._messages.put(None)
+    
+    async def send(self, message: Dict[str, Any]):
+        response = await self.client.post(self.endpoint, json=message)
+        response.raise_for_status()
+    
+    async def receive(self) -> Optional[Dict[str, Any]]:
+        return await self._messages.get()
+    
+    async def close(self):
+        if self._reader_task:
+            self._reader_task.cancel()
+        if self.client:
+            await self.client.aclose()
+
+class MCPConnection:
+    """One initialized MCP session; concurrent requests are multiplexed by JSON-RPC id"""
+    
+    def __init__(self, config: MCPServerConfig):
+        self.config = config
+        self.transport = SSETransport(config) if config.url else StdioTransport(config)
+        self.pending: Dict[int, asyncio.Future] = {}
+        self.server_info: Dict[str, Any] = {}
+        self.alive = False
+        self._ids = itertools.count(1)
+        self._reader_task = None
+    
+    @property
+    def in_flight(self) -> int:
+        return len(self.pending)
+    
+    async def open(self):
+        await self.transport.start()
+        self.alive = True
+        self._reader_task = asyncio.create_task(self._read_loop())
+        result = await self.request("initialize", {
+            "protocolVersion": PROTOCOL_VERSION,
+            "capabilities": {},
+            "clientInfo": CLIENT_INFO
+        })
+        self.server_info = result.get("serverInfo", {})
+        await self.transport.send({"jsonrpc": "2.0", "method": "notifications/initialized"})
+        logger.info(f"Connected to MCP server {self.config.name} "
+                    f"({self.server_info.get('name', '?')} {self.server_info.get('version', '')})")
+    
+    async def request(self, method: str, params: Optional[Dict[str, Any]] = None,
+                      timeout: Optional[float] = None) -> Dict[str, Any]:
+        if not self.alive:
+            raise MCPError(f"Connection to {self.config.name} is closed")
+        request_id = next(self._ids)
+        future = asyncio.get_running_loop().create_future()
+        self.pending[request_id] = future
+        try:
+            message = {"jsonrpc": "2.0", "id": request_id, "method": method}
+            if params is not None:
+                message["params"] = params
+            await self.transport.send(message)
+            return await asyncio.wait_for(future, timeout or self.config.request_timeout)
+        finally:
+            self.pending.pop(request_id, None)
+    
+    async def _read_loop(self):
+        try:
+            while True:
+                message = await self.transport.receive()
+                if message is None:
+                    break
+                if "id" in message and ("result" in message or "error" in message):
+                    future = self.pending.get(message["id"])
+                    if future is None or future.done():
+                        continue
+                    if "error" in message:
+                        error = message["error"] or {}
+                        future.set_exception(MCPError(f"{error.get('code')}: {error.get('message')}"))
+                    else:
+                        future.set_result(message.get("result") or {})
+                elif "id" in message and "method" in message:
+                    # Requests from the server: answer pings, decline the rest
+                    if message["method"] == "ping":
+                        reply = {"jsonrpc": "2.0", "id": message["id"], "result": {}}
+                    else:
+                        reply = {"jsonrpc": "2.0", "id": message["id"],
+                                 "error": {"code": -32601, "message": f"Method not found: {message['method']}"}}
+                    await self.transport.send(reply)
+                else:
+                    logger.debug(f"[{self.config.name}] notification {message.get('method')}")
+        except Exception as e:
+            logger.warning(f"Connection to {self.config.name} failed: {e}")
+        finally:
+            self.alive = False
+            for future in self.pending.values():
+                if not future.done():
+                    future.set_exception(MCPError(f"MCP server {self.config.name} closed the connection"))
+    
+    async def close(self):
+        self.alive = False
+        await self.transport.close()
+        if self._reader_task:
+            self._reader_task.cancel()
+
+class MCPConnectionPool:
+    """Up to max_connections sessions of one server
+    
+    A request goes to the least busy live connection; another one is opened
+    only when every open connection already has max_in_flight requests
+    waiting. Dead connections are dropped and replaced on demand.
+    """
+    
+    def __init__(self, config: MCPServerConfig):
+        self.config = config
+        self.connections: List[MCPConnection] = []
+        self._lock = asyncio.Lock()
+    
+    async def acquire(self) -> MCPConnection:
+        async with self._lock:
+            self.connections = [c for c in self.connections if c.alive]
+            best = min(self.connections, key=lambda c: c.in_flight, default=None)
+            if best is None or (best.in_flight >= self.config.max_in_flight
+                                and len(self.connections) < self.config.max_connections):
+                connection = MCPConnection(self.config)
+                try:
+                    await connection.open()
+                except BaseException:
+                    await connection.close()
+                    if best is None:
+                        raise
+                    return best
+                self.connections.append(connection)
+                best = connection
+            return best
+    
+    async def request(self, method: str, params: Optional[Dict[str, Any]] = None) -> Dict[str, Any]:
+        connection = await self.acquire()
+        return await connection.request(method, params)
+    
+    async def close(self):
+        async with self._lock:
+            connections, self.connections = self.connections, []
+        await asyncio.gather(*(c.close() for c in connections), return_exceptions=True)
 
 class MCPClient:
     """Generic MCP client for communicating with MCP servers"""
@@ -27,15 +297,14 @@ class MCPClient:
     def __init__(self, server_config: MCPServerConfig):
         """Initialize MCP client"""
         self.config = server_config
-        self.process = None
+        self.pool = MCPConnectionPool(server_config)
         self.connected = False
-        
+    
     async def connect(self) -> bool:
-        """Connect to MCP server"""
+        """Connect to MCP server (starts the first pooled connection)"""
         try:
-            # This would implement actual MCP protocol connection
             logger.info(f"Connecting to MCP server: {self.config.name}")
-            # Placeholder - actual implementation would start subprocess and handle MCP protocol
+            await self.pool.acquire()
             self.connected = True
             return True
         except Exception as e:
@@ -44,34 +313,58 @@ class MCPClient:
     
     async def disconnect(self):
         """Disconnect from MCP server"""
-        if self.process:
-            self.process.terminate()
-            await self.process.wait()
+        await self.pool.close()
         self.connected = False
     
+    async def list_tools(self) -> List[Dict[str, Any]]:
+        """Tools the server offers"""
+        result = await self.pool.request("tools/list", {})
+        return result.get("tools", [])
+    
     async def call_tool(self, tool_name: str, arguments: Dict[str, Any]) -> Dict[str, Any]:
-        """Call a tool on the MCP server"""
+        """Call a tool on the MCP server
+        
+        The text content of the answer is returned as the JSON object it
+        holds, or as {"text": ...} when it is not JSON; a tool error or a
+        failed request comes back as {"error": ...}.
+        """
         if not self.connected:
             raise RuntimeError("Not connected to MCP server")
         
-        # Placeholder - actual implementation would send MCP protocol messages
-        logger.info(f"Calling tool {tool_name} with args {arguments}")
-        return {"result": "placeholder"}
+        logger.debug(f"Calling tool {tool_name} with args {arguments}")
+        try:
+            result = await self.pool.request("tools/call", {"name": tool_name, "arguments": arguments})
+        except (MCPError, asyncio.TimeoutError, OSError) as e:
+            logger.error(f"Tool {tool_name} on {self.config.name} failed: {e!r}")
+            return {"error": str(e) or type(e).__name__}
+        return self._parse_tool_result(result)
+    
+    @staticmethod
+    def _parse_tool_result(result: Dict[str, Any]) -> Dict[str, Any]:
+        text = "\n".join(item.get("text", "") for item in result.get("content", []) if item.get("type") == "text")
+        if result.get("isError"):
+            return {"error": text}
+        try:
+            parsed = json.loads(text)
+        except json.JSONDecodeError:
+            return {"text": text}
+        return parsed if isinstance(parsed, dict) else {"result": parsed}
 
 class QNXMCPClient(MCPClient):
     """Client for QNX function MCP server"""
     
-    def __init__(self, server_path: str = "src/qnx_mcp/qnx_mcp_server.py"):
+    def __init__(self, server_path: str = "src/qnx_mcp/qnx_mcp_server.py", **options):
         config = MCPServerConfig(
             name="qnx-functions",
-            command="python",
-            args=[server_path]
+            command=sys.executable,
+            args=[server_path],
+            **options
         )
         super().__init__(config)
     
     async def get_function_info(self, function_name: str) -> Dict[str, Any]:
         """Get QNX function information"""
-        return await self.call_tool("get_qnx_function_info", {"function_name": function_name})
+        return await self.call_tool("get_qnx_function_details", {"function_name": function_name, "format": "json"})
     
     async def search_functions(self, query: str, max_results: int = 10) -> Dict[str, Any]:
         """Search QNX functions"""
@@ -79,15 +372,23 @@ class QNXMCPClient(MCPClient):
             "query": query,
             "max_results": max_results
         })
+    
+    async def search_functions_batch(self, queries: List[str], max_results: int = 10) -> Dict[str, Any]:
+        """Search QNX functions for several queries in one call"""
+        return await self.call_tool("search_qnx_functions", {
+            "queries": queries,
+            "max_results": max_results
+        })
 
 class LinuxMCPClient(MCPClient):
     """Client for Linux function MCP server"""
     
-    def __init__(self, server_path: str = "src/linux_mcp/linux_mcp_server.py"):
+    def __init__(self, server_path: str = "src/linux_mcp/linux_mcp_server.py", **options):
         config = MCPServerConfig(
-            name="linux-functions", 
-            command="python",
-            args=[server_path]
+            name="linux-functions",
+            command=sys.executable,
+            args=[server_path],
+            **options
         )
         super().__init__(config)
     
@@ -107,4 +408,4 @@ class LinuxMCPClient(MCPClient):
         return await self.call_tool("analyze_function_compatibility", {
             "qnx_func": qnx_func,
             "linux_func": linux_func
-        })
\ No newline at end of file
+        })
@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Adaptive request rate limiting for the external APIs of the pipelines.
+"""
+
+import logging
+import threading
+import time
+from typing import Any, Dict, Optional
+
+logger = logging.getLogger(__name__)
+
+class AdaptiveRateLimiter:
+    """Request pacing that follows what the service answers
+
+    Requests are spaced 1/rate apart across all threads sharing the limiter.
+    A 429 or 5xx halves the rate (and honors Retry-After); each success
+    raises it by a small step again, up to max_rate.
+    """
+
+    def __init__(self, rate: float = 1.0, min_rate: float = 0.05, max_rate: float = 5.0,
+                 increase: float = 0.1):
+        self.max_rate = max_rate
+        self.min_rate = min(min_rate, max_rate)
+        self.rate = max(self.min_rate, min(rate, max_rate))
+        self.increase = increase
+        self._next = 0.0
+        self._lock = threading.Lock()
+
+    @classmethod
+    def from_config(cls, config: Dict[str, Any]) -> "AdaptiveRateLimiter":
+        """ai_settings.rate_limit: {"requests_per_second", "min_requests_per_second", "max_requests_per_second"}"""
+        limit_config = config.get("ai_settings", {}).get("rate_limit", {})
+        return cls(limit_config.get("requests_per_second", 1.0),
+                   limit_config.get("min_requests_per_second", 0.05),
+                   limit_config.get("max_requests_per_second", 5.0))
+
+    def acquire(self):
+        """Block until this thread may send its request"""
+        with self._lock:
+            now = time.monotonic()
+            start = max(now, self._next)
+            self._next = start + 1.0 / self.rate
+        if start > now:
+            time.sleep(start - now)
+
+    def report(self, status_code: Optional[int], retry_after: Optional[str] = None):
+        """Adjust the rate to the status of a finished request"""
+        with self._lock:
+            if status_code == 429 or (status_code is not None and status_code >= 500):
+                self.rate = max(self.min_rate, self.rate / 2)
+                pause = 1.0 / self.rate
+                try:
+                    pause = max(pause, float(retry_after))
+                except (TypeError, ValueError):
+                    pass
+                self._next = max(self._next, time.monotonic() + pause)
+                logger.warning(f"API answered {status_code}, request rate lowered to {self.rate:.2f}/s")
+            elif status_code is not None and 200 <= status_code < 300:
+                self.rate = min(self.max_rate, self.rate + self.increase)
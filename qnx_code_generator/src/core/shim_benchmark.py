@@ -0,0 +1,212 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Microbenchmarks that time a generated shim against the musl function it
+wraps, so wrappers whose overhead exceeds the budget are caught before merge.
+"""
+
+import json
+import logging
+import os
+import re
+import subprocess
+import tempfile
+from typing import Any, Dict, List, Optional, Tuple
+
+logger = logging.getLogger(__name__)
+
+# Functions that do not return, replace or fork the process, or block: never called in a loop
+UNBENCHMARKABLE = {
+    'exit', '_exit', '_Exit', 'abort', 'quick_exit', 'longjmp', 'siglongjmp', '_longjmp',
+    'pthread_exit', 'fork', 'vfork', 'execl', 'execle', 'execlp', 'execv', 'execve', 'execvp', 'execvpe',
+    'fexecve', 'kill', 'raise', 'pause', 'sigsuspend', 'wait', 'waitpid', 'sleep', 'usleep', 'nanosleep',
+    'accept', 'read', 'recv', 'recvfrom', 'recvmsg', 'select', 'poll', 'pselect', 'pthread_join',
+    'pthread_mutex_lock', 'sem_wait', 'msgrcv', 'MsgReceive', 'MsgSend',
+}
+
+def parse_prototype(func_name: str, signature: str) -> Optional[Tuple[str, List[str]]]:
+    """(return class, [argument classes]) of a prototype, None if it cannot be called generically
+
+    Classes: "void" (return only), "ptr", "str" (char pointer), "long" (every
+    integer type; the callee reads the low bits of the register) and
+    "double". Variadic functions, va_list, long double and structs passed by
+    value are not supported.
+    """
+    m = re.search(rf'\b{re.escape(func_name)}\s*\(', signature or '')
+    if not m:
+        return None
+    depth, end = 1, m.end()
+    while end < len(signature) and depth:
+        depth += {'(': 1, ')': -1}.get(signature[end], 0)
+        end += 1
+    if depth:
+        return None
+    parts, depth, current = [], 0, ''
+    for ch in signature[m.end():end - 1]:
+        if ch == ',' and depth == 0:
+            parts.append(current)
+            current = ''
+            continue
+        depth += {'(': 1, ')': -1}.get(ch, 0)
+        current += ch
+    parts.append(current)
+    if len(parts) == 1 and parts[0].strip() in ('', 'void'):
+        parts = []
+
+    return_class = _classify(re.sub(r'\b(extern|static|inline|__inline)\b', ' ', signature[:m.start()]),
+                             returned=True)
+    arg_classes = [_classify(part) for part in parts]
+    if return_class is None or None in arg_classes:
+        return None
+    return return_class, arg_classes
+
+def _classify(declaration: str, returned: bool = False) -> Optional[str]:
+    declaration = declaration.strip()
+    if '...' in declaration or 'va_list' in declaration:
+        return None
+    if '(' in declaration:
+        return 'ptr'    # function pointer; NULL is passed
+    words = re.findall(r'[A-Za-z_]\w*', declaration)
+    if '*' in declaration or '[' in declaration:
+        return 'str' if 'char' in words and declaration.count('*') + declaration.count('[') == 1 else 'ptr'
+    if ('long' in words and 'double' in words) or 'struct' in words or 'union' in words:
+        return None
+    if 'double' in words or 'float' in words:
+        return 'double'
+    if returned and words == ['void']:
+        return 'void'
+    return 'long'
+
+def emit_shim_benchmark(func_name: str, signature: str, shim: str, target: Optional[str] = None,
+                        arguments: Optional[List[str]] = None, iterations: int = 1000000) -> Optional[str]:
+    """C program timing shim against target (default func_name), both called through dlsym, or None
+
+    Pointer arguments point to zeroed 64 KiB buffers (buf0, buf1, ...),
+    char pointers to a short relative path in writable buffers, integers
+    are 0 and floating point values 1.0; arguments (C expressions over those
+    names) replace the defaults for functions that need real ones.
+    """
+    if func_name in UNBENCHMARKABLE:
+        return None
+    prototype = parse_prototype(func_name, signature)
+    if prototype is None:
+        return None
+    return_class, arg_classes = prototype
+    if arguments is not None and len(arguments) != len(arg_classes):
+        logger.warning(f"{func_name}: {len(arguments)} benchmark arguments for {len(arg_classes)} parameters")
+        return None
+    c_types = {'void': 'void', 'ptr': 'void *', 'str': 'char *', 'long': 'long', 'double': 'double'}
+    defaults = {'ptr': 'buf{i}', 'str': 'str{i}', 'long': '0', 'double': '1.0'}
+    args = arguments or [defaults[c].format(i=i) for i, c in enumerate(arg_classes)]
+    sink = {'void': '', 'ptr': 'psink = ', 'str': 'psink = ', 'long': 'lsink = ', 'double': 'dsink = '}[return_class]
+    buffers = '\n'.join(f'static char buf{i}[65536] __attribute__((aligned(64)));\n'
+                        f'static char str{i}[4096] = "qnx-shim-bench";' for i in range(len(arg_classes)))
+    return f'''#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <stdio.h>
+#include <time.h>
+
+typedef {c_types[return_class]} (*fn_t)({', '.join(c_types[c] for c in arg_classes) or 'void'});
+
+{buffers}
+static void *volatile psink;
+static volatile long lsink;
+static volatile double dsink;
+
+static double ns_per_call(fn_t f, long n)
+{{
+	struct timespec a, b;
+	clock_gettime(CLOCK_MONOTONIC, &a);
+	for (long i = 0; i < n; i++) {{
+		{sink}f({', '.join(args)});
+		__asm__ volatile("" ::: "memory");
+	}}
+	clock_gettime(CLOCK_MONOTONIC, &b);
+	return ((b.tv_sec - a.tv_sec) * 1e9 + (b.tv_nsec - a.tv_nsec)) / n;
+}}
+
+int main(void)
+{{
+	fn_t shim = (fn_t)dlsym(RTLD_DEFAULT, "{shim}");
+	fn_t target = (fn_t)dlsym(RTLD_DEFAULT, "{target or func_name}");
+	if (!shim || !target) {{
+		printf("{{\\"error\\": \\"%s not found\\"}}\\n", shim ? "{target or func_name}" : "{shim}");
+		return 2;
+	}}
+	/* Warm up, then the best of several alternating rounds */
+	ns_per_call(shim, {max(1, iterations // 10)}L);
+	ns_per_call(target, {max(1, iterations // 10)}L);
+	double best_shim = 1e18, best_target = 1e18;
+	for (int round = 0; round < 5; round++) {{
+		double t = ns_per_call(shim, {max(1, iterations // 5)}L);
+		if (t < best_shim) best_shim = t;
+		t = ns_per_call(target, {max(1, iterations // 5)}L);
+		if (t < best_target) best_target = t;
+	}}
+	printf("{{\\"shim_ns\\": %.3f, \\"musl_ns\\": %.3f}}\\n", best_shim, best_target);
+	return 0;
+}}
+'''
+
+def build_command(source_file: str, binary: str, musl_path: str, libc: str, arch: str = "x86_64") -> List[str]:
+    """gcc argv linking a benchmark against a musl tree's headers, crt objects and the given libc.so
+
+    arch is the musl arch the tree was configured for; the benchmark runs
+    natively, so it has to be the host's.
+    """
+    musl_path = os.path.abspath(musl_path)
+    includes = [os.path.join(musl_path, d) for d in ("include", "obj/include", f"arch/{arch}", "arch/generic")]
+    return (["gcc", "-O2", "-fno-stack-protector", "-nostdinc"]
+            + [arg for d in includes for arg in ("-isystem", d)]
+            + ["-nostdlib", "-o", binary, os.path.join(musl_path, "lib", "crt1.o"),
+               os.path.join(musl_path, "lib", "crti.o"), source_file, os.path.abspath(libc), "-lgcc",
+               os.path.join(musl_path, "lib", "crtn.o")])
+
+def check_budget(timing: Dict[str, Any], budget_ns: float, budget_ratio: float) -> Dict[str, Any]:
+    """Overhead of a benchmark result against the budget
+
+    The allowed overhead is the larger of budget_ns and budget_ratio of the
+    musl time, so neither a fixed cost on a 2 ns function nor a small share
+    of a 1 us one is flagged by itself.
+    """
+    overhead = timing["shim_ns"] - timing["musl_ns"]
+    allowed = max(budget_ns, budget_ratio * timing["musl_ns"])
+    return dict(timing, overhead_ns=round(overhead, 3),
+                overhead_ratio=round(overhead / timing["musl_ns"], 3) if timing["musl_ns"] > 0 else None,
+                allowed_ns=round(allowed, 3), within_budget=overhead <= allowed)
+
+def run_shim_benchmark(source: str, musl_path: str, libc: str, budget_ns: float = 5, budget_ratio: float = 0.1,
+                       timeout: float = 60, cwd: Optional[str] = None, arch: str = "x86_64") -> Dict[str, Any]:
+    """Build a benchmark against libc, run it with that libc as the dynamic loader and check the budget
+
+    {"benchmarked": False, "error"} when it cannot be built or run; otherwise
+    the timings, the overhead and "within_budget".
+    """
+    with tempfile.TemporaryDirectory() as work:
+        c_file = os.path.join(work, "shim_bench.c")
+        binary = os.path.join(work, "shim_bench")
+        with open(c_file, 'w', encoding='utf-8') as f:
+            f.write(source)
+        try:
+            build = subprocess.run(build_command(c_file, binary, musl_path, libc, arch),
+                                   capture_output=True, text=True, timeout=timeout)
+            if build.returncode != 0:
+                return {"benchmarked": False, "error": f"benchmark failed to compile: {build.stderr[-2000:]}"}
+            run = subprocess.run([os.path.abspath(libc), binary], capture_output=True, text=True,
+                                 timeout=timeout, cwd=cwd or work)
+        except (OSError, subprocess.TimeoutExpired) as e:
+            return {"benchmarked": False, "error": f"benchmark failed: {e}"}
+        try:
+            timing = json.loads(run.stdout.strip().splitlines()[-1])
+        except (ValueError, IndexError):
+            return {"benchmarked": False, "error": f"benchmark exited with {run.returncode}: {run.stderr[-2000:]}"}
+    if "error" in timing:
+        return {"benchmarked": False, "error": timing["error"]}
+    return dict(check_budget(timing, budget_ns, budget_ratio), benchmarked=True)
+
+def benchmark_settings(config: Dict[str, Any]) -> Dict[str, Any]:
+    """processing_settings.glue.benchmark with its defaults"""
+    settings = {"enabled": True, "budget_ns": 5, "budget_ratio": 0.1, "iterations": 1000000,
+                "reject": False, "timeout": 60, "arguments": {}}
+    settings.update(config.get("processing_settings", {}).get("glue", {}).get("benchmark", {}))
+    return settings
@@ -8,18 +8,48 @@ QNX functions to Linux equivalents. It uses information from both QNX and Linux
 MCP servers to analyze compatibility and generate appropriate wrapper code.
 """
 
+import asyncio
 import logging
 import json
+import re
+import sys
+from pathlib import Path
 from typing import Dict, List, Optional, Any, Tuple
-from dataclasses import dataclass
+from dataclasses import asdict, dataclass
 from enum import Enum
 
+try:
+    from .shim_sandbox import ShimSandboxPool
+except ImportError:
+    from shim_sandbox import ShimSandboxPool
+try:
+    from .struct_converter import StructConverterGenerator, run_benchmark
+    from .constant_tables import generate_constant_header, load_families
+    from .shim_backlog import ShimBacklog
+except ImportError:
+    from struct_converter import StructConverterGenerator, run_benchmark
+    from constant_tables import generate_constant_header, load_families
+    from shim_backlog import ShimBacklog
+
+sys.path.insert(0, str(Path(__file__).resolve().parent.parent))
+from core.abi_compat import AbiComparator
+
 # Setup logging
 logging.basicConfig(level=logging.INFO)
 logger = logging.getLogger(__name__)
 
+# Typedefs that are plain integers on both sides and never need a converter
+SCALAR_TYPEDEFS = {
+    'size_t', 'ssize_t', 'off_t', 'off64_t', 'pid_t', 'uid_t', 'gid_t', 'mode_t', 'time_t',
+    'clock_t', 'useconds_t', 'suseconds_t', 'socklen_t', 'wchar_t', 'wint_t', 'ptrdiff_t',
+    'intptr_t', 'uintptr_t', 'int8_t', 'int16_t', 'int32_t', 'int64_t',
+    'uint8_t', 'uint16_t', 'uint32_t', 'uint64_t', 'intmax_t', 'uintmax_t',
+    '_Uint8t', '_Uint16t', '_Uint32t', '_Uint64t', '_Int8t', '_Int16t', '_Int32t', '_Int64t',
+}
+
 class MigrationStrategy(Enum):
     """Migration strategies for different function types"""
+    ZERO_COST = "zero_cost"                     # Identical ABI, QNX binaries bind musl directly
     DIRECT_WRAPPER = "direct_wrapper"           # Simple 1:1 mapping
     PARAMETER_ADAPTATION = "parameter_adaptation"  # Parameter conversion needed
     HEURISTIC_IMPLEMENTATION = "heuristic_implementation"  # No Linux equivalent, create placeholder
@@ -52,6 +82,15 @@ class GlueCodeGenerator:
         # Code generation templates
         self.templates = self._load_templates()
         
+        # Compile-and-test sandboxes, prepared on first validation
+        self.sandbox_pool = ShimSandboxPool.from_config(self.config)
+        
+        # ABI checks and layout-driven converters when the DWARF of both sides has been indexed
+        self.abi = AbiComparator.from_config(self.config)
+        self.struct_converters = StructConverterGenerator(self.abi.qnx_types, self.abi.linux_types) \
+            if self.abi.available else None
+        self.converter_benchmarks: Dict[str, str] = {}
+        
         logger.info("Glue Code Generator initialized")
     
     def _load_config(self, config_path: str) -> Dict[str, Any]:
@@ -91,6 +130,17 @@ class GlueCodeGenerator:
     // Placeholder return value
 {return_placeholder}
 }}
+''',
+            "type_converter": '''
+// Conversion helpers for {type_name}, shared by every shim that uses it
+static inline void qnx_{ident}_to_linux(const {type_name} *qnx, {type_name} *linux_value) {{
+    // TODO: Convert the fields whose QNX and Linux layouts differ
+    memcpy(linux_value, qnx, sizeof(*linux_value));
+}}
+
+static inline void linux_{ident}_to_qnx(const {type_name} *linux_value, {type_name} *qnx) {{
+    memcpy(qnx, linux_value, sizeof(*qnx));
+}}
 ''',
             "header_include": '''
 // QNX to Linux glue code
@@ -99,6 +149,7 @@ class GlueCodeGenerator:
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <errno.h>
 #include <unistd.h>
 {additional_includes}
@@ -123,7 +174,12 @@ class GlueCodeGenerator:
             # Try to find Linux equivalent
             linux_func = await self._find_linux_equivalent(qnx_func, qnx_info)
             
-            if linux_func:
+            abi = None
+            if linux_func == qnx_func and self.abi.available:
+                abi = self.abi.check_function(qnx_func, qnx_info.get("signature", ""))
+            if abi and abi["identical"]:
+                strategy, confidence = MigrationStrategy.ZERO_COST, 1.0
+            elif linux_func:
                 linux_info = await self._get_linux_function_info(linux_func)
                 strategy, confidence = self._determine_migration_strategy(qnx_info, linux_info)
             else:
@@ -135,7 +191,9 @@ class GlueCodeGenerator:
                 linux_function=linux_func,
                 strategy=strategy,
                 confidence=confidence,
-                notes=f"Migration strategy determined: {strategy.value}"
+                notes=f"Migration strategy determined: {strategy.value}",
+                dependencies=self._signature_types(qnx_info.get("signature", "")),
+                warnings=abi["differences"] if abi else None
             )
             
         except Exception as e:
@@ -151,7 +209,10 @@ class GlueCodeGenerator:
     async def generate_function_glue_code(self, plan: FunctionMigrationPlan) -> str:
         """Generate glue code based on migration plan"""
         try:
-            if plan.strategy == MigrationStrategy.DIRECT_WRAPPER:
+            if plan.strategy == MigrationStrategy.ZERO_COST:
+                # No wrapper and no QNX_REDIRECT entry: the musl symbol is the QNX one
+                return ""
+            elif plan.strategy == MigrationStrategy.DIRECT_WRAPPER:
                 return await self._generate_direct_wrapper(plan)
             elif plan.strategy == MigrationStrategy.PARAMETER_ADAPTATION:
                 return await self._generate_parameter_adaptation(plan)
@@ -166,52 +227,203 @@ class GlueCodeGenerator:
             logger.error(f"Error generating code for {plan.qnx_function}: {e}")
             return f"// Code generation failed for {plan.qnx_function}: {e}\n"
     
+    @staticmethod
+    def _signature_types(signature: str) -> List[str]:
+        """Aggregate and typedef types of a prototype that may need layout conversion"""
+        types = []
+        for m in re.finditer(r'\b(?:(struct|union)\s+([A-Za-z_]\w*)|([A-Za-z_]\w*_t))\b', signature or ""):
+            name = f"{m.group(1)} {m.group(2)}" if m.group(1) else m.group(3)
+            if name not in SCALAR_TYPEDEFS and name not in types:
+                types.append(name)
+        return types
+    
+    @staticmethod
+    def _type_ident(type_name: str) -> str:
+        """struct stat -> stat, for the converter names"""
+        return re.sub(r'^(struct|union)\s+', '', type_name)
+    
+    async def generate_type_converter(self, type_name: str) -> str:
+        """Conversion helpers for one type, emitted once for all the shims that use it
+        
+        Generated from the two layouts when both type indexes know the type,
+        otherwise the memcpy template to be filled in by hand.
+        """
+        if self.struct_converters:
+            converters = await asyncio.to_thread(
+                self.struct_converters.converters, type_name, self._type_ident(type_name))
+            if converters:
+                self.converter_benchmarks.update(converters["benchmarks"])
+                return converters["code"] + "\n"
+        return self.templates["type_converter"].format(
+            type_name=type_name,
+            ident=self._type_ident(type_name)
+        )
+    
     async def generate_bulk_glue_code(self, function_list: List[str]) -> Dict[str, Any]:
-        """Generate glue code for multiple functions"""
+        """Generate glue code for multiple functions
+        
+        Runs as a DAG under processing_settings.glue.max_concurrency: all
+        functions are analyzed concurrently, the converters of the types
+        they share (struct stat, sigset_t, ...) are generated once each, and
+        every function's code is generated as soon as its converters exist.
+        """
+        function_list = list(dict.fromkeys(function_list))
+        max_concurrency = self.config.get("processing_settings", {}).get("glue", {}).get("max_concurrency", 8)
+        semaphore = asyncio.Semaphore(max_concurrency)
         results = {
             "header_code": "",
+            "converter_code": "",
             "function_code": "",
+            "converters": {},
             "migration_plans": {},
             "statistics": {
                 "total_functions": len(function_list),
                 "successful_migrations": 0,
                 "failed_migrations": 0,
+                "shared_converters": 0,
+                "converter_uses": 0,
+                "zero_cost_functions": [],
                 "strategies": {}
             }
         }
         
         # Generate header
+        constants_header = self._constant_tables_path()
         results["header_code"] = self.templates["header_include"].format(
-            additional_includes="// Add additional includes as needed"
+            additional_includes=f'#include "{Path(constants_header).name}"' if Path(constants_header).exists()
+            else "// Add additional includes as needed"
         )
         
-        # Process each function
-        for func_name in function_list:
+        # Stage 1: analyze every function
+        async def analyze(func_name: str) -> Optional[FunctionMigrationPlan]:
+            async with semaphore:
+                try:
+                    return await self.analyze_function_compatibility(func_name)
+                except Exception as e:
+                    logger.error(f"Failed to analyze {func_name}: {e}")
+                    return None
+        
+        plans = dict(zip(function_list, await asyncio.gather(*(analyze(f) for f in function_list))))
+        
+        # Stage 2: one converter task per type shared by the functions that need conversion
+        converter_tasks: Dict[str, asyncio.Task] = {}
+        
+        async def convert(type_name: str) -> str:
+            async with semaphore:
+                return await self.generate_type_converter(type_name)
+        
+        for plan in plans.values():
+            if plan and plan.strategy == MigrationStrategy.PARAMETER_ADAPTATION:
+                for type_name in plan.dependencies or []:
+                    if type_name not in converter_tasks:
+                        converter_tasks[type_name] = asyncio.create_task(convert(type_name))
+                    results["statistics"]["converter_uses"] += 1
+        
+        # Stage 3: each function's code, once the converters it depends on are done
+        async def generate(func_name: str, plan: FunctionMigrationPlan) -> Optional[str]:
+            if plan.strategy == MigrationStrategy.PARAMETER_ADAPTATION:
+                await asyncio.gather(*(converter_tasks[t] for t in plan.dependencies or [] if t in converter_tasks))
+            async with semaphore:
+                try:
+                    return await self.generate_function_glue_code(plan)
+                except Exception as e:
+                    logger.error(f"Failed to process {func_name}: {e}")
+                    return None
+        
+        codes = await asyncio.gather(*(generate(f, plans[f]) for f in function_list if plans[f]))
+        codes = dict(zip([f for f in function_list if plans[f]], codes))
+        
+        for type_name, task in converter_tasks.items():
             try:
-                plan = await self.analyze_function_compatibility(func_name)
-                code = await self.generate_function_glue_code(plan)
-                
-                results["migration_plans"][func_name] = plan
-                results["function_code"] += code + "\n"
-                
-                # Update statistics
-                if plan.strategy != MigrationStrategy.UNSUPPORTED:
-                    results["statistics"]["successful_migrations"] += 1
-                else:
-                    results["statistics"]["failed_migrations"] += 1
-                
-                strategy_name = plan.strategy.value
-                results["statistics"]["strategies"][strategy_name] = \
-                    results["statistics"]["strategies"].get(strategy_name, 0) + 1
-                
-                logger.info(f"Processed {func_name}: {plan.strategy.value}")
-                
+                results["converters"][type_name] = task.result()
             except Exception as e:
-                logger.error(f"Failed to process {func_name}: {e}")
+                logger.error(f"Failed to generate converter for {type_name}: {e}")
+        results["converter_code"] = "".join(results["converters"].values())
+        results["statistics"]["shared_converters"] = len(results["converters"])
+        
+        # Assemble in the order of function_list
+        for func_name in function_list:
+            plan = plans[func_name]
+            code = codes.get(func_name)
+            if plan is None or code is None:
                 results["statistics"]["failed_migrations"] += 1
+                continue
+            plan.generated_code = code
+            results["migration_plans"][func_name] = plan
+            if plan.strategy == MigrationStrategy.ZERO_COST:
+                results["statistics"]["zero_cost_functions"].append(func_name)
+            else:
+                results["function_code"] += code + "\n"
+            
+            # Update statistics
+            if plan.strategy != MigrationStrategy.UNSUPPORTED:
+                results["statistics"]["successful_migrations"] += 1
+            else:
+                results["statistics"]["failed_migrations"] += 1
+            
+            strategy_name = plan.strategy.value
+            results["statistics"]["strategies"][strategy_name] = \
+                results["statistics"]["strategies"].get(strategy_name, 0) + 1
+            
+            logger.info(f"Processed {func_name}: {plan.strategy.value}")
+        
+        return results
+    
+    async def generate_backlog_glue_code(self, backlog: Optional[ShimBacklog] = None,
+                                         limit: Optional[int] = None) -> Dict[str, Any]:
+        """generate_bulk_glue_code over the shim backlog, highest ranked first
         
+        The backlog defaults to the census data named by
+        processing_settings.glue.backlog; results["backlog"] holds the ranking.
+        """
+        backlog = backlog or ShimBacklog.from_config(self.config)
+        entries = backlog.rank(limit or self.config.get("processing_settings", {}).get("glue", {}).get(
+            "backlog", {}).get("limit"))
+        logger.info(f"Shim backlog: {len(entries)} functions, "
+                    f"{entries[-1].unblocked if entries else 0} of {len(backlog.blocked)} programs unblocked")
+        results = await self.generate_bulk_glue_code([e.function for e in entries])
+        results["backlog"] = [asdict(e) for e in entries]
         return results
     
+    async def validate_bulk_glue_code(self, results: Dict[str, Any]) -> Dict[str, Dict[str, Any]]:
+        """Compile, relink and test every generated shim of generate_bulk_glue_code in parallel"""
+        candidates = [
+            {"function": func_name,
+             "source": results["header_code"]
+                       + "".join(results.get("converters", {}).get(t, "") for t in plan.dependencies or [])
+                       + plan.generated_code}
+            for func_name, plan in results["migration_plans"].items()
+            if plan.generated_code and plan.strategy not in (MigrationStrategy.UNSUPPORTED, MigrationStrategy.ZERO_COST)
+        ]
+        validations = await self.sandbox_pool.validate(candidates)
+        passed = sum(1 for v in validations if v["passed"])
+        logger.info(f"Validated {len(validations)} shims: {passed} passed")
+        return {v["function"]: v for v in validations}
+    
+    def _constant_tables_path(self) -> str:
+        return self.config.get("processing_settings", {}).get("glue", {}).get(
+            "constant_tables", {}).get("output", "./data/qnx_constants.h")
+    
+    async def generate_constant_tables(self) -> Dict[str, Any]:
+        """Write the QNX <-> musl flag and enum translation header the shims include"""
+        families = await asyncio.to_thread(load_families, self.config)
+        output = Path(self._constant_tables_path())
+        output.parent.mkdir(parents=True, exist_ok=True)
+        output.write_text(generate_constant_header(families), encoding='utf-8')
+        logger.info(f"Constant tables for {len(families)} families written to {output}")
+        return {"output": str(output),
+                "families": {f.name: {"constants": len(f.pairs), "identity": f.identity,
+                                      "qnx_only": f.qnx_only, "problems": f.problems} for f in families}}
+    
+    async def benchmark_converters(self) -> Dict[str, Optional[Dict[str, Any]]]:
+        """Check and time every layout-driven converter generated so far against its per-field reference"""
+        names = list(self.converter_benchmarks)
+        runs = await asyncio.gather(*(asyncio.to_thread(run_benchmark, self.converter_benchmarks[n]) for n in names))
+        for name, run in zip(names, runs):
+            if run is None or not run.get("match"):
+                logger.warning(f"Converter {name} does not match its reference")
+        return dict(zip(names, runs))
+    
     async def _get_qnx_function_info(self, func_name: str) -> Optional[Dict[str, Any]]:
         """Get QNX function information from MCP server"""
         # Placeholder - would call QNX MCP server
@@ -253,7 +465,9 @@ class GlueCodeGenerator:
             linux_func=plan.linux_function or plan.qnx_function,
             return_type="int",  # Placeholder
             parameters="void",  # Placeholder
-            param_conversions="    // TODO: Add parameter conversions",
+            param_conversions="\n".join(
+                f"    // qnx_{self._type_ident(t)}_to_linux() / linux_{self._type_ident(t)}_to_qnx() for {t}"
+                for t in plan.dependencies or []) or "    // TODO: Add parameter conversions",
             return_statement="return",
             converted_params="",
             cleanup_code=""
@@ -285,6 +499,9 @@ async def main():
     print("=== Generated Header ===")
     print(results["header_code"])
     
+    print("=== Shared Converters ===")
+    print(results["converter_code"])
+    
     print("=== Generated Functions ===")
     print(results["function_code"])
     
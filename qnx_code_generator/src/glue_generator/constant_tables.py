@@ -0,0 +1,280 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Constant Table Generator
+
+Extracts the QNX flag and enumeration constants (O_*, SIG*, E*, SOCK_*,
+SO_*, POSIX_SPAWN_*, ...) from the QNX headers, pairs them with the musl
+values of the same names and emits one C header of translation functions,
+so shims stop hand-copying QNX values and walking branch chains.
+"""
+
+import json
+import logging
+import re
+import sys
+from pathlib import Path
+from typing import Any, Dict, List, Optional, Tuple
+
+sys.path.insert(0, str(Path(__file__).resolve().parent.parent))
+from core.abi_compat import MacroTable, macro_tables
+
+logger = logging.getLogger(__name__)
+
+# kind "flags": bit sets, translated bit by bit; kind "values": one value out of a set.
+# "prefer" names win when several QNX names share one musl value (O_SYNC and O_RSYNC).
+DEFAULT_FAMILIES = [
+    {"name": "oflags", "pattern": r"^O_[A-Z0-9_]+$", "kind": "flags", "field_masks": ["O_ACCMODE"],
+     "prefer": ["O_SYNC", "O_NONBLOCK"]},
+    {"name": "errno", "pattern": r"^E[A-Z0-9]+$", "kind": "values", "unmapped": "EINVAL", "exclude": ["EOF"]},
+    {"name": "signal", "pattern": r"^SIG[A-Z0-9]+$", "kind": "values",
+     "exclude": ["SIGSTKSZ", "SIGRTMIN", "SIGRTMAX"]},
+    {"name": "socktype", "pattern": r"^SOCK_(STREAM|DGRAM|RAW|RDM|SEQPACKET)$", "kind": "values"},
+    {"name": "sockopt", "pattern": r"^SO_[A-Z0-9_]+$", "kind": "values"},
+    {"name": "socklevel", "pattern": r"^SOL_[A-Z0-9_]+$", "kind": "values"},
+    {"name": "sockflags", "pattern": r"^SOCK_(NONBLOCK|CLOEXEC)$", "kind": "flags"},
+    {"name": "msgflags", "pattern": r"^MSG_[A-Z0-9_]+$", "kind": "flags"},
+    {"name": "prot", "pattern": r"^PROT_[A-Z0-9_]+$", "kind": "flags"},
+    {"name": "mapflags", "pattern": r"^MAP_[A-Z0-9_]+$", "kind": "flags", "field_masks": ["MAP_TYPE"]},
+    {"name": "spawnflags", "pattern": r"^POSIX_SPAWN_[A-Z0-9_]+$", "kind": "flags"},
+]
+# Largest value a "values" family is translated through a table for; sparser ones get a switch
+MAX_TABLE = 1024
+
+def _bits(value: int) -> List[int]:
+    return [b for b in range(32) if value >> b & 1]
+
+def _c_type(values: List[int]) -> str:
+    low, high = min(values, default=0), max(values, default=0)
+    if low >= 0:
+        return 'unsigned char' if high < 1 << 8 else 'unsigned short' if high < 1 << 16 else 'unsigned'
+    return 'int'
+
+def _array(values: List[int], indent: str = '\t') -> str:
+    lines, line = [], indent
+    for v in values:
+        item = f"{v:#x}, " if v > 9 else f"{v}, "
+        if len(line) + len(item) > 72:
+            lines.append(line.rstrip())
+            line = indent
+        line += item
+    lines.append(line.rstrip())
+    return '\n'.join(lines)
+
+class ConstantFamily:
+    """The QNX constants of one family, paired by name with their musl values"""
+
+    def __init__(self, spec: Dict[str, Any], qnx: MacroTable, linux: MacroTable):
+        self.name = spec["name"]
+        self.kind = spec.get("kind", "values")
+        self.unmapped = spec.get("unmapped", "drop" if self.kind == "flags" else "pass")
+        pattern = re.compile(spec["pattern"])
+        exclude = set(spec.get("exclude", [])) | set(spec.get("field_masks", []))
+        prefix = re.match(r'\^?([A-Za-z0-9_]*)', spec["pattern"]).group(1)
+
+        def members(table: MacroTable) -> Dict[str, int]:
+            return {n: v for n, v in table.family(prefix).items()
+                    if pattern.match(n) and n not in exclude and v >= 0}
+
+        q_members, l_members = members(qnx), members(linux)
+        self.pairs = [(n, q, l_members[n]) for n, q in q_members.items() if n in l_members]
+        # On the way back a musl value goes to a preferred name, else not to an alias
+        prefer = spec.get("prefer", [])
+        self.reverse_pairs = sorted(self.pairs, key=lambda p: (p[0] not in prefer, linux.is_alias(p[0])))
+        self.qnx_only = sorted(n for n in q_members if n not in l_members)
+        self.field_masks: List[Tuple[str, int]] = []
+        self.problems: List[str] = []
+        for mask_name in spec.get("field_masks", []):
+            mask = qnx.value(mask_name)
+            if mask is None:
+                continue
+            # A field (access mode, mapping type) passes through only if all its values agree
+            inside = [(n, q, l) for n, q, l in self.pairs if q & ~mask == 0]
+            if all(q == l for n, q, l in inside):
+                self.field_masks.append((mask_name, mask))
+            else:
+                self.problems += [f"{n}: {q:#x} on QNX, {l:#x} on musl, inside {mask_name}"
+                                  for n, q, l in inside if q != l]
+        if self.unmapped not in ("drop", "pass"):
+            value = linux.value(self.unmapped) if not str(self.unmapped).lstrip('-').isdigit() \
+                else int(self.unmapped)
+            self.unmapped_value = value if value is not None else 0
+        else:
+            self.unmapped_value = None
+
+    @property
+    def identity(self) -> bool:
+        """No translation at all: every shared name has the same value and nothing is dropped"""
+        return (all(q == l for _, q, l in self.pairs) and not self.problems
+                and (self.unmapped == "pass" or not self.qnx_only))
+
+    # Translation of bit sets
+
+    def _flag_plan(self, forward: bool):
+        """(keep mask, [(from bit, to value)], [(from value, to value)] composite) for one direction"""
+        field_mask = 0
+        for _, mask in self.field_masks:
+            field_mask |= mask
+        keep, single, composite, seen = field_mask, [], [], set()
+        for name, q, l in self.pairs if forward else self.reverse_pairs:
+            src, dst = (q, l) if forward else (l, q)
+            if src == 0 or src & field_mask == src or src in seen:
+                continue
+            seen.add(src)
+            if src == dst and len(_bits(src)) == 1:
+                keep |= src
+            elif len(_bits(src)) == 1:
+                single.append((src, dst))
+            elif forward:
+                # QNX combinations (O_RSYNC = O_DSYNC | ...) are covered by their bits
+                continue
+            else:
+                composite.append((src, dst))
+        if self.unmapped == "pass":
+            known = field_mask
+            for _, q, l in self.pairs:
+                known |= q if forward else l
+            keep |= ~known & 0xffffffff
+        # A bit some mapping moves is never kept as it is
+        for src, _ in single + composite:
+            keep &= ~src
+        return keep, sorted(single), sorted(composite, key=lambda c: -len(_bits(c[0])))
+
+    @staticmethod
+    def _chunks(single: List[Tuple[int, int]]) -> List[Tuple[int, int, List[int]]]:
+        """(shift, width, table) lookups of at most 8 source bits each"""
+        bits = sorted((src.bit_length() - 1, dst) for src, dst in single)
+        chunks = []
+        while bits:
+            start = bits[0][0]
+            group = [(b, d) for b, d in bits if b < start + 8]
+            bits = bits[len(group):]
+            width = group[-1][0] - start + 1
+            table = []
+            for i in range(1 << width):
+                value = 0
+                for b, d in group:
+                    if i >> (b - start) & 1:
+                        value |= d
+                table.append(value)
+            chunks.append((start, width, table))
+        return chunks
+
+    def _emit_flags(self, forward: bool) -> str:
+        direction = "to_linux" if forward else "from_linux"
+        func = f"qnx_const_{self.name}_{direction}"
+        keep, single, composite = self._flag_plan(forward)
+        lines = []
+        chunks = self._chunks(single)
+        for n, (shift, width, table) in enumerate(chunks):
+            lines.append(f"static const {_c_type(table)} {func}_tab{n}[{len(table)}] = {{")
+            lines.append(_array(table) + "\n};")
+        lines += [f"static inline int {func}(int v)", "{", "\tunsigned u = v;"]
+        # Fast path: only bits that mean the same on both sides
+        lines += [f"\tif (!(u & ~{keep:#x}u))" if keep else "\tif (!u)", "\t\treturn v;"]
+        if composite:
+            lines.append(f"\tunsigned r = u & {keep:#x}u;" if keep else "\tunsigned r = 0;")
+            for src, dst in composite:
+                # Multi-bit values first, their bits are not looked up again
+                lines.append(f"\tif ((u & {src:#x}u) == {src:#x}u) r |= {dst:#x}u, u &= ~{src:#x}u;")
+            terms = ["r"]
+        else:
+            terms = [f"(u & {keep:#x}u)"] if keep else []
+        for n, (shift, width, table) in enumerate(chunks):
+            terms.append(f"{func}_tab{n}[u >> {shift} & {(1 << width) - 1:#x}]" if shift
+                         else f"{func}_tab{n}[u & {(1 << width) - 1:#x}]")
+        expression = ' |\n\t\t     '.join(terms) or '0'
+        lines.append(f"\treturn (int)({expression});")
+        lines.append("}")
+        return '\n'.join(lines) + '\n'
+
+    # Translation of single values
+
+    def _emit_values(self, forward: bool) -> str:
+        direction = "to_linux" if forward else "from_linux"
+        func = f"qnx_const_{self.name}_{direction}"
+        mapping = {}
+        for name, q, l in self.pairs if forward else self.reverse_pairs:
+            src, dst = (q, l) if forward else (l, q)
+            mapping.setdefault(src, dst)
+        if self.unmapped_value is not None:
+            fallback_value = self.unmapped_value if forward else next(
+                (q for _, q, l in self.pairs if l == self.unmapped_value), self.unmapped_value)
+            fallback = str(fallback_value)
+        else:
+            fallback_value, fallback = None, "v"
+        top = max(mapping, default=-1) + 1
+        if top <= MAX_TABLE:
+            table = [mapping.get(i, i if fallback_value is None else fallback_value) for i in range(top)]
+            return (f"static const {_c_type(table)} {func}_tab[{top}] = {{\n{_array(table)}\n}};\n"
+                    f"static inline int {func}(int v)\n{{\n"
+                    f"\treturn (unsigned)v < {top}u ? {func}_tab[v] : {fallback};\n}}\n")
+        cases = ''.join(f"\tcase {src}: return {dst};\n" for src, dst in sorted(mapping.items()) if src != dst
+                        or fallback_value is not None)
+        return (f"static inline int {func}(int v)\n{{\n\tswitch (v) {{\n{cases}"
+                f"\t}}\n\treturn {fallback};\n}}\n")
+
+    def emit(self) -> str:
+        header = [f"/* {self.name}: {len(self.pairs)} constants, generated from the QNX and musl headers */"]
+        if self.qnx_only:
+            header.append(f"/* QNX only ({'passed through' if self.unmapped == 'pass' else 'dropped'}): "
+                          f"{', '.join(self.qnx_only)} */")
+        for problem in self.problems:
+            header.append(f"/* TODO: {problem} */")
+        if self.identity:
+            body = (f"/* Identical on both sides */\n"
+                    f"#define QNX_CONST_{self.name.upper()}_IDENTITY 1\n"
+                    f"static inline int qnx_const_{self.name}_to_linux(int v) {{ return v; }}\n"
+                    f"static inline int qnx_const_{self.name}_from_linux(int v) {{ return v; }}\n")
+        elif self.kind == "flags":
+            body = self._emit_flags(True) + self._emit_flags(False)
+        else:
+            body = self._emit_values(True) + self._emit_values(False)
+        return '\n'.join(header) + '\n' + body
+
+def generate_constant_header(families: List[ConstantFamily], guard: str = "QNX_CONSTANTS_H") -> str:
+    parts = [f"#ifndef {guard}", f"#define {guard}", "",
+             "/* Generated by glue_generator/constant_tables.py - do not edit */", ""]
+    for family in families:
+        parts.append(family.emit())
+    parts.append("#endif")
+    return '\n'.join(parts) + '\n'
+
+def load_families(config: Dict[str, Any]) -> List[ConstantFamily]:
+    """processing_settings.glue.constant_tables.families (default DEFAULT_FAMILIES) over both header trees"""
+    qnx, linux = macro_tables(config)
+    specs = config.get("processing_settings", {}).get("glue", {}).get("constant_tables", {}).get(
+        "families") or DEFAULT_FAMILIES
+    return [ConstantFamily(spec, qnx, linux) for spec in specs]
+
+def main():
+    """Write the constant translation header"""
+    import argparse
+
+    parser = argparse.ArgumentParser(description='Generate QNX <-> musl constant translation tables')
+    parser.add_argument('--config', '-c', default='config.json', help='Configuration file path')
+    parser.add_argument('--output', '-o', help='Header to write (default: processing_settings.glue.constant_tables.output)')
+    args = parser.parse_args()
+
+    logging.basicConfig(level=logging.INFO, format='%(asctime)s - %(levelname)s - %(message)s')
+    try:
+        with open(args.config, 'r', encoding='utf-8') as f:
+            config = json.load(f)
+    except Exception as e:
+        logger.warning(f"Failed to load config file: {e}")
+        config = {}
+
+    families = load_families(config)
+    output = args.output or config.get("processing_settings", {}).get("glue", {}).get(
+        "constant_tables", {}).get("output", "./data/qnx_constants.h")
+    Path(output).parent.mkdir(parents=True, exist_ok=True)
+    with open(output, 'w', encoding='utf-8') as f:
+        f.write(generate_constant_header(families))
+    for family in families:
+        logger.info(f"{family.name}: {len(family.pairs)} constants, "
+                    f"{'identity' if family.identity else family.kind}, {len(family.qnx_only)} QNX only")
+    logger.info(f"Constant tables written to {output}")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -16,6 +16,7 @@ glue code generation process:
 import asyncio
 import json
 import logging
+import time
 from typing import Dict, List, Optional, Any, Union
 from dataclasses import dataclass, asdict
 from enum import Enum
@@ -39,12 +40,14 @@ except ImportError:
         from src.core.mcp_client import QNXMCPClient, LinuxMCPClient
     except ImportError:
         class QNXMCPClient:
+            def __init__(self, *args, **kwargs): pass
             async def connect(self): pass
             async def disconnect(self): pass
             async def get_function_info(self, name): return {"error": "No QNX MCP"}
             async def call_tool(self, tool, params): return {"error": "No QNX MCP"}
         
         class LinuxMCPClient:
+            def __init__(self, *args, **kwargs): pass
             async def connect(self): pass
             async def disconnect(self): pass
             async def get_function_info(self, name): return {"error": "No Linux MCP"}
@@ -105,9 +108,14 @@ class IntelligentGlueAgent:
         """Initialize the intelligent agent"""
         self.config = self._load_config(config_path)
         
-        # MCP clients
-        self.qnx_client = QNXMCPClient()
-        self.linux_client = LinuxMCPClient()
+        # MCP clients: each keeps its server processes alive for the whole run
+        glue_config = self.config.get("processing_settings", {}).get("glue", {})
+        mcp_options = glue_config.get("mcp", {})
+        self.qnx_client = QNXMCPClient(**mcp_options)
+        self.linux_client = LinuxMCPClient(**mcp_options)
+        self.lookup_concurrency = glue_config.get("max_concurrency", 8)
+        self.batch_size = max(1, glue_config.get("batch_size", 8))
+        self._function_info: Dict[Any, Dict[str, Any]] = {}
         
         # LangGraph setup
         self.graph = None
@@ -192,22 +200,16 @@ class IntelligentGlueAgent:
         # Connect to MCP servers
         await self.qnx_client.connect()
         await self.linux_client.connect()
+        self._function_info = {}
         
         try:
-            for func_name in functions:
-                logger.info(f"Processing function: {func_name}")
-                
-                if LANGGRAPH_AVAILABLE:
-                    result = await self._process_function_with_langgraph(func_name)
-                else:
-                    result = await self._process_function_simple(func_name)
-                
-                if result.get("success"):
-                    results["completed"].append(func_name)
-                    logger.info(f"Successfully processed: {func_name}")
-                else:
-                    results["failed"].append(func_name)
-                    logger.error(f"Failed to process: {func_name} - {result.get('error')}")
+            if LANGGRAPH_AVAILABLE and self.graph:
+                await self._prefetch_function_info(functions)
+                for func_name in functions:
+                    logger.info(f"Processing function: {func_name}")
+                    self._record_result(results, func_name, await self._process_function_with_langgraph(func_name))
+            else:
+                await self._process_pipelined(functions, results)
             
             results["summary"] = {
                 "success_rate": len(results["completed"]) / len(functions),
@@ -221,6 +223,93 @@ class IntelligentGlueAgent:
         
         return results
     
+    @staticmethod
+    def _record_result(results: Dict[str, Any], func_name: str, result: Dict[str, Any]):
+        if result.get("success"):
+            results["completed"].append(func_name)
+            logger.info(f"Successfully processed: {func_name}")
+        else:
+            results["failed"].append(func_name)
+            logger.error(f"Failed to process: {func_name} - {result.get('error')}")
+    
+    async def _process_pipelined(self, functions: List[str], results: Dict[str, Any]):
+        """Plan the next batch (lookups and code generation) while the current one is applied and compiled
+        
+        Planning is concurrent within a batch and touches no files, so it
+        overlaps with the dynlink edits and musl builds, which run one
+        function at a time in the original order.
+        """
+        batches = [functions[i:i + self.batch_size] for i in range(0, len(functions), self.batch_size)]
+        if not batches:
+            return
+        planning = asyncio.create_task(self._plan_batch(batches[0]))
+        try:
+            for index, batch in enumerate(batches):
+                plans = await planning
+                if index + 1 < len(batches):
+                    planning = asyncio.create_task(self._plan_batch(batches[index + 1]))
+                started = time.monotonic()
+                for func_name in batch:
+                    logger.info(f"Processing function: {func_name}")
+                    self._record_result(results, func_name, await self._apply_plan(func_name, plans[func_name]))
+                logger.info(f"Applied batch {index + 1}/{len(batches)} ({len(batch)} functions) "
+                            f"in {time.monotonic() - started:.1f}s")
+        finally:
+            if not planning.done():
+                planning.cancel()
+    
+    async def _plan_batch(self, batch: List[str]) -> Dict[str, Dict[str, Any]]:
+        """func_name -> glue plan (or {"error"}) for a batch, every function planned concurrently"""
+        started = time.monotonic()
+        await self._prefetch_function_info(batch)
+        semaphore = asyncio.Semaphore(self.lookup_concurrency)
+        
+        async def plan(func_name):
+            async with semaphore:
+                try:
+                    return await self._plan_function(func_name)
+                except Exception as e:
+                    logger.error(f"Error planning function {func_name}: {e}")
+                    return {"error": str(e)}
+        
+        plans = await asyncio.gather(*(plan(func_name) for func_name in batch))
+        logger.info(f"Planned {len(batch)} functions in {time.monotonic() - started:.1f}s")
+        return dict(zip(batch, plans))
+    
+    async def _prefetch_function_info(self, functions: List[str]):
+        """Look functions up on both servers concurrently and warm the type layouts their prototypes use
+        
+        The per-function steps reuse the answers.
+        """
+        semaphore = asyncio.Semaphore(self.lookup_concurrency)
+        
+        async def lookup(client, func_name):
+            async with semaphore:
+                await self._get_function_info(client, func_name)
+        
+        await asyncio.gather(*(lookup(client, func_name) for func_name in functions
+                               for client in (self.qnx_client, self.linux_client)), return_exceptions=True)
+        logger.info(f"Looked up {len(functions)} functions on the QNX and Linux MCP servers")
+        
+        qnx_infos = {}
+        for func_name in functions:
+            qnx_info = self._function_info.get((id(self.qnx_client), func_name))
+            if qnx_info and "error" not in qnx_info:
+                qnx_infos[func_name] = qnx_info
+        if qnx_infos:
+            layouts = await self.linux_client.call_tool("prefetch_type_layouts", {"qnx_infos": json.dumps(qnx_infos)})
+            if layouts and "error" not in layouts:
+                logger.info(f"Prefetched {layouts.get('types', 0)} type layouts, "
+                            f"{len(layouts.get('differing', []))} differ between QNX and musl")
+            else:
+                logger.debug(f"Type layout prefetch failed: {(layouts or {}).get('error')}")
+    
+    async def _get_function_info(self, client, func_name: str) -> Dict[str, Any]:
+        key = (id(client), func_name)
+        if key not in self._function_info:
+            self._function_info[key] = await client.get_function_info(func_name)
+        return self._function_info[key]
+    
     async def _process_function_with_langgraph(self, func_name: str) -> Dict[str, Any]:
         """Process single function using LangGraph"""
         if not self.graph:
@@ -251,32 +340,53 @@ class IntelligentGlueAgent:
     async def _process_function_simple(self, func_name: str) -> Dict[str, Any]:
         """Simple processing without LangGraph"""
         try:
-            # Step 1: Analyze QNX function
-            logger.info(f"Analyzing QNX function: {func_name}")
-            qnx_info = await self.qnx_client.get_function_info(func_name)
-            
-            if not qnx_info or "error" in qnx_info:
-                return {"success": False, "error": f"QNX function {func_name} not found"}
-            
-            # Step 2: Analyze Linux function
-            logger.info(f"Analyzing Linux function: {func_name}")
-            linux_info = await self.linux_client.get_function_info(func_name)
-            
-            # Step 3: Generate glue code
-            logger.info(f"Generating glue code for: {func_name}")
-            glue_plan = await self.linux_client.call_tool("generate_qnx_glue_code", {
-                "qnx_func": func_name,
-                "qnx_info": json.dumps(qnx_info)
-            })
+            glue_plan = await self._plan_function(func_name)
+        except Exception as e:
+            logger.error(f"Error processing function {func_name}: {e}")
+            return {"success": False, "error": str(e)}
+        return await self._apply_plan(func_name, glue_plan)
+    
+    async def _plan_function(self, func_name: str) -> Dict[str, Any]:
+        """Steps 1-3: look the function up on both servers and generate its glue plan"""
+        # Step 1: Analyze QNX function
+        logger.info(f"Analyzing QNX function: {func_name}")
+        qnx_info = await self._get_function_info(self.qnx_client, func_name)
+        
+        if not qnx_info or "error" in qnx_info:
+            return {"error": f"QNX function {func_name} not found"}
+        
+        # Step 2: Analyze Linux function
+        logger.info(f"Analyzing Linux function: {func_name}")
+        linux_info = await self._get_function_info(self.linux_client, func_name)
+        
+        # Step 3: Generate glue code
+        logger.info(f"Generating glue code for: {func_name}")
+        glue_plan = await self.linux_client.call_tool("generate_qnx_glue_code", {
+            "qnx_func": func_name,
+            "qnx_info": json.dumps(qnx_info)
+        })
+        
+        if not glue_plan or "error" in glue_plan:
+            return {"error": f"Failed to generate glue code for {func_name}"}
+        return glue_plan
+    
+    async def _apply_plan(self, func_name: str, glue_plan: Dict[str, Any]) -> Dict[str, Any]:
+        """Steps 4-5: apply a glue plan to the musl tree and rebuild it"""
+        try:
+            if "error" in glue_plan:
+                return {"success": False, "error": glue_plan["error"]}
             
-            if not glue_plan or "error" in glue_plan:
-                return {"success": False, "error": f"Failed to generate glue code for {func_name}"}
+            if glue_plan.get("zero_cost"):
+                # Identical ABI: nothing to write, nothing to rebuild
+                logger.info(f"{func_name} needs no glue code, QNX binaries bind the musl symbol")
+                return {"success": True, "error": None, "generated_code": "", "zero_cost": True}
             
             # Step 4: Modify dynlink if needed
             if glue_plan.get("needs_dynlink_modification"):
                 logger.info(f"Modifying dynlink.c for: {func_name}")
                 dynlink_result = await self.linux_client.call_tool("modify_dynlink", {
-                    "additions": glue_plan.get("dynlink_addition", "")
+                    "additions": glue_plan.get("dynlink_addition", ""),
+                    "target_file": glue_plan.get("qnx_support_file", "")
                 })
                 
                 if "error" in dynlink_result:
@@ -284,23 +394,47 @@ class IntelligentGlueAgent:
             
             # Step 5: Compile and test
             logger.info(f"Compiling musl library...")
-            compile_result = await self.linux_client.call_tool("compile_musl", {})
+            compile_result = await self.linux_client.call_tool("compile_musl", {
+                "changed_files": glue_plan.get("qnx_support_file") or ""
+            })
             
             success = compile_result.get("success", False)
             if not success:
                 logger.error(f"Compilation failed: {compile_result.get('stderr', '')}")
             
+            # Step 6: Time the wrapper against the musl function it wraps
+            benchmark = await self._benchmark_shim(func_name, glue_plan) if success else None
+            error = None if success else compile_result.get("stderr")
+            if benchmark and not benchmark.get("accepted", True):
+                success, error = False, self._budget_error(func_name, benchmark)
+            
             return {
                 "success": success,
-                "error": None if success else compile_result.get("stderr"),
+                "error": error,
                 "generated_code": glue_plan.get("glue_code"),
-                "compilation_result": compile_result
+                "compilation_result": compile_result,
+                "benchmark": benchmark
             }
             
         except Exception as e:
             logger.error(f"Error processing function {func_name}: {e}")
             return {"success": False, "error": str(e)}
     
+    async def _benchmark_shim(self, func_name: str, glue_plan: Dict[str, Any]) -> Optional[Dict[str, Any]]:
+        """The overhead budget check of a wrapper built by compile_musl, None for plans without a benchmark"""
+        if not glue_plan.get("benchmark"):
+            return None
+        return await self.linux_client.call_tool("benchmark_shim", {
+            "qnx_func": func_name,
+            "source": glue_plan["benchmark"]
+        })
+    
+    @staticmethod
+    def _budget_error(func_name: str, benchmark: Dict[str, Any]) -> str:
+        return (f"_qnx_{func_name} is over its overhead budget: {benchmark.get('shim_ns')} ns against "
+                f"{benchmark.get('musl_ns')} ns for {func_name}, {benchmark.get('allowed_ns')} ns allowed; "
+                f"avoid heap allocations, extra system calls and copies on this path")
+    
     # LangGraph node functions
     async def _analyze_qnx_function(self, state: GlueGenerationState) -> GlueGenerationState:
         """Analyze QNX function"""
@@ -308,7 +442,7 @@ class IntelligentGlueAgent:
             func_name = state.current_function
             logger.info(f"LangGraph: Analyzing QNX function {func_name}")
             
-            qnx_info = await self.qnx_client.get_function_info(func_name)
+            qnx_info = await self._get_function_info(self.qnx_client, func_name)
             state.qnx_function_info = qnx_info
             state.current_state = AgentState.ANALYZE_LINUX
             
@@ -326,7 +460,7 @@ class IntelligentGlueAgent:
             func_name = state.current_function
             logger.info(f"LangGraph: Analyzing Linux function {func_name}")
             
-            linux_info = await self.linux_client.get_function_info(func_name)
+            linux_info = await self._get_function_info(self.linux_client, func_name)
             state.linux_function_info = linux_info
             state.current_state = AgentState.GENERATE_CODE
             
@@ -375,7 +509,8 @@ class IntelligentGlueAgent:
                 logger.info(f"LangGraph: Modifying dynlink.c")
                 
                 result = await self.linux_client.call_tool("modify_dynlink", {
-                    "additions": state.dynlink_modifications
+                    "additions": state.dynlink_modifications,
+                    "target_file": (state.glue_plan or {}).get("qnx_support_file", "")
                 })
                 
                 if "error" in result:
@@ -393,11 +528,30 @@ class IntelligentGlueAgent:
     async def _compile_and_test(self, state: GlueGenerationState) -> GlueGenerationState:
         """Compile and test the changes"""
         try:
+            if (state.glue_plan or {}).get("zero_cost"):
+                state.compilation_result = {"success": True, "skipped": "zero_cost"}
+                state.success = True
+                state.current_state = AgentState.COMPLETE
+                state.completed_functions.append(state.current_function)
+                logger.info(f"No glue code needed for {state.current_function}")
+                return state
+            
             logger.info(f"LangGraph: Compiling musl library")
             
-            compile_result = await self.linux_client.call_tool("compile_musl", {})
+            compile_result = await self.linux_client.call_tool("compile_musl", {
+                "changed_files": (state.glue_plan or {}).get("qnx_support_file") or ""
+            })
             state.compilation_result = compile_result
             
+            benchmark = await self._benchmark_shim(state.current_function, state.glue_plan or {}) \
+                if compile_result.get("success") else None
+            if benchmark and not benchmark.get("accepted", True):
+                # Regenerate with the budget overrun as the error to fix
+                compile_result = dict(compile_result, success=False,
+                                      stderr=self._budget_error(state.current_function, benchmark),
+                                      benchmark=benchmark)
+                state.compilation_result = compile_result
+            
             if compile_result.get("success"):
                 state.success = True
                 state.current_state = AgentState.COMPLETE
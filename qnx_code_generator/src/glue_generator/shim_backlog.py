@@ -0,0 +1,219 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Shim Backlog
+
+Ranks the QNX functions that still need a shim by what the QOL runs
+measured: the programs each missing function blocks (the loader's
+LD_QNX_CENSUS lines, as collected by qol/batch.sh) and how often the
+census trampolines were called (LD_QNX_CENSUS_TABLE files), so glue
+generation starts with the shims that unblock the most of the binaries
+actually run.
+"""
+
+import asyncio
+import json
+import logging
+import struct
+import sys
+from dataclasses import asdict, dataclass
+from pathlib import Path
+from typing import Any, Dict, List, Optional, Set
+
+logger = logging.getLogger(__name__)
+
+# LD_QNX_CENSUS_TABLE layout, as read by qol/census.py (census_init in musl/ldso/dynlink.c)
+CENSUS_MAGIC = b"qnxcns1\0"
+CENSUS_HEADER = struct.Struct("<8sii48x")
+CENSUS_ENTRY = struct.Struct("<i4x64s120s320s")
+
+def _cstr(b: bytes) -> str:
+    return b.split(b"\0", 1)[0].decode(errors="replace")
+
+def read_census_table(path: str) -> Dict[str, int]:
+    """symbol -> calls through its census trampoline, summed over the libraries referencing it"""
+    data = Path(path).read_bytes()
+    magic, _, count = CENSUS_HEADER.unpack_from(data)
+    if magic != CENSUS_MAGIC:
+        raise ValueError(f"{path}: not a census table")
+    calls: Dict[str, int] = {}
+    for i in range(count):
+        entry_calls, _, name, _ = CENSUS_ENTRY.unpack_from(data, CENSUS_HEADER.size + i * CENSUS_ENTRY.size)
+        name = _cstr(name)
+        calls[name] = calls.get(name, 0) + entry_calls
+    return calls
+
+def read_census_log(path: str) -> Set[str]:
+    """Functions a program's LD_QNX_CENSUS output reports missing ("qnxcensus missing <dso> <sym> func")"""
+    missing = set()
+    with open(path, 'r', encoding='utf-8', errors='replace') as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) >= 5 and fields[:2] == ["qnxcensus", "missing"] and fields[4] == "func":
+                missing.add(fields[3])
+    return missing
+
+def read_batch_dir(path: str) -> Dict[str, Set[str]]:
+    """program -> missing functions of a qol/batch.sh output directory
+
+    The per-program logs say which symbols are functions; missing.txt
+    ("<program> <symbol>", data symbols included) is the fallback when the
+    logs are gone.
+    """
+    directory = Path(path)
+    logs = sorted((directory / "logs").glob("*.log"))
+    if logs:
+        return {log.stem: read_census_log(str(log)) for log in logs}
+    blocked: Dict[str, Set[str]] = {}
+    with open(directory / "missing.txt", 'r', encoding='utf-8') as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) == 2:
+                blocked.setdefault(fields[0], set()).add(fields[1])
+    return blocked
+
+@dataclass
+class BacklogEntry:
+    """One function to shim, with the numbers it was ranked by"""
+    function: str
+    programs: int       # programs that reference it and do not load without it
+    calls: int          # calls through its census trampoline
+    score: int          # programs * (calls + 1)
+    unblocked: int      # programs that load once this and every function ranked above it exist
+
+class ShimBacklog:
+    """Missing functions per program plus trampoline call counts, ranked into a work queue"""
+
+    def __init__(self, blocked: Optional[Dict[str, Set[str]]] = None, calls: Optional[Dict[str, int]] = None,
+                 exclude: Optional[Set[str]] = None):
+        self.blocked: Dict[str, Set[str]] = {}
+        self.calls: Dict[str, int] = {}
+        self.exclude = set(exclude or ())
+        self.add_programs(blocked or {})
+        self.add_calls(calls or {})
+
+    @classmethod
+    def from_config(cls, config: Dict[str, Any]) -> "ShimBacklog":
+        """processing_settings.glue.backlog: {"batch_dirs", "census_tables", "exclude"}"""
+        backlog_config = config.get("processing_settings", {}).get("glue", {}).get("backlog", {})
+        backlog = cls(exclude=set(backlog_config.get("exclude") or ()))
+        for path in backlog_config.get("batch_dirs") or []:
+            backlog.add_batch_dir(path)
+        for path in backlog_config.get("census_tables") or []:
+            backlog.add_census_table(path)
+        return backlog
+
+    def add_programs(self, blocked: Dict[str, Set[str]]):
+        for program, functions in blocked.items():
+            self.blocked.setdefault(program, set()).update(functions)
+
+    def add_calls(self, calls: Dict[str, int]):
+        for name, count in calls.items():
+            self.calls[name] = self.calls.get(name, 0) + count
+
+    def add_batch_dir(self, path: str):
+        try:
+            self.add_programs(read_batch_dir(path))
+        except OSError as e:
+            logger.warning(f"Skipping batch output {path}: {e}")
+
+    def add_census_table(self, path: str):
+        try:
+            self.add_calls(read_census_table(path))
+        except (OSError, ValueError, struct.error) as e:
+            logger.warning(f"Skipping census table {path}: {e}")
+
+    def rank(self, limit: Optional[int] = None) -> List[BacklogEntry]:
+        """Functions by programs blocked x (trampoline calls + 1), most valuable first
+
+        The +1 keeps functions that were never called in the ranking: musl
+        binds eagerly, so a program does not start while any of its
+        functions is missing, called or not. Functions that only appear in
+        census tables count as blocking no program.
+        """
+        programs: Dict[str, int] = {}
+        for functions in self.blocked.values():
+            for name in functions:
+                programs[name] = programs.get(name, 0) + 1
+        names = (set(programs) | set(self.calls)) - self.exclude
+        order = sorted(names, key=lambda n: (-programs.get(n, 0) * (self.calls.get(n, 0) + 1),
+                                             -programs.get(n, 0), -self.calls.get(n, 0), n))
+        if limit:
+            order = order[:limit]
+
+        # Programs left blocked after each step: those still missing a function not yet ranked
+        remaining = {program: set(functions) - self.exclude for program, functions in self.blocked.items()}
+        waiting: Dict[str, List[str]] = {}
+        for program, functions in remaining.items():
+            for name in functions:
+                waiting.setdefault(name, []).append(program)
+        unblocked = sum(1 for functions in remaining.values() if not functions)
+        entries = []
+        for name in order:
+            for program in waiting.get(name, []):
+                remaining[program].discard(name)
+                if not remaining[program]:
+                    unblocked += 1
+            entries.append(BacklogEntry(name, programs.get(name, 0), self.calls.get(name, 0),
+                                        programs.get(name, 0) * (self.calls.get(name, 0) + 1), unblocked))
+        return entries
+
+def main():
+    """Print the ranked shim backlog, optionally generating glue code in that order"""
+    import argparse
+
+    parser = argparse.ArgumentParser(description='Rank missing QNX functions by programs blocked and calls')
+    parser.add_argument('--config', '-c', default='config.json', help='Configuration file path')
+    parser.add_argument('--batch-dir', action='append', default=[], help='qol/batch.sh output directory')
+    parser.add_argument('--table', action='append', default=[], help='LD_QNX_CENSUS_TABLE file')
+    parser.add_argument('--limit', '-n', type=int, default=0, help='Keep only the N highest ranked functions')
+    parser.add_argument('--functions-file', help='Write the ranked names here (for main.py --functions-file)')
+    parser.add_argument('--generate', metavar='OUTPUT', help='Write glue code for the ranked functions to OUTPUT')
+    parser.add_argument('--json', action='store_true', help='Print the ranking as JSON')
+    args = parser.parse_args()
+
+    logging.basicConfig(level=logging.INFO, format='%(asctime)s - %(levelname)s - %(message)s')
+    try:
+        with open(args.config, 'r', encoding='utf-8') as f:
+            config = json.load(f)
+    except Exception as e:
+        logger.warning(f"Failed to load config file: {e}")
+        config = {}
+
+    backlog = ShimBacklog.from_config(config)
+    for path in args.batch_dir:
+        backlog.add_batch_dir(path)
+    for path in args.table:
+        backlog.add_census_table(path)
+    entries = backlog.rank(args.limit or config.get("processing_settings", {}).get("glue", {}).get(
+        "backlog", {}).get("limit"))
+    if not entries:
+        logger.error("No missing functions: pass --batch-dir or --table, or set processing_settings.glue.backlog")
+        return 1
+
+    if args.json:
+        print(json.dumps([asdict(e) for e in entries], indent=2))
+    else:
+        print(f"{'score':>10} {'programs':>8} {'calls':>10} {'unblocked':>9}  function")
+        for e in entries:
+            print(f"{e.score:10d} {e.programs:8d} {e.calls:10d} {e.unblocked:9d}  {e.function}")
+    if args.functions_file:
+        Path(args.functions_file).write_text(''.join(e.function + '\n' for e in entries), encoding='utf-8')
+
+    if args.generate:
+        try:
+            from .code_generator import GlueCodeGenerator
+        except ImportError:
+            from code_generator import GlueCodeGenerator
+        generator = GlueCodeGenerator(args.config)
+        results = asyncio.run(generator.generate_backlog_glue_code(backlog, args.limit or None))
+        output = Path(args.generate)
+        output.parent.mkdir(parents=True, exist_ok=True)
+        output.write_text(results["header_code"] + results["converter_code"] + results["function_code"],
+                          encoding='utf-8')
+        logger.info(f"Glue code for {results['statistics']['successful_migrations']} of {len(entries)} "
+                    f"functions written to {output}")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,259 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Shim Sandbox Pool
+
+Validates candidate glue code in parallel: each worker sandbox compiles a
+candidate shim with musl's own flags, relinks its private libc.so from the
+prebuilt musl objects, and runs the QNX test binary against it.
+"""
+
+import asyncio
+import json
+import logging
+import os
+import re
+import shlex
+import shutil
+import sys
+import time
+from pathlib import Path
+from typing import Any, Dict, List, Optional, Tuple
+
+sys.path.insert(0, str(Path(__file__).resolve().parent.parent))
+from core.compiler_diagnostics import parse_compiler_diagnostics
+
+logger = logging.getLogger(__name__)
+
+class ShimSandboxPool:
+    """A fixed set of warm sandboxes that compile, relink and test shims
+
+    prepare() brings musl's object tree up to date once and records, from a
+    make dry run, the compile command of every object and the libc.so link
+    command. After that a candidate costs one compile and one link: the
+    shim's object takes the place of the object it replaces (or is added),
+    while all other objects are shared read-only from the musl tree.
+    """
+
+    def __init__(self, musl_path: str, root: str = "./data/shim_sandboxes", workers: int = 4,
+                 test_binary: Optional[str] = None, test_command: Optional[List[str]] = None,
+                 compile_timeout: float = 60, test_timeout: float = 30, build_jobs: int = 0):
+        self.musl_path = os.path.abspath(musl_path)
+        self.root = Path(root).resolve()
+        self.workers = max(1, workers)
+        self.test_binary = test_binary
+        # {libc}, {binary}, {function} and {sandbox} are filled in per run
+        self.test_command = test_command or ["{libc}", "{binary}", "{function}"]
+        self.compile_timeout = compile_timeout
+        self.test_timeout = test_timeout
+        self.build_jobs = build_jobs or os.cpu_count() or 1
+
+        self.compile_commands: Dict[str, List[str]] = {}  # object -> argv
+        self.link_command: List[str] = []
+        self._free: Optional[asyncio.Queue] = None
+        self._prepare_lock = asyncio.Lock()
+        self._prepared = False
+
+    @classmethod
+    def from_config(cls, config: Dict[str, Any]) -> "ShimSandboxPool":
+        """linux_system.sandbox: {"root", "workers", "test_binary", "test_command", "compile_timeout", "test_timeout"}"""
+        linux_config = config.get("linux_system", {})
+        sandbox_config = linux_config.get("sandbox", {})
+        return cls(linux_config.get("musl_source_path", "../qol/musl"),
+                   sandbox_config.get("root", "./data/shim_sandboxes"),
+                   sandbox_config.get("workers", 4),
+                   sandbox_config.get("test_binary"),
+                   sandbox_config.get("test_command"),
+                   sandbox_config.get("compile_timeout", 60),
+                   sandbox_config.get("test_timeout", 30),
+                   linux_config.get("build_jobs", 0))
+
+    async def _run(self, argv: List[str], timeout: float, cwd: Optional[str] = None) -> Tuple[Optional[int], str, str]:
+        """(return code, stdout, stderr); None as return code on timeout"""
+        process = await asyncio.create_subprocess_exec(
+            *argv, cwd=cwd or self.musl_path,
+            stdout=asyncio.subprocess.PIPE, stderr=asyncio.subprocess.PIPE)
+        try:
+            stdout, stderr = await asyncio.wait_for(process.communicate(), timeout=timeout)
+        except asyncio.TimeoutError:
+            process.kill()
+            await process.wait()
+            return None, "", ""
+        return process.returncode, stdout.decode('utf-8', 'replace'), stderr.decode('utf-8', 'replace')
+
+    async def prepare(self) -> bool:
+        """Build the musl objects and record the build commands (once per pool)"""
+        async with self._prepare_lock:
+            if self._prepared:
+                return True
+            if not os.path.exists(os.path.join(self.musl_path, "config.mak")):
+                logger.error(f"config.mak not found in {self.musl_path}, run ./configure first")
+                return False
+
+            returncode, dry_run, stderr = await self._run(['make', '-n', '-B', 'lib/libc.so'], 120)
+            if returncode != 0:
+                logger.error(f"make dry run failed in {self.musl_path}: {stderr[-2000:]}")
+                return False
+            self._parse_dry_run(dry_run)
+            if not self.link_command:
+                logger.error("No libc.so link command in the musl build")
+                return False
+
+            # Objects only: a candidate is what decides whether libc.so links
+            objects = list(self.compile_commands)
+            returncode, _, stderr = await self._run(['make', f'-j{self.build_jobs}', '-k'] + objects, 1800)
+            missing = [o for o in objects if not os.path.exists(os.path.join(self.musl_path, o))]
+            if missing:
+                logger.error(f"{len(missing)} musl objects failed to build, e.g. {missing[:3]}")
+                return False
+
+            self._free = asyncio.Queue()
+            for index in range(self.workers):
+                sandbox = self.root / f"worker-{index}"
+                shutil.rmtree(sandbox, ignore_errors=True)
+                (sandbox / "lib").mkdir(parents=True)
+                self._free.put_nowait(sandbox)
+            self._prepared = True
+            logger.info(f"Shim sandbox pool ready: {self.workers} workers, {len(objects)} musl objects")
+            return True
+
+    def _parse_dry_run(self, output: str):
+        self.compile_commands.clear()
+        self.link_command = []
+        for line in output.replace('\\\n', ' ').splitlines():
+            if '|' in line:
+                continue
+            try:
+                argv = shlex.split(line)
+            except ValueError:
+                continue
+            if '-o' not in argv:
+                continue
+            target = argv[argv.index('-o') + 1]
+            if '-c' in argv and target.startswith('obj/'):
+                self.compile_commands[target] = argv
+            elif target == 'lib/libc.so':
+                self.link_command = argv
+
+    def _object_for(self, source_file: Optional[str]) -> Optional[str]:
+        """The musl object built from a source file (src/qnxsupport/x.c -> obj/src/qnxsupport/x.lo)"""
+        if not source_file:
+            return None
+        relative = os.path.relpath(os.path.abspath(source_file), self.musl_path)
+        target = 'obj/' + os.path.splitext(relative)[0] + '.lo'
+        return target if target in self.compile_commands else None
+
+    def _compile_template(self, replaced: Optional[str]) -> List[str]:
+        """Compile argv of the replaced object, or of a QNX support object for new shims"""
+        if replaced:
+            return self.compile_commands[replaced]
+        for target, argv in self.compile_commands.items():
+            if target.startswith('obj/src/qnxsupport/') and target.endswith('.lo'):
+                return argv
+        return next(argv for target, argv in self.compile_commands.items() if target.endswith('.lo'))
+
+    async def validate(self, candidates: List[Dict[str, Any]]) -> List[Dict[str, Any]]:
+        """Compile, link and test candidates in parallel
+
+        A candidate is {"function", "source"[, "replaces"]}: the complete
+        source of one shim file and, when it is a new version of an existing
+        musl source, that file's path. Results are in candidate order.
+        """
+        if not await self.prepare():
+            return [{"function": c.get("function"), "passed": False, "stage": "prepare",
+                     "error": "sandbox pool could not be prepared"} for c in candidates]
+        return list(await asyncio.gather(*(self._validate_one(c) for c in candidates)))
+
+    async def _validate_one(self, candidate: Dict[str, Any]) -> Dict[str, Any]:
+        sandbox = await self._free.get()
+        try:
+            return await self._run_candidate(sandbox, candidate)
+        except Exception as e:
+            logger.error(f"Sandbox validation of {candidate.get('function')} failed: {e}")
+            return {"function": candidate.get("function"), "passed": False, "stage": "internal", "error": str(e)}
+        finally:
+            self._free.put_nowait(sandbox)
+
+    async def _run_candidate(self, sandbox: Path, candidate: Dict[str, Any]) -> Dict[str, Any]:
+        function = candidate.get("function", "shim")
+        result = {"function": function, "passed": False, "stage": "compile", "sandbox": sandbox.name,
+                  "timings": {}, "diagnostics": []}
+
+        # Compile the shim with the flags musl uses for the object it stands in for
+        replaced = self._object_for(candidate.get("replaces"))
+        source = sandbox / f"{re.sub(r'[^A-Za-z0-9_]', '_', function)}.c"
+        shim_object = sandbox / "shim.lo"
+        source.write_text(candidate["source"], encoding='utf-8')
+        argv = list(self._compile_template(replaced))
+        argv[argv.index('-o') + 1] = str(shim_object)
+        argv[-1] = str(source)
+        start = time.monotonic()
+        returncode, _, stderr = await self._run(argv, self.compile_timeout)
+        result["timings"]["compile"] = round(time.monotonic() - start, 3)
+        result["diagnostics"] = parse_compiler_diagnostics(stderr)
+        if returncode != 0:
+            result["error"] = "compile timed out" if returncode is None else stderr[-4000:]
+            return result
+
+        # Relink a private libc.so: the shim object instead of (or next to) the musl one
+        result["stage"] = "link"
+        libc = sandbox / "lib" / "libc.so"
+        argv = list(self.link_command)
+        argv[argv.index('-o') + 1] = str(libc)
+        if replaced:
+            argv = [a for a in argv if a != replaced]
+        first_object = next(i for i, a in enumerate(argv) if a.endswith('.lo'))
+        argv.insert(first_object, str(shim_object))
+        start = time.monotonic()
+        returncode, _, stderr = await self._run(argv, self.compile_timeout)
+        result["timings"]["link"] = round(time.monotonic() - start, 3)
+        result["diagnostics"] += parse_compiler_diagnostics(stderr)
+        if returncode != 0:
+            result["error"] = "link timed out" if returncode is None else stderr[-4000:]
+            return result
+
+        # Exercise the function with the QNX test binary on the new libc.so
+        result["stage"] = "test"
+        if not self.test_binary:
+            result.update(passed=True, tested=False)
+            return result
+        values = {"libc": str(libc), "binary": self.test_binary, "function": function, "sandbox": str(sandbox)}
+        argv = [part.format(**values) for part in self.test_command]
+        start = time.monotonic()
+        returncode, stdout, stderr = await self._run(argv, self.test_timeout, cwd=str(sandbox))
+        result["timings"]["test"] = round(time.monotonic() - start, 3)
+        result.update(tested=True, passed=returncode == 0, return_code=returncode,
+                      output=(stdout + stderr)[-4000:])
+        if returncode is None:
+            result["error"] = "test timed out"
+        return result
+
+def main():
+    """Validate shim sources from the command line"""
+    import argparse
+
+    parser = argparse.ArgumentParser(description='Compile, relink and test QNX shims in parallel sandboxes')
+    parser.add_argument('sources', nargs='+', help='Shim source files (function name = file name)')
+    parser.add_argument('--config', '-c', default='config.json', help='Configuration file path')
+    parser.add_argument('--replace', action='store_true', help='Each source replaces the musl file of the same path')
+    args = parser.parse_args()
+
+    logging.basicConfig(level=logging.INFO, format='%(asctime)s - %(levelname)s - %(message)s')
+    try:
+        with open(args.config, 'r', encoding='utf-8') as f:
+            config = json.load(f)
+    except Exception as e:
+        logger.warning(f"Failed to load config file: {e}")
+        config = {}
+
+    candidates = []
+    for path in args.sources:
+        with open(path, 'r', encoding='utf-8') as f:
+            candidates.append({"function": Path(path).stem, "source": f.read(),
+                               "replaces": path if args.replace else None})
+    results = asyncio.run(ShimSandboxPool.from_config(config).validate(candidates))
+    print(json.dumps(results, indent=2))
+    return 0 if all(r["passed"] for r in results) else 1
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,243 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Struct Converter Generator
+
+Emits QNX <-> Linux conversion functions from the DWARF layouts of the two
+type indexes instead of hand-written field-by-field copies, together with a
+benchmark that checks each one against a per-field reference.
+"""
+
+import json
+import logging
+import os
+import re
+import subprocess
+import tempfile
+from typing import Any, Callable, Dict, List, Optional
+
+logger = logging.getLogger(__name__)
+
+FLOAT_TYPES = {4: 'float', 8: 'double', 16: 'long double'}
+INT_TYPES = {1: 'int8_t', 2: 'int16_t', 4: 'int32_t', 8: 'int64_t'}
+SIGNED_BASES = {'char', 'signed char', 'short', 'short int', 'int', 'signed', 'signed int', 'long', 'long int',
+                'long long', 'long long int'}
+
+def classify(type_name: str, resolve: Optional[Callable[[str], Optional[Dict[str, Any]]]] = None,
+             depth: int = 0) -> str:
+    """'pointer', 'float', 'sint', 'uint' or 'blob' for a field type of the index"""
+    t = re.sub(r'\b(const|volatile|restrict)\b', '', type_name or '').strip()
+    t = ' '.join(t.split())
+    if t.endswith('*') or '(*' in t:
+        return 'pointer'
+    if '[' in t or t.startswith(('struct ', 'union ')):
+        return 'blob'
+    if t.startswith('enum '):
+        return 'sint'
+    if t in ('float', 'double', 'long double'):
+        return 'float'
+    if 'unsigned' in t or t in ('_Bool', 'bool'):
+        return 'uint'
+    if t in SIGNED_BASES:
+        return 'sint'
+    # A typedef: follow it in the index that described the field
+    entry = resolve(t) if resolve and depth < 8 else None
+    if entry:
+        if entry["kind"] == 'typedef' and entry.get("target"):
+            return classify(entry["target"], resolve, depth + 1)
+        if entry["kind"] in ('struct', 'union'):
+            return 'blob'
+        if entry["kind"] == 'enum':
+            return 'sint'
+    return 'blob'
+
+def plan_conversion(src: Dict[str, Any], dst: Dict[str, Any],
+                    src_resolve: Optional[Callable] = None, dst_resolve: Optional[Callable] = None,
+                    merge: bool = True) -> Dict[str, Any]:
+    """Byte-level operations that turn a src layout into a dst layout
+
+    Fields are matched by name. Same-size fields copy bytes, integers and
+    floats of different widths are converted, and dst fields without a src
+    counterpart are zeroed. With merge, copies whose offset delta stays the
+    same across neighbouring fields (padding included) collapse into one
+    memcpy, so an identical layout becomes a single memcpy and an
+    offset-only difference a few wide moves.
+    """
+    src_fields = {f["name"]: f for f in src.get("fields", []) if f.get("name")}
+    ops, review = [], []
+    for field in sorted(dst.get("fields", []), key=lambda f: f.get("offset") or 0):
+        name, doff, dsize = field.get("name"), field.get("offset"), field.get("size")
+        if doff is None or not dsize:
+            review.append(f"{name}: no offset or size")
+            continue
+        if "bit_size" in field:
+            review.append(f"{name}: bitfield")
+            continue
+        other = src_fields.get(name)
+        if other is None or other.get("offset") is None or not other.get("size") or "bit_size" in other:
+            ops.append({"op": "zero", "dst": doff, "size": dsize, "fields": [name]})
+            if other is not None:
+                review.append(f"{name}: src field has no usable layout")
+            continue
+        skind = classify(other["type"], src_resolve)
+        dkind = classify(field["type"], dst_resolve)
+        if other["size"] == dsize and (skind == dkind or {skind, dkind} <= {'sint', 'uint'}):
+            ops.append({"op": "copy", "dst": doff, "src": other["offset"], "size": dsize, "fields": [name]})
+        elif skind in ('sint', 'uint') and dkind in ('sint', 'uint') or skind == dkind == 'float':
+            ops.append({"op": "convert", "dst": doff, "src": other["offset"], "size": dsize,
+                        "src_size": other["size"], "src_kind": skind, "dst_kind": dkind, "fields": [name]})
+        else:
+            ops.append({"op": "zero", "dst": doff, "size": dsize, "fields": [name]})
+            review.append(f"{name}: {other['type']} ({other['size']}) -> {field['type']} ({dsize})")
+
+    if merge:
+        # A gap between two operations may only be padding, never a field left out above
+        starts = sorted(f["offset"] for f in dst.get("fields", []) if f.get("offset") is not None)
+        
+        def gap_is_padding(last, op) -> bool:
+            return not any(last["dst"] + last["size"] <= o < op["dst"] for o in starts)
+        
+        merged = []
+        for op in ops:
+            last = merged[-1] if merged else None
+            if last and last["op"] == op["op"] == "copy" and op["dst"] >= last["dst"] + last["size"] \
+                    and op["dst"] - last["dst"] == op["src"] - last["src"] and gap_is_padding(last, op):
+                last["size"] = op["dst"] + op["size"] - last["dst"]
+                last["fields"] += op["fields"]
+            elif last and last["op"] == op["op"] == "zero" and op["dst"] >= last["dst"] + last["size"] \
+                    and gap_is_padding(last, op):
+                last["size"] = op["dst"] + op["size"] - last["dst"]
+                last["fields"] += op["fields"]
+            else:
+                merged.append(dict(op, fields=list(op["fields"])))
+        ops = merged
+        # The whole object in one go when the layouts are identical
+        if (len(ops) == 1 and ops[0]["op"] == "copy" and ops[0]["dst"] == ops[0]["src"] == 0
+                and src.get("size") == dst.get("size") and dst.get("size")):
+            ops[0]["size"] = dst["size"]
+
+    return {"src": src.get("name"), "dst": dst.get("name"), "src_size": src.get("size"),
+            "dst_size": dst.get("size"), "ops": ops, "review": review}
+
+def _scalar(kind: str, size: int) -> str:
+    if kind == 'float':
+        return FLOAT_TYPES[size]
+    return ('u' if kind == 'uint' else '') + INT_TYPES[size]
+
+def emit_converter(plan: Dict[str, Any], name: str) -> str:
+    """C definition of one converter: void name(const void *src, void *dst)"""
+    lines = [f"/* {plan['src']} ({plan['src_size']} bytes) -> {plan['dst']} ({plan['dst_size']} bytes),"
+             f" generated from the type indexes */"]
+    for note in plan["review"]:
+        lines.append(f"/* TODO: {note} */")
+    lines += [f"static inline void {name}(const void *src, void *dst)", "{",
+              "\tconst unsigned char *s = src;", "\tunsigned char *d = dst;"]
+    for op in plan["ops"]:
+        fields = ', '.join(op["fields"])
+        if op["op"] == "copy":
+            lines.append(f"\tmemcpy(d + {op['dst']}, s + {op['src']}, {op['size']});\t/* {fields} */")
+        elif op["op"] == "zero":
+            lines.append(f"\tmemset(d + {op['dst']}, 0, {op['size']});\t/* {fields} */")
+        else:
+            src_type = _scalar(op["src_kind"], op["src_size"])
+            dst_type = _scalar(op["dst_kind"], op["size"])
+            lines.append(f"\t{{ {src_type} v; memcpy(&v, s + {op['src']}, {op['src_size']}); "
+                         f"{dst_type} w = ({dst_type})v; memcpy(d + {op['dst']}, &w, {op['size']}); }}"
+                         f"\t/* {fields} */")
+    lines.append("}")
+    return '\n'.join(lines) + '\n'
+
+def emit_benchmark(plan: Dict[str, Any], reference: Dict[str, Any], name: str, iterations: int = 10000000) -> str:
+    """C program checking a converter against its per-field reference (plan_conversion(merge=False)) and timing both"""
+    src_size, dst_size = plan["src_size"] or 1, plan["dst_size"] or 1
+    # Merged copies also move padding, so only the bytes the reference writes are compared
+    ranges = ', '.join(f"{{{op['dst']}, {op['size']}}}" for op in reference["ops"]) or "{0, 0}"
+    return f'''#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+{emit_converter(plan, name)}
+{emit_converter(reference, name + "_reference")}
+static double ns_per_call(void (*convert)(const void *, void *), const void *src, void *dst)
+{{
+	struct timespec a, b;
+	clock_gettime(CLOCK_MONOTONIC, &a);
+	for (long i = 0; i < {iterations}L; i++) {{
+		convert(src, dst);
+		__asm__ volatile("" ::: "memory");
+	}}
+	clock_gettime(CLOCK_MONOTONIC, &b);
+	return ((b.tv_sec - a.tv_sec) * 1e9 + (b.tv_nsec - a.tv_nsec)) / {iterations}.0;
+}}
+
+int main(void)
+{{
+	static unsigned char src[{src_size}], dst[{dst_size}], expected[{dst_size}];
+	for (unsigned i = 0; i < sizeof(src); i++)
+		src[i] = (unsigned char)(i * 37 + 11);
+	{name}(src, dst);
+	{name}_reference(src, expected);
+	static const unsigned fields[][2] = {{ {ranges} }};
+	int match = 1;
+	for (unsigned i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+		match &= memcmp(dst + fields[i][0], expected + fields[i][0], fields[i][1]) == 0;
+	double fast = ns_per_call({name}, src, dst);
+	double slow = ns_per_call({name}_reference, src, expected);
+	printf("{{\\"converter\\": \\"{name}\\", \\"match\\": %s, \\"ns_per_call\\": %.3f, "
+	       "\\"reference_ns_per_call\\": %.3f}}\\n", match ? "true" : "false", fast, slow);
+	return !match;
+}}
+'''
+
+def run_benchmark(source: str, compiler: str = "gcc", timeout: float = 120) -> Optional[Dict[str, Any]]:
+    """Compile and run an emitted benchmark on the host; its JSON result, or None"""
+    with tempfile.TemporaryDirectory() as work:
+        c_file = os.path.join(work, "bench.c")
+        binary = os.path.join(work, "bench")
+        with open(c_file, 'w', encoding='utf-8') as f:
+            f.write(source)
+        try:
+            build = subprocess.run([compiler, "-O2", "-o", binary, c_file],
+                                   capture_output=True, text=True, timeout=timeout)
+            if build.returncode != 0:
+                logger.warning(f"Converter benchmark failed to compile: {build.stderr[-2000:]}")
+                return None
+            run = subprocess.run([binary], capture_output=True, text=True, timeout=timeout)
+        except (OSError, subprocess.TimeoutExpired) as e:
+            logger.warning(f"Converter benchmark failed: {e}")
+            return None
+        try:
+            return json.loads(run.stdout.strip().splitlines()[-1])
+        except (ValueError, IndexError):
+            return None
+
+class StructConverterGenerator:
+    """QNX <-> Linux converters for the types both type indexes know"""
+
+    def __init__(self, qnx_index, linux_index):
+        self.qnx_index = qnx_index
+        self.linux_index = linux_index
+
+    def _layout(self, index, type_name: str) -> Optional[Dict[str, Any]]:
+        entry = index.get(type_name) if index else None
+        if not entry or not entry.get("fields") or not entry.get("size"):
+            return None
+        return entry
+
+    def converters(self, type_name: str, ident: str) -> Optional[Dict[str, Any]]:
+        """{"code", "benchmarks", "plans"} of qnx_<ident>_to_linux and linux_<ident>_to_qnx"""
+        qnx = self._layout(self.qnx_index, type_name)
+        linux = self._layout(self.linux_index, type_name)
+        if not qnx or not linux:
+            return None
+        code, benchmarks, plans = [], {}, {}
+        for name, src, dst, src_index, dst_index in (
+                (f"qnx_{ident}_to_linux", qnx, linux, self.qnx_index, self.linux_index),
+                (f"linux_{ident}_to_qnx", linux, qnx, self.linux_index, self.qnx_index)):
+            plan = plan_conversion(src, dst, src_index.get, dst_index.get)
+            reference = plan_conversion(src, dst, src_index.get, dst_index.get, merge=False)
+            code.append(emit_converter(plan, name))
+            benchmarks[name] = emit_benchmark(plan, reference, name)
+            plans[name] = plan
+        return {"code": "\n".join(code), "benchmarks": benchmarks, "plans": plans}
@@ -17,7 +17,7 @@ TOOLS PROVIDED:
 - scan_musl_source: Fallback regex-based source scanning
 - get_linux_function_info: Legacy function info retrieval
 - generate_qnx_glue_code: QNX adaptation code generation
-- modify_dynlink: Automated dynlink.c modifications
+- modify_dynlink: Automated QNX_REDIRECT registration for new shims
 - compile_musl: Build verification and testing
 
 FEATURES:
@@ -30,11 +30,14 @@ FEATURES:
 """
 
 import asyncio
+import codecs
+import inspect
 import logging
 import json
 import os
 import re
 import subprocess
+import sys
 import tempfile
 from typing import Dict, List, Optional, Any, Tuple
 from dataclasses import dataclass, asdict
@@ -47,10 +50,23 @@ from mcp.server import NotificationOptions, Server
 from mcp.types import Resource, Tool, TextContent, ImageContent, EmbeddedResource
 import mcp.types as types
 
+sys.path.insert(0, str(Path(__file__).resolve().parent.parent))
+from core.llm_cache import LLMCache
+from core.compiler_diagnostics import parse_compiler_diagnostics
+from core.abi_compat import AbiComparator, musl_arch
+from core.shim_benchmark import benchmark_settings, emit_shim_benchmark, run_shim_benchmark
+from musl_source_index import MuslSourceCache, MuslSourceIndex, split_parameters
+from musl_debug_index import MuslDebugIndex
+
 # Setup logging
 logging.basicConfig(level=logging.INFO)
 logger = logging.getLogger(__name__)
 
+# Prompt template versions in the LLM cache key: bump one when its prompt
+# or the handling of the answer changes
+ANALYSIS_PROMPT_VERSION = "1"
+CODE_GENERATION_PROMPT_VERSION = "1"
+
 @dataclass
 class LinuxFunctionInfo:
     """Linux function information structure"""
@@ -71,6 +87,7 @@ class LinuxFunctionInfo:
     notes: Optional[str] = None
     function_address: Optional[str] = None
     ai_analysis: Optional[Dict[str, Any]] = None
+    callees: Optional[List[str]] = None
 
 @dataclass
 class QNXGlueCodePlan:
@@ -83,6 +100,9 @@ class QNXGlueCodePlan:
     glue_code: str
     dynlink_addition: Optional[str]  # Code to add to dynlink.c
     confidence: float
+    zero_cost: bool = False  # ABI identical: no wrapper, no QNX_REDIRECT entry
+    abi_differences: Optional[List[str]] = None
+    benchmark: Optional[str] = None  # C microbenchmark of the wrapper against the musl function
 
 class LinuxMuslAnalyzer:
     """Analyzes musl source code and libc.so using GDB"""
@@ -104,10 +124,22 @@ class LinuxMuslAnalyzer:
         # Function database
         self.function_db: Dict[str, LinuxFunctionInfo] = {}
         self.source_index: Dict[str, List[str]] = {}  # file -> function_names
+        # Parsed musl sources, kept across runs and refreshed incrementally
+        self.source_db = MuslSourceIndex(self.config.get("linux_system", {}).get(
+            "source_index_path", "./data/musl_source_index.db"))
+        # Mapped source files and their spans, so extracting a function is a slice
+        self.source_cache = MuslSourceCache(self.config.get("linux_system", {}).get(
+            "source_cache_files", 256))
         
-        # GDB process
+        # GDB/MI session, used for what libc.so's debug index cannot answer
         self.gdb_process = None
-        self.gdb_initialized = False
+        self.gdb_token = 0
+        self.gdb_lock = asyncio.Lock()
+        self.gdb_command_timeout = self.config.get("debug_settings", {}).get("gdb_command_timeout", 10)
+        self.debug_index = MuslDebugIndex(self.libc_path)
+        # Type layouts and flag values of both sides, for functions that need no shim at all
+        self.abi = AbiComparator.from_config(self.config)
+        self.location_cache: Dict[str, Dict[str, Any]] = {}
         self.function_cache: Dict[str, LinuxFunctionInfo] = {}
         
         logger.info(f"Linux musl analyzer initialized with musl path: {self.musl_path}")
@@ -125,6 +157,9 @@ class LinuxMuslAnalyzer:
             # 如果没有单独配置，使用默认AI配置
             self.code_gen_ai_provider = self.ai_provider
             self.code_gen_ai_config = self.ai_config
+        
+        # Persistent LLM answers, shared with the QNX pipeline
+        self.llm_cache = LLMCache.from_config(self.config)
     
     def _load_config(self, config_path: str) -> Dict[str, Any]:
         """Load configuration file"""
@@ -136,8 +171,8 @@ class LinuxMuslAnalyzer:
             return {}
     
     async def scan_musl_source(self) -> Dict[str, int]:
-        """扫描 musl 源码并构建函数索引 (备用方案)"""
-        stats = {"files_scanned": 0, "functions_found": 0, "errors": 0, "method": "regex_fallback"}
+        """扫描 musl 源码并构建函数索引 (只重新解析改动过的文件)"""
+        stats = {"files_scanned": 0, "functions_found": 0, "errors": 0, "method": "source_index"}
         
         if not os.path.exists(self.musl_path):
             logger.error(f"musl source path not found: {self.musl_path}")
@@ -148,28 +183,60 @@ class LinuxMuslAnalyzer:
             logger.error(f"musl src directory not found: {src_path}")
             return stats
         
-        logger.info("Starting musl source scan (regex-based fallback method)")
-        
-        # Scan all C files in src directory
-        for root, dirs, files in os.walk(src_path):
-            for file in files:
-                if file.endswith('.c'):
-                    file_path = os.path.join(root, file)
-                    try:
-                        functions = await self._parse_c_file(file_path)
-                        self.source_index[file_path] = functions
-                        stats["functions_found"] += len(functions)
-                        stats["files_scanned"] += 1
-                        
-                        logger.debug(f"Parsed {file_path}: found {len(functions)} functions")
-                        
-                    except Exception as e:
-                        logger.error(f"Error parsing {file_path}: {e}")
-                        stats["errors"] += 1
+        try:
+            index_stats = await asyncio.to_thread(self.source_db.refresh, src_path)
+        except Exception as e:
+            logger.error(f"Error refreshing musl source index: {e}")
+            stats["errors"] += 1
+            return stats
         
+        stats.update(index_stats)
+        stats["functions_found"] = self.load_source_index()
         logger.info(f"musl source scan complete: {stats}")
         return stats
     
+    def load_source_index(self) -> int:
+        """Fill function_db and source_index from the source index (external functions and their aliases)"""
+        self.function_db.clear()
+        self.source_index.clear()
+        
+        def make_info(entry: Dict[str, Any], name: str, note: Optional[str] = None) -> LinuxFunctionInfo:
+            path = entry["path"]
+            return LinuxFunctionInfo(
+                name=name,
+                signature=entry["signature"],
+                description=f"Function from {os.path.basename(path)}",
+                parameters=split_parameters(entry["parameters"]),
+                return_type=entry["return_type"],
+                return_description="",
+                headers=[],  # TODO: Determine headers
+                source_file=path,
+                source_location=f"{path}:{entry['start_line']}-{entry['end_line']}",
+                source_code=self.source_cache.lines(path, entry["start_line"], entry["end_line"]) or '',
+                library="musl",
+                availability="musl",
+                notes=note,
+                callees=entry["callees"]
+            )
+        
+        definitions = {}
+        for entry in self.source_db.functions(include_static=True):
+            if entry["is_static"]:
+                definitions.setdefault(entry["name"], entry)
+                continue
+            definitions[entry["name"]] = entry
+            self.function_db[entry["name"]] = make_info(entry, entry["name"])
+            self.source_index.setdefault(entry["path"], []).append(entry["name"])
+        
+        for alias in self.source_db.aliases():
+            target = definitions.get(alias["target"])
+            if target and alias["alias"] not in self.function_db:
+                self.function_db[alias["alias"]] = make_info(
+                    target, alias["alias"], f"{alias['kind']} of {alias['target']}")
+                self.source_index.setdefault(alias["path"], []).append(alias["alias"])
+        
+        return len(self.function_db)
+    
     async def batch_smart_analysis(self, func_names: List[str], max_concurrent: int = 5) -> Dict[str, Any]:
         """批量智能分析函数"""
         try:
@@ -184,6 +251,9 @@ class LinuxMuslAnalyzer:
                 }
             }
             
+            # 一次性定位所有函数 (DWARF 索引, 剩下的一个 GDB 批次)
+            await self.locate_functions([name for name in func_names if name not in self.function_cache])
+            
             # 使用信号量限制并发数
             semaphore = asyncio.Semaphore(max_concurrent)
             
@@ -221,92 +291,6 @@ class LinuxMuslAnalyzer:
             logger.error(f"Batch smart analysis failed: {e}")
             return {"error": str(e)}
     
-    async def _parse_c_file(self, file_path: str) -> List[str]:
-        """Parse C file and extract function definitions"""
-        functions = []
-        
-        try:
-            with open(file_path, 'r', encoding='utf-8', errors='ignore') as f:
-                content = f.read()
-            
-            # Find function definitions using regex
-            # Look for pattern: type function_name(parameters) {
-            func_pattern = r'^([a-zA-Z_][a-zA-Z0-9_\s\*]*)\s+([a-zA-Z_][a-zA-Z0-9_]*)\s*\([^)]*\)\s*\{'
-            
-            lines = content.split('\n')
-            for i, line in enumerate(lines):
-                match = re.match(func_pattern, line.strip())
-                if match and not line.strip().startswith('//'):
-                    func_name = match.group(2)
-                    # Skip static functions and macros
-                    if not line.strip().startswith('static') and not line.strip().startswith('#'):
-                        
-                        # Extract full function info
-                        func_info = await self._extract_function_info(content, func_name, file_path, i)
-                        if func_info:
-                            functions.append(func_name)
-                            self.function_db[func_name] = func_info
-        
-        except Exception as e:
-            logger.error(f"Error reading {file_path}: {e}")
-        
-        return functions
-    
-    async def _extract_function_info(self, content: str, func_name: str, file_path: str, line_no: int) -> Optional[LinuxFunctionInfo]:
-        """Extract detailed function information"""
-        try:
-            lines = content.split('\n')
-            
-            # Find function start and end
-            start_line = line_no
-            brace_count = 0
-            end_line = start_line
-            
-            for i in range(start_line, len(lines)):
-                line = lines[i]
-                brace_count += line.count('{') - line.count('}')
-                if brace_count == 0 and '{' in lines[start_line:i+1]:
-                    end_line = i
-                    break
-            
-            # Extract function source code
-            func_source = '\n'.join(lines[start_line:end_line+1])
-            
-            # Parse function signature
-            signature_lines = []
-            for i in range(max(0, start_line-5), start_line+3):
-                if i < len(lines):
-                    signature_lines.append(lines[i])
-            
-            signature = self._parse_function_signature('\n'.join(signature_lines), func_name)
-            
-            return LinuxFunctionInfo(
-                name=func_name,
-                signature=signature,
-                description=f"Function from {os.path.basename(file_path)}",
-                parameters=[],  # TODO: Parse parameters
-                return_type="unknown",  # TODO: Parse return type
-                return_description="",
-                headers=[],  # TODO: Determine headers
-                source_file=file_path,
-                source_location=f"{file_path}:{start_line+1}-{end_line+1}",
-                source_code=func_source,
-                library="musl",
-                availability="musl"
-            )
-            
-        except Exception as e:
-            logger.error(f"Error extracting function info for {func_name}: {e}")
-            return None
-    
-    def _parse_function_signature(self, text: str, func_name: str) -> str:
-        """Parse function signature from text"""
-        lines = text.split('\n')
-        for line in lines:
-            if func_name in line and '(' in line:
-                return line.strip()
-        return f"unknown {func_name}()"
-    
     def extract_function_by_braces(self, content: str, start_line: int, func_name: str = None) -> Optional[str]:
         """基于智能大括号匹配提取完整函数代码"""
         try:
@@ -391,7 +375,7 @@ class LinuxMuslAnalyzer:
                             brace_count -= 1
                             if brace_count == 0:
                                 func_end = i
-                                function_code = '\\n'.join(lines[func_start:func_end+1])
+                                function_code = '\n'.join(lines[func_start:func_end+1])
                                 logger.debug(f"Extracted function {func_name or 'unknown'}: {len(function_code)} chars")
                                 return function_code
                     
@@ -403,7 +387,7 @@ class LinuxMuslAnalyzer:
             
             # 如果没有找到匹配的右大括号，返回从开始到文件末尾
             if brace_count > 0:
-                function_code = '\\n'.join(lines[func_start:])
+                function_code = '\n'.join(lines[func_start:])
                 logger.warning(f"Unmatched braces for function {func_name or 'unknown'}, returning partial code")
                 return function_code
                 
@@ -420,14 +404,7 @@ class LinuxMuslAnalyzer:
                 logger.warning(f"libc.so not found: {self.libc_path}")
                 return None
             
-            # Start GDB process if not already running
-            if not self.gdb_process:
-                await self._start_gdb()
-            
-            if not self.gdb_process:
-                return None
-            
-            # GDB commands to analyze function
+            # GDB commands to analyze function, sent in one round trip
             commands = [
                 f"info address {func_name}",
                 f"disassemble {func_name}",
@@ -435,131 +412,173 @@ class LinuxMuslAnalyzer:
                 f"ptype {func_name}"
             ]
             
-            results = {}
-            for cmd in commands:
-                result = await self._send_gdb_command(cmd)
-                results[cmd] = result
-            
-            return results
+            responses = await self._send_gdb_commands(commands)
+            if responses is None:
+                return None
+            return dict(zip(commands, responses))
             
         except Exception as e:
             logger.error(f"GDB analysis failed for {func_name}: {e}")
             return None
     
     async def _start_gdb(self) -> bool:
-        """Start GDB process"""
+        """Start a GDB/MI session on libc.so"""
         try:
             self.gdb_process = await asyncio.create_subprocess_exec(
-                'gdb', self.libc_path, '-q',
+                'gdb', '--quiet', '--nx', '--interpreter=mi2', self.libc_path,
                 stdin=asyncio.subprocess.PIPE,
                 stdout=asyncio.subprocess.PIPE,
-                stderr=asyncio.subprocess.PIPE
+                stderr=asyncio.subprocess.DEVNULL
             )
             
             # Initialize GDB
-            await self._send_gdb_command("set confirm off")
-            await self._send_gdb_command("set pagination off")
+            if await self._run_mi_commands(["set confirm off", "set pagination off"]) is None:
+                return False
             
-            logger.info("GDB process started")
+            logger.info("GDB/MI session started")
             return True
             
         except Exception as e:
             logger.error(f"Failed to start GDB: {e}")
+            self.gdb_process = None
             return False
     
-    async def _send_gdb_command(self, command: str) -> str:
-        """Send command to GDB and get response"""
+    async def _stop_gdb(self):
+        if self.gdb_process:
+            try:
+                self.gdb_process.kill()
+                await self.gdb_process.wait()
+            except ProcessLookupError:
+                pass
+        self.gdb_process = None
+    
+    async def _run_mi_commands(self, commands: List[str]) -> Optional[List[Tuple[str, str]]]:
+        """Send console commands as one pipelined batch of MI requests
+        
+        Returns (result class, console output) per command in order, or None
+        when the session died or timed out (it is then stopped, and the next
+        request starts a new one).
+        """
+        tokens = []
+        request = ""
+        for command in commands:
+            self.gdb_token += 1
+            tokens.append(str(self.gdb_token))
+            escaped = command.replace('\\', '\\\\').replace('"', '\\"')
+            request += f'{self.gdb_token}-interpreter-exec console "{escaped}"\n'
         try:
-            if not self.gdb_process:
-                return ""
-            
-            self.gdb_process.stdin.write(f"{command}\n".encode())
+            self.gdb_process.stdin.write(request.encode())
             await self.gdb_process.stdin.drain()
-            
-            # Read response with timeout
+        except (OSError, AttributeError) as e:
+            logger.warning(f"GDB session lost: {e}")
+            await self._stop_gdb()
+            return None
+        
+        # GDB answers in order: console records (~"...") precede the
+        # <token>^done / <token>^error result record of their command
+        results = {}
+        console = []
+        deadline = time.monotonic() + self.gdb_command_timeout * len(commands)
+        while len(results) < len(tokens):
             try:
-                response = await asyncio.wait_for(
-                    self.gdb_process.stdout.readline(), timeout=5.0
-                )
-                return response.decode().strip()
+                line = await asyncio.wait_for(self.gdb_process.stdout.readline(),
+                                              timeout=max(0.0, deadline - time.monotonic()))
             except asyncio.TimeoutError:
-                return ""
-            
-        except Exception as e:
-            logger.error(f"GDB command failed: {command} - {e}")
-            return ""
+                logger.warning(f"GDB command '{commands[len(results)]}' timed out")
+                await self._stop_gdb()
+                return None
+            if not line:
+                logger.warning("GDB session exited")
+                await self._stop_gdb()
+                return None
+            line = line.decode('utf-8', 'replace').rstrip('\n')
+            if line.startswith('~"'):
+                console.append(self._mi_string(line[1:]))
+                continue
+            m = re.match(r'^(\d+)\^(done|error|running|connected|exit)', line)
+            if m and m.group(1) in tokens:
+                results[m.group(1)] = (m.group(2), ''.join(console))
+                console = []
+        return [results[token] for token in tokens]
     
-    async def _send_gdb_command_with_timeout(self, command: str, timeout: float = 10.0) -> str:
-        """Send command to GDB with enhanced timeout and error handling"""
-        try:
-            if not self.gdb_process:
-                await self._start_gdb()
-                if not self.gdb_process:
-                    return ""
-            
-            logger.debug(f"Sending GDB command: {command}")
-            self.gdb_process.stdin.write(f"{command}\n".encode())
-            await self.gdb_process.stdin.drain()
-            
-            # Read multiple lines of response until prompt
-            response_lines = []
-            start_time = time.time()
-            
-            while time.time() - start_time < timeout:
-                try:
-                    line = await asyncio.wait_for(
-                        self.gdb_process.stdout.readline(), timeout=1.0
-                    )
-                    line_str = line.decode().strip()
-                    
-                    # Stop reading when we see the GDB prompt
-                    if line_str.startswith("(gdb)") or line_str == "":
-                        break
-                        
-                    response_lines.append(line_str)
-                    
-                except asyncio.TimeoutError:
-                    # Continue reading until timeout
-                    continue
-            
-            return "\n".join(response_lines)
-            
-        except Exception as e:
-            logger.error(f"Enhanced GDB command failed: {command} - {e}")
-            return f"ERROR: {str(e)}"
+    @staticmethod
+    def _mi_string(quoted: str) -> str:
+        """Decode an MI c-string ("...")"""
+        body = quoted.strip()[1:-1]
+        return codecs.escape_decode(body.encode('utf-8'))[0].decode('utf-8', 'replace')
     
-    async def locate_function_with_gdb(self, func_name: str) -> Optional[Dict[str, Any]]:
-        """使用 GDB 精确定位函数"""
-        try:
-            if not os.path.exists(self.libc_path):
-                logger.warning(f"libc.so not found: {self.libc_path}")
+    async def _send_gdb_commands(self, commands: List[str]) -> Optional[List[str]]:
+        """Run several GDB commands in one round trip; "" for each that failed, None without a session"""
+        async with self.gdb_lock:
+            if not self.gdb_process and not await self._start_gdb():
                 return None
-            
-            # Start GDB process if not already running
-            if not self.gdb_process:
-                if not await self._start_gdb():
-                    return None
-            
-            # GDB commands to locate function precisely
-            commands = [
-                f"info address {func_name}",      # Get function address
-                f"info line {func_name}",         # Get source location
-                f"info symbol {func_name}",       # Get symbol info
-                f"x/1i {func_name}",             # Show first instruction
-                f"disassemble {func_name}",      # Get disassembly for boundaries
-            ]
-            
-            results = {}
-            for cmd in commands:
-                result = await self._send_gdb_command_with_timeout(cmd, timeout=15.0)
-                results[cmd] = result
-                logger.debug(f"GDB {cmd}: {result[:100]}...")
-            
-            return self._parse_gdb_location_info(results, func_name)
-            
-        except Exception as e:
-            logger.error(f"GDB location failed for {func_name}: {e}")
+            results = await self._run_mi_commands(commands)
+        if results is None:
             return None
+        return [output.strip() if result_class == "done" else "" for result_class, output in results]
+    
+    async def _send_gdb_command(self, command: str) -> str:
+        """Send command to GDB and get its console output"""
+        responses = await self._send_gdb_commands([command])
+        return responses[0] if responses else ""
+    
+    async def locate_function_with_gdb(self, func_name: str) -> Optional[Dict[str, Any]]:
+        """精确定位函数 (DWARF 索引优先, GDB 兜底)"""
+        located = await self.locate_functions([func_name])
+        return located.get(func_name)
+    
+    async def locate_functions(self, func_names: List[str]) -> Dict[str, Dict[str, Any]]:
+        """Address and source location of many functions
+        
+        libc.so's symbols and DWARF are read once (musl_debug_index), with
+        the source index filling in locations the library has no debug
+        information for; only the functions neither knows are asked of GDB,
+        all in one pipelined MI batch.
+        """
+        located = {}
+        if not os.path.exists(self.libc_path):
+            logger.warning(f"libc.so not found: {self.libc_path}")
+            return located
+        
+        pending = []
+        for func_name in dict.fromkeys(func_names):
+            if func_name in self.location_cache:
+                located[func_name] = self.location_cache[func_name]
+                continue
+            entry = await asyncio.to_thread(self.debug_index.lookup, func_name)
+            if entry and not entry["source_file"]:
+                definition = await asyncio.to_thread(self.source_db.find, func_name)
+                if definition:
+                    entry["source_file"] = definition["path"]
+                    entry["line_number"] = definition["name_line"]
+            if entry and entry["source_file"]:
+                located[func_name] = {
+                    "function_name": func_name,
+                    "address": entry["address"],
+                    "source_file": entry["source_file"],
+                    "line_number": entry["line_number"],
+                    "symbol_info": f"{func_name} in section {entry['section']}" if entry["section"] else None,
+                    "size": entry["size"],
+                    "method": "debug_index"
+                }
+            else:
+                pending.append(func_name)
+        
+        if pending:
+            commands = []
+            for func_name in pending:
+                commands += [f"info address {func_name}", f"info line {func_name}", f"info symbol {func_name}"]
+            responses = await self._send_gdb_commands(commands)
+            if responses is not None:
+                results = dict(zip(commands, responses))
+                for func_name in pending:
+                    location_info = self._parse_gdb_location_info(results, func_name)
+                    if location_info:
+                        location_info["method"] = "gdb"
+                        located[func_name] = location_info
+        
+        self.location_cache.update(located)
+        return located
     
     def _parse_gdb_location_info(self, gdb_results: Dict[str, str], func_name: str) -> Optional[Dict[str, Any]]:
         """Parse GDB command results to extract function location info"""
@@ -569,25 +588,20 @@ class LinuxMuslAnalyzer:
                 "address": None,
                 "source_file": None,
                 "line_number": None,
-                "symbol_info": None,
-                "disassembly": None
+                "symbol_info": None
             }
             
             # Parse address info
             address_result = gdb_results.get(f"info address {func_name}", "")
-            if "Symbol" in address_result and "is at" in address_result:
-                # Extract address from "Symbol malloc is at 0x7ffff7e5b010 in section .text"
-                parts = address_result.split()
-                for i, part in enumerate(parts):
-                    if part.startswith("0x"):
-                        location_info["address"] = part
-                        break
+            # "Symbol "malloc" is a function at address 0x7ffff7e5b010."
+            address_match = re.search(r'^Symbol .* at (?:address )?(0x[0-9a-fA-F]+)', address_result)
+            if address_match:
+                location_info["address"] = address_match.group(1)
             
             # Parse line info
             line_result = gdb_results.get(f"info line {func_name}", "")
             if "Line" in line_result and "of" in line_result:
                 # Extract from "Line 123 of \"/path/to/file.c\" starts at address 0x..."
-                import re
                 line_match = re.search(r'Line (\d+) of "([^"]+)"', line_result)
                 if line_match:
                     location_info["line_number"] = int(line_match.group(1))
@@ -597,10 +611,6 @@ class LinuxMuslAnalyzer:
             symbol_result = gdb_results.get(f"info symbol {func_name}", "")
             location_info["symbol_info"] = symbol_result
             
-            # Parse disassembly for function boundaries
-            disasm_result = gdb_results.get(f"disassemble {func_name}", "")
-            location_info["disassembly"] = disasm_result
-            
             # Only return if we have essential information
             if location_info["address"] or location_info["source_file"]:
                 return location_info
@@ -651,6 +661,8 @@ class LinuxMuslAnalyzer:
             
             # 调用 Claude API
             ai_response = await self._call_claude_api(analysis_prompt)
+            cache_entry = self._llm_cache_entry("linux_analysis", ANALYSIS_PROMPT_VERSION,
+                                                self.ai_config, analysis_prompt)
             
             if ai_response:
                 try:
@@ -668,10 +680,12 @@ class LinuxMuslAnalyzer:
                         return ai_analysis
                     else:
                         logger.warning(f"No JSON found in AI response for {func_name}")
+                        self.llm_cache.delete(*cache_entry)
                         return self._get_mock_analysis(func_name, func_code)
                         
                 except json.JSONDecodeError as e:
                     logger.error(f"Failed to parse AI JSON response for {func_name}: {e}")
+                    self.llm_cache.delete(*cache_entry)
                     return self._get_mock_analysis(func_name, func_code)
             else:
                 logger.warning(f"No AI response for {func_name}, using mock analysis")
@@ -699,8 +713,19 @@ class LinuxMuslAnalyzer:
             "ai_model": "mock"
         }
     
+    def _llm_cache_entry(self, namespace: str, version: str, ai_config: Dict[str, Any], prompt: str) -> Tuple:
+        """LLM cache arguments of a prompt sent with ai_config"""
+        return (namespace, version, ai_config.get("model", "claude-sonnet-4-20250514"), prompt,
+                {"max_tokens": ai_config.get("max_tokens", 8000),
+                 "temperature": ai_config.get("temperature", 0.1),
+                 "base_url": ai_config.get("base_url", "https://api.anthropic.com")})
+    
     async def _call_claude_api(self, prompt: str) -> Optional[str]:
         """调用 Claude API"""
+        cache_entry = self._llm_cache_entry("linux_analysis", ANALYSIS_PROMPT_VERSION, self.ai_config, prompt)
+        cached = self.llm_cache.get(*cache_entry)
+        if cached:
+            return cached
         try:
             import aiohttp
             import os
@@ -744,7 +769,9 @@ class LinuxMuslAnalyzer:
                         result = await response.json()
                         content = result.get("content", [])
                         if content and len(content) > 0:
-                            return content[0].get("text", "")
+                            text = content[0].get("text", "")
+                            self.llm_cache.put(*cache_entry[:4], text, cache_entry[4])
+                            return text
                     else:
                         logger.error(f"Claude API error: {response.status} - {await response.text()}")
                         return None
@@ -755,6 +782,12 @@ class LinuxMuslAnalyzer:
     
     async def _call_claude_api_for_code_generation(self, prompt: str) -> Optional[str]:
         """调用 Claude API 进行代码生成（使用专门的代码生成配置）"""
+        cache_entry = self._llm_cache_entry("linux_code_generation", CODE_GENERATION_PROMPT_VERSION,
+                                            self.code_gen_ai_config, prompt)
+        cached = self.llm_cache.get(*cache_entry)
+        if cached:
+            logger.info("Claude code generation answer loaded from LLM cache")
+            return cached
         try:
             import aiohttp
             import os
@@ -796,6 +829,7 @@ class LinuxMuslAnalyzer:
                         if result.get("content") and len(result["content"]) > 0:
                             response_text = result["content"][0].get("text", "")
                             logger.info(f"Claude code generation API success - model: {model}")
+                            self.llm_cache.put(*cache_entry[:4], response_text, cache_entry[4])
                             return response_text
                         else:
                             logger.error("Empty response from Claude code generation API")
@@ -830,16 +864,18 @@ class LinuxMuslAnalyzer:
                 logger.warning(f"Incomplete location info for {func_name}")
                 return None
             
-            # 2. 读取源文件并提取完整函数代码
+            # 2. 从映射的源文件中提取完整函数代码
             if not os.path.exists(source_file):
                 logger.error(f"Source file not found: {source_file}")
                 return None
             
-            with open(source_file, 'r', encoding='utf-8', errors='ignore') as f:
-                content = f.read()
-            
-            # 使用智能大括号匹配提取函数
-            func_code = self.extract_function_by_braces(content, line_number - 1, func_name)
+            # 文件的函数范围表里有这个定义就直接切片, 否则用智能大括号匹配提取函数
+            span = self.source_cache.function_at(source_file, line_number)
+            if span:
+                func_code = self.source_cache.lines(source_file, span["start_line"], span["end_line"])
+            else:
+                content = self.source_cache.text(source_file)
+                func_code = self.extract_function_by_braces(content, line_number - 1, func_name) if content else None
             if not func_code:
                 logger.warning(f"Could not extract function code for {func_name}")
                 return None
@@ -915,32 +951,122 @@ class LinuxMuslAnalyzer:
             logger.error(f"Error extracting signature for {func_name}: {e}")
             return f"unknown {func_name}(...)"
     
+    async def compile_musl(self, changed_files: Optional[List[str]] = None, clean: bool = False) -> Dict[str, Any]:
+        """Rebuild lib/libc.so, recompiling only the objects that are out of date
+        
+        musl's Makefile tracks each object against its source, so after a
+        shim or dynlink.c change only those objects are rebuilt before the
+        relink; changed_files are rebuilt even when their mtime did not move.
+        """
+        if not os.path.exists(os.path.join(self.musl_path, "config.mak")):
+            return {"success": False, "error": f"config.mak not found in {self.musl_path}, run ./configure first"}
+        
+        linux_config = self.config.get("linux_system", {})
+        jobs = linux_config.get("build_jobs") or os.cpu_count() or 1
+        timeout = linux_config.get("build_timeout", 300)
+        start = time.time()
+        
+        if clean:
+            returncode, _, stderr = await self._run_make(['clean'], timeout)
+            if returncode != 0:
+                return {"success": False, "return_code": returncode, "stderr": stderr}
+        
+        args = [f'-j{jobs}']
+        for path in changed_files or []:
+            relative = os.path.relpath(os.path.abspath(path), os.path.abspath(self.musl_path))
+            if not relative.startswith('..'):
+                args += ['-W', f'./{relative}']
+        args.append('lib/libc.so')
+        
+        returncode, stdout, stderr = await self._run_make(args, timeout)
+        if returncode is None:
+            return {"success": False, "error": "Compilation timed out"}
+        
+        recompiled = re.findall(r' -c -o (obj/\S+)', stdout)
+        diagnostics = parse_compiler_diagnostics(stderr)
+        if returncode == 0:
+            # The library changed under the cached addresses
+            self.location_cache.clear()
+        
+        result = {
+            "success": returncode == 0,
+            "return_code": returncode,
+            "recompiled": recompiled,
+            "relinked": '-o lib/libc.so' in stdout,
+            "errors": sum(1 for d in diagnostics if d["severity"] in ("error", "fatal error")),
+            "warnings": sum(1 for d in diagnostics if d["severity"] == "warning"),
+            "diagnostics": diagnostics,
+            "seconds": round(time.time() - start, 2)
+        }
+        if returncode != 0:
+            result["stderr"] = stderr[-8000:]
+        logger.info(f"musl build: {len(recompiled)} objects recompiled, {result['errors']} errors, "
+                    f"{result['warnings']} warnings in {result['seconds']}s")
+        return result
+    
+    async def _run_make(self, args: List[str], timeout: float) -> Tuple[Optional[int], str, str]:
+        """(return code, stdout, stderr) of make in the musl tree; None as return code on timeout"""
+        process = await asyncio.create_subprocess_exec(
+            'make', *args,
+            cwd=self.musl_path,
+            stdout=asyncio.subprocess.PIPE,
+            stderr=asyncio.subprocess.PIPE
+        )
+        try:
+            stdout, stderr = await asyncio.wait_for(process.communicate(), timeout=timeout)
+        except asyncio.TimeoutError:
+            process.kill()
+            await process.wait()
+            return None, "", ""
+        return process.returncode, stdout.decode('utf-8', 'replace'), stderr.decode('utf-8', 'replace')
+    
     def get_existing_qnx_escape_functions(self) -> List[str]:
-        """Get list of functions already in ESCAPE_QNX_FUNC"""
+        """Get list of functions redirected with QNX_REDIRECT in src/qnxsupport"""
         escaped_funcs = []
+        qnxsupport_dir = os.path.join(self.musl_path, "src", "qnxsupport")
         
         try:
-            with open(self.dynlink_path, 'r', encoding='utf-8') as f:
-                content = f.read()
-            
-            # Find ESCAPE_QNX_FUNC calls
-            pattern = r'ESCAPE_QNX_FUNC\(([^)]+)\);'
-            matches = re.findall(pattern, content)
+            pattern = re.compile(r'^QNX_REDIRECT\((\w+)\);', re.M)
+            for name in sorted(os.listdir(qnxsupport_dir)):
+                if not name.endswith('.c'):
+                    continue
+                with open(os.path.join(qnxsupport_dir, name), 'r', encoding='utf-8') as f:
+                    escaped_funcs.extend(pattern.findall(f.read()))
             
-            escaped_funcs = [match.strip() for match in matches]
-            logger.info(f"Found {len(escaped_funcs)} functions in ESCAPE_QNX_FUNC")
+            logger.info(f"Found {len(escaped_funcs)} functions in QNX_REDIRECT")
             
         except Exception as e:
-            logger.error(f"Error reading dynlink.c: {e}")
+            logger.error(f"Error scanning {qnxsupport_dir}: {e}")
         
         return escaped_funcs
     
+    @staticmethod
+    def _qnx_signature(qnx_info: Dict[str, Any]) -> str:
+        """The QNX prototype, from a plain function record or a get_qnx_function_details answer"""
+        return qnx_info.get('signature') or (qnx_info.get('function_data') or {}).get('synopsis', '')
+    
+    async def prefetch_type_layouts(self, qnx_infos: Dict[str, Dict[str, Any]]) -> Dict[str, Any]:
+        """Compare the types of many QNX prototypes ahead of generate_qnx_glue_plan, which then reads cached results"""
+        if not self.abi.available:
+            return {"types": 0, "differing": []}
+        type_names = []
+        for func_name, qnx_info in qnx_infos.items():
+            for type_name in self.abi.signature_types(func_name, self._qnx_signature(qnx_info)) or []:
+                if type_name not in type_names:
+                    type_names.append(type_name)
+        differing = await asyncio.to_thread(
+            lambda: [type_name for type_name in type_names if self.abi.compare_type(type_name)])
+        return {"types": len(type_names), "differing": differing}
+    
     async def generate_qnx_glue_plan(self, qnx_func: str, qnx_info: Dict[str, Any]) -> QNXGlueCodePlan:
         """Generate QNX glue code plan with AI enhancement"""
         
         # Check if function exists in Linux
         linux_func_info = self.function_db.get(qnx_func)
         escaped_funcs = self.get_existing_qnx_escape_functions()
+        abi = None
+        if linux_func_info and qnx_func not in escaped_funcs and self.abi.available:
+            abi = self.abi.check_function(qnx_func, self._qnx_signature(qnx_info))
         
         if not linux_func_info:
             # Strategy 1: Create stub in qnxsupport with AI enhancement
@@ -973,11 +1099,28 @@ class LinuxMuslAnalyzer:
                 qnx_support_file=f"{self.qnx_support_dir}/_qnx_{qnx_func}.c",
                 glue_code=glue_code,
                 dynlink_addition=None,
-                confidence=0.95 if glue_code != self._generate_qnx_wrapper_code(qnx_func, linux_func_info, qnx_info) else 0.9
+                confidence=0.95 if glue_code != self._generate_qnx_wrapper_code(qnx_func, linux_func_info, qnx_info) else 0.9,
+                benchmark=self._wrapper_benchmark(qnx_func, linux_func_info, qnx_info)
+            )
+        
+        elif abi and abi["identical"]:
+            # Strategy 3: Same types and constants on both sides, QNX binaries bind the musl symbol itself
+            logger.info(f"{qnx_func}: QNX and musl ABIs are identical, no wrapper needed")
+            return QNXGlueCodePlan(
+                qnx_function=qnx_func,
+                linux_function=qnx_func,
+                strategy="direct",
+                needs_dynlink_modification=False,
+                qnx_support_file=None,
+                glue_code="",
+                dynlink_addition=None,
+                confidence=1.0,
+                zero_cost=True,
+                abi_differences=[]
             )
         
         else:
-            # Strategy 3: Need to add to ESCAPE_QNX_FUNC and create wrapper with AI enhancement
+            # Strategy 4: Need a QNX_REDIRECT entry and a wrapper with AI enhancement
             glue_code = await self._generate_ai_enhanced_wrapper_code(qnx_func, linux_func_info, qnx_info)
             if not glue_code:
                 glue_code = self._generate_qnx_wrapper_code(qnx_func, linux_func_info, qnx_info)
@@ -989,10 +1132,42 @@ class LinuxMuslAnalyzer:
                 needs_dynlink_modification=True,
                 qnx_support_file=f"{self.qnx_support_dir}/_qnx_{qnx_func}.c",
                 glue_code=glue_code,
-                dynlink_addition=f"\tESCAPE_QNX_FUNC({qnx_func});",
-                confidence=0.9 if glue_code != self._generate_qnx_wrapper_code(qnx_func, linux_func_info, qnx_info) else 0.8
+                dynlink_addition=f"QNX_REDIRECT({qnx_func});",
+                confidence=0.9 if glue_code != self._generate_qnx_wrapper_code(qnx_func, linux_func_info, qnx_info) else 0.8,
+                abi_differences=abi["differences"] if abi else None,
+                benchmark=self._wrapper_benchmark(qnx_func, linux_func_info, qnx_info)
             )
     
+    def _wrapper_benchmark(self, func_name: str, linux_info: LinuxFunctionInfo, qnx_info: Dict[str, Any]) -> Optional[str]:
+        """Microbenchmark of _qnx_<func> against the musl function, None if it cannot be called generically"""
+        settings = benchmark_settings(self.config)
+        if not settings["enabled"]:
+            return None
+        return emit_shim_benchmark(func_name, self._qnx_signature(qnx_info) or linux_info.signature,
+                                   f"_qnx_{func_name}", func_name, settings["arguments"].get(func_name),
+                                   settings["iterations"])
+    
+    async def benchmark_shim(self, func_name: str, source: str) -> Dict[str, Any]:
+        """Run a wrapper's microbenchmark against the libc.so compile_musl built and check the overhead budget
+        
+        "accepted" is False only when the shim is over budget and
+        processing_settings.glue.benchmark.reject is set; over-budget shims
+        are otherwise accepted with "flagged" set.
+        """
+        settings = benchmark_settings(self.config)
+        result = await asyncio.to_thread(run_shim_benchmark, source, self.musl_path,
+                                         os.path.join(self.musl_path, "lib", "libc.so"),
+                                         settings["budget_ns"], settings["budget_ratio"], settings["timeout"],
+                                         arch=musl_arch(self.config))
+        over_budget = result.get("benchmarked", False) and not result["within_budget"]
+        result.update(function=func_name, flagged=over_budget, accepted=not (over_budget and settings["reject"]))
+        if over_budget:
+            logger.warning(f"_qnx_{func_name} costs {result['overhead_ns']} ns more than {func_name} "
+                           f"(budget {result['allowed_ns']} ns)")
+        elif not result.get("benchmarked", False):
+            logger.info(f"_qnx_{func_name} not benchmarked: {result.get('error')}")
+        return result
+    
     def _generate_stub_code(self, func_name: str, qnx_info: Dict[str, Any]) -> str:
         """Generate stub code for QNX-only functions"""
         signature = qnx_info.get('signature', f'int {func_name}(void)')
@@ -1135,9 +1310,19 @@ class LinuxFunctionMCPServer:
             return {}
     
     def _register_tools(self):
-        """Register MCP tools"""
+        """Register MCP tools
         
-        @self.server.call_tool()
+        Server.call_tool() takes a single handler for every tool, so the tools
+        are collected by name and one handler dispatches to them; their
+        signatures give the input schemas of tools/list.
+        """
+        self.tools = {}
+        
+        def tool(handler):
+            self.tools[handler.__name__] = handler
+            return handler
+        
+        @tool
         async def batch_smart_analysis(func_names: str, max_concurrent: int = 3) -> List[types.TextContent]:
             """批量智能分析函数列表"""
             try:
@@ -1168,7 +1353,7 @@ class LinuxFunctionMCPServer:
                     text=json.dumps({"error": str(e)}, indent=2)
                 )]
         
-        @self.server.call_tool()
+        @tool
         async def scan_musl_source() -> List[types.TextContent]:
             """Scan musl source code and build function index"""
             try:
@@ -1191,7 +1376,7 @@ class LinuxFunctionMCPServer:
                     text=json.dumps({"error": str(e)}, indent=2)
                 )]
         
-        @self.server.call_tool()
+        @tool
         async def smart_function_lookup(func_name: str) -> List[types.TextContent]:
             """智能函数查询 - 结合GDB定位和AI分析"""
             try:
@@ -1234,10 +1419,13 @@ class LinuxFunctionMCPServer:
                     text=json.dumps({"error": str(e)}, indent=2)
                 )]
         
-        @self.server.call_tool()
+        @tool
         async def get_linux_function_info(name: str) -> List[types.TextContent]:
             """Get Linux function information from musl source"""
             try:
+                if not self.analyzer.function_db:
+                    # Definitions indexed by an earlier run, without rescanning
+                    await asyncio.to_thread(self.analyzer.load_source_index)
                 func_info = self.analyzer.function_db.get(name)
                 if not func_info:
                     return [types.TextContent(
@@ -1266,7 +1454,7 @@ class LinuxFunctionMCPServer:
                     text=json.dumps({"error": str(e)}, indent=2)
                 )]
         
-        @self.server.call_tool()
+        @tool
         async def generate_qnx_glue_code(qnx_func: str, qnx_info: str) -> List[types.TextContent]:
             """Generate QNX glue code plan and implementation"""
             try:
@@ -1285,7 +1473,10 @@ class LinuxFunctionMCPServer:
                         "qnx_support_file": plan.qnx_support_file,
                         "confidence": plan.confidence,
                         "glue_code": plan.glue_code,
-                        "dynlink_addition": plan.dynlink_addition
+                        "dynlink_addition": plan.dynlink_addition,
+                        "zero_cost": plan.zero_cost,
+                        "abi_differences": plan.abi_differences,
+                        "benchmark": plan.benchmark
                     }, indent=2)
                 )]
                 
@@ -1296,87 +1487,145 @@ class LinuxFunctionMCPServer:
                     text=json.dumps({"error": str(e)}, indent=2)
                 )]
         
-        @self.server.call_tool()
-        async def modify_dynlink(additions: str) -> List[types.TextContent]:
-            """Add ESCAPE_QNX_FUNC entries to dynlink.c"""
+        @tool
+        async def prefetch_type_layouts(qnx_infos: str) -> List[types.TextContent]:
+            """Compare the QNX and musl layouts of the types in many prototypes, so later glue plans hit the cache"""
             try:
-                # Read current dynlink.c
-                with open(self.analyzer.dynlink_path, 'r', encoding='utf-8') as f:
-                    content = f.read()
-                
-                # Find insertion point (after last ESCAPE_QNX_FUNC)
-                lines = content.split('\n')
-                insert_line = -1
+                qnx_data = json.loads(qnx_infos) if isinstance(qnx_infos, str) else qnx_infos
+                result = await self.analyzer.prefetch_type_layouts(qnx_data)
                 
-                for i, line in enumerate(lines):
-                    if 'ESCAPE_QNX_FUNC(' in line:
-                        insert_line = i + 1
+                return [types.TextContent(
+                    type="text",
+                    text=json.dumps(result, indent=2)
+                )]
                 
-                if insert_line == -1:
+            except Exception as e:
+                logger.error(f"Error prefetching type layouts: {e}")
+                return [types.TextContent(
+                    type="text",
+                    text=json.dumps({"error": str(e)}, indent=2)
+                )]
+        
+        @tool
+        async def modify_dynlink(additions: str, target_file: str = "") -> List[types.TextContent]:
+            """Append QNX_REDIRECT entries to the shim source that defines them
+
+            The loader builds its redirect table from the qnx_redirect section,
+            so dynlink.c itself no longer needs editing; the name is kept for
+            existing callers.
+            """
+            try:
+                if not target_file:
                     return [types.TextContent(
                         type="text",
-                        text=json.dumps({"error": "Could not find ESCAPE_QNX_FUNC section in dynlink.c"}, indent=2)
+                        text=json.dumps({"error": "target_file is required for QNX_REDIRECT entries"}, indent=2)
                     )]
                 
-                # Insert new entries
-                new_lines = additions.strip().split('\n')
-                lines[insert_line:insert_line] = new_lines
+                content = ""
+                if os.path.exists(target_file):
+                    with open(target_file, 'r', encoding='utf-8') as f:
+                        content = f.read()
                 
-                # Write back to file
-                with open(self.analyzer.dynlink_path, 'w', encoding='utf-8') as f:
-                    f.write('\n'.join(lines))
+                new_lines = [line.strip() for line in additions.strip().split('\n')
+                             if re.match(r'\s*QNX_REDIRECT\(\w+\);', line)
+                             and line.strip() not in content]
+                
+                if '#include "qnx_redirect.h"' not in content:
+                    content = '#include "qnx_redirect.h"\n' + content
+                if content and not content.endswith('\n'):
+                    content += '\n'
+                content += ''.join(line + '\n' for line in new_lines)
+                
+                with open(target_file, 'w', encoding='utf-8') as f:
+                    f.write(content)
                 
                 return [types.TextContent(
                     type="text",
                     text=json.dumps({
-                        "message": "dynlink.c modified successfully",
+                        "message": "QNX_REDIRECT entries added successfully",
                         "inserted_lines": len(new_lines),
-                        "dynlink_path": self.analyzer.dynlink_path
+                        "target_file": target_file
                     }, indent=2)
                 )]
                 
             except Exception as e:
-                logger.error(f"Error modifying dynlink.c: {e}")
+                logger.error(f"Error adding QNX_REDIRECT entries: {e}")
                 return [types.TextContent(
                     type="text",
                     text=json.dumps({"error": str(e)}, indent=2)
                 )]
         
-        @self.server.call_tool()
-        async def compile_musl() -> List[types.TextContent]:
-            """Compile musl library to test changes"""
+        @tool
+        async def compile_musl(changed_files: str = "", clean: bool = False) -> List[types.TextContent]:
+            """Rebuild lib/libc.so incrementally to test changes"""
             try:
-                # Change to musl directory and compile
-                result = subprocess.run(
-                    ['make', 'clean', '&&', 'make'],
-                    cwd=self.analyzer.musl_path,
-                    capture_output=True,
-                    text=True,
-                    shell=True,
-                    timeout=300
-                )
+                # 改动过的文件 (逗号分隔或换行分隔), 即使时间戳没变也会重新编译
+                files = [path.strip() for path in changed_files.replace(',', '\n').split('\n') if path.strip()]
+                result = await self.analyzer.compile_musl(files, clean)
                 
                 return [types.TextContent(
                     type="text",
-                    text=json.dumps({
-                        "success": result.returncode == 0,
-                        "return_code": result.returncode,
-                        "stdout": result.stdout,
-                        "stderr": result.stderr
-                    }, indent=2)
+                    text=json.dumps(result, indent=2)
                 )]
                 
-            except subprocess.TimeoutExpired:
+            except Exception as e:
+                logger.error(f"Error compiling musl: {e}")
+                return [types.TextContent(
+                    type="text",
+                    text=json.dumps({"error": str(e)}, indent=2)
+                )]
+        
+        @tool
+        async def benchmark_shim(qnx_func: str, source: str) -> List[types.TextContent]:
+            """Time a built wrapper against the musl function and check it against the overhead budget"""
+            try:
+                result = await self.analyzer.benchmark_shim(qnx_func, source)
+                
                 return [types.TextContent(
                     type="text",
-                    text=json.dumps({"error": "Compilation timed out"}, indent=2)
+                    text=json.dumps(result, indent=2)
                 )]
+                
             except Exception as e:
-                logger.error(f"Error compiling musl: {e}")
+                logger.error(f"Error benchmarking shim: {e}")
                 return [types.TextContent(
                     type="text",
                     text=json.dumps({"error": str(e)}, indent=2)
                 )]
+        
+        @self.server.list_tools()
+        async def handle_list_tools() -> List[types.Tool]:
+            return [types.Tool(name=name, description=(handler.__doc__ or name).strip(),
+                               inputSchema=_input_schema(handler))
+                    for name, handler in self.tools.items()]
+        
+        @self.server.call_tool()
+        async def handle_call_tool(name: str, arguments: Dict[str, Any]) -> List[types.TextContent]:
+            handler = self.tools.get(name)
+            if handler is None:
+                return [types.TextContent(
+                    type="text",
+                    text=json.dumps({"error": f"Unknown tool: {name}"}, indent=2)
+                )]
+            try:
+                return await handler(**(arguments or {}))
+            except TypeError as e:
+                return [types.TextContent(
+                    type="text",
+                    text=json.dumps({"error": f"Bad arguments for {name}: {e}"}, indent=2)
+                )]
+
+def _input_schema(handler) -> Dict[str, Any]:
+    """JSON schema of a tool handler's keyword arguments"""
+    json_types = {str: "string", int: "integer", float: "number", bool: "boolean"}
+    properties, required = {}, []
+    for param in inspect.signature(handler).parameters.values():
+        properties[param.name] = {"type": json_types.get(param.annotation, "string")}
+        if param.default is inspect.Parameter.empty:
+            required.append(param.name)
+        else:
+            properties[param.name]["default"] = param.default
+    return {"type": "object", "properties": properties, "required": required}
 
 async def main():
     """Main function to run the Linux MCP server"""
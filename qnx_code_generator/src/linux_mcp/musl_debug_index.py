@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+musl Debug Index
+Function addresses and source locations of libc.so read straight from its
+ELF symbol tables and DWARF, so locating a function needs no GDB round trip
+"""
+
+import logging
+import os
+import threading
+from typing import Any, Dict, Optional
+
+logger = logging.getLogger(__name__)
+
+try:
+    from elftools.elf.elffile import ELFFile
+    ELFTOOLS_AVAILABLE = True
+except ImportError:
+    ELFTOOLS_AVAILABLE = False
+
+class MuslDebugIndex:
+    """Symbols and DW_TAG_subprogram locations of one libc.so
+
+    The library is read on first use and again whenever its mtime changes
+    (after a rebuild); lookups in between are dictionary reads.
+    """
+
+    def __init__(self, libc_path: str):
+        self.libc_path = libc_path
+        self.symbols: Dict[str, Dict[str, Any]] = {}    # name -> {"address", "size", "section"}
+        self.locations: Dict[str, Dict[str, Any]] = {}  # name -> {"source_file", "line_number"}
+        self.by_address: Dict[str, list] = {}            # address -> names (aliases share one)
+        self.has_dwarf = False
+        self._mtime = None
+        self._lock = threading.Lock()
+
+    @property
+    def available(self) -> bool:
+        return ELFTOOLS_AVAILABLE and os.path.exists(self.libc_path)
+
+    def _ensure_loaded(self) -> bool:
+        if not self.available:
+            return False
+        mtime = os.path.getmtime(self.libc_path)
+        with self._lock:
+            if self._mtime == mtime:
+                return True
+            try:
+                self._load()
+            except Exception as e:
+                logger.warning(f"Failed to read debug information of {self.libc_path}: {e}")
+                self.symbols, self.locations, self.by_address, self.has_dwarf = {}, {}, {}, False
+            self._mtime = mtime
+        return True
+
+    def _load(self):
+        symbols, locations = {}, {}
+        with open(self.libc_path, 'rb') as f:
+            elf = ELFFile(f)
+            sections = [s.name for s in elf.iter_sections()]
+            for table_name in ('.symtab', '.dynsym'):
+                table = elf.get_section_by_name(table_name)
+                if table is None:
+                    continue
+                for symbol in table.iter_symbols():
+                    if (symbol['st_info']['type'] != 'STT_FUNC' or not symbol.name
+                            or symbol['st_shndx'] == 'SHN_UNDEF' or symbol.name in symbols):
+                        continue
+                    shndx = symbol['st_shndx']
+                    symbols[symbol.name] = {
+                        "address": hex(symbol['st_value']),
+                        "size": symbol['st_size'],
+                        "section": sections[shndx] if isinstance(shndx, int) and shndx < len(sections) else None,
+                    }
+
+            self.has_dwarf = elf.has_dwarf_info()
+            if self.has_dwarf:
+                dwarf = elf.get_dwarf_info()
+                for cu in dwarf.iter_CUs():
+                    top = cu.get_top_DIE()
+                    comp_dir = self._attr_str(top, 'DW_AT_comp_dir') or ''
+                    lineprog = dwarf.line_program_for_CU(cu)
+                    for die in cu.iter_DIEs():
+                        if die.tag != 'DW_TAG_subprogram' or 'DW_AT_declaration' in die.attributes:
+                            continue
+                        name = self._attr_str(die, 'DW_AT_name')
+                        if not name or name in locations or 'DW_AT_decl_line' not in die.attributes:
+                            continue
+                        path = self._decl_file(lineprog, die, comp_dir, cu['version'])
+                        if path:
+                            locations[name] = {
+                                "source_file": path,
+                                "line_number": die.attributes['DW_AT_decl_line'].value,
+                            }
+        by_address = {}
+        for name, symbol in symbols.items():
+            by_address.setdefault(symbol["address"], []).append(name)
+        self.symbols, self.locations, self.by_address = symbols, locations, by_address
+        logger.info(f"Read {len(symbols)} function symbols and {len(locations)} DWARF locations "
+                    f"from {self.libc_path}")
+
+    @staticmethod
+    def _attr_str(die, name: str) -> Optional[str]:
+        attr = die.attributes.get(name)
+        if attr is None:
+            return None
+        value = attr.value
+        return value.decode('utf-8', 'replace') if isinstance(value, bytes) else str(value)
+
+    @staticmethod
+    def _decl_file(lineprog, die, comp_dir: str, version: int) -> Optional[str]:
+        attr = die.attributes.get('DW_AT_decl_file')
+        if attr is None or lineprog is None:
+            return None
+        # File and directory numbers are 1-based before DWARF 5 (directory 0 is comp_dir)
+        files = lineprog['file_entry']
+        index = attr.value if version >= 5 else attr.value - 1
+        if not 0 <= index < len(files):
+            return None
+        entry = files[index]
+        name = entry.name.decode('utf-8', 'replace') if isinstance(entry.name, bytes) else entry.name
+        directories = lineprog['include_directory']
+        dir_index = entry.dir_index if version >= 5 else entry.dir_index - 1
+        directory = ''
+        if 0 <= dir_index < len(directories):
+            directory = directories[dir_index]
+            directory = directory.decode('utf-8', 'replace') if isinstance(directory, bytes) else directory
+        return os.path.normpath(os.path.join(comp_dir, directory, name))
+
+    def lookup(self, func_name: str) -> Optional[Dict[str, Any]]:
+        """{"address", "size", "section", "source_file", "line_number"} of a function, or None"""
+        if not self._ensure_loaded():
+            return None
+        symbol = self.symbols.get(func_name)
+        location = self.locations.get(func_name)
+        if symbol and not location:
+            # weak_alias(__stpcpy, stpcpy): DWARF only names the definition
+            for alias in self.by_address.get(symbol["address"], []):
+                if alias in self.locations:
+                    location = self.locations[alias]
+                    break
+        if not symbol and not location:
+            return None
+        result = {"address": None, "size": None, "section": None, "source_file": None, "line_number": None}
+        result.update(symbol or {})
+        result.update(location or {})
+        return result
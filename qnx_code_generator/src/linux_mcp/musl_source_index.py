@@ -0,0 +1,479 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+musl Source Index
+Function definitions, spans, callees and alias relations of the musl
+sources, parsed once and kept in SQLite across server runs, and the
+memory-mapped files the functions are sliced from
+"""
+
+import bisect
+import hashlib
+import json
+import logging
+import mmap
+import os
+import re
+import sqlite3
+import threading
+import time
+from collections import OrderedDict
+from concurrent.futures import ProcessPoolExecutor
+from pathlib import Path
+from typing import Any, Dict, List, Optional, Tuple
+
+logger = logging.getLogger(__name__)
+
+# Bump when the parser changes what it records: every file is then reparsed
+PARSER_VERSION = "1"
+
+TOKEN_RE = re.compile(r'''
+    (?P<pp>^[ \t]*\#(?:\\\n|[^\n])*)
+   |(?P<comment>/\*.*?\*/|//[^\n]*)
+   |(?P<ws>[ \t\r\f\v]+|\n)
+   |(?P<str>"(?:\\.|[^"\\\n])*"|'(?:\\.|[^'\\\n])*')
+   |(?P<ident>[A-Za-z_]\w*)
+   |(?P<num>\.?\d(?:[eEpP][+-]|[\w.])*)
+   |(?P<punct>\.\.\.|->|<<=|>>=|[-+*/%&|^!=<>]=|&&|\|\||<<|>>|\+\+|--|.)
+''', re.S | re.M | re.X)
+
+# Identifiers followed by "(" that are not calls or function names
+NOT_CALLS = {
+    'if', 'while', 'for', 'switch', 'return', 'sizeof', '_Alignof', 'alignof', 'case',
+    '__attribute__', '__attribute', '__asm__', '__asm', 'asm', '__typeof__', 'typeof',
+    '__builtin_offsetof', 'offsetof', '_Static_assert', '__extension__', 'defined',
+}
+TYPE_WORDS = {'void', 'char', 'short', 'int', 'long', 'float', 'double', 'signed', 'unsigned',
+              '_Bool', '_Complex', 'const', 'volatile', 'restrict', 'struct', 'union', 'enum'}
+STORAGE_WORDS = {'static', 'inline', '__inline', '__inline__', 'extern', 'hidden', '_Noreturn',
+                 'weak', 'register', 'auto'}
+ALIAS_MACROS = {'weak_alias', 'strong_alias', 'weak_alias_hidden'}
+
+def _tokens(content: str) -> List[Tuple[str, str, int]]:
+    """(kind, text, offset) of the C tokens, without comments and preprocessor lines"""
+    tokens = []
+    for m in TOKEN_RE.finditer(content):
+        kind = m.lastgroup
+        if kind in ('ws', 'comment', 'pp'):
+            continue
+        tokens.append((kind, m.group(), m.start()))
+    return tokens
+
+def _match(tokens: List[Tuple[str, str, int]], i: int, open_: str, close: str) -> int:
+    """Index of the token closing the group opened at i (len(tokens) if unbalanced)"""
+    depth = 0
+    for j in range(i, len(tokens)):
+        text = tokens[j][1]
+        if text == open_:
+            depth += 1
+        elif text == close:
+            depth -= 1
+            if depth == 0:
+                return j
+    return len(tokens)
+
+def parse_c_source(content: str) -> Tuple[List[Dict[str, Any]], List[Dict[str, Any]]]:
+    """(function definitions, alias declarations) at file scope of one C source"""
+    tokens = _tokens(content)
+    newlines = [m.start() for m in re.finditer('\n', content)]
+
+    def line_of(offset: int) -> int:
+        return bisect.bisect_right(newlines, offset - 1) + 1
+
+    def text_of(first: int, last: int) -> str:
+        return ' '.join(content[tokens[first][2]:tokens[last][2] + len(tokens[last][1])].split())
+
+    functions, aliases = [], []
+    start, i, n = 0, 0, len(tokens)
+    while i < n:
+        text = tokens[i][1]
+        if text == '{':
+            close = _match(tokens, i, '{', '}')
+            function = _function(tokens, start, i, close) if i > start else None
+            if function:
+                name_index = function.pop("name_index")
+                params_open, params_close = function.pop("params")
+                return_type = text_of(start, name_index - 1) if name_index > start else 'int'
+                if function.pop("nested"):
+                    # void (*signal(int, void (*)(int)))(int): the rest of the declarator
+                    return_type += text_of(params_close + 1, i - 1)
+                else:
+                    return_type = return_type.rstrip('( ')
+                function.update(
+                    signature=text_of(start, i - 1),
+                    return_type=return_type,
+                    parameters=text_of(params_open + 1, params_close - 1) if params_close > params_open + 1 else '',
+                    start_line=line_of(tokens[start][2]),
+                    name_line=line_of(tokens[name_index][2]),
+                    end_line=line_of(tokens[min(close, n - 1)][2]),
+                )
+                function["return_type"] = ' '.join(w for w in function["return_type"].split()
+                                                   if w not in STORAGE_WORDS) or 'int'
+                functions.append(function)
+                start = close + 1
+            # A struct body or initializer: the declaration goes on to its ";"
+            i = close + 1
+            continue
+        if text == ';':
+            alias = _alias(tokens, start, i)
+            if alias:
+                alias["line"] = line_of(tokens[start][2])
+                aliases.append(alias)
+            start = i + 1
+        i += 1
+    return functions, aliases
+
+def _function(tokens, start: int, brace: int, close: int) -> Optional[Dict[str, Any]]:
+    """The definition whose declarator is tokens[start:brace] and body ends at close"""
+    words = [t[1] for t in tokens[start:brace]]
+    if words[0] in ('typedef', 'struct', 'union', 'enum') and '(' not in words:
+        return None
+    depth = 0
+    name_index = None
+    for j in range(start, brace):
+        kind, text, _ = tokens[j]
+        if text == '(':
+            depth += 1
+        elif text == ')':
+            depth -= 1
+        elif text == '=' and depth == 0:
+            return None
+        elif name_index is None and kind == 'ident' and text not in NOT_CALLS and text not in TYPE_WORDS:
+            if j + 1 < brace and tokens[j + 1][1] == '(':
+                name_index, params_open = j, j + 1
+                nested = depth > 0
+            elif (j + 2 < brace and tokens[j - 1][1] == '(' and tokens[j + 1][1] == ')'
+                  and tokens[j + 2][1] == '('):
+                # double (creal)(double complex z): the name kept out of macro expansion
+                name_index, params_open = j, j + 2
+                nested = False
+    if name_index is None or tokens[brace - 1][1] not in (')',) and not _knr(tokens, name_index, brace):
+        return None
+    params_close = _match(tokens, params_open, '(', ')')
+
+    callees = []
+    for j in range(brace + 1, min(close, len(tokens) - 1)):
+        kind, text, _ = tokens[j]
+        if (kind == 'ident' and text not in NOT_CALLS and tokens[j + 1][1] == '('
+                and tokens[j - 1][1] not in ('.', '->') and text not in callees):
+            callees.append(text)
+    return {
+        "name": tokens[name_index][1],
+        "is_static": 'static' in words[:name_index - start],
+        "callees": callees,
+        "name_index": name_index,
+        "params": (params_open, params_close),
+        "nested": nested,
+    }
+
+def _knr(tokens, name_index: int, brace: int) -> bool:
+    """Old-style definition: f(a, b) int a; char *b; {"""
+    close = _match(tokens, name_index + 1, '(', ')')
+    return close < brace and tokens[brace - 1][1] == ';'
+
+def _alias(tokens, start: int, end: int) -> Optional[Dict[str, Any]]:
+    """weak_alias(target, alias); and the like"""
+    words = [t[1] for t in tokens[start:end]]
+    if (len(words) == 6 and words[0] in ALIAS_MACROS and words[1] == '(' and words[3] == ','
+            and words[5] == ')'):
+        return {"alias": words[4], "target": words[2], "kind": words[0]}
+    return None
+
+def split_parameters(parameters: str) -> List[Dict[str, str]]:
+    """[{"type", "name"}] of a parameter list such as const char *s, size_t n"""
+    result, depth, current = [], 0, ''
+    for ch in parameters + ',':
+        if ch == ',' and depth == 0:
+            current = current.strip()
+            if current and current != 'void':
+                if current == '...':
+                    result.append({"type": "...", "name": ""})
+                else:
+                    names = re.findall(r'[A-Za-z_]\w*', re.sub(r'\[[^\]]*\]', '', current))
+                    fnptr = re.search(r'\(\s*\*\s*([A-Za-z_]\w*)\s*\)', current)
+                    name = fnptr.group(1) if fnptr else (names[-1] if len(names) > 1 else '')
+                    if name and name not in TYPE_WORDS:
+                        at = fnptr.start(1) if fnptr else current.rindex(name)
+                        ptype = ' '.join((current[:at] + current[at + len(name):]).split())
+                    else:
+                        name, ptype = '', ' '.join(current.split())
+                    result.append({"type": ptype, "name": name})
+            current = ''
+            continue
+        depth += ch in '(['
+        depth -= ch in ')]'
+        current += ch
+    return result
+
+def parse_c_file(path: str) -> Tuple[str, str, List[Dict[str, Any]], List[Dict[str, Any]]]:
+    """(path, content hash, functions, aliases) of one file (runs in a worker process)"""
+    with open(path, 'rb') as f:
+        raw = f.read()
+    functions, aliases = parse_c_source(raw.decode('utf-8', 'ignore'))
+    return path, hashlib.sha1(raw).hexdigest(), functions, aliases
+
+class MuslSourceIndex:
+    """Parsed musl sources in one SQLite database
+
+    refresh() reparses, in parallel, only the files whose content hash
+    changed (the mtime and size are checked first, so unchanged files are
+    not even read), and drops the entries of deleted files.
+    """
+
+    def __init__(self, db_path: str = "./data/musl_source_index.db"):
+        self.db_path = Path(db_path)
+        self.db_path.parent.mkdir(parents=True, exist_ok=True)
+        conn = self._connect()
+        try:
+            conn.execute("PRAGMA journal_mode=WAL")
+            conn.execute('''
+                CREATE TABLE IF NOT EXISTS files (
+                    path TEXT PRIMARY KEY,
+                    hash TEXT,
+                    mtime REAL,
+                    size INTEGER,
+                    parser TEXT
+                )
+            ''')
+            conn.execute('''
+                CREATE TABLE IF NOT EXISTS functions (
+                    name TEXT NOT NULL,
+                    path TEXT NOT NULL,
+                    start_line INTEGER,
+                    name_line INTEGER,
+                    end_line INTEGER,
+                    signature TEXT,
+                    return_type TEXT,
+                    parameters TEXT,
+                    is_static INTEGER,
+                    callees TEXT
+                )
+            ''')
+            conn.execute('''
+                CREATE TABLE IF NOT EXISTS aliases (
+                    alias TEXT NOT NULL,
+                    target TEXT NOT NULL,
+                    path TEXT NOT NULL,
+                    line INTEGER,
+                    kind TEXT
+                )
+            ''')
+            conn.execute("CREATE INDEX IF NOT EXISTS functions_name ON functions(name)")
+            conn.execute("CREATE INDEX IF NOT EXISTS functions_path ON functions(path)")
+            conn.execute("CREATE INDEX IF NOT EXISTS aliases_alias ON aliases(alias)")
+            conn.execute("CREATE INDEX IF NOT EXISTS aliases_path ON aliases(path)")
+            conn.commit()
+        finally:
+            conn.close()
+
+    def _connect(self) -> sqlite3.Connection:
+        return sqlite3.connect(str(self.db_path), timeout=30)
+
+    def refresh(self, src_path: str, max_workers: Optional[int] = None) -> Dict[str, Any]:
+        """Bring the index up to date with the .c files under src_path"""
+        start = time.time()
+        on_disk = {}
+        for root, dirs, files in os.walk(src_path):
+            for name in files:
+                if name.endswith('.c'):
+                    path = os.path.abspath(os.path.join(root, name))
+                    st = os.stat(path)
+                    on_disk[path] = (st.st_mtime, st.st_size)
+
+        conn = self._connect()
+        try:
+            indexed = {row[0]: row[1:] for row in conn.execute("SELECT path, hash, mtime, size, parser FROM files")}
+        finally:
+            conn.close()
+        stale = [p for p, (mtime, size) in on_disk.items()
+                 if p not in indexed or indexed[p][1:] != (mtime, size, PARSER_VERSION)]
+        removed = [p for p in indexed if p not in on_disk]
+
+        if len(stale) > 32:
+            with ProcessPoolExecutor(max_workers=max_workers) as executor:
+                parsed = list(executor.map(parse_c_file, stale, chunksize=32))
+        else:
+            parsed = [parse_c_file(p) for p in stale]
+
+        reparsed = 0
+        conn = self._connect()
+        try:
+            with conn:
+                for path in removed:
+                    self._drop(conn, path)
+                for path, digest, functions, aliases in parsed:
+                    mtime, size = on_disk[path]
+                    old = indexed.get(path)
+                    if old and old[0] == digest and old[3] == PARSER_VERSION:
+                        # Touched but unchanged: only remember the new mtime
+                        conn.execute("UPDATE files SET mtime = ?, size = ? WHERE path = ?", (mtime, size, path))
+                        continue
+                    reparsed += 1
+                    self._drop(conn, path)
+                    conn.execute("INSERT INTO files (path, hash, mtime, size, parser) VALUES (?, ?, ?, ?, ?)",
+                                 (path, digest, mtime, size, PARSER_VERSION))
+                    conn.executemany('''
+                        INSERT INTO functions (name, path, start_line, name_line, end_line, signature,
+                                               return_type, parameters, is_static, callees)
+                        VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
+                    ''', [(f["name"], path, f["start_line"], f["name_line"], f["end_line"], f["signature"],
+                           f["return_type"], f["parameters"], int(f["is_static"]), json.dumps(f["callees"]))
+                          for f in functions])
+                    conn.executemany("INSERT INTO aliases (alias, target, path, line, kind) VALUES (?, ?, ?, ?, ?)",
+                                     [(a["alias"], a["target"], path, a["line"], a["kind"]) for a in aliases])
+            counts = conn.execute("SELECT (SELECT COUNT(*) FROM functions), (SELECT COUNT(*) FROM aliases)").fetchone()
+        finally:
+            conn.close()
+
+        stats = {
+            "files_scanned": len(on_disk),
+            "files_reparsed": reparsed,
+            "files_removed": len(removed),
+            "functions_found": counts[0],
+            "aliases_found": counts[1],
+            "seconds": round(time.time() - start, 2),
+        }
+        logger.info(f"musl source index refreshed: {stats}")
+        return stats
+
+    @staticmethod
+    def _drop(conn: sqlite3.Connection, path: str):
+        conn.execute("DELETE FROM functions WHERE path = ?", (path,))
+        conn.execute("DELETE FROM aliases WHERE path = ?", (path,))
+        conn.execute("DELETE FROM files WHERE path = ?", (path,))
+
+    @staticmethod
+    def _row(row) -> Dict[str, Any]:
+        keys = ("name", "path", "start_line", "name_line", "end_line", "signature",
+                "return_type", "parameters", "is_static", "callees")
+        entry = dict(zip(keys, row))
+        entry["is_static"] = bool(entry["is_static"])
+        entry["callees"] = json.loads(entry["callees"]) if entry["callees"] else []
+        return entry
+
+    _COLUMNS = "name, path, start_line, name_line, end_line, signature, return_type, parameters, is_static, callees"
+
+    def functions(self, include_static: bool = False) -> List[Dict[str, Any]]:
+        conn = self._connect()
+        try:
+            rows = conn.execute(f"SELECT {self._COLUMNS} FROM functions"
+                                + ("" if include_static else " WHERE is_static = 0")
+                                + " ORDER BY path, start_line").fetchall()
+        finally:
+            conn.close()
+        return [self._row(r) for r in rows]
+
+    def aliases(self) -> List[Dict[str, Any]]:
+        conn = self._connect()
+        try:
+            rows = conn.execute("SELECT alias, target, path, line, kind FROM aliases ORDER BY path, line").fetchall()
+        finally:
+            conn.close()
+        return [dict(zip(("alias", "target", "path", "line", "kind"), r)) for r in rows]
+
+    def find(self, name: str) -> Optional[Dict[str, Any]]:
+        """Definition of an external function, following weak_alias and friends"""
+        conn = self._connect()
+        try:
+            for _ in range(4):
+                row = conn.execute(f"SELECT {self._COLUMNS} FROM functions WHERE name = ? "
+                                   "ORDER BY is_static, path LIMIT 1", (name,)).fetchone()
+                if row:
+                    return self._row(row)
+                alias = conn.execute("SELECT target FROM aliases WHERE alias = ? LIMIT 1", (name,)).fetchone()
+                if not alias:
+                    return None
+                name = alias[0]
+        finally:
+            conn.close()
+        return None
+
+    def function_at(self, path: str, line: int) -> Optional[Dict[str, Any]]:
+        """The definition in a file whose span contains a line"""
+        conn = self._connect()
+        try:
+            row = conn.execute(f"SELECT {self._COLUMNS} FROM functions WHERE path = ? "
+                               "AND start_line <= ? AND end_line >= ? ORDER BY start_line DESC LIMIT 1",
+                               (os.path.abspath(path), line, line)).fetchone()
+        finally:
+            conn.close()
+        return self._row(row) if row else None
+
+class MuslSourceCache:
+    """Source files memory-mapped once, with their line offsets and function spans
+
+    Extracting a function is then a slice of the mapping instead of a read
+    and split of the whole file. The spans are parsed on a file's first
+    span lookup; a file whose mtime or size changed is mapped again. At most
+    max_files stay mapped, the least recently used are closed.
+    """
+
+    def __init__(self, max_files: int = 256):
+        self.max_files = max_files
+        self._files: "OrderedDict[str, Dict[str, Any]]" = OrderedDict()
+        self._lock = threading.Lock()
+
+    def _entry(self, path: str) -> Optional[Dict[str, Any]]:
+        path = os.path.abspath(path)
+        try:
+            st = os.stat(path)
+        except OSError:
+            return None
+        key = (st.st_mtime_ns, st.st_size)
+        with self._lock:
+            entry = self._files.get(path)
+            if entry and entry["key"] == key:
+                self._files.move_to_end(path)
+                return entry
+            if entry:
+                self._close(self._files.pop(path))
+            try:
+                with open(path, 'rb') as f:
+                    data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) if st.st_size else b''
+            except (OSError, ValueError):
+                return None
+            # Offset of the start of every line, and one past the end of the last
+            starts = [0] + [m.end() for m in re.finditer(b'\n', data)]
+            if starts[-1] != len(data):
+                starts.append(len(data))
+            entry = {"key": key, "data": data, "starts": starts, "spans": None}
+            self._files[path] = entry
+            while len(self._files) > self.max_files:
+                self._close(self._files.popitem(last=False)[1])
+            return entry
+
+    @staticmethod
+    def _close(entry: Dict[str, Any]):
+        if isinstance(entry["data"], mmap.mmap):
+            entry["data"].close()
+
+    def lines(self, path: str, first: int, last: int) -> Optional[str]:
+        """Lines first..last (1-based, inclusive) of a file, without the final newline"""
+        entry = self._entry(path)
+        if entry is None:
+            return None
+        starts = entry["starts"]
+        first = max(first, 1)
+        last = min(last, len(starts) - 1)
+        if first > last:
+            return ''
+        return entry["data"][starts[first - 1]:starts[last]].decode('utf-8', 'ignore').rstrip('\n')
+
+    def text(self, path: str) -> Optional[str]:
+        entry = self._entry(path)
+        return None if entry is None else entry["data"][:].decode('utf-8', 'ignore')
+
+    def function_at(self, path: str, line: int) -> Optional[Dict[str, Any]]:
+        """The file-scope definition whose span contains a line, from the file's own parse"""
+        entry = self._entry(path)
+        if entry is None:
+            return None
+        if entry["spans"] is None:
+            functions, _ = parse_c_source(entry["data"][:].decode('utf-8', 'ignore'))
+            spans = sorted(functions, key=lambda f: f["start_line"])
+            entry["spans"] = (spans, [f["start_line"] for f in spans])
+        spans, start_lines = entry["spans"]
+        i = bisect.bisect_right(start_lines, line) - 1
+        if i >= 0 and spans[i]["end_line"] >= line:
+            return spans[i]
+        return None
@@ -10,20 +10,34 @@ import sys
 import json
 import logging
 import time
+import multiprocessing
+import threading
 import requests
-from typing import Dict, List, Optional, Any
+from concurrent.futures import ProcessPoolExecutor
+from pathlib import Path
+from typing import Dict, List, Optional, Any, Tuple
 from dataclasses import dataclass
-from bs4 import BeautifulSoup
 
 # Add src directory to Python path  
 current_dir = os.path.dirname(os.path.abspath(__file__))
 sys.path.insert(0, current_dir)
+sys.path.insert(1, os.path.dirname(current_dir))
 
-from qnx_batch_processor import serialize_function_info
 from qnx_gdb_type_enhancer import QNXGDBTypeEnhancer
+from qnx_function_info import QNXFunctionInfo, FunctionParameter, HeaderFile
+from qnx_doc_parser import QNXDocParser
+from qnx_html_clean import CLEAN_VERSION, clean_html
+from qnx_page_cache import QNXPageCache
+from core.llm_cache import LLMCache
 
 logger = logging.getLogger(__name__)
 
+# Bump when the extraction prompt or the handling of its answer changes,
+# so that cached answers of the old prompt are no longer used
+EXTRACTION_PROMPT_VERSION = "1"
+# Pages cleaned in the calling thread below this; a process pool above
+CLEAN_POOL_MIN = 8
+
 class ClaudeJSONExtractor:
     """Claude-based JSON extractor for QNX functions"""
     
@@ -59,6 +73,32 @@ class ClaudeJSONExtractor:
         self.max_retries = request_config.get("max_retries", 3)
         self.retry_delay = request_config.get("retry_delay", 1.0)
         
+        # Rule-based parsing of the page first, the LLM only for pages it cannot parse
+        processing_config = self.config.get("processing_settings", {})
+        self.doc_parser = QNXDocParser() if processing_config.get("rule_based_extraction", True) else None
+        
+        # Batched LLM extraction: pages per request, bounded by the prompt size and
+        # by the output budget (one JSON object per function)
+        self.batch_size = processing_config.get("extraction_batch_size", 4)
+        self.batch_max_chars = processing_config.get("extraction_batch_max_chars", 24000)
+        
+        # Answers already paid for, per (page, model, prompt version)
+        self.llm_cache = LLMCache.from_config(self.config)
+        
+        # Cleaned text kept beside the crawler's page bodies; cleaning runs in
+        # worker processes, out of the GIL of the extraction threads
+        try:
+            self.page_cache = QNXPageCache(Path("./data/qnx_web_cache") / "pages.db")
+        except Exception as e:
+            logger.warning(f"Cleaned page cache unavailable: {e}")
+            self.page_cache = None
+        self.clean_workers = processing_config.get("clean_workers", os.cpu_count() or 1)
+        self._clean_pool = None
+        self._clean_pool_lock = threading.Lock()
+        
+        # Optional AdaptiveRateLimiter shared with other extractors (set by the pipelines)
+        self.rate_limiter = None
+        
         # Initialize QNX GDB type enhancer (only if enabled for extraction phase)
         if enable_gdb_in_extraction:
             try:
@@ -81,6 +121,7 @@ class ClaudeJSONExtractor:
         logger.info(f"Model: {self.model}")
         logger.info(f"Base URL: {self.base_url}")
         logger.info(f"GDB enhancement: {'Enabled' if self.gdb_enhancement_enabled else 'Disabled'}")
+        logger.info(f"Rule-based extraction: {'Enabled' if self.doc_parser else 'Disabled'}")
     
     def _load_config(self, config_path: str) -> Dict[str, Any]:
         """Load configuration file"""
@@ -133,46 +174,105 @@ Important requirements:
 4. Focus on accuracy and completeness
 5. Extract function prototype exactly as shown"""
     
+    def _create_batch_extraction_prompt(self, names: List[str]) -> str:
+        """Prompt for several pages at once, answered with one JSON array"""
+        return self.extraction_prompt + f"""
+
+BATCH MODE: the input below holds {len(names)} documentation pages, each starting with a line
+"=== FUNCTION: <name> ===". Output ONE JSON array with exactly one object of the structure
+above per page, in the same order, each with "name" set to the function name of its page:
+[{{"name": "{names[0]}", ...}}, ...]"""
+    
     def clean_html_content(self, html_content: str) -> str:
         """Clean HTML content and extract text"""
+        return self.clean_pages([html_content])[0]
+    
+    def _pool(self) -> ProcessPoolExecutor:
+        with self._clean_pool_lock:
+            if self._clean_pool is None:
+                # spawn: the extraction threads may hold locks a forked child would inherit
+                self._clean_pool = ProcessPoolExecutor(
+                    max_workers=self.clean_workers, mp_context=multiprocessing.get_context("spawn"))
+            return self._clean_pool
+    
+    def clean_pages(self, pages: List[str]) -> List[str]:
+        """Cleaned text of each page
+        
+        Pages cleaned before, by the same CLEAN_VERSION, come from the page
+        cache. The others are cleaned in the worker processes when there are
+        CLEAN_POOL_MIN or more, and stored for the next run.
+        """
+        digests = [QNXPageCache.content_hash(html) for html in pages]
+        cleaned: Dict[str, str] = {}
+        if self.page_cache:
+            try:
+                cleaned = self.page_cache.get_cleaned(list(set(digests)), CLEAN_VERSION)
+            except Exception as e:
+                logger.warning(f"Failed to read cleaned pages: {e}")
+        todo = {d: html for d, html in zip(digests, pages) if d not in cleaned}
+        if todo:
+            texts = None
+            if len(todo) >= CLEAN_POOL_MIN and self.clean_workers > 1:
+                try:
+                    texts = list(self._pool().map(clean_html, todo.values(), chunksize=4))
+                except Exception as e:
+                    logger.warning(f"Cleaning pool failed, cleaning in this thread: {e}")
+                    with self._clean_pool_lock:
+                        self._clean_pool = None
+            if texts is None:
+                texts = [clean_html(html) for html in todo.values()]
+            fresh = dict(zip(todo, texts))
+            cleaned.update(fresh)
+            if self.page_cache:
+                try:
+                    self.page_cache.put_cleaned(fresh, CLEAN_VERSION)
+                except Exception as e:
+                    logger.warning(f"Failed to store cleaned pages: {e}")
+        return [cleaned[d] for d in digests]
+    
+    def _cache_entry(self, function_name: str, cleaned_content: str) -> Tuple:
+        """LLM cache arguments for the extraction of one cleaned page"""
+        return ("qnx_extract", EXTRACTION_PROMPT_VERSION, self.model,
+                f"{function_name}\n{cleaned_content}",
+                {"max_tokens": self.max_tokens, "temperature": self.temperature})
+    
+    def _cached_function_info(self, function_name: str, cleaned_content: str) -> Optional[QNXFunctionInfo]:
+        cached = self.llm_cache.get(*self._cache_entry(function_name, cleaned_content))
+        if not cached:
+            return None
         try:
-            soup = BeautifulSoup(html_content, 'html.parser')
-            
-            # Remove script and style tags
-            for script in soup(["script", "style"]):
-                script.decompose()
-            
-            # Get main content area
-            main_content = soup.find('div', class_='content') or soup.find('main') or soup.body or soup
-            
-            if main_content:
-                # Keep structured information
-                text_content = main_content.get_text(separator='\n', strip=True)
-                
-                # Clean extra blank lines
-                lines = [line.strip() for line in text_content.split('\n') if line.strip()]
-                cleaned_text = '\n'.join(lines)
-                
-                # Limit length to avoid token overflow
-                if len(cleaned_text) > 6000:
-                    cleaned_text = cleaned_text[:6000] + "\n... (content truncated)"
-                
-                return cleaned_text
-            else:
-                return html_content[:6000]
-                
+            return self._json_to_function_info(json.loads(cached))
         except Exception as e:
-            logger.warning(f"HTML cleaning failed: {e}")
-            return html_content[:6000]
+            logger.warning(f"Dropping unusable cached extraction of {function_name}: {e}")
+            self.llm_cache.delete(*self._cache_entry(function_name, cleaned_content))
+            return None
     
     def extract_function_info(self, html_content: str, function_name: str = "") -> Optional[QNXFunctionInfo]:
-        """Extract function information from HTML content using Claude API"""
+        """Extract function information from HTML content
+        
+        The page is parsed by rules first; Claude API is only called when the
+        parser cannot fill the function info confidently.
+        """
+        if self.doc_parser and function_name:
+            function_info = self.doc_parser.parse(html_content, function_name)
+            if function_info:
+                if self.gdb_enhancement_enabled:
+                    function_info = self._enhance_with_gdb_info(function_info)
+                logger.info(f"Function info extracted by rules: {function_name}")
+                return function_info
+            logger.info(f"Rule-based extraction not confident, using Claude: {function_name}")
+        
+        # Clean HTML content
+        cleaned_content = self.clean_html_content(html_content)
+        function_info = self._cached_function_info(function_name, cleaned_content)
+        if function_info:
+            if self.gdb_enhancement_enabled:
+                function_info = self._enhance_with_gdb_info(function_info)
+            logger.info(f"Function info loaded from LLM cache: {function_info.name}")
+            return function_info
         
         for attempt in range(self.max_retries):
             try:
-                # Clean HTML content
-                cleaned_content = self.clean_html_content(html_content)
-                
                 # Build full prompt
                 full_prompt = self.extraction_prompt + "\n\n" + cleaned_content
                 
@@ -189,6 +289,9 @@ Important requirements:
                     try:
                         json_data = json.loads(response)
                         function_info = self._json_to_function_info(json_data)
+                        namespace, version, model, key, params = self._cache_entry(function_name, cleaned_content)
+                        self.llm_cache.put(namespace, version, model, key,
+                                           json.dumps(json_data, ensure_ascii=False), params)
                         
                         # GDB type enhancement
                         if self.gdb_enhancement_enabled and function_info:
@@ -221,6 +324,124 @@ Important requirements:
         
         return None
     
+    def extract_functions_batch(self, pages: List[Tuple[str, str]]) -> Dict[str, Optional[QNXFunctionInfo]]:
+        """Extract several functions, (name, html) each, with as few API calls as possible
+        
+        Pages the rule-based parser handles never reach the API. The others are
+        packed into requests of up to batch_size pages and batch_max_chars of
+        cleaned text. Each element of the returned array is validated on its
+        own, and only the pages whose element is missing or invalid are sent
+        again, up to max_retries times.
+        """
+        results: Dict[str, Optional[QNXFunctionInfo]] = {}
+        pending, unparsed = [], []
+        for name, html_content in pages:
+            function_info = self.doc_parser.parse(html_content, name) if self.doc_parser else None
+            if function_info:
+                results[name] = function_info
+            else:
+                unparsed.append((name, html_content))
+        cleaned_pages = self.clean_pages([html_content for _, html_content in unparsed])
+        for (name, _), cleaned_content in zip(unparsed, cleaned_pages):
+            function_info = self._cached_function_info(name, cleaned_content)
+            if function_info:
+                results[name] = function_info
+            else:
+                pending.append((name, cleaned_content))
+        logger.info(f"Batch extraction: {len(pages) - len(pending)} by rules or from cache, "
+                    f"{len(pending)} for Claude")
+        
+        for attempt in range(self.max_retries):
+            if not pending:
+                break
+            if attempt:
+                time.sleep(self.retry_delay)
+            failed = []
+            for batch in self._pack_batches(pending):
+                extracted = self._extract_batch(batch)
+                for name, cleaned in batch:
+                    if extracted.get(name):
+                        results[name] = extracted[name]
+                    else:
+                        failed.append((name, cleaned))
+            if failed:
+                logger.warning(f"Batch extraction: {len(failed)} functions to retry "
+                               f"(Attempt {attempt + 1}/{self.max_retries})")
+            pending = failed
+        
+        for name, _ in pending:
+            logger.error(f"Failed to extract function info: {name}")
+            results[name] = None
+        
+        if self.gdb_enhancement_enabled:
+            for name, function_info in results.items():
+                if function_info:
+                    results[name] = self._enhance_with_gdb_info(function_info)
+        return results
+    
+    def _pack_batches(self, pending: List[Tuple[str, str]]) -> List[List[Tuple[str, str]]]:
+        batches, current, size = [], [], 0
+        for name, cleaned in pending:
+            if current and (len(current) >= self.batch_size or size + len(cleaned) > self.batch_max_chars):
+                batches.append(current)
+                current, size = [], 0
+            current.append((name, cleaned))
+            size += len(cleaned)
+        if current:
+            batches.append(current)
+        return batches
+    
+    def _extract_batch(self, batch: List[Tuple[str, str]]) -> Dict[str, QNXFunctionInfo]:
+        """One API call for a batch; the valid function infos of its answer by name"""
+        names = [name for name, _ in batch]
+        prompt = self._create_batch_extraction_prompt(names) + "\n\n" + "\n\n".join(
+            f"=== FUNCTION: {name} ===\n{cleaned}" for name, cleaned in batch)
+        logger.info(f"Start extracting {len(batch)} functions in one request: {', '.join(names)}")
+        
+        response = self._call_claude_api(prompt)
+        if not response:
+            return {}
+        try:
+            elements = json.loads(self._strip_code_fence(response))
+        except json.JSONDecodeError as e:
+            logger.error(f"Batch JSON parsing failed: {e}")
+            return {}
+        if isinstance(elements, dict):
+            elements = [elements]
+        if not isinstance(elements, list):
+            return {}
+        
+        extracted = {}
+        for i, element in enumerate(elements):
+            if not isinstance(element, dict):
+                continue
+            name = str(element.get("name", "")).strip().rstrip("()").strip()
+            if name not in names and len(elements) == len(batch):
+                # Misnamed: trust the position
+                name = names[i]
+            if name not in names or name in extracted:
+                continue
+            if not isinstance(element.get("parameters", []), list) or not isinstance(element.get("headers", []), list):
+                continue
+            try:
+                element["name"] = name
+                extracted[name] = self._json_to_function_info(element)
+                namespace, version, model, key, params = self._cache_entry(name, dict(batch)[name])
+                self.llm_cache.put(namespace, version, model, key,
+                                   json.dumps(element, ensure_ascii=False), params)
+            except Exception as e:
+                logger.warning(f"Invalid batch element for {name}: {e}")
+        return extracted
+    
+    @staticmethod
+    def _strip_code_fence(response: str) -> str:
+        text = response.strip()
+        if text.startswith("```"):
+            text = text.split("\n", 1)[1] if "\n" in text else ""
+            if text.rstrip().endswith("```"):
+                text = text.rstrip()[:-3]
+        return text
+    
     def _call_claude_api(self, prompt: str) -> Optional[str]:
         """Call Claude API with the given prompt"""
         # Try different endpoint formats since this might be a relay service
@@ -254,12 +475,16 @@ Important requirements:
                 }
                 
                 logger.info(f"Trying endpoint: {endpoint}")
+                if self.rate_limiter:
+                    self.rate_limiter.acquire()
                 response = requests.post(
                     endpoint,
                     headers=headers,
                     json=payload,
                     timeout=self.timeout
                 )
+                if self.rate_limiter:
+                    self.rate_limiter.report(response.status_code, response.headers.get("Retry-After"))
                 
                 if response.status_code == 200:
                     result = response.json()
@@ -419,6 +644,9 @@ Important requirements:
         """Close resources"""
         if hasattr(self, 'gdb_enhancer') and self.gdb_enhancer:
             self.gdb_enhancer.close()
+        if getattr(self, '_clean_pool', None):
+            self._clean_pool.shutdown(wait=False)
+            self._clean_pool = None
     
     def __del__(self):
         """Destructor"""
@@ -0,0 +1,234 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Embedding Providers
+A local ONNX sentence-embedding model for offline indexing, and a persistent
+embedding cache keyed by the hash of model and text shared by all providers
+"""
+
+import hashlib
+import logging
+import os
+import sqlite3
+import struct
+import threading
+import time
+from pathlib import Path
+from typing import Any, Dict, List, Optional, Sequence
+
+logger = logging.getLogger(__name__)
+
+try:
+    import numpy as np
+    import onnxruntime as ort
+    from tokenizers import Tokenizer
+    LOCAL_EMBEDDINGS_AVAILABLE = True
+except ImportError:
+    LOCAL_EMBEDDINGS_AVAILABLE = False
+
+class EmbeddingCache:
+    """Embeddings in one SQLite database (WAL), stored as float32 blobs
+
+    The key is sha256(model, text), so switching models never returns a
+    vector of the wrong space and re-indexing unchanged documents costs no
+    model call at all.
+    """
+
+    def __init__(self, db_path: str = "./data/embedding_cache.db", enabled: bool = True):
+        self.db_path = Path(db_path)
+        self.enabled = enabled
+        self.hits = 0
+        self.misses = 0
+        if not enabled:
+            return
+        self.db_path.parent.mkdir(parents=True, exist_ok=True)
+        conn = self._connect()
+        try:
+            conn.execute("PRAGMA journal_mode=WAL")
+            conn.execute('''
+                CREATE TABLE IF NOT EXISTS embeddings (
+                    key TEXT PRIMARY KEY,
+                    model TEXT NOT NULL,
+                    dim INTEGER NOT NULL,
+                    vector BLOB NOT NULL,
+                    created_at REAL
+                )
+            ''')
+            conn.commit()
+        finally:
+            conn.close()
+
+    @classmethod
+    def from_config(cls, config: Dict[str, Any]) -> "EmbeddingCache":
+        """ai_settings.embedding.cache: {"enabled": true, "path": "./data/embedding_cache.db"}"""
+        cache_config = config.get("ai_settings", {}).get("embedding", {}).get("cache", {})
+        return cls(cache_config.get("path", "./data/embedding_cache.db"), cache_config.get("enabled", True))
+
+    def _connect(self) -> sqlite3.Connection:
+        return sqlite3.connect(str(self.db_path), timeout=30)
+
+    @staticmethod
+    def key(model: str, text: str) -> str:
+        return hashlib.sha256(f"{model}\0{text}".encode('utf-8')).hexdigest()
+
+    def get_many(self, model: str, texts: Sequence[str]) -> Dict[str, List[float]]:
+        """text -> embedding of the cached texts"""
+        if not self.enabled or not texts:
+            return {}
+        keys = {self.key(model, text): text for text in texts}
+        found = {}
+        try:
+            conn = self._connect()
+            try:
+                key_list = list(keys)
+                for i in range(0, len(key_list), 500):
+                    chunk = key_list[i:i + 500]
+                    rows = conn.execute(f"SELECT key, dim, vector FROM embeddings WHERE key IN "
+                                        f"({','.join('?' * len(chunk))})", chunk)
+                    for key, dim, vector in rows:
+                        found[keys[key]] = list(struct.unpack(f'{dim}f', vector))
+            finally:
+                conn.close()
+        except sqlite3.Error as e:
+            logger.warning(f"Embedding cache lookup failed: {e}")
+            return {}
+        self.hits += len(found)
+        self.misses += len(set(texts)) - len(found)
+        return found
+
+    def put_many(self, model: str, embeddings: Dict[str, Sequence[float]]):
+        if not self.enabled or not embeddings:
+            return
+        now = time.time()
+        try:
+            conn = self._connect()
+            try:
+                conn.executemany('''
+                    INSERT OR REPLACE INTO embeddings (key, model, dim, vector, created_at)
+                    VALUES (?, ?, ?, ?, ?)
+                ''', [(self.key(model, text), model, len(vector), struct.pack(f'{len(vector)}f', *vector), now)
+                      for text, vector in embeddings.items()])
+                conn.commit()
+            finally:
+                conn.close()
+        except sqlite3.Error as e:
+            logger.warning(f"Embedding cache store failed: {e}")
+
+def token_batches(lengths: Sequence[int], max_batch_tokens: int, max_batch_size: int) -> List[List[int]]:
+    """Indexes grouped by similar length so that padded length * count stays under max_batch_tokens"""
+    order = sorted(range(len(lengths)), key=lambda i: lengths[i])
+    batches, current, longest = [], [], 0
+    for i in order:
+        width = max(longest, lengths[i], 1)
+        if current and (width * (len(current) + 1) > max_batch_tokens or len(current) >= max_batch_size):
+            batches.append(current)
+            current, width = [], max(lengths[i], 1)
+        current.append(i)
+        longest = width
+    if current:
+        batches.append(current)
+    return batches
+
+class LocalEmbeddingProvider:
+    """A sentence-embedding model exported to ONNX (e.g. all-MiniLM-L6-v2 or bge-small)
+
+    Texts are tokenized in parallel by the Rust tokenizer (encode_batch),
+    sorted by length and run in dynamic batches bounded by a token budget,
+    so short function names are not padded to the length of long manual
+    pages. The CUDA execution provider is used when onnxruntime has it.
+    """
+
+    def __init__(self, model_path: str, tokenizer_path: Optional[str] = None, max_length: int = 256,
+                 max_batch_tokens: int = 16384, max_batch_size: int = 256, intra_op_threads: int = 0,
+                 pooling: str = "mean", normalize: bool = True, use_gpu: bool = True):
+        self.model_path = model_path
+        self.tokenizer_path = tokenizer_path or os.path.join(os.path.dirname(model_path), "tokenizer.json")
+        self.model_name = f"local:{Path(model_path).parent.name}/{Path(model_path).name}"
+        self.max_length = max_length
+        self.max_batch_tokens = max_batch_tokens
+        self.max_batch_size = max_batch_size
+        self.intra_op_threads = intra_op_threads
+        self.pooling = pooling
+        self.normalize = normalize
+        self.use_gpu = use_gpu
+        self._session = None
+        self._tokenizer = None
+        self._input_names = []
+        self._lock = threading.Lock()
+
+    @classmethod
+    def from_config(cls, config: Dict[str, Any]) -> "LocalEmbeddingProvider":
+        """ai_settings.embedding.local: {"model_path", "tokenizer_path", "max_length", "max_batch_tokens",
+        "max_batch_size", "intra_op_threads", "pooling", "use_gpu"}"""
+        local_config = config.get("ai_settings", {}).get("embedding", {}).get("local", {})
+        return cls(local_config.get("model_path", "./data/models/embedding/model.onnx"),
+                   local_config.get("tokenizer_path"),
+                   local_config.get("max_length", 256),
+                   local_config.get("max_batch_tokens", 16384),
+                   local_config.get("max_batch_size", 256),
+                   local_config.get("intra_op_threads", 0),
+                   local_config.get("pooling", "mean"),
+                   local_config.get("normalize", True),
+                   local_config.get("use_gpu", True))
+
+    @property
+    def available(self) -> bool:
+        return LOCAL_EMBEDDINGS_AVAILABLE and os.path.exists(self.model_path) and os.path.exists(self.tokenizer_path)
+
+    def _ensure_loaded(self) -> bool:
+        if self._session is not None:
+            return True
+        if not self.available:
+            return False
+        with self._lock:
+            if self._session is None:
+                options = ort.SessionOptions()
+                if self.intra_op_threads:
+                    options.intra_op_num_threads = self.intra_op_threads
+                providers = ['CPUExecutionProvider']
+                if self.use_gpu and 'CUDAExecutionProvider' in ort.get_available_providers():
+                    providers.insert(0, 'CUDAExecutionProvider')
+                tokenizer = Tokenizer.from_file(self.tokenizer_path)
+                tokenizer.enable_truncation(max_length=self.max_length)
+                session = ort.InferenceSession(self.model_path, sess_options=options, providers=providers)
+                self._input_names = [i.name for i in session.get_inputs()]
+                self._tokenizer = tokenizer
+                self._session = session
+                logger.info(f"Loaded local embedding model {self.model_path} ({session.get_providers()[0]})")
+        return True
+
+    def embed(self, texts: List[str]) -> List[Optional[List[float]]]:
+        """Embeddings in input order; None for every text when the model cannot run"""
+        if not texts:
+            return []
+        try:
+            if not self._ensure_loaded():
+                return [None] * len(texts)
+            encodings = self._tokenizer.encode_batch(texts)
+            results: List[Optional[List[float]]] = [None] * len(texts)
+            for batch in token_batches([len(e.ids) for e in encodings], self.max_batch_tokens, self.max_batch_size):
+                width = max(len(encodings[i].ids) for i in batch) or 1
+                ids = np.zeros((len(batch), width), dtype=np.int64)
+                mask = np.zeros((len(batch), width), dtype=np.int64)
+                for row, i in enumerate(batch):
+                    n = len(encodings[i].ids)
+                    ids[row, :n] = encodings[i].ids
+                    mask[row, :n] = 1
+                feeds = {"input_ids": ids, "attention_mask": mask}
+                if "token_type_ids" in self._input_names:
+                    feeds["token_type_ids"] = np.zeros_like(ids)
+                output = self._session.run(None, {k: v for k, v in feeds.items() if k in self._input_names})[0]
+                if output.ndim == 3:
+                    if self.pooling == "cls":
+                        output = output[:, 0]
+                    else:
+                        weights = mask[..., None].astype(output.dtype)
+                        output = (output * weights).sum(axis=1) / np.maximum(weights.sum(axis=1), 1e-9)
+                if self.normalize:
+                    output = output / np.maximum(np.linalg.norm(output, axis=1, keepdims=True), 1e-12)
+                for row, i in enumerate(batch):
+                    results[i] = output[row].astype(np.float32).tolist()
+            return results
+        except Exception as e:
+            logger.error(f"Local embedding failed: {e}")
+            return [None] * len(texts)
@@ -1,7 +1,7 @@
 #!/usr/bin/env python3
 # -*- coding: utf-8 -*-
 """
-OpenAI Vectorizer - Dedicated to OpenAI Embedding API
+Function Vectorizer - local ONNX embeddings or the OpenAI Embedding API
 """
 
 import os
@@ -13,10 +13,17 @@ from typing import Dict, List, Optional, Any
 from pathlib import Path
 from dataclasses import dataclass
 
-from openai import OpenAI
-import chromadb
+try:
+    from openai import OpenAI
+except ImportError:
+    OpenAI = None  # offline installs embed with the local model only
 from dotenv import load_dotenv
 
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from vector_store import VectorStore
+from embedding_providers import EmbeddingCache, LocalEmbeddingProvider
+from qnx_record_store import load_records
+
 # Load environment variables
 load_dotenv()
 
@@ -41,33 +48,44 @@ class VectorizeResult:
     error: Optional[str] = None
 
 class HybridVectorizer:
-    """OpenAI Vectorizer - Dedicated to OpenAI Embedding API"""
+    """Function vectorizer - a local ONNX model or the OpenAI Embedding API, behind a shared embedding cache"""
     
     def __init__(self, config_path: str = "config.json"):
-        """Initialize OpenAI vectorizer"""
+        """Initialize vectorizer"""
         # Load configuration
         self.config = self._load_config(config_path)
         
         # API configuration
         ai_config = self.config.get("ai_settings", {})
         openai_config = ai_config.get("openai", {})
+        embedding_config = ai_config.get("embedding", {})
         
         # OpenAI settings
         self.openai_api_key = os.getenv(openai_config.get("api_key_env", "OPENAI_API_KEY"))
         self.openai_embedding_model = openai_config.get("embedding_model", "text-embedding-3-small")
+        # The embeddings endpoint takes up to 2048 inputs per request
+        self.openai_batch_size = max(1, min(embedding_config.get("batch_size", 512), 2048))
+        
+        # Provider: "local" (ONNX model, no network), "openai", or "auto" (local when the model is installed)
+        self.provider = embedding_config.get("provider", "auto")
+        self.local_embedder = LocalEmbeddingProvider.from_config(self.config)
+        self.local_available = self.provider in ("local", "auto") and self.local_embedder.available
+        if self.provider == "local" and not self.local_available:
+            logger.warning(f"Local embedding model not available: {self.local_embedder.model_path}")
         
-        # Initialize OpenAI client
+        # Initialize OpenAI client (not needed, and never contacted, when the local model serves)
         self.openai_client = None
-        self.openai_available = self._init_openai()
+        self.openai_available = False
+        if self.provider == "openai" or (self.provider == "auto" and not self.local_available):
+            self.openai_available = self._init_openai()
+        self.embedding_cache = EmbeddingCache.from_config(self.config)
         
-        # ChromaDB settings
-        self.persist_dir = "./data/chroma_db/"
+        # Vector store settings
         self.collection_name = "qnx_functions_hybrid"
-        self.chroma_client = chromadb.PersistentClient(path=self.persist_dir)
         self.collection = None
         
-        logger.info("OpenAI vectorizer initialization completed")
-        logger.info(f"OpenAI available: {self.openai_available}")
+        logger.info("Vectorizer initialization completed")
+        logger.info(f"Local model available: {self.local_available}, OpenAI available: {self.openai_available}")
     
     def _load_config(self, config_path: str) -> Dict[str, Any]:
         """Load configuration file"""
@@ -82,6 +100,9 @@ class HybridVectorizer:
     def _init_openai(self) -> bool:
         """Initialize OpenAI client"""
         try:
+            if OpenAI is None:
+                logger.warning("openai package not installed")
+                return False
             if not self.openai_api_key:
                 logger.warning("OpenAI API key not found")
                 return False
@@ -132,106 +153,82 @@ class HybridVectorizer:
             logger.debug(f"OpenAI embedding failed: {e}")
             return None
     
+    @property
+    def embedding_model(self) -> str:
+        """Name of the model producing new embeddings (part of the cache key)"""
+        return self.local_embedder.model_name if self.local_available else self.openai_embedding_model
+    
     def get_single_embedding(self, text: str) -> VectorizeResult:
         """Get embedding for single text"""
         doc_id = f"text_{hash(text) % 10000}"
-        
-        # Get embedding using OpenAI
-        if self.openai_available:
-            embedding = self.get_embedding_openai(text)
-            if embedding:
-                return VectorizeResult(
-                    doc_id=doc_id,
-                    embedding=embedding,
-                    success=True,
-                    provider="openai"
-                )
-        
-        # Failed
-        return VectorizeResult(
-            doc_id=doc_id,
-            embedding=[],
-            success=False,
-            error="OpenAI embedding failed"
-        )
+        return self.get_batch_embeddings([VectorizeTask(text, doc_id, {})])[0]
     
-    def get_batch_embeddings(self, tasks: List[VectorizeTask]) -> List[VectorizeResult]:
-        """Batch get embeddings with true batch processing"""
-        results = []
-        
-        logger.info(f"Starting optimized batch processing of {len(tasks)} embedding tasks")
-        
-        # Use OpenAI batch API for better performance
-        if self.openai_available:
-            batch_size = 20  # OpenAI allows up to 2048 texts per batch
+    def _embed_openai(self, texts: List[str]) -> Dict[str, List[float]]:
+        """text -> embedding from the OpenAI API, in requests of openai_batch_size inputs"""
+        embeddings = {}
+        for i in range(0, len(texts), self.openai_batch_size):
+            batch_texts = texts[i:i + self.openai_batch_size]
             
-            for i in range(0, len(tasks), batch_size):
-                batch_tasks = tasks[i:i+batch_size]
-                batch_texts = [task.text for task in batch_tasks]
-                
-                logger.info(f"Processing batch {i//batch_size + 1}/{(len(tasks) + batch_size - 1)//batch_size} ({len(batch_tasks)} items)")
-                
-                try:
-                    # Single API call for the entire batch
-                    response = self.openai_client.embeddings.create(
-                        model=self.openai_embedding_model,
-                        input=batch_texts
-                    )
+            logger.info(f"Processing batch {i // self.openai_batch_size + 1}/"
+                        f"{(len(texts) + self.openai_batch_size - 1) // self.openai_batch_size} ({len(batch_texts)} items)")
+            
+            try:
+                # Single API call for the entire batch
+                response = self.openai_client.embeddings.create(
+                    model=self.openai_embedding_model,
+                    input=batch_texts
+                )
+                for text, item in zip(batch_texts, response.data):
+                    embeddings[text] = item.embedding
                     
-                    # Process batch results
-                    for j, task in enumerate(batch_tasks):
-                        if j < len(response.data):
-                            embedding = response.data[j].embedding
-                            result = VectorizeResult(
-                                doc_id=task.doc_id,
-                                embedding=embedding,
-                                success=True,
-                                provider="openai"
-                            )
-                        else:
-                            result = VectorizeResult(
-                                doc_id=task.doc_id,
-                                embedding=[],
-                                success=False,
-                                error="OpenAI batch result missing"
-                            )
-                        results.append(result)
-                        
-                except Exception as e:
-                    logger.error(f"Batch embedding failed: {e}")
-                    # Fallback to individual processing for this batch
-                    for task in batch_tasks:
-                        embedding = self.get_embedding_openai(task.text)
-                        if embedding:
-                            result = VectorizeResult(
-                                doc_id=task.doc_id,
-                                embedding=embedding,
-                                success=True,
-                                provider="openai"
-                            )
-                        else:
-                            result = VectorizeResult(
-                                doc_id=task.doc_id,
-                                embedding=[],
-                                success=False,
-                                error="OpenAI embedding failed"
-                            )
-                        results.append(result)
-                
-                # Rate limiting between batches (much less delay needed)
+            except Exception as e:
+                logger.error(f"Batch embedding failed: {e}")
+                # Fallback to individual processing for this batch
+                for text in batch_texts:
+                    embedding = self.get_embedding_openai(text)
+                    if embedding:
+                        embeddings[text] = embedding
+            
+            # Rate limiting between batches (much less delay needed)
+            if i + self.openai_batch_size < len(texts):
                 time.sleep(0.5)
-        else:
-            # Fallback to original method if OpenAI not available
-            for i, task in enumerate(tasks):
-                logger.debug(f"Processing {i+1}/{len(tasks)}: {task.text[:50]}...")
-                result = VectorizeResult(
+        return embeddings
+    
+    def get_batch_embeddings(self, tasks: List[VectorizeTask]) -> List[VectorizeResult]:
+        """Batch get embeddings: cached texts first, the rest from the local model or OpenAI in large batches"""
+        logger.info(f"Starting batch processing of {len(tasks)} embedding tasks")
+        
+        model = self.embedding_model
+        texts = list(dict.fromkeys(task.text for task in tasks))
+        cached = self.embedding_cache.get_many(model, texts)
+        missing = [text for text in texts if text not in cached]
+        
+        fresh, provider = {}, ""
+        if missing and self.local_available:
+            provider = "local"
+            fresh = {text: e for text, e in zip(missing, self.local_embedder.embed(missing)) if e is not None}
+        elif missing and self.openai_available:
+            provider = "openai"
+            fresh = self._embed_openai(missing)
+        self.embedding_cache.put_many(model, fresh)
+        
+        results = []
+        for task in tasks:
+            embedding = cached.get(task.text) or fresh.get(task.text)
+            if embedding:
+                results.append(VectorizeResult(
+                    doc_id=task.doc_id,
+                    embedding=embedding,
+                    success=True,
+                    provider="cache" if task.text in cached else provider
+                ))
+            else:
+                results.append(VectorizeResult(
                     doc_id=task.doc_id,
                     embedding=[],
                     success=False,
-                    error="OpenAI not available"
-                )
-                results.append(result)
-                time.sleep(0.1)
+                    error=f"{provider} embedding failed" if provider else "No embedding provider available"
+                ))
         
         successful = [r for r in results if r.success]
         logger.info(f"Batch processing completed: {len(successful)}/{len(tasks)} successful")
@@ -239,32 +236,21 @@ class HybridVectorizer:
         # Count usage statistics
         provider_stats = {}
         for result in successful:
-            provider = result.provider
-            provider_stats[provider] = provider_stats.get(provider, 0) + 1
+            provider_stats[result.provider] = provider_stats.get(result.provider, 0) + 1
         
         logger.info(f"API usage statistics: {provider_stats}")
         
         return results
     
-    def create_or_get_collection(self, reset: bool = False) -> chromadb.Collection:
-        """Create or get ChromaDB collection"""
+    def create_or_get_collection(self, reset: bool = False) -> VectorStore:
+        """Open (or reset) the quantized vector store of the function embeddings"""
+        if self.collection is None:
+            self.collection = VectorStore.from_config(self.config, self.collection_name)
         if reset:
-            try:
-                self.chroma_client.delete_collection(name=self.collection_name)
-                logger.info(f"Deleted existing collection: {self.collection_name}")
-            except (ValueError, Exception):
-                pass
-        
-        try:
-            self.collection = self.chroma_client.get_collection(name=self.collection_name)
-            logger.info(f"Retrieved existing collection: {self.collection_name}")
-        except (ValueError, Exception):
-            self.collection = self.chroma_client.create_collection(
-                name=self.collection_name,
-                metadata={"description": "QNX function documentation vector database - Hybrid API version"}
-            )
-            logger.info(f"Created new collection: {self.collection_name}")
+            self.collection.reset()
+            logger.info(f"Deleted existing collection: {self.collection_name}")
         
+        logger.info(f"Using collection {self.collection_name} ({self.collection.count()} vectors)")
         return self.collection
     
     def store_vectors(self, results: List[VectorizeResult], documents: List[str], metadatas: List[Dict[str, Any]]) -> bool:
@@ -289,8 +275,8 @@ class HybridVectorizer:
             # Create or get collection
             collection = self.create_or_get_collection()
             
-            # Store to ChromaDB
-            collection.add(
+            # Store to the vector store (replacing older vectors of the same ids)
+            collection.upsert(
                 ids=doc_ids,
                 embeddings=embeddings,
                 documents=valid_documents,
@@ -304,47 +290,124 @@ class HybridVectorizer:
             logger.error(f"Failed to store vectors: {e}")
             return False
     
+    def content_hash(self, text: str) -> str:
+        """Hash of an embedded text under the current model (another model re-embeds everything)"""
+        return EmbeddingCache.key(self.embedding_model, text)
+    
+    def sync_vectors(self, tasks: List[VectorizeTask], documents: List[str],
+                     embeddings: Optional[Dict[str, List[float]]] = None, prune: bool = False) -> Dict[str, int]:
+        """Bring the store in line with tasks, embedding only what changed
+        
+        A record whose content_hash matches its task keeps its vector; when
+        only its document or metadata differ they are rewritten in place. New
+        and changed texts are embedded (unless embeddings has them already)
+        and upserted. With prune, ids that are no longer among the tasks are
+        deleted.
+        """
+        collection = self.create_or_get_collection()
+        stored = collection.get()
+        current = {doc_id: (stored["documents"][i], stored["metadatas"][i]) for i, doc_id in enumerate(stored["ids"])}
+        embeddings = embeddings or {}
+        stats = {"embedded": 0, "updated": 0, "unchanged": 0, "deleted": 0, "failed": 0}
+        
+        latest = {task.doc_id: (task, document) for task, document in zip(tasks, documents)}
+        changed, refreshed = [], []
+        for doc_id, (task, document) in latest.items():
+            metadata = dict(task.metadata, content_hash=self.content_hash(task.text))
+            old = current.get(doc_id)
+            if old is None or old[1].get("content_hash") != metadata["content_hash"]:
+                changed.append((task, document, metadata))
+                continue
+            metadata["embedding_provider"] = old[1].get("embedding_provider", "")
+            if old[0] != document or old[1] != metadata:
+                refreshed.append((doc_id, document, metadata))
+            else:
+                stats["unchanged"] += 1
+        
+        missing = [task for task, _, _ in changed if task.doc_id not in embeddings]
+        fresh = {r.doc_id: r for r in self.get_batch_embeddings(missing)} if missing else {}
+        ids, vectors, docs, metas = [], [], [], []
+        for task, document, metadata in changed:
+            if task.doc_id in embeddings:
+                vector = embeddings[task.doc_id]
+            else:
+                result = fresh.get(task.doc_id)
+                if not result or not result.success:
+                    stats["failed"] += 1
+                    continue
+                vector = result.embedding
+                metadata["embedding_provider"] = result.provider
+            ids.append(task.doc_id)
+            vectors.append(vector)
+            docs.append(document)
+            metas.append(metadata)
+        
+        try:
+            if ids:
+                collection.upsert(ids, vectors, docs, metas)
+                stats["embedded"] = len(ids)
+            if refreshed:
+                collection.update([r[0] for r in refreshed], [r[1] for r in refreshed], [r[2] for r in refreshed])
+                stats["updated"] = len(refreshed)
+            if prune:
+                stats["deleted"] = collection.delete([doc_id for doc_id in current if doc_id not in latest])
+        except Exception as e:
+            logger.error(f"Failed to store vectors: {e}")
+            stats["failed"] += len(ids)
+            stats["embedded"] = 0
+        
+        logger.info(f"Vector sync: {stats['embedded']} embedded, {stats['updated']} updated in place, "
+                    f"{stats['unchanged']} unchanged, {stats['deleted']} deleted, {stats['failed']} failed")
+        return stats
+    
     def query_similar(self, query_text: str, n_results: int = 5) -> List[Dict[str, Any]]:
         """Query similar documents"""
+        return self.query_similar_batch([query_text], n_results)[0]
+    
+    def query_similar_batch(self, query_texts: List[str], n_results: int = 5) -> List[List[Dict[str, Any]]]:
+        """Query similar documents for several texts: one embedding call, one store query"""
         if not self.collection:
             self.create_or_get_collection()
         
-        # Get query vector
-        query_result = self.get_single_embedding(query_text)
-        if not query_result.success:
-            logger.error("Unable to get query vector")
-            return []
+        # Get query vectors
+        tasks = [VectorizeTask(text, f"query_{i}", {}) for i, text in enumerate(query_texts)]
+        query_results = self.get_batch_embeddings(tasks) if len(tasks) > 1 else [self.get_single_embedding(query_texts[0])]
+        valid = [i for i, r in enumerate(query_results) if r.success]
+        if len(valid) < len(query_texts):
+            logger.error(f"Unable to get query vector for {len(query_texts) - len(valid)} queries")
+        
+        formatted_results = [[] for _ in query_texts]
+        if not valid:
+            return formatted_results
         
         try:
             results = self.collection.query(
-                query_embeddings=[query_result.embedding],
-                n_results=n_results,
-                include=["documents", "metadatas", "distances"]
+                query_embeddings=[query_results[i].embedding for i in valid],
+                n_results=n_results
             )
             
-            formatted_results = []
-            for i in range(len(results["documents"][0])):
-                formatted_results.append({
-                    "document": results["documents"][0][i],
-                    "metadata": results["metadatas"][0][i],
-                    "distance": results["distances"][0][i],
-                    "similarity": 1 - results["distances"][0][i]
-                })
+            for slot, i in enumerate(valid):
+                for j in range(len(results["ids"][slot])):
+                    formatted_results[i].append({
+                        "document": results["documents"][slot][j],
+                        "metadata": results["metadatas"][slot][j],
+                        "distance": results["distances"][slot][j],
+                        "similarity": 1 - results["distances"][slot][j]
+                    })
             
             return formatted_results
             
         except Exception as e:
             logger.error(f"Query failed: {e}")
-            return []
+            return formatted_results
 
-    def vectorize_functions_from_file(self, json_file_path: str) -> bool:
-        """Vectorize QNX functions from JSON file"""
+    def vectorize_functions_from_file(self, json_file_path: str, prune: bool = True) -> bool:
+        """Vectorize QNX functions from JSON file (the whole library: with prune, other ids are removed)"""
         logger.info(f"Starting vectorization of functions from {json_file_path}")
         
         try:
-            # Load JSON data
-            with open(json_file_path, 'r', encoding='utf-8') as f:
-                functions_data = json.load(f)
+            # Load JSON data (a single JSON object or a JSONL result store)
+            functions_data = load_records(json_file_path)
             
             logger.info(f"Loaded {len(functions_data)} functions from JSON file")
             
@@ -372,41 +435,18 @@ class HybridVectorizer:
                 )
                 tasks.append(task)
             
-            # Process in batches
-            batch_size = 100
-            total_batches = (len(tasks) + batch_size - 1) // batch_size
-            all_results = []
-            
-            for i in range(0, len(tasks), batch_size):
-                batch_tasks = tasks[i:i + batch_size]
-                batch_num = i // batch_size + 1
-                
-                logger.info(f"Processing batch {batch_num}/{total_batches} ({len(batch_tasks)} functions)")
-                
-                # Get embeddings
-                batch_results = self.get_batch_embeddings(batch_tasks)
-                all_results.extend(batch_results)
-                
-                # Store to database
-                successful_results = [r for r in batch_results if r.success]
-                if successful_results:
-                    documents = [tasks[i + j].text for j, r in enumerate(batch_results) if r.success]
-                    metadatas = [tasks[i + j].metadata for j, r in enumerate(batch_results) if r.success]
-                    
-                    self.store_vectors(successful_results, documents, metadatas)
-                
-                # Small delay between batches
-                if batch_num < total_batches:
-                    time.sleep(1)
+            # Embed and store only new or changed functions, drop functions no longer in the file
+            stats = self.sync_vectors(tasks, [task.text for task in tasks], prune=prune)
+            successful_count = stats["embedded"] + stats["updated"] + stats["unchanged"]
+            failed_count = stats["failed"]
             
             # Summary
-            successful_count = sum(1 for r in all_results if r.success)
-            failed_count = len(all_results) - successful_count
-            
             logger.info("=" * 60)
             logger.info("Vectorization Complete!")
             logger.info(f"Total functions: {len(functions_data)}")
-            logger.info(f"Successfully vectorized: {successful_count}")
+            logger.info(f"Up to date in vector store: {successful_count} "
+                        f"(embedded {stats['embedded']}, unchanged {stats['unchanged']})")
+            logger.info(f"Removed stale: {stats['deleted']}")
             logger.info(f"Failed: {failed_count}")
             logger.info(f"Success rate: {successful_count/len(functions_data)*100:.1f}%")
             logger.info("=" * 60)
@@ -477,6 +517,7 @@ def main():
     parser.add_argument('--test', action='store_true', help='Run test mode')
     parser.add_argument('--query', '-q', help='Test query for similarity search')
     parser.add_argument('--config', '-c', default='config.json', help='Configuration file path')
+    parser.add_argument('--no-prune', action='store_true', help='Keep stored functions missing from the input file')
     
     args = parser.parse_args()
     
@@ -522,7 +563,7 @@ def main():
             print(f"Error: Input file not found: {args.input}")
             return 1
         
-        success = vectorizer.vectorize_functions_from_file(args.input)
+        success = vectorizer.vectorize_functions_from_file(args.input, prune=not args.no_prune)
         return 0 if success else 1
     
     print("No action specified. Use --input to vectorize functions, --test for testing, or --query for search.")
@@ -10,21 +10,24 @@ import sys
 import json
 import logging
 import time
+import asyncio
 import threading
 import sqlite3
 from typing import Dict, List, Optional, Any, Tuple
 from pathlib import Path
 from dataclasses import dataclass, asdict
-from concurrent.futures import ThreadPoolExecutor, as_completed
 from queue import Queue, Empty
 
 # Add current directory to Python path
 sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(1, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
 
 from qnx_web_crawler import QNXWebCrawler, QNXFunction
 from claude_json_extractor import ClaudeJSONExtractor
-from hybrid_vectorizer import HybridVectorizer, VectorizeTask, VectorizeResult
+from hybrid_vectorizer import HybridVectorizer, VectorizeTask
 from qnx_gdb_type_enhancer import QNXGDBTypeEnhancer
+from qnx_record_store import JSONLRecordStore
+from core.rate_limit import AdaptiveRateLimiter
 
 # Configure logging
 logging.basicConfig(level=logging.INFO, format='%(asctime)s - %(levelname)s - %(message)s')
@@ -94,21 +97,31 @@ class QNXBatchProcessor:
         # Initialize GDB type enhancer
         self.gdb_enhancer = QNXGDBTypeEnhancer(config_path)
         
-        # GDB async processing setup
+        # GDB async processing setup: tasks go through an in-process queue to a pool
+        # of workers; gdb_tasks.db records their status so unfinished tasks resume
+        gdb_config = self.config.get("processing_settings", {}).get("gdb", {})
+        self.gdb_workers = max(1, gdb_config.get("workers", 4))
+        self.gdb_status_batch_size = gdb_config.get("status_batch_size", 50)
+        self.gdb_drain_timeout = gdb_config.get("drain_timeout", 600)
         self.gdb_queue = Queue()
-        self.gdb_results = {}
-        self.gdb_thread = None
+        self.gdb_updates = Queue()
+        self.gdb_threads = []
+        self.gdb_writer = None
         self.gdb_stop_flag = threading.Event()
         self.gdb_db_path = self.output_dir / "gdb_tasks.db"
         
         # Statistics
         self.stats = ProcessingStats()
         
-        # Processing settings
-        processing_config = self.config.get("processing_settings", {})
-        self.max_worker_threads = processing_config.get("max_worker_threads", 3)
-        self.api_delay_range = processing_config.get("api_request_delay_range", [0.5, 2.0])
-        self.enable_multithreading = processing_config.get("enable_multithreading", True)
+        # Pipeline settings: concurrency of each stage and the bound of the queues between them
+        pipeline_config = self.config.get("processing_settings", {}).get("pipeline", {})
+        self.extract_concurrency = pipeline_config.get("extract_concurrency", 4)
+        self.embed_concurrency = pipeline_config.get("embed_concurrency", 1)
+        self.queue_size = pipeline_config.get("queue_size", 32)
+        
+        # LLM request pacing shared by all extract workers, adapted to 429/5xx answers
+        self.rate_limiter = AdaptiveRateLimiter.from_config(self.config)
+        self.json_extractor.rate_limiter = self.rate_limiter
         
         # Batch settings
         self.embedding_batch_size = 10  # Process 10 function names per embedding batch
@@ -116,8 +129,8 @@ class QNXBatchProcessor:
         logger.info("QNX Batch Processor Final initialized")
         logger.info(f"Embedding batch size: {self.embedding_batch_size}")
         logger.info(f"Output directory: {self.output_dir}")
-        logger.info(f"Max worker threads: {self.max_worker_threads}")
-        logger.info(f"Multithreading enabled: {self.enable_multithreading}")
+        logger.info(f"Pipeline: {self.extract_concurrency} extract workers, "
+                    f"{self.embed_concurrency} embed workers, queue size {self.queue_size}")
     
     def _load_config(self, config_path: str) -> Dict[str, Any]:
         """Load configuration file"""
@@ -134,6 +147,7 @@ class QNXBatchProcessor:
             conn = sqlite3.connect(str(self.gdb_db_path))
             cursor = conn.cursor()
             
+            cursor.execute("PRAGMA journal_mode=WAL")
             cursor.execute('''
                 CREATE TABLE IF NOT EXISTS gdb_tasks (
                     id INTEGER PRIMARY KEY AUTOINCREMENT,
@@ -160,115 +174,148 @@ class QNXBatchProcessor:
         except Exception as e:
             logger.error(f"Failed to initialize GDB database: {e}")
 
-    def _gdb_consumer_worker(self):
-        """GDB consumer worker thread"""
-        logger.info("GDB consumer worker started")
+    def _gdb_consumer_worker(self, enhancer: QNXGDBTypeEnhancer):
+        """GDB worker thread: enhances queued functions with its own enhancer"""
+        logger.debug("GDB worker started")
         
-        while not self.gdb_stop_flag.is_set():
+        while True:
+            task = self.gdb_queue.get()
             try:
-                # Check for tasks in database
-                conn = sqlite3.connect(str(self.gdb_db_path))
-                cursor = conn.cursor()
-                
-                cursor.execute('''
-                    SELECT function_name, json_data FROM gdb_tasks 
-                    WHERE status = 'pending' 
-                    ORDER BY created_at 
-                    LIMIT 1
-                ''')
-                
-                task = cursor.fetchone()
-                
-                if task:
-                    function_name, json_data_str = task
-                    logger.info(f"Processing GDB enhancement for: {function_name}")
-                    
-                    try:
-                        # Parse JSON data
-                        json_data = json.loads(json_data_str)
-                        
-                        # Enhance function parameters using GDB
-                        if 'parameters' in json_data:
-                            enhanced_params = self.gdb_enhancer.enhance_function_parameters(
-                                json_data['parameters']
-                            )
-                            json_data['parameters'] = enhanced_params
-                        
-                        # Mark task as processed
-                        cursor.execute('''
-                            UPDATE gdb_tasks 
-                            SET status = 'completed', processed_at = CURRENT_TIMESTAMP 
-                            WHERE function_name = ?
-                        ''', (function_name,))
-                        
-                        # Store enhanced result
-                        cursor.execute('''
-                            INSERT OR REPLACE INTO gdb_results 
-                            (function_name, enhanced_data) 
-                            VALUES (?, ?)
-                        ''', (function_name, json.dumps(json_data)))
-                        
-                        conn.commit()
-                        logger.debug(f"GDB enhancement completed for: {function_name}")
-                        
-                    except Exception as e:
-                        logger.error(f"GDB enhancement failed for {function_name}: {e}")
-                        cursor.execute('''
+                if task is None:
+                    break
+                # After a stop the remaining tasks stay pending for the next run
+                if self.gdb_stop_flag.is_set():
+                    continue
+                function_name, json_data = task
+                try:
+                    json_data = dict(json_data)
+                    # Enhance function parameters using GDB
+                    if 'parameters' in json_data:
+                        json_data['parameters'] = enhancer.enhance_function_parameters(json_data['parameters'])
+                    self.gdb_updates.put(('completed', function_name, json_data))
+                    logger.debug(f"GDB enhancement completed for: {function_name}")
+                except Exception as e:
+                    logger.error(f"GDB enhancement failed for {function_name}: {e}")
+                    self.gdb_updates.put(('failed', function_name, None))
+            finally:
+                self.gdb_queue.task_done()
+        
+        if enhancer is not self.gdb_enhancer:
+            enhancer.close()
+        logger.debug("GDB worker stopped")
+
+    def _gdb_status_writer(self):
+        """Write queued task status changes to gdb_tasks.db, many per transaction"""
+        conn = sqlite3.connect(str(self.gdb_db_path), timeout=30)
+        running = True
+        while running:
+            update = self.gdb_updates.get()
+            batch = []
+            while update is not None:
+                batch.append(update)
+                if len(batch) >= self.gdb_status_batch_size:
+                    break
+                try:
+                    update = self.gdb_updates.get(timeout=0.2)
+                except Empty:
+                    break
+            running = update is not None
+            if not batch:
+                continue
+            try:
+                with conn:
+                    for status, function_name, json_data in batch:
+                        if status == 'pending':
+                            conn.execute('''
+                                INSERT OR REPLACE INTO gdb_tasks 
+                                (function_name, json_data, status) 
+                                VALUES (?, ?, 'pending')
+                            ''', (function_name, json.dumps(json_data)))
+                            continue
+                        conn.execute('''
                             UPDATE gdb_tasks 
-                            SET status = 'failed', processed_at = CURRENT_TIMESTAMP 
+                            SET status = ?, processed_at = CURRENT_TIMESTAMP 
                             WHERE function_name = ?
-                        ''', (function_name,))
-                        conn.commit()
-                
-                conn.close()
-                
-                # Sleep before checking for next task
-                time.sleep(1.0)
-                
+                        ''', (status, function_name))
+                        if status == 'completed':
+                            conn.execute('''
+                                INSERT OR REPLACE INTO gdb_results 
+                                (function_name, enhanced_data) 
+                                VALUES (?, ?)
+                            ''', (function_name, json.dumps(json_data)))
+                logger.debug(f"Recorded {len(batch)} GDB task updates")
             except Exception as e:
-                logger.error(f"GDB worker error: {e}")
-                time.sleep(5.0)
-        
-        logger.info("GDB consumer worker stopped")
+                logger.error(f"Failed to record GDB task updates: {e}")
+        conn.close()
 
     def start_gdb_processing(self):
         """Start async GDB processing"""
-        if self.gdb_thread and self.gdb_thread.is_alive():
+        if self.gdb_threads:
             return
         
         # Initialize database
         self._init_gdb_database()
         
-        # Start worker thread
+        # Resume tasks left pending by an interrupted run
+        try:
+            conn = sqlite3.connect(str(self.gdb_db_path))
+            pending = conn.execute(
+                "SELECT function_name, json_data FROM gdb_tasks WHERE status = 'pending' ORDER BY id").fetchall()
+            conn.close()
+        except Exception as e:
+            logger.error(f"Failed to load pending GDB tasks: {e}")
+            pending = []
+        for function_name, json_data_str in pending:
+            try:
+                self.gdb_queue.put((function_name, json.loads(json_data_str)))
+            except json.JSONDecodeError:
+                logger.warning(f"Failed to parse pending GDB task for {function_name}")
+        if pending:
+            logger.info(f"Resuming {len(pending)} pending GDB tasks")
+        
+        # Start status writer and worker threads, one enhancer (and GDB session) each
         self.gdb_stop_flag.clear()
-        self.gdb_thread = threading.Thread(target=self._gdb_consumer_worker, daemon=True)
-        self.gdb_thread.start()
-        logger.info("GDB async processing started")
+        self.gdb_writer = threading.Thread(target=self._gdb_status_writer, daemon=True)
+        self.gdb_writer.start()
+        for i in range(self.gdb_workers):
+            enhancer = self.gdb_enhancer if i == 0 else QNXGDBTypeEnhancer(self.config_path)
+            thread = threading.Thread(target=self._gdb_consumer_worker, args=(enhancer,), daemon=True)
+            thread.start()
+            self.gdb_threads.append(thread)
+        logger.info(f"GDB async processing started with {self.gdb_workers} workers")
+
+    def wait_gdb_processing(self, timeout: Optional[float] = None) -> bool:
+        """Wait until every queued GDB task is done; False on timeout"""
+        deadline = time.monotonic() + timeout if timeout is not None else None
+        with self.gdb_queue.all_tasks_done:
+            while self.gdb_queue.unfinished_tasks:
+                remaining = deadline - time.monotonic() if deadline is not None else None
+                if remaining is not None and remaining <= 0:
+                    logger.warning(f"GDB processing timed out with {self.gdb_queue.unfinished_tasks} tasks left")
+                    return False
+                self.gdb_queue.all_tasks_done.wait(remaining)
+        return True
 
     def stop_gdb_processing(self):
-        """Stop async GDB processing"""
-        if self.gdb_thread and self.gdb_thread.is_alive():
-            self.gdb_stop_flag.set()
-            self.gdb_thread.join(timeout=10)
-            logger.info("GDB async processing stopped")
+        """Stop async GDB processing and flush the recorded task status"""
+        if not self.gdb_threads:
+            return
+        self.gdb_stop_flag.set()
+        for _ in self.gdb_threads:
+            self.gdb_queue.put(None)
+        for thread in self.gdb_threads:
+            thread.join(timeout=30)
+        self.gdb_threads = []
+        self.gdb_updates.put(None)
+        self.gdb_writer.join(timeout=30)
+        self.gdb_writer = None
+        logger.info("GDB async processing stopped")
 
     def enqueue_gdb_task(self, function_name: str, json_data: Dict[str, Any]):
         """Enqueue function for GDB enhancement"""
-        try:
-            conn = sqlite3.connect(str(self.gdb_db_path))
-            cursor = conn.cursor()
-            
-            cursor.execute('''
-                INSERT OR REPLACE INTO gdb_tasks 
-                (function_name, json_data, status) 
-                VALUES (?, ?, 'pending')
-            ''', (function_name, json.dumps(json_data)))
-            
-            conn.commit()
-            conn.close()
-            logger.debug(f"Enqueued GDB task for: {function_name}")
-        except Exception as e:
-            logger.error(f"Failed to enqueue GDB task for {function_name}: {e}")
+        self.gdb_updates.put(('pending', function_name, json_data))
+        self.gdb_queue.put((function_name, json_data))
+        logger.debug(f"Enqueued GDB task for: {function_name}")
 
     def get_gdb_results(self) -> Dict[str, Dict[str, Any]]:
         """Get all completed GDB enhancement results"""
@@ -306,116 +353,37 @@ class QNXBatchProcessor:
         return functions
     
     def extract_json_data(self, functions: List[QNXFunction]) -> Dict[str, Dict[str, Any]]:
-        """Extract JSON data (multithreaded version configurable)"""
-        if self.enable_multithreading and len(functions) > 1:
-            logger.info(f"Extracting JSON data for {len(functions)} functions using {self.max_worker_threads} threads")
-            return self._extract_json_data_multithreaded(functions)
-        else:
-            logger.info(f"Extracting JSON data for {len(functions)} functions using single thread")
-            return self._extract_json_data_sequential(functions)
+        """Extract JSON data"""
+        logger.info(f"Extracting JSON data for {len(functions)} functions")
+        return self._extract_json_data_sequential(functions)
     
     def _extract_json_data_sequential(self, functions: List[QNXFunction]) -> Dict[str, Dict[str, Any]]:
-        """Single-threaded JSON extraction"""
-        json_data = {}
-        
-        for i, func in enumerate(functions):
-            logger.info(f"Processing JSON {i+1}/{len(functions)}: {func.name}")
-            
-            try:
-                function_info = self.json_extractor.extract_function_info(
-                    func.html_content, 
-                    func.name
-                )
-                
-                if function_info:
-                    serializable_info = serialize_function_info(function_info)
-                    json_data[func.name] = serializable_info
-                    self.stats.json_extracted += 1
-                    logger.debug(f"✓ Extracted JSON for {func.name}")
-                    
-                    # Enqueue for async GDB enhancement
-                    self.enqueue_gdb_task(func.name, serializable_info)
-                else:
-                    logger.warning(f"✗ Failed to extract JSON for {func.name}")
-                    self.stats.errors.append(f"JSON extraction failed: {func.name}")
-                    
-            except Exception as e:
-                error_msg = f"Error extracting JSON for {func.name}: {str(e)}"
-                logger.error(error_msg)
-                self.stats.errors.append(error_msg)
-        
-        logger.info(f"Successfully extracted JSON for {len(json_data)} functions")
-        return json_data
-    
-    def _extract_json_data_multithreaded(self, functions: List[QNXFunction]) -> Dict[str, Dict[str, Any]]:
-        """Multithreaded JSON extraction"""
+        """Single-threaded JSON extraction, several functions per API request"""
         json_data = {}
-        max_workers = self.max_worker_threads
-        api_delay_range = self.api_delay_range  # Copy to local variable
-        config_path = self.config_path
         
-        def extract_single_function(func_data):
-            """Single function JSON extraction task"""
-            func, index = func_data
-            try:
-                logger.info(f"Processing JSON {index+1}/{len(functions)}: {func.name}")
-                
-                # Add random delay to avoid concurrent API request issues
-                import random
-                delay_min, delay_max = api_delay_range
-                time.sleep(random.uniform(delay_min, delay_max))
-                
-                # Create a separate JSON extractor instance for each thread with GDB enhancement enabled
-                thread_extractor = ClaudeJSONExtractor(config_path, enable_gdb_in_extraction=True)
-                
-                function_info = thread_extractor.extract_function_info(
-                    func.html_content, 
-                    func.name
-                )
-                
-                # Close thread-specific extractor
-                thread_extractor.close()
+        try:
+            results = self.json_extractor.extract_functions_batch(
+                [(func.name, func.html_content) for func in functions]
+            )
+        except Exception as e:
+            error_msg = f"Error extracting JSON batch: {str(e)}"
+            logger.error(error_msg)
+            self.stats.errors.append(error_msg)
+            return json_data
+        
+        for func in functions:
+            function_info = results.get(func.name)
+            if function_info:
+                serializable_info = serialize_function_info(function_info)
+                json_data[func.name] = serializable_info
+                self.stats.json_extracted += 1
+                logger.debug(f"✓ Extracted JSON for {func.name}")
                 
-                if function_info:
-                    # Convert to serializable dict
-                    serializable_info = serialize_function_info(function_info)
-                    logger.debug(f"✓ Extracted JSON for {func.name}")
-                    return func.name, serializable_info, None
-                else:
-                    error_msg = f"JSON extraction failed: {func.name}"
-                    logger.warning(f"✗ Failed to extract JSON for {func.name}")
-                    return func.name, None, error_msg
-                    
-            except Exception as e:
-                error_msg = f"JSON extraction error: {func.name}: {str(e)}"
-                logger.error(f"Error extracting JSON for {func.name}: {e}")
-                return func.name, None, error_msg
-        
-        # Use ThreadPoolExecutor for parallel processing
-        with ThreadPoolExecutor(max_workers=max_workers) as executor:
-            # Prepare task data (function and index)
-            tasks = [(func, i) for i, func in enumerate(functions)]
-            
-            # Submit all tasks
-            futures = [executor.submit(extract_single_function, task) for task in tasks]
-            
-            # Collect results
-            for future in as_completed(futures):
-                try:
-                    func_name, result, error = future.result()
-                    
-                    if result:
-                        json_data[func_name] = result
-                        self.stats.json_extracted += 1
-                        
-                        # Enqueue for async GDB enhancement
-                        self.enqueue_gdb_task(func_name, result)
-                    else:
-                        self.stats.errors.append(error)
-                        
-                except Exception as e:
-                    logger.error(f"Thread execution error: {e}")
-                    self.stats.errors.append(f"Thread execution error: {str(e)}")
+                # Enqueue for async GDB enhancement
+                self.enqueue_gdb_task(func.name, serializable_info)
+            else:
+                logger.warning(f"✗ Failed to extract JSON for {func.name}")
+                self.stats.errors.append(f"JSON extraction failed: {func.name}")
         
         logger.info(f"Successfully extracted JSON for {len(json_data)} functions")
         return json_data
@@ -431,12 +399,18 @@ class QNXBatchProcessor:
         return batches
     
     def vectorize_function_names(self, function_names: List[str]) -> Dict[str, List[float]]:
-        """Vectorize function names"""
-        logger.info(f"Vectorizing {len(function_names)} function names")
+        """Vectorize function names that have no up-to-date vector in the store yet"""
+        stored = self.vectorizer.create_or_get_collection().content_hashes()
+        pending = [name for name in function_names if stored.get(name) != self.vectorizer.content_hash(name)]
+        if len(pending) < len(function_names):
+            logger.info(f"{len(function_names) - len(pending)} function names already vectorized, skipping")
+        logger.info(f"Vectorizing {len(pending)} function names")
+        if not pending:
+            return {}
         
         # Create vectorization tasks
         tasks = []
-        for func_name in function_names:
+        for func_name in pending:
             task = VectorizeTask(
                 text=func_name,  # Vectorize function name
                 doc_id=func_name,
@@ -471,50 +445,36 @@ class QNXBatchProcessor:
         return embeddings
     
     def store_vector_database(self, json_data: Dict[str, Dict[str, Any]], embeddings: Dict[str, List[float]]) -> bool:
-        """Store to vector database"""
+        """Store to vector database: new vectors are upserted, unchanged names only get their document refreshed"""
         logger.info("Storing data to vector database")
         
         try:
-            # Prepare storage data
-            results = []
+            # Prepare storage data: the function name is the embedded text, the JSON the document
+            tasks = []
             documents = []
-            metadatas = []
-            
             for func_name in json_data.keys():
-                if func_name in embeddings:
-                    # Create VectorizeResult object
-                    result = VectorizeResult(
-                        doc_id=func_name,
-                        embedding=embeddings[func_name],
-                        success=True,
-                        provider="hybrid"
-                    )
-                    results.append(result)
-                    
-                    # Document content stores JSON string
-                    documents.append(json.dumps(json_data[func_name], ensure_ascii=False))
-                    
-                    # Metadata
-                    metadatas.append({
+                tasks.append(VectorizeTask(
+                    text=func_name,
+                    doc_id=func_name,
+                    metadata={
                         "function_name": func_name,
                         "type": "qnx_function",
                         "category": func_name[0].lower()
-                    })
+                    }
+                ))
+                documents.append(json.dumps(json_data[func_name], ensure_ascii=False))
             
-            if results:
-                # Use hybrid vectorizer for storage
-                success = self.vectorizer.store_vectors(results, documents, metadatas)
-                
-                if success:
-                    self.stats.stored = len(results)
-                    logger.info(f"Successfully stored {len(results)} functions to vector database")
-                    return True
-                else:
-                    logger.error("Failed to store to vector database")
-                    return False
-            else:
+            if not tasks:
                 logger.warning("No valid data to store")
                 return False
+            
+            stats = self.vectorizer.sync_vectors(tasks, documents, embeddings=embeddings)
+            stored = stats["embedded"] + stats["updated"] + stats["unchanged"]
+            self.stats.stored += stored
+            if stats["failed"]:
+                logger.error(f"Failed to store {stats['failed']} functions to vector database")
+            logger.info(f"Successfully stored {stored} functions to vector database")
+            return stored > 0
                 
         except Exception as e:
             error_msg = f"Error storing to vector database: {str(e)}"
@@ -522,8 +482,12 @@ class QNXBatchProcessor:
             self.stats.errors.append(error_msg)
             return False
     
+    def _results_path(self, output_file: str) -> Path:
+        """The JSONL store of output_file (a .json name maps to .jsonl beside it)"""
+        return (self.output_dir / output_file).with_suffix('.jsonl')
+    
     def save_results(self, json_data: Dict[str, Dict[str, Any]], embeddings: Dict[str, List[float]], output_file: str):
-        """Save processing results to file"""
+        """Append processing results to the JSONL result store"""
         try:
             # Combine final results
             final_result = {}
@@ -535,12 +499,13 @@ class QNXBatchProcessor:
                     "has_embedding": func_name in embeddings
                 }
             
-            # Save to file
-            output_path = self.output_dir / output_file
-            with open(output_path, 'w', encoding='utf-8') as f:
-                json.dump(final_result, f, indent=2, ensure_ascii=False)
+            # Append to the store: earlier records stay untouched on disk
+            output_path = self._results_path(output_file)
+            store = JSONLRecordStore(str(output_path))
+            store.append(final_result)
+            store.compact()
             
-            logger.info(f"Results saved to {output_path}")
+            logger.info(f"Results saved to {output_path} ({len(final_result)} new, {len(store)} total)")
             
             # Also save statistics
             stats_file = output_path.with_suffix('.stats.json')
@@ -559,25 +524,165 @@ class QNXBatchProcessor:
         except Exception as e:
             logger.error(f"Failed to save results: {e}")
     
-    def load_existing_data(self) -> Dict[str, Dict[str, Any]]:
-        """Load existing processed data for incremental processing"""
-        existing_file = self.output_dir / "qnx_functions_processed.json"
-        if existing_file.exists():
+    def load_existing_data(self, output_file: str = "qnx_functions_processed.jsonl") -> JSONLRecordStore:
+        """The result store of earlier runs for incremental processing (a legacy .json result is imported once)"""
+        output_path = self._results_path(output_file)
+        store = JSONLRecordStore(str(output_path))
+        legacy_file = output_path.with_suffix('.json')
+        if not len(store) and legacy_file.exists():
             try:
-                with open(existing_file, 'r', encoding='utf-8') as f:
-                    data = json.load(f)
-                logger.info(f"Loaded {len(data)} existing processed functions")
-                return data
+                with open(legacy_file, 'r', encoding='utf-8') as f:
+                    store.append(json.load(f))
+                logger.info(f"Imported {len(store)} functions from {legacy_file}")
             except Exception as e:
                 logger.warning(f"Failed to load existing data: {e}")
-        return {}
+        if len(store):
+            logger.info(f"Loaded {len(store)} existing processed functions")
+        return store
 
-    def process_functions(self, function_names: List[str], output_file: str = "qnx_functions_final.json") -> Dict[str, Any]:
+    async def run_pipeline(self, function_names: List[str]) -> Tuple[Dict[str, Dict[str, Any]], Dict[str, List[float]]]:
+        """Crawl, extract, embed and store as one streaming pipeline
+        
+        Each stage runs its own workers (the crawler's max_concurrency, then
+        extract_concurrency, embed_concurrency and a single store worker), and
+        the stages are connected by queues of queue_size entries, so a slow
+        stage holds back the ones before it instead of letting work pile up.
+        The blocking API clients run in worker threads; every LLM request goes
+        through the shared AdaptiveRateLimiter.
+        """
+        names_q = asyncio.Queue()
+        pages_q = asyncio.Queue(maxsize=self.queue_size)
+        extracted_q = asyncio.Queue(maxsize=self.queue_size)
+        embedded_q = asyncio.Queue(maxsize=self.queue_size)
+        json_data: Dict[str, Dict[str, Any]] = {}
+        embeddings: Dict[str, List[float]] = {}
+        for name in function_names:
+            names_q.put_nowait(name)
+        
+        async def crawl_worker(client):
+            while True:
+                try:
+                    name = names_q.get_nowait()
+                except asyncio.QueueEmpty:
+                    return
+                func = await self.crawler.fetch_function_page_async(client, name)
+                if func and self.crawler.validate_function_content(func):
+                    self.stats.crawled += 1
+                    await pages_q.put(func)
+                else:
+                    logger.warning(f"✗ Failed to crawl {name}")
+                    self.stats.errors.append(f"Crawl failed: {name}")
+        
+        async def extract_worker(extractor):
+            done = False
+            while not done:
+                batch = []
+                func = await pages_q.get()
+                # Whatever else is already waiting goes into the same LLM request;
+                # each worker takes exactly one None, which ends it
+                while func is not None:
+                    batch.append(func)
+                    if len(batch) >= extractor.batch_size or pages_q.empty():
+                        break
+                    func = pages_q.get_nowait()
+                done = func is None
+                if not batch:
+                    continue
+                try:
+                    results = await asyncio.to_thread(
+                        extractor.extract_functions_batch, [(func.name, func.html_content) for func in batch])
+                except Exception as e:
+                    logger.error(f"Error extracting JSON batch: {e}")
+                    self.stats.errors.append(f"Error extracting JSON batch: {str(e)}")
+                    continue
+                for func in batch:
+                    function_info = results.get(func.name)
+                    if not function_info:
+                        logger.warning(f"✗ Failed to extract JSON for {func.name}")
+                        self.stats.errors.append(f"JSON extraction failed: {func.name}")
+                        continue
+                    serializable_info = serialize_function_info(function_info)
+                    json_data[func.name] = serializable_info
+                    self.stats.json_extracted += 1
+                    # Enqueue for async GDB enhancement
+                    self.enqueue_gdb_task(func.name, serializable_info)
+                    await extracted_q.put(func.name)
+        
+        async def embed_worker():
+            done = False
+            while not done:
+                batch = []
+                name = await extracted_q.get()
+                while name is not None:
+                    batch.append(name)
+                    if len(batch) >= self.embedding_batch_size:
+                        break
+                    try:
+                        # Give the extractors a moment to fill the embedding batch
+                        name = await asyncio.wait_for(extracted_q.get(), timeout=1.0)
+                    except asyncio.TimeoutError:
+                        break
+                done = name is None
+                if not batch:
+                    continue
+                try:
+                    batch_embeddings = await asyncio.to_thread(self.vectorize_function_names, batch)
+                except Exception as e:
+                    logger.error(f"Error vectorizing batch: {e}")
+                    self.stats.errors.append(f"Error vectorizing batch: {str(e)}")
+                    continue
+                embeddings.update(batch_embeddings)
+                # Names with an up-to-date vector still go on so their documents are stored
+                await embedded_q.put(batch)
+        
+        async def store_worker():
+            while True:
+                batch = await embedded_q.get()
+                if batch is None:
+                    return
+                if batch:
+                    await asyncio.to_thread(self.store_vector_database,
+                                            {name: json_data[name] for name in batch},
+                                            {name: embeddings[name] for name in batch if name in embeddings})
+        
+        # One extractor per worker: the GDB enhancer inside is not thread-safe
+        extractors = await asyncio.gather(*(
+            asyncio.to_thread(ClaudeJSONExtractor, self.config_path, True)
+            for _ in range(max(0, self.extract_concurrency - 1))))
+        extractors = [self.json_extractor] + list(extractors)
+        for extractor in extractors:
+            extractor.rate_limiter = self.rate_limiter
+        
+        extract_tasks = [asyncio.create_task(extract_worker(e)) for e in extractors]
+        embed_tasks = [asyncio.create_task(embed_worker()) for _ in range(self.embed_concurrency)]
+        store_task = asyncio.create_task(store_worker())
+        try:
+            async with self.crawler.async_client() as client:
+                await asyncio.gather(*(crawl_worker(client) for _ in range(self.crawler.max_concurrency)))
+            for _ in extract_tasks:
+                await pages_q.put(None)
+            await asyncio.gather(*extract_tasks)
+            for _ in embed_tasks:
+                await extracted_q.put(None)
+            await asyncio.gather(*embed_tasks)
+            await embedded_q.put(None)
+            await store_task
+        finally:
+            for task in extract_tasks + embed_tasks + [store_task]:
+                task.cancel()
+            for extractor in extractors[1:]:
+                extractor.close()
+        
+        logger.info(f"Pipeline done: {self.stats.crawled} crawled, {len(json_data)} extracted, "
+                    f"{len(embeddings)} vectorized, {self.stats.stored} stored")
+        return json_data, embeddings
+    
+    def process_functions(self, function_names: List[str], output_file: str = "qnx_functions_processed.jsonl") -> Dict[str, Any]:
         """Complete processing pipeline with incremental support"""
         start_time = time.time()
         
-        # Load existing data for incremental processing
-        existing_data = self.load_existing_data()
+        # Only the index of earlier results is read here, not the records themselves
+        existing_data = self.load_existing_data(output_file)
         
         # Filter out already processed functions
         new_functions = [name for name in function_names if name not in existing_data]
@@ -594,7 +699,7 @@ class QNXBatchProcessor:
             logger.info("All functions already processed! Using existing data.")
             return {
                 "success": True,
-                "data": existing_data,
+                "data": existing_data.load_all(),
                 "stats": {
                     "total_functions": len(function_names),
                     "skipped": skipped_count,
@@ -609,37 +714,23 @@ class QNXBatchProcessor:
         self.start_gdb_processing()
         
         try:
-            # Step 1: Crawl function documentation (only for new functions)
-            logger.info("Step 1: Crawling function documentation")
-            functions = self.crawl_functions(new_functions)
+            # Steps 1-4: crawl, extract, vectorize and store, streamed through one pipeline
+            logger.info("Steps 1-4: Crawl -> JSON extract -> Vectorize -> Store pipeline")
+            json_data, embeddings = asyncio.run(self.run_pipeline(new_functions))
             
-            if not functions:
+            if not self.stats.crawled:
                 logger.error("No functions crawled successfully")
                 return {"error": "No functions crawled"}
-            
-            # Step 2: Extract JSON data
-            logger.info("Step 2: Extracting JSON data with OpenAI")
-            json_data = self.extract_json_data(functions)
-            
             if not json_data:
                 logger.error("No JSON data extracted")
                 return {"error": "No JSON data extracted"}
             
-            # Step 3: Vectorize function names (hybrid API)
-            logger.info("Step 3: Vectorizing function names with Hybrid API")
-            embeddings = self.vectorize_function_names(list(json_data.keys()))
-            
-            # Step 4: Store to vector database
-            logger.info("Step 4: Storing to vector database")
-            store_success = self.store_vector_database(json_data, embeddings)
-            
             # Step 5: Wait for GDB processing to complete and merge results
             logger.info("Step 5: Waiting for GDB processing and merging results")
+            self.wait_gdb_processing(self.gdb_drain_timeout)
             
-            # Allow some time for GDB processing
-            logger.info("Allowing time for GDB processing to complete...")
-            wait_time = min(30, len(json_data) * 2)  # Maximum 30 seconds or 2 seconds per function
-            time.sleep(wait_time)
+            # Stop GDB processing (flushes the task status to the database)
+            self.stop_gdb_processing()
             
             # Get GDB enhanced results
             gdb_results = self.get_gdb_results()
@@ -650,9 +741,6 @@ class QNXBatchProcessor:
                         json_data[func_name] = enhanced_data
                         logger.debug(f"Merged GDB enhancement for: {func_name}")
             
-            # Stop GDB processing
-            self.stop_gdb_processing()
-            
             # Step 6: Save results file
             logger.info("Step 6: Saving results")
             self.save_results(json_data, embeddings, output_file)
@@ -728,7 +816,7 @@ def main():
     parser.add_argument("--max-functions", type=int, help="Maximum number of functions to process")
     parser.add_argument("--all", action="store_true", help="Process all discovered QNX functions from A-Z")
     parser.add_argument("--letters", nargs="+", help="Process functions from specific letters (e.g., --letters a b c)")
-    parser.add_argument("--output", default="qnx_functions_processed.json", help="Output file")
+    parser.add_argument("--output", default="qnx_functions_processed.jsonl", help="Output JSONL result store")
     parser.add_argument("--test-query", help="Test query after processing")
     parser.add_argument("--continue-on-error", action="store_true", help="Continue processing even if some functions fail")
     
@@ -0,0 +1,279 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+QNX Documentation Page Parser
+Rule-based extraction of function information from QNX library reference pages
+"""
+
+import re
+import logging
+from typing import Dict, List, Optional, Tuple
+from bs4 import BeautifulSoup, NavigableString, Tag
+
+from qnx_function_info import QNXFunctionInfo, FunctionParameter, HeaderFile
+
+logger = logging.getLogger(__name__)
+
+# Section headings of a library reference page ("Synopsis:", "Returns:", ...)
+SECTION_RE = re.compile(
+    r'^(synopsis|arguments|library|description|returns|errors|examples?|classification|see also)\s*:?\s*$',
+    re.I)
+HEADING_TAGS = ('h1', 'h2', 'h3', 'h4')
+INCLUDE_RE = re.compile(r'#\s*include\s*[<"]([^>"]+)[>"]')
+IDENT_RE = re.compile(r'[A-Za-z_]\w*')
+# Words of a parameter declaration that are not its name
+TYPE_WORDS = {
+    'const', 'volatile', 'restrict', '__restrict', 'struct', 'union', 'enum', 'unsigned',
+    'signed', 'short', 'long', 'int', 'char', 'void', 'float', 'double', '_Bool', 'register',
+}
+
+class QNXDocParser:
+    """Fills QNXFunctionInfo straight from the regular structure of a
+    library reference page (Synopsis, Arguments, Library, Returns, Errors, ...)
+
+    parse() returns None when the page does not parse confidently (no
+    prototype for the function in the Synopsis, or a parameter it cannot
+    split into type and name), so that the caller can fall back to the LLM.
+    """
+
+    def parse(self, html_content: str, function_name: str) -> Optional[QNXFunctionInfo]:
+        try:
+            soup = BeautifulSoup(html_content, 'html.parser')
+        except Exception as e:
+            logger.debug(f"Rule-based parse of {function_name} failed: {e}")
+            return None
+        sections = self._sections(soup)
+
+        synopsis = self._synopsis_text(sections.get('synopsis', []))
+        if not synopsis:
+            logger.debug(f"Rule-based parse of {function_name}: no Synopsis section")
+            return None
+        prototype = self._prototype(synopsis, function_name)
+        if not prototype:
+            logger.debug(f"Rule-based parse of {function_name}: no prototype in Synopsis")
+            return None
+        return_type, params = prototype
+        parameters = self._parameters(params, self._definitions(sections.get('arguments', [])))
+        if parameters is None:
+            logger.debug(f"Rule-based parse of {function_name}: unparsed parameter list '{params}'")
+            return None
+
+        returns = self._text(sections.get('returns', []))
+        errors = self._errors(sections.get('errors', []))
+        if errors:
+            returns = (returns + "\n" if returns else "") + "Errors: " + "; ".join(errors)
+
+        return QNXFunctionInfo(
+            name=function_name,
+            synopsis=synopsis,
+            description=self._description(soup, sections),
+            parameters=parameters,
+            return_type=return_type,
+            return_description=returns,
+            headers=[HeaderFile(filename=h, path=f"/usr/include/{h}", is_system=True)
+                     for h in INCLUDE_RE.findall(synopsis)],
+            libraries=self._libraries(sections.get('library', [])),
+            examples=[pre.get_text().strip() for pre in self._find_all(sections.get('examples', []), 'pre')],
+            see_also=self._see_also(soup, sections.get('see also', []), function_name),
+            classification=self._classification(sections.get('classification', [])),
+            safety=self._safety(soup)
+        )
+
+    def _sections(self, soup: BeautifulSoup) -> Dict[str, list]:
+        """Section name -> the nodes after its heading, up to the next heading"""
+        sections = {}
+        for heading in soup.find_all(HEADING_TAGS):
+            m = SECTION_RE.match(heading.get_text(' ', strip=True))
+            if not m:
+                continue
+            name = m.group(1).lower()
+            if name == 'example':
+                name = 'examples'
+            nodes = []
+            for sibling in heading.next_siblings:
+                if isinstance(sibling, Tag) and (sibling.name in HEADING_TAGS or sibling.find(HEADING_TAGS)):
+                    break
+                nodes.append(sibling)
+            sections.setdefault(name, nodes)
+        return sections
+
+    @staticmethod
+    def _find_all(nodes: list, tag) -> list:
+        found = []
+        for node in nodes:
+            if isinstance(node, Tag):
+                if node.name == tag:
+                    found.append(node)
+                found.extend(node.find_all(tag))
+        return found
+
+    @staticmethod
+    def _text(nodes: list) -> str:
+        parts = []
+        for node in nodes:
+            text = node.get_text(' ', strip=True) if isinstance(node, Tag) else str(node).strip()
+            if text:
+                parts.append(text)
+        return re.sub(r'[ \t]+', ' ', '\n'.join(parts)).strip()
+
+    def _synopsis_text(self, nodes: list) -> str:
+        pres = self._find_all(nodes, 'pre')
+        if pres:
+            return '\n'.join(pre.get_text().strip() for pre in pres)
+        return self._text(nodes)
+
+    @staticmethod
+    def _prototype(synopsis: str, function_name: str) -> Optional[Tuple[str, str]]:
+        """(return type, parameter list) of the declaration of function_name"""
+        code = re.sub(r'/\*.*?\*/', ' ', synopsis, flags=re.S)
+        code = '\n'.join(line for line in code.split('\n') if not line.strip().startswith('#'))
+        m = re.search(rf'(?:^|[;}}\n])([^;{{}}()]*?)\b{re.escape(function_name)}\s*\(', code)
+        if not m:
+            return None
+        depth, start = 1, m.end()
+        for i in range(start, len(code)):
+            if code[i] == '(':
+                depth += 1
+            elif code[i] == ')':
+                depth -= 1
+                if depth == 0:
+                    break
+        else:
+            return None
+        return_type = ' '.join(m.group(1).replace('extern', ' ').split())
+        if not return_type:
+            return None
+        return return_type, ' '.join(code[start:i].split())
+
+    @staticmethod
+    def _split_params(params: str) -> List[str]:
+        out, depth, cur = [], 0, ''
+        for c in params:
+            if c in '([':
+                depth += 1
+            elif c in ')]':
+                depth -= 1
+            if c == ',' and depth == 0:
+                out.append(cur.strip())
+                cur = ''
+            else:
+                cur += c
+        if cur.strip():
+            out.append(cur.strip())
+        return out
+
+    def _parameters(self, params: str, descriptions: Dict[str, str]) -> Optional[List[FunctionParameter]]:
+        if params in ('', 'void'):
+            return []
+        parameters = []
+        for decl in self._split_params(params):
+            if decl == '...':
+                parameters.append(FunctionParameter(name='...', type='...',
+                                                    description=descriptions.get('...', ''),
+                                                    is_optional=True))
+                continue
+            # Function pointer: ret (*name)(args)
+            m = re.match(r'^(.*?)\(\s*\*\s*(\w+)\s*\)\s*(\(.*\))$', decl)
+            if m:
+                name = m.group(2)
+                ptype = f"{m.group(1).strip()} (*){m.group(3)}"
+                is_pointer, is_const = True, False
+            else:
+                m = re.match(r'^(.*?)([A-Za-z_]\w*)\s*((?:\[[^\]]*\])*)$', decl)
+                if not m or m.group(2) in TYPE_WORDS or not IDENT_RE.search(m.group(1)):
+                    return None
+                name = m.group(2)
+                ptype = ' '.join((m.group(1) + m.group(3)).split())
+                ptype = re.sub(r'\s*\*\s*', ' *', ptype).replace('* *', '**').strip()
+                is_pointer = '*' in ptype or '[' in ptype
+                is_const = bool(re.search(r'\bconst\b', ptype))
+            parameters.append(FunctionParameter(
+                name=name,
+                type=ptype,
+                description=descriptions.get(name, ''),
+                is_pointer=is_pointer,
+                is_const=is_const
+            ))
+        return parameters
+
+    @staticmethod
+    def _definitions(nodes: list) -> Dict[str, str]:
+        """<dt>term</dt><dd>text</dd> pairs of a section"""
+        defs = {}
+        for node in nodes:
+            if not isinstance(node, Tag):
+                continue
+            for dt in ([node] if node.name == 'dt' else node.find_all('dt')):
+                dd = dt.find_next_sibling('dd')
+                if dd:
+                    term = dt.get_text(' ', strip=True)
+                    defs.setdefault(term, ' '.join(dd.get_text(' ', strip=True).split()))
+        return defs
+
+    def _errors(self, nodes: list) -> List[str]:
+        defs = self._definitions(nodes)
+        if defs:
+            return [f"{k}: {v}" if v else k for k, v in defs.items()]
+        text = self._text(nodes)
+        return [text] if text else []
+
+    def _description(self, soup: BeautifulSoup, sections: Dict[str, list]) -> str:
+        shortdesc = soup.find(class_='shortdesc')
+        if shortdesc:
+            text = ' '.join(shortdesc.get_text(' ', strip=True).split())
+            if text:
+                return text
+        for p in self._find_all(sections.get('description', []), 'p'):
+            text = ' '.join(p.get_text(' ', strip=True).split())
+            if text:
+                return text
+        return self._text(sections.get('description', []))[:500]
+
+    def _libraries(self, nodes: list) -> List[str]:
+        libs = []
+        for tag in ('samp', 'code', 'kbd'):
+            for node in self._find_all(nodes, tag):
+                text = node.get_text(strip=True)
+                if re.match(r'^lib\w+$', text) and text not in libs:
+                    libs.append(text)
+        if not libs:
+            libs = [lib for lib in dict.fromkeys(re.findall(r'\blib\w+\b', self._text(nodes)))]
+        return libs
+
+    def _classification(self, nodes: list) -> str:
+        # The safety table may follow in the same section
+        parts = []
+        for node in nodes:
+            if isinstance(node, Tag) and (node.name == 'table' or node.find('table')):
+                break
+            text = node.get_text(' ', strip=True) if isinstance(node, Tag) else str(node).strip()
+            if text:
+                parts.append(text)
+        return ' '.join(' '.join(parts).split())
+
+    @staticmethod
+    def _safety(soup: BeautifulSoup) -> str:
+        """'Cancellation point: No, Interrupt handler: No, ...' from the safety table"""
+        for table in soup.find_all('table'):
+            rows = []
+            for tr in table.find_all('tr'):
+                cells = [' '.join(c.get_text(' ', strip=True).split()) for c in tr.find_all(['td', 'th'])]
+                if len(cells) == 2 and cells[0] and cells[1] and not cells[0].lower().startswith('safety'):
+                    rows.append(f"{cells[0]}: {cells[1]}")
+            if rows and any(r.lower().startswith(('cancellation point', 'thread')) for r in rows):
+                return ', '.join(rows)
+        return ""
+
+    def _see_also(self, soup: BeautifulSoup, nodes: list, function_name: str) -> List[str]:
+        links = self._find_all(nodes, 'a')
+        related = soup.find(class_='related-links')
+        if related:
+            links += related.find_all('a')
+        names = []
+        for a in links:
+            text = a.get_text(strip=True)
+            if text.endswith('()'):
+                text = text[:-2]
+                if text != function_name and IDENT_RE.fullmatch(text) and text not in names:
+                    names.append(text)
+        return names
@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+QNX Function Index
+In-memory lexical index of the processed function files: exact names in a
+hash map, name prefixes in a trie and BM25 over the extracted fields, so
+name lookups and keyword queries need neither a file scan nor an embedding
+"""
+
+import logging
+import math
+import re
+import threading
+import time
+from collections import Counter
+from pathlib import Path
+from typing import Any, Dict, List, Optional, Tuple
+
+from qnx_record_store import load_records
+
+logger = logging.getLogger(__name__)
+
+TOKEN_RE = re.compile(r'[A-Za-z0-9]+')
+NAME_RE = re.compile(r'^[A-Za-z_]\w*$')
+# Weight of each extracted field in the BM25 document
+FIELD_WEIGHTS = {"name": 3, "synopsis": 2, "description": 1, "parameters": 1, "return_description": 1,
+                 "headers": 1, "see_also": 1, "classification": 1}
+
+def tokenize(text: str) -> List[str]:
+    """Lower-case terms; identifiers also yield their '_' parts (pthread_mutex_lock -> pthread, mutex, lock)"""
+    terms = []
+    for token in re.findall(r'\w+', (text or '').lower()):
+        parts = TOKEN_RE.findall(token)
+        if len(parts) > 1:
+            terms.append(token.strip('_'))
+        terms.extend(parts)
+    return terms
+
+def _field_text(function_data: Dict[str, Any], field: str) -> str:
+    value = function_data.get(field)
+    if field == "parameters":
+        return ' '.join(f"{p.get('name', '')} {p.get('type', '')} {p.get('description', '')}"
+                        for p in value or [] if isinstance(p, dict))
+    if field == "headers":
+        return ' '.join((h.get('filename', '') if isinstance(h, dict) else str(h)) for h in value or [])
+    if isinstance(value, list):
+        return ' '.join(str(v) for v in value)
+    return str(value or '')
+
+class QNXFunctionIndex:
+    """Name map, prefix trie and BM25 postings of data_dir/*.json (minus *.stats.json) and *.jsonl stores
+
+    The files are read once and again only when one of them is added, removed
+    or modified (checked every recheck_interval seconds); every lookup in
+    between is an in-memory operation.
+    """
+
+    def __init__(self, data_dir: str = "./data/processed_functions", k1: float = 1.2, b: float = 0.75,
+                 recheck_interval: float = 2.0):
+        self.data_dir = Path(data_dir)
+        self.recheck_interval = recheck_interval
+        self.k1 = k1
+        self.b = b
+        self.functions: Dict[str, Dict[str, Any]] = {}  # name -> {"source_file", "function_data", "has_embedding"}
+        self.lower_names: Dict[str, str] = {}           # lower-case name -> name
+        self.sorted_names: List[str] = []
+        self.trie: Dict[str, Any] = {}
+        self.postings: Dict[str, List[Tuple[str, int]]] = {}  # term -> [(name, weighted tf)]
+        self.lengths: Dict[str, int] = {}
+        self.average_length = 0.0
+        self._signature = None
+        self._checked = 0.0
+        self._lock = threading.Lock()
+
+    def _files(self) -> List[Path]:
+        # A JSONL result store replaces the legacy .json file it was imported from
+        stores = set(self.data_dir.glob("*.jsonl"))
+        return sorted(stores | {p for p in self.data_dir.glob("*.json")
+                                if not p.name.endswith('.stats.json') and p.with_suffix('.jsonl') not in stores})
+
+    def _ensure_loaded(self):
+        # Stat the directory at most every recheck_interval seconds
+        now = time.monotonic()
+        if self._signature is not None and now - self._checked < self.recheck_interval:
+            return
+        self._checked = now
+        files = self._files()
+        signature = tuple((str(p), p.stat().st_mtime_ns, p.stat().st_size) for p in files)
+        if signature == self._signature:
+            return
+        with self._lock:
+            if signature != self._signature:
+                self._load(files)
+                self._signature = signature
+
+    def _load(self, files: List[Path]):
+        functions = {}
+        for json_file in files:
+            try:
+                data = load_records(str(json_file))
+            except Exception as e:
+                logger.warning(f"Failed to read file {json_file}: {e}")
+                continue
+            if not isinstance(data, dict):
+                continue
+            for name, entry in data.items():
+                if name in functions or not isinstance(entry, dict):
+                    continue
+                functions[name] = {"source_file": json_file.name,
+                                   "function_data": entry.get("function_data", {}) or {},
+                                   "has_embedding": entry.get("has_embedding", False)}
+
+        trie, postings, lengths = {}, {}, {}
+        for name, entry in functions.items():
+            node = trie
+            for ch in name.lower():
+                node = node.setdefault(ch, {})
+            node.setdefault('$', []).append(name)
+
+            counts = Counter()
+            for term in tokenize(name):
+                counts[term] += FIELD_WEIGHTS["name"]
+            for field, weight in FIELD_WEIGHTS.items():
+                if field != "name":
+                    for term in tokenize(_field_text(entry["function_data"], field)):
+                        counts[term] += weight
+            for term, tf in counts.items():
+                postings.setdefault(term, []).append((name, tf))
+            lengths[name] = sum(counts.values())
+
+        self.functions = functions
+        self.sorted_names = sorted(functions)
+        self.lower_names = {}
+        for name in functions:
+            self.lower_names.setdefault(name.lower(), name)
+        self.trie, self.postings, self.lengths = trie, postings, lengths
+        self.average_length = (sum(lengths.values()) / len(lengths)) if lengths else 0.0
+        logger.info(f"Indexed {len(functions)} QNX functions from {len(files)} files")
+
+    def get(self, name: str) -> Optional[Dict[str, Any]]:
+        """Entry of a function by exact (or, failing that, case-insensitive) name"""
+        self._ensure_loaded()
+        entry = self.functions.get(name)
+        if entry is None:
+            name = self.lower_names.get(name.lower())
+            entry = self.functions.get(name) if name else None
+        return entry
+
+    def canonical_name(self, name: str) -> Optional[str]:
+        self._ensure_loaded()
+        return name if name in self.functions else self.lower_names.get(name.lower())
+
+    def names(self) -> List[str]:
+        """All names, sorted once per load; the list is shared, do not modify it"""
+        self._ensure_loaded()
+        return self.sorted_names
+
+    def prefix(self, prefix: str, limit: int = 10) -> List[str]:
+        """Names starting with prefix (case-insensitive), shortest first"""
+        self._ensure_loaded()
+        node = self.trie
+        for ch in prefix.lower():
+            node = node.get(ch)
+            if node is None:
+                return []
+        found, stack = [], [node]
+        while stack:
+            current = stack.pop()
+            found.extend(current.get('$', []))
+            stack.extend(child for key, child in current.items() if key != '$')
+        return sorted(found, key=lambda n: (len(n), n))[:limit]
+
+    def bm25(self, query: str, limit: int = 10) -> List[Tuple[str, float]]:
+        """(name, score) of the best BM25 matches, best first"""
+        self._ensure_loaded()
+        total = len(self.functions)
+        if not total:
+            return []
+        scores = Counter()
+        for term in set(tokenize(query)):
+            postings = self.postings.get(term)
+            if not postings:
+                continue
+            idf = math.log(1 + (total - len(postings) + 0.5) / (len(postings) + 0.5))
+            for name, tf in postings:
+                norm = self.k1 * (1 - self.b + self.b * self.lengths[name] / (self.average_length or 1))
+                scores[name] += idf * tf * (self.k1 + 1) / (tf + norm)
+        return [(name, round(score, 4)) for name, score in scores.most_common(limit)]
+
+    @staticmethod
+    def is_name_query(query: str) -> bool:
+        """A single identifier (optionally with a trailing '()' or '*')"""
+        return bool(NAME_RE.match(query.strip().rstrip('*').removesuffix('()')))
@@ -0,0 +1,42 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+QNX Function Information
+Structured function records produced by the JSON extractors
+"""
+
+from typing import List
+from dataclasses import dataclass, field
+
+@dataclass
+class FunctionParameter:
+    """Function parameter"""
+    name: str = ""
+    type: str = ""
+    description: str = ""
+    is_pointer: bool = False
+    is_const: bool = False
+    is_optional: bool = False
+
+@dataclass
+class HeaderFile:
+    """Header file declaring a function"""
+    filename: str = ""
+    path: str = ""
+    is_system: bool = True
+
+@dataclass
+class QNXFunctionInfo:
+    """Function information extracted from a QNX documentation page"""
+    name: str = ""
+    synopsis: str = ""
+    description: str = ""
+    parameters: List[FunctionParameter] = field(default_factory=list)
+    return_type: str = ""
+    return_description: str = ""
+    headers: List[HeaderFile] = field(default_factory=list)
+    libraries: List[str] = field(default_factory=list)
+    examples: List[str] = field(default_factory=list)
+    see_also: List[str] = field(default_factory=list)
+    classification: str = ""
+    safety: str = ""
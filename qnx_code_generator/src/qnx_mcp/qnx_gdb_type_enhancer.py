@@ -8,6 +8,8 @@ Obtain accurate type information through QNX's ntox86_64-gdb to enhance JSON ext
 import os
 import sys
 import json
+import codecs
+import queue
 import subprocess
 import tempfile
 import logging
@@ -20,10 +22,20 @@ from typing import Dict, List, Optional, Any, Tuple
 from dataclasses import dataclass, asdict
 from pathlib import Path
 
+# Add current directory to Python path
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+from qnx_type_index import QNXTypeIndex
+from qnx_header_index import QNXHeaderIndex
+from qnx_record_store import JSONLRecordStore, load_records
+
 # Setup logging
 logging.basicConfig(level=logging.INFO)
 logger = logging.getLogger(__name__)
 
+# SDP debugger per qnx_system.preferred_architecture, when gdb_executable is not set
+GDB_EXECUTABLES = {"x86_64": "ntox86_64-gdb", "aarch64le": "ntoaarch64-gdb", "armle-v7": "ntoarmv7-gdb"}
+
 @dataclass
 class TypeInfo:
     """Type information"""
@@ -63,25 +75,40 @@ class QNXGDBTypeEnhancer:
         qnx_config = self.config.get("qnx_system", {})
         self.qnx_root = qnx_config.get("root_path", "/home/a2ure/Desktop/qnx700")
         self.env_script = qnx_config.get("env_setup_script", f"{self.qnx_root}/qnxsdp-env.sh")
-        self.gdb_executable = qnx_config.get("gdb_executable", "ntox86_64-gdb")
+        self.preferred_arch = qnx_config.get("preferred_architecture", "x86_64")
+        self.gdb_executable = qnx_config.get("gdb_executable", GDB_EXECUTABLES.get(self.preferred_arch, "ntox86_64-gdb"))
         self.gdb_fallback = qnx_config.get("gdb_fallback", "gdb")
         self.header_paths = qnx_config.get("header_search_paths", [])
         self.symbol_paths = qnx_config.get("symbol_library_paths", [])
-        self.preferred_arch = qnx_config.get("preferred_architecture", "x86_64")
+        
+        # Offline type index built from the library DWARF (qnx_type_index.py); GDB is the fallback
+        self.type_index_path = qnx_config.get("type_index_path", "./data/qnx_type_index.db")
+        self.type_index = QNXTypeIndex.open(self.type_index_path)
+        
+        # Identifier and file name index of the headers, refreshed by mtime on first use
+        self.header_index_path = qnx_config.get("header_index_path", "./data/qnx_header_index.db")
+        self.header_index = None
         
         # Debug settings
         debug_config = self.config.get("debug_settings", {})
         self.enable_gdb_analysis = debug_config.get("enable_gdb_analysis", True)
         self.max_function_declarations = debug_config.get("max_function_declarations", 20)
         self.header_preview_size = debug_config.get("header_content_preview_size", 2000)
+        self.gdb_command_timeout = debug_config.get("gdb_command_timeout", 10)
         
-        # GDB session
+        # GDB session: one long-lived GDB/MI process per enhancer, with libc.so.4 loaded once
         self.gdb_process = None
         self.gdb_initialized = False
+        self.gdb_output = None
+        self.gdb_token = 0
+        self.gdb_lock = Lock()
+        self.qnx_env = None
         
         logger.info(f"QNX GDB enhancer initialized")
         logger.info(f"QNX root path: {self.qnx_root}")
         logger.info(f"GDB executable: {self.gdb_executable}")
+        if self.type_index:
+            logger.info(f"Type index: {self.type_index_path}")
     
     def _load_config(self, config_path: str) -> Dict[str, Any]:
         """Load configuration file"""
@@ -93,7 +120,9 @@ class QNXGDBTypeEnhancer:
             return {}
     
     def _setup_qnx_environment(self) -> Dict[str, str]:
-        """Set QNX environment variables"""
+        """Set QNX environment variables (sourced once per enhancer)"""
+        if self.qnx_env is not None:
+            return self.qnx_env
         env = os.environ.copy()
         
         if os.path.exists(self.env_script):
@@ -115,125 +144,177 @@ class QNXGDBTypeEnhancer:
         else:
             logger.warning(f"QNX environment script does not exist: {self.env_script}")
         
+        self.qnx_env = env
         return env
     
     def _start_gdb_session(self) -> bool:
-        """Start GDB session"""
+        """Start a GDB/MI session with QNX libc loaded for type information"""
         if not self.enable_gdb_analysis:
             logger.info("GDB analysis is disabled")
             return False
         
-        try:
-            env = self._setup_qnx_environment()
-            
-            # Try to start QNX GDB with CLI interface for better output parsing
+        env = self._setup_qnx_environment()
+        # QNX libc library path for type information
+        qnx_libc_path = f"{self.qnx_root}/target/qnx7/{self.preferred_arch}/lib/libc.so.4"
+        
+        for executable in (self.gdb_executable, self.gdb_fallback):
             try:
                 self.gdb_process = subprocess.Popen(
-                    [self.gdb_executable, "--quiet", "--batch-silent"],
+                    [executable, "--quiet", "--nx", "--interpreter=mi2"],
                     stdin=subprocess.PIPE,
                     stdout=subprocess.PIPE,
-                    stderr=subprocess.PIPE,
+                    stderr=subprocess.DEVNULL,
                     text=True,
+                    bufsize=1,
                     env=env
                 )
-                logger.info(f"Successfully started {self.gdb_executable}")
             except FileNotFoundError:
-                logger.warning(f"{self.gdb_executable} not found, trying {self.gdb_fallback}")
-                self.gdb_process = subprocess.Popen(
-                    [self.gdb_fallback, "--quiet", "--batch-silent"],
-                    stdin=subprocess.PIPE,
-                    stdout=subprocess.PIPE,
-                    stderr=subprocess.PIPE,
-                    text=True,
-                    env=env
-                )
-                logger.info(f"Successfully started {self.gdb_fallback}")
-            
-            # Initialize GDB settings
-            self._send_gdb_command("set confirm off")
-            self._send_gdb_command("set pagination off")
-            
-            # Set symbol file paths
-            for path in self.symbol_paths:
-                if os.path.exists(path):
-                    self._send_gdb_command(f"set solib-search-path {path}")
+                logger.warning(f"GDB executable not found: {executable}")
+                continue
             
-            self.gdb_initialized = True
-            logger.info("GDB session initialized")
-            return True
+            # Reader thread, so that every read can time out
+            self.gdb_output = queue.Queue()
+            threading.Thread(target=self._read_gdb_output,
+                             args=(self.gdb_process.stdout, self.gdb_output), daemon=True).start()
             
-        except Exception as e:
-            logger.error(f"Failed to start GDB session: {e}")
-            return False
+            # Initialize GDB settings
+            setup = ["set confirm off", "set pagination off", "set width 0"]
+            setup += [f"set solib-search-path {path}" for path in self.symbol_paths if os.path.exists(path)]
+            setup.append(f"file {qnx_libc_path}")
+            results = self._run_mi_commands(setup)
+            if results is None:
+                continue
+            if results[-1][0] == "done" or executable == self.gdb_fallback:
+                if results[-1][0] != "done":
+                    # Keep the session for the types GDB knows without symbols
+                    logger.warning(f"{executable} could not load {qnx_libc_path}")
+                self.gdb_initialized = True
+                logger.info(f"GDB/MI session started with {executable}")
+                return True
+            
+            # Fall back to the system GDB if the QNX one cannot load libc
+            logger.warning(f"{executable} could not load {qnx_libc_path}, trying {self.gdb_fallback}")
+            self._stop_gdb_process()
+        
+        logger.error("Failed to start GDB session")
+        return False
+    
+    @staticmethod
+    def _read_gdb_output(stream, lines: "queue.Queue"):
+        for line in stream:
+            lines.put(line.rstrip('\n'))
+        lines.put(None)
+    
+    def _run_mi_commands(self, commands: List[str]) -> Optional[List[Tuple[str, str]]]:
+        """Send console commands as one pipelined batch of MI requests
+        
+        Returns (result class, console output) per command in order, or None
+        when the session died or timed out (it is then stopped).
+        """
+        tokens = []
+        request = ""
+        for command in commands:
+            self.gdb_token += 1
+            tokens.append(str(self.gdb_token))
+            escaped = command.replace('\\', '\\\\').replace('"', '\\"')
+            request += f'{self.gdb_token}-interpreter-exec console "{escaped}"\n'
+        try:
+            self.gdb_process.stdin.write(request)
+            self.gdb_process.stdin.flush()
+        except (OSError, ValueError) as e:
+            logger.warning(f"GDB session lost: {e}")
+            self._stop_gdb_process()
+            return None
+        
+        # GDB answers in order: console records (~"...") precede the
+        # <token>^done / <token>^error result record of their command
+        results = {}
+        console = []
+        deadline = time.monotonic() + self.gdb_command_timeout * len(commands)
+        while len(results) < len(tokens):
+            try:
+                line = self.gdb_output.get(timeout=max(0.0, deadline - time.monotonic()))
+            except queue.Empty:
+                logger.warning(f"GDB command '{commands[len(results)]}' timed out")
+                self._stop_gdb_process()
+                return None
+            if line is None:
+                logger.warning("GDB session exited")
+                self._stop_gdb_process()
+                return None
+            if line.startswith('~"'):
+                console.append(self._mi_string(line[1:]))
+                continue
+            m = re.match(r'^(\d+)\^(done|error|running|connected|exit)', line)
+            if m and m.group(1) in tokens:
+                results[m.group(1)] = (m.group(2), ''.join(console))
+                console = []
+        return [results[token] for token in tokens]
+    
+    @staticmethod
+    def _mi_string(quoted: str) -> str:
+        """Decode an MI c-string ("...")"""
+        body = quoted.strip()[1:-1]
+        return codecs.escape_decode(body.encode('utf-8'))[0].decode('utf-8', 'replace')
+    
+    def _send_gdb_commands(self, commands: List[str]) -> List[str]:
+        """Run several GDB commands in one round trip; "" for each that failed"""
+        with self.gdb_lock:
+            if not self.gdb_initialized and not self._start_gdb_session():
+                return [""] * len(commands)
+            results = self._run_mi_commands(commands)
+        if results is None:
+            return [""] * len(commands)
+        responses = []
+        for command, (result_class, output) in zip(commands, results):
+            response = output.strip() if result_class == "done" else ""
+            logger.debug(f"GDB command '{command}' response: {response[:200]}...")
+            responses.append(response)
+        return responses
     
     def _send_gdb_command(self, command: str) -> str:
-        """Send GDB command and get result using subprocess communication"""
+        """Send GDB command to the session and get its console output"""
         try:
-            # Create a new GDB process for each command to avoid session issues
-            env = self._setup_qnx_environment()
-            
-            # QNX libc library path for type information
-            qnx_libc_path = f"{self.qnx_root}/target/qnx7/x86_64/lib/libc.so.4"
-            
-            # Use GDB in batch mode with QNX library loaded first, then the command
-            gdb_cmd = [
-                self.gdb_executable, "--quiet", "--batch", 
-                "--ex", f"file {qnx_libc_path}",  # Load QNX libc for type information
-                "--ex", command
-            ]
-            
-            try:
-                result = subprocess.run(
-                    gdb_cmd,
-                    capture_output=True,
-                    text=True,
-                    timeout=10,
-                    env=env
-                )
-                
-                if result.returncode == 0 and result.stdout:
-                    response = result.stdout.strip()
-                    logger.debug(f"GDB command '{command}' response: {response[:200]}...")
-                    return response
-                else:
-                    # Fallback to system GDB if QNX GDB fails (also load QNX libc)
-                    gdb_cmd_fallback = [
-                        self.gdb_fallback, "--quiet", "--batch",
-                        "--ex", f"file {qnx_libc_path}",  # Also load QNX libc in fallback
-                        "--ex", command
-                    ]
-                    result_fallback = subprocess.run(
-                        gdb_cmd_fallback,
-                        capture_output=True,
-                        text=True,
-                        timeout=10,
-                        env=env
-                    )
-                    
-                    if result_fallback.returncode == 0 and result_fallback.stdout:
-                        response = result_fallback.stdout.strip()
-                        logger.debug(f"GDB fallback command '{command}' response: {response[:200]}...")
-                        return response
-                    
-            except FileNotFoundError:
-                logger.warning(f"GDB executable not found: {self.gdb_executable}")
-                return ""
-            except subprocess.TimeoutExpired:
-                logger.warning(f"GDB command '{command}' timed out")
-                return ""
-                
-            return ""
-            
+            return self._send_gdb_commands([command])[0]
         except Exception as e:
             logger.error(f"Failed to send GDB command '{command}': {e}")
             return ""
     
+    def _indexed_type_info(self, type_name: str) -> Optional[TypeInfo]:
+        """Type information from the offline type index, with exact sizes and offsets"""
+        if not self.type_index:
+            return None
+        names = [type_name]
+        if not re.match(r'^(struct|union|enum)\s', type_name):
+            names += [f"struct {type_name}", f"union {type_name}", f"enum {type_name}"]
+        for name in names:
+            entry = self.type_index.get(name)
+            if not entry:
+                continue
+            type_info = TypeInfo(name=type_name)
+            type_info.definition = entry["definition"]
+            type_info.size = entry["size"] or 0
+            body = entry["definition"].split('\n', 1)[0]
+            type_info.is_struct = body.startswith("type = struct")
+            type_info.is_union = body.startswith("type = union")
+            type_info.is_enum = body.startswith("type = enum")
+            type_info.is_pointer = '*' in body
+            type_info.is_array = '[' in body
+            type_info.fields = entry["fields"]
+            return type_info
+        return None
+    
     def get_type_info(self, type_name: str) -> Optional[TypeInfo]:
         """Get type information - simplified to just store raw ptype output"""
         try:
-            # Just use ptype command and store the raw result
-            command = f"ptype {type_name}"
-            result = self._send_gdb_command(command)
+            type_info = self._indexed_type_info(type_name)
+            if type_info:
+                logger.debug(f"Got indexed layout for {type_name}")
+                return type_info
+            
+            # Just use ptype command and store the raw result; whatis is
+            # pipelined with it as the simpler fallback
+            result, whatis_result = self._send_gdb_commands([f"ptype {type_name}", f"whatis {type_name}"])
             
             if result and result.strip():
                 # Create simple TypeInfo with raw output
@@ -258,7 +339,7 @@ class QNXGDBTypeEnhancer:
                 return type_info
             
             # If ptype fails, try whatis as simpler fallback
-            result = self._send_gdb_command(f"whatis {type_name}")
+            result = whatis_result
             if result and result.strip():
                 type_info = TypeInfo(name=type_name)
                 type_info.definition = result.strip()
@@ -373,24 +454,26 @@ class QNXGDBTypeEnhancer:
     
     def _search_type_in_headers(self, type_name: str) -> Optional[TypeInfo]:
         """Search for type definition in header files"""
-        for header_path in self.header_paths:
-            if not os.path.exists(header_path):
-                continue
-            
-            try:
-                # Search for type definition
-                for root, dirs, files in os.walk(header_path):
-                    for file in files:
-                        if file.endswith(('.h', '.hpp')):
-                            file_path = os.path.join(root, file)
-                            type_info = self._search_type_in_file(file_path, type_name)
-                            if type_info:
-                                return type_info
-            except Exception as e:
-                logger.warning(f"Failed to search header files {header_path}: {e}")
+        type_info = self._indexed_type_info(type_name)
+        if type_info:
+            return type_info
+        
+        # Only the headers the index lists as defining the name are read
+        index = self._get_header_index()
+        clean_name = type_name.replace('struct ', '').replace('union ', '').replace('enum ', '').strip()
+        for file_path in dict.fromkeys(path for path, line, kind in index.find(clean_name) if kind != 'define'):
+            type_info = self._search_type_in_file(file_path, type_name)
+            if type_info:
+                return type_info
         
         return None
     
+    def _get_header_index(self) -> QNXHeaderIndex:
+        if self.header_index is None:
+            self.header_index = QNXHeaderIndex(self.header_index_path)
+            self.header_index.refresh_once(self.header_paths)
+        return self.header_index
+    
     def _search_type_in_file(self, file_path: str, type_name: str) -> Optional[TypeInfo]:
         """Search for type definition in a single file"""
         try:
@@ -560,14 +643,14 @@ class QNXGDBTypeEnhancer:
             direct_path = os.path.join(header_path, header_filename)
             if os.path.exists(direct_path):
                 return os.path.abspath(direct_path)
-            
-            # Try recursive search in subdirectories
-            try:
-                for root, dirs, files in os.walk(header_path):
-                    if header_filename in files:
-                        return os.path.abspath(os.path.join(root, header_filename))
-            except Exception as e:
-                logger.warning(f"Failed to search in {header_path}: {e}")
+        
+        # Then anywhere below the search paths, in their order
+        candidates = self._get_header_index().header_paths_for(header_filename)
+        for header_path in self.header_paths:
+            root = os.path.abspath(header_path) + os.sep
+            for path in candidates:
+                if path.startswith(root):
+                    return path
         
         return None
 
@@ -658,24 +741,40 @@ class QNXGDBTypeEnhancer:
         type_name = ' '.join(type_name.split())
         return type_name.strip()
     
-    def close(self):
-        """Close GDB session"""
+    def _stop_gdb_process(self):
         if self.gdb_process:
             try:
-                self.gdb_process.terminate()
+                self.gdb_process.stdin.write("-gdb-exit\n")
+                self.gdb_process.stdin.flush()
                 self.gdb_process.wait(timeout=5)
             except:
                 self.gdb_process.kill()
             finally:
                 self.gdb_process = None
                 self.gdb_initialized = False
-                logger.info("GDB session closed")
+    
+    def close(self):
+        """Close GDB session"""
+        if self.gdb_process:
+            self._stop_gdb_process()
+            logger.info("GDB session closed")
     
     def __del__(self):
         """Destructor"""
         self.close()
 
 
+def serialize_function_info(obj):
+    """JSON fallback for dataclass, namedtuple and plain objects in enhanced function data"""
+    if hasattr(obj, '__dataclass_fields__'):
+        return asdict(obj)
+    if hasattr(obj, '_asdict'):
+        return obj._asdict()
+    if hasattr(obj, '__dict__'):
+        return dict(obj.__dict__)
+    raise TypeError(f"Object of type {type(obj).__name__} is not JSON serializable")
+
+
 class MultiThreadGDBEnhancer:
     """Multi-threaded GDB enhancement processor"""
     
@@ -684,6 +783,8 @@ class MultiThreadGDBEnhancer:
         self.config_path = config_path
         self.max_workers = max_workers
         self.lock = Lock()
+        self.local = threading.local()
+        self.worker_enhancers = []
         self.processed_count = 0
         self.failed_count = 0
         self.start_time = None
@@ -706,10 +807,20 @@ class MultiThreadGDBEnhancer:
         """Create a GDB enhancer instance for worker thread"""
         return QNXGDBTypeEnhancer(self.config_path)
     
+    def _worker_enhancer(self) -> QNXGDBTypeEnhancer:
+        """The calling worker thread's enhancer, so each worker keeps one GDB session"""
+        enhancer = getattr(self.local, 'enhancer', None)
+        if enhancer is None:
+            enhancer = self.local.enhancer = self._create_worker_enhancer()
+            with self.lock:
+                self.worker_enhancers.append(enhancer)
+        return enhancer
+    
     def _enhance_single_function(self, func_data: Dict[str, Any], func_name: str, 
-                                enhancer: QNXGDBTypeEnhancer) -> Dict[str, Any]:
+                                enhancer: Optional[QNXGDBTypeEnhancer] = None) -> Dict[str, Any]:
         """Enhance a single function with GDB type information"""
         try:
+            enhancer = enhancer or self._worker_enhancer()
             enhanced_func = func_data.copy()
             
             # Enhance parameters if they exist
@@ -747,8 +858,7 @@ class MultiThreadGDBEnhancer:
         
         # Load input data
         try:
-            with open(input_file, 'r', encoding='utf-8') as f:
-                functions_data = json.load(f)
+            functions_data = load_records(input_file)
         except Exception as e:
             logger.error(f"Failed to load input file {input_file}: {e}")
             return {}
@@ -767,6 +877,13 @@ class MultiThreadGDBEnhancer:
         logger.info(f"Processing {self.total_functions} functions with {self.max_workers} threads")
         
         enhanced_functions = {}
+        pending = {}
+        
+        # Checkpoints append to a JSONL store; a .json output is exported from it once at the end
+        checkpoint_file = str(Path(output_file).with_suffix('.jsonl'))
+        store = JSONLRecordStore(checkpoint_file, default=serialize_function_info)
+        if checkpoint_file != output_file:
+            store.remove()
         
         # Process functions in parallel
         with ThreadPoolExecutor(max_workers=self.max_workers) as executor:
@@ -774,9 +891,7 @@ class MultiThreadGDBEnhancer:
             future_to_func = {}
             
             for func_name, func_data in functions_data.items():
-                # Create a new enhancer for each task to avoid thread conflicts
-                enhancer = self._create_worker_enhancer()
-                future = executor.submit(self._enhance_single_function, func_data, func_name, enhancer)
+                future = executor.submit(self._enhance_single_function, func_data, func_name)
                 future_to_func[future] = func_name
             
             # Collect results
@@ -785,18 +900,31 @@ class MultiThreadGDBEnhancer:
                 try:
                     result = future.result()
                     enhanced_functions.update(result)
+                    pending.update(result)
                     
                     # Periodically save progress
-                    if len(enhanced_functions) % 50 == 0:
-                        self._save_progress(enhanced_functions, output_file)
+                    if len(pending) >= 50:
+                        self._save_progress(store, pending)
                         
                 except Exception as e:
                     logger.error(f"Exception processing function {func_name}: {e}")
                     # Add original function data if processing failed
                     enhanced_functions[func_name] = functions_data[func_name]
+                    pending[func_name] = functions_data[func_name]
+        
+        for enhancer in self.worker_enhancers:
+            enhancer.close()
+        self.worker_enhancers = []
         
         # Final save
-        self._save_progress(enhanced_functions, output_file)
+        self._save_progress(store, pending)
+        store.compact()
+        if checkpoint_file != output_file:
+            try:
+                store.export_json(output_file)
+                store.remove()
+            except Exception as e:
+                logger.error(f"Failed to write {output_file}, results remain in {checkpoint_file}: {e}")
         
         # Summary
         elapsed_time = time.time() - self.start_time
@@ -815,40 +943,12 @@ class MultiThreadGDBEnhancer:
         
         return enhanced_functions
     
-    def _save_progress(self, enhanced_functions: Dict[str, Any], output_file: str):
-        """Save current progress to file"""
+    def _save_progress(self, store: JSONLRecordStore, pending: Dict[str, Any]):
+        """Append the records enhanced since the last checkpoint"""
         try:
-            # Define serialize function locally to avoid circular imports
-            def serialize_function_info(obj):
-                """Custom JSON serialization function"""
-                from dataclasses import asdict
-                # Handle dataclass objects
-                if hasattr(obj, '__dataclass_fields__'):
-                    return asdict(obj)
-                # Handle objects with __dict__ attribute
-                elif hasattr(obj, '__dict__'):
-                    return {k: serialize_function_info(v) for k, v in obj.__dict__.items()}
-                # Handle namedtuple
-                elif hasattr(obj, '_asdict'):
-                    return obj._asdict()
-                # Handle lists and tuples
-                elif isinstance(obj, (list, tuple)):
-                    return [serialize_function_info(item) for item in obj]
-                # Handle dictionaries
-                elif isinstance(obj, dict):
-                    return {key: serialize_function_info(value) for key, value in obj.items()}
-                # Other basic types
-                else:
-                    return obj
-            
-            # Create directory if it doesn't exist
-            os.makedirs(os.path.dirname(output_file), exist_ok=True)
-            
-            with open(output_file, 'w', encoding='utf-8') as f:
-                json.dump(enhanced_functions, f, indent=2, default=serialize_function_info, ensure_ascii=False)
-            
-            logger.debug(f"Progress saved: {len(enhanced_functions)} functions")
-            
+            store.append(pending)
+            logger.debug(f"Progress saved: {len(store)} functions")
+            pending.clear()
         except Exception as e:
             logger.error(f"Failed to save progress: {e}")
 
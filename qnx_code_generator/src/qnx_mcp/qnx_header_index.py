@@ -0,0 +1,242 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+QNX Header Index
+Inverted index of the headers under header_search_paths: identifier to
+(header, line, kind) and file name to full path
+"""
+
+import os
+import re
+import sys
+import json
+import logging
+import sqlite3
+import threading
+import time
+from concurrent.futures import ProcessPoolExecutor
+from pathlib import Path
+from typing import Dict, List, Optional, Tuple
+
+logger = logging.getLogger(__name__)
+
+HEADER_SUFFIXES = ('.h', '.hpp')
+# Definitions a header can provide, with the group holding the identifier
+DEFINITION_PATTERNS = [
+    ('struct', re.compile(r'\bstruct\s+([A-Za-z_]\w*)\s*\{')),
+    ('union', re.compile(r'\bunion\s+([A-Za-z_]\w*)\s*\{')),
+    ('enum', re.compile(r'\benum\s+([A-Za-z_]\w*)\s*\{')),
+    ('define', re.compile(r'^\s*#\s*define\s+([A-Za-z_]\w*)', re.M)),
+]
+TYPEDEF_RE = re.compile(r'\btypedef\b')
+IDENT_RE = re.compile(r'[A-Za-z_]\w*')
+
+def _line_of(content: str, offset: int) -> int:
+    return content.count('\n', 0, offset) + 1
+
+def _typedef_names(content: str) -> List[Tuple[str, int]]:
+    """(name, line) of each typedef, including all the names of typedef a b, *c;"""
+    names = []
+    for m in TYPEDEF_RE.finditer(content):
+        depth, i = 0, m.end()
+        while i < len(content):
+            ch = content[i]
+            if ch in '{(':
+                depth += 1
+            elif ch in '})':
+                depth -= 1
+            elif ch == ';' and depth <= 0:
+                break
+            i += 1
+        declarators = content[m.end():i]
+        # Drop bodies and parameter lists, then take the last identifier of each declarator
+        flat = declarators
+        while True:
+            stripped = re.sub(r'\{[^{}]*\}', ' ', flat)
+            if stripped == flat:
+                break
+            flat = stripped
+        fnptr = re.findall(r'\(\s*\*\s*([A-Za-z_]\w*)\s*\)', flat)
+        if fnptr:
+            candidates = fnptr
+        else:
+            candidates = []
+            for part in flat.split(','):
+                part = re.sub(r'\[[^\]]*\]|\([^()]*\)', ' ', part)
+                idents = IDENT_RE.findall(part)
+                if idents:
+                    candidates.append(idents[-1])
+        for name in candidates:
+            names.append((name, _line_of(content, i)))
+    return names
+
+def scan_header(path: str) -> Tuple[str, List[Tuple[str, int, str]]]:
+    """(path, [(identifier, line, kind)]) for one header (runs in a worker process)"""
+    try:
+        with open(path, 'r', encoding='utf-8', errors='ignore') as f:
+            content = f.read()
+    except OSError:
+        return path, []
+    # Comments can hold anything that looks like a definition
+    content = re.sub(r'/\*.*?\*/', lambda m: '\n' * m.group(0).count('\n'), content, flags=re.S)
+    content = re.sub(r'//[^\n]*', '', content)
+    symbols = []
+    for kind, pattern in DEFINITION_PATTERNS:
+        for m in pattern.finditer(content):
+            symbols.append((m.group(1), _line_of(content, m.start(1)), kind))
+    symbols += [(name, line, 'typedef') for name, line in _typedef_names(content)]
+    return path, symbols
+
+class QNXHeaderIndex:
+    """Header symbols and paths in one SQLite database
+
+    refresh() walks the search paths and rescans, in parallel, only the
+    headers that are new or whose mtime changed since the last refresh.
+    """
+
+    # Index files already refreshed by this process
+    _refreshed = set()
+    _refresh_lock = threading.Lock()
+
+    def __init__(self, db_path: str = "./data/qnx_header_index.db"):
+        self.db_path = Path(db_path)
+        self.db_path.parent.mkdir(parents=True, exist_ok=True)
+        conn = self._connect()
+        try:
+            conn.execute("PRAGMA journal_mode=WAL")
+            conn.execute('''
+                CREATE TABLE IF NOT EXISTS files (
+                    path TEXT PRIMARY KEY,
+                    basename TEXT NOT NULL,
+                    mtime REAL
+                )
+            ''')
+            conn.execute('''
+                CREATE TABLE IF NOT EXISTS symbols (
+                    name TEXT NOT NULL,
+                    path TEXT NOT NULL,
+                    line INTEGER,
+                    kind TEXT
+                )
+            ''')
+            conn.execute("CREATE INDEX IF NOT EXISTS files_basename ON files(basename)")
+            conn.execute("CREATE INDEX IF NOT EXISTS symbols_name ON symbols(name)")
+            conn.execute("CREATE INDEX IF NOT EXISTS symbols_path ON symbols(path)")
+            conn.commit()
+        finally:
+            conn.close()
+
+    def _connect(self) -> sqlite3.Connection:
+        return sqlite3.connect(str(self.db_path), timeout=30)
+
+    def refresh(self, header_paths: List[str], max_workers: Optional[int] = None) -> int:
+        """Bring the index up to date with the headers on disk; returns the number rescanned"""
+        on_disk = {}
+        for root in header_paths:
+            if not os.path.isdir(root):
+                continue
+            for dirpath, dirs, files in os.walk(root):
+                for name in files:
+                    if name.endswith(HEADER_SUFFIXES):
+                        path = os.path.abspath(os.path.join(dirpath, name))
+                        if path not in on_disk:
+                            try:
+                                on_disk[path] = os.path.getmtime(path)
+                            except OSError:
+                                pass
+
+        conn = self._connect()
+        try:
+            indexed = dict(conn.execute("SELECT path, mtime FROM files"))
+        finally:
+            conn.close()
+        changed = [p for p, mtime in on_disk.items() if indexed.get(p) != mtime]
+        removed = [p for p in indexed if p not in on_disk]
+        if not changed and not removed:
+            return 0
+
+        start = time.time()
+        if len(changed) > 64:
+            with ProcessPoolExecutor(max_workers=max_workers) as executor:
+                scanned = list(executor.map(scan_header, changed, chunksize=64))
+        else:
+            scanned = [scan_header(p) for p in changed]
+
+        conn = self._connect()
+        try:
+            with conn:
+                for path in removed + changed:
+                    conn.execute("DELETE FROM symbols WHERE path = ?", (path,))
+                    conn.execute("DELETE FROM files WHERE path = ?", (path,))
+                for path, symbols in scanned:
+                    conn.execute("INSERT INTO files (path, basename, mtime) VALUES (?, ?, ?)",
+                                 (path, os.path.basename(path), on_disk[path]))
+                    conn.executemany("INSERT INTO symbols (name, path, line, kind) VALUES (?, ?, ?, ?)",
+                                     [(name, path, line, kind) for name, line, kind in symbols])
+        finally:
+            conn.close()
+        logger.info(f"Header index: rescanned {len(changed)} headers, dropped {len(removed)} "
+                    f"in {time.time() - start:.1f}s")
+        return len(changed)
+
+    def refresh_once(self, header_paths: List[str]):
+        """refresh() the first time this index is used in the process"""
+        key = str(self.db_path.resolve())
+        with self._refresh_lock:
+            if key in self._refreshed:
+                return
+            try:
+                self.refresh(header_paths)
+            except Exception as e:
+                logger.warning(f"Failed to refresh header index {self.db_path}: {e}")
+            self._refreshed.add(key)
+
+    def find(self, name: str) -> List[Tuple[str, int, str]]:
+        """(path, line, kind) of every definition of an identifier"""
+        conn = self._connect()
+        try:
+            return conn.execute("SELECT path, line, kind FROM symbols WHERE name = ? ORDER BY path, line",
+                                (name,)).fetchall()
+        finally:
+            conn.close()
+
+    def header_paths_for(self, header_filename: str) -> List[str]:
+        """Full paths of the headers named header_filename ("stat.h" or "sys/stat.h")"""
+        conn = self._connect()
+        try:
+            paths = [r[0] for r in conn.execute("SELECT path FROM files WHERE basename = ? ORDER BY path",
+                                                (os.path.basename(header_filename),))]
+        finally:
+            conn.close()
+        suffix = os.sep + header_filename.lstrip('/')
+        return [p for p in paths if p.endswith(suffix)]
+
+def main():
+    """Refresh the header index from the command line"""
+    import argparse
+
+    parser = argparse.ArgumentParser(description='Build or refresh the QNX header index')
+    parser.add_argument('--config', '-c', default='config.json', help='Configuration file path')
+    parser.add_argument('--db', help='Index database (default: qnx_system.header_index_path)')
+    parser.add_argument('--workers', '-w', type=int, help='Number of scanning processes')
+    parser.add_argument('--find', help='Print the definitions of an identifier')
+    args = parser.parse_args()
+
+    logging.basicConfig(level=logging.INFO, format='%(asctime)s - %(levelname)s - %(message)s')
+    try:
+        with open(args.config, 'r', encoding='utf-8') as f:
+            config = json.load(f)
+    except Exception as e:
+        logger.warning(f"Failed to load config file: {e}")
+        config = {}
+
+    qnx_config = config.get("qnx_system", {})
+    index = QNXHeaderIndex(args.db or qnx_config.get("header_index_path", "./data/qnx_header_index.db"))
+    index.refresh(qnx_config.get("header_search_paths", []), args.workers)
+    if args.find:
+        for path, line, kind in index.find(args.find):
+            print(f"{path}:{line}: {kind}")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+QNX HTML Cleaning
+Documentation pages reduced to the text sent to the LLM
+"""
+
+import logging
+
+try:
+    import lxml.html
+    from lxml import etree
+except ImportError:
+    lxml = None
+
+logger = logging.getLogger(__name__)
+
+# Bump when the cleaned text changes, so that cleaned pages stored in the
+# page cache by the old rules are cleaned again
+CLEAN_VERSION = "1"
+MAX_CHARS = 6000
+
+def _truncate(text: str) -> str:
+    # Limit length to avoid token overflow
+    if len(text) > MAX_CHARS:
+        return text[:MAX_CHARS] + "\n... (content truncated)"
+    return text
+
+def _clean_lxml(html_content: str) -> str:
+    root = lxml.html.fromstring(html_content)
+    etree.strip_elements(root, etree.Comment, "script", "style", with_tail=False)
+    main = (root.xpath("//div[contains(concat(' ', normalize-space(@class), ' '), ' content ')]")
+            or root.xpath("//main") or root.xpath("//body") or [root])[0]
+    lines = (line.strip() for text in main.itertext() for line in text.split('\n'))
+    return '\n'.join(line for line in lines if line)
+
+def _clean_bs4(html_content: str) -> str:
+    from bs4 import BeautifulSoup
+    soup = BeautifulSoup(html_content, 'html.parser')
+    for script in soup(["script", "style"]):
+        script.decompose()
+    main = soup.find('div', class_='content') or soup.find('main') or soup.body or soup
+    text = main.get_text(separator='\n', strip=True)
+    return '\n'.join(line.strip() for line in text.split('\n') if line.strip())
+
+def clean_html(html_content: str) -> str:
+    """Text of the page's main content area, one non-empty line per text node
+
+    lxml parses in C and is used when installed; BeautifulSoup's pure-Python
+    parser otherwise. Top level so that a process pool can run it.
+    """
+    try:
+        return _truncate(_clean_lxml(html_content) if lxml else _clean_bs4(html_content))
+    except Exception as e:
+        logger.warning(f"HTML cleaning failed: {e}")
+        return html_content[:MAX_CHARS]
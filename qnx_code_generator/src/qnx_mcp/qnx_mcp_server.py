@@ -10,6 +10,8 @@ import json
 import logging
 import os
 import sys
+import time
+from collections import OrderedDict
 from typing import Any, Dict, List, Optional, Sequence
 from pathlib import Path
 
@@ -23,9 +25,10 @@ from mcp.server import NotificationOptions, Server
 import mcp.server.stdio
 
 # Project imports
-from hybrid_vectorizer import HybridVectorizer
+from hybrid_vectorizer import HybridVectorizer, VectorizeTask
 from openai_json_extractor import serialize_function_info
-import chromadb
+from vector_store import VectorStore
+from qnx_function_index import QNXFunctionIndex
 
 # Set up logging
 logging.basicConfig(level=logging.INFO)
@@ -41,12 +44,20 @@ class QNXFunctionsMCPServer:
         
         # Initialize vectorizer and database connection
         self.vectorizer = None
-        self.chroma_client = None
         self.collection = None
         
         # Data directory
         self.data_dir = Path("./data/processed_functions")
-        self.chroma_db_path = "./data/chroma_db"
+        self.function_index = QNXFunctionIndex(str(self.data_dir))
+        vector_config = self.config.get("qnx_system", {}).get("vector_store", {})
+        self.max_results = vector_config.get("max_results", 50)
+        
+        # Embeddings of recent queries, least recently used first
+        self.query_cache: "OrderedDict[str, List[float]]" = OrderedDict()
+        self.query_cache_size = vector_config.get("query_cache_size", 1024)
+        # A missing store is looked for again at most this often
+        self.reconnect_interval = vector_config.get("reconnect_interval", 30.0)
+        self._db_checked = None
         
         logger.info("QNX Functions MCP Server initialized")
     
@@ -60,19 +71,24 @@ class QNXFunctionsMCPServer:
             return {}
     
     async def initialize_vector_db(self):
-        """Initialize vector database connection"""
+        """Initialize vector database connection
+        
+        Also loads the function index, so that the first query after start
+        does not pay for it.
+        """
+        self._db_checked = time.monotonic()
+        await asyncio.to_thread(self.function_index.names)
         try:
             # Initialize vectorizer
-            self.vectorizer = HybridVectorizer(self.config_path)
-            
-            # Initialize ChromaDB client
-            self.chroma_client = chromadb.PersistentClient(path=self.chroma_db_path)
-            
-            # Get or create collection
-            try:
-                self.collection = self.chroma_client.get_collection("qnx_functions_hybrid")
-                logger.info("Successfully connected to existing QNX function vector database")
-            except Exception:
+            if not self.vectorizer:
+                self.vectorizer = HybridVectorizer(self.config_path)
+            
+            # Map the quantized store; nothing is loaded until a query touches it
+            store = VectorStore.from_config(self.config, "qnx_functions_hybrid")
+            if store.exists:
+                self.collection = store
+                logger.info(f"Successfully connected to existing QNX function vector database ({store.count()} vectors)")
+            else:
                 logger.warning("No existing database found, please run the batch processor to generate data first")
                 self.collection = None
                 
@@ -83,80 +99,137 @@ class QNXFunctionsMCPServer:
     
     async def search_functions(self, query: str, n_results: int = 5) -> List[Dict[str, Any]]:
         """Search for relevant functions"""
-        if not self.collection or not self.vectorizer:
-            await self.initialize_vector_db()
-            
-        if not self.collection:
+        return (await self.search_functions_batch([query], n_results))[0]
+    
+    def _lexical_match(self, query: str, n_results: int) -> List[Dict[str, Any]]:
+        """Exact name or name prefix hits for identifier queries; [] when the query needs ranking"""
+        name = query.strip().rstrip('*').removesuffix('()')
+        if not self.function_index.is_name_query(name):
             return []
+        exact = self.function_index.canonical_name(name)
+        hits = [exact] if exact else []
+        hits += [n for n in self.function_index.prefix(name, n_results + 1) if n != exact]
+        return [{
+            "function_name": n,
+            "similarity": 1.0 if n == exact else None,
+            "distance": 0.0 if n == exact else None,
+            "match": "exact" if n == exact else "prefix",
+            "metadata": {"function_name": n}
+        } for n in hits[:n_results]]
+    
+    async def search_functions_batch(self, queries: List[str], n_results: int = 5) -> List[List[Dict[str, Any]]]:
+        """Search for relevant functions of several queries
         
-        try:
-            # Generate query vector
-            query_result = self.vectorizer.get_single_embedding(query)
-            if not query_result.success:
-                logger.error(f"Failed to generate query embedding: {query_result.error}")
-                return []
-            
-            # Search in vector database
-            results = self.collection.query(
-                query_embeddings=[query_result.embedding],
-                n_results=min(n_results, 10),  # Limit max results
-                include=["metadatas", "documents", "distances"]
-            )
-            
-            # Format results
-            formatted_results = []
-            if results["metadatas"] and results["metadatas"][0]:
-                for i, metadata in enumerate(results["metadatas"][0]):
-                    function_name = metadata.get("function_name", "unknown")
-                    distance = results["distances"][0][i] if results["distances"] else 0
-                    similarity = 1 - distance  # Convert to similarity
-                    
-                    formatted_results.append({
-                        "function_name": function_name,
-                        "similarity": round(similarity, 4),
-                        "distance": round(distance, 4),
-                        "metadata": metadata
-                    })
-            
-            logger.info(f"Found {len(formatted_results)} relevant functions")
+        Exact names and name prefixes are answered from the in-memory index.
+        The remaining (fuzzy) queries are embedded in one request, searched in
+        one store query and fused with their BM25 ranking (reciprocal rank).
+        """
+        n_results = max(1, min(n_results, self.max_results))
+        formatted_results = [self._lexical_match(query, n_results) for query in queries]
+        fuzzy = [i for i, results in enumerate(formatted_results) if not results]
+        if not fuzzy:
             return formatted_results
-            
-        except Exception as e:
-            logger.error(f"Function search failed: {e}")
-            return []
+        
+        lexical = {i: self.function_index.bm25(queries[i], n_results * 2) for i in fuzzy}
+        vector = {i: [] for i in fuzzy}
+        
+        if (not self.collection or not self.vectorizer) and (
+                self._db_checked is None or time.monotonic() - self._db_checked >= self.reconnect_interval):
+            await self.initialize_vector_db()
+        
+        if self.collection:
+            try:
+                valid = await self._query_embeddings([(i, queries[i]) for i in fuzzy])
+                
+                # Search in vector database
+                if valid:
+                    results = await asyncio.to_thread(
+                        self.collection.query, [embedding for _, embedding in valid], n_results * 2)
+                    for slot, (i, _) in enumerate(valid):
+                        vector[i] = list(zip(results["metadatas"][slot], results["distances"][slot]))
+            except Exception as e:
+                logger.error(f"Function search failed: {e}")
+        
+        # Reciprocal rank fusion of the BM25 and vector rankings
+        for i in fuzzy:
+            fused, details = {}, {}
+            for rank, (name, score) in enumerate(lexical[i]):
+                fused[name] = fused.get(name, 0.0) + 1.0 / (60 + rank)
+                details.setdefault(name, {"metadata": {"function_name": name}})["bm25"] = score
+            for rank, (metadata, distance) in enumerate(vector[i]):
+                name = metadata.get("function_name", "unknown")
+                fused[name] = fused.get(name, 0.0) + 1.0 / (60 + rank)
+                details.setdefault(name, {})["metadata"] = metadata
+                details[name]["distance"] = distance
+            
+            for name in sorted(fused, key=lambda n: -fused[n])[:n_results]:
+                distance = details[name].get("distance")
+                formatted_results[i].append({
+                    "function_name": name,
+                    "similarity": round(1 - distance, 4) if distance is not None else None,
+                    "distance": round(distance, 4) if distance is not None else None,
+                    "bm25": details[name].get("bm25"),
+                    "score": round(fused[name], 5),
+                    "match": "hybrid" if distance is not None and "bm25" in details[name]
+                             else ("vector" if distance is not None else "bm25"),
+                    "metadata": details[name]["metadata"]
+                })
+        
+        logger.info(f"Found {sum(len(r) for r in formatted_results)} relevant functions for {len(queries)} queries")
+        return formatted_results
+    
+    @staticmethod
+    def _query_key(query: str) -> str:
+        return ' '.join(query.split())
+    
+    async def _query_embeddings(self, queries: List[tuple]) -> List[tuple]:
+        """(slot, embedding) of each (slot, query) that could be embedded
+        
+        Queries seen recently are answered from the LRU cache; the others
+        are embedded in one request and cached.
+        """
+        found, missing = {}, []
+        for i, query in queries:
+            embedding = self.query_cache.get(self._query_key(query))
+            if embedding is not None:
+                self.query_cache.move_to_end(self._query_key(query))
+                found[i] = embedding
+            else:
+                missing.append((i, query))
+        
+        if len(missing) == 1:
+            query_results = [await asyncio.to_thread(self.vectorizer.get_single_embedding, missing[0][1])]
+        elif missing:
+            tasks = [VectorizeTask(query, f"query_{i}", {}) for i, query in missing]
+            query_results = await asyncio.to_thread(self.vectorizer.get_batch_embeddings, tasks)
+        else:
+            query_results = []
+        for (i, query), r in zip(missing, query_results):
+            if not r.success:
+                logger.error(f"Failed to generate query embedding for '{query}': {r.error}")
+                continue
+            found[i] = r.embedding
+            self.query_cache[self._query_key(query)] = r.embedding
+            if len(self.query_cache) > self.query_cache_size:
+                self.query_cache.popitem(last=False)
+        return [(i, found[i]) for i, _ in queries if i in found]
     
     async def get_function_details(self, function_name: str) -> Optional[Dict[str, Any]]:
         """Get detailed information about a function"""
         try:
-            # Search processed function files
-            for json_file in self.data_dir.glob("*.json"):
-                if json_file.name.endswith('.stats.json'):
-                    continue
-                    
-                try:
-                    with open(json_file, 'r', encoding='utf-8') as f:
-                        data = json.load(f)
-                    
-                    if function_name in data:
-                        function_data = data[function_name]
-                        
-                        # Add some metadata
-                        result = {
-                            "function_name": function_name,
-                            "source_file": str(json_file.name),
-                            "function_data": function_data.get("function_data", {}),
-                            "has_embedding": function_data.get("has_embedding", False)
-                        }
-                        
-                        logger.info(f"Found function details: {function_name}")
-                        return result
-                        
-                except Exception as e:
-                    logger.warning(f"Failed to read file {json_file}: {e}")
-                    continue
-            
-            logger.warning(f"Function not found: {function_name}")
-            return None
+            entry = self.function_index.get(function_name)
+            if entry is None:
+                logger.warning(f"Function not found: {function_name}")
+                return None
+            
+            result = {
+                "function_name": self.function_index.canonical_name(function_name),
+                "source_file": entry["source_file"],
+                "function_data": entry["function_data"],
+                "has_embedding": entry["has_embedding"]
+            }
+            logger.debug(f"Found function details: {function_name}")
+            return result
             
         except Exception as e:
             logger.error(f"Failed to get function details: {e}")
@@ -165,25 +238,7 @@ class QNXFunctionsMCPServer:
     async def get_available_functions(self, limit: int = 50) -> List[str]:
         """Get list of available functions"""
         try:
-            functions = set()
-            
-            # Scan all JSON files
-            for json_file in self.data_dir.glob("*.json"):
-                if json_file.name.endswith('.stats.json'):
-                    continue
-                    
-                try:
-                    with open(json_file, 'r', encoding='utf-8') as f:
-                        data = json.load(f)
-                    
-                    functions.update(data.keys())
-                    
-                except Exception as e:
-                    logger.warning(f"Failed to read file {json_file}: {e}")
-                    continue
-            
-            # Convert to sorted list and limit count
-            function_list = sorted(list(functions))[:limit]
+            function_list = self.function_index.names()[:limit]
             logger.info(f"Found {len(function_list)} available functions")
             return function_list
             
@@ -202,7 +257,7 @@ async def handle_list_tools() -> List[types.Tool]:
     return [
         types.Tool(
             name="search_qnx_functions",
-            description="Search for QNX functions using semantic similarity",
+            description="Search for QNX functions: exact names and prefixes directly, other queries by keyword (BM25) and semantic similarity",
             inputSchema={
                 "type": "object",
                 "properties": {
@@ -210,15 +265,19 @@ async def handle_list_tools() -> List[types.Tool]:
                         "type": "string",
                         "description": "Search query (function name, description, or functionality)"
                     },
+                    "queries": {
+                        "type": "array",
+                        "items": {"type": "string"},
+                        "description": "Several search queries answered in one call (instead of query)"
+                    },
                     "max_results": {
                         "type": "integer",
-                        "description": "Maximum number of results to return (default: 5)",
+                        "description": "Maximum number of results per query (default: 5)",
                         "default": 5,
                         "minimum": 1,
-                        "maximum": 10
+                        "maximum": qnx_server.max_results
                     }
-                },
-                "required": ["query"]
+                }
             }
         ),
         types.Tool(
@@ -230,6 +289,12 @@ async def handle_list_tools() -> List[types.Tool]:
                     "function_name": {
                         "type": "string",
                         "description": "Name of the QNX function to get details for"
+                    },
+                    "format": {
+                        "type": "string",
+                        "enum": ["markdown", "json"],
+                        "description": "markdown for reading, json for the extracted record (default: markdown)",
+                        "default": "markdown"
                     }
                 },
                 "required": ["function_name"]
@@ -258,30 +323,32 @@ async def handle_call_tool(name: str, arguments: Dict[str, Any]) -> List[types.T
     """Handle tool calls"""
     try:
         if name == "search_qnx_functions":
-            query = arguments.get("query", "")
+            queries = arguments.get("queries") or ([arguments["query"]] if arguments.get("query") else [])
             max_results = arguments.get("max_results", 5)
             
-            if not query:
+            if not queries:
                 return [types.TextContent(
                     type="text",
                     text="Error: Query parameter is required"
                 )]
             
-            results = await qnx_server.search_functions(query, max_results)
-            
-            if not results:
-                return [types.TextContent(
-                    type="text", 
-                    text=f"No QNX functions found for query: '{query}'"
-                )]
+            all_results = await qnx_server.search_functions_batch(queries, max_results)
             
             # Format search results
-            result_text = f"Found {len(results)} QNX functions for query: '{query}'\n\n"
-            
-            for i, result in enumerate(results, 1):
-                result_text += f"{i}. **{result['function_name']}**\n"
-                result_text += f"   Similarity: {result['similarity']:.3f}\n"
-                result_text += f"   Use `get_qnx_function_details` with function_name='{result['function_name']}' for full details\n\n"
+            result_text = ""
+            for query, results in zip(queries, all_results):
+                if not results:
+                    result_text += f"No QNX functions found for query: '{query}'\n\n"
+                    continue
+                
+                result_text += f"Found {len(results)} QNX functions for query: '{query}'\n\n"
+                
+                for i, result in enumerate(results, 1):
+                    result_text += f"{i}. **{result['function_name']}**\n"
+                    if result.get("similarity") is not None:
+                        result_text += f"   Similarity: {result['similarity']:.3f}\n"
+                    result_text += f"   Match: {result.get('match', 'vector')}\n"
+                    result_text += f"   Use `get_qnx_function_details` with function_name='{result['function_name']}' for full details\n\n"
             
             return [types.TextContent(type="text", text=result_text)]
         
@@ -296,6 +363,13 @@ async def handle_call_tool(name: str, arguments: Dict[str, Any]) -> List[types.T
             
             details = await qnx_server.get_function_details(function_name)
             
+            if arguments.get("format") == "json":
+                return [types.TextContent(
+                    type="text",
+                    text=json.dumps(details or {"error": f"Function '{function_name}' not found in QNX database"},
+                                    ensure_ascii=False)
+                )]
+            
             if not details:
                 return [types.TextContent(
                     type="text",
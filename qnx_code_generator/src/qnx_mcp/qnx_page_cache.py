@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+QNX Page Cache
+Compressed, content-addressed store for crawled documentation pages
+"""
+
+import json
+import hashlib
+import logging
+import sqlite3
+import time
+import zlib
+from pathlib import Path
+from typing import Callable, Dict, List, Optional, Tuple
+
+try:
+    import zstandard
+except ImportError:
+    zstandard = None
+
+logger = logging.getLogger(__name__)
+
+class QNXPageCache:
+    """Crawled pages in one SQLite database
+
+    Page bodies are stored once per content hash, compressed with zstd (zlib
+    when zstandard is not installed; the codec is recorded per body). Pages
+    are keyed by URL, so a function documented in several library sections
+    keeps one entry per URL, and are indexed by function name. The text a
+    body cleans to is kept beside it, per cleaning version, so that a page
+    is parsed once per version of its content.
+    """
+
+    def __init__(self, db_path: Path):
+        self.db_path = Path(db_path)
+        self.db_path.parent.mkdir(parents=True, exist_ok=True)
+        conn = self._connect()
+        try:
+            conn.execute("PRAGMA journal_mode=WAL")
+            conn.execute('''
+                CREATE TABLE IF NOT EXISTS bodies (
+                    hash TEXT PRIMARY KEY,
+                    codec TEXT NOT NULL,
+                    data BLOB NOT NULL
+                )
+            ''')
+            conn.execute('''
+                CREATE TABLE IF NOT EXISTS pages (
+                    url TEXT PRIMARY KEY,
+                    name TEXT NOT NULL,
+                    hash TEXT NOT NULL REFERENCES bodies(hash),
+                    etag TEXT,
+                    last_modified TEXT,
+                    fetched_at REAL
+                )
+            ''')
+            conn.execute('''
+                CREATE TABLE IF NOT EXISTS cleaned (
+                    hash TEXT NOT NULL,
+                    version TEXT NOT NULL,
+                    codec TEXT NOT NULL,
+                    data BLOB NOT NULL,
+                    PRIMARY KEY (hash, version)
+                )
+            ''')
+            conn.execute("CREATE INDEX IF NOT EXISTS pages_name ON pages(name)")
+            conn.execute("CREATE INDEX IF NOT EXISTS pages_hash ON pages(hash)")
+            conn.commit()
+        finally:
+            conn.close()
+
+    def _connect(self) -> sqlite3.Connection:
+        return sqlite3.connect(str(self.db_path), timeout=30)
+
+    @staticmethod
+    def _compress(text: str) -> Tuple[str, bytes]:
+        raw = text.encode('utf-8')
+        if zstandard:
+            return "zstd", zstandard.ZstdCompressor(level=10).compress(raw)
+        return "zlib", zlib.compress(raw, 9)
+
+    @staticmethod
+    def _decompress(codec: str, data: bytes) -> str:
+        if codec == "zstd":
+            if not zstandard:
+                raise RuntimeError("page cache entry is zstd-compressed but zstandard is not installed")
+            return zstandard.ZstdDecompressor().decompress(data).decode('utf-8')
+        return zlib.decompress(data).decode('utf-8')
+
+    def get(self, url: str) -> Optional[Dict[str, Optional[str]]]:
+        """{'name', 'html', 'etag', 'last_modified'} of a cached URL, or None"""
+        conn = self._connect()
+        try:
+            row = conn.execute('''
+                SELECT p.name, b.codec, b.data, p.etag, p.last_modified
+                FROM pages p JOIN bodies b ON b.hash = p.hash
+                WHERE p.url = ?
+            ''', (url,)).fetchone()
+        finally:
+            conn.close()
+        if not row:
+            return None
+        name, codec, data, etag, last_modified = row
+        return {"name": name, "html": self._decompress(codec, data),
+                "etag": etag, "last_modified": last_modified}
+
+    def put(self, url: str, name: str, html: str,
+            etag: Optional[str] = None, last_modified: Optional[str] = None):
+        digest = self.content_hash(html)
+        conn = self._connect()
+        try:
+            old = conn.execute("SELECT hash FROM pages WHERE url = ?", (url,)).fetchone()
+            if not conn.execute("SELECT 1 FROM bodies WHERE hash = ?", (digest,)).fetchone():
+                codec, data = self._compress(html)
+                conn.execute("INSERT OR IGNORE INTO bodies (hash, codec, data) VALUES (?, ?, ?)",
+                             (digest, codec, data))
+            conn.execute('''
+                INSERT OR REPLACE INTO pages (url, name, hash, etag, last_modified, fetched_at)
+                VALUES (?, ?, ?, ?, ?, ?)
+            ''', (url, name, digest, etag, last_modified, time.time()))
+            # The page changed: drop its old body unless another page shares it
+            if old and old[0] != digest and not conn.execute(
+                    "SELECT 1 FROM pages WHERE hash = ?", (old[0],)).fetchone():
+                conn.execute("DELETE FROM bodies WHERE hash = ?", (old[0],))
+                conn.execute("DELETE FROM cleaned WHERE hash = ?", (old[0],))
+            conn.commit()
+        finally:
+            conn.close()
+
+    @staticmethod
+    def content_hash(html: str) -> str:
+        return hashlib.sha256(html.encode('utf-8')).hexdigest()
+
+    def get_cleaned(self, digests: List[str], version: str) -> Dict[str, str]:
+        """Cleaned text by body hash, for those of digests cleaned with version"""
+        found = {}
+        conn = self._connect()
+        try:
+            for i in range(0, len(digests), 500):
+                chunk = digests[i:i + 500]
+                rows = conn.execute(
+                    f"SELECT hash, codec, data FROM cleaned WHERE version = ? "
+                    f"AND hash IN ({','.join('?' * len(chunk))})", [version] + chunk)
+                for digest, codec, data in rows:
+                    found[digest] = self._decompress(codec, data)
+        finally:
+            conn.close()
+        return found
+
+    def put_cleaned(self, cleaned: Dict[str, str], version: str):
+        conn = self._connect()
+        try:
+            conn.executemany(
+                "INSERT OR REPLACE INTO cleaned (hash, version, codec, data) VALUES (?, ?, ?, ?)",
+                [(digest, version, *self._compress(text)) for digest, text in cleaned.items()])
+            conn.commit()
+        finally:
+            conn.close()
+
+    def urls_for(self, name: str) -> List[str]:
+        """All cached URLs documenting a function name"""
+        conn = self._connect()
+        try:
+            return [r[0] for r in conn.execute(
+                "SELECT url FROM pages WHERE name = ? ORDER BY url", (name,))]
+        finally:
+            conn.close()
+
+    def names(self) -> List[str]:
+        """Function names with at least one cached page"""
+        conn = self._connect()
+        try:
+            return [r[0] for r in conn.execute("SELECT DISTINCT name FROM pages ORDER BY name")]
+        finally:
+            conn.close()
+
+    def count(self) -> int:
+        conn = self._connect()
+        try:
+            return conn.execute("SELECT COUNT(*) FROM pages").fetchone()[0]
+        finally:
+            conn.close()
+
+    def import_html_dir(self, cache_dir: Path, url_for: Callable[[str], str]) -> int:
+        """Import the legacy one-file-per-function cache (<name>.html and its .meta.json)"""
+        imported = 0
+        for html_file in sorted(Path(cache_dir).glob("*.html")):
+            name = html_file.stem
+            try:
+                html = html_file.read_text(encoding='utf-8')
+            except Exception as e:
+                logger.warning(f"Failed to import cached page {html_file}: {e}")
+                continue
+            try:
+                meta = json.loads(html_file.with_suffix(".meta.json").read_text(encoding='utf-8'))
+            except (OSError, ValueError):
+                meta = {}
+            self.put(url_for(name), name, html, meta.get("etag"), meta.get("last_modified"))
+            imported += 1
+        if imported:
+            logger.info(f"Imported {imported} cached pages from {cache_dir}")
+        return imported
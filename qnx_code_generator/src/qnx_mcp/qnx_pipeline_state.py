@@ -0,0 +1,207 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+QNX Pipeline State
+Per-function state of the step pipeline in SQLite, so every step works only
+on the functions in its input state, interrupted runs resume where they
+stopped and several processes can share one pipeline
+"""
+
+import json
+import logging
+import os
+import socket
+import sqlite3
+import struct
+import time
+from pathlib import Path
+from typing import Any, Dict, List, Optional, Sequence, Tuple
+
+logger = logging.getLogger(__name__)
+
+# Every function moves through these states in order
+STATES = ["discovered", "crawled", "extracted", "enhanced", "embedded", "stored"]
+STATE_RANK = {state: rank for rank, state in enumerate(STATES)}
+
+class PipelineState:
+    """One row per function: state, the extracted data, its embedding and a lease
+
+    A worker claims a batch of items in a step's input state; the claim is a
+    lease that expires, so the items of a killed worker are picked up again
+    by the next one. An item that failed max_attempts times in a state is
+    left there until reset_failed().
+    """
+
+    def __init__(self, db_path: str = "./data/processed_functions/pipeline_state.db",
+                 lease_seconds: float = 600, max_attempts: int = 3):
+        self.db_path = Path(db_path)
+        self.lease_seconds = lease_seconds
+        self.max_attempts = max_attempts
+        self.owner = f"{socket.gethostname()}:{os.getpid()}"
+        self.db_path.parent.mkdir(parents=True, exist_ok=True)
+        conn = self._connect()
+        try:
+            conn.execute("PRAGMA journal_mode=WAL")
+            conn.execute('''
+                CREATE TABLE IF NOT EXISTS items (
+                    name TEXT PRIMARY KEY,
+                    state INTEGER NOT NULL,
+                    data TEXT,
+                    embedding BLOB,
+                    attempts INTEGER NOT NULL DEFAULT 0,
+                    error TEXT,
+                    lease_owner TEXT,
+                    lease_until REAL,
+                    updated_at REAL
+                )
+            ''')
+            conn.execute("CREATE INDEX IF NOT EXISTS items_state ON items(state, name)")
+            conn.commit()
+        finally:
+            conn.close()
+
+    @classmethod
+    def from_config(cls, config: Dict[str, Any]) -> "PipelineState":
+        """processing_settings.state: {"path", "lease_seconds", "max_attempts"}"""
+        state_config = config.get("processing_settings", {}).get("state", {})
+        return cls(state_config.get("path", "./data/processed_functions/pipeline_state.db"),
+                   state_config.get("lease_seconds", 600),
+                   state_config.get("max_attempts", 3))
+
+    def _connect(self) -> sqlite3.Connection:
+        return sqlite3.connect(str(self.db_path), timeout=30, isolation_level=None)
+
+    def add(self, names: Sequence[str], state: str = "discovered", data: Optional[Dict[str, Dict[str, Any]]] = None) -> int:
+        """Insert functions not yet known in state; returns how many were new"""
+        now = time.time()
+        conn = self._connect()
+        try:
+            before = conn.total_changes
+            conn.execute("BEGIN IMMEDIATE")
+            conn.executemany("INSERT OR IGNORE INTO items (name, state, data, updated_at) VALUES (?, ?, ?, ?)",
+                             [(name, STATE_RANK[state],
+                               json.dumps(data[name], ensure_ascii=False) if data and name in data else None, now)
+                              for name in names])
+            conn.execute("COMMIT")
+            return conn.total_changes - before
+        finally:
+            conn.close()
+
+    def claim(self, state: str, limit: int, names: Optional[Sequence[str]] = None) -> List[Tuple[str, Optional[Dict[str, Any]]]]:
+        """Lease up to limit unleased items in state (restricted to names); returns (name, data)"""
+        now = time.time()
+        conn = self._connect()
+        try:
+            conn.execute("BEGIN IMMEDIATE")
+            query = ("SELECT name, data FROM items WHERE state = ? AND attempts < ? "
+                     "AND (lease_until IS NULL OR lease_until < ?)")
+            rows = []
+            if names is None:
+                rows = conn.execute(query + " ORDER BY name LIMIT ?",
+                                    (STATE_RANK[state], self.max_attempts, now, limit)).fetchall()
+            else:
+                names = list(names)
+                for i in range(0, len(names), 500):
+                    chunk = names[i:i + 500]
+                    rows.extend(conn.execute(query + f" AND name IN ({','.join('?' * len(chunk))}) ORDER BY name LIMIT ?",
+                                             (STATE_RANK[state], self.max_attempts, now, *chunk, limit - len(rows))))
+                    if len(rows) >= limit:
+                        break
+            conn.executemany("UPDATE items SET lease_owner = ?, lease_until = ? WHERE name = ?",
+                             [(self.owner, now + self.lease_seconds, name) for name, _ in rows])
+            conn.execute("COMMIT")
+        finally:
+            conn.close()
+        return [(name, json.loads(data) if data else None) for name, data in rows]
+
+    def advance(self, results: Dict[str, Optional[Dict[str, Any]]], state: str,
+                embeddings: Optional[Dict[str, List[float]]] = None):
+        """Move items to state and release their lease; data is replaced when not None"""
+        if not results:
+            return
+        now = time.time()
+        embeddings = embeddings or {}
+        conn = self._connect()
+        try:
+            conn.execute("BEGIN IMMEDIATE")
+            conn.executemany('''
+                UPDATE items SET state = ?, data = COALESCE(?, data), embedding = COALESCE(?, embedding),
+                                 attempts = 0, error = NULL, lease_owner = NULL, lease_until = NULL, updated_at = ?
+                WHERE name = ?
+            ''', [(STATE_RANK[state],
+                   json.dumps(data, ensure_ascii=False) if data is not None else None,
+                   struct.pack(f'{len(embeddings[name])}f', *embeddings[name]) if name in embeddings else None,
+                   now, name) for name, data in results.items()])
+            conn.execute("COMMIT")
+        finally:
+            conn.close()
+
+    def fail(self, errors: Dict[str, str]):
+        """Count a failed attempt and release the lease; the item stays in its state"""
+        if not errors:
+            return
+        conn = self._connect()
+        try:
+            conn.execute("BEGIN IMMEDIATE")
+            conn.executemany('''
+                UPDATE items SET attempts = attempts + 1, error = ?, lease_owner = NULL, lease_until = NULL,
+                                 updated_at = ?
+                WHERE name = ?
+            ''', [(error, time.time(), name) for name, error in errors.items()])
+            conn.execute("COMMIT")
+        finally:
+            conn.close()
+
+    def release(self, names: Sequence[str]):
+        """Give back leases without counting an attempt (e.g. on shutdown)"""
+        conn = self._connect()
+        try:
+            conn.executemany("UPDATE items SET lease_owner = NULL, lease_until = NULL WHERE name = ? AND lease_owner = ?",
+                             [(name, self.owner) for name in names])
+        finally:
+            conn.close()
+
+    def reset_failed(self) -> int:
+        conn = self._connect()
+        try:
+            return conn.execute("UPDATE items SET attempts = 0, error = NULL WHERE attempts > 0").rowcount
+        finally:
+            conn.close()
+
+    def items(self, min_state: str, names: Optional[Sequence[str]] = None) -> Dict[str, Dict[str, Any]]:
+        """name -> {"state", "data", "embedding"} of the items at or past min_state"""
+        conn = self._connect()
+        try:
+            rows = conn.execute("SELECT name, state, data, embedding FROM items WHERE state >= ?",
+                                (STATE_RANK[min_state],)).fetchall()
+        finally:
+            conn.close()
+        wanted = set(names) if names is not None else None
+        return {name: {"state": STATES[state],
+                       "data": json.loads(data) if data else None,
+                       "embedding": list(struct.unpack(f'{len(embedding) // 4}f', embedding)) if embedding else None}
+                for name, state, data, embedding in rows if wanted is None or name in wanted}
+
+    def names(self, state: Optional[str] = None) -> List[str]:
+        """Names of all items, or of the items in state"""
+        conn = self._connect()
+        try:
+            if state is None:
+                return [row[0] for row in conn.execute("SELECT name FROM items ORDER BY name")]
+            return [row[0] for row in conn.execute("SELECT name FROM items WHERE state = ? ORDER BY name",
+                                                   (STATE_RANK[state],))]
+        finally:
+            conn.close()
+
+    def counts(self) -> Dict[str, int]:
+        """Items per state, plus "failed" (items that ran out of attempts)"""
+        conn = self._connect()
+        try:
+            counts = {state: 0 for state in STATES}
+            for state, count in conn.execute("SELECT state, COUNT(*) FROM items GROUP BY state"):
+                counts[STATES[state]] = count
+            counts["failed"] = conn.execute("SELECT COUNT(*) FROM items WHERE attempts >= ?",
+                                            (self.max_attempts,)).fetchone()[0]
+            return counts
+        finally:
+            conn.close()
@@ -0,0 +1,219 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+QNX Record Store
+Append-only JSONL storage of processed functions with a sidecar offset index,
+so checkpoints append only the new records and readers seek to one function
+instead of parsing the whole result file
+"""
+
+import fcntl
+import json
+import logging
+import os
+import threading
+from contextlib import contextmanager
+from pathlib import Path
+from typing import Any, Callable, Dict, Iterator, List, Optional, Tuple
+
+logger = logging.getLogger(__name__)
+
+class JSONLRecordStore:
+    """One {"name": ..., "data": ...} JSON object per line in path, plus path.idx
+
+    The index holds one "offset<TAB>length<TAB>name" line per record. A name
+    written again supersedes its earlier line; compact() drops superseded
+    lines. A torn last line (a writer killed mid-append) is truncated on open,
+    and an index that does not match the data file is rebuilt from it.
+    Writers hold an flock on path.lock, so several processes can append to
+    one store; each picks up the others' records before writing.
+    """
+
+    def __init__(self, path: str, default: Optional[Callable[[Any], Any]] = None):
+        self.path = Path(path)
+        self.index_path = self.path.with_name(self.path.name + ".idx")
+        self.default = default
+        self.offsets: Dict[str, Tuple[int, int]] = {}
+        self.lines = 0
+        self.end = -1
+        self._lock = threading.Lock()
+        self.path.parent.mkdir(parents=True, exist_ok=True)
+        with self._locked():
+            pass
+
+    @contextmanager
+    def _locked(self):
+        """Exclusive access to the files, with the offsets brought up to date first"""
+        with self._lock, open(self.path.with_name(self.path.name + ".lock"), 'a') as lock_file:
+            fcntl.flock(lock_file, fcntl.LOCK_EX)
+            try:
+                size = self.path.stat().st_size if self.path.exists() else 0
+                if size != self.end:
+                    self.offsets, self.lines = {}, 0
+                    self._open_index()
+                yield
+            finally:
+                fcntl.flock(lock_file, fcntl.LOCK_UN)
+
+    def _open_index(self):
+        size = self.path.stat().st_size if self.path.exists() else 0
+        covered = 0
+        if self.index_path.exists() and size:
+            with open(self.index_path, 'r', encoding='utf-8') as f:
+                for line in f:
+                    parts = line.rstrip('\n').split('\t', 2)
+                    if len(parts) != 3:
+                        break
+                    offset, length = int(parts[0]), int(parts[1])
+                    if offset + length > size:
+                        break
+                    self.offsets[parts[2]] = (offset, length)
+                    self.lines += 1
+                    covered = max(covered, offset + length)
+        if covered == size and self.index_path.exists() == bool(size):
+            self.end = size
+            return
+        # The index lags behind the data file (or is missing): index the records after the covered part
+        if covered == 0:
+            self.offsets, self.lines = {}, 0
+        scanned = self._scan(covered, size)
+        with open(self.index_path, 'w', encoding='utf-8') as f:
+            for name, (offset, length) in sorted(self.offsets.items(), key=lambda kv: kv[1][0]):
+                f.write(f"{offset}\t{length}\t{name}\n")
+        self.end = self.path.stat().st_size if self.path.exists() else 0
+        if scanned:
+            logger.info(f"Indexed {len(scanned)} records of {self.path}")
+
+    def _scan(self, start: int, size: int) -> List[Tuple[str, int, int]]:
+        scanned, end = [], start
+        if not size:
+            return scanned
+        with open(self.path, 'rb') as f:
+            f.seek(start)
+            offset = start
+            for line in f:
+                if not line.endswith(b'\n'):
+                    break
+                try:
+                    name = json.loads(line)["name"]
+                except (ValueError, KeyError, TypeError):
+                    logger.warning(f"Skipping unreadable record at {self.path}:{offset}")
+                    offset += len(line)
+                    end = offset
+                    continue
+                self.offsets[name] = (offset, len(line))
+                self.lines += 1
+                scanned.append((name, offset, len(line)))
+                offset += len(line)
+                end = offset
+        if end < size:
+            logger.warning(f"Truncating torn record at the end of {self.path}")
+            os.truncate(self.path, end)
+        return scanned
+
+    def append(self, records: Dict[str, Any]) -> int:
+        """Append records (name -> data); returns how many were written"""
+        if not records:
+            return 0
+        with self._locked():
+            written = []
+            with open(self.path, 'ab') as f:
+                offset = f.tell()
+                for name, data in records.items():
+                    line = (json.dumps({"name": name, "data": data}, ensure_ascii=False, default=self.default)
+                            + '\n').encode('utf-8')
+                    f.write(line)
+                    written.append((name, offset, len(line)))
+                    offset += len(line)
+                f.flush()
+                os.fsync(f.fileno())
+            with open(self.index_path, 'a', encoding='utf-8') as f:
+                for name, offset, length in written:
+                    f.write(f"{offset}\t{length}\t{name}\n")
+            for name, offset, length in written:
+                self.offsets[name] = (offset, length)
+            self.lines += len(written)
+            self.end = offset
+        return len(written)
+
+    def get(self, name: str) -> Optional[Any]:
+        """Data of one record, read with a single seek"""
+        location = self.offsets.get(name)
+        if location is None:
+            return None
+        with open(self.path, 'rb') as f:
+            f.seek(location[0])
+            return json.loads(f.read(location[1]))["data"]
+
+    def names(self) -> List[str]:
+        return list(self.offsets)
+
+    def __contains__(self, name: str) -> bool:
+        return name in self.offsets
+
+    def __len__(self) -> int:
+        return len(self.offsets)
+
+    def items(self) -> Iterator[Tuple[str, Any]]:
+        """(name, data) of the latest version of every record, in one sequential read"""
+        if not self.offsets:
+            return
+        live = {offset for offset, _ in self.offsets.values()}
+        with open(self.path, 'rb') as f:
+            offset = 0
+            for line in f:
+                if offset in live:
+                    record = json.loads(line)
+                    yield record["name"], record["data"]
+                offset += len(line)
+
+    def load_all(self) -> Dict[str, Any]:
+        return dict(self.items())
+
+    @property
+    def superseded(self) -> int:
+        return self.lines - len(self.offsets)
+
+    def compact(self, force: bool = False) -> bool:
+        """Rewrite the file without superseded lines (by default only once they outnumber the live ones)"""
+        with self._locked():
+            if not self.superseded or (not force and self.superseded < len(self.offsets)):
+                return False
+            tmp_path = self.path.with_name(self.path.name + ".tmp")
+            offsets, offset = {}, 0
+            with open(self.path, 'rb') as src, open(tmp_path, 'wb') as f:
+                for name, (start, length) in sorted(self.offsets.items(), key=lambda kv: kv[1][0]):
+                    src.seek(start)
+                    f.write(src.read(length))
+                    offsets[name] = (offset, length)
+                    offset += length
+                f.flush()
+                os.fsync(f.fileno())
+            with open(self.index_path.with_name(self.index_path.name + ".tmp"), 'w', encoding='utf-8') as f:
+                for name, (start, length) in offsets.items():
+                    f.write(f"{start}\t{length}\t{name}\n")
+            os.replace(tmp_path, self.path)
+            os.replace(self.index_path.with_name(self.index_path.name + ".tmp"), self.index_path)
+            logger.info(f"Compacted {self.path}: dropped {self.superseded} superseded records")
+            self.offsets, self.lines, self.end = offsets, len(offsets), offset
+        return True
+
+    def remove(self):
+        """Delete the store's files"""
+        with self._lock:
+            for path in (self.path, self.index_path, self.path.with_name(self.path.name + ".lock")):
+                if path.exists():
+                    path.unlink()
+            self.offsets, self.lines, self.end = {}, 0, -1
+
+    def export_json(self, output_file: str):
+        """Write all records as one JSON object (the format of the older result files)"""
+        with open(output_file, 'w', encoding='utf-8') as f:
+            json.dump(self.load_all(), f, indent=2, ensure_ascii=False)
+
+def load_records(path: str) -> Dict[str, Any]:
+    """name -> data of a result file, either a JSONL store or a single JSON object"""
+    if str(path).endswith('.jsonl'):
+        return JSONLRecordStore(path).load_all()
+    with open(path, 'r', encoding='utf-8') as f:
+        return json.load(f)
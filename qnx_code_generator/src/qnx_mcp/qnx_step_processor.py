@@ -11,23 +11,36 @@ import json
 import logging
 import time
 import argparse
-from typing import Dict, List, Optional, Any, Set
+from typing import Callable, Dict, List, Optional, Any
 from pathlib import Path
 from dataclasses import dataclass, asdict
 
 # Add current directory to Python path
 sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(1, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
 
 from qnx_web_crawler import QNXWebCrawler, QNXFunction
 from openai_json_extractor import OpenAIJSONExtractor
 from claude_json_extractor import ClaudeJSONExtractor
-from hybrid_vectorizer import HybridVectorizer, VectorizeTask, VectorizeResult
+from hybrid_vectorizer import HybridVectorizer, VectorizeTask
 from qnx_gdb_type_enhancer import QNXGDBTypeEnhancer
+from qnx_pipeline_state import PipelineState, STATE_RANK
+from qnx_record_store import JSONLRecordStore
+from core.rate_limit import AdaptiveRateLimiter
 
 # Configure logging
 logging.basicConfig(level=logging.INFO, format='%(asctime)s - %(levelname)s - %(message)s')
 logger = logging.getLogger(__name__)
 
+# Input and output state of every step after discovery
+STEP_STATES = {
+    "crawl": ("discovered", "crawled"),
+    "extract": ("crawled", "extracted"),
+    "gdb": ("extracted", "enhanced"),
+    "vectorize": ("enhanced", "embedded"),
+    "store": ("embedded", "stored")
+}
+
 @dataclass
 class ProcessingStep:
     """Processing step configuration"""
@@ -53,11 +66,18 @@ class QNXStepProcessor:
             "discover": ProcessingStep("discover", True, "Discover QNX functions from documentation"),
             "crawl": ProcessingStep("crawl", True, "Crawl function documentation"),
             "extract": ProcessingStep("extract", True, "Extract JSON data with OpenAI"),
+            "gdb": ProcessingStep("gdb", True, "GDB type enhancement"),
             "vectorize": ProcessingStep("vectorize", True, "Vectorize function names"),
-            "store": ProcessingStep("store", True, "Store to vector database"),
-            "gdb": ProcessingStep("gdb", True, "GDB type enhancement (async)")
+            "store": ProcessingStep("store", True, "Store to vector database")
         }
         
+        # Per-function state shared by every step, and by every process running the pipeline
+        self.state = PipelineState.from_config(self.config)
+        state_config = self.config.get("processing_settings", {}).get("state", {})
+        self.batch_size = state_config.get("batch_size", 20)
+        self.store_batch_size = state_config.get("store_batch_size", 500)
+        self.results = JSONLRecordStore(str(self.output_dir / "qnx_functions_processed.jsonl"))
+        
         # Initialize components (lazy loading)
         self.crawler = None
         self.json_extractor = None
@@ -97,6 +117,8 @@ class QNXStepProcessor:
             else:
                 # Use OpenAI extractor as fallback
                 self.json_extractor = OpenAIJSONExtractor(self.config_path, enable_gdb_in_extraction=enable_gdb)
+            # Requests are paced by the API's answers instead of fixed sleeps
+            self.json_extractor.rate_limiter = AdaptiveRateLimiter.from_config(self.config)
         return self.json_extractor
     
     def _init_vectorizer(self):
@@ -118,333 +140,272 @@ class QNXStepProcessor:
                 self.steps[step_name].enabled = enabled
                 logger.info(f"Step '{step_name}': {'enabled' if enabled else 'disabled'}")
     
-    def check_existing_data(self) -> Dict[str, Any]:
-        """Check what data already exists"""
-        status = {
-            "discovered_functions": None,
-            "crawled_functions": None,
-            "extracted_functions": None,
-            "cache_exists": False,
-            "processed_count": 0
-        }
-        
-        # Check cache directory
-        if self.cache_dir.exists():
-            cache_files = list(self.cache_dir.glob("*.html"))
-            status["cache_exists"] = len(cache_files) > 0
-            logger.info(f"Found {len(cache_files)} cached HTML files")
-        
-        # Check if we have discovered functions list
+    def _import_legacy_data(self):
+        """Seed an empty state database from the discovered/extracted files of earlier runs"""
+        if self.state.names():
+            return
+        extracted_file = self.output_dir / "extracted_functions.json"
+        if extracted_file.exists():
+            try:
+                with open(extracted_file, 'r', encoding='utf-8') as f:
+                    extracted = json.load(f)
+                self.state.add(list(extracted), "extracted", extracted)
+                logger.info(f"Imported {len(extracted)} extracted functions from {extracted_file}")
+            except Exception as e:
+                logger.warning(f"Failed to load existing extracted data: {e}")
         discovered_file = self.output_dir / "discovered_functions.json"
         if discovered_file.exists():
             try:
                 with open(discovered_file, 'r', encoding='utf-8') as f:
-                    status["discovered_functions"] = json.load(f)
-                logger.info(f"Found {len(status['discovered_functions'])} discovered functions")
+                    added = self.state.add(json.load(f))
+                logger.info(f"Imported {added} discovered functions from {discovered_file}")
             except Exception as e:
                 logger.warning(f"Failed to load discovered functions: {e}")
-        
-        # If no discovered functions found, check cache directory for all cached functions
-        if status["discovered_functions"] is None and status["cache_exists"]:
+    
+    def _fallback_function_names(self) -> List[str]:
+        """Function names of the cached pages, or of qnx_structure_analysis.json"""
+        cached_functions = self._init_crawler().get_cached_functions()
+        if cached_functions:
+            logger.info(f"Found {len(cached_functions)} functions from cache directory")
+            return list(cached_functions)
+        
+        analysis_file = Path(self.config_path).parent / "data" / "qnx_structure_analysis.json"
+        if analysis_file.exists():
             try:
-                # Extract function names from cached HTML files
-                cache_files = list(self.cache_dir.glob("*.html"))
-                discovered_functions = []
+                with open(analysis_file, 'r', encoding='utf-8') as f:
+                    analysis_data = json.load(f)
                 
-                for cache_file in cache_files:
-                    func_name = cache_file.stem  # Get filename without extension
-                    discovered_functions.append(func_name)
+                # Extract function names from url_patterns
+                discovered_functions = []
+                url_patterns = analysis_data.get("url_patterns", {})
+                for letter_group in url_patterns.values():
+                    for func_info in letter_group:
+                        if "function_name" in func_info:
+                            discovered_functions.append(func_info["function_name"])
                 
-                if discovered_functions:
-                    status["discovered_functions"] = discovered_functions
-                    logger.info(f"Found {len(discovered_functions)} functions from cache directory")
+                logger.info(f"Found {len(discovered_functions)} functions from qnx_structure_analysis.json (fallback)")
+                return discovered_functions
             except Exception as e:
-                logger.warning(f"Failed to extract functions from cache directory: {e}")
-        
-        # Fallback: check qnx_structure_analysis.json
-        if status["discovered_functions"] is None:
-            analysis_file = Path(self.config_path).parent / "data" / "qnx_structure_analysis.json"
-            if analysis_file.exists():
-                try:
-                    with open(analysis_file, 'r', encoding='utf-8') as f:
-                        analysis_data = json.load(f)
-                    
-                    # Extract function names from url_patterns
-                    discovered_functions = []
-                    url_patterns = analysis_data.get("url_patterns", {})
-                    for letter_group in url_patterns.values():
-                        for func_info in letter_group:
-                            if "function_name" in func_info:
-                                discovered_functions.append(func_info["function_name"])
-                    
-                    if discovered_functions:
-                        status["discovered_functions"] = discovered_functions
-                        logger.info(f"Found {len(discovered_functions)} functions from qnx_structure_analysis.json (fallback)")
-                except Exception as e:
-                    logger.warning(f"Failed to load qnx_structure_analysis.json: {e}")
+                logger.warning(f"Failed to load qnx_structure_analysis.json: {e}")
+        return []
+    
+    def check_existing_data(self) -> Dict[str, Any]:
+        """Check what data already exists: cached pages and functions per pipeline state"""
+        self._import_legacy_data()
         
-        # Check if we have crawled functions
-        crawled_file = self.output_dir / "crawled_functions.json"
-        if crawled_file.exists():
-            try:
-                with open(crawled_file, 'r', encoding='utf-8') as f:
-                    status["crawled_functions"] = json.load(f)
-                logger.info(f"Found {len(status['crawled_functions'])} crawled functions")
-            except Exception as e:
-                logger.warning(f"Failed to load crawled functions: {e}")
+        cached_functions = self._init_crawler().get_cached_functions()
+        logger.info(f"Found {len(cached_functions)} cached functions")
         
-        # Check existing processed data
-        processed_file = self.output_dir / "qnx_functions_processed.json"
-        if processed_file.exists():
+        counts = self.state.counts()
+        status = {"cache_exists": len(cached_functions) > 0, "cached_functions": len(cached_functions)}
+        status.update(counts)
+        status["processed_count"] = counts["stored"]
+        return status
+    
+    def _run_step(self, step: str, work: Callable, selection: Optional[List[str]], batch_size: Optional[int] = None) -> int:
+        """Claim batches in the step's input state until none is left and advance what work() finished
+        
+        work(batch) returns (results, errors, embeddings) for the (name, data)
+        pairs of the batch; a name missing from both results and errors counts
+        as failed, so every claim ends in either an advance or an attempt.
+        """
+        input_state, output_state = STEP_STATES[step]
+        done = failed = 0
+        while True:
+            batch = self.state.claim(input_state, batch_size or self.batch_size, selection)
+            if not batch:
+                break
             try:
-                with open(processed_file, 'r', encoding='utf-8') as f:
-                    data = json.load(f)
-                status["extracted_functions"] = data
-                status["processed_count"] = len(data)
-                logger.info(f"Found {len(data)} already processed functions")
+                results, errors, embeddings = work(batch)
             except Exception as e:
-                logger.warning(f"Failed to load processed functions: {e}")
-        
-        return status
+                logger.error(f"Step '{step}' failed for a batch of {len(batch)} functions: {e}")
+                results, errors, embeddings = {}, {name: str(e) for name, _ in batch}, None
+            except BaseException:
+                # Interrupted: hand the batch back without counting an attempt
+                self.state.release([name for name, _ in batch])
+                raise
+            for name, _ in batch:
+                if name not in results and name not in errors:
+                    errors[name] = f"{step} produced no result"
+            self.state.advance(results, output_state, embeddings)
+            self.state.fail(errors)
+            done += len(results)
+            failed += len(errors)
+            logger.info(f"Step '{step}': {done} {output_state}, {failed} failed so far")
+        return done
+    
+    def _record_results(self, results: Dict[str, Dict[str, Any]], has_embedding: bool):
+        """Append finished functions to the JSONL result store"""
+        self.results.append({name: {"function_data": data, "has_embedding": has_embedding}
+                             for name, data in results.items() if data is not None})
     
     def step_discover(self, max_functions: Optional[int] = None) -> List[str]:
-        """Step 1: Discover QNX functions"""
+        """Step 1: Discover QNX functions (they enter the state database as discovered)"""
         logger.info("=== Step 1: Discovering QNX functions ===")
         
-        discovered_file = self.output_dir / "discovered_functions.json"
-        
-        # Check if already exists
-        if discovered_file.exists():
-            try:
-                with open(discovered_file, 'r', encoding='utf-8') as f:
-                    functions = json.load(f)
-                logger.info(f"Loaded {len(functions)} existing discovered functions")
-                if max_functions:
-                    functions = functions[:max_functions]
-                return functions
-            except Exception as e:
-                logger.warning(f"Failed to load existing discovered functions: {e}")
-        
-        # Discover new functions
-        crawler = self._init_crawler()
-        functions = crawler.discover_functions_from_index()
+        functions = self.state.names()
+        if functions:
+            logger.info(f"Loaded {len(functions)} existing discovered functions")
+        else:
+            # Discover new functions
+            functions = self._init_crawler().discover_functions_from_index()
+            self.state.add(functions)
+            logger.info(f"Discovered and saved {len(functions)} functions")
         
         if max_functions:
             functions = functions[:max_functions]
             logger.info(f"Limited to {max_functions} functions")
-        
-        # Save discovered functions
-        with open(discovered_file, 'w', encoding='utf-8') as f:
-            json.dump(functions, f, indent=2, ensure_ascii=False)
-        
-        logger.info(f"Discovered and saved {len(functions)} functions")
         return functions
     
-    def step_crawl(self, function_names: List[str]) -> List[QNXFunction]:
-        """Step 2: Crawl function documentation"""
+    def step_crawl(self, selection: Optional[List[str]]) -> int:
+        """Step 2: Crawl function documentation (discovered -> crawled)"""
         logger.info("=== Step 2: Crawling function documentation ===")
-        
-        crawled_file = self.output_dir / "crawled_functions.json"
-        
-        # Check if already exists
-        if crawled_file.exists():
-            try:
-                with open(crawled_file, 'r', encoding='utf-8') as f:
-                    data = json.load(f)
-                
-                # Convert back to QNXFunction objects
-                functions = []
-                for item in data:
-                    func = QNXFunction(
-                        name=item["name"],
-                        url=item["url"],
-                        html_content=item.get("html_content", "")
-                    )
-                    functions.append(func)
-                
-                logger.info(f"Loaded {len(functions)} existing crawled functions")
-                return functions
-            except Exception as e:
-                logger.warning(f"Failed to load existing crawled functions: {e}")
-        
-        # Crawl new functions
         crawler = self._init_crawler()
-        functions = crawler.crawl_functions(function_names)
         
-        # Save crawled functions
-        crawled_data = []
-        for func in functions:
-            crawled_data.append({
-                "name": func.name,
-                "url": func.url,
-                "html_content": func.html_content
-            })
-        
-        with open(crawled_file, 'w', encoding='utf-8') as f:
-            json.dump(crawled_data, f, indent=2, ensure_ascii=False)
+        def crawl(batch):
+            names = [name for name, _ in batch]
+            pages = {func.name: func for func in crawler.fetch_functions_batch(names)}
+            results, errors = {}, {}
+            for name in names:
+                func = pages.get(name)
+                if func is None:
+                    errors[name] = "page not found"
+                elif not crawler.validate_function_content(func):
+                    errors[name] = "invalid page content"
+                else:
+                    results[name] = None
+            return results, errors, None
         
-        logger.info(f"Crawled and saved {len(functions)} functions")
-        return functions
+        return self._run_step("crawl", crawl, selection)
     
-    def step_extract(self, functions: List[QNXFunction]) -> Dict[str, Dict[str, Any]]:
-        """Step 3: Extract JSON data one by one (no batch processing)"""
+    def promote_cached(self, selection: Optional[List[str]]) -> int:
+        """With the crawl step disabled: discovered functions whose page is cached count as crawled"""
+        cached = set(self._init_crawler().get_cached_functions())
+        wanted = set(selection) if selection is not None else None
+        names = [name for name in self.state.names("discovered")
+                 if name in cached and (wanted is None or name in wanted)]
+        self.state.advance({name: None for name in names}, "crawled")
+        logger.info(f"Using {len(names)} cached pages as crawled functions")
+        return len(names)
+    
+    def step_extract(self, selection: Optional[List[str]]) -> int:
+        """Step 3: Extract JSON data one by one (crawled -> extracted)"""
         logger.info("=== Step 3: Extracting JSON data ===")
-        
-        extracted_file = self.output_dir / "extracted_functions.json"
-        
-        # Check existing data
-        existing_data = {}
-        if extracted_file.exists():
-            try:
-                with open(extracted_file, 'r', encoding='utf-8') as f:
-                    existing_data = json.load(f)
-                logger.info(f"Loaded {len(existing_data)} existing extracted functions")
-            except Exception as e:
-                logger.warning(f"Failed to load existing extracted data: {e}")
-        
-        # Filter functions that need processing
-        functions_to_process = [f for f in functions if f.name not in existing_data]
-        logger.info(f"Need to process {len(functions_to_process)} new functions")
-        
-        if not functions_to_process:
-            logger.info("All functions already extracted")
-            return existing_data
-        
-        # Initialize extractor
+        crawler = self._init_crawler()
         extractor = self._init_json_extractor()
-        
-        # Process one by one to avoid connection issues
-        extracted_data = existing_data.copy()
-        
-        for i, func in enumerate(functions_to_process, 1):
-            try:
-                logger.info(f"Extracting {i}/{len(functions_to_process)}: {func.name}")
-                function_info = extractor.extract_function_info(func.html_content, func.name)
-                
+        from qnx_batch_processor import serialize_function_info
+        
+        def extract(batch):
+            results, errors = {}, {}
+            for name, _ in batch:
+                # A cached page comes back without a request
+                func = crawler.fetch_function_page(name)
+                if func is None:
+                    errors[name] = "page not available"
+                    continue
+                try:
+                    function_info = extractor.extract_function_info(func.html_content, name)
+                except Exception as e:
+                    logger.error(f"Error extracting {name}: {e}")
+                    errors[name] = str(e)
+                    continue
                 if function_info:
                     # Convert to serializable format
-                    from qnx_batch_processor import serialize_function_info
-                    extracted_data[func.name] = serialize_function_info(function_info)
-                    logger.info(f"✓ Extracted: {func.name}")
+                    results[name] = serialize_function_info(function_info)
+                    logger.info(f"✓ Extracted: {name}")
                 else:
-                    logger.warning(f"✗ Failed to extract: {func.name}")
-                
-                # Save progress after each function
-                with open(extracted_file, 'w', encoding='utf-8') as f:
-                    json.dump(extracted_data, f, indent=2, ensure_ascii=False)
-                logger.info(f"Saved progress: {len(extracted_data)} functions extracted")
-                
-                # Add delay between functions to avoid API rate limits
-                if i < len(functions_to_process):  # Don't delay after last function
-                    import random
-                    delay = random.uniform(1.0, 3.0)  # Reduced delay: 1-3 seconds (Claude is fast!)
-                    logger.info(f"Waiting {delay:.1f}s before next function...")
-                    time.sleep(delay)
-                        
-            except Exception as e:
-                logger.error(f"Error extracting {func.name}: {e}")
-                # Continue with next function even if one fails
-                continue
+                    logger.warning(f"✗ Failed to extract: {name}")
+                    errors[name] = "extraction failed"
+            return results, errors, None
         
-        logger.info(f"Extraction complete: {len(extracted_data)} total functions")
-        return extracted_data
+        return self._run_step("extract", extract, selection)
     
-    def step_vectorize(self, function_names: List[str]) -> Dict[str, List[float]]:
-        """Step 4: Vectorize function names"""
-        logger.info("=== Step 4: Vectorizing function names ===")
-        
+    def step_gdb_enhance(self, selection: Optional[List[str]]) -> int:
+        """Step 4: GDB type enhancement (extracted -> enhanced; passes data through when disabled)"""
+        logger.info("=== Step 4: GDB type enhancement ===")
+        enhancer = self._init_gdb_enhancer() if self.steps["gdb"].enabled else None
+        
+        def enhance(batch):
+            results = {}
+            for name, func_data in batch:
+                func_data = func_data or {}
+                if enhancer and func_data.get('parameters'):
+                    try:
+                        func_data['parameters'] = enhancer.enhance_function_parameters(func_data['parameters'])
+                        logger.info(f"✓ Enhanced: {name}")
+                    except Exception as e:
+                        logger.error(f"GDB enhancement failed for {name}: {e}")  # Keep original data
+                results[name] = func_data
+            self._record_results(results, has_embedding=False)
+            return results, {}, None
+        
+        return self._run_step("gdb", enhance, selection)
+    
+    def step_vectorize(self, selection: Optional[List[str]]) -> int:
+        """Step 5: Vectorize function names (enhanced -> embedded)"""
+        logger.info("=== Step 5: Vectorizing function names ===")
         vectorizer = self._init_vectorizer()
         
-        # Create vectorization tasks
-        tasks = []
-        for func_name in function_names:
-            task = VectorizeTask(
-                text=func_name,
-                doc_id=func_name,
-                metadata={"function_name": func_name, "type": "function_name"}
-            )
-            tasks.append(task)
-        
-        # Execute batch vectorization
-        results = vectorizer.get_batch_embeddings(tasks)
-        
-        # Process results
-        embeddings = {}
-        for result in results:
-            if result.success:
-                embeddings[result.doc_id] = result.embedding
+        def vectorize(batch):
+            tasks = [VectorizeTask(text=name, doc_id=name, metadata={"function_name": name, "type": "function_name"})
+                     for name, _ in batch]
+            results, errors, embeddings = {}, {}, {}
+            for result in vectorizer.get_batch_embeddings(tasks):
+                if result.success:
+                    results[result.doc_id] = None
+                    embeddings[result.doc_id] = result.embedding
+                else:
+                    errors[result.doc_id] = result.error or "embedding failed"
+            return results, errors, embeddings
         
-        logger.info(f"Vectorized {len(embeddings)} function names")
-        return embeddings
+        return self._run_step("vectorize", vectorize, selection)
     
-    def step_store(self, json_data: Dict[str, Dict[str, Any]], embeddings: Dict[str, List[float]]) -> bool:
-        """Step 5: Store to vector database"""
-        logger.info("=== Step 5: Storing to vector database ===")
-        
+    def step_store(self, selection: Optional[List[str]]) -> int:
+        """Step 6: Store to vector database (embedded -> stored)"""
+        logger.info("=== Step 6: Storing to vector database ===")
         vectorizer = self._init_vectorizer()
         
-        # Prepare storage data
-        results = []
-        documents = []
-        metadatas = []
-        
-        for func_name in json_data.keys():
-            if func_name in embeddings:
-                result = VectorizeResult(
-                    doc_id=func_name,
-                    embedding=embeddings[func_name],
-                    success=True,
-                    provider="hybrid"
-                )
-                results.append(result)
-                
-                documents.append(json.dumps(json_data[func_name], ensure_ascii=False))
-                
-                metadatas.append({
-                    "function_name": func_name,
+        def store(batch):
+            names = [name for name, _ in batch]
+            items = self.state.items("embedded", names)
+            embeddings = {name: item["embedding"] for name, item in items.items() if item["embedding"]}
+            tasks, documents, results, errors = [], [], {}, {}
+            for name, func_data in batch:
+                if name not in embeddings:
+                    errors[name] = "no embedding"
+                    continue
+                tasks.append(VectorizeTask(text=name, doc_id=name, metadata={
+                    "function_name": name,
                     "type": "qnx_function",
-                    "category": func_name[0].lower()
-                })
-        
-        if results:
-            success = vectorizer.store_vectors(results, documents, metadatas)
-            if success:
-                logger.info(f"Successfully stored {len(results)} functions to vector database")
-                return True
-            else:
-                logger.error("Failed to store to vector database")
-                return False
-        else:
-            logger.warning("No valid data to store")
-            return False
+                    "category": name[0].lower()
+                }))
+                documents.append(json.dumps(func_data or {}, ensure_ascii=False))
+                results[name] = func_data
+            if tasks:
+                stats = vectorizer.sync_vectors(tasks, documents, embeddings=embeddings)
+                if stats["failed"]:
+                    raise RuntimeError(f"{stats['failed']} functions could not be stored")
+            self._record_results(results, has_embedding=True)
+            return results, errors, None
+        
+        return self._run_step("store", store, selection, self.store_batch_size)
     
-    def step_gdb_enhance(self, json_data: Dict[str, Dict[str, Any]]) -> Dict[str, Dict[str, Any]]:
-        """Step 6: GDB type enhancement"""
-        logger.info("=== Step 6: GDB type enhancement ===")
-        
-        enhancer = self._init_gdb_enhancer()
-        enhanced_data = {}
-        
-        for func_name, func_data in json_data.items():
-            try:
-                logger.info(f"Enhancing: {func_name}")
-                
-                if 'parameters' in func_data:
-                    enhanced_params = enhancer.enhance_function_parameters(func_data['parameters'])
-                    func_data['parameters'] = enhanced_params
-                
-                enhanced_data[func_name] = func_data
-                logger.info(f"✓ Enhanced: {func_name}")
-                
-            except Exception as e:
-                logger.error(f"GDB enhancement failed for {func_name}: {e}")
-                enhanced_data[func_name] = func_data  # Keep original data
-        
-        logger.info(f"GDB enhancement complete: {len(enhanced_data)} functions")
-        return enhanced_data
+    def _export_extracted(self):
+        """extracted_functions.json for the standalone enhancer and vectorizer, written once per run"""
+        extracted = {name: item["data"] for name, item in self.state.items("extracted").items() if item["data"]}
+        extracted_file = self.output_dir / "extracted_functions.json"
+        tmp_file = extracted_file.with_suffix('.json.tmp')
+        with open(tmp_file, 'w', encoding='utf-8') as f:
+            json.dump(extracted, f, indent=2, ensure_ascii=False)
+        os.replace(tmp_file, extracted_file)
     
     def process(self, function_names: Optional[List[str]] = None, max_functions: Optional[int] = None) -> Dict[str, Any]:
-        """Execute the configured processing pipeline"""
+        """Execute the configured processing pipeline
+        
+        Every step works only on the functions in its input state, so a rerun
+        continues where the last one stopped, and several processes running
+        this at once split the work between them.
+        """
         logger.info("=" * 60)
         logger.info("Starting QNX Step-by-Step Processing")
         logger.info("=" * 60)
@@ -453,131 +414,78 @@ class QNXStepProcessor:
         enabled_steps = [name for name, step in self.steps.items() if step.enabled]
         logger.info(f"Enabled steps: {', '.join(enabled_steps)}")
         
-        # Check existing data
-        existing_data = self.check_existing_data()
+        self._import_legacy_data()
         
         start_time = time.time()
         result = {"success": True, "steps_completed": [], "errors": []}
         
         try:
             # Step 1: Discover
-            if self.steps["discover"].enabled:
-                if function_names:
-                    discovered_functions = function_names
-                    logger.info(f"Using provided function list: {len(discovered_functions)} functions")
-                else:
-                    discovered_functions = self.step_discover(max_functions)
-                result["steps_completed"].append("discover")
+            selection = None
+            if function_names:
+                self.state.add(function_names)
+                selection = list(function_names)
+                logger.info(f"Using provided function list: {len(selection)} functions")
             else:
-                if existing_data["discovered_functions"]:
-                    discovered_functions = existing_data["discovered_functions"]
+                if self.steps["discover"].enabled:
+                    discovered_functions = self.step_discover(max_functions)
+                    result["steps_completed"].append("discover")
+                else:
+                    discovered_functions = self.state.names()
+                    if not discovered_functions:
+                        discovered_functions = self._fallback_function_names()
+                        self.state.add(discovered_functions)
+                    if not discovered_functions:
+                        raise ValueError("Discovery step disabled but no existing discovered functions found")
                     if max_functions:
                         discovered_functions = discovered_functions[:max_functions]
                     logger.info(f"Using existing discovered functions: {len(discovered_functions)}")
-                else:
-                    raise ValueError("Discovery step disabled but no existing discovered functions found")
+                if max_functions:
+                    selection = discovered_functions
             
-            # Step 2: Crawl
+            # Steps 2-6, each on the functions the previous one left in its input state
             if self.steps["crawl"].enabled:
-                crawled_functions = self.step_crawl(discovered_functions)
+                self.step_crawl(selection)
                 result["steps_completed"].append("crawl")
             else:
-                if existing_data["crawled_functions"]:
-                    # Filter by discovered_functions
-                    discovered_set = set(discovered_functions)
-                    crawled_functions = [f for f in existing_data["crawled_functions"] 
-                                       if f["name"] in discovered_set]
-                    logger.info(f"Using existing crawled functions: {len(crawled_functions)}")
-                elif existing_data["cache_exists"]:
-                    # Build crawled functions from cache files
-                    logger.info("Building crawled functions from cache files...")
-                    crawled_functions = []
-                    discovered_set = set(discovered_functions)
-                    
-                    for func_name in discovered_functions:
-                        cache_file = self.cache_dir / f"{func_name}.html"
-                        if cache_file.exists():
-                            try:
-                                with open(cache_file, 'r', encoding='utf-8') as f:
-                                    html_content = f.read()
-                                
-                                # Create QNXFunction object
-                                func = QNXFunction(
-                                    name=func_name,
-                                    url=f"https://www.qnx.com/developers/docs/7.1/com.qnx.doc.neutrino.lib_ref/topic/x/{func_name}.html",
-                                    html_content=html_content
-                                )
-                                crawled_functions.append(func)
-                            except Exception as e:
-                                logger.warning(f"Failed to load cached HTML for {func_name}: {e}")
-                    
-                    logger.info(f"Built {len(crawled_functions)} crawled functions from cache")
-                else:
-                    raise ValueError("Crawl step disabled but no existing crawled functions or cache found")
+                self.promote_cached(selection)
             
-            # Step 3: Extract
             if self.steps["extract"].enabled:
-                if isinstance(crawled_functions[0], dict):
-                    # Convert from dict to QNXFunction
-                    func_objects = []
-                    for item in crawled_functions:
-                        func = QNXFunction(
-                            name=item["name"],
-                            url=item["url"],
-                            html_content=item.get("html_content", "")
-                        )
-                        func_objects.append(func)
-                    crawled_functions = func_objects
-                
-                extracted_data = self.step_extract(crawled_functions)
+                self.step_extract(selection)
                 result["steps_completed"].append("extract")
-            else:
-                if existing_data["extracted_functions"]:
-                    extracted_data = existing_data["extracted_functions"]
-                    # Filter by discovered functions
-                    discovered_set = set(discovered_functions)
-                    extracted_data = {k: v for k, v in extracted_data.items() if k in discovered_set}
-                    logger.info(f"Using existing extracted functions: {len(extracted_data)}")
-                else:
-                    raise ValueError("Extract step disabled but no existing extracted functions found")
             
-            # Step 4: Vectorize
+            self.step_gdb_enhance(selection)
+            if self.steps["gdb"].enabled:
+                result["steps_completed"].append("gdb")
+            
             if self.steps["vectorize"].enabled:
-                embeddings = self.step_vectorize(list(extracted_data.keys()))
+                self.step_vectorize(selection)
                 result["steps_completed"].append("vectorize")
-            else:
-                embeddings = {}
-                logger.info("Vectorize step disabled, using empty embeddings")
             
-            # Step 5: Store
-            if self.steps["store"].enabled and embeddings:
-                store_success = self.step_store(extracted_data, embeddings)
-                if store_success:
-                    result["steps_completed"].append("store")
-                else:
-                    result["errors"].append("Failed to store to vector database")
+            if self.steps["store"].enabled:
+                self.step_store(selection)
+                result["steps_completed"].append("store")
             
-            # Step 6: GDB Enhancement
-            if self.steps["gdb"].enabled:
-                enhanced_data = self.step_gdb_enhance(extracted_data)
-                result["steps_completed"].append("gdb")
-            else:
-                enhanced_data = extracted_data
-                logger.info("GDB step disabled, using original data")
+            self.results.compact()
+            self._export_extracted()
             
-            # Save final results
-            final_output = self.output_dir / "qnx_functions_processed.json"
-            with open(final_output, 'w', encoding='utf-8') as f:
-                json.dump(enhanced_data, f, indent=2, ensure_ascii=False)
+            counts = self.state.counts()
+            if counts["failed"]:
+                result["errors"].append(f"{counts['failed']} functions failed {self.state.max_attempts} times "
+                                        f"(rerun with --retry-failed)")
+            selected = self.state.items("discovered", selection)
             
             # Processing summary
             processing_time = time.time() - start_time
             result.update({
-                "total_functions": len(discovered_functions),
-                "extracted_functions": len(extracted_data),
-                "vectorized_functions": len(embeddings),
+                "total_functions": len(selected),
+                "extracted_functions": sum(1 for item in selected.values()
+                                           if STATE_RANK[item["state"]] >= STATE_RANK["extracted"]),
+                "vectorized_functions": sum(1 for item in selected.values()
+                                            if STATE_RANK[item["state"]] >= STATE_RANK["embedded"]),
+                "states": counts,
                 "processing_time": processing_time,
-                "output_file": str(final_output)
+                "output_file": str(self.results.path)
             })
             
             logger.info("=" * 60)
@@ -585,10 +493,11 @@ class QNXStepProcessor:
             logger.info(f"Total functions: {result['total_functions']}")
             logger.info(f"Extracted: {result['extracted_functions']}")
             logger.info(f"Vectorized: {result['vectorized_functions']}")
+            logger.info(f"States: {', '.join(f'{k}={v}' for k, v in counts.items())}")
             logger.info(f"Steps completed: {', '.join(result['steps_completed'])}")
             logger.info(f"Processing time: {processing_time:.2f}s")
             logger.info("=" * 60)
-            
+        
         except Exception as e:
             result["success"] = False
             result["error"] = str(e)
@@ -614,12 +523,18 @@ def main():
     
     # Other options
     parser.add_argument("--check-data", action="store_true", help="Check existing data and exit")
+    parser.add_argument("--retry-failed", action="store_true", help="Retry functions that ran out of attempts")
+    parser.add_argument("--batch-size", type=int, help="Functions claimed per batch (default: processing_settings.state.batch_size)")
     parser.add_argument("--config", default="config.json", help="Configuration file path")
     
     args = parser.parse_args()
     
     # Initialize processor
     processor = QNXStepProcessor(args.config)
+    if args.batch_size:
+        processor.batch_size = args.batch_size
+    if args.retry_failed:
+        logger.info(f"Reset {processor.state.reset_failed()} failed functions")
     
     # Configure steps
     processor.configure_steps(
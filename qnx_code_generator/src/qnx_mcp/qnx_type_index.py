@@ -0,0 +1,411 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+QNX Type Index
+Offline index of the struct, union, enum and typedef layouts in the DWARF
+of the QNX libraries, used instead of asking GDB for every type
+"""
+
+import os
+import sys
+import glob
+import json
+import logging
+import sqlite3
+import time
+from concurrent.futures import ProcessPoolExecutor, as_completed
+from pathlib import Path
+from typing import Any, Dict, List, Optional, Tuple
+
+try:
+    from elftools.elf.elffile import ELFFile
+except ImportError:
+    ELFFile = None
+
+logger = logging.getLogger(__name__)
+
+# Tags indexed under their own name ("struct stat", "enum sigev_notify", "size_t", ...)
+RECORD_TAGS = {
+    'DW_TAG_structure_type': 'struct',
+    'DW_TAG_union_type': 'union',
+    'DW_TAG_enumeration_type': 'enum',
+    'DW_TAG_typedef': 'typedef',
+    'DW_TAG_base_type': 'base',
+}
+DW_OP_PLUS_UCONST = 0x23
+
+def _attr(die, name, default=None):
+    attr = die.attributes.get(name)
+    if attr is None:
+        return default
+    value = attr.value
+    return value.decode('utf-8', 'replace') if isinstance(value, bytes) else value
+
+def _uleb128(data: List[int]) -> int:
+    result = shift = 0
+    for byte in data:
+        result |= (byte & 0x7f) << shift
+        shift += 7
+        if not byte & 0x80:
+            break
+    return result
+
+def _member_offset(die) -> Optional[int]:
+    location = _attr(die, 'DW_AT_data_member_location')
+    if location is None:
+        # Union members and bitfields given by bit offset
+        bit_offset = _attr(die, 'DW_AT_data_bit_offset')
+        return bit_offset // 8 if bit_offset is not None else (0 if die.get_parent().tag == 'DW_TAG_union_type' else None)
+    if isinstance(location, int):
+        return location
+    # DWARF 2/3 location expression: DW_OP_plus_uconst <uleb128>
+    if location and location[0] == DW_OP_PLUS_UCONST:
+        return _uleb128(location[1:])
+    return None
+
+class _DieDescriber:
+    """C spellings and sizes of DWARF type DIEs within one compilation unit"""
+
+    def __init__(self):
+        self.names = {}
+
+    def _target(self, die):
+        if 'DW_AT_type' not in die.attributes:
+            return None
+        return die.get_DIE_from_attribute('DW_AT_type')
+
+    def type_name(self, die) -> str:
+        """'const char *', 'struct stat', 'int (*)(void *)', ..."""
+        if die is None:
+            return 'void'
+        key = die.offset
+        if key not in self.names:
+            self.names[key] = self.declare(die, '')
+        return self.names[key]
+
+    def declare(self, die, inner: str) -> str:
+        """C declaration of inner (a declarator, '' for the bare type) with type die"""
+        if die is None:
+            return f"void {inner}".strip()
+        tag = die.tag
+        if tag == 'DW_TAG_pointer_type':
+            target = self._target(die)
+            if target is not None and target.tag in ('DW_TAG_subroutine_type', 'DW_TAG_array_type'):
+                return self.declare(target, f"(*{inner})")
+            return self.declare(target, f"*{inner}")
+        if tag in ('DW_TAG_const_type', 'DW_TAG_volatile_type', 'DW_TAG_restrict_type'):
+            qualifier = {'DW_TAG_const_type': 'const', 'DW_TAG_volatile_type': 'volatile',
+                         'DW_TAG_restrict_type': 'restrict'}[tag]
+            target = self._target(die)
+            if target is not None and target.tag == 'DW_TAG_pointer_type':
+                return self.declare(target, f"{qualifier} {inner}".strip())
+            return f"{qualifier} {self.declare(target, inner)}"
+        if tag == 'DW_TAG_array_type':
+            dims = ''
+            for sub in die.iter_children():
+                if sub.tag != 'DW_TAG_subrange_type':
+                    continue
+                count = _attr(sub, 'DW_AT_count')
+                upper = _attr(sub, 'DW_AT_upper_bound')
+                if count is None and isinstance(upper, int):
+                    count = upper + 1
+                dims += f"[{count}]" if isinstance(count, int) else "[]"
+            return self.declare(self._target(die), f"{inner}{dims or '[]'}")
+        if tag == 'DW_TAG_subroutine_type':
+            params = []
+            for sub in die.iter_children():
+                if sub.tag == 'DW_TAG_formal_parameter':
+                    params.append(self.type_name(self._target(sub)))
+                elif sub.tag == 'DW_TAG_unspecified_parameters':
+                    params.append('...')
+            if not params and _attr(die, 'DW_AT_prototyped'):
+                params = ['void']
+            return self.declare(self._target(die), f"{inner}({', '.join(params)})")
+        name = _attr(die, 'DW_AT_name')
+        if tag in ('DW_TAG_structure_type', 'DW_TAG_union_type', 'DW_TAG_enumeration_type'):
+            name = f"{RECORD_TAGS[tag]} {name}" if name else f"{RECORD_TAGS[tag]} {{...}}"
+        return f"{name or '?'} {inner}".strip()
+
+    def byte_size(self, die) -> Optional[int]:
+        """Size of a type, following typedefs and qualifiers"""
+        seen = 0
+        while die is not None and seen < 32:
+            size = _attr(die, 'DW_AT_byte_size')
+            if size is not None:
+                if die.tag == 'DW_TAG_array_type':
+                    break
+                return size
+            if die.tag == 'DW_TAG_pointer_type':
+                return die.cu['address_size']
+            if die.tag == 'DW_TAG_array_type':
+                break
+            die = self._target(die)
+            seen += 1
+        if die is not None and die.tag == 'DW_TAG_array_type':
+            count = 1
+            for sub in die.iter_children():
+                if sub.tag == 'DW_TAG_subrange_type':
+                    n = _attr(sub, 'DW_AT_count')
+                    upper = _attr(sub, 'DW_AT_upper_bound')
+                    if n is None and isinstance(upper, int):
+                        n = upper + 1
+                    if not isinstance(n, int):
+                        return None
+                    count *= n
+            elem = self.byte_size(self._target(die))
+            return elem * count if elem is not None else None
+        return None
+
+    def record(self, die) -> Optional[Dict[str, Any]]:
+        """Index record of a named type, or None for declarations and anonymous types"""
+        kind = RECORD_TAGS[die.tag]
+        name = _attr(die, 'DW_AT_name')
+        if not name or _attr(die, 'DW_AT_declaration'):
+            return None
+        body = die
+        if kind == 'typedef':
+            body = self._target(die)
+            # Resolve typedef chains down to the type that has a body
+            while body is not None and body.tag == 'DW_TAG_typedef':
+                body = self._target(body)
+        record = {
+            "name": name if kind in ('typedef', 'base') else f"{kind} {name}",
+            "kind": kind,
+            "size": self.byte_size(die),
+            "target": self.type_name(self._target(die)) if kind == 'typedef' else None,
+            "fields": [],
+        }
+        body_tag = body.tag if body is not None else None
+        if body_tag in ('DW_TAG_structure_type', 'DW_TAG_union_type') and not _attr(body, 'DW_AT_declaration'):
+            for member in body.iter_children():
+                if member.tag != 'DW_TAG_member':
+                    continue
+                member_type = self._target(member)
+                member_name = _attr(member, 'DW_AT_name') or ''
+                field = {
+                    "name": member_name,
+                    "type": self.type_name(member_type),
+                    "declaration": self.declare(member_type, member_name),
+                    "offset": _member_offset(member),
+                    "size": self.byte_size(member_type),
+                }
+                bit_size = _attr(member, 'DW_AT_bit_size')
+                if bit_size is not None:
+                    field["bit_size"] = bit_size
+                record["fields"].append(field)
+        elif body_tag == 'DW_TAG_enumeration_type':
+            for value in body.iter_children():
+                if value.tag == 'DW_TAG_enumerator':
+                    record["fields"].append({"name": _attr(value, 'DW_AT_name'),
+                                             "value": _attr(value, 'DW_AT_const_value')})
+        record["definition"] = self._ptype(record, body)
+        return record
+
+    def _ptype(self, record: Dict[str, Any], body) -> str:
+        """The record in the form of GDB's ptype output"""
+        if body is None:
+            return "type = void"
+        if body.tag in ('DW_TAG_structure_type', 'DW_TAG_union_type'):
+            lines = [f"type = {self.type_name(body).replace(' {...}', '')} {{"]
+            for field in record["fields"]:
+                bits = f" : {field['bit_size']}" if "bit_size" in field else ""
+                lines.append(f"    {field['declaration']}{bits};")
+            return '\n'.join(lines + ["}"])
+        if body.tag == 'DW_TAG_enumeration_type':
+            values = ', '.join(f"{f['name']}" if f['value'] is None else f"{f['name']} = {f['value']}"
+                               for f in record["fields"])
+            return f"type = {self.type_name(body).replace(' {...}', '')} {{{values}}}"
+        return f"type = {self.type_name(body)}"
+
+def index_library(path: str) -> Tuple[str, List[Dict[str, Any]]]:
+    """All named type records in the DWARF of one library (runs in a worker process)"""
+    records = []
+    with open(path, 'rb') as f:
+        elf = ELFFile(f)
+        if not elf.has_dwarf_info():
+            return path, records
+        for cu in elf.get_dwarf_info().iter_CUs():
+            describer = _DieDescriber()
+            for die in cu.get_top_DIE().iter_children():
+                if die.tag in RECORD_TAGS:
+                    record = describer.record(die)
+                    if record:
+                        record["source"] = path
+                        records.append(record)
+    return path, records
+
+class QNXTypeIndex:
+    """Type layouts in one SQLite database, looked up by name
+
+    Names are spelled the way GDB takes them: "struct stat", "union sigval",
+    "enum sigev", or the bare name of a typedef or base type. When several
+    libraries define a name, the first complete definition wins.
+    """
+
+    def __init__(self, db_path: str = "./data/qnx_type_index.db"):
+        self.db_path = Path(db_path)
+        self.db_path.parent.mkdir(parents=True, exist_ok=True)
+        conn = self._connect()
+        try:
+            conn.execute("PRAGMA journal_mode=WAL")
+            conn.execute('''
+                CREATE TABLE IF NOT EXISTS types (
+                    name TEXT PRIMARY KEY,
+                    kind TEXT NOT NULL,
+                    size INTEGER,
+                    target TEXT,
+                    definition TEXT,
+                    fields TEXT,
+                    source TEXT
+                )
+            ''')
+            conn.execute('''
+                CREATE TABLE IF NOT EXISTS libraries (
+                    path TEXT PRIMARY KEY,
+                    mtime REAL,
+                    types INTEGER
+                )
+            ''')
+            conn.commit()
+        finally:
+            conn.close()
+
+    @classmethod
+    def open(cls, db_path: str) -> Optional["QNXTypeIndex"]:
+        """The index at db_path if it has been built, else None"""
+        if not os.path.exists(db_path):
+            return None
+        index = cls(db_path)
+        return index if index.count() else None
+
+    def _connect(self) -> sqlite3.Connection:
+        return sqlite3.connect(str(self.db_path), timeout=30)
+
+    def get(self, name: str) -> Optional[Dict[str, Any]]:
+        """{'name', 'kind', 'size', 'target', 'definition', 'fields', 'source'} of a type"""
+        conn = self._connect()
+        try:
+            row = conn.execute('''
+                SELECT name, kind, size, target, definition, fields, source FROM types WHERE name = ?
+            ''', (' '.join(name.split()),)).fetchone()
+        finally:
+            conn.close()
+        if not row:
+            return None
+        keys = ("name", "kind", "size", "target", "definition", "fields", "source")
+        entry = dict(zip(keys, row))
+        entry["fields"] = json.loads(entry["fields"]) if entry["fields"] else []
+        return entry
+
+    def count(self) -> int:
+        conn = self._connect()
+        try:
+            return conn.execute("SELECT COUNT(*) FROM types").fetchone()[0]
+        finally:
+            conn.close()
+
+    def add_records(self, records: List[Dict[str, Any]]) -> int:
+        conn = self._connect()
+        try:
+            before = conn.total_changes
+            conn.executemany('''
+                INSERT OR IGNORE INTO types (name, kind, size, target, definition, fields, source)
+                VALUES (?, ?, ?, ?, ?, ?, ?)
+            ''', [(r["name"], r["kind"], r["size"], r["target"], r["definition"],
+                   json.dumps(r["fields"]), r.get("source")) for r in records])
+            conn.commit()
+            return conn.total_changes - before
+        finally:
+            conn.close()
+
+    def build(self, library_paths: List[str], max_workers: Optional[int] = None) -> int:
+        """Index the DWARF of the given libraries, skipping those unchanged since the last build"""
+        if ELFFile is None:
+            raise RuntimeError("pyelftools is required to build the type index (pip install pyelftools)")
+        conn = self._connect()
+        try:
+            indexed = dict(conn.execute("SELECT path, mtime FROM libraries"))
+        finally:
+            conn.close()
+        todo = [p for p in library_paths if indexed.get(p) != os.path.getmtime(p)]
+        logger.info(f"Indexing types of {len(todo)} libraries ({len(library_paths) - len(todo)} unchanged)")
+
+        added = 0
+        with ProcessPoolExecutor(max_workers=max_workers) as executor:
+            futures = {executor.submit(index_library, path): path for path in todo}
+            for future in as_completed(futures):
+                path = futures[future]
+                try:
+                    _, records = future.result()
+                except Exception as e:
+                    logger.warning(f"Failed to index {path}: {e}")
+                    continue
+                if path in indexed:
+                    # A rebuilt library replaces the types it defined
+                    conn = self._connect()
+                    try:
+                        conn.execute("DELETE FROM types WHERE source = ?", (path,))
+                        conn.commit()
+                    finally:
+                        conn.close()
+                count = self.add_records(records)
+                added += count
+                conn = self._connect()
+                try:
+                    conn.execute("INSERT OR REPLACE INTO libraries (path, mtime, types) VALUES (?, ?, ?)",
+                                 (path, os.path.getmtime(path), len(records)))
+                    conn.commit()
+                finally:
+                    conn.close()
+                logger.info(f"{os.path.basename(path)}: {len(records)} types, {count} new")
+        logger.info(f"Type index: {self.count()} types ({added} added)")
+        return added
+
+def default_libraries(config: Dict[str, Any]) -> List[str]:
+    """Shared objects under the symbol library paths of the preferred architecture"""
+    qnx_config = config.get("qnx_system", {})
+    paths = qnx_config.get("symbol_library_paths", [])
+    arch = qnx_config.get("preferred_architecture", "x86_64")
+    if os.environ.get("QNX_TARGET"):
+        paths = [os.path.join(os.environ["QNX_TARGET"], arch, "lib")] + paths
+    # Layouts differ between architectures: index only the preferred one when it is configured
+    arch_paths = [p for p in paths if f"/{arch}/" in p + "/"]
+    libraries = []
+    for path in dict.fromkeys(arch_paths or paths):
+        for lib in sorted(glob.glob(os.path.join(path, "*.so*"))):
+            if os.path.isfile(lib) and not os.path.islink(lib):
+                libraries.append(lib)
+    return libraries
+
+def main():
+    """Build the type index from the command line"""
+    import argparse
+
+    parser = argparse.ArgumentParser(description='Build the QNX type index from library DWARF')
+    parser.add_argument('libraries', nargs='*', help='Libraries to index (default: symbol_library_paths)')
+    parser.add_argument('--config', '-c', default='config.json', help='Configuration file path')
+    parser.add_argument('--db', help='Index database (default: qnx_system.type_index_path)')
+    parser.add_argument('--workers', '-w', type=int, help='Number of indexing processes')
+    args = parser.parse_args()
+
+    logging.basicConfig(level=logging.INFO, format='%(asctime)s - %(levelname)s - %(message)s')
+    try:
+        with open(args.config, 'r', encoding='utf-8') as f:
+            config = json.load(f)
+    except Exception as e:
+        logger.warning(f"Failed to load config file: {e}")
+        config = {}
+
+    db_path = args.db or config.get("qnx_system", {}).get("type_index_path", "./data/qnx_type_index.db")
+    libraries = args.libraries or default_libraries(config)
+    if not libraries:
+        logger.error("No libraries to index")
+        return 1
+
+    start = time.time()
+    QNXTypeIndex(db_path).build(libraries, args.workers)
+    logger.info(f"Done in {time.time() - start:.1f}s: {db_path}")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -11,18 +11,64 @@ import json
 import logging
 import time
 import hashlib
+import asyncio
+import fcntl
+import tempfile
 import requests
+import httpx
 from typing import Dict, List, Optional, Any, Tuple
 from pathlib import Path
 from urllib.parse import urljoin, urlparse
 from bs4 import BeautifulSoup
+from qnx_page_cache import QNXPageCache
 from dataclasses import dataclass
+from concurrent.futures import ProcessPoolExecutor, ThreadPoolExecutor
 import re
 
 # Configure logging
 logging.basicConfig(level=logging.INFO, format='%(asctime)s - %(levelname)s - %(message)s')
 logger = logging.getLogger(__name__)
 
+INDEX_LETTERS = 'abcdefghijklmnopqrstuvwxyz'
+INDEX_CACHE_VERSION = 1
+
+def parse_index_page(letter: str, page_url: str, html: str) -> Dict[str, List[str]]:
+    """Function name -> page URLs of one lib-<letter>.html index page
+
+    Top level so that a process pool can run it. The names come from the
+    "name(), name()" text of the related links, and from the DC.Relation
+    metadata and bare links to topic/<letter>/ pages, by their file name.
+    """
+    soup = BeautifulSoup(html, 'html.parser')
+    urls: Dict[str, List[str]] = {}
+
+    def add(name: str, url: str):
+        name = name.strip()
+        if name and re.match(r'^[A-Za-z_][A-Za-z0-9_]*$', name):
+            bucket = urls.setdefault(name, [])
+            if url not in bucket:
+                bucket.append(url)
+
+    def by_file(href: str):
+        name = href.split('/')[-1][:-len('.html')]
+        if name and name[0].lower() == letter:
+            add(name, urljoin(page_url, href))
+
+    for meta in soup.find_all('meta', {'name': 'DC.Relation'}):
+        content = meta.get('content', '')
+        if f'/topic/{letter}/' in content and content.endswith('.html'):
+            by_file(content)
+    for link in soup.find_all('a', href=True):
+        href, text = link['href'], link.get_text().strip()
+        if not href.endswith('.html'):
+            continue
+        if '()' in text:
+            for name in text.replace('()', '').split(','):
+                add(name, urljoin(page_url, href))
+        elif f'/{letter}/' in href:
+            by_file(href)
+    return urls
+
 @dataclass
 class QNXFunction:
     """QNX function information"""
@@ -30,6 +76,51 @@ class QNXFunction:
     url: str
     html_content: str
     category: str = ""
+
+try:
+    import h2  # noqa: F401
+    HTTP2_AVAILABLE = True
+except ImportError:
+    HTTP2_AVAILABLE = False
+
+class TokenBucket:
+    """Token bucket rate limiter shared by all crawler processes on the host
+    
+    The bucket state (tokens, timestamp) lives in a small file updated under
+    flock, so parallel batch/step processors together stay under one request
+    rate. Tokens may go negative: a caller reserves its slot and waits for it.
+    """
+    
+    def __init__(self, path: Path, rate: float, burst: int = 1):
+        self.path = path
+        self.rate = rate
+        self.burst = max(1, burst)
+    
+    def _reserve(self) -> float:
+        """Take one token, return seconds to wait until it is due"""
+        with open(self.path, 'a+') as f:
+            fcntl.flock(f, fcntl.LOCK_EX)
+            now = time.time()
+            f.seek(0)
+            try:
+                tokens, stamp = json.loads(f.read())
+            except ValueError:
+                tokens, stamp = self.burst, now
+            tokens = min(self.burst, tokens + max(0.0, now - stamp) * self.rate) - 1
+            f.seek(0)
+            f.truncate()
+            f.write(json.dumps([tokens, now]))
+        return -tokens / self.rate if tokens < 0 else 0.0
+    
+    def acquire(self):
+        wait = self._reserve()
+        if wait:
+            time.sleep(wait)
+    
+    async def acquire_async(self):
+        wait = self._reserve()
+        if wait:
+            await asyncio.sleep(wait)
     
 class QNXWebCrawler:
     """QNX official documentation web crawler"""
@@ -50,8 +141,8 @@ class QNXWebCrawler:
         
         # Proxy config
         proxy_config = self.config.get("network_settings", {}).get("proxy", {})
+        proxies = {}
         if proxy_config.get("enabled", False):
-            proxies = {}
             if proxy_config.get("http_proxy"):
                 proxies["http"] = proxy_config["http_proxy"]
             if proxy_config.get("https_proxy"):
@@ -65,13 +156,22 @@ class QNXWebCrawler:
         request_settings = self.config.get("network_settings", {}).get("request_settings", {})
         self.timeout = request_settings.get("timeout", 30)
         self.max_retries = request_settings.get("max_retries", 3)
+        self.retry_delay = request_settings.get("retry_delay", 1.0)
+        self.max_concurrency = request_settings.get("max_concurrency", 4)
+        self.index_ttl = request_settings.get("index_ttl_hours", 24) * 3600
+        self.proxy = proxies.get("https") or proxies.get("http")
         
         # Cache settings
         self.cache_dir = Path("./data/qnx_web_cache")
         self.cache_dir.mkdir(parents=True, exist_ok=True)
+        self.page_cache = QNXPageCache(self.cache_dir / "pages.db")
+        if self.page_cache.count() == 0:
+            self.page_cache.import_html_dir(self.cache_dir, self._page_url)
         
-        # Rate limiting
-        self.request_delay = 1.0  # 1 second delay to avoid being blocked
+        # Rate limiting, shared with the other crawler processes to avoid being blocked
+        self.rate_limiter = TokenBucket(
+            Path(tempfile.gettempdir()) / "qnx_web_crawler.bucket",
+            request_settings.get("requests_per_second", 1.0), request_settings.get("burst", 1))
         
         logger.info("QNX Web Crawler initialized")
         logger.info(f"Base URL: {self.base_url}")
@@ -152,154 +252,263 @@ class QNXWebCrawler:
         url = f"{self.base_url}#{self.lib_ref_base}{first_letter}/{function_name}.html"
         return url
     
-    def fetch_function_page(self, function_name: str) -> Optional[QNXFunction]:
-        """Fetch single function page"""
-        url = self.build_function_url(function_name)
+    def _page_url(self, function_name: str) -> str:
+        """Actual URL to fetch (without the #)"""
+        return f"{self.base_url}{self.lib_ref_base}{function_name[0].lower()}/{function_name}.html"
+    
+    def _make_function(self, function_name: str, html_content: str) -> QNXFunction:
+        return QNXFunction(
+            name=function_name,
+            url=self.build_function_url(function_name),
+            html_content=html_content,
+            category=function_name[0].lower()
+        )
+    
+    def _load_cached(self, function_name: str) -> Optional[Dict[str, Optional[str]]]:
+        try:
+            return self.page_cache.get(self._page_url(function_name))
+        except Exception as e:
+            logger.warning(f"Failed to load cache for {function_name}: {e}")
+            return None
+    
+    @staticmethod
+    def _conditional_headers(cached: Optional[Dict[str, Optional[str]]]) -> Dict[str, str]:
+        """If-None-Match / If-Modified-Since from the validators saved with the cached page"""
+        headers = {}
+        if cached and cached.get("etag"):
+            headers["If-None-Match"] = cached["etag"]
+        if cached and cached.get("last_modified"):
+            headers["If-Modified-Since"] = cached["last_modified"]
+        return headers
+    
+    def _store_page(self, function_name: str, html_content: str, headers) -> Optional[QNXFunction]:
+        """Validate a fetched page, cache it with its validators"""
+        # Validate content (contains function name)
+        if function_name.lower() not in html_content.lower():
+            logger.warning(f"Invalid content for {function_name}")
+            return None
+        try:
+            self.page_cache.put(self._page_url(function_name), function_name, html_content,
+                                headers.get("ETag"), headers.get("Last-Modified"))
+            logger.debug(f"Cached: {function_name}")
+        except Exception as e:
+            logger.warning(f"Failed to cache {function_name}: {e}")
+        return self._make_function(function_name, html_content)
+    
+    def fetch_function_page(self, function_name: str, refresh: bool = False) -> Optional[QNXFunction]:
+        """Fetch single function page
         
-        # Check cache
-        cache_file = self.cache_dir / f"{function_name}.html"
-        if cache_file.exists():
+        A cached page is returned without any request or delay. With refresh,
+        it is revalidated with a conditional request instead.
+        """
+        cached = self._load_cached(function_name)
+        if cached is not None and not refresh:
             logger.debug(f"Loading from cache: {function_name}")
-            try:
-                html_content = cache_file.read_text(encoding='utf-8')
-                return QNXFunction(
-                    name=function_name,
-                    url=url,
-                    html_content=html_content,
-                    category=function_name[0].lower()
-                )
-            except Exception as e:
-                logger.warning(f"Failed to load cache for {function_name}: {e}")
+            return self._make_function(function_name, cached["html"])
         
         # Fetch from network
+        headers = self._conditional_headers(cached)
         try:
-            logger.info(f"Fetching: {function_name} -> {url}")
-            
-            # Actual URL to fetch (remove #)
-            actual_url = f"{self.base_url}{self.lib_ref_base}{function_name[0].lower()}/{function_name}.html"
-            
-            response = self.session.get(actual_url, timeout=30)
+            logger.info(f"Fetching: {function_name} -> {self.build_function_url(function_name)}")
+            self.rate_limiter.acquire()
+            response = self.session.get(self._page_url(function_name), headers=headers, timeout=self.timeout)
+            if response.status_code == 304:
+                logger.debug(f"Not modified: {function_name}")
+                return self._make_function(function_name, cached["html"])
             response.raise_for_status()
-            
-            html_content = response.text
-            
-            # Validate content (contains function name)
-            if function_name.lower() in html_content.lower():
-                # Cache result
-                try:
-                    cache_file.write_text(html_content, encoding='utf-8')
-                    logger.debug(f"Cached: {function_name}")
-                except Exception as e:
-                    logger.warning(f"Failed to cache {function_name}: {e}")
-                
-                return QNXFunction(
-                    name=function_name,
-                    url=url,
-                    html_content=html_content,
-                    category=function_name[0].lower()
-                )
-            else:
-                logger.warning(f"Invalid content for {function_name}")
-                return None
-                
+            return self._store_page(function_name, response.text, response.headers)
         except requests.RequestException as e:
             logger.error(f"Failed to fetch {function_name}: {e}")
             return None
         except Exception as e:
             logger.error(f"Unexpected error fetching {function_name}: {e}")
             return None
-        finally:
-            # Rate limiting
-            time.sleep(self.request_delay)
     
-    def fetch_functions_batch(self, function_names: List[str]) -> List[QNXFunction]:
-        """Fetch function pages in batch"""
-        functions = []
+    def _async_client(self) -> httpx.AsyncClient:
+        """One client for the whole batch, so connections (HTTP/2 when h2 is installed) are reused"""
+        kwargs = dict(
+            http2=HTTP2_AVAILABLE,
+            timeout=self.timeout,
+            headers=dict(self.session.headers),
+            limits=httpx.Limits(max_connections=self.max_concurrency,
+                                max_keepalive_connections=self.max_concurrency),
+            follow_redirects=True,
+        )
+        if self.proxy:
+            try:
+                return httpx.AsyncClient(proxy=self.proxy, **kwargs)
+            except TypeError:
+                # httpx < 0.26
+                return httpx.AsyncClient(proxies=self.proxy, **kwargs)
+        return httpx.AsyncClient(**kwargs)
+    
+    async def _fetch_function_page_async(self, client: httpx.AsyncClient, semaphore: asyncio.Semaphore,
+                                         function_name: str, refresh: bool) -> Optional[QNXFunction]:
+        cached = self._load_cached(function_name)
+        if cached is not None and not refresh:
+            return self._make_function(function_name, cached["html"])
+        
+        headers = self._conditional_headers(cached)
+        url = self._page_url(function_name)
+        async with semaphore:
+            for attempt in range(max(1, self.max_retries)):
+                if attempt:
+                    await asyncio.sleep(self.retry_delay * 2 ** (attempt - 1))
+                await self.rate_limiter.acquire_async()
+                try:
+                    response = await client.get(url, headers=headers)
+                except httpx.HTTPError as e:
+                    logger.warning(f"Failed to fetch {function_name} (attempt {attempt + 1}): {e}")
+                    continue
+                if response.status_code == 304:
+                    logger.debug(f"Not modified: {function_name}")
+                    return self._make_function(function_name, cached["html"])
+                if response.status_code == 429 or response.status_code >= 500:
+                    logger.warning(f"Failed to fetch {function_name} (attempt {attempt + 1}): "
+                                   f"HTTP {response.status_code}")
+                    continue
+                if response.status_code != 200:
+                    logger.error(f"Failed to fetch {function_name}: HTTP {response.status_code}")
+                    return None
+                return self._store_page(function_name, response.text, response.headers)
+        logger.error(f"Failed to fetch {function_name} after {self.max_retries} attempts")
+        return None
+    
+    def async_client(self) -> httpx.AsyncClient:
+        """Client for fetch_function_page_async"""
+        return self._async_client()
+    
+    async def fetch_function_page_async(self, client: httpx.AsyncClient, function_name: str,
+                                        refresh: bool = False) -> Optional[QNXFunction]:
+        """Fetch one page with a client of async_client(), for callers running their own workers"""
+        return await self._fetch_function_page_async(client, asyncio.Semaphore(1), function_name, refresh)
+    
+    async def fetch_functions_batch_async(self, function_names: List[str], refresh: bool = False) -> List[QNXFunction]:
+        """Fetch function pages concurrently
         
+        At most max_concurrency requests are in flight, and all of them go
+        through the shared rate limiter; cache hits return immediately.
+        Results keep the order of function_names.
+        """
         logger.info(f"Fetching batch of {len(function_names)} functions")
-        
-        for i, name in enumerate(function_names):
-            logger.info(f"Progress: {i+1}/{len(function_names)} - {name}")
-            
-            func = self.fetch_function_page(name)
-            if func:
-                functions.append(func)
-            else:
+        semaphore = asyncio.Semaphore(self.max_concurrency)
+        done = 0
+        
+        async def fetch(client, name):
+            nonlocal done
+            func = await self._fetch_function_page_async(client, semaphore, name, refresh)
+            done += 1
+            if func is None:
                 logger.warning(f"Failed to fetch function: {name}")
+            if done % 100 == 0 or done == len(function_names):
+                logger.info(f"Progress: {done}/{len(function_names)}")
+            return func
+        
+        async with self._async_client() as client:
+            results = await asyncio.gather(*(fetch(client, name) for name in function_names))
         
+        functions = [func for func in results if func]
         logger.info(f"Successfully fetched {len(functions)}/{len(function_names)} functions")
         return functions
     
-    def discover_functions_from_alphabetic_pages(self) -> List[str]:
-        """从QNX文档的字母索引页面发现所有函数"""
-        all_functions = []
+    def fetch_functions_batch(self, function_names: List[str], refresh: bool = False) -> List[QNXFunction]:
+        """Fetch function pages in batch"""
+        coro = self.fetch_functions_batch_async(function_names, refresh)
+        try:
+            asyncio.get_running_loop()
+        except RuntimeError:
+            return asyncio.run(coro)
+        # Called from inside an event loop (MCP server): run the batch on its own loop
+        with ThreadPoolExecutor(max_workers=1) as executor:
+            return executor.submit(asyncio.run, coro).result()
+    
+    async def _fetch_index_pages_async(self) -> Dict[str, Optional[str]]:
+        """The lib-<letter>.html index pages, fetched concurrently; None for a failed letter"""
+        semaphore = asyncio.Semaphore(self.max_concurrency)
+        
+        async def fetch(client, letter):
+            url = f"{self.base_url}{self.lib_ref_base}lib-{letter}.html"
+            async with semaphore:
+                for attempt in range(max(1, self.max_retries)):
+                    if attempt:
+                        await asyncio.sleep(self.retry_delay * 2 ** (attempt - 1))
+                    await self.rate_limiter.acquire_async()
+                    try:
+                        response = await client.get(url)
+                    except httpx.HTTPError as e:
+                        logger.warning(f"Failed to fetch index '{letter}' (attempt {attempt + 1}): {e}")
+                        continue
+                    if response.status_code == 200:
+                        return response.text
+                    logger.warning(f"Index page '{letter}': HTTP {response.status_code}")
+                    if response.status_code != 429 and response.status_code < 500:
+                        break
+            return None
         
-        # 对每个字母进行爬取
-        for letter in 'abcdefghijklmnopqrstuvwxyz':
-            logger.info(f"正在发现字母 '{letter}' 下的函数...")
-            
+        async with self._async_client() as client:
+            pages = await asyncio.gather(*(fetch(client, letter) for letter in INDEX_LETTERS))
+        return dict(zip(INDEX_LETTERS, pages))
+    
+    def discover_function_urls(self, refresh: bool = False) -> Dict[str, List[str]]:
+        """Function name -> every page URL documenting it, from the alphabetic index
+        
+        The one crawl of the index behind both the step processor's function
+        list and the full-index builder. The index pages are fetched
+        concurrently and parsed in a process pool, and the map is kept in
+        function_urls.json for index_ttl_hours (default 24). Letters whose
+        page could not be fetched fall back to the backup list.
+        """
+        cache_file = self.cache_dir / "function_urls.json"
+        if not refresh:
             try:
-                # QNX按字母组织的目录页面URL
-                index_url = f"{self.base_url}{self.lib_ref_base}lib-{letter}.html"
-                
-                response = self.session.get(index_url, timeout=30)
-                if response.status_code == 200:
-                    soup = BeautifulSoup(response.text, 'html.parser')
-                    
-                    # 查找函数链接
-                    functions_in_letter = self._extract_functions_from_index_page(soup, letter)
-                    all_functions.extend(functions_in_letter)
-                    
-                    logger.info(f"字母 '{letter}': 发现 {len(functions_in_letter)} 个函数")
-                else:
-                    logger.warning(f"无法访问字母 '{letter}' 的索引页面: {response.status_code}")
-                    
-            except Exception as e:
-                logger.error(f"处理字母 '{letter}' 时出错: {e}")
-                # 如果网络失败，使用预定义的函数列表作为备用
-                backup_functions = self._get_backup_functions_for_letter(letter)
-                if backup_functions:
-                    all_functions.extend(backup_functions)
-                    logger.info(f"字母 '{letter}': 使用备用列表 {len(backup_functions)} 个函数")
-            
-            # Rate limiting
-            time.sleep(self.request_delay)
-        
-        # 去重并排序
-        unique_functions = sorted(list(set(all_functions)))
-        logger.info(f"总共发现 {len(unique_functions)} 个唯一函数")
-        
-        return unique_functions
+                with open(cache_file, 'r', encoding='utf-8') as f:
+                    cached = json.load(f)
+                if (cached.get("version") == INDEX_CACHE_VERSION
+                        and time.time() - cached.get("fetched_at", 0) < self.index_ttl):
+                    logger.info(f"Function index from cache: {len(cached['urls'])} functions")
+                    return cached["urls"]
+            except (OSError, ValueError, KeyError):
+                pass
+        
+        logger.info("Discovering functions from the alphabetic index pages...")
+        coro = self._fetch_index_pages_async()
+        try:
+            asyncio.get_running_loop()
+            with ThreadPoolExecutor(max_workers=1) as executor:
+                pages = executor.submit(asyncio.run, coro).result()
+        except RuntimeError:
+            pages = asyncio.run(coro)
+        
+        fetched = [(letter, f"{self.base_url}{self.lib_ref_base}lib-{letter}.html", html)
+                   for letter, html in pages.items() if html is not None]
+        with ProcessPoolExecutor(max_workers=min(len(fetched), os.cpu_count() or 1) or 1) as executor:
+            parsed = list(executor.map(parse_index_page, *zip(*fetched))) if fetched else []
+        
+        function_urls: Dict[str, List[str]] = {}
+        for urls in parsed:
+            for name, page_urls in urls.items():
+                bucket = function_urls.setdefault(name, [])
+                bucket.extend(u for u in page_urls if u not in bucket)
+        failed = [letter for letter, html in pages.items() if html is None]
+        for letter in failed:
+            for name in self._get_backup_functions_for_letter(letter):
+                function_urls.setdefault(name, [self._page_url(name)])
+        
+        duplicates = sum(1 for urls in function_urls.values() if len(urls) > 1)
+        logger.info(f"Discovered {len(function_urls)} functions, {duplicates} documented more than once"
+                    + (f"; index pages failed: {''.join(failed)}" if failed else ""))
+        # A partial crawl is not kept, so that the next run tries those letters again
+        if not failed:
+            tmp = cache_file.with_suffix(".tmp")
+            with open(tmp, 'w', encoding='utf-8') as f:
+                json.dump({"version": INDEX_CACHE_VERSION, "fetched_at": time.time(),
+                           "urls": function_urls}, f, ensure_ascii=False)
+            os.replace(tmp, cache_file)
+        return function_urls
     
-    def _extract_functions_from_index_page(self, soup: BeautifulSoup, letter: str) -> List[str]:
-        """从索引页面提取函数名列表"""
-        functions = []
-        
-        # 方法1: 从meta标签的DC.Relation中提取函数链接
-        for meta in soup.find_all('meta', {'name': 'DC.Relation'}):
-            content = meta.get('content', '')
-            if f'/topic/{letter}/' in content and content.endswith('.html'):
-                # 提取函数名: ../../com.qnx.doc.neutrino.lib_ref/topic/a/abort.html -> abort
-                function_name = content.split('/')[-1].replace('.html', '')
-                if function_name and function_name[0].lower() == letter:
-                    functions.append(function_name)
-        
-        # 方法2: 查找所有.html链接（备用方案）
-        for link in soup.find_all('a', href=True):
-            href = link.get('href', '')
-            if href.endswith('.html') and f'/{letter}/' in href:
-                function_name = href.split('/')[-1].replace('.html', '')
-                if function_name and function_name[0].lower() == letter:
-                    functions.append(function_name)
-        
-        # 方法3: 查找包含函数名的特定结构（备用方案）
-        for element in soup.find_all(['dt', 'li', 'td']):
-            text = element.get_text().strip()
-            # 匹配看起来像函数名的文本 (字母开头，可能包含下划线)
-            if re.match(rf'^{letter}[a-zA-Z_][a-zA-Z0-9_]*$', text):
-                functions.append(text)
-        
-        return list(set(functions))  # 去重
+    def discover_functions_from_alphabetic_pages(self) -> List[str]:
+        """从QNX文档的字母索引页面发现所有函数"""
+        return sorted(self.discover_function_urls())
     
     def _get_backup_functions_for_letter(self, letter: str) -> List[str]:
         """获取指定字母的备用函数列表"""
@@ -381,14 +590,17 @@ class QNXWebCrawler:
     
     def get_cached_functions(self) -> List[str]:
         """Get list of cached functions"""
-        if not self.cache_dir.exists():
-            return []
-        
-        cached = []
-        for file in self.cache_dir.glob("*.html"):
-            cached.append(file.stem)
-        
-        return sorted(cached)
+        return self.page_cache.names()
+    
+    def get_cached_pages(self, function_name: str) -> List[QNXFunction]:
+        """Every cached page of a function, one per library section documenting it"""
+        pages = []
+        for url in self.page_cache.urls_for(function_name):
+            cached = self.page_cache.get(url)
+            if cached:
+                pages.append(QNXFunction(name=function_name, url=url, html_content=cached["html"],
+                                         category=function_name[0].lower()))
+        return pages
     
     def crawl_functions(self, function_names: Optional[List[str]] = None, max_functions: Optional[int] = None) -> List[QNXFunction]:
         """Crawl function documentation
@@ -406,25 +618,13 @@ class QNXWebCrawler:
         logger.info(f"Starting to crawl {len(function_names)} functions")
         
         # Check cached functions
-        cached_functions = self.get_cached_functions()
+        cached_functions = set(self.get_cached_functions())
         logger.info(f"Found {len(cached_functions)} cached functions")
         
-        # Separate functions to fetch
+        # Cached pages come back without a request, so everything goes through one batch
         to_fetch = [name for name in function_names if name not in cached_functions]
         logger.info(f"Need to fetch {len(to_fetch)} new functions")
-        
-        # Fetch new functions
-        functions = []
-        if to_fetch:
-            new_functions = self.fetch_functions_batch(to_fetch)
-            functions.extend(new_functions)
-        
-        # Load cached functions
-        for name in function_names:
-            if name in cached_functions:
-                func = self.fetch_function_page(name)  # Load from cache
-                if func and self.validate_function_content(func):
-                    functions.append(func)
+        functions = self.fetch_functions_batch(function_names)
         
         logger.info(f"Total collected functions: {len(functions)}")
         
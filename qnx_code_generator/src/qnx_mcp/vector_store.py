@@ -0,0 +1,477 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Quantized Vector Store
+Function embeddings kept as int8 (or fp16) vectors with an HNSW graph, both
+memory-mapped from disk, so opening the store costs no load and a batch of
+queries walks the graph without any server round trip
+"""
+
+import heapq
+import json
+import logging
+import math
+import mmap
+import operator
+import os
+import random
+import re
+import shutil
+import sqlite3
+import struct
+from contextlib import contextmanager
+from pathlib import Path
+from typing import Any, Dict, List, Optional, Sequence
+
+logger = logging.getLogger(__name__)
+
+QUANTIZATIONS = {"int8": 1, "fp16": 2, "fp32": 4}
+
+class VectorStore:
+    """One collection: vectors.bin, scales.bin and graph.bin (native byte order,
+    memory-mapped), index.json (header and upper HNSW layers) and records.db
+    (ids, documents and metadata)
+
+    Vectors are normalized before quantization, so the distance is the cosine
+    distance 1 - similarity. int8 keeps one float32 scale per vector. Layer 0
+    of the graph is a fixed-width neighbor table; the sparse upper layers live
+    in index.json. Adding vectors copies the maps into memory once and writes
+    every file back on save(). Deleted records leave a tombstone node that
+    still routes graph walks but is never returned; once tombstones make up a
+    third of the nodes the store is compacted.
+    """
+
+    def __init__(self, path: str, quantization: str = "int8", m: int = 16,
+                 ef_construction: int = 100, ef_search: int = 64, seed: int = 42):
+        if quantization not in QUANTIZATIONS:
+            raise ValueError(f"Unknown quantization: {quantization}")
+        self.path = Path(path)
+        self.quantization = quantization
+        self.m = max(2, m)
+        self.m0 = self.m * 2
+        self.ef_construction = max(ef_construction, self.m)
+        self.ef_search = ef_search
+        self._random = random.Random(seed)
+
+        self.dim = 0
+        self.size = 0
+        self.entry_point = -1
+        self.max_level = -1
+        self.upper: List[Dict[int, List[int]]] = []  # upper[level - 1]: node -> neighbors
+        self.deleted = set()                            # tombstone nodes
+        self._vectors = None   # buffer of size * dim * width bytes
+        self._scales = None    # float32 per vector
+        self._layer0 = None    # int32 size * m0, -1 for empty slots
+        self._maps = []
+        self._writable = False
+        self._open()
+
+    @classmethod
+    def from_config(cls, config: Dict[str, Any], collection: str) -> "VectorStore":
+        """qnx_system.vector_store: {"path", "quantization", "m", "ef_construction", "ef_search"}"""
+        store_config = config.get("qnx_system", {}).get("vector_store", {})
+        return cls(os.path.join(store_config.get("path", "./data/vector_store"), collection),
+                   store_config.get("quantization", "int8"),
+                   store_config.get("m", 16),
+                   store_config.get("ef_construction", 100),
+                   store_config.get("ef_search", 64))
+
+    @property
+    def exists(self) -> bool:
+        return self.count() > 0
+
+    def count(self) -> int:
+        return self.size - len(self.deleted)
+
+    # --- files ---
+
+    def _file(self, name: str) -> Path:
+        return self.path / name
+
+    def _map(self, name: str):
+        """Read-only map of a data file (empty buffer for an empty file)"""
+        with open(self._file(name), 'rb') as f:
+            if os.fstat(f.fileno()).st_size == 0:
+                return memoryview(b'')
+            mapped = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        self._maps.append(mapped)
+        return memoryview(mapped)
+
+    def _open(self):
+        header_file = self._file("index.json")
+        if not header_file.exists():
+            return
+        try:
+            with open(header_file, 'r', encoding='utf-8') as f:
+                header = json.load(f)
+            if header.get("quantization", self.quantization) != self.quantization or header.get("m", self.m) != self.m:
+                # The files decide the layout of an existing store
+                self.quantization, self.m = header["quantization"], header["m"]
+                self.m0 = self.m * 2
+            self.dim, self.size = header["dim"], header["count"]
+            self.entry_point, self.max_level = header["entry_point"], header["max_level"]
+            self.upper = [{int(node): neighbors for node, neighbors in layer.items()} for layer in header["upper"]]
+            self.deleted = set(header.get("deleted", []))
+            self._vectors = self._map("vectors.bin")
+            self._scales = self._map("scales.bin").cast('f')
+            self._layer0 = self._map("graph.bin").cast('i')
+            logger.info(f"Opened vector store {self.path}: {self.size} vectors, {self.dim} dims, {self.quantization}")
+        except Exception as e:
+            logger.error(f"Failed to open vector store {self.path}: {e}")
+            self._close()
+            self.dim = self.size = 0
+            self.entry_point, self.max_level, self.upper = -1, -1, []
+            self.deleted = set()
+
+    def _close(self):
+        self._vectors = self._scales = self._layer0 = None
+        for mapped in self._maps:
+            try:
+                mapped.close()
+            except BufferError:
+                pass  # a slice is still referenced; the map goes with it
+        self._maps = []
+
+    def _make_writable(self):
+        if self._writable:
+            return
+        self._vectors = bytearray(self._vectors or b'')
+        self._scales = memoryview(bytearray(self._scales or b'')).cast('f') if self.size else None
+        self._layer0 = memoryview(bytearray(self._layer0 or b'')).cast('i') if self.size else None
+        for mapped in self._maps:
+            try:
+                mapped.close()
+            except BufferError:
+                pass
+        self._maps = []
+        self._writable = True
+
+    def save(self):
+        """Write all files (each via a temporary file) and map them again"""
+        if not self._writable:
+            return
+        self.path.mkdir(parents=True, exist_ok=True)
+        for name, data in (("vectors.bin", self._vectors), ("scales.bin", self._scales),
+                           ("graph.bin", self._layer0)):
+            tmp = self._file(name + ".tmp")
+            with open(tmp, 'wb') as f:
+                f.write(data if data is not None else b'')
+            os.replace(tmp, self._file(name))
+        header = {"dim": self.dim, "count": self.size, "quantization": self.quantization, "m": self.m,
+                  "entry_point": self.entry_point, "max_level": self.max_level,
+                  "upper": [{str(node): neighbors for node, neighbors in layer.items()} for layer in self.upper],
+                  "deleted": sorted(self.deleted)}
+        tmp = self._file("index.json.tmp")
+        with open(tmp, 'w', encoding='utf-8') as f:
+            json.dump(header, f)
+        os.replace(tmp, self._file("index.json"))
+        self._writable = False
+        self._vectors = self._scales = self._layer0 = None
+        self._open()
+
+    def reset(self):
+        """Delete the collection"""
+        self._close()
+        shutil.rmtree(self.path, ignore_errors=True)
+        self.dim = self.size = 0
+        self.entry_point, self.max_level, self.upper = -1, -1, []
+        self.deleted = set()
+        self._writable = False
+
+    @contextmanager
+    def _db(self):
+        """A connection per operation, committed and closed afterwards"""
+        self.path.mkdir(parents=True, exist_ok=True)
+        conn = sqlite3.connect(self._file("records.db"))
+        try:
+            conn.execute('''CREATE TABLE IF NOT EXISTS records (
+                node INTEGER PRIMARY KEY, id TEXT UNIQUE NOT NULL, document TEXT, metadata TEXT)''')
+            yield conn
+            conn.commit()
+        finally:
+            conn.close()
+
+    # --- vectors ---
+
+    def _encode(self, embedding: Sequence[float]):
+        """(bytes, scale) of a normalized, quantized embedding"""
+        norm = math.sqrt(sum(x * x for x in embedding)) or 1.0
+        values = [x / norm for x in embedding]
+        if self.quantization == "int8":
+            peak = max(abs(x) for x in values) or 1.0
+            return struct.pack(f'{len(values)}b', *(round(x * 127 / peak) for x in values)), peak / 127
+        code = 'e' if self.quantization == "fp16" else 'f'
+        return struct.pack(f'{len(values)}{code}', *values), 1.0
+
+    def _vector(self, node: int):
+        width = QUANTIZATIONS[self.quantization]
+        start = node * self.dim * width
+        if self.quantization == "fp16":
+            return struct.unpack_from(f'{self.dim}e', self._vectors, start)
+        view = memoryview(self._vectors)[start:start + self.dim * width]
+        return view.cast('b' if self.quantization == "int8" else 'f')
+
+    def _similarity(self, query: Sequence[float], node: int) -> float:
+        return sum(map(operator.mul, query, self._vector(node))) * self._scales[node]
+
+    def _neighbors(self, node: int, level: int) -> List[int]:
+        if level == 0:
+            row = self._layer0[node * self.m0:(node + 1) * self.m0]
+            return [n for n in row if n >= 0]
+        return self.upper[level - 1].get(node, [])
+
+    def _set_neighbors(self, node: int, level: int, neighbors: List[int]):
+        if level == 0:
+            base = node * self.m0
+            for i in range(self.m0):
+                self._layer0[base + i] = neighbors[i] if i < len(neighbors) else -1
+        else:
+            self.upper[level - 1][node] = neighbors
+
+    def _search_layer(self, query, entry: List[int], ef: int, level: int) -> List[tuple]:
+        """ef nearest (distance, node) pairs reachable from the entry nodes, closest first"""
+        visited = set(entry)
+        candidates = [(1.0 - self._similarity(query, node), node) for node in entry]
+        heapq.heapify(candidates)
+        found = [(-d, n) for d, n in candidates]  # max-heap on distance
+        heapq.heapify(found)
+        while len(found) > ef:
+            heapq.heappop(found)
+        while candidates:
+            distance, node = heapq.heappop(candidates)
+            if distance > -found[0][0] and len(found) >= ef:
+                break
+            for neighbor in self._neighbors(node, level):
+                if neighbor in visited:
+                    continue
+                visited.add(neighbor)
+                d = 1.0 - self._similarity(query, neighbor)
+                if len(found) < ef or d < -found[0][0]:
+                    heapq.heappush(candidates, (d, neighbor))
+                    heapq.heappush(found, (-d, neighbor))
+                    if len(found) > ef:
+                        heapq.heappop(found)
+        return sorted((-d, n) for d, n in found)
+
+    def _descend(self, query, level: int) -> List[int]:
+        """Greedy walk from the entry point down to (not into) a level"""
+        entry = [self.entry_point]
+        for upper_level in range(self.max_level, level, -1):
+            entry = [self._search_layer(query, entry, 1, upper_level)[0][1]]
+        return entry
+
+    def _insert(self, node: int):
+        level = int(-math.log(1.0 - self._random.random()) / math.log(self.m))
+        self._set_neighbors(node, 0, [])
+        if self.entry_point < 0:
+            self.entry_point, self.max_level = node, level
+            self.upper.extend({} for _ in range(level))
+            for l in range(1, level + 1):
+                self.upper[l - 1][node] = []
+            return
+
+        query = self._vector(node)
+        scale = self._scales[node]
+        query = [x * scale for x in query]
+        entry = self._descend(query, level)
+        for l in range(min(level, self.max_level), -1, -1):
+            found = self._search_layer(query, entry, self.ef_construction, l)
+            width = self.m0 if l == 0 else self.m
+            neighbors = [n for _, n in found[:self.m]]
+            self._set_neighbors(node, l, neighbors)
+            for neighbor in neighbors:
+                links = self._neighbors(neighbor, l) + [node]
+                if len(links) > width:
+                    # Keep the closest links of an overfull node
+                    own = [x * self._scales[neighbor] for x in self._vector(neighbor)]
+                    links = sorted(links, key=lambda n: -self._similarity(own, n))[:width]
+                self._set_neighbors(neighbor, l, links)
+            entry = [n for _, n in found]
+        if level > self.max_level:
+            for l in range(self.max_level + 1, level + 1):
+                self.upper.append({node: []})
+            self.entry_point, self.max_level = node, level
+
+    # --- collection API ---
+
+    def add(self, ids: List[str], embeddings: List[Sequence[float]], documents: Optional[List[str]] = None,
+            metadatas: Optional[List[Dict[str, Any]]] = None):
+        """Add records; ids already in the store are rejected"""
+        if not ids:
+            return
+        if len(set(ids)) != len(ids):
+            raise ValueError("Duplicate ids in one add() call")
+        dim = len(embeddings[0])
+        if self.dim and dim != self.dim:
+            raise ValueError(f"Embedding dimension {dim} does not match the store ({self.dim})")
+        documents = documents or [""] * len(ids)
+        metadatas = metadatas or [{}] * len(ids)
+        with self._db() as conn:
+            placeholders = ','.join('?' * len(ids))
+            taken = [row[0] for row in conn.execute(f"SELECT id FROM records WHERE id IN ({placeholders})", ids)]
+            if taken:
+                raise ValueError(f"Ids already in the store: {taken[:5]}")
+
+        self._make_writable()
+        self.dim = dim
+        first = self.size
+        scales, layer0 = bytearray(self._scales or b''), bytearray(self._layer0 or b'')
+        for embedding in embeddings:
+            data, scale = self._encode(embedding)
+            self._vectors += data
+            scales += struct.pack('f', scale)
+        layer0 += struct.pack(f'{len(ids) * self.m0}i', *([-1] * (len(ids) * self.m0)))
+        self._scales, self._layer0 = memoryview(scales).cast('f'), memoryview(layer0).cast('i')
+        for node in range(first, first + len(ids)):
+            self._insert(node)
+        self.size = first + len(ids)
+
+        with self._db() as conn:
+            conn.executemany("INSERT INTO records (node, id, document, metadata) VALUES (?, ?, ?, ?)",
+                             [(first + i, ids[i], documents[i], json.dumps(metadatas[i], ensure_ascii=False))
+                              for i in range(len(ids))])
+        self.save()
+
+    def upsert(self, ids: List[str], embeddings: List[Sequence[float]], documents: Optional[List[str]] = None,
+               metadatas: Optional[List[Dict[str, Any]]] = None):
+        """Add records, replacing those whose id is already in the store"""
+        self.delete(ids, compact=False)
+        self.add(ids, embeddings, documents, metadatas)
+        self._maybe_compact()
+
+    def update(self, ids: List[str], documents: List[str], metadatas: List[Dict[str, Any]]):
+        """Replace document and metadata of existing records, keeping their vectors"""
+        with self._db() as conn:
+            conn.executemany("UPDATE records SET document = ?, metadata = ? WHERE id = ?",
+                             [(documents[i], json.dumps(metadatas[i], ensure_ascii=False), ids[i])
+                              for i in range(len(ids))])
+
+    def delete(self, ids: List[str], compact: bool = True) -> int:
+        """Remove records; their nodes become tombstones. Returns the number removed"""
+        if not ids:
+            return 0
+        nodes = []
+        with self._db() as conn:
+            for i in range(0, len(ids), 500):
+                chunk = list(ids[i:i + 500])
+                placeholders = ','.join('?' * len(chunk))
+                nodes += [row[0] for row in conn.execute(
+                    f"SELECT node FROM records WHERE id IN ({placeholders})", chunk)]
+                conn.execute(f"DELETE FROM records WHERE id IN ({placeholders})", chunk)
+        if not nodes:
+            return 0
+        self._make_writable()
+        self.deleted.update(nodes)
+        self.save()
+        if compact:
+            self._maybe_compact()
+        return len(nodes)
+
+    def _maybe_compact(self):
+        if self.deleted and len(self.deleted) * 3 >= self.size:
+            self.compact()
+
+    def compact(self):
+        """Drop the tombstones: renumber the live nodes and rebuild the graph from their stored vectors"""
+        self._make_writable()
+        live = [node for node in range(self.size) if node not in self.deleted]
+        width = QUANTIZATIONS[self.quantization] * self.dim
+        old_vectors, old_scales = self._vectors, self._scales
+        self._vectors = bytearray()
+        for node in live:
+            self._vectors += old_vectors[node * width:(node + 1) * width]
+        scales = bytearray(struct.pack(f'{len(live)}f', *(old_scales[node] for node in live)))
+        self._scales = memoryview(scales).cast('f') if live else None
+        layer0 = bytearray(struct.pack(f'{len(live) * self.m0}i', *([-1] * (len(live) * self.m0))))
+        self._layer0 = memoryview(layer0).cast('i') if live else None
+        self.size, self.deleted = len(live), set()
+        self.entry_point, self.max_level, self.upper = -1, -1, []
+        for node in range(self.size):
+            self._insert(node)
+
+        # Ascending order never moves a record onto a node number still in use
+        with self._db() as conn:
+            conn.executemany("UPDATE records SET node = ? WHERE node = ?",
+                             [(new, old) for new, old in enumerate(live) if new != old])
+        self.save()
+        logger.info(f"Compacted vector store {self.path}: {self.size} vectors")
+
+    def content_hashes(self) -> Dict[str, Optional[str]]:
+        """id -> metadata["content_hash"] of every record"""
+        with self._db() as conn:
+            return {row[0]: row[1] for row in conn.execute(
+                "SELECT id, json_extract(metadata, '$.content_hash') FROM records")}
+
+    @staticmethod
+    def _where_clause(where: Optional[Dict[str, Any]]):
+        if not where:
+            return "", []
+        clauses, values = [], []
+        for key, value in where.items():
+            if not re.fullmatch(r'[A-Za-z_][A-Za-z0-9_]*', key):
+                raise ValueError(f"Unsupported metadata key: {key}")
+            clauses.append(f"json_extract(metadata, '$.{key}') = ?")
+            values.append(value)
+        return " WHERE " + " AND ".join(clauses), values
+
+    def _records(self, nodes: List[int]) -> Dict[int, tuple]:
+        if not nodes:
+            return {}
+        with self._db() as conn:
+            placeholders = ','.join('?' * len(nodes))
+            return {row[0]: row[1:] for row in conn.execute(
+                f"SELECT node, id, document, metadata FROM records WHERE node IN ({placeholders})", nodes)}
+
+    def get(self, ids: Optional[List[str]] = None, where: Optional[Dict[str, Any]] = None) -> Dict[str, List]:
+        """{"ids", "documents", "metadatas"} of the given ids and/or metadata equality filter"""
+        if ids is not None and not ids:
+            return {"ids": [], "documents": [], "metadatas": []}
+        clause, values = self._where_clause(where)
+        if ids is not None:
+            clause += (" AND " if clause else " WHERE ") + f"id IN ({','.join('?' * len(ids))})"
+            values += list(ids)
+        with self._db() as conn:
+            rows = conn.execute(f"SELECT id, document, metadata FROM records{clause} ORDER BY node", values).fetchall()
+        return {"ids": [r[0] for r in rows], "documents": [r[1] for r in rows],
+                "metadatas": [json.loads(r[2]) for r in rows]}
+
+    def query(self, query_embeddings: List[Sequence[float]], n_results: int = 5,
+              where: Optional[Dict[str, Any]] = None) -> Dict[str, List[List]]:
+        """Nearest records of every query embedding in one call
+
+        Results are {"ids", "documents", "metadatas", "distances"}, one list per
+        query, closest first. With a metadata filter the matching records are
+        ranked exactly instead of through the graph.
+        """
+        results = {"ids": [], "documents": [], "metadatas": [], "distances": []}
+        if not self.count() or not query_embeddings:
+            for key in results:
+                results[key] = [[] for _ in query_embeddings]
+            return results
+
+        candidates = None
+        if where:
+            clause, values = self._where_clause(where)
+            with self._db() as conn:
+                candidates = [row[0] for row in conn.execute(f"SELECT node FROM records{clause}", values)]
+
+        hits = []
+        for embedding in query_embeddings:
+            norm = math.sqrt(sum(x * x for x in embedding)) or 1.0
+            query = [x / norm for x in embedding]
+            if candidates is not None:
+                ranked = sorted((1.0 - self._similarity(query, node), node) for node in candidates)
+            else:
+                ef = max(self.ef_search, n_results + len(self.deleted))
+                ranked = self._search_layer(query, self._descend(query, 0), ef, 0)
+                ranked = [(d, n) for d, n in ranked if n not in self.deleted]
+            hits.append(ranked[:n_results])
+
+        records = self._records(sorted({node for ranked in hits for _, node in ranked}))
+        for ranked in hits:
+            ranked = [(d, n) for d, n in ranked if n in records]
+            results["ids"].append([records[n][0] for _, n in ranked])
+            results["documents"].append([records[n][1] for _, n in ranked])
+            results["metadatas"].append([json.loads(records[n][2]) for _, n in ranked])
+            results["distances"].append([round(max(d, 0.0), 6) for d, _ in ranked])
+        return results
@@ -0,0 +1,47 @@
+#!/usr/bin/env python3
+"""
+GDB/MI stand-in for the perf suite
+
+Answers -interpreter-exec console requests from gdb_replies.json: the
+recorded console output of a command, then <token>^done. Settings and
+"file" commands succeed silently; any other command gets <token>^error,
+as an unknown symbol would.
+"""
+
+import json
+import os
+import re
+import sys
+
+REQUEST_RE = re.compile(r'^(\d*)-interpreter-exec console "((?:\\.|[^"\\])*)"$')
+
+def mi_string(text: str) -> str:
+    return '"' + text.replace('\\', '\\\\').replace('"', '\\"').replace('\n', '\\n') + '"'
+
+def main():
+    with open(os.path.join(os.path.dirname(os.path.abspath(__file__)), "gdb_replies.json")) as f:
+        replies = json.load(f)
+    out = sys.stdout
+    out.write("(gdb)\n")
+    out.flush()
+    for line in sys.stdin:
+        line = line.strip()
+        if line.endswith("-gdb-exit"):
+            out.write("^exit\n")
+            break
+        m = REQUEST_RE.match(line)
+        if not m:
+            continue
+        token, command = m.group(1), m.group(2).replace('\\"', '"').replace('\\\\', '\\')
+        if command in replies:
+            out.write(f"~{mi_string(replies[command] + chr(10))}\n{token}^done\n")
+        elif command.startswith(("set ", "file ")):
+            out.write(f"{token}^done\n")
+        else:
+            out.write(f'{token}^error,msg={mi_string("No symbol " + command.split()[-1] + " in current context.")}\n')
+        out.write("(gdb)\n")
+        out.flush()
+    out.flush()
+
+if __name__ == "__main__":
+    main()
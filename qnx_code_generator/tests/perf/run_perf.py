@@ -0,0 +1,377 @@
+#!/usr/bin/env python3
+"""
+Pipeline Performance Regression Suite
+
+Runs each stage of the QNX pipeline on recorded fixtures and reports its
+throughput in items/sec:
+
+    crawl    QNXWebCrawler.fetch_functions_batch, pages from a local HTTP
+             server answering after --latency ms, cold page cache
+    clean    ClaudeJSONExtractor.clean_pages, cold cleaned-page cache
+    extract  ClaudeJSONExtractor.extract_functions_batch (rule-based parser)
+    gdb      QNXGDBTypeEnhancer.enhance_function_parameters, GDB/MI replies
+             recorded in fixtures/gdb_replies.json (fixtures/fake_gdb.py)
+    embed    HybridVectorizer.get_batch_embeddings, canned embeddings
+             behind a cold embedding cache
+    store    HybridVectorizer.store_vectors into an empty vector store
+    query    HybridVectorizer.query_similar_batch
+
+Nothing reaches the network, a real GDB or a model: the pages are rendered
+from fixtures/page.html and fixtures/functions.json, and the embeddings are
+fixed pseudo-random vectors per text, made before the timed runs.
+
+A stage fails when its rate is more than --threshold below the rate stored
+in baselines.json. Rates depend on the machine: record the baselines with
+--save on the host that runs the suite.
+"""
+
+import argparse
+import hashlib
+import http.server
+import json
+import logging
+import os
+import random
+import shutil
+import string
+import sys
+import tempfile
+import threading
+import time
+from pathlib import Path
+from socketserver import ThreadingMixIn
+from typing import Any, Dict, List, Optional
+
+PERF_DIR = Path(__file__).resolve().parent
+FIXTURES = PERF_DIR / "fixtures"
+PROJECT_DIR = PERF_DIR.parent.parent
+
+# Add src to path (the qnx_mcp modules import each other by bare name)
+sys.path.insert(0, str(PROJECT_DIR / "src"))
+sys.path.insert(0, str(PROJECT_DIR / "src" / "qnx_mcp"))
+
+STAGES = ["crawl", "clean", "extract", "gdb", "embed", "store", "query"]
+BASELINES = PERF_DIR / "baselines.json"
+
+class CannedEmbedder:
+    """Stands in for LocalEmbeddingProvider with vectors made before the timed runs"""
+    model_name = "perf:canned"
+    available = True
+
+    def __init__(self, dim: int):
+        self.dim = dim
+        self.vectors: Dict[str, List[float]] = {}
+
+    def record(self, texts: List[str]):
+        for text in texts:
+            rng = random.Random(hashlib.sha256(text.encode('utf-8')).digest())
+            self.vectors[text] = [rng.gauss(0.0, 1.0) for _ in range(self.dim)]
+
+    def embed(self, texts: List[str]) -> List[Optional[List[float]]]:
+        return [self.vectors.get(text) for text in texts]
+
+def fixture_functions(count: int) -> List[Dict[str, Any]]:
+    """count functions, in the shape of asdict(QNXFunctionInfo), cycling the prototypes of functions.json"""
+    with open(FIXTURES / "functions.json", encoding='utf-8') as f:
+        prototypes = json.load(f)
+    functions = []
+    for i in range(count):
+        proto = prototypes[i % len(prototypes)]
+        name = f"{proto['name']}_{i}"
+        decls = [p.get("decl") or ("..." if p["name"] == "..." else f"{p['type']} {p['name']}")
+                 for p in proto["parameters"]]
+        prototype = f"{proto['return_type']} {name}( " + ",\n    ".join(decls) + " );"
+        includes = '\n'.join(f"#include <{h}>" for h in proto["headers"])
+        functions.append({
+            "name": name,
+            "synopsis": f"{includes}\n\n{prototype}",
+            "prototype": prototype,
+            "description": proto["description"],
+            "parameters": [{"name": p["name"], "type": p["type"], "description": p["description"]}
+                           for p in proto["parameters"]],
+            "return_type": proto["return_type"],
+            "return_description": proto["returns"],
+            "headers": [{"filename": h, "path": f"/usr/include/{h}", "is_system": True} for h in proto["headers"]],
+            "libraries": ["libc"],
+            "see_also": proto["see_also"],
+            "classification": "QNX Neutrino",
+        })
+    return functions
+
+def render_page(template: string.Template, function: Dict[str, Any]) -> str:
+    escape = lambda text: text.replace('&', '&amp;').replace('<', '&lt;').replace('>', '&gt;')
+    includes, _, _ = function["synopsis"].partition("\n\n")
+    return template.substitute(
+        name=function["name"],
+        letter=function["name"][0].lower(),
+        description=escape(function["description"]),
+        includes=escape(includes),
+        prototype=escape(function["prototype"]),
+        arguments='\n'.join(f'<dt class="dt dlterm"><var class="keyword varname">{escape(p["name"])}</var></dt>'
+                            f'<dd class="dd">{escape(p["description"])}</dd>' for p in function["parameters"]),
+        returns=escape(function["return_description"]),
+        see_also=', '.join(f'<a class="xref" href="{n[0].lower()}/{n}.html"><samp class="ph codeph">{n}()</samp></a>'
+                           for n in function["see_also"]),
+    )
+
+def serve_pages(pages: Dict[str, str], latency: float) -> http.server.HTTPServer:
+    """An HTTP server on a free local port answering /.../<name>.html after latency seconds"""
+    class Handler(http.server.BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def do_GET(self):
+            time.sleep(latency)
+            body = pages.get(os.path.basename(self.path).rsplit('.', 1)[0])
+            if body is None:
+                self.send_error(404)
+                return
+            data = body.encode('utf-8')
+            self.send_response(200)
+            self.send_header("Content-Type", "text/html; charset=UTF-8")
+            self.send_header("Content-Length", str(len(data)))
+            self.end_headers()
+            self.wfile.write(data)
+
+        def log_message(self, *args):
+            pass
+
+    class Server(ThreadingMixIn, http.server.HTTPServer):
+        daemon_threads = True
+
+    server = Server(("127.0.0.1", 0), Handler)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    return server
+
+class PerfRun:
+    """Fixtures, and a fresh working directory (./data of its own) per timed run"""
+
+    def __init__(self, items: int, dim: int, latency: float):
+        self.workdir = Path(tempfile.mkdtemp(prefix="qnx_perf_"))
+        self.functions = fixture_functions(items)
+        template = string.Template((FIXTURES / "page.html").read_text(encoding='utf-8'))
+        self.pages = {f["name"]: render_page(template, f) for f in self.functions}
+        self.server = serve_pages(self.pages, latency)
+        self.runs = 0
+
+        # The project's settings, with fixtures in place of the QNX SDP and no rate limit
+        with open(PROJECT_DIR / "config.json", encoding='utf-8') as f:
+            self.config = json.load(f)
+        qnx = self.config.setdefault("qnx_system", {})
+        qnx.update(root_path=str(self.workdir / "qnx"), env_setup_script=str(self.workdir / "qnx" / "env.sh"),
+                   gdb_executable=str(FIXTURES / "fake_gdb.py"), gdb_fallback=str(FIXTURES / "fake_gdb.py"),
+                   type_index_path="./data/no_type_index.db", symbol_library_paths=[], header_search_paths=[])
+        self.config.setdefault("debug_settings", {})["enable_gdb_analysis"] = True
+        requests = self.config.setdefault("network_settings", {}).setdefault("request_settings", {})
+        requests.update(requests_per_second=1e9, burst=1 << 30, max_retries=1)
+        self.config["network_settings"].get("proxy", {})["enabled"] = False
+
+        self.embedder = CannedEmbedder(dim)
+        vectorizer = self.vectorizer(self.fresh())
+        self.texts = [vectorizer._create_function_text(f["name"], f) for f in self.functions]
+        self.queries = [f"{f['description']} ({f['return_type']})" for f in self.functions]
+        self.embedder.record(self.texts + self.queries)
+
+    def fresh(self) -> str:
+        """chdir into a new empty run directory, return the path of its config.json"""
+        self.runs += 1
+        run_dir = self.workdir / f"run{self.runs}"
+        run_dir.mkdir()
+        os.chdir(run_dir)
+        with open("config.json", 'w', encoding='utf-8') as f:
+            json.dump(self.config, f)
+        return str(run_dir / "config.json")
+
+    def close(self):
+        self.server.shutdown()
+        os.chdir(PERF_DIR)
+        shutil.rmtree(self.workdir, ignore_errors=True)
+
+    def vectorizer(self, config_path: str):
+        from hybrid_vectorizer import HybridVectorizer
+        vectorizer = HybridVectorizer(config_path)
+        vectorizer.local_embedder = self.embedder
+        vectorizer.local_available = True
+        return vectorizer
+
+    def tasks(self, texts: List[str]):
+        from hybrid_vectorizer import VectorizeTask
+        return [VectorizeTask(text, f["name"], {"function_name": f["name"]})
+                for text, f in zip(texts, self.functions)]
+
+# A stage: setup(run) -> state, untimed; body(state) -> items done, timed
+def crawl_setup(run: PerfRun):
+    from qnx_web_crawler import QNXWebCrawler, TokenBucket
+    crawler = QNXWebCrawler(run.fresh())
+    crawler.base_url = f"http://127.0.0.1:{run.server.server_address[1]}/"
+    crawler.rate_limiter = TokenBucket(Path("crawler.bucket"), 1e9, 1 << 30)
+    return crawler, list(run.pages)
+
+def crawl_body(state) -> int:
+    crawler, names = state
+    return len(crawler.fetch_functions_batch(names))
+
+def extractor_setup(run: PerfRun):
+    from claude_json_extractor import ClaudeJSONExtractor
+    os.environ.setdefault("CLAUDE_API_KEY", "perf-fixture")
+    config_path = run.fresh()
+    extractor = ClaudeJSONExtractor(config_path)
+    # Every fixture page parses by rules: a call here means the parser regressed
+    extractor._call_claude_api = lambda prompt: None
+    return extractor, list(run.pages.items())
+
+def clean_body(state) -> int:
+    extractor, pages = state
+    try:
+        return sum(1 for text in extractor.clean_pages([html for _, html in pages]) if text)
+    finally:
+        extractor.close()
+
+def extract_body(state) -> int:
+    extractor, pages = state
+    try:
+        return sum(1 for info in extractor.extract_functions_batch(pages).values() if info)
+    finally:
+        extractor.close()
+
+def gdb_setup(run: PerfRun):
+    from qnx_gdb_type_enhancer import QNXGDBTypeEnhancer
+    enhancer = QNXGDBTypeEnhancer(run.fresh())
+    return enhancer, [f["parameters"] for f in run.functions]
+
+def gdb_body(state) -> int:
+    enhancer, parameter_lists = state
+    try:
+        return sum(1 for params in parameter_lists
+                   if any(p["enhanced"] for p in enhancer.enhance_function_parameters(params)))
+    finally:
+        enhancer.close()
+
+def embed_setup(run: PerfRun):
+    return run.vectorizer(run.fresh()), run.tasks(run.texts)
+
+def embed_body(state) -> int:
+    vectorizer, tasks = state
+    return sum(1 for r in vectorizer.get_batch_embeddings(tasks) if r.success)
+
+def store_setup(run: PerfRun):
+    from hybrid_vectorizer import VectorizeResult
+    vectorizer = run.vectorizer(run.fresh())
+    results = [VectorizeResult(doc_id=f["name"], embedding=run.embedder.vectors[text], success=True, provider="local")
+               for text, f in zip(run.texts, run.functions)]
+    metadatas = [{"function_name": f["name"], "return_type": f["return_type"]} for f in run.functions]
+    return vectorizer, results, metadatas, run.texts
+
+def store_body(state) -> int:
+    vectorizer, results, metadatas, documents = state
+    if not vectorizer.store_vectors(results, documents, metadatas):
+        return 0
+    return vectorizer.collection.count()
+
+def query_setup(run: PerfRun):
+    state = store_setup(run)
+    store_body(state)
+    return state[0], run.queries
+
+def query_body(state) -> int:
+    vectorizer, queries = state
+    return sum(1 for hits in vectorizer.query_similar_batch(queries) if hits)
+
+STAGE_FUNCTIONS: Dict[str, tuple] = {
+    "crawl": (crawl_setup, crawl_body),
+    "clean": (extractor_setup, clean_body),
+    "extract": (extractor_setup, extract_body),
+    "gdb": (gdb_setup, gdb_body),
+    "embed": (embed_setup, embed_body),
+    "store": (store_setup, store_body),
+    "query": (query_setup, query_body),
+}
+
+def measure(run: PerfRun, stage: str, repeat: int) -> Dict[str, Any]:
+    """Best items/sec of repeat runs, each on fresh state; ok is False when a run drops items"""
+    setup, body = STAGE_FUNCTIONS[stage]
+    expected = len(run.functions)
+    best, ok = 0.0, True
+    for _ in range(repeat):
+        state = setup(run)
+        start = time.perf_counter()
+        done = body(state)
+        elapsed = time.perf_counter() - start
+        ok = ok and done == expected
+        best = max(best, done / elapsed if elapsed > 0 else 0.0)
+    return {"rate": best, "ok": ok}
+
+def load_baselines(path: Path) -> Dict[str, Any]:
+    try:
+        with open(path, encoding='utf-8') as f:
+            return json.load(f)
+    except (OSError, ValueError):
+        return {}
+
+def main():
+    parser = argparse.ArgumentParser(description="Pipeline throughput against stored baselines")
+    parser.add_argument("--stages", default=",".join(STAGES), help=f"comma-separated subset of {','.join(STAGES)}")
+    parser.add_argument("--items", type=int, default=200, help="functions per stage (default 200)")
+    parser.add_argument("--repeat", type=int, default=3, help="timed runs per stage, the best counts (default 3)")
+    parser.add_argument("--latency", type=float, default=20, help="ms the page server waits per request (default 20)")
+    parser.add_argument("--dim", type=int, default=384, help="embedding dimension (default 384)")
+    parser.add_argument("--threshold", type=float, default=0.25,
+                        help="fail below (1 - threshold) * baseline (default 0.25)")
+    parser.add_argument("--baselines", type=Path, default=BASELINES, help="baseline file")
+    parser.add_argument("--save", action="store_true", help="store the rates of this run as the baselines")
+    parser.add_argument("-v", "--verbose", action="store_true", help="keep the pipeline's logging")
+    args = parser.parse_args()
+
+    stages = [s for s in args.stages.split(",") if s]
+    unknown = [s for s in stages if s not in STAGE_FUNCTIONS]
+    if unknown:
+        parser.error(f"unknown stages: {', '.join(unknown)}")
+
+    if not args.verbose:
+        # The pipeline modules configure INFO logging when imported
+        logging.disable(logging.WARNING)
+    run = PerfRun(args.items, args.dim, args.latency / 1000)
+    settings = {"items": args.items, "latency_ms": args.latency, "dim": args.dim}
+    baselines = load_baselines(args.baselines)
+    if baselines and baselines.get("settings") != settings:
+        print(f"⚠️  Baselines were recorded with {baselines.get('settings')}, this run uses {settings}")
+
+    print("⏱  QNX pipeline throughput (recorded fixtures)")
+    print("=" * 60)
+    results, failed = {}, []
+    try:
+        for stage in stages:
+            result = measure(run, stage, args.repeat)
+            results[stage] = result
+            rate = result["rate"]
+            base = baselines.get("stages", {}).get(stage)
+            line = f"  {stage:8} {rate:10.1f} items/s"
+            if base:
+                line += f"   baseline {base:10.1f}  {(rate / base - 1) * 100:+6.1f}%"
+            if not result["ok"]:
+                failed.append(stage)
+                line += "   ✗ items dropped"
+            elif base and rate < base * (1 - args.threshold):
+                failed.append(stage)
+                line += "   ✗ REGRESSED"
+            print(line)
+    finally:
+        run.close()
+
+    if args.save:
+        stored = baselines if baselines.get("settings") == settings else {"settings": settings, "stages": {}}
+        stored["settings"] = settings
+        stored.setdefault("stages", {}).update({s: round(r["rate"], 1) for s, r in results.items() if r["ok"]})
+        with open(args.baselines, 'w', encoding='utf-8') as f:
+            json.dump(stored, f, indent=2)
+            f.write("\n")
+        print(f"\nBaselines saved to {args.baselines}")
+
+    print("=" * 60)
+    if failed:
+        print(f"⚠️  {len(failed)} stage(s) failed: {', '.join(failed)}")
+        return 1
+    print("🎉 No stage regressed")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -39,7 +39,7 @@ async def test_qnx_escape_functions():
     try:
         escaped_funcs = analyzer.get_existing_qnx_escape_functions()
         print(f"✓ Found {len(escaped_funcs)} escaped functions")
-        assert len(escaped_funcs) > 0, "Should find ESCAPE_QNX_FUNC entries"
+        assert len(escaped_funcs) > 0, "Should find QNX_REDIRECT entries"
         
         # Check that known functions are detected
         expected_funcs = ['stat', 'malloc', 'socket']
@@ -33,22 +33,26 @@ def test_qnx_data_availability():
     data_dir = os.path.join(os.path.dirname(current_dir), 'data')
     processed_dir = os.path.join(data_dir, 'processed_functions')
     cache_dir = os.path.join(data_dir, 'qnx_web_cache')
-    chroma_dir = os.path.join(data_dir, 'chroma_db')
+    vector_dir = os.path.join(data_dir, 'vector_store')
     
     checks = [
         ("Data directory", os.path.exists(data_dir)),
         ("Processed functions", os.path.exists(processed_dir)),
         ("Web cache", os.path.exists(cache_dir)),
-        ("ChromaDB", os.path.exists(chroma_dir)),
+        ("Vector store", os.path.exists(vector_dir)),
     ]
     
     for name, exists in checks:
         print(f"{'✅' if exists else '❌'} {name}: {'存在' if exists else '不存在'}")
     
     # Count files
-    if os.path.exists(cache_dir):
-        cache_count = len([f for f in os.listdir(cache_dir) if f.endswith('.html')])
-        print(f"📄 缓存的HTML文件: {cache_count}")
+    pages_db = os.path.join(cache_dir, 'pages.db')
+    if os.path.exists(pages_db):
+        import sqlite3
+        conn = sqlite3.connect(pages_db)
+        cache_count = conn.execute("SELECT COUNT(*) FROM pages").fetchone()[0]
+        conn.close()
+        print(f"📄 缓存的HTML页面: {cache_count}")
     
     if os.path.exists(processed_dir):
         processed_count = len([f for f in os.listdir(processed_dir) if f.endswith('.json')])
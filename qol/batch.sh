@@ -0,0 +1,120 @@
+#!/bin/bash
+#
+# Patch every ELF under $QNX_TARGET/$QNX_ARCH/{bin,usr/bin,lib}, run each
+# program once under a timeout and rank the symbols the loader could not
+# resolve by how many programs they block. The ranked list is a work
+# queue for the glue generator:
+#
+#   ../qnx_code_generator/main.py --functions-file <out>/functions.txt
+
+print_help() {
+	echo "Usage: $0 [-h] [-a arch] [-j jobs] [-t seconds] [-o out]"
+	echo "   -h: print this help message"
+	echo "   -a: QNX target, x86_64 (default), aarch64le or armle-v7;"
+	echo "       the programs run natively, so on a host of that arch"
+	echo "   -j: programs run at once (default: nproc)"
+	echo "   -t: timeout per program (default: 5)"
+	echo "   -o: output directory (default: batch)"
+}
+
+QNX_ARCH=x86_64
+JOBS=$(nproc)
+TIMEOUT=5
+OUT=batch
+
+while getopts "ha:j:t:o:" opt; do
+	case $opt in
+	h)
+		print_help
+		exit 0
+		;;
+	a)
+		QNX_ARCH=$OPTARG
+		;;
+	j)
+		JOBS=$OPTARG
+		;;
+	t)
+		TIMEOUT=$OPTARG
+		;;
+	o)
+		OUT=$OPTARG
+		;;
+	\?)
+		print_help
+		exit 1
+		;;
+	esac
+done
+
+shift $((OPTIND - 1))
+
+if [ -z "$QNX_TARGET" ]; then
+	echo "QNX_TARGET is not set"
+	exit 1
+fi
+
+SCRIPT_DIR=$(realpath ${BASH_SOURCE%/*})
+QNXPATCH=$SCRIPT_DIR/qnxpatch
+MUSL_SO=$(realpath $SCRIPT_DIR/musl/lib/libc.so)
+TREES="bin usr/bin lib"
+
+if [ ! -x $QNXPATCH -o $QNXPATCH.c -nt $QNXPATCH ]; then
+	cc -O2 -o $QNXPATCH $QNXPATCH.c || exit 1
+fi
+
+rm -rf $OUT
+mkdir -p $OUT/root $OUT/logs
+OUT=$(realpath $OUT)
+ROOT=$OUT/root
+
+RPATH=$ROOT/lib:$ROOT/usr/lib:$ROOT/lib/dll
+for tree in $TREES usr/lib; do
+	[ -d $QNX_TARGET/$QNX_ARCH/$tree ] || continue
+	mkdir -p $ROOT/$tree
+	cp -a $QNX_TARGET/$QNX_ARCH/$tree/. $ROOT/$tree || exit 1
+done
+$QNXPATCH -a $QNX_ARCH -j $JOBS -l $MUSL_SO -r $RPATH $ROOT
+
+# Programs are the patched files with an interpreter.
+for tree in bin usr/bin; do
+	[ -d $ROOT/$tree ] && find $ROOT/$tree -type f -perm -u+x
+done | while read -r prog; do
+	if readelf -l "$prog" 2> /dev/null | grep -q 'program interpreter'; then
+		echo "$prog"
+	fi
+done > $OUT/programs.txt
+
+# Each program's stderr, exit status last, goes to logs/<name>.log.
+run_one() {
+	local prog=$1 log=$OUT/logs/$(basename "$1").log
+	LD_QNX_CENSUS=2 timeout -k 1 $TIMEOUT "$prog" --help < /dev/null > /dev/null 2> "$log"
+	echo "qolbatch status $?" >> "$log"
+}
+export -f run_one
+export OUT TIMEOUT
+xargs -a $OUT/programs.txt -d '\n' -P $JOBS -I{} bash -c 'run_one "$1"' _ {}
+
+# Census mode reports every missing symbol of a program and its
+# libraries, one "qnxcensus missing <dso> <sym> <kind>" line each.
+for log in $OUT/logs/*.log; do
+	prog=$(basename $log .log)
+	awk '$1 == "qnxcensus" && $2 == "missing" { print $4 }' $log |
+		sort -u | sed "s|^|$prog |"
+done > $OUT/missing.txt
+
+# missing.txt: "<program> <symbol>"; ranked.txt: "<programs> <symbol>".
+awk '{ print $2 }' $OUT/missing.txt | sort | uniq -c | sort -k1,1nr -k2 |
+	awk '{ print $1, $2 }' > $OUT/ranked.txt
+awk '{ print $2 }' $OUT/ranked.txt > $OUT/functions.txt
+
+total=$(wc -l < $OUT/programs.txt)
+blocked=$(awk '{ print $1 }' $OUT/missing.txt | sort -u | wc -l)
+nolib=$(grep -l '^Error loading shared library' $OUT/logs/*.log | wc -l)
+# timeout exits 124, a program killed by a signal 128 + the signal.
+timedout=$(cat $OUT/logs/*.log | awk '$1 == "qolbatch" && $3 == 124' | wc -l)
+crashed=$(cat $OUT/logs/*.log | awk '$1 == "qolbatch" && $3 > 128' | wc -l)
+echo "$total programs: $blocked with missing symbols, $nolib with missing" \
+	"libraries, $crashed killed by a signal, $timedout timed out"
+echo "top missing symbols (programs blocked):"
+head -20 $OUT/ranked.txt
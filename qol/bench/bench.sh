@@ -0,0 +1,112 @@
+#!/bin/bash
+#
+# Build and run the QOL microbenchmarks (qolbench.c) against the musl
+# in ../musl, which must have been built with make. Results go to
+# stdout, or to -o <file>, as one JSON object; compare.py checks one
+# run against another.
+
+print_help() {
+	echo "Usage: $0 [-h] [-t seconds] [-n dsos] [-o out] [name-prefix]..."
+	echo "   -h: print this help message"
+	echo "   -t: time per benchmark (default: 1)"
+	echo "   -n: DSO counts of the startup programs (default: \"1 16 64\")"
+	echo "   -o: write the JSON results to this file"
+}
+
+SECS=1
+DSOS="1 16 64"
+OUT=
+
+while getopts "ht:n:o:" opt; do
+	case $opt in
+	h)
+		print_help
+		exit 0
+		;;
+	t)
+		SECS=$OPTARG
+		;;
+	n)
+		DSOS=$OPTARG
+		;;
+	o)
+		OUT=$OPTARG
+		;;
+	\?)
+		print_help
+		exit 1
+		;;
+	esac
+done
+
+shift $((OPTIND - 1))
+
+SCRIPT_DIR=$(realpath ${BASH_SOURCE%/*})
+MUSL=$(realpath $SCRIPT_DIR/../musl)
+ARCH=$(uname -m)
+WORK=$SCRIPT_DIR/build
+
+if [ ! -f $MUSL/lib/libc.so ]; then
+	echo "$MUSL/lib/libc.so not found; run make in $MUSL first"
+	exit 1
+fi
+
+# Programs and libraries linked against the QOL musl, not the host libc.
+CC="cc -O2 -nostdinc -isystem $MUSL/include -isystem $MUSL/obj/include \
+	-isystem $MUSL/arch/$ARCH -isystem $MUSL/arch/generic"
+LINK="-nostdlib -Wl,--dynamic-linker=$MUSL/lib/libc.so -L$MUSL/lib"
+CRT_BEGIN="$MUSL/lib/Scrt1.o $MUSL/lib/crti.o"
+CRT_END="-lc -lgcc $MUSL/lib/crtn.o"
+
+rm -rf $WORK
+mkdir -p $WORK/lib $WORK/files
+
+$CC -fPIE -pie $LINK -Wl,-rpath,$MUSL/lib -o $WORK/qolbench $CRT_BEGIN \
+	$SCRIPT_DIR/qolbench.c $CRT_END || exit 1
+
+# startup-<n>: a program linked against n libraries of one function
+# each, every one of them calling a redirected and a plain function, so
+# that each DSO costs the loader lookups of both kinds.
+STARTUP=()
+for n in $DSOS; do
+	libs=
+	main=$WORK/startup-$n.c
+	: > $main
+	for ((i = 0; i < n; i++)); do
+		lib=b${n}_$i
+		cat > $WORK/lib/$lib.c <<-EOF
+			#include <string.h>
+			#include <sys/stat.h>
+			int f_$lib(const char *p)
+			{
+				struct stat st;
+				return stat(p, &st) + (int)strlen(p);
+			}
+		EOF
+		$CC -fPIC -shared $LINK -o $WORK/lib/lib$lib.so \
+			$WORK/lib/$lib.c -lc || exit 1
+		echo "int f_$lib(const char *);" >> $main
+		libs="$libs -l$lib"
+	done
+	{
+		echo "int main(int argc, char **argv)"
+		echo "{"
+		echo "	int r = 0;"
+		for ((i = 0; i < n; i++)); do
+			echo "	if (argc > 1) r += f_b${n}_$i(argv[1]);"
+		done
+		echo "	return r & 0;"
+		echo "}"
+	} >> $main
+	$CC -fPIE -pie $LINK -Wl,-rpath,$MUSL/lib:$WORK/lib -L$WORK/lib \
+		-o $WORK/startup-$n $CRT_BEGIN $main $libs $CRT_END || exit 1
+	STARTUP+=(-s $WORK/startup-$n)
+done
+
+# slogf output is thrown away; it is the logging path being timed.
+export QNX_SLOG_FILE=/dev/null
+if [ -n "$OUT" ]; then
+	$WORK/qolbench -t $SECS -d $WORK/files "${STARTUP[@]}" "$@" > $OUT
+else
+	$WORK/qolbench -t $SECS -d $WORK/files "${STARTUP[@]}" "$@"
+fi
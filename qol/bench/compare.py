@@ -0,0 +1,54 @@
+#!/usr/bin/env python3
+"""Compare two bench.sh result files.
+
+Usage: compare.py [-r PERCENT] BASE NEW
+
+Prints each benchmark found in both files with its ns/op in each and
+the change, and exits with status 1 if any is slower in NEW by more
+than PERCENT (default 10), so that a shim change can be gated on it.
+Benchmarks in only one of the files are listed but never fail the run.
+"""
+
+import argparse
+import json
+import sys
+
+
+def read(path):
+    with open(path) as f:
+        data = json.load(f)
+    if data.get("version") != 1:
+        sys.exit(f"{path}: not a qolbench result file")
+    return {r["name"]: r for r in data["results"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare qolbench results.")
+    parser.add_argument("-r", type=float, default=10.0, metavar="PERCENT",
+                        help="slowdown that counts as a regression (default 10)")
+    parser.add_argument("base", help="results before the change")
+    parser.add_argument("new", help="results after the change")
+    args = parser.parse_args()
+
+    base, new = read(args.base), read(args.new)
+    failed = 0
+    print(f"{'name':<24} {'base ns':>12} {'new ns':>12} {'change':>8}")
+    for name in sorted(base.keys() | new.keys()):
+        if name not in base or name not in new:
+            side = "new" if name in new else "base"
+            print(f"{name:<24} only in {side}")
+            continue
+        b, n = base[name]["ns_per_op"], new[name]["ns_per_op"]
+        change = (n - b) / b * 100 if b else 0.0
+        mark = ""
+        if change > args.r:
+            mark = "  REGRESSION"
+            failed += 1
+        print(f"{name:<24} {b:12.1f} {n:12.1f} {change:+7.1f}%{mark}")
+    if failed:
+        print(f"{failed} regression(s) over {args.r:g}%", file=sys.stderr)
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,346 @@
+/*
+ * Microbenchmarks of the QOL musl, run by bench.sh. Each benchmark is
+ * timed in batches sized to take about a tenth of the -t time; the
+ * result is the median batch, as ns per operation, which is steadier
+ * across runs than the mean. Output is one JSON object:
+ *
+ *   {"version": 1, "results": [{"name": "stat/qnx", "ns_per_op": 512.3,
+ *    "ops_per_sec": 1951905, "batches": 9, "ops": 2048}, ...]}
+ *
+ * "<op>/qnx" calls the _qnx_ shim a QNX program is bound to and
+ * "<op>/musl" the plain musl function, on the same files. The dlsym
+ * ones time the lookup path (find_sym2) with and without a QNX
+ * redirect, and the startup/<prog> ones run the programs given with -s
+ * to exit.
+ *
+ * Usage: qolbench [-t secs] [-d dir] [-s prog]... [name-prefix]...
+ */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define BATCHES 9
+#define DIR_FILES 64
+#define MAX_STARTUP 16
+
+/* The shims, as bound for QNX programs; their structures are opaque
+ * here. */
+int _qnx_stat(const char *, void *);
+int _qnx_open(const char *, int, ...);
+int _qnx_close(int);
+void *_qnx_opendir(const char *);
+void *_qnx_readdir(void *);
+int _qnx_closedir(void *);
+int slogf(int, int, const char *, ...);
+pid_t spawn(const char *, int, const int[], const void *, char *const[],
+	    char *const[]);
+
+extern char **environ;
+
+static char self[PATH_MAX], dir[PATH_MAX], file[PATH_MAX + 16];
+static const char *startup[MAX_STARTUP];
+static int nstartup, first = 1;
+
+static uint64_t now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void die(const char *what)
+{
+	fprintf(stderr, "qolbench: %s: %s\n", what, strerror(errno));
+	exit(1);
+}
+
+static long b_stat_qnx(long n, const char *arg)
+{
+	static long long buf[32];
+	for (long i = 0; i < n; i++)
+		if (_qnx_stat(file, buf))
+			die("_qnx_stat");
+	return n;
+}
+
+static long b_stat_musl(long n, const char *arg)
+{
+	struct stat st;
+	for (long i = 0; i < n; i++)
+		if (stat(file, &st))
+			die("stat");
+	return n;
+}
+
+static long b_open_qnx(long n, const char *arg)
+{
+	for (long i = 0; i < n; i++) {
+		int fd = _qnx_open(file, 0);
+		if (fd < 0)
+			die("_qnx_open");
+		_qnx_close(fd);
+	}
+	return n;
+}
+
+static long b_open_musl(long n, const char *arg)
+{
+	for (long i = 0; i < n; i++) {
+		int fd = open(file, O_RDONLY);
+		if (fd < 0)
+			die("open");
+		close(fd);
+	}
+	return n;
+}
+
+/* One operation per entry read, ., .. and the open and close included. */
+static long b_readdir_qnx(long n, const char *arg)
+{
+	long ops = 0;
+	while (ops < n) {
+		void *d = _qnx_opendir(dir);
+		if (!d)
+			die("_qnx_opendir");
+		while (_qnx_readdir(d))
+			ops++;
+		_qnx_closedir(d);
+	}
+	return ops;
+}
+
+static long b_readdir_musl(long n, const char *arg)
+{
+	long ops = 0;
+	while (ops < n) {
+		DIR *d = opendir(dir);
+		if (!d)
+			die("opendir");
+		while (readdir(d))
+			ops++;
+		closedir(d);
+	}
+	return ops;
+}
+
+/* Eight names each: redirected to shims, and not. */
+static const char *const redirected[] = {
+	"stat", "open", "read", "write", "pthread_mutex_lock", "strcmp",
+	"mmap", "sigaction",
+};
+static const char *const plain[] = {
+	"strlen", "memcpy", "malloc", "free", "printf", "qsort", "getpid",
+	"strtol",
+};
+
+static long dlsym_loop(long n, const char *const *names)
+{
+	for (long i = 0; i < n; i++)
+		if (!dlsym(RTLD_DEFAULT, names[i & 7]))
+			die(names[i & 7]);
+	return n;
+}
+
+static long b_dlsym_redirect(long n, const char *arg)
+{
+	return dlsym_loop(n, redirected);
+}
+
+static long b_dlsym_plain(long n, const char *arg)
+{
+	return dlsym_loop(n, plain);
+}
+
+static long b_slogf(long n, const char *arg)
+{
+	for (long i = 0; i < n; i++)
+		slogf(1, 5, "qolbench %ld", i);
+	return n;
+}
+
+static void wait_ok(pid_t pid, const char *what)
+{
+	int status;
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+	    WEXITSTATUS(status))
+		die(what);
+}
+
+static long b_spawn_qnx(long n, const char *arg)
+{
+	char *argv[] = { self, "-x", 0 };
+	for (long i = 0; i < n; i++) {
+		pid_t pid = spawn(self, 0, 0, 0, argv, 0);
+		if (pid < 0)
+			die("spawn");
+		wait_ok(pid, "spawn child");
+	}
+	return n;
+}
+
+static long b_spawn_musl(long n, const char *arg)
+{
+	char *argv[] = { self, "-x", 0 };
+	pid_t pid;
+	for (long i = 0; i < n; i++) {
+		if ((errno = posix_spawn(&pid, self, 0, 0, argv, environ)))
+			die("posix_spawn");
+		wait_ok(pid, "posix_spawn child");
+	}
+	return n;
+}
+
+static long b_startup(long n, const char *prog)
+{
+	char *argv[] = { (char *)prog, 0 };
+	pid_t pid;
+	for (long i = 0; i < n; i++) {
+		if ((errno = posix_spawn(&pid, prog, 0, 0, argv, environ)))
+			die(prog);
+		wait_ok(pid, prog);
+	}
+	return n;
+}
+
+static const struct bench {
+	const char *name;
+	long (*fn)(long, const char *);
+} benches[] = {
+	{ "stat/qnx", b_stat_qnx },
+	{ "stat/musl", b_stat_musl },
+	{ "open/qnx", b_open_qnx },
+	{ "open/musl", b_open_musl },
+	{ "readdir/qnx", b_readdir_qnx },
+	{ "readdir/musl", b_readdir_musl },
+	{ "dlsym/redirect", b_dlsym_redirect },
+	{ "dlsym/plain", b_dlsym_plain },
+	{ "spawn/qnx", b_spawn_qnx },
+	{ "spawn/musl", b_spawn_musl },
+	{ "slogf", b_slogf },
+};
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+static void run(const char *name, long (*fn)(long, const char *),
+		const char *arg, double secs)
+{
+	double per[BATCHES], target = secs * 1e9 / (BATCHES + 1);
+	long n = 1, ops;
+	uint64_t t;
+	int i;
+
+	/* Grow the batch until it takes a tenth of the time; the last
+	 * calibration round doubles as warm-up. */
+	for (;;) {
+		t = now();
+		ops = fn(n, arg);
+		t = now() - t;
+		if (t >= target / 2 || n >= 1L << 40)
+			break;
+		n = t ? n * (target / t) + 1 : n * 64;
+	}
+	for (i = 0; i < BATCHES; i++) {
+		t = now();
+		ops = fn(n, arg);
+		per[i] = (double)(now() - t) / ops;
+	}
+	qsort(per, BATCHES, sizeof *per, cmp_double);
+	printf("%s\n    {\"name\": \"%s\", \"ns_per_op\": %.1f, "
+	       "\"ops_per_sec\": %.0f, \"batches\": %d, \"ops\": %ld}",
+	       first ? "" : ",", name, per[BATCHES / 2],
+	       1e9 / per[BATCHES / 2], BATCHES, ops);
+	first = 0;
+	fflush(stdout);
+}
+
+static int selected(const char *name, char **pre, int npre)
+{
+	if (!npre)
+		return 1;
+	for (int i = 0; i < npre; i++)
+		if (!strncmp(name, pre[i], strlen(pre[i])))
+			return 1;
+	return 0;
+}
+
+/* DIR_FILES empty files in dir, and file the first of them. */
+static void make_files(void)
+{
+	int fd;
+
+	for (int i = 0; i < DIR_FILES; i++) {
+		snprintf(file, sizeof file, "%s/f%03d", dir, i);
+		if ((fd = open(file, O_WRONLY | O_CREAT, 0644)) < 0)
+			die(file);
+		close(fd);
+	}
+	snprintf(file, sizeof file, "%s/f000", dir);
+}
+
+int main(int argc, char **argv)
+{
+	char name[PATH_MAX + 16];
+	double secs = 1;
+	const char *base;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "t:d:s:x")) != -1) {
+		switch (c) {
+		case 't':
+			secs = strtod(optarg, 0);
+			break;
+		case 'd':
+			snprintf(dir, sizeof dir, "%s", optarg);
+			break;
+		case 's':
+			if (nstartup < MAX_STARTUP)
+				startup[nstartup++] = optarg;
+			break;
+		case 'x':
+			return 0;
+		default:
+			fprintf(stderr, "usage: qolbench [-t secs] [-d dir] "
+				"[-s prog]... [name-prefix]...\n");
+			return 2;
+		}
+	}
+	if (!realpath("/proc/self/exe", self))
+		die("/proc/self/exe");
+	if (!*dir) {
+		snprintf(dir, sizeof dir, "/tmp/qolbench.%d", getpid());
+		if (mkdir(dir, 0755) && errno != EEXIST)
+			die(dir);
+	}
+	make_files();
+
+	printf("{\"version\": 1, \"results\": [");
+	for (i = 0; i < sizeof benches / sizeof *benches; i++)
+		if (selected(benches[i].name, argv + optind, argc - optind))
+			run(benches[i].name, benches[i].fn, 0, secs);
+	for (i = 0; i < nstartup; i++) {
+		base = strrchr(startup[i], '/');
+		snprintf(name, sizeof name, "startup/%s",
+			 base ? base + 1 : startup[i]);
+		if (selected(name, argv + optind, argc - optind))
+			run(name, b_startup, startup[i], secs);
+	}
+	printf("\n]}\n");
+	return 0;
+}
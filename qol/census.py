@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+"""Print the call counts of an LD_QNX_CENSUS_TABLE file.
+
+Usage: census.py [-n N] [--all] TABLE
+
+Lists the missing functions the census trampolines were bound to, most
+called first, with the referencing library and the callers recorded on
+the first call. Functions that were never called are left out unless
+--all is given. The first column is the work queue order for shims.
+
+File format (native x86_64, see census_init in musl/ldso/dynlink.c):
+    header   char magic[8] "qnxcns1", i32 lock, count, 48 bytes pad
+    entries  {i32 calls, pad; char dso[64], name[120], callers[320]}[1024]
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = b"qnxcns1\0"
+HEADER = struct.Struct("<8sii48x")
+ENTRY = struct.Struct("<i4x64s120s320s")
+
+
+def cstr(b):
+    return b.split(b"\0", 1)[0].decode(errors="replace")
+
+
+def read(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    magic, _, count = HEADER.unpack_from(data)
+    if magic != MAGIC:
+        sys.exit(f"{path}: not a census table")
+    entries = []
+    for i in range(count):
+        calls, dso, name, callers = ENTRY.unpack_from(data, HEADER.size + i * ENTRY.size)
+        entries.append((calls, cstr(dso), cstr(name), cstr(callers)))
+    return entries
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Print LD_QNX_CENSUS_TABLE call counts.")
+    parser.add_argument("-n", type=int, default=0, help="print only the N most called")
+    parser.add_argument("--all", action="store_true", help="include functions never called")
+    parser.add_argument("table", help="file named by LD_QNX_CENSUS_TABLE")
+    args = parser.parse_args()
+
+    entries = [e for e in read(args.table) if args.all or e[0]]
+    entries.sort(key=lambda e: (-e[0], e[2]))
+    if args.n:
+        entries = entries[: args.n]
+    for calls, dso, name, callers in entries:
+        print(f"{calls:10d} {name} {dso}" + (f" from {callers}" if callers else ""))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,239 @@
+#!/usr/bin/env python3
+"""Pack a QNX program, its DSOs and its plugins into one QOL bundle.
+
+Usage: mkbundle.py [--root DIR] -o OUTPUT [-m PROGRAM] -L LIBDIR...
+                   [PLUGIN...]
+
+The DT_NEEDED libraries of PROGRAM and of every PLUGIN are looked up by
+name in the LIBDIRs, in order, and added breadth first, the order in
+which the dynamic linker loads them. The libc (libc.so, libc.so.4 and
+the names reserved by musl's loader) is left out, since the loader
+binds it to itself. With --root, LIBDIRs and PLUGINs are resolved
+below DIR, as for mkldcache.py.
+
+Run the program with `libc.so OUTPUT [args]`, or run it from its own
+file with LD_QNX_BUNDLE=OUTPUT, so that only the libraries come from
+the bundle. Members are found by the last component of the name
+requested (see bundle_find in musl/ldso/dynlink.c).
+
+File format (little endian):
+    header   u32 magic, nent, nsym, nbucket, strsz, main; u64 size
+    entries  {u32 name, hash; u64 off, size}[nent]  in load order
+    buckets  u32[nbucket]  1-based head symbol of each chain, 0 if empty
+    symbols  {u32 hash, next, name, pad; u64 mask}[nsym]
+    strings  NUL-terminated names, strsz bytes
+    members  each ELF file at a page-aligned off
+main is the index of the program, or 0xffffffff. Each symbol's mask
+has bit i set if member i (i < 64) defines it: the loader does not
+search the others for it.
+"""
+
+import argparse
+import os
+import struct
+import sys
+from collections import deque
+
+BUNDLE_MAGIC = 0x31424C51
+NOMAIN = 0xFFFFFFFF
+PAGE = 4096
+
+PT_LOAD, PT_DYNAMIC = 1, 2
+DT_NEEDED, DT_HASH, DT_STRTAB, DT_SYMTAB, DT_GNU_HASH = 1, 4, 5, 6, 0x6FFFFEF5
+
+# The prefixes listed in load_library as the implementation itself.
+RESERVED = ("c.", "pthread.", "rt.", "m.", "dl.", "util.", "xnet.")
+
+
+def gnu_hash(name):
+    h = 5381
+    for c in name.encode():
+        h = (h * 33 + c) & 0xFFFFFFFF
+    return h
+
+
+def is_libc(name):
+    base = os.path.basename(name)
+    if base.startswith("lib") and base[3:].startswith(RESERVED):
+        return True
+    return base == "libc.so"
+
+
+class Elf:
+    """The dynamic section of an x86_64 ELF file: needed and defined names."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        d = self.data
+        if d[:4] != b"\x7fELF" or d[4] != 2 or d[5] != 1:
+            sys.exit(f"{path}: not a 64-bit little-endian ELF file")
+        phoff, = struct.unpack_from("<Q", d, 0x20)
+        phentsize, phnum = struct.unpack_from("<HH", d, 0x36)
+        self.loads, dyn = [], None
+        for i in range(phnum):
+            p_type, _, p_offset, p_vaddr, _, p_filesz = \
+                struct.unpack_from("<IIQQQQ", d, phoff + i * phentsize)
+            if p_type == PT_LOAD:
+                self.loads.append((p_vaddr, p_offset, p_filesz))
+            elif p_type == PT_DYNAMIC:
+                dyn = (p_offset, p_filesz)
+        if dyn is None:
+            sys.exit(f"{path}: no dynamic section")
+        self.dyn = {}
+        needed = []
+        for off in range(dyn[0], dyn[0] + dyn[1], 16):
+            tag, val = struct.unpack_from("<qQ", d, off)
+            if tag == 0:
+                break
+            if tag == DT_NEEDED:
+                needed.append(val)
+            else:
+                self.dyn.setdefault(tag, val)
+        self.strtab = self.offset(self.dyn[DT_STRTAB])
+        self.needed = [self.string(n) for n in needed]
+
+    def offset(self, vaddr):
+        for v, o, sz in self.loads:
+            if v <= vaddr < v + sz:
+                return vaddr - v + o
+        sys.exit(f"address {vaddr:#x} is not in the file")
+
+    def string(self, off):
+        o = self.strtab + off
+        return self.data[o:self.data.index(b"\0", o)].decode()
+
+    def nsyms(self):
+        d = self.data
+        if DT_HASH in self.dyn:
+            return struct.unpack_from("<I", d, self.offset(self.dyn[DT_HASH]) + 4)[0]
+        o = self.offset(self.dyn[DT_GNU_HASH])
+        nbucket, symoff, nbloom, _ = struct.unpack_from("<4I", d, o)
+        o += 16 + 8 * nbloom
+        buckets = struct.unpack_from(f"<{nbucket}I", d, o)
+        chain = o + 4 * nbucket
+        n = max(buckets, default=0)
+        if n < symoff:
+            return symoff
+        while not struct.unpack_from("<I", d, chain + 4 * (n - symoff))[0] & 1:
+            n += 1
+        return n + 1
+
+    def defined(self):
+        """Every name the loader could bind here, and then some: a
+        superset of what sym_usable accepts."""
+        d, o = self.data, self.offset(self.dyn[DT_SYMTAB])
+        names = set()
+        for i in range(1, self.nsyms()):
+            st_name, st_info, _, st_shndx, st_value = \
+                struct.unpack_from("<IBBHQ", d, o + 24 * i)
+            if st_name and (st_shndx or st_value or st_info & 0xF == 6):
+                names.add(self.string(st_name))
+        return names
+
+
+def find(name, root, libdirs):
+    host = lambda p: os.path.join(root, p.lstrip("/")) if root else p
+    if "/" in name:
+        return host(name) if os.path.isfile(host(name)) else None
+    for d in libdirs:
+        path = host(os.path.join(d, name))
+        if os.path.isfile(path):
+            return path
+    return None
+
+
+def collect(root, libdirs, program, plugins):
+    """[(name, Elf)] in load order, and the index of the program."""
+    members, seen, queue = [], set(), deque()
+
+    def add(name, path):
+        base = os.path.basename(name)
+        if base in seen:
+            return
+        seen.add(base)
+        members.append((base, Elf(path)))
+        queue.append(members[-1][1])
+
+    roots = ([program] if program else []) + plugins
+    for i, p in enumerate(roots):
+        add(p, os.path.join(root, p.lstrip("/")) if root else p)
+        # Breadth first from each root, as load_deps walks the list.
+        while queue:
+            for n in queue.popleft().needed:
+                if is_libc(n) or os.path.basename(n) in seen:
+                    continue
+                path = find(n, root, libdirs)
+                if not path:
+                    sys.exit(f"{n}: not found in {':'.join(libdirs)}")
+                add(n, path)
+    return members, 0 if program else NOMAIN
+
+
+def build(members, main):
+    strings = bytearray()
+
+    def intern(s):
+        off = len(strings)
+        strings.extend(s.encode() + b"\0")
+        return off
+
+    names = [(intern(n), gnu_hash(n)) for n, _ in members]
+    masks = {}
+    for i, (_, elf) in enumerate(members[:64]):
+        for s in elf.defined():
+            masks[s] = masks.get(s, 0) | 1 << i
+    nsym = len(masks)
+    nbucket = max(1, nsym // 2)
+    buckets = [0] * nbucket
+    syms = []
+    for i, (s, mask) in enumerate(masks.items()):
+        h = gnu_hash(s)
+        syms.append([h, buckets[h % nbucket], intern(s), 0, mask])
+        buckets[h % nbucket] = i + 1
+
+    index = 32 + 24 * len(members) + 4 * nbucket + 24 * nsym + len(strings)
+    off, offs = -index % PAGE + index, []
+    for _, elf in members:
+        offs.append(off)
+        off += len(elf.data) + (-len(elf.data) % PAGE)
+    size = offs[-1] + len(members[-1][1].data) if members else index
+
+    out = bytearray(struct.pack("<6IQ", BUNDLE_MAGIC, len(members), nsym, nbucket,
+                                len(strings), main, size))
+    for (name, h), o, (_, elf) in zip(names, offs, members):
+        out += struct.pack("<2I2Q", name, h, o, len(elf.data))
+    out += struct.pack(f"<{nbucket}I", *buckets)
+    for s in syms:
+        out += struct.pack("<4IQ", *s)
+    out += strings
+    for o, (_, elf) in zip(offs, members):
+        out += bytes(o - len(out)) + elf.data
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Pack a QNX program and its DSOs into a QOL bundle")
+    parser.add_argument("--root", default="", help="directory the paths are relative to")
+    parser.add_argument("-o", "--output", required=True, help="bundle to write")
+    parser.add_argument("-m", "--main", help="program, run when the bundle is")
+    parser.add_argument("-L", dest="libdirs", action="append", default=[],
+                        help="library directory, in search order")
+    parser.add_argument("plugins", nargs="*", help="DSOs the program dlopens")
+    args = parser.parse_args()
+    if not args.main and not args.plugins:
+        parser.error("nothing to bundle")
+
+    members, main_idx = collect(args.root, args.libdirs, args.main, args.plugins)
+    data = build(members, main_idx)
+    tmp = args.output + ".tmp"
+    with open(tmp, "wb") as f:
+        f.write(data)
+    os.rename(tmp, args.output)
+    if len(members) > 64:
+        print(f"warning: members past the first 64 are not indexed", file=sys.stderr)
+    print(f"{args.output}: {len(members)} members, {len(data)} bytes")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""Generate the library path cache read by the QOL dynamic linker.
+
+Usage: mkldcache.py [--root DIR] -o OUTPUT LIBDIR...
+
+Every regular file in LIBDIR whose name contains ".so" is indexed under
+its file name. When a name appears in several directories the first one
+wins, matching the linker's search order. With --root, LIBDIRs are
+resolved below DIR but recorded as absolute paths inside it, so a cache
+for a chroot can be built from the host.
+
+File format (little endian, see ldcache_open in musl/ldso/dynlink.c):
+    header   u32 magic, nbucket, nent, strsz
+    buckets  u32[nbucket]  1-based head entry of each chain, 0 if empty
+    entries  {u32 hash, next, name, path}[nent]  string offsets
+    strings  NUL-terminated names and paths, strsz bytes
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+LDCACHE_MAGIC = 0x31434C51
+
+
+def gnu_hash(name):
+    h = 5381
+    for c in name.encode():
+        h = (h * 33 + c) & 0xFFFFFFFF
+    return h
+
+
+def collect(root, libdirs):
+    libs = {}
+    for libdir in libdirs:
+        host_dir = os.path.join(root, libdir.lstrip("/")) if root else libdir
+        try:
+            names = sorted(os.listdir(host_dir))
+        except OSError as e:
+            print(f"warning: {host_dir}: {e.strerror}", file=sys.stderr)
+            continue
+        for name in names:
+            if ".so" not in name or name in libs:
+                continue
+            if os.path.isfile(os.path.join(host_dir, name)):
+                libs[name] = os.path.join(libdir, name)
+    return libs
+
+
+def build(libs):
+    nent = len(libs)
+    nbucket = max(1, nent)
+    buckets = [0] * nbucket
+    strings = bytearray()
+    entries = []
+
+    def intern(s):
+        off = len(strings)
+        strings.extend(s.encode() + b"\0")
+        return off
+
+    for i, (name, path) in enumerate(libs.items()):
+        h = gnu_hash(name)
+        b = h % nbucket
+        entries.append([h, buckets[b], intern(name), intern(path)])
+        buckets[b] = i + 1
+    if not strings:
+        strings.extend(b"\0")
+
+    out = bytearray(struct.pack("<4I", LDCACHE_MAGIC, nbucket, nent, len(strings)))
+    out += struct.pack(f"<{nbucket}I", *buckets)
+    for e in entries:
+        out += struct.pack("<4I", *e)
+    out += strings
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate the QOL library path cache")
+    parser.add_argument("--root", default="", help="directory the LIBDIRs are relative to")
+    parser.add_argument("-o", "--output", required=True, help="cache file to write")
+    parser.add_argument("libdirs", nargs="+", help="absolute library directories, in search order")
+    args = parser.parse_args()
+
+    libs = collect(args.root, args.libdirs)
+    data = build(libs)
+    tmp = args.output + ".tmp"
+    with open(tmp, "wb") as f:
+        f.write(data)
+    os.rename(tmp, args.output)
+    print(f"{args.output}: {len(libs)} libraries")
+
+
+if __name__ == "__main__":
+    main()
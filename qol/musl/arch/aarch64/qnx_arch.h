@@ -0,0 +1,23 @@
+/* QNX 7 aarch64 is LP64 with a 64-bit time_t, laid out as on x86_64. */
+typedef int64_t qnx_time_t;
+
+/* The system page: SYSPAGE_AARCH64, and ClockCycles is the generic
+ * timer's virtual count, which runs at CNTFRQ_EL0. */
+#define QNX_SYSPAGE_TYPE 7
+#define QNX_CPU_NAME "aarch64"
+
+static inline uint64_t qnx_cycles(void)
+{
+	uint64_t v;
+
+	__asm__ __volatile__ ("isb; mrs %0, cntvct_el0" : "=r"(v) : : "memory");
+	return v;
+}
+
+static inline uint64_t qnx_cycles_per_sec(void)
+{
+	uint64_t f;
+
+	__asm__ ("mrs %0, cntfrq_el0" : "=r"(f));
+	return f;
+}
@@ -0,0 +1,25 @@
+/* QNX 7 armle-v7 keeps an unsigned 32-bit time_t, where musl has moved
+ * to 64 bits, so structures holding times differ from musl's. */
+typedef uint32_t qnx_time_t;
+
+/* The system page: SYSPAGE_ARM, and ClockCycles is the generic timer's
+ * virtual count, which runs at CNTFRQ. */
+#define QNX_SYSPAGE_TYPE 4
+#define QNX_CPU_NAME "armle-v7"
+
+static inline uint64_t qnx_cycles(void)
+{
+	uint32_t lo, hi;
+
+	__asm__ __volatile__ ("isb; mrrc p15, 1, %0, %1, c14"
+			      : "=r"(lo), "=r"(hi) : : "memory");
+	return (uint64_t)hi << 32 | lo;
+}
+
+static inline uint64_t qnx_cycles_per_sec(void)
+{
+	uint32_t f;
+
+	__asm__ ("mrc p15, 0, %0, c14, c0, 0" : "=r"(f));
+	return f;
+}
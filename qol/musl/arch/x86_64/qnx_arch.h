@@ -0,0 +1,44 @@
+/* QNX 7 x86_64 is LP64 with a 64-bit time_t. */
+typedef int64_t qnx_time_t;
+
+/* The system page: SYSPAGE_X86_64, and ClockCycles is the TSC. */
+#define QNX_SYSPAGE_TYPE 6
+#define QNX_CPU_NAME "x86_64"
+
+static inline uint64_t qnx_cycles(void)
+{
+	uint32_t lo, hi;
+
+	__asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+	return (uint64_t)hi << 32 | lo;
+}
+
+static inline void qnx_cpuid(uint32_t leaf, uint32_t r[4])
+{
+	__asm__ ("cpuid" : "=a"(r[0]), "=b"(r[1]), "=c"(r[2]), "=d"(r[3])
+		 : "a"(leaf), "c"(0));
+}
+
+/* The TSC rate as a hypervisor or CPUID leaf 0x15 states it, 0 if
+ * neither does and it has to be measured. */
+static inline uint64_t qnx_cycles_per_sec(void)
+{
+	uint32_t r[4];
+
+	qnx_cpuid(1, r);
+	if (r[2] >> 31) {
+		qnx_cpuid(0x40000000, r);
+		if (r[0] >= 0x40000010) {
+			qnx_cpuid(0x40000010, r);
+			if (r[0])
+				return r[0] * 1000ull;
+		}
+	}
+	qnx_cpuid(0, r);
+	if (r[0] >= 0x15) {
+		qnx_cpuid(0x15, r);
+		if (r[0] && r[1] && r[2])
+			return (uint64_t)r[2] * r[1] / r[0];
+	}
+	return 0;
+}
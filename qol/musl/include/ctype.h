@@ -70,6 +70,15 @@ int   toascii(int);
 
 #endif
 
+#if defined(_GNU_SOURCE) || defined(_BSD_SOURCE)
+#define __NEED_size_t
+#include <bits/alltypes.h>
+
+void qnx_toupper_buf(char *, const char *, size_t);
+void qnx_tolower_buf(char *, const char *, size_t);
+size_t qnx_ctype_span(const char *, size_t, int);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
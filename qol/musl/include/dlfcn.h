@@ -25,6 +25,9 @@ void  *dlopen(const char *, int);
 void  *dlsym(void *__restrict, const char *__restrict);
 
 #if defined(_GNU_SOURCE) || defined(_BSD_SOURCE)
+#define __NEED_size_t
+#include <bits/alltypes.h>
+
 typedef struct {
 	const char *dli_fname;
 	void *dli_fbase;
@@ -33,6 +36,7 @@ typedef struct {
 } Dl_info;
 int dladdr(const void *, Dl_info *);
 int dlinfo(void *, int, void *);
+int dlsym_many(void *__restrict, const char *const *__restrict, void **__restrict, size_t);
 #endif
 
 #if _REDIR_TIME64
@@ -9,6 +9,9 @@ extern "C" {
 
 #define __NEED_float_t
 #define __NEED_double_t
+#ifdef _GNU_SOURCE
+#define __NEED_size_t
+#endif
 #include <bits/alltypes.h>
 
 #if 100*__GNUC__+__GNUC_MINOR__ >= 303
@@ -433,6 +436,11 @@ long double exp10l(long double);
 double      pow10(double);
 float       pow10f(float);
 long double pow10l(long double);
+
+void        vexpf(float *, const float *, size_t);
+void        vpowf(float *, const float *, const float *, size_t);
+void        vlrintf(long *, const float *, size_t);
+void        vfloorf(float *, const float *, size_t);
 #endif
 
 #ifdef __cplusplus
@@ -11,6 +11,7 @@
 #include <limits.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/resource.h>
 #include <errno.h>
 #include <link.h>
 #include <setjmp.h>
@@ -22,6 +23,12 @@
 #include "pthread_impl.h"
 #include "fork_impl.h"
 #include "dynlink.h"
+#include "qnx_redirect.h"
+#include "qnx_probe.h"
+#include "qnx_stats.h"
+#include "qnx_afl.h"
+#include "qnx_string.h"
+#include "qnx_shimstats.h"
 
 static size_t ldso_page_size;
 #ifndef PAGE_SIZE
@@ -74,20 +81,31 @@ struct dso {
 	Sym *syms;
 	Elf_Symndx *hashtab;
 	uint32_t *ghashtab;
+	size_t *sysv_bloom, sysv_bloom_mask;
+	uint32_t *sysv_gnu_hashes, sysv_bloom_shift;
+	struct sym_index *volatile sym_index;
 	int16_t *versym;
 	char *strings;
 	struct dso *syms_next, *lazy_next;
 	size_t *lazy, lazy_cnt;
+	size_t *plt_rel, plt_rel_stride;
 	unsigned char *map;
 	size_t map_len;
 	dev_t dev;
 	ino_t ino;
+	struct timespec mtime;
+	uint32_t bundle_idx;
+	struct {
+		uint64_t map_ns, dyn_ns, reloc_ns, init_ns;
+	} prof;
 	char relocated;
 	char constructed;
 	char kernel_mapped;
 	char mark;
 	char bfs_built;
 	char runtime_loaded;
+	int ctor_deferred;
+	char ctor_released;
 	struct dso **deps, *needed_by;
 	size_t ndeps_direct;
 	size_t next_dep;
@@ -133,13 +151,33 @@ static size_t *saved_addends, *apply_addends_to;
 
 static struct dso ldso;
 static struct dso *head, *tail, *fini_head, *syms_tail, *lazy_head;
-static char *env_path, *sys_path;
+static char *env_path, *sys_path, *env_ldcache;
 static unsigned long long gencnt;
+static volatile size_t dso_gen;
 static int runtime;
 static int ldd_mode;
 static int ldso_fail;
 static int noload;
 static int shutting_down;
+static int qnx_nosymcache;
+static int qnx_lazy;
+static int qnx_parallel;
+static int qnx_hugepage, qnx_populate;
+static int qnx_defer_ctors;
+static int qnx_tls_relax;
+static int qnx_cmplog;
+static char *qnx_snapshot_path;
+static struct qnx_snap_hdr *qnx_snap;
+static size_t qnx_snap_len;
+static size_t map_hint;
+static off_t map_bias;
+static int qnx_prof_fd = -1;
+static int qnx_census_fd = -1;
+static struct {
+	uint64_t start, load_ns, reloc_ns, init_ns;
+	uint64_t lookups, redirects, bloom_rejects, sysv_rejects, bundle_skips, tls_relaxed;
+	long minflt, majflt;
+} qnx_prof;
 static jmp_buf *rtld_fail;
 static pthread_rwlock_t lock;
 static struct debug debug;
@@ -299,6 +337,183 @@ static Sym *gnu_lookup_filtered(uint32_t h1, uint32_t *hashtab, struct dso *dso,
 	return gnu_lookup(h1, hashtab, dso, s);
 }
 
+/* Most QNX 7 libraries ship only DT_HASH, so a lookup in them walks a
+ * chain with a strcmp per candidate even for the many names they do not
+ * define. sysv_filter_build gives such a library a bloom filter in the
+ * DT_GNU_HASH layout, probed with the GNU hash find_sym2 has anyway, and
+ * the GNU hash of each symbol, compared before its name. */
+
+static Sym *sysv_lookup_filtered(const char *s, uint32_t *h, uint32_t gh, struct dso *dso, uint32_t fofs, size_t fmask)
+{
+	size_t f = dso->sysv_bloom[fofs & dso->sysv_bloom_mask];
+	if (!(f & fmask) || !(f >> (gh >> dso->sysv_bloom_shift) % (8 * sizeof f) & 1)) {
+		qnx_prof.sysv_rejects++;
+		return 0;
+	}
+
+	size_t i;
+	Sym *syms = dso->syms;
+	Elf_Symndx *hashtab = dso->hashtab;
+	uint32_t *hashes = dso->sysv_gnu_hashes;
+	if (!*h) *h = sysv_hash(s);
+	for (i=hashtab[2+*h%hashtab[0]]; i; i=hashtab[2+hashtab[0]+i]) {
+		if (hashes[i] == gh && (!dso->versym || dso->versym[i] >= 0)
+		    && !strcmp(s, dso->strings+syms[i].st_name))
+			return syms+i;
+	}
+	return 0;
+}
+
+/* Symbols whose QNX ABI differs from musl's, declared next to their
+ * shims in src/qnxsupport with QNX_REDIRECT and gathered by the linker
+ * into the qnx_redirect section. */
+extern hidden const struct qnx_redirect __start_qnx_redirect[], __stop_qnx_redirect[];
+
+/* Open-addressed index over the qnx_redirect section keyed by the GNU
+ * hash that find_sym2 computes anyway, so a lookup costs one probe and
+ * at most one string compare. It is sized at stage 2 to stay under half
+ * full; QNX_REDIRECT_MAX_SLOTS bounds the section at half that many. */
+#define QNX_REDIRECT_MAX_SLOTS 1024
+
+/* LD_QNX_PROFILE=<fd> instrumentation. Counters are always kept; the
+ * clock is only read when profiling is enabled, since the startup
+ * phases run before the vdso is set up and each read is a syscall. */
+static uint64_t prof_now(void)
+{
+	struct timespec ts;
+	if (qnx_prof_fd < 0) return 0;
+	__syscall(SYS_clock_gettime, CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void prof_faults(long *minflt, long *majflt)
+{
+	struct rusage ru;
+	if (__syscall(SYS_getrusage, RUSAGE_SELF, &ru)) return;
+	*minflt = ru.ru_minflt;
+	*majflt = ru.ru_majflt;
+}
+
+void __dl_qnx_lookups(uint64_t *lookups, uint64_t *redirects)
+{
+	*lookups = qnx_prof.lookups;
+	*redirects = qnx_prof.redirects;
+}
+
+static void prof_dump(void)
+{
+	struct dso *p;
+	uint64_t mapped = 0;
+	size_t n = 0;
+	int fd = qnx_prof_fd;
+	long minflt = qnx_prof.minflt, majflt = qnx_prof.majflt;
+
+	prof_faults(&minflt, &majflt);
+
+	for (p=head; p; p=p->next, n++) {
+		dprintf(fd, "qnxprof dso name=%s map_ns=%llu dyn_ns=%llu "
+			"reloc_ns=%llu init_ns=%llu mapped=%zu\n", p->name,
+			(unsigned long long)p->prof.map_ns,
+			(unsigned long long)p->prof.dyn_ns,
+			(unsigned long long)p->prof.reloc_ns,
+			(unsigned long long)p->prof.init_ns, p->map_len);
+		mapped += p->map_len;
+	}
+	dprintf(fd, "qnxprof phase load_ns=%llu reloc_ns=%llu init_ns=%llu\n",
+		(unsigned long long)qnx_prof.load_ns,
+		(unsigned long long)qnx_prof.reloc_ns,
+		(unsigned long long)qnx_prof.init_ns);
+	dprintf(fd, "qnxprof total dsos=%zu lookups=%llu redirects=%llu "
+		"bloom_rejects=%llu sysv_rejects=%llu bundle_skips=%llu "
+		"tls_relaxed=%llu mapped=%llu\n", n,
+		(unsigned long long)qnx_prof.lookups,
+		(unsigned long long)qnx_prof.redirects,
+		(unsigned long long)qnx_prof.bloom_rejects,
+		(unsigned long long)qnx_prof.sysv_rejects,
+		(unsigned long long)qnx_prof.bundle_skips,
+		(unsigned long long)qnx_prof.tls_relaxed,
+		(unsigned long long)mapped);
+	dprintf(fd, "qnxprof faults minflt=%ld majflt=%ld\n",
+		minflt - qnx_prof.minflt, majflt - qnx_prof.majflt);
+}
+
+static struct qnx_redirect_slot {
+	uint32_t hash, target_hash;
+	const struct qnx_redirect *r;
+	int cmplog;
+} qnx_redirect_index[QNX_REDIRECT_MAX_SLOTS];
+static size_t qnx_redirect_mask;
+
+/* Bloom filter over the redirect names, two bits per name in the same
+ * word (as in DT_GNU_HASH) so that the common case, a symbol which is
+ * not redirected, is rejected with one load and one AND before the
+ * table is probed. */
+#define QNX_REDIRECT_BLOOM_WORDS 16
+#define QNX_REDIRECT_BLOOM_SHIFT 26
+static size_t qnx_redirect_bloom[QNX_REDIRECT_BLOOM_WORDS];
+
+static inline size_t qnx_bloom_mask(uint32_t h)
+{
+	return (size_t)1 << h % (8*sizeof(size_t))
+		| (size_t)1 << (h >> QNX_REDIRECT_BLOOM_SHIFT) % (8*sizeof(size_t));
+}
+
+static inline size_t *qnx_bloom_word(uint32_t h)
+{
+	return &qnx_redirect_bloom[h / (8*sizeof(size_t)) % QNX_REDIRECT_BLOOM_WORDS];
+}
+
+static void qnx_redirect_init(void)
+{
+	const struct qnx_redirect *r;
+	size_t n = __stop_qnx_redirect - __start_qnx_redirect, j;
+	if (n > QNX_REDIRECT_MAX_SLOTS/2) a_crash();
+	for (qnx_redirect_mask=1; qnx_redirect_mask < 2*n; qnx_redirect_mask*=2);
+	qnx_redirect_mask--;
+	for (r=__start_qnx_redirect; r<__stop_qnx_redirect; r++) {
+		uint32_t h = gnu_hash(r->name);
+		*qnx_bloom_word(h) |= qnx_bloom_mask(h);
+		for (j=h; qnx_redirect_index[j&qnx_redirect_mask].r; j++)
+			if (!strcmp(qnx_redirect_index[j&qnx_redirect_mask].r->name, r->name))
+				break;
+		qnx_redirect_index[j&qnx_redirect_mask] = (struct qnx_redirect_slot){
+			.hash = h,
+			.target_hash = gnu_hash(r->target),
+			.r = r,
+			.cmplog = !strncmp(r->target, QNX_CMPLOG_PREFIX,
+				sizeof QNX_CMPLOG_PREFIX - 1),
+		};
+	}
+}
+
+/* LD_QNX_SHIMSTATS: a copy of each redirect target's symbol with the
+ * address of its counting wrapper (see qnxsupport/shimstats.c), by
+ * index in the qnx_redirect section. Targets that some other DSO
+ * defines are bound as they are. */
+static Sym *qnx_shimstats_syms;
+
+static inline void qnx_shimstats_bind(const struct qnx_redirect_slot *qr, struct symdef *def)
+{
+	Sym *w;
+	if (!qnx_shimstats_syms || !def->sym || def->dso != &ldso) return;
+	w = &qnx_shimstats_syms[qr->r - __start_qnx_redirect];
+	if (w->st_value) def->sym = w;
+}
+
+static const struct qnx_redirect_slot *qnx_redirect_find(const char *s, uint32_t gh)
+{
+	const struct qnx_redirect_slot *e;
+	size_t m = qnx_bloom_mask(gh);
+	if ((*qnx_bloom_word(gh) & m) != m) {
+		qnx_prof.bloom_rejects++;
+		return 0;
+	}
+	for (size_t j=gh; (e=&qnx_redirect_index[j&qnx_redirect_mask])->r; j++)
+		if (e->hash == gh && !strcmp(s, e->r->name))
+			return e->cmplog && !qnx_cmplog ? 0 : e;
+	return 0;
+}
+
 #define OK_TYPES (1<<STT_NOTYPE | 1<<STT_OBJECT | 1<<STT_FUNC | 1<<STT_COMMON | 1<<STT_TLS)
 #define OK_BINDS (1<<STB_GLOBAL | 1<<STB_WEAK | 1<<STB_GNU_UNIQUE)
 
@@ -306,74 +521,250 @@ static Sym *gnu_lookup_filtered(uint32_t h1, uint32_t *hashtab, struct dso *dso,
 #define ARCH_SYM_REJECT_UND(s) 0
 #endif
 
+/* Bundles, written by qol/mkbundle.py: one file holding a program, the
+ * DSOs it needs and its plugins, each page aligned after an index. With
+ * LD_QNX_BUNDLE=<file>, or a bundle run as the program through the
+ * dynamic linker, load_library maps members from the one descriptor
+ * before any path search, by the last component of the name. The
+ * symbol index gives, for every name a member defines, the set of
+ * members defining it, so find_sym2 skips the others outright. Members
+ * past the first 64 are always searched. */
+#define BUNDLE_MAGIC 0x31424c51 /* "QLB1" */
+#define BUNDLE_NOMAIN 0xffffffff
+
+struct bundle_hdr {
+	uint32_t magic, nent, nsym, nbucket, strsz, main;
+	uint64_t size;
+};
+
+struct bundle_ent {
+	uint32_t name, hash;
+	uint64_t off, size;
+};
+
+struct bundle_sym {
+	uint32_t hash, next, name, pad;
+	uint64_t mask;
+};
+
+static struct bundle_hdr *bundle;
+static size_t bundle_len;
+static int bundle_fd = -1;
+static const char *bundle_path;
+
+#define bundle_ents(h) ((struct bundle_ent *)((h)+1))
+#define bundle_buckets(h) ((uint32_t *)(bundle_ents(h) + (h)->nent))
+#define bundle_syms(h) ((struct bundle_sym *)(bundle_buckets(h) + (h)->nbucket))
+#define bundle_strings(h) ((const char *)(bundle_syms(h) + (h)->nsym))
+
+/* Take fd as the bundle if it is one; it stays open for the process. */
+static int bundle_open(int fd, const char *path)
+{
+	struct bundle_hdr *h, hdr;
+	struct stat st;
+	size_t need, i;
+
+	if (pread(fd, &hdr, sizeof hdr, 0) != sizeof hdr
+	    || hdr.magic != BUNDLE_MAGIC || fstat(fd, &st)
+	    || hdr.size != st.st_size || hdr.nent > 1<<20
+	    || hdr.nsym > 1<<24 || hdr.nbucket > 1<<24)
+		return 0;
+	need = sizeof hdr + sizeof(struct bundle_ent)*(size_t)hdr.nent
+		+ 4*(size_t)hdr.nbucket
+		+ sizeof(struct bundle_sym)*(size_t)hdr.nsym + hdr.strsz;
+	if (!hdr.strsz || need > hdr.size || (hdr.nsym && !hdr.nbucket)
+	    || (hdr.main != BUNDLE_NOMAIN && hdr.main >= hdr.nent))
+		return 0;
+	h = mmap(0, need, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (h == MAP_FAILED) return 0;
+	for (i=0; i<h->nent; i++) {
+		struct bundle_ent *e = bundle_ents(h)+i;
+		if (e->name >= h->strsz || e->off & PAGE_SIZE-1
+		    || e->off > h->size || e->size > h->size - e->off)
+			break;
+	}
+	if (i < h->nent || bundle_strings(h)[h->strsz-1]) {
+		munmap(h, need);
+		return 0;
+	}
+	if (bundle) {
+		munmap(bundle, bundle_len);
+		close(bundle_fd);
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	bundle = h;
+	bundle_len = need;
+	bundle_fd = fd;
+	bundle_path = path;
+	/* A snapshot matches DSOs by inode, which members share. */
+	qnx_snapshot_path = 0;
+	return 1;
+}
+
+static int bundle_find(const char *name)
+{
+	const char *base = strrchr(name, '/');
+	uint32_t h, i;
+
+	base = base ? base+1 : name;
+	h = gnu_hash(base);
+	for (i=0; i<bundle->nent; i++) {
+		struct bundle_ent *e = bundle_ents(bundle)+i;
+		if (e->hash == h && !strcmp(bundle_strings(bundle)+e->name, base))
+			return i;
+	}
+	return -1;
+}
+
+/* Members that may define s; all of them without an index. */
+static uint64_t bundle_sym_mask(const char *s, uint32_t gh)
+{
+	const struct bundle_sym *syms = bundle_syms(bundle);
+	uint32_t i, n;
+
+	if (!bundle->nsym) return -1;
+	i = bundle_buckets(bundle)[gh % bundle->nbucket];
+	for (n=0; i && i<=bundle->nsym && n<bundle->nsym; n++) {
+		const struct bundle_sym *e = &syms[i-1];
+		if (e->hash == gh && e->name < bundle->strsz
+		    && !strcmp(bundle_strings(bundle)+e->name, s))
+			return e->mask;
+		i = e->next;
+	}
+	return 0;
+}
+
+static inline int sym_usable(const Sym *sym, int need_def)
+{
+	if (!sym->st_shndx)
+		if (need_def || (sym->st_info&0xf) == STT_TLS
+		    || ARCH_SYM_REJECT_UND(sym))
+			return 0;
+	if (!sym->st_value)
+		if ((sym->st_info&0xf) != STT_TLS)
+			return 0;
+	if (!(1<<(sym->st_info&0xf) & OK_TYPES)) return 0;
+	if (!(1<<(sym->st_info>>4) & OK_BINDS)) return 0;
+	return 1;
+}
+
 #if defined(__GNUC__)
 __attribute__((always_inline))
 #endif
-static inline struct symdef find_sym2(struct dso *dso, const char *s, int need_def, int use_deps)
+static inline struct symdef find_sym2(struct dso *dso, const char *s, uint32_t gh, int need_def, int use_deps)
 {
 	// dprintf(2, "DEBUG: relocating %s: %s, is_plt: %d \n", dso->name, s, need_def);
 
-	#define ESCAPE_QNX_FUNC(func) if (!strcmp(s, #func)) s = "_qnx_" #func
-
-	ESCAPE_QNX_FUNC(stat);
-	ESCAPE_QNX_FUNC(lstat);
-	ESCAPE_QNX_FUNC(fstat);
-	ESCAPE_QNX_FUNC(fstatat);
-	ESCAPE_QNX_FUNC(readdir);
-	ESCAPE_QNX_FUNC(open);
-	ESCAPE_QNX_FUNC(openat);
-	ESCAPE_QNX_FUNC(creat);
-	ESCAPE_QNX_FUNC(utimes);
-	ESCAPE_QNX_FUNC(gettimeofday);
-	ESCAPE_QNX_FUNC(settimeofday);
-	ESCAPE_QNX_FUNC(sigaction);
-	ESCAPE_QNX_FUNC(localeconv);
-	ESCAPE_QNX_FUNC(bind);
-	ESCAPE_QNX_FUNC(connect);
-	ESCAPE_QNX_FUNC(freeaddrinfo);
-	ESCAPE_QNX_FUNC(getaddrinfo);
-	ESCAPE_QNX_FUNC(gethostbyname);
-	ESCAPE_QNX_FUNC(getsockname);
-	ESCAPE_QNX_FUNC(getsockopt);
-	ESCAPE_QNX_FUNC(listen);
-	ESCAPE_QNX_FUNC(recv);
-	ESCAPE_QNX_FUNC(send);
-	ESCAPE_QNX_FUNC(socket);
-	
-	#undef ESCAPE_QNX_FUNC
-
-	uint32_t h = 0, gh = gnu_hash(s), gho = gh / (8*sizeof(size_t)), *ght;
+	uint32_t h = 0, gho, *ght;
+	const struct qnx_redirect_slot *qr = qnx_redirect_find(s, gh);
+	qnx_prof.lookups++;
+	if (qr) {
+		qnx_prof.redirects++;
+		QNX_PROBE2(redirect, s, qr->r->target);
+		s = qr->r->target;
+		gh = qr->target_hash;
+	}
+	gho = gh / (8*sizeof(size_t));
 	size_t ghm = 1ul << gh % (8*sizeof(size_t));
 	struct symdef def = {0};
 	struct dso **deps = use_deps ? dso->deps : 0;
+	uint64_t bm = bundle ? bundle_sym_mask(s, gh) : -1;
 	for (; dso; dso=use_deps ? *deps++ : dso->syms_next) {
 		Sym *sym;
+		if (dso->bundle_idx-1 < 64 && !(bm >> dso->bundle_idx-1 & 1)) {
+			qnx_prof.bundle_skips++;
+			continue;
+		}
 		if ((ght = dso->ghashtab)) {
 			sym = gnu_lookup_filtered(gh, ght, dso, s, gho, ghm);
+		} else if (dso->sysv_bloom) {
+			sym = sysv_lookup_filtered(s, &h, gh, dso, gho, ghm);
 		} else {
 			if (!h) h = sysv_hash(s);
 			sym = sysv_lookup(s, h, dso);
 		}
-		if (!sym) continue;
-		if (!sym->st_shndx)
-			if (need_def || (sym->st_info&0xf) == STT_TLS
-			    || ARCH_SYM_REJECT_UND(sym))
-				continue;
-		if (!sym->st_value)
-			if ((sym->st_info&0xf) != STT_TLS)
-				continue;
-		if (!(1<<(sym->st_info&0xf) & OK_TYPES)) continue;
-		if (!(1<<(sym->st_info>>4) & OK_BINDS)) continue;
+		if (!sym || !sym_usable(sym, need_def)) continue;
 		def.sym = sym;
 		def.dso = dso;
 		break;
 	}
+	if (qr) qnx_shimstats_bind(qr, &def);
 	return def;
 }
 
 static struct symdef find_sym(struct dso *dso, const char *s, int need_def)
 {
-	return find_sym2(dso, s, need_def, 0);
+	return find_sym2(dso, s, gnu_hash(s), need_def, 0);
+}
+
+static void qnx_shimstats_init(void)
+{
+	static Sym syms[QNX_REDIRECT_MAX_SLOTS/2];
+	const struct qnx_redirect *r = __start_qnx_redirect;
+	size_t n = __stop_qnx_redirect - r, i;
+	struct symdef def;
+	void *w;
+
+	if (__qnx_shimstats_init(r, n)) return;
+	for (i=0; i<n; i++) {
+		def = find_sym(&ldso, r[i].target, 1);
+		if (!def.sym || def.dso != &ldso || (def.sym->st_info&0xf) != STT_FUNC)
+			continue;
+		if (!(w = __qnx_shimstats_wrap(i, laddr(def.dso, def.sym->st_value))))
+			continue;
+		syms[i] = *def.sym;
+		syms[i].st_value = (size_t)w - (size_t)ldso.base;
+	}
+	qnx_shimstats_syms = syms;
+}
+
+/* Resolution cache for the startup relocation pass. The global symbol
+ * list does not change between the start and end of the initial
+ * reloc_all calls, so a definition found for (name, ctx, need_def) can
+ * be reused by every later DSO importing the same name. Only hits are
+ * cached; misses go on to the lfs64 and error paths as usual. */
+#define SYMCACHE_SIZE 4096
+
+static struct symcache_entry {
+	uint32_t hash;
+	int need_def;
+	const char *name;
+	struct dso *ctx;
+	struct symdef def;
+} *symcache;
+
+static void symcache_init(void)
+{
+	void *p = mmap(0, SYMCACHE_SIZE * sizeof *symcache,
+		PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (p != MAP_FAILED) symcache = p;
+}
+
+static void symcache_drop(void)
+{
+	if (!symcache) return;
+	munmap(symcache, SYMCACHE_SIZE * sizeof *symcache);
+	symcache = 0;
+}
+
+static struct symdef find_sym_cached(struct dso *ctx, const char *s, int need_def)
+{
+	uint32_t gh = gnu_hash(s);
+	struct symcache_entry *e;
+	struct symdef def;
+
+	if (!symcache) return find_sym2(ctx, s, gh, need_def, 0);
+	e = &symcache[(gh ^ need_def) % SYMCACHE_SIZE];
+	if (e->def.sym && e->hash == gh && e->ctx == ctx
+	    && e->need_def == need_def
+	    && (e->name == s || !strcmp(e->name, s)))
+		return e->def;
+	def = find_sym2(ctx, s, gh, need_def, 0);
+	if (def.sym) *e = (struct symcache_entry){
+		.hash = gh, .need_def = need_def,
+		.name = s, .ctx = ctx, .def = def,
+	};
+	return def;
 }
 
 static struct symdef get_lfs64(const char *name)
@@ -410,6 +801,212 @@ nomatch:
 	return (struct symdef){ 0 };
 }
 
+/* Census mode (LD_QNX_CENSUS=<fd>). A symbol no DSO defines does not
+ * fail the load: it is reported to <fd> as
+ *   qnxcensus missing <dso> <symbol> func|object
+ * and bound, for data, to a zeroed block and, for functions, to a
+ * trampoline of its own, so one run lists every missing symbol of the
+ * program and it keeps running past calls to them. COPY and TLS
+ * relocations against missing symbols are left alone.
+ *
+ * Each trampoline loads its own address into %rdi and jumps to
+ * census_call, which counts the call in the entry and, on the first call
+ * in the process tree, records the callers and reports
+ *   qnxcensus call <dso> <symbol> from <obj>+<off> ...
+ * It then crashes or, with LD_QNX_CENSUS_POLICY=enosys, returns -1 with
+ * errno set to ENOSYS (89 in QNX's view of errno). Entries live in a
+ * shared mapping, backed by LD_QNX_CENSUS_TABLE=<file> if set, so
+ * counts from forked children and from earlier runs add up; census.py
+ * reads the file. Trampolines are
+ * written through a second, writable mapping of the same memfd, so the
+ * executable one never changes protection while other threads run. */
+#define CENSUS_MAX 1024
+#define CENSUS_STUB 64
+
+struct census_entry {
+	volatile int calls;
+	int unused;
+	char dso[64];
+	char name[120];
+	char callers[320];
+};
+
+struct census_table {
+	char magic[8];
+	volatile int lock;
+	volatile int count;
+	char pad[48];
+	struct census_entry e[CENSUS_MAX];
+};
+
+/* A trampoline slot: its code, then what census_call and census_def
+ * need. Read through census_rx, written through census_rw. */
+struct census_stub {
+	unsigned char code[24];
+	struct census_entry *e;
+	Sym sym;
+	volatile int called;
+};
+
+static struct census_table *census_tab;
+static unsigned char *census_rw, *census_rx;
+static volatile int census_nstubs;
+static int census_abort = 1;
+static char *census_table_path;
+
+static void *addr2dso(size_t);
+
+static void census_trap(void)
+{
+	if (qnx_census_fd >= 0)
+		dprintf(qnx_census_fd, "qnxcensus call of a missing function\n");
+	a_crash();
+}
+
+static const char *census_base(const char *name)
+{
+	const char *s = strrchr(name, '/');
+	return s ? s+1 : name;
+}
+
+static long census_call(struct census_stub *st)
+{
+	size_t *fp = __builtin_frame_address(0), *prev = fp;
+	size_t ra = (size_t)__builtin_return_address(0);
+	struct census_entry *e = st->e;
+	struct dso *p;
+	char *c = e->callers;
+	int i;
+
+	a_inc(&e->calls);
+	st = (void *)(census_rw + ((unsigned char *)st - census_rx));
+	if (!a_cas(&st->called, 0, 1)) {
+		/* Callers from the frame pointer chain while it looks
+		 * like one; QNX code often has none. */
+		for (i=0; i<8 && (p = addr2dso(ra)); i++) {
+			size_t n = e->callers + sizeof e->callers - c;
+			int r = snprintf(c, n, "%s%s+%#zx", i ? " " : "",
+				census_base(p->name), ra - (size_t)p->base);
+			if (r < 0 || r >= n) break;
+			c += r;
+			fp = (size_t *)*fp;
+			if (fp <= prev || (size_t)fp - (size_t)prev > 1<<20
+			    || ((size_t)fp & 7)) break;
+			prev = fp;
+			ra = fp[1];
+		}
+		dprintf(qnx_census_fd, "qnxcensus call %s %s from %s\n",
+			e->dso, e->name, e->callers);
+	}
+	if (census_abort) a_crash();
+	errno = ENOSYS;
+	return -1;
+}
+
+static int census_init(void)
+{
+	static int done;
+	struct census_table *t = MAP_FAILED;
+	size_t stubs = CENSUS_MAX * CENSUS_STUB;
+	int fd;
+
+	if (done) return census_rx != 0;
+	done = 1;
+	if (census_table_path) {
+		fd = open(census_table_path, O_RDWR|O_CREAT|O_CLOEXEC, 0644);
+		if (fd >= 0 && !ftruncate(fd, sizeof *t))
+			t = mmap(0, sizeof *t, PROT_READ|PROT_WRITE,
+				MAP_SHARED, fd, 0);
+		if (fd >= 0) close(fd);
+	} else {
+		t = mmap(0, sizeof *t, PROT_READ|PROT_WRITE,
+			MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	}
+	if (t == MAP_FAILED) return 0;
+	if (memcmp(t->magic, "qnxcns1", 8)) {
+		memset(t, 0, sizeof *t);
+		memcpy(t->magic, "qnxcns1", 8);
+	}
+	census_tab = t;
+#ifdef __x86_64__
+	if ((fd = memfd_create("qnxcensus", MFD_CLOEXEC)) < 0) return 0;
+	if (!ftruncate(fd, stubs)) {
+		census_rw = mmap(0, stubs, PROT_READ|PROT_WRITE,
+			MAP_SHARED, fd, 0);
+		census_rx = mmap(0, stubs, PROT_READ|PROT_EXEC,
+			MAP_SHARED, fd, 0);
+	}
+	close(fd);
+	if (census_rw == MAP_FAILED || census_rx == MAP_FAILED)
+		census_rw = census_rx = 0;
+#endif
+	return census_rx != 0;
+}
+
+/* The trampoline of a missing function, with its table entry, or 0. */
+static Sym *census_stub(struct dso *dso, const char *name)
+{
+	struct census_table *t = census_tab;
+	struct census_entry *e = 0;
+	struct census_stub *st = 0;
+	unsigned char *c, *rx;
+	int i;
+
+	while (a_swap(&t->lock, 1)) a_spin();
+	for (i=0; i<t->count && !e; i++)
+		if (!strncmp(t->e[i].name, name, sizeof t->e[i].name - 1)
+		    && !strncmp(t->e[i].dso, dso->name, sizeof t->e[i].dso - 1))
+			e = &t->e[i];
+	if (!e && t->count < CENSUS_MAX) {
+		e = &t->e[t->count++];
+		snprintf(e->dso, sizeof e->dso, "%s", dso->name);
+		snprintf(e->name, sizeof e->name, "%s", name);
+	}
+	for (i=0; e && i<census_nstubs; i++)
+		if (((struct census_stub *)(census_rx + i*CENSUS_STUB))->e == e)
+			st = (void *)(census_rx + i*CENSUS_STUB);
+	if (e && !st && census_nstubs < CENSUS_MAX) {
+		rx = census_rx + census_nstubs*CENSUS_STUB;
+		st = (void *)(census_rw + census_nstubs*CENSUS_STUB);
+		c = st->code;
+		/* movabs $rx,%rdi; jmp *0(%rip); .quad census_call */
+		*c++ = 0x48; *c++ = 0xbf;
+		memcpy(c, &rx, 8); c += 8;
+		*c++ = 0xff; *c++ = 0x25;
+		memset(c, 0, 4); c += 4;
+		memcpy(c, &(void *){ (void *)census_call }, 8);
+		st->e = e;
+		st->sym.st_value = (size_t)rx - (size_t)ldso.base;
+		st->sym.st_info = STT_FUNC;
+		census_nstubs++;
+		st = (void *)rx;
+	}
+	a_store(&t->lock, 0);
+	return st ? &st->sym : 0;
+}
+
+static struct symdef census_def(struct dso *dso, const char *name, Sym *sym)
+{
+	static Sym func, object;
+	static size_t zero[64];
+	int obj = (sym->st_info&0xf) == STT_OBJECT;
+	Sym *stub = 0;
+
+	dprintf(qnx_census_fd, "qnxcensus missing %s %s %s\n",
+		dso->name, name, obj ? "object" : "func");
+	if ((sym->st_info&0xf) == STT_TLS) return (struct symdef){ 0 };
+	if (obj) {
+		object.st_value = (size_t)zero - (size_t)ldso.base;
+		return (struct symdef){ .dso = &ldso, .sym = &object };
+	}
+	if (census_init()) stub = census_stub(dso, name);
+	if (!stub) {
+		func.st_value = (size_t)census_trap - (size_t)ldso.base;
+		stub = &func;
+	}
+	return (struct symdef){ .dso = &ldso, .sym = stub };
+}
+
 static void do_relocs(struct dso *dso, size_t *rel, size_t rel_size, size_t stride)
 {
 	unsigned char *base = dso->base;
@@ -434,6 +1031,7 @@ static void do_relocs(struct dso *dso, size_t *rel, size_t rel_size, size_t stri
 		skip_relative = 1;
 	}
 
+	QNX_PROBE2(relocs, dso->name, rel_size / (stride*sizeof(size_t)));
 	for (; rel_size; rel+=stride, rel_size-=stride*sizeof(size_t)) {
 		if (skip_relative && IS_RELATIVE(rel[1], dso->syms)) continue;
 		type = R_TYPE(rel[1]);
@@ -462,7 +1060,7 @@ static void do_relocs(struct dso *dso, size_t *rel, size_t rel_size, size_t stri
 			ctx = type==REL_COPY ? head->syms_next : head;
 			def = (sym->st_info>>4) == STB_LOCAL
 				? (struct symdef){ .dso = dso, .sym = sym }
-				: find_sym(ctx, name, type==REL_PLT);
+				: find_sym_cached(ctx, name, type==REL_PLT);
 			if (!def.sym) def = get_lfs64(name);
 			if (!def.sym && (sym->st_shndx != SHN_UNDEF
 			    || sym->st_info>>4 != STB_WEAK)) {
@@ -473,10 +1071,14 @@ static void do_relocs(struct dso *dso, size_t *rel, size_t rel_size, size_t stri
 					dso->lazy_cnt++;
 					continue;
 				}
-				error("Error relocating %s: %s: symbol not found",
-					dso->name, name);
-				if (runtime) longjmp(*rtld_fail, 1);
-				continue;
+				if (qnx_census_fd < 0) {
+					error("Error relocating %s: %s: symbol not found",
+						dso->name, name);
+					if (runtime) longjmp(*rtld_fail, 1);
+					continue;
+				}
+				def = census_def(dso, name, sym);
+				if (!def.sym || type == REL_COPY) continue;
 			}
 		} else {
 			sym = 0;
@@ -588,6 +1190,7 @@ static void do_relocs(struct dso *dso, size_t *rel, size_t rel_size, size_t stri
 			continue;
 		}
 	}
+	QNX_PROBE1(relocs_done, dso->name);
 }
 
 static void do_relr_relocs(struct dso *dso, size_t *relr, size_t relr_size)
@@ -715,6 +1318,23 @@ static void unmap_library(struct dso *dso)
 	}
 }
 
+/* LD_QNX_HUGEPAGE: place a relocatable object so that its load base is
+ * 2M aligned. Text segments, whose file offset equals their address
+ * offset in usual linker layouts, then start on a huge page boundary
+ * and can be backed by transparent huge pages (MADV_HUGEPAGE below).
+ * A suitably aligned range is found by reserving 2M extra and freeing
+ * it again; the result is only a hint to the real mapping. */
+#define HUGE_ALIGN (2*1024*1024UL)
+
+static size_t huge_hint(size_t addr_min, size_t map_len)
+{
+	unsigned char *r = mmap(0, map_len + HUGE_ALIGN, PROT_NONE,
+		MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (r == MAP_FAILED) return 0;
+	munmap(r, map_len + HUGE_ALIGN);
+	return ((size_t)r - addr_min + HUGE_ALIGN-1 & -HUGE_ALIGN) + addr_min;
+}
+
 static void *map_library(int fd, struct dso *dso)
 {
 	Ehdr buf[(896+sizeof(Ehdr))/sizeof(Ehdr)];
@@ -731,8 +1351,10 @@ static void *map_library(int fd, struct dso *dso)
 	size_t dyn=0;
 	size_t tls_image=0;
 	size_t i;
+	int populate = qnx_populate ? MAP_POPULATE : 0;
 
-	ssize_t l = read(fd, buf, sizeof buf);
+	/* Members of a bundle start map_bias bytes into fd. */
+	ssize_t l = pread(fd, buf, sizeof buf, map_bias);
 	eh = buf;
 	if (l<0) return 0;
 	if (l<sizeof *eh || (eh->e_type != ET_DYN && eh->e_type != ET_EXEC))
@@ -741,12 +1363,12 @@ static void *map_library(int fd, struct dso *dso)
 	if (phsize > sizeof buf - sizeof *eh) {
 		allocated_buf = malloc(phsize);
 		if (!allocated_buf) return 0;
-		l = pread(fd, allocated_buf, phsize, eh->e_phoff);
+		l = pread(fd, allocated_buf, phsize, eh->e_phoff + map_bias);
 		if (l < 0) goto error;
 		if (l != phsize) goto noexec;
 		ph = ph0 = allocated_buf;
 	} else if (eh->e_phoff + phsize > l) {
-		l = pread(fd, buf+1, phsize, eh->e_phoff);
+		l = pread(fd, buf+1, phsize, eh->e_phoff + map_bias);
 		if (l < 0) goto error;
 		if (l != phsize) goto noexec;
 		ph = ph0 = (void *)(buf + 1);
@@ -797,7 +1419,7 @@ static void *map_library(int fd, struct dso *dso)
 				((ph->p_flags&PF_X) ? PROT_EXEC : 0));
 			map = mmap(0, ph->p_memsz + (ph->p_vaddr & PAGE_SIZE-1),
 				prot, MAP_PRIVATE,
-				fd, ph->p_offset & -PAGE_SIZE);
+				fd, (ph->p_offset & -PAGE_SIZE) + map_bias);
 			if (map == MAP_FAILED) {
 				unmap_library(dso);
 				goto error;
@@ -830,6 +1452,8 @@ static void *map_library(int fd, struct dso *dso)
 	addr_min &= -PAGE_SIZE;
 	off_start &= -PAGE_SIZE;
 	map_len = addr_max - addr_min + off_start;
+	if (qnx_hugepage && eh->e_type == ET_DYN && !map_hint && !DL_NOMMU_SUPPORT)
+		map_hint = huge_hint(addr_min, map_len);
 	/* The first time, we map too much, possibly even more than
 	 * the length of the file. This is okay because we will not
 	 * use the invalid part; we just need to reserve the right
@@ -837,8 +1461,9 @@ static void *map_library(int fd, struct dso *dso)
 	map = DL_NOMMU_SUPPORT
 		? mmap((void *)addr_min, map_len, PROT_READ|PROT_WRITE|PROT_EXEC,
 			MAP_PRIVATE|MAP_ANONYMOUS, -1, 0)
-		: mmap((void *)addr_min, map_len, prot,
-			MAP_PRIVATE, fd, off_start);
+		: mmap((void *)(eh->e_type == ET_DYN && map_hint ? map_hint : addr_min),
+			map_len, prot, MAP_PRIVATE, fd, off_start + map_bias);
+	map_hint = 0;
 	if (map==MAP_FAILED) goto error;
 	dso->map = map;
 	dso->map_len = map_len;
@@ -868,15 +1493,18 @@ static void *map_library(int fd, struct dso *dso)
 		prot = (((ph->p_flags&PF_R) ? PROT_READ : 0) |
 			((ph->p_flags&PF_W) ? PROT_WRITE: 0) |
 			((ph->p_flags&PF_X) ? PROT_EXEC : 0));
-		/* Reuse the existing mapping for the lowest-address LOAD */
-		if ((ph->p_vaddr & -PAGE_SIZE) != addr_min || DL_NOMMU_SUPPORT)
-			if (mmap_fixed(base+this_min, this_max-this_min, prot, MAP_PRIVATE|MAP_FIXED, fd, off_start) == MAP_FAILED)
+		/* Reuse the existing mapping for the lowest-address LOAD,
+		 * unless it has to be remapped to prefault it. */
+		if ((ph->p_vaddr & -PAGE_SIZE) != addr_min || DL_NOMMU_SUPPORT || qnx_populate)
+			if (mmap_fixed(base+this_min, this_max-this_min, prot, MAP_PRIVATE|MAP_FIXED|populate, fd, off_start + map_bias) == MAP_FAILED)
 				goto error;
+		if (qnx_hugepage && (prot & PROT_EXEC))
+			madvise(base+this_min, this_max-this_min, MADV_HUGEPAGE);
 		if (ph->p_memsz > ph->p_filesz && (ph->p_flags&PF_W)) {
 			size_t brk = (size_t)base+ph->p_vaddr+ph->p_filesz;
 			size_t pgbrk = brk+PAGE_SIZE-1 & -PAGE_SIZE;
 			memset((void *)brk, 0, pgbrk-brk & PAGE_SIZE-1);
-			if (pgbrk-(size_t)base < this_max && mmap_fixed((void *)pgbrk, (size_t)base+this_max-pgbrk, prot, MAP_PRIVATE|MAP_FIXED|MAP_ANONYMOUS, -1, 0) == MAP_FAILED)
+			if (pgbrk-(size_t)base < this_max && mmap_fixed((void *)pgbrk, (size_t)base+this_max-pgbrk, prot, MAP_PRIVATE|MAP_FIXED|MAP_ANONYMOUS|populate, -1, 0) == MAP_FAILED)
 				goto error;
 		}
 	}
@@ -1055,6 +1683,39 @@ static void *dl_mmap(size_t n)
 	return (unsigned long)p > -4096UL ? 0 : p;
 }
 
+/* For a DSO with DT_HASH only: the bloom words, about 16 bits per
+ * symbol with two of them set, followed by each symbol's GNU hash, in
+ * one anonymous mapping. Without the memory the plain chain walk stays.
+ * As with ld, the second bit comes from the hash bits above those that
+ * pick the word and the first bit. */
+static void sysv_filter_build(struct dso *p)
+{
+	size_t nsym, nwords, i;
+	size_t *bloom;
+	uint32_t *hashes, shift;
+
+	if (p->ghashtab || !p->hashtab || (nsym = p->hashtab[1]) < 2) return;
+	for (nwords = 1, shift = sizeof(size_t) == 8 ? 6 : 5;
+	     nwords * 8*sizeof(size_t) < 16*nsym && shift < 31; nwords *= 2)
+		shift++;
+	bloom = dl_mmap(nwords*sizeof *bloom + nsym*sizeof *hashes);
+	if (!bloom) return;
+	hashes = (void *)(bloom + nwords);
+	for (i=1; i<nsym; i++) {
+		uint32_t h;
+		if (!p->syms[i].st_name || (p->versym && p->versym[i] < 0))
+			continue;
+		h = hashes[i] = gnu_hash(p->strings + p->syms[i].st_name);
+		bloom[h / (8*sizeof(size_t)) & nwords-1] |=
+			1ul << h % (8*sizeof(size_t))
+			| 1ul << (h >> shift) % (8*sizeof(size_t));
+	}
+	p->sysv_bloom = bloom;
+	p->sysv_bloom_mask = nwords-1;
+	p->sysv_bloom_shift = shift;
+	p->sysv_gnu_hashes = hashes;
+}
+
 static void makefuncdescs(struct dso *p)
 {
 	static int self_done;
@@ -1083,6 +1744,523 @@ static void makefuncdescs(struct dso *p)
 	}
 }
 
+/* Build <prefix>/etc/ld-musl-ARCH.<ext>, where <prefix> is the parent
+ * of the directory the dynamic linker was loaded from. */
+static void etc_ldso_file(char *buf, size_t n, const char *ext)
+{
+	char *prefix = 0;
+	size_t prefix_len;
+	if (ldso.name[0]=='/') {
+		char *s, *t, *z;
+		for (s=t=z=ldso.name; *s; s++)
+			if (*s=='/') z=t, t=s;
+		prefix_len = z-ldso.name;
+		if (prefix_len < PATH_MAX)
+			prefix = ldso.name;
+	}
+	if (!prefix) {
+		prefix = "";
+		prefix_len = 0;
+	}
+	snprintf(buf, n, "%.*s/etc/ld-musl-" LDSO_ARCH ".%s",
+		(int)prefix_len, prefix, ext);
+}
+
+/* Library path cache: a read-only index, generated by qol/mkldcache.py,
+ * from library names to absolute paths. It is consulted after
+ * LD_LIBRARY_PATH and before rpath and the system path, so the rpaths
+ * added by patch.sh no longer cost one open attempt per directory for
+ * every DT_NEEDED entry. Names missing from the cache, or whose cached
+ * path no longer exists, take the normal search. */
+#define LDCACHE_MAGIC 0x31434c51 /* "QLC1" */
+
+struct ldcache_hdr {
+	uint32_t magic, nbucket, nent, strsz;
+};
+
+struct ldcache_ent {
+	uint32_t hash, next, name, path;
+};
+
+static struct ldcache_hdr *ldcache;
+static char ldcache_checked;
+
+static void ldcache_open(void)
+{
+	char path[PATH_MAX + sizeof "/etc/ld-musl-" LDSO_ARCH ".cache"];
+	const char *file = env_ldcache;
+	struct ldcache_hdr *h;
+	struct stat st;
+	size_t need;
+	int fd;
+
+	ldcache_checked = 1;
+	if (!file) {
+		etc_ldso_file(path, sizeof path, "cache");
+		file = path;
+	}
+	if ((fd = open(file, O_RDONLY|O_CLOEXEC)) < 0) return;
+	if (fstat(fd, &st) || st.st_size < sizeof *h) goto out;
+	h = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (h == MAP_FAILED) goto out;
+	need = sizeof *h + 4*(size_t)h->nbucket
+		+ sizeof(struct ldcache_ent)*(size_t)h->nent + h->strsz;
+	if (h->magic != LDCACHE_MAGIC || !h->nbucket || !h->strsz
+	    || need != st.st_size || ((char *)h)[need-1]) {
+		munmap(h, st.st_size);
+		goto out;
+	}
+	ldcache = h;
+out:
+	close(fd);
+}
+
+static const char *ldcache_lookup(const char *name)
+{
+	uint32_t *buckets = (void *)(ldcache+1);
+	struct ldcache_ent *ents = (void *)(buckets + ldcache->nbucket);
+	const char *strings = (void *)(ents + ldcache->nent);
+	uint32_t h = gnu_hash(name), i, n;
+
+	for (i=buckets[h % ldcache->nbucket], n=0; i && n<ldcache->nent; n++) {
+		struct ldcache_ent *e = &ents[i-1];
+		if (i > ldcache->nent || e->name >= ldcache->strsz
+		    || e->path >= ldcache->strsz) return 0;
+		if (e->hash == h && !strcmp(strings+e->name, name))
+			return strings+e->path;
+		i = e->next;
+	}
+	return 0;
+}
+
+#ifdef __x86_64__
+/* LD_QNX_TLS_RELAX: what the linker does for executables, done at load
+ * time for the libraries loaded at startup. Their TLS offsets are fixed
+ * by then, so each general-dynamic access to a static TLS module,
+ *
+ *	data16 lea x@tlsgd(%rip),%rdi; data16 data16 rex.W call __tls_get_addr
+ *
+ * (or its call *__tls_get_addr@GOTPCREL(%rip) form, 16 bytes either
+ * way) is rewritten in place to the local-exec sequence
+ *
+ *	mov %fs:0,%rax; lea x@tpoff(%rax),%rax
+ *
+ * The sites are found by scanning executable segments for that lea,
+ * pointing at a GOT pair that a DTPMOD64 relocation filled; the pair
+ * gives the module and offset, already relocated. Text pages rewritten
+ * are no longer shared with other processes. */
+#define TLS_RELAX_MAX 1024
+
+static int cmp_addr(const void *a, const void *b)
+{
+	size_t x = *(const size_t *)a, y = *(const size_t *)b;
+	return (x > y) - (x < y);
+}
+
+/* The PT_LOAD segments of every loaded DSO sorted by address, for
+ * addr2dso and dladdr. It is rebuilt under the lock whenever dso_gen
+ * says the list has changed and published with a pointer store, so it
+ * is read without the lock, including from signal handlers; for the
+ * same reason an old index is never unmapped. A stale or missing index
+ * sends lookups back to the list walk. */
+static struct addr_index {
+	size_t gen, n;
+	struct addr_range {
+		size_t start, len;
+		struct dso *dso;
+	} r[];
+} *volatile addr_index;
+
+static void addr_index_update(void)
+{
+	struct addr_index *ix = addr_index;
+	struct dso *p;
+	size_t gen = dso_gen, n = 0;
+	Phdr *ph;
+	int i;
+
+	if (DL_FDPIC || (ix && ix->gen == gen)) return;
+	for (p=head; p; p=p->next)
+		for (ph=p->phdr, i=p->phnum; i; i--, ph=(void *)((char *)ph+p->phentsize))
+			n += ph->p_type == PT_LOAD && ph->p_memsz;
+	ix = dl_mmap(sizeof *ix + n*sizeof *ix->r);
+	if (!ix) return;
+	ix->gen = gen;
+	for (p=head; p; p=p->next)
+		for (ph=p->phdr, i=p->phnum; i; i--, ph=(void *)((char *)ph+p->phentsize))
+			if (ph->p_type == PT_LOAD && ph->p_memsz)
+				ix->r[ix->n++] = (struct addr_range){
+					(size_t)laddr(p, ph->p_vaddr), ph->p_memsz, p };
+	qsort(ix->r, ix->n, sizeof *ix->r, cmp_addr);
+	a_barrier();
+	addr_index = ix;
+}
+
+/* Zero when the index cannot answer for the current list. */
+static int addr_index_lookup(size_t a, struct dso **dso)
+{
+	struct addr_index *ix = addr_index;
+	size_t lo = 0, hi, mid;
+
+	if (!ix || ix->gen != dso_gen) return 0;
+	for (hi=ix->n; lo<hi; ) {
+		mid = lo + (hi-lo)/2;
+		if (ix->r[mid].start <= a) lo = mid+1;
+		else hi = mid;
+	}
+	*dso = lo && a-ix->r[lo-1].start < ix->r[lo-1].len ? ix->r[lo-1].dso : 0;
+	return 1;
+}
+
+/* The symbols dladdr can report, by address and then symbol index, so
+ * the nearest one is a binary search. Built on the first dladdr into
+ * the DSO and published with a CAS; the loser of a race unmaps its
+ * copy. */
+struct sym_index {
+	size_t n;
+	struct sym_addr {
+		size_t addr, sym;
+	} e[];
+};
+
+static int cmp_sym_addr(const void *a, const void *b)
+{
+	const struct sym_addr *x = a, *y = b;
+	if (x->addr != y->addr) return (x->addr > y->addr) - (x->addr < y->addr);
+	return (x->sym > y->sym) - (x->sym < y->sym);
+}
+
+static struct sym_index *sym_index_get(struct dso *p)
+{
+	struct sym_index *ix = p->sym_index, *old;
+	uint32_t nsym, i;
+	size_t n = 0, size;
+	Sym *sym = p->syms;
+
+	if (ix) return ix;
+	nsym = count_syms(p);
+	for (i=0; i<nsym; i++)
+		n += sym[i].st_value
+		  && (1<<(sym[i].st_info&0xf) & OK_TYPES)
+		  && (1<<(sym[i].st_info>>4) & OK_BINDS);
+	size = sizeof *ix + n*sizeof *ix->e;
+	ix = dl_mmap(size);
+	if (!ix) return 0;
+	for (i=0; i<nsym; i++)
+		if (sym[i].st_value
+		 && (1<<(sym[i].st_info&0xf) & OK_TYPES)
+		 && (1<<(sym[i].st_info>>4) & OK_BINDS))
+			ix->e[ix->n++] = (struct sym_addr){
+				(size_t)laddr(p, sym[i].st_value), i };
+	qsort(ix->e, ix->n, sizeof *ix->e, cmp_sym_addr);
+	a_barrier();
+	old = a_cas_p(&p->sym_index, 0, ix);
+	if (old) {
+		munmap(ix, size);
+		ix = old;
+	}
+	return ix;
+}
+
+static void tls_relax(struct dso *p)
+{
+	static size_t slots[TLS_RELAX_MAX];
+	static const unsigned char call[] = { 0x66, 0x66, 0x48, 0xe8 };
+	static const unsigned char gotcall[] = { 0x66, 0x48, 0xff, 0x15 };
+	size_t dyn[DYN_CNT], n = 0, i, *rel, *end;
+	Phdr *ph;
+
+	if (p == &ldso || !p->phdr) return;
+	decode_vec(p->dynv, dyn, DYN_CNT);
+	rel = laddr(p, dyn[DT_RELA]);
+	end = (size_t *)((char *)rel + dyn[DT_RELASZ]);
+	for (; dyn[DT_RELA] && rel < end && n < TLS_RELAX_MAX; rel += 3)
+		if (R_TYPE(rel[1]) == R_X86_64_DTPMOD64)
+			slots[n++] = (size_t)laddr(p, rel[0]);
+	if (!n) return;
+	qsort(slots, n, sizeof *slots, cmp_addr);
+
+	for (ph=p->phdr, i=p->phnum; i; i--, ph=(void *)((char *)ph+p->phentsize)) {
+		unsigned char *c, *seg, *lim;
+		size_t pgs = 0, pge = 0;
+		if (ph->p_type != PT_LOAD || !(ph->p_flags & PF_X)) continue;
+		seg = laddr(p, ph->p_vaddr);
+		lim = seg + ph->p_filesz;
+		for (c=seg; lim-c >= 16; c++) {
+			size_t t, *got;
+			int32_t disp, v;
+			struct dso *m;
+			if (!(c = memchr(c, 0x66, lim-c-15))) break;
+			if (c[1] != 0x48 || c[2] != 0x8d || c[3] != 0x3d) continue;
+			if (memcmp(c+8, call, 4) && memcmp(c+8, gotcall, 4)) continue;
+			memcpy(&disp, c+4, 4);
+			t = (size_t)c + 8 + disp;
+			if (!bsearch(&t, slots, n, sizeof *slots, cmp_addr)) continue;
+			got = (size_t *)t;
+			if (!got[0] || got[0] > static_tls_cnt) continue;
+			for (m=head; m && m->tls_id != got[0]; m=m->next);
+			if (!m || got[1] - m->tls.offset + 0x80000000ul > 0xfffffffful)
+				continue;
+			if (!pge) {
+				pgs = (size_t)seg & -PAGE_SIZE;
+				pge = (size_t)lim + PAGE_SIZE-1 & -PAGE_SIZE;
+				if (mprotect((void *)pgs, pge-pgs, PROT_READ|PROT_WRITE))
+					return;
+			}
+			v = got[1] - m->tls.offset;
+			memcpy(c, "\x64\x48\x8b\x04\x25\0\0\0\0\x48\x8d\x80", 12);
+			memcpy(c+12, &v, 4);
+			qnx_prof.tls_relaxed++;
+			c += 15;
+		}
+		if (pge) mprotect((void *)pgs, pge-pgs, PROT_READ|PROT_EXEC
+			| (ph->p_flags & PF_W ? PROT_WRITE : 0));
+	}
+}
+#endif
+
+/* Lazy PLT binding (LD_QNX_LAZY). Instead of resolving JMPREL at load
+ * time, each GOT slot is pointed back at its PLT stub and GOT[1] and
+ * GOT[2] are set up so that the first call enters
+ * __dl_lazy_plt_resolve, which resolves the symbol, QNX redirects
+ * included, and patches the slot. DSOs linked with -z now, or whose
+ * JMPREL holds anything but JUMP_SLOT entries, are bound eagerly. */
+static int lazy_plt_init(struct dso *p, size_t *dyn, int restored)
+{
+	size_t *rel = laddr(p, dyn[DT_JMPREL]), rel_size = dyn[DT_PLTRELSZ];
+	size_t stride = 2+(dyn[DT_PLTREL]==DT_RELA), flags1 = 0, i;
+	size_t *got = laddr(p, dyn[DT_PLTGOT]);
+
+	if (!DL_LAZY_PLT || !dyn[DT_PLTGOT] || !rel_size) return 0;
+	search_vec(p->dynv, &flags1, DT_FLAGS_1);
+	if ((dyn[0] & (1UL<<DT_BIND_NOW)) || (dyn[DT_FLAGS] & DF_BIND_NOW)
+	    || (flags1 & DF_1_NOW))
+		return 0;
+	for (i=0; i<rel_size/sizeof(size_t); i+=stride)
+		if (R_TYPE(rel[i+1]) != REL_PLT) return 0;
+	/* Slots restored from a snapshot already hold rebased stubs. */
+	if (!restored) for (i=0; i<rel_size/sizeof(size_t); i+=stride)
+		*(size_t *)laddr(p, rel[i]) += (size_t)p->base;
+	p->plt_rel = rel;
+	p->plt_rel_stride = stride;
+	got[1] = (size_t)p;
+	got[2] = (size_t)__dl_lazy_plt_resolve;
+	return 1;
+}
+
+static void run_deferred_ctors(struct dso *);
+
+hidden void *__dl_lazy_plt_fixup(void *dso, size_t idx)
+{
+	struct dso *p = dso;
+	size_t *rel = p->plt_rel + idx*p->plt_rel_stride;
+	Sym *sym = p->syms + R_SYM(rel[1]);
+	const char *name = p->strings + sym->st_name;
+	size_t addend = p->plt_rel_stride > 2 ? rel[2] : 0;
+	struct symdef def;
+
+	pthread_rwlock_rdlock(&lock);
+	def = find_sym(head, name, 1);
+	if (!def.sym) def = find_sym2(p, name, gnu_hash(name), 1, 1);
+	pthread_rwlock_unlock(&lock);
+	if (!def.sym) {
+		dprintf(2, "Error relocating %s: %s: symbol not found\n",
+			p->name, name);
+		a_crash();
+	}
+	if (def.dso->ctor_deferred) run_deferred_ctors(def.dso);
+	void *target = (char *)laddr(def.dso, def.sym->st_value) + addend;
+	*(void **)laddr(p, rel[0]) = target;
+	return target;
+}
+
+/* Snapshot startup mode (LD_QNX_SNAPSHOT=file). After the initial
+ * relocation pass the contents of every writable PT_LOAD segment
+ * outside libc are written to the file, together with the identity and
+ * load address of each DSO. A later run that maps every DSO at the same
+ * address (requested via map_hint, so this needs ASLR disabled) copies
+ * the segments back instead of processing relocations. Only the exact
+ * segment extent is restored: the partial pages around it have already
+ * been donated to malloc by reclaim_gaps. Any change of inode, device,
+ * mtime, load order or address invalidates the snapshot, which is then
+ * rewritten. libc itself is always relocated normally, since its data
+ * is live by this point. */
+#define QNX_SNAP_MAGIC 0x3150414e534c4f51ULL /* "QOLSNAP1" */
+
+struct qnx_snap_hdr {
+	uint64_t magic;
+	uint64_t ldso_base, lazy;
+	uint64_t dso_cnt, seg_cnt;
+};
+
+struct qnx_snap_dso {
+	uint64_t dev, ino;
+	int64_t mtime_sec, mtime_nsec;
+	uint64_t base;
+};
+
+struct qnx_snap_seg {
+	uint64_t addr, len, off;
+};
+
+#define snap_dsos(h) ((struct qnx_snap_dso *)((h)+1))
+#define snap_segs(h) ((struct qnx_snap_seg *)(snap_dsos(h)+(h)->dso_cnt))
+
+static int snap_eligible(struct dso *p)
+{
+	return p != &ldso && !p->relocated;
+}
+
+static void snapshot_open(void)
+{
+	struct stat st;
+	struct qnx_snap_hdr *h;
+	int fd = open(qnx_snapshot_path, O_RDONLY|O_CLOEXEC);
+	if (fd < 0) return;
+	if (fstat(fd, &st) || st.st_size < sizeof *h) goto out;
+	h = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (h == MAP_FAILED) goto out;
+	if (h->magic != QNX_SNAP_MAGIC || h->ldso_base != (size_t)ldso.base
+	    || h->lazy != qnx_lazy
+	    || h->dso_cnt > st.st_size / sizeof(struct qnx_snap_dso)
+	    || h->seg_cnt > st.st_size / sizeof(struct qnx_snap_seg)
+	    || (char *)(snap_segs(h)+h->seg_cnt) > (char *)h + st.st_size) {
+		munmap(h, st.st_size);
+		goto out;
+	}
+	qnx_snap = h;
+	qnx_snap_len = st.st_size;
+out:
+	close(fd);
+}
+
+static void snapshot_close(void)
+{
+	if (qnx_snap) munmap(qnx_snap, qnx_snap_len);
+	qnx_snap = 0;
+}
+
+/* Ask map_library for the address this file had when the snapshot was
+ * taken, so that the recorded relocated segments are valid again. */
+static void snapshot_hint(const struct stat *st)
+{
+	struct qnx_snap_dso *d = snap_dsos(qnx_snap);
+	for (size_t i=0; i<qnx_snap->dso_cnt; i++)
+		if (d[i].dev == st->st_dev && d[i].ino == st->st_ino) {
+			map_hint = d[i].base;
+			return;
+		}
+}
+
+static int snap_dso_match(struct dso *p, const struct qnx_snap_dso *d)
+{
+	return d->dev == p->dev && d->ino == p->ino
+		&& d->mtime_sec == p->mtime.tv_sec
+		&& d->mtime_nsec == p->mtime.tv_nsec
+		&& d->base == (size_t)p->map;
+}
+
+static int snapshot_apply(struct dso *head)
+{
+	struct qnx_snap_dso *d = snap_dsos(qnx_snap);
+	struct qnx_snap_seg *g = snap_segs(qnx_snap);
+	struct dso *p;
+	size_t i = 0;
+
+	for (p=head; p; p=p->next) {
+		if (!snap_eligible(p)) continue;
+		if (i == qnx_snap->dso_cnt || !snap_dso_match(p, d+i)) return 0;
+		i++;
+	}
+	if (i != qnx_snap->dso_cnt) return 0;
+	for (i=0; i<qnx_snap->seg_cnt; i++)
+		if (g[i].off > qnx_snap_len || g[i].len > qnx_snap_len - g[i].off)
+			return 0;
+	for (i=0; i<qnx_snap->seg_cnt; i++)
+		memcpy((void *)g[i].addr, (char *)qnx_snap + g[i].off, g[i].len);
+	for (p=head; p; p=p->next) {
+		if (!snap_eligible(p)) continue;
+		/* GOT[1] points at the dso, which need not have the same
+		 * address as when the snapshot was taken. */
+		if (qnx_lazy) {
+			size_t dyn[DYN_CNT];
+			decode_vec(p->dynv, dyn, DYN_CNT);
+			lazy_plt_init(p, dyn, 1);
+		}
+		if (p->relro_start != p->relro_end)
+			mprotect(laddr(p, p->relro_start),
+				p->relro_end-p->relro_start, PROT_READ);
+		p->relocated = 1;
+	}
+	return 1;
+}
+
+static int write_all(int fd, const void *p, size_t n)
+{
+	for (ssize_t r; n; p=(char *)p+r, n-=r)
+		if ((r = write(fd, p, n)) < 0 && errno != EINTR) return -1;
+		else if (r < 0) r = 0;
+	return 0;
+}
+
+/* Must be called right after the initial relocation pass, before any
+ * constructor can modify the recorded pages. */
+static void snapshot_save(struct dso *head, struct dso *end)
+{
+	struct qnx_snap_hdr h = {
+		.magic = QNX_SNAP_MAGIC,
+		.ldso_base = (size_t)ldso.base,
+		.lazy = qnx_lazy,
+	};
+	struct dso *p;
+	size_t i, j, off;
+	Phdr *ph;
+
+	for (p=head; p!=end; p=p->next) {
+		if (p == &ldso) continue;
+		h.dso_cnt++;
+		for (j=p->phnum, ph=p->phdr; j--; ph=(void *)((char *)ph+p->phentsize))
+			if (ph->p_type == PT_LOAD && (ph->p_flags & PF_W)) h.seg_cnt++;
+	}
+
+	struct qnx_snap_dso d[h.dso_cnt+1];
+	struct qnx_snap_seg g[h.seg_cnt+1];
+	off = sizeof h + sizeof *d * h.dso_cnt + sizeof *g * h.seg_cnt;
+	for (p=head, i=j=0; p!=end; p=p->next) {
+		size_t k;
+		if (p == &ldso) continue;
+		d[i++] = (struct qnx_snap_dso){
+			.dev = p->dev, .ino = p->ino,
+			.mtime_sec = p->mtime.tv_sec, .mtime_nsec = p->mtime.tv_nsec,
+			.base = (size_t)p->map,
+		};
+		for (k=p->phnum, ph=p->phdr; k--; ph=(void *)((char *)ph+p->phentsize)) {
+			if (ph->p_type != PT_LOAD || !(ph->p_flags & PF_W)) continue;
+			g[j++] = (struct qnx_snap_seg){
+				.addr = (size_t)laddr(p, ph->p_vaddr),
+				.len = ph->p_memsz, .off = off,
+			};
+			off += ph->p_memsz;
+		}
+	}
+
+	size_t l = strlen(qnx_snapshot_path);
+	char tmp[l + sizeof ".tmp"];
+	memcpy(tmp, qnx_snapshot_path, l);
+	memcpy(tmp+l, ".tmp", sizeof ".tmp");
+	int fd = open(tmp, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0644);
+	if (fd < 0) return;
+	if (write_all(fd, &h, sizeof h) || write_all(fd, d, sizeof *d * h.dso_cnt)
+	    || write_all(fd, g, sizeof *g * h.seg_cnt)) goto fail;
+	for (j=0; j<h.seg_cnt; j++)
+		if (write_all(fd, (void *)g[j].addr, g[j].len)) goto fail;
+	if (close(fd) || rename(tmp, qnx_snapshot_path)) unlink(tmp);
+	return;
+fail:
+	close(fd);
+	unlink(tmp);
+}
+
 static struct dso *load_library(const char *name, struct dso *needed_by)
 {
 	char buf[2*NAME_MAX+2];
@@ -1094,6 +2272,7 @@ static struct dso *load_library(const char *name, struct dso *needed_by)
 	size_t alloc_size;
 	int n_th = 0;
 	int is_self = 0;
+	int member = -1;
 
 	if (!*name) {
 		errno = EINVAL;
@@ -1132,10 +2311,23 @@ static struct dso *load_library(const char *name, struct dso *needed_by)
 			tail->next = &ldso;
 			ldso.prev = tail;
 			tail = &ldso;
+			dso_gen++;
 		}
 		return &ldso;
 	}
-	if (strchr(name, '/')) {
+	if (bundle && (member = bundle_find(name)) >= 0) {
+		struct bundle_ent *e = bundle_ents(bundle)+member;
+		for (p=head->next; p; p=p->next)
+			if (p->bundle_idx == member+1 || (p->shortname
+			    && !strcmp(p->shortname, name)))
+				return p;
+		if (snprintf(buf, sizeof buf, "%s/%s", bundle_path,
+		    bundle_strings(bundle)+e->name) >= sizeof buf)
+			return 0;
+		pathname = buf;
+		fd = bundle_fd;
+		map_bias = e->off;
+	} else if (strchr(name, '/')) {
 		pathname = name;
 		fd = open(name, O_RDONLY|O_CLOEXEC);
 	} else {
@@ -1148,6 +2340,16 @@ static struct dso *load_library(const char *name, struct dso *needed_by)
 		if (strlen(name) > NAME_MAX) return 0;
 		fd = -1;
 		if (env_path) fd = path_open(name, env_path, buf, sizeof buf);
+		if (fd == -1 && !ldcache_checked) ldcache_open();
+		if (fd == -1 && ldcache) {
+			const char *cached = ldcache_lookup(name);
+			size_t l = cached ? strlen(cached) : 0;
+			if (l && l < sizeof buf) {
+				memcpy(buf, cached, l+1);
+				fd = open(buf, O_RDONLY|O_CLOEXEC);
+				if (fd < 0) fd = -1;
+			}
+		}
 		for (p=needed_by; fd == -1 && p; p=p->needed_by) {
 			if (fixup_rpath(p, buf, sizeof buf) < 0)
 				fd = -2; /* Inhibit further search. */
@@ -1156,25 +2358,9 @@ static struct dso *load_library(const char *name, struct dso *needed_by)
 		}
 		if (fd == -1) {
 			if (!sys_path) {
-				char *prefix = 0;
-				size_t prefix_len;
-				if (ldso.name[0]=='/') {
-					char *s, *t, *z;
-					for (s=t=z=ldso.name; *s; s++)
-						if (*s=='/') z=t, t=s;
-					prefix_len = z-ldso.name;
-					if (prefix_len < PATH_MAX)
-						prefix = ldso.name;
-				}
-				if (!prefix) {
-					prefix = "";
-					prefix_len = 0;
-				}
-				char etc_ldso_path[prefix_len + 1
+				char etc_ldso_path[PATH_MAX
 					+ sizeof "/etc/ld-musl-" LDSO_ARCH ".path"];
-				snprintf(etc_ldso_path, sizeof etc_ldso_path,
-					"%.*s/etc/ld-musl-" LDSO_ARCH ".path",
-					(int)prefix_len, prefix);
+				etc_ldso_file(etc_ldso_path, sizeof etc_ldso_path, "path");
 				fd = open(etc_ldso_path, O_RDONLY|O_CLOEXEC);
 				if (fd>=0) {
 					size_t n = 0;
@@ -1196,11 +2382,14 @@ static struct dso *load_library(const char *name, struct dso *needed_by)
 		pathname = buf;
 	}
 	if (fd < 0) return 0;
-	if (fstat(fd, &st) < 0) {
+	if (member >= 0) {
+		/* Members are told apart by index, not by inode. */
+		st = (struct stat){0};
+	} else if (fstat(fd, &st) < 0) {
 		close(fd);
 		return 0;
 	}
-	for (p=head->next; p; p=p->next) {
+	for (p=head->next; member < 0 && p; p=p->next) {
 		if (p->dev == st.st_dev && p->ino == st.st_ino) {
 			/* If this library was previously loaded with a
 			 * pathname but a search found the same inode,
@@ -1211,15 +2400,21 @@ static struct dso *load_library(const char *name, struct dso *needed_by)
 			return p;
 		}
 	}
+	if (qnx_snap) snapshot_hint(&st);
+	uint64_t t0 = prof_now();
 	map = noload ? 0 : map_library(fd, &temp_dso);
-	close(fd);
+	map_bias = 0;
+	if (member < 0) close(fd);
 	if (!map) return 0;
+	uint64_t t1 = prof_now();
+	temp_dso.prof.map_ns = t1 - t0;
 
 	/* Avoid the danger of getting two versions of libc mapped into the
 	 * same process when an absolute pathname was used. The symbols
 	 * checked are chosen to catch both musl and glibc, and to avoid
 	 * false positives from interposition-hack libraries. */
 	decode_dyn(&temp_dso);
+	temp_dso.prof.dyn_ns = prof_now() - t1;
 	if (find_sym(&temp_dso, "__libc_start_main", 1).sym &&
 	    find_sym(&temp_dso, "stdin", 1).sym) {
 		unmap_library(&temp_dso);
@@ -1229,6 +2424,9 @@ static struct dso *load_library(const char *name, struct dso *needed_by)
 	 * committed either to use the mapped library or to abort execution.
 	 * Unmapping is not possible, so we can safely reclaim gaps. */
 	if (!runtime) reclaim_gaps(&temp_dso);
+	t1 = prof_now();
+	sysv_filter_build(&temp_dso);
+	temp_dso.prof.dyn_ns += prof_now() - t1;
 
 	/* Allocate storage for the new DSO. When there is TLS, this
 	 * storage must include a reservation for all pre-existing
@@ -1251,6 +2449,8 @@ static struct dso *load_library(const char *name, struct dso *needed_by)
 	memcpy(p, &temp_dso, sizeof temp_dso);
 	p->dev = st.st_dev;
 	p->ino = st.st_ino;
+	p->mtime = st.st_mtim;
+	p->bundle_idx = member+1;
 	p->needed_by = needed_by;
 	p->name = p->buf;
 	p->runtime_loaded = runtime;
@@ -1281,11 +2481,13 @@ static struct dso *load_library(const char *name, struct dso *needed_by)
 	tail->next = p;
 	p->prev = tail;
 	tail = p;
+	dso_gen++;
 
 	if (DL_FDPIC) makefuncdescs(p);
 
 	if (ldd_mode) dprintf(1, "\t%s => %s (%p)\n", name, pathname, p->base);
 
+	QNX_PROBE3(load_library, name, p->name, p->base);
 	return p;
 }
 
@@ -1398,6 +2600,52 @@ static void load_preload(char *s)
 	}
 }
 
+/* LD_QNX_PRELOAD_PLUGINS: libraries a process is known to dlopen,
+ * such as the img_codec_*.so modules libimg opens for each entry of
+ * img.conf, are loaded with the startup set so that they take static
+ * TLS, are relocated in the startup pass and are part of a snapshot.
+ * They stay RTLD_LOCAL and their constructors run at the first dlopen;
+ * after that dlopen returns the handle without taking the lock. A name
+ * that is not found is skipped, as with LD_PRELOAD. */
+#define PLUGIN_MAX 64
+static struct dso *plugins[PLUGIN_MAX];
+static int plugin_cnt;
+
+static void load_plugins(char *s)
+{
+	int tmp;
+	char *z;
+	struct dso *p;
+	for (z=s; *z; s=z) {
+		for (   ; *s && (isspace(*s) || *s==':'); s++);
+		for (z=s; *z && !isspace(*z) && *z!=':'; z++);
+		tmp = *z;
+		*z = 0;
+		if (*s && (p = load_library(s, 0)) && plugin_cnt < PLUGIN_MAX)
+			plugins[plugin_cnt++] = p;
+		*z = tmp;
+	}
+}
+
+/* A plugin handle dlopen can return as is: already constructed (or its
+ * constructors deferred), and global if RTLD_GLOBAL is asked for. Names
+ * match as in load_library: by path when file has a slash, else by the
+ * short name. */
+static struct dso *plugin_find(const char *file, int mode)
+{
+	int i;
+	for (i=0; i<plugin_cnt; i++) {
+		struct dso *p = plugins[i];
+		const char *name = strchr(file, '/') ? p->name : p->shortname;
+		if (!name || strcmp(file, name)) continue;
+		if (!(p->constructed || p->ctor_deferred)
+		    || ((mode & RTLD_GLOBAL) && !p->syms_next && syms_tail != p))
+			return 0;
+		return p;
+	}
+	return 0;
+}
+
 static void add_syms(struct dso *p)
 {
 	if (!p->syms_next && syms_tail != p) {
@@ -1438,33 +2686,120 @@ static void do_mips_relocs(struct dso *p, size_t *got)
 	}
 }
 
-static void reloc_all(struct dso *p)
+static void reloc_one(struct dso *p)
 {
 	size_t dyn[DYN_CNT];
-	for (; p; p=p->next) {
-		if (p->relocated) continue;
-		decode_vec(p->dynv, dyn, DYN_CNT);
-		if (NEED_MIPS_GOT_RELOCS)
-			do_mips_relocs(p, laddr(p, dyn[DT_PLTGOT]));
+	uint64_t t0 = prof_now();
+	decode_vec(p->dynv, dyn, DYN_CNT);
+	if (NEED_MIPS_GOT_RELOCS)
+		do_mips_relocs(p, laddr(p, dyn[DT_PLTGOT]));
+	if (!qnx_lazy || p == &ldso || !lazy_plt_init(p, dyn, 0))
 		do_relocs(p, laddr(p, dyn[DT_JMPREL]), dyn[DT_PLTRELSZ],
 			2+(dyn[DT_PLTREL]==DT_RELA));
-		do_relocs(p, laddr(p, dyn[DT_REL]), dyn[DT_RELSZ], 2);
-		do_relocs(p, laddr(p, dyn[DT_RELA]), dyn[DT_RELASZ], 3);
-		if (!DL_FDPIC)
-			do_relr_relocs(p, laddr(p, dyn[DT_RELR]), dyn[DT_RELRSZ]);
-
-		if (head != &ldso && p->relro_start != p->relro_end) {
-			long ret = __syscall(SYS_mprotect, laddr(p, p->relro_start),
-				p->relro_end-p->relro_start, PROT_READ);
-			if (ret != 0 && ret != -ENOSYS) {
-				error("Error relocating %s: RELRO protection failed: %m",
-					p->name);
-				if (runtime) longjmp(*rtld_fail, 1);
-			}
+	do_relocs(p, laddr(p, dyn[DT_REL]), dyn[DT_RELSZ], 2);
+	do_relocs(p, laddr(p, dyn[DT_RELA]), dyn[DT_RELASZ], 3);
+	if (!DL_FDPIC)
+		do_relr_relocs(p, laddr(p, dyn[DT_RELR]), dyn[DT_RELRSZ]);
+
+	if (head != &ldso && p->relro_start != p->relro_end) {
+		long ret = __syscall(SYS_mprotect, laddr(p, p->relro_start),
+			p->relro_end-p->relro_start, PROT_READ);
+		if (ret != 0 && ret != -ENOSYS) {
+			error("Error relocating %s: RELRO protection failed: %m",
+				p->name);
+			if (runtime) longjmp(*rtld_fail, 1);
 		}
+	}
 
-		p->relocated = 1;
+	p->relocated = 1;
+	p->prof.reloc_ns += prof_now() - t0;
+}
+
+static void reloc_all(struct dso *p)
+{
+	for (; p; p=p->next)
+		if (!p->relocated) reloc_one(p);
+}
+
+/* The plugins and the libraries only they need, which follow the
+ * startup set in the list, are relocated first with their symbols made
+ * global for the duration, as dlopen does, so that none of the startup
+ * libraries bind to them. */
+static void reloc_plugins(struct dso *first)
+{
+	struct dso *p, *orig_syms_tail = syms_tail;
+	if (!first) return;
+	for (p=first; p; p=p->next)
+		add_syms(p);
+	reloc_all(first);
+	revert_syms(orig_syms_tail);
+}
+
+/* Parallel startup relocation (LD_QNX_PARALLEL=<n>). Relocating a
+ * library only reads the symbol tables of the others and writes its
+ * own segments, so the libraries can be relocated in any order; only
+ * the main program, which may have copy relocations, has to wait for
+ * them. Workers are raw clones sharing the main thread's thread
+ * pointer, which is safe since nothing on this path uses thread-local
+ * state other than errno for error messages. Each one pulls libraries
+ * from a shared queue until it is empty. With n<2, or if no worker can
+ * be created, the queue is drained serially by the main thread. */
+#define RELOC_MAX_THREADS 16
+#define RELOC_STACK_SIZE 65536
+
+static struct dso **reloc_queue;
+static int reloc_queue_len;
+static volatile int reloc_next;
+
+static int reloc_drain(void *unused)
+{
+	int i;
+	while ((i = a_fetch_add(&reloc_next, 1)) < reloc_queue_len)
+		reloc_one(reloc_queue[i]);
+	return 0;
+}
+
+static void reloc_parallel(struct dso *p, int nthreads)
+{
+	struct dso *q;
+	int n = 0, i, t;
+	for (q=p; q; q=q->next) n += !q->relocated;
+	if (!n) return;
+
+	struct dso *queue[n];
+	volatile int tid[RELOC_MAX_THREADS] = {0};
+	unsigned char *stacks = MAP_FAILED;
+	sigset_t set;
+
+	for (n=0, q=p; q; q=q->next)
+		if (!q->relocated) queue[n++] = q;
+	reloc_queue = queue;
+	reloc_queue_len = n;
+	reloc_next = 0;
+
+	if (nthreads > RELOC_MAX_THREADS) nthreads = RELOC_MAX_THREADS;
+	if (nthreads > n) nthreads = n;
+	if (nthreads > 1)
+		stacks = mmap(0, (nthreads-1) * RELOC_STACK_SIZE,
+			PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+
+	__block_all_sigs(&set);
+	for (i=0; stacks != MAP_FAILED && i<nthreads-1; i++) {
+		int ret = __clone(reloc_drain,
+			stacks + (i+1) * RELOC_STACK_SIZE,
+			CLONE_VM|CLONE_FS|CLONE_FILES|CLONE_SIGHAND|CLONE_THREAD
+			|CLONE_SYSVSEM|CLONE_PARENT_SETTID|CLONE_CHILD_CLEARTID,
+			0, &tid[i], 0, &tid[i]);
+		if (ret < 0) break;
 	}
+	reloc_drain(0);
+	for (i=0; i<nthreads-1; i++)
+		while ((t = tid[i])) __futexwait(&tid[i], t, 0);
+	__restore_sigs(&set);
+
+	if (stacks != MAP_FAILED)
+		munmap(stacks, (nthreads-1) * RELOC_STACK_SIZE);
+	reloc_queue = 0;
 }
 
 static void kernel_mapped_dso(struct dso *p)
@@ -1617,11 +2952,17 @@ static void do_init_fini(struct dso **queue)
 	for (i=0; (p=queue[i]); i++) {
 		while ((p->ctor_visitor && p->ctor_visitor!=self) || shutting_down)
 			pthread_cond_wait(&ctor_cond, &init_fini_lock);
-		if (p->ctor_visitor || p->constructed)
+		if (p->ctor_visitor || p->constructed || p->ctor_deferred)
 			continue;
 		p->ctor_visitor = self;
 		
 		decode_vec(p->dynv, dyn, DYN_CNT);
+		if (qnx_defer_ctors && p->runtime_loaded && !p->ctor_released
+		    && (dyn[0] & ((1<<DT_INIT) | (1<<DT_INIT_ARRAY)))) {
+			p->ctor_visitor = 0;
+			p->ctor_deferred = 1;
+			continue;
+		}
 		if (dyn[0] & ((1<<DT_FINI) | (1<<DT_FINI_ARRAY))) {
 			p->fini_next = fini_head;
 			fini_head = p;
@@ -1629,6 +2970,7 @@ static void do_init_fini(struct dso **queue)
 
 		pthread_mutex_unlock(&init_fini_lock);
 
+		uint64_t t0 = prof_now();
 #ifndef NO_LEGACY_INITFINI
 		if ((dyn[0] & (1<<DT_INIT)) && dyn[DT_INIT])
 			fpaddr(p, dyn[DT_INIT])();
@@ -1638,6 +2980,7 @@ static void do_init_fini(struct dso **queue)
 			size_t *fn = laddr(p, dyn[DT_INIT_ARRAY]);
 			while (n--) ((void (*)(void))*fn++)();
 		}
+		p->prof.init_ns += prof_now() - t0;
 
 		pthread_mutex_lock(&init_fini_lock);
 		p->ctor_visitor = 0;
@@ -1647,12 +2990,63 @@ static void do_init_fini(struct dso **queue)
 	pthread_mutex_unlock(&init_fini_lock);
 }
 
+/* Deferred constructors (LD_QNX_DEFER_CTORS). Libraries loaded by
+ * dlopen, such as the img_codec_*.so modules libimg opens for every
+ * entry in img.conf, have their constructors postponed until a symbol
+ * in them is first bound through dlsym or a lazy PLT slot. Their
+ * dependencies are constructed first. Direct data references through
+ * eagerly bound GOT entries do not trigger construction, so this mode
+ * is only safe for libraries entered through functions. */
+static void run_deferred_ctors(struct dso *p)
+{
+	struct dso *queue[2] = { p, 0 };
+	size_t i;
+	if (!a_swap(&p->ctor_deferred, 0)) return;
+	p->ctor_released = 1;
+	for (i=0; i<p->ndeps_direct; i++)
+		if (p->deps[i]->ctor_deferred)
+			run_deferred_ctors(p->deps[i]);
+	do_init_fini(queue);
+}
+
 void __libc_start_init(void)
 {
+	uint64_t t0 = prof_now();
 	do_init_fini(main_ctor_queue);
 	if (!__malloc_replaced && main_ctor_queue != builtin_ctor_queue)
 		free(main_ctor_queue);
 	main_ctor_queue = 0;
+	if (qnx_prof_fd >= 0) {
+		qnx_prof.init_ns = prof_now() - t0;
+		prof_dump();
+	}
+}
+
+/* The QNX crt passes the bounds of the program's own init and fini
+ * arrays to _init_array and _fini_array. When an array is the
+ * DT_INIT_ARRAY or DT_FINI_ARRAY of a loaded DSO, do_init_fini and
+ * __libc_exit_fini already run it once, in dependency order, so the
+ * caller must not; if the startup constructors somehow have not run
+ * yet they are run now. Returns 0 for arrays the loader does not know,
+ * which the caller runs itself. */
+static void *addr2dso(size_t);
+
+hidden int __dl_qnx_array_owned(void (**start)(void), int fini)
+{
+	size_t dyn[DYN_CNT];
+	int tag = fini ? DT_FINI_ARRAY : DT_INIT_ARRAY;
+	struct dso *p;
+
+	pthread_rwlock_rdlock(&lock);
+	p = addr2dso((size_t)start);
+	pthread_rwlock_unlock(&lock);
+	if (!p) return 0;
+	decode_vec(p->dynv, dyn, DYN_CNT);
+	if (!(dyn[0] & (1<<tag)) || laddr(p, dyn[tag]) != (void *)start)
+		return 0;
+	if (!fini && !p->constructed && main_ctor_queue)
+		__libc_start_init();
+	return 1;
 }
 
 static void dl_debug_state(void)
@@ -1785,6 +3179,8 @@ hidden void __dls2(unsigned char *base, size_t *sp)
 	size_t addends[symbolic_rel_cnt+1];
 	saved_addends = addends;
 
+	qnx_redirect_init();
+
 	head = &ldso;
 	reloc_all(&ldso);
 
@@ -1832,7 +3228,8 @@ void __dls3(size_t *sp, size_t *auxv)
 	static struct dso app, vdso;
 	size_t aux[AUX_CNT];
 	size_t i;
-	char *env_preload=0;
+	char *env_preload=0, *env_plugins=0;
+	struct dso *plugin_first = 0;
 	char *replace_argv0=0;
 	size_t vdso_base;
 	int argc = *sp;
@@ -1844,6 +3241,7 @@ void __dls3(size_t *sp, size_t *auxv)
 	 * global data that may be needed before we can make syscalls. */
 	__environ = envp;
 	decode_vec(auxv, aux, AUX_CNT);
+	__qnx_string_init();
 	search_vec(auxv, &__sysinfo, AT_SYSINFO);
 	__pthread_self()->sysinfo = __sysinfo;
 	libc.page_size = aux[AT_PAGESZ];
@@ -1854,6 +3252,52 @@ void __dls3(size_t *sp, size_t *auxv)
 	if (!libc.secure) {
 		env_path = getenv("LD_LIBRARY_PATH");
 		env_preload = getenv("LD_PRELOAD");
+		env_plugins = getenv("LD_QNX_PRELOAD_PLUGINS");
+		qnx_nosymcache = getenv("LD_QNX_NOSYMCACHE") != 0;
+		qnx_lazy = getenv("LD_QNX_LAZY") != 0;
+		qnx_hugepage = getenv("LD_QNX_HUGEPAGE") != 0;
+		qnx_populate = getenv("LD_QNX_POPULATE") != 0;
+		qnx_defer_ctors = getenv("LD_QNX_DEFER_CTORS") != 0;
+		qnx_tls_relax = getenv("LD_QNX_TLS_RELAX") != 0;
+		char *par = getenv("LD_QNX_PARALLEL");
+		if (par) qnx_parallel = atoi(par);
+		env_ldcache = getenv("LD_QNX_PATHCACHE");
+		qnx_snapshot_path = getenv("LD_QNX_SNAPSHOT");
+		if (qnx_snapshot_path && !*qnx_snapshot_path) qnx_snapshot_path = 0;
+		char *bfile = getenv("LD_QNX_BUNDLE");
+		if (bfile && *bfile) {
+			int fd = open(bfile, O_RDONLY|O_CLOEXEC);
+			if (fd >= 0 && !bundle_open(fd, bfile)) close(fd);
+		}
+		__qnx_afl_forksrv = getenv("LD_QNX_AFL_FORKSRV");
+		if (__qnx_afl_forksrv && !*__qnx_afl_forksrv) __qnx_afl_forksrv = 0;
+		/* Set by afl-fuzz for its CmpLog runs; a snapshot taken
+		 * without the comparison shims bound cannot be used. */
+		qnx_cmplog = getenv("__AFL_CMPLOG_SHM_ID") != 0;
+		if (qnx_cmplog) qnx_snapshot_path = 0;
+		/* Census runs must see every relocation, eagerly. */
+		char *census = getenv("LD_QNX_CENSUS");
+		if (census && *census >= '0' && *census <= '9') {
+			qnx_census_fd = atoi(census);
+			qnx_snapshot_path = 0;
+			qnx_lazy = 0;
+			census_table_path = getenv("LD_QNX_CENSUS_TABLE");
+			char *policy = getenv("LD_QNX_CENSUS_POLICY");
+			if (policy && !strcmp(policy, "enosys"))
+				census_abort = 0;
+		}
+		/* Snapshots hold the wrappers of the run that took them. */
+		char *shimstats = getenv("LD_QNX_SHIMSTATS");
+		if (shimstats && *shimstats) {
+			qnx_snapshot_path = 0;
+			qnx_shimstats_init();
+		}
+		char *prof = getenv("LD_QNX_PROFILE");
+		if (prof && *prof >= '0' && *prof <= '9') {
+			qnx_prof_fd = atoi(prof);
+			qnx_prof.start = prof_now();
+			prof_faults(&qnx_prof.minflt, &qnx_prof.majflt);
+		}
 	}
 
 	/* Activate error handler function */
@@ -1934,12 +3378,22 @@ void __dls3(size_t *sp, size_t *auxv)
 			dprintf(2, "%s: cannot load %s: %s\n", ldname, argv[0], strerror(errno));
 			_exit(1);
 		}
+		/* A bundle run as the program brings its own libraries. */
+		if (bundle_open(fd, argv[0])) {
+			if (bundle->main == BUNDLE_NOMAIN) {
+				dprintf(2, "%s: %s: Bundle holds no program\n", ldname, argv[0]);
+				_exit(1);
+			}
+			app.bundle_idx = bundle->main+1;
+			map_bias = bundle_ents(bundle)[bundle->main].off;
+		}
 		Ehdr *ehdr = map_library(fd, &app);
+		map_bias = 0;
 		if (!ehdr) {
 			dprintf(2, "%s: %s: Not a valid dynamic program\n", ldname, argv[0]);
 			_exit(1);
 		}
-		close(fd);
+		if (fd != bundle_fd) close(fd);
 		ldso.name = ldname;
 		app.name = argv[0];
 		aux[AT_ENTRY] = (size_t)laddr(&app, ehdr->e_entry);
@@ -1969,6 +3423,7 @@ void __dls3(size_t *sp, size_t *auxv)
 		tls_align = MAXP2(tls_align, app.tls.align);
 	}
 	decode_dyn(&app);
+	sysv_filter_build(&app);
 	if (DL_FDPIC) {
 		makefuncdescs(&app);
 		if (!app.loadmap) {
@@ -1982,6 +3437,16 @@ void __dls3(size_t *sp, size_t *auxv)
 		argv[-3] = (void *)app.loadmap;
 	}
 
+	if (qnx_snapshot_path) {
+		struct stat st;
+		if (!stat(app.name, &st)) {
+			app.dev = st.st_dev;
+			app.ino = st.st_ino;
+			app.mtime = st.st_mtim;
+		}
+		snapshot_open();
+	}
+
 	/* Initial dso chain consists only of the app. */
 	head = tail = syms_tail = &app;
 
@@ -1996,6 +3461,15 @@ void __dls3(size_t *sp, size_t *auxv)
 	for (struct dso *p=head; p; p=p->next)
 		add_syms(p);
 
+	/* Plugins go after the startup set and before the vdso, so that
+	 * the snapshot covers them. */
+	if (env_plugins) {
+		struct dso *orig_tail = tail;
+		load_plugins(env_plugins);
+		plugin_first = orig_tail->next;
+		if (plugin_first) load_deps(plugin_first);
+	}
+
 	/* Attach to vdso, if provided by the kernel, last so that it does
 	 * not become part of the global namespace.  */
 	if (search_vec(auxv, &vdso_base, AT_SYSINFO_EHDR) && vdso_base) {
@@ -2017,7 +3491,9 @@ void __dls3(size_t *sp, size_t *auxv)
 		vdso.prev = tail;
 		tail->next = &vdso;
 		tail = &vdso;
+		dso_gen++;
 	}
+	addr_index_update();
 
 	for (i=0; app.dynv[i]; i+=2) {
 		if (!DT_DEBUG_INDIRECT && app.dynv[i]==DT_DEBUG)
@@ -2054,10 +3530,34 @@ void __dls3(size_t *sp, size_t *auxv)
 	}
 	static_tls_cnt = tls_cnt;
 
+	int snap_restored = qnx_snap && snapshot_apply(&app);
+	snapshot_close();
+
+	uint64_t t_reloc = prof_now();
+	qnx_prof.load_ns = t_reloc - qnx_prof.start;
+
+	/* Before the symbol cache exists, since the plugins' symbols are
+	 * only global while they are relocated. */
+	reloc_plugins(plugin_first);
+
+	/* The symbol cache is not shared between relocation threads. */
+	if (!qnx_nosymcache && qnx_parallel < 2) symcache_init();
+
 	/* The main program must be relocated LAST since it may contain
 	 * copy relocations which depend on libraries' relocations. */
-	reloc_all(app.next);
+	if (qnx_parallel > 1) reloc_parallel(app.next, qnx_parallel);
+	else reloc_all(app.next);
 	reloc_all(&app);
+#ifdef __x86_64__
+	if (qnx_tls_relax)
+		for (struct dso *p=head; p; p=p->next) tls_relax(p);
+#endif
+
+	qnx_prof.reloc_ns = prof_now() - t_reloc;
+	symcache_drop();
+
+	if (qnx_snapshot_path && !snap_restored && !ldso_fail)
+		snapshot_save(&app, tail == &vdso ? &vdso : 0);
 
 	/* Actual copying to new TLS needs to happen after relocations,
 	 * since the TLS images might have contained relocated addresses. */
@@ -2140,6 +3640,10 @@ void *dlopen(const char *file, int mode)
 	struct dso **volatile ctor_queue = 0;
 
 	if (!file) return head;
+	if (!shutting_down && (p = plugin_find(file, mode))) {
+		if (__qnx_afl_forksrv) __qnx_afl_point(file);
+		return p;
+	}
 
 	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cs);
 	pthread_rwlock_wrlock(&lock);
@@ -2243,6 +3747,7 @@ void *dlopen(const char *file, int mode)
 		install_new_tls();
 	orig_tail = tail;
 end:
+	addr_index_update();
 	debug.state = RT_CONSISTENT;
 	_dl_debug_state();
 	__release_ptc();
@@ -2253,6 +3758,7 @@ end:
 		free(ctor_queue);
 	}
 	pthread_setcancelstate(cs, 0);
+	if (p && __qnx_afl_forksrv) __qnx_afl_point(file);
 	return p;
 }
 
@@ -2268,6 +3774,7 @@ static void *addr2dso(size_t a)
 {
 	struct dso *p;
 	size_t i;
+	if (addr_index_lookup(a, &p)) return p;
 	if (DL_FDPIC) for (p=head; p; p=p->next) {
 		i = count_syms(p);
 		if (a-(size_t)p->funcdescs < i*sizeof(*p->funcdescs))
@@ -2297,6 +3804,8 @@ static void *addr2dso(size_t a)
 	return 0;
 }
 
+static void *symdef_addr(struct symdef);
+
 static void *do_dlsym(struct dso *p, const char *s, void *ra)
 {
 	int use_deps = 0;
@@ -2310,11 +3819,90 @@ static void *do_dlsym(struct dso *p, const char *s, void *ra)
 		return 0;
 	} else
 		use_deps = 1;
-	struct symdef def = find_sym2(p, s, 0, use_deps);
+	struct symdef def = find_sym2(p, s, gnu_hash(s), 0, use_deps);
 	if (!def.sym) {
 		error("Symbol not found: %s", s);
 		return 0;
 	}
+	return symdef_addr(def);
+}
+
+/* dlsym_many: look up a batch of names with one pass over the search
+ * list. Each hash is computed once, and every DSO is visited once per
+ * chunk of names instead of once per name. QNX redirects apply as for
+ * dlsym. Missing names get a null result; the first one is reported
+ * through dlerror. */
+#define DLSYM_BATCH 64
+
+static int do_dlsym_many(struct dso *p, const char *const *names, void **out, size_t n)
+{
+	int use_deps = 0, found = 0, missing = 0;
+	size_t i, j;
+	if (p == head || p == RTLD_DEFAULT) {
+		p = head;
+	} else if (p == RTLD_NEXT) {
+		p = 0;
+		error("dlsym_many: RTLD_NEXT is not supported");
+	} else if (__dl_invalid_handle(p)) {
+		p = 0;
+	} else
+		use_deps = 1;
+	for (i=0; i<n; i+=DLSYM_BATCH) {
+		size_t cnt = n-i < DLSYM_BATCH ? n-i : DLSYM_BATCH, left = cnt;
+		const char *s[DLSYM_BATCH];
+		uint32_t gh[DLSYM_BATCH], h[DLSYM_BATCH];
+		struct symdef def[DLSYM_BATCH];
+		const struct qnx_redirect_slot *rd[DLSYM_BATCH];
+		struct dso *dso, **deps = use_deps && p ? p->deps : 0;
+
+		for (j=0; j<cnt; j++) {
+			const struct qnx_redirect_slot *qr;
+			s[j] = names[i+j];
+			gh[j] = gnu_hash(s[j]);
+			h[j] = 0;
+			def[j] = (struct symdef){0};
+			qnx_prof.lookups++;
+			if ((qr = rd[j] = qnx_redirect_find(s[j], gh[j]))) {
+				qnx_prof.redirects++;
+				s[j] = qr->r->target;
+				gh[j] = qr->target_hash;
+			}
+		}
+		for (dso=p; dso && left; dso=use_deps ? *deps++ : dso->syms_next) {
+			for (j=0; j<cnt; j++) {
+				Sym *sym;
+				if (def[j].sym) continue;
+				if (dso->ghashtab) {
+					sym = gnu_lookup_filtered(gh[j], dso->ghashtab,
+						dso, s[j], gh[j] / (8*sizeof(size_t)),
+						1ul << gh[j] % (8*sizeof(size_t)));
+				} else if (dso->sysv_bloom) {
+					sym = sysv_lookup_filtered(s[j], &h[j], gh[j],
+						dso, gh[j] / (8*sizeof(size_t)),
+						1ul << gh[j] % (8*sizeof(size_t)));
+				} else {
+					if (!h[j]) h[j] = sysv_hash(s[j]);
+					sym = sysv_lookup(s[j], h[j], dso);
+				}
+				if (!sym || !sym_usable(sym, 0)) continue;
+				def[j].sym = sym;
+				def[j].dso = dso;
+				left--;
+			}
+		}
+		for (j=0; j<cnt; j++) {
+			if (rd[j]) qnx_shimstats_bind(rd[j], &def[j]);
+			out[i+j] = def[j].sym ? symdef_addr(def[j]) : 0;
+			if (def[j].sym) found++;
+			else if (p && !missing++)
+				error("Symbol not found: %s", names[i+j]);
+		}
+	}
+	return found;
+}
+
+static void *symdef_addr(struct symdef def)
+{
 	if ((def.sym->st_info&0xf) == STT_TLS)
 		return __tls_get_addr((tls_mod_off_t []){def.dso->tls_id, def.sym->st_value-DTP_OFFSET});
 	if (DL_FDPIC && (def.sym->st_info&0xf) == STT_FUNC)
@@ -2326,15 +3914,18 @@ int dladdr(const void *addr_arg, Dl_info *info)
 {
 	size_t addr = (size_t)addr_arg;
 	struct dso *p;
+	struct sym_index *ix = 0;
 	Sym *sym, *bestsym;
 	uint32_t nsym;
 	char *strings;
 	size_t best = 0;
 	size_t besterr = -1;
 
-	pthread_rwlock_rdlock(&lock);
-	p = addr2dso(addr);
-	pthread_rwlock_unlock(&lock);
+	if (!addr_index_lookup(addr, &p)) {
+		pthread_rwlock_rdlock(&lock);
+		p = addr2dso(addr);
+		pthread_rwlock_unlock(&lock);
+	}
 
 	if (!p) return 0;
 
@@ -2352,7 +3943,23 @@ int dladdr(const void *addr_arg, Dl_info *info)
 		}
 	}
 
-	if (!best) for (; nsym; nsym--, sym++) {
+	if (!best && !DL_FDPIC && (ix = sym_index_get(p))) {
+		size_t lo = 0, hi = ix->n, mid;
+		while (lo < hi) {
+			mid = lo + (hi-lo)/2;
+			if (ix->e[mid].addr <= addr) lo = mid+1;
+			else hi = mid;
+		}
+		/* Of several symbols at one address, the first in the table */
+		while (lo > 1 && ix->e[lo-2].addr == ix->e[lo-1].addr) lo--;
+		if (lo) {
+			best = ix->e[lo-1].addr;
+			bestsym = p->syms + ix->e[lo-1].sym;
+			besterr = addr - best;
+		}
+	}
+
+	if (!best && !ix) for (; nsym; nsym--, sym++) {
 		if (sym->st_value
 		 && (1<<(sym->st_info&0xf) & OK_TYPES)
 		 && (1<<(sym->st_info>>4) & OK_BINDS)) {
@@ -2392,9 +3999,29 @@ int dladdr(const void *addr_arg, Dl_info *info)
 hidden void *__dlsym(void *restrict p, const char *restrict s, void *restrict ra)
 {
 	void *res;
+	struct dso *def = 0;
 	pthread_rwlock_rdlock(&lock);
 	res = do_dlsym(p, s, ra);
+	if (qnx_defer_ctors && res) def = addr2dso((size_t)res);
 	pthread_rwlock_unlock(&lock);
+	if (def && def->ctor_deferred) run_deferred_ctors(def);
+	return res;
+}
+
+hidden int __dlsym_many(void *restrict p, const char *const *restrict names, void **restrict out, size_t n)
+{
+	int res;
+	pthread_rwlock_rdlock(&lock);
+	res = do_dlsym_many(p, names, out, n);
+	pthread_rwlock_unlock(&lock);
+	for (size_t i=0; qnx_defer_ctors && i<n; i++) {
+		struct dso *q;
+		if (!out[i]) continue;
+		pthread_rwlock_rdlock(&lock);
+		q = addr2dso((size_t)out[i]);
+		pthread_rwlock_unlock(&lock);
+		if (q && q->ctor_deferred) run_deferred_ctors(q);
+	}
 	return res;
 }
 
@@ -5,7 +5,11 @@
 #include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
 #include <sys/auxv.h>
+#include <sys/mman.h>
 #include "syscall.h"
 #include "atomic.h"
 #include "pthread_impl.h"
@@ -45,6 +49,17 @@
  * necessary because aio_cancel is needed by close, and close is required
  * to be async-signal safe. All aio worker threads run with all signals
  * blocked permanently.
+ *
+ * Where the kernel has io_uring, reads, and writes to seekable fds not
+ * in append mode, do not get a thread: they go on one ring for the
+ * whole process, and a single poller thread reaps their completions.
+ * These operations are aio_uop entries on their queue's uops list. The
+ * poller publishes a result without taking any lock, the same way
+ * cleanup does, and then locks the queue to unlink and free the entry.
+ * Operations that have to wait for earlier writes keep their thread,
+ * which waits for earlier uops writes as well. So do operations that
+ * notify through a new thread. aio_cancel waits on the queue's cond
+ * var for the uops it cancels.
  */
 
 struct aio_thread {
@@ -55,6 +70,16 @@ struct aio_thread {
 	volatile int running;
 	int err, op;
 	ssize_t ret;
+	unsigned seq;
+};
+
+struct aio_uop {
+	struct aiocb *cb;
+	struct aio_uop *next, *prev;
+	struct aio_queue *q;
+	struct sigevent sev;
+	unsigned seq;
+	int op, cancel;
 };
 
 struct aio_queue {
@@ -62,6 +87,8 @@ struct aio_queue {
 	pthread_mutex_t lock;
 	pthread_cond_t cond;
 	struct aio_thread *head;
+	struct aio_uop *uops;
+	unsigned seq, canceled;
 };
 
 struct aio_args {
@@ -158,6 +185,340 @@ static void __aio_unref_queue(struct aio_queue *q)
 	}
 }
 
+/* The io_uring ABI, as much of it as is used here. */
+
+struct uring_sqe {
+	uint8_t opcode, flags;
+	uint16_t ioprio;
+	int32_t fd;
+	uint64_t off, addr;
+	uint32_t len, op_flags;
+	uint64_t user_data;
+	uint64_t pad[3];
+};
+
+struct uring_cqe {
+	uint64_t user_data;
+	int32_t res;
+	uint32_t flags;
+};
+
+struct uring_params {
+	uint32_t sq_entries, cq_entries, flags, sq_thread_cpu;
+	uint32_t sq_thread_idle, features, wq_fd, resv[3];
+	struct {
+		uint32_t head, tail, ring_mask, ring_entries;
+		uint32_t flags, dropped, array, resv1;
+		uint64_t resv2;
+	} sq_off;
+	struct {
+		uint32_t head, tail, ring_mask, ring_entries;
+		uint32_t overflow, cqes, flags, resv1;
+		uint64_t resv2;
+	} cq_off;
+};
+
+#define URING_OP_FSYNC 3
+#define URING_OP_ASYNC_CANCEL 14
+#define URING_OP_READ 22
+#define URING_OP_WRITE 23
+#define URING_ENTER_GETEVENTS 1
+#define URING_FEAT_SINGLE_MMAP 1
+#define URING_FEAT_NODROP 2
+#define URING_FEAT_SUBMIT_STABLE 4
+#define URING_FEAT_RW_CUR_POS 8
+#define URING_OFF_SQES 0x10000000
+
+#define URING_ENTRIES 1024
+
+static struct {
+	int fd, state;
+	unsigned *sq_head, *sq_tail, *sq_array, sq_mask, sq_entries;
+	unsigned *cq_head, *cq_tail, cq_mask, cq_entries;
+	struct uring_sqe *sqes;
+	struct uring_cqe *cqes;
+	void *mem;
+	size_t mem_size;
+	/* SQEs past the kernel's head that no io_uring_enter has been
+	 * passed yet, and SQEs whose CQE is still to be reaped. */
+	unsigned pending, inflight;
+	int submitting;
+} ring;
+
+static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int uring_writes_before(struct aio_queue *q, unsigned seq)
+{
+	struct aio_uop *u;
+	for (u=q->uops; u; u=u->next)
+		if (u->op == LIO_WRITE && (int)(u->seq - seq) < 0)
+			return 1;
+	return 0;
+}
+
+static int uring_enter(unsigned submit, unsigned wait, unsigned flags)
+{
+#ifdef SYS_io_uring_enter
+	return __syscall(SYS_io_uring_enter, ring.fd, submit, wait, flags, 0, _NSIG/8);
+#else
+	return -ENOSYS;
+#endif
+}
+
+/* Passes the pending SQEs to the kernel. With ring_lock held; a caller
+ * that finds another one at it leaves its SQEs for that one, which
+ * only stops once there are none left. */
+static void uring_flush(void)
+{
+	unsigned n;
+	int r;
+
+	if (ring.submitting) return;
+	ring.submitting = 1;
+	while ((n = ring.pending)) {
+		ring.pending = 0;
+		pthread_mutex_unlock(&ring_lock);
+		while ((r = uring_enter(n, 0, 0)) == -EINTR);
+		pthread_mutex_lock(&ring_lock);
+		if (r < 0) r = 0;
+		ring.pending += n - r;
+		/* Out of kernel memory; the poller tries again. */
+		if (!r) break;
+	}
+	ring.submitting = 0;
+}
+
+/* With ring_lock held. The SQE is zeroed. */
+static struct uring_sqe *uring_get_sqe(void)
+{
+	struct uring_sqe *sqe;
+	unsigned tail = *ring.sq_tail;
+
+	if (ring.inflight >= ring.cq_entries) return 0;
+	if (tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE) >= ring.sq_entries)
+		return 0;
+	sqe = &ring.sqes[tail & ring.sq_mask];
+	memset(sqe, 0, sizeof *sqe);
+	return sqe;
+}
+
+static void uring_put_sqe(void)
+{
+	ring.pending++;
+	ring.inflight++;
+	__atomic_store_n(ring.sq_tail, *ring.sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+static void uring_complete(struct aio_uop *u, int res)
+{
+	struct aio_queue *q = u->q;
+	struct aiocb *cb = u->cb;
+	int err = res<0 ? -res : 0;
+
+	cb->__ret = res<0 ? -1 : res;
+	if (a_swap(&cb->__err, err) != EINPROGRESS)
+		__wake(&cb->__err, -1, 1);
+	if (a_swap(&__aio_fut, 0))
+		__wake(&__aio_fut, -1, 1);
+
+	if (u->sev.sigev_notify == SIGEV_SIGNAL) {
+		siginfo_t si = {
+			.si_signo = u->sev.sigev_signo,
+			.si_value = u->sev.sigev_value,
+			.si_code = SI_ASYNCIO,
+			.si_pid = getpid(),
+			.si_uid = getuid()
+		};
+		__syscall(SYS_rt_sigqueueinfo, si.si_pid, si.si_signo, &si);
+	}
+
+	pthread_mutex_lock(&q->lock);
+	if (u->next) u->next->prev = u->prev;
+	if (u->prev) u->prev->next = u->next;
+	else q->uops = u->next;
+	if (u->cancel && err == ECANCELED) q->canceled++;
+	pthread_cond_broadcast(&q->cond);
+	__aio_unref_queue(q);
+	free(u);
+}
+
+static void *uring_poller(void *ctx)
+{
+	unsigned head, tail, n;
+
+	for (;;) {
+		uring_enter(0, 1, URING_ENTER_GETEVENTS);
+		head = *ring.cq_head;
+		tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+		for (n=0; head+n != tail; n++) {
+			struct uring_cqe *cqe = &ring.cqes[head+n & ring.cq_mask];
+			/* Cancel requests have no user_data. */
+			if (cqe->user_data)
+				uring_complete((void *)(uintptr_t)cqe->user_data, cqe->res);
+		}
+		__atomic_store_n(ring.cq_head, tail, __ATOMIC_RELEASE);
+		pthread_mutex_lock(&ring_lock);
+		ring.inflight -= n;
+		uring_flush();
+		pthread_mutex_unlock(&ring_lock);
+	}
+	return 0;
+}
+
+/* With ring_lock held and all signals blocked, which the poller
+ * inherits. QNX_AIO_THREADS keeps aio on threads. */
+static void uring_setup(void)
+{
+	struct uring_params p = { 0 };
+	unsigned char *sq, *cq;
+	size_t sqe_size, i;
+	pthread_attr_t a;
+	pthread_t td;
+	const unsigned need = URING_FEAT_SINGLE_MMAP | URING_FEAT_NODROP
+		| URING_FEAT_SUBMIT_STABLE | URING_FEAT_RW_CUR_POS;
+
+	ring.state = -1;
+	if (getenv("QNX_AIO_THREADS")) return;
+#ifdef SYS_io_uring_setup
+	ring.fd = __syscall(SYS_io_uring_setup, URING_ENTRIES, &p);
+#else
+	ring.fd = -ENOSYS;
+#endif
+	if (ring.fd < 0) return;
+	if ((p.features & need) != need) goto fail;
+
+	ring.mem_size = MAX(p.sq_off.array + p.sq_entries * sizeof(unsigned),
+		p.cq_off.cqes + p.cq_entries * sizeof(struct uring_cqe));
+	ring.mem = __mmap(0, ring.mem_size, PROT_READ|PROT_WRITE,
+		MAP_SHARED|MAP_POPULATE, ring.fd, 0);
+	if (ring.mem == MAP_FAILED) goto fail;
+	sqe_size = p.sq_entries * sizeof(struct uring_sqe);
+	ring.sqes = __mmap(0, sqe_size, PROT_READ|PROT_WRITE,
+		MAP_SHARED|MAP_POPULATE, ring.fd, URING_OFF_SQES);
+	if (ring.sqes == MAP_FAILED) goto fail_mem;
+
+	sq = cq = ring.mem;
+	ring.sq_head = (void *)(sq + p.sq_off.head);
+	ring.sq_tail = (void *)(sq + p.sq_off.tail);
+	ring.sq_array = (void *)(sq + p.sq_off.array);
+	ring.sq_mask = *(unsigned *)(sq + p.sq_off.ring_mask);
+	ring.sq_entries = p.sq_entries;
+	ring.cq_head = (void *)(cq + p.cq_off.head);
+	ring.cq_tail = (void *)(cq + p.cq_off.tail);
+	ring.cq_mask = *(unsigned *)(cq + p.cq_off.ring_mask);
+	ring.cq_entries = p.cq_entries;
+	ring.cqes = (void *)(cq + p.cq_off.cqes);
+	/* SQE i always sits in slot i. */
+	for (i=0; i<p.sq_entries; i++) ring.sq_array[i] = i;
+
+	pthread_attr_init(&a);
+	pthread_attr_setstacksize(&a, io_thread_stack_size);
+	pthread_attr_setguardsize(&a, 0);
+	pthread_attr_setdetachstate(&a, PTHREAD_CREATE_DETACHED);
+	if (pthread_create(&td, &a, uring_poller, 0)) {
+		__munmap(ring.sqes, sqe_size);
+		goto fail_mem;
+	}
+	ring.state = 1;
+	return;
+fail_mem:
+	__munmap(ring.mem, ring.mem_size);
+fail:
+	__syscall(SYS_close, ring.fd);
+}
+
+/* Puts cb on the ring if it can go there, with q locked, which it
+ * unlocks if so; returns 0 to leave cb to a thread. */
+static int uring_submit(struct aio_queue *q, struct aiocb *cb, int op, int flush)
+{
+	sigset_t allmask, origmask;
+	struct uring_sqe *sqe;
+	struct aio_uop *u;
+
+	if (ring.state < 0 || cb->aio_sigevent.sigev_notify == SIGEV_THREAD)
+		return 0;
+	if (op!=LIO_READ && (op!=LIO_WRITE || q->append))
+		return 0;
+	if (!(u = malloc(sizeof *u))) return 0;
+
+	sigfillset(&allmask);
+	pthread_sigmask(SIG_BLOCK, &allmask, &origmask);
+	pthread_mutex_lock(&ring_lock);
+	if (!ring.state) uring_setup();
+	if (ring.state < 0 || !(sqe = uring_get_sqe())) {
+		pthread_mutex_unlock(&ring_lock);
+		pthread_sigmask(SIG_SETMASK, &origmask, 0);
+		free(u);
+		return 0;
+	}
+
+	u->cb = cb;
+	u->q = q;
+	u->sev = cb->aio_sigevent;
+	u->seq = q->seq++;
+	u->op = op;
+	u->cancel = 0;
+	u->prev = 0;
+	if ((u->next = q->uops)) u->next->prev = u;
+	q->uops = u;
+	cb->__err = EINPROGRESS;
+
+	sqe->opcode = op == LIO_READ ? URING_OP_READ : URING_OP_WRITE;
+	sqe->fd = cb->aio_fildes;
+	sqe->off = q->seekable ? cb->aio_offset : -1;
+	sqe->addr = (uintptr_t)cb->aio_buf;
+	sqe->len = cb->aio_nbytes;
+	sqe->user_data = (uintptr_t)u;
+	uring_put_sqe();
+	pthread_mutex_unlock(&q->lock);
+
+	if (flush) uring_flush();
+	pthread_mutex_unlock(&ring_lock);
+	pthread_sigmask(SIG_SETMASK, &origmask, 0);
+	return 1;
+}
+
+/* aio_cancel for the uops of q, with q locked and signals blocked;
+ * unlocks q. */
+static int uring_cancel(struct aio_queue *q, struct aiocb *cb, int ret)
+{
+	struct uring_sqe *sqe;
+	struct aio_uop *u;
+	unsigned canceled = q->canceled;
+	int cs;
+
+	if (!q->uops) {
+		pthread_mutex_unlock(&q->lock);
+		return ret;
+	}
+	pthread_mutex_lock(&ring_lock);
+	for (u=q->uops; u; u=u->next) {
+		if ((cb && cb != u->cb) || u->cancel) continue;
+		u->cancel = 1;
+		/* Without room for the request, the uop just runs to the end. */
+		if (!(sqe = uring_get_sqe())) continue;
+		sqe->opcode = URING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = (uintptr_t)u;
+		uring_put_sqe();
+	}
+	uring_flush();
+	pthread_mutex_unlock(&ring_lock);
+
+	/* The uops are done once they are off the list. */
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cs);
+	q->ref++;
+	for (;;) {
+		for (u=q->uops; u && (!u->cancel || cb && cb != u->cb); u=u->next);
+		if (!u) break;
+		pthread_cond_wait(&q->cond, &q->lock);
+	}
+	if (q->canceled != canceled) ret = AIO_CANCELED;
+	__aio_unref_queue(q);
+	pthread_setcancelstate(cs, 0);
+	return ret;
+}
+
 static void cleanup(void *ctx)
 {
 	struct aio_thread *at = ctx;
@@ -234,23 +595,17 @@ static void *io_thread_func(void *ctx)
 	at.td = __pthread_self();
 	at.cb = cb;
 	at.prev = 0;
+	at.seq = q->seq++;
 	if ((at.next = q->head)) at.next->prev = &at;
 	q->head = &at;
 
-	if (!q->init) {
-		int seekable = lseek(fd, 0, SEEK_CUR) >= 0;
-		q->seekable = seekable;
-		q->append = !seekable || (fcntl(fd, F_GETFL) & O_APPEND);
-		q->init = 1;
-	}
-
 	pthread_cleanup_push(cleanup, &at);
 
 	/* Wait for sequenced operations. */
 	if (op!=LIO_READ && (op!=LIO_WRITE || q->append)) {
 		for (;;) {
 			for (p=at.next; p && p->op!=LIO_WRITE; p=p->next);
-			if (!p) break;
+			if (!p && !uring_writes_before(q, at.seq)) break;
 			pthread_cond_wait(&q->cond, &q->lock);
 		}
 	}
@@ -279,7 +634,7 @@ static void *io_thread_func(void *ctx)
 	return 0;
 }
 
-static int submit(struct aiocb *cb, int op)
+static int submit(struct aiocb *cb, int op, int flush)
 {
 	int ret = 0;
 	pthread_attr_t a;
@@ -296,6 +651,13 @@ static int submit(struct aiocb *cb, int op)
 		return -1;
 	}
 	q->ref++;
+	if (!q->init) {
+		int seekable = lseek(cb->aio_fildes, 0, SEEK_CUR) >= 0;
+		q->seekable = seekable;
+		q->append = !seekable || (fcntl(cb->aio_fildes, F_GETFL) & O_APPEND);
+		q->init = 1;
+	}
+	if (uring_submit(q, cb, op, flush)) return 0;
 	pthread_mutex_unlock(&q->lock);
 
 	if (cb->aio_sigevent.sigev_notify == SIGEV_THREAD) {
@@ -329,12 +691,32 @@ static int submit(struct aiocb *cb, int op)
 
 int aio_read(struct aiocb *cb)
 {
-	return submit(cb, LIO_READ);
+	return submit(cb, LIO_READ, 1);
 }
 
 int aio_write(struct aiocb *cb)
 {
-	return submit(cb, LIO_WRITE);
+	return submit(cb, LIO_WRITE, 1);
+}
+
+/* lio_listio queues its reads and writes with flush 0 and then passes
+ * them to the kernel in one go. */
+int __aio_submit(struct aiocb *cb, int op, int flush)
+{
+	return submit(cb, op, flush);
+}
+
+void __aio_flush(void)
+{
+	sigset_t allmask, origmask;
+
+	if (ring.state <= 0) return;
+	sigfillset(&allmask);
+	pthread_sigmask(SIG_BLOCK, &allmask, &origmask);
+	pthread_mutex_lock(&ring_lock);
+	uring_flush();
+	pthread_mutex_unlock(&ring_lock);
+	pthread_sigmask(SIG_SETMASK, &origmask, 0);
 }
 
 int aio_fsync(int op, struct aiocb *cb)
@@ -343,7 +725,7 @@ int aio_fsync(int op, struct aiocb *cb)
 		errno = EINVAL;
 		return -1;
 	}
-	return submit(cb, op);
+	return submit(cb, op, 1);
 }
 
 ssize_t aio_return(struct aiocb *cb)
@@ -389,7 +771,7 @@ int aio_cancel(int fd, struct aiocb *cb)
 		}
 	}
 
-	pthread_mutex_unlock(&q->lock);
+	ret = uring_cancel(q, cb, ret);
 done:
 	pthread_sigmask(SIG_SETMASK, &origmask, 0);
 	return ret;
@@ -412,6 +794,15 @@ void __aio_atfork(int who)
 		return;
 	}
 	aio_fd_cnt = 0;
+	/* The ring is shared with the parent, and its poller is not here
+	 * to reap the child's completions. The child sets up its own. */
+	if (ring.state > 0) {
+		__munmap(ring.sqes, ring.sq_entries * sizeof(struct uring_sqe));
+		__munmap(ring.mem, ring.mem_size);
+		__syscall(SYS_close, ring.fd);
+	}
+	memset(&ring, 0, sizeof ring);
+	pthread_mutex_init(&ring_lock, 0);
 	if (pthread_rwlock_tryrdlock(&maplock)) {
 		/* Obtaining lock may fail if _Fork was called nor via
 		 * fork. In this case, no further aio is possible from
@@ -3,6 +3,7 @@
 #include <unistd.h>
 #include <string.h>
 #include "pthread_impl.h"
+#include "aio_impl.h"
 
 struct lio_state {
 	struct sigevent *sev;
@@ -90,20 +91,20 @@ int lio_listio(int mode, struct aiocb *restrict const *restrict cbs, int cnt, st
 		if (!cbs[i]) continue;
 		switch (cbs[i]->aio_lio_opcode) {
 		case LIO_READ:
-			ret = aio_read(cbs[i]);
-			break;
 		case LIO_WRITE:
-			ret = aio_write(cbs[i]);
+			ret = __aio_submit(cbs[i], cbs[i]->aio_lio_opcode, 0);
 			break;
 		default:
 			continue;
 		}
 		if (ret) {
+			__aio_flush();
 			free(st);
 			errno = EAGAIN;
 			return -1;
 		}
 	}
+	__aio_flush();
 
 	if (mode == LIO_WAIT) {
 		ret = lio_wait(st);
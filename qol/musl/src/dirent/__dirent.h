@@ -5,6 +5,8 @@ struct __dirstream
 	int buf_pos;
 	int buf_end;
 	volatile int lock[1];
+	/* dircntl() flags, used by the QNX readdir shim */
+	int qnx_flags, __qnx_pad;
 	/* Any changes to this struct must preserve the property:
 	 * offsetof(struct __dirent, buf) % sizeof(off_t) == 0 */
 	char buf[2048];
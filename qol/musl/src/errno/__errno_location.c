@@ -1,12 +1,20 @@
 // #include <errno.h>
 // #include "pthread_impl.h"
 #include <features.h>
+#include "qnx_errno.h"
 
 int errno;
 
+/* Every errno access in libc comes here: pick up a value QNX code
+ * stored, then let __get_errno_ptr know errno may change. */
 int *__errno_location(void)
 {
 	// return &__pthread_self()->errno_val;
+	if (__qnx_errno != __qnx_errno_seen) {
+		__qnx_errno_seen = __qnx_errno;
+		errno = __qnx_errno_to_linux(__qnx_errno);
+	}
+	__qnx_errno_dirty = 1;
 	return &errno;
 }
 
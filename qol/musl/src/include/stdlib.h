@@ -15,5 +15,7 @@ hidden void *__libc_malloc_impl(size_t);
 hidden void *__libc_calloc(size_t, size_t);
 hidden void *__libc_realloc(void *, size_t);
 hidden void __libc_free(void *);
+hidden void *__libc_aligned_alloc(size_t, size_t);
+hidden size_t __libc_malloc_usable_size(void *);
 
 #endif
@@ -6,4 +6,8 @@ extern hidden volatile int __aio_fut;
 extern hidden int __aio_close(int);
 extern hidden void __aio_atfork(int);
 
+struct aiocb;
+extern hidden int __aio_submit(struct aiocb *, int, int);
+extern hidden void __aio_flush(void);
+
 #endif
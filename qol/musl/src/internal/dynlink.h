@@ -96,6 +96,10 @@ struct fdpic_dummy_loadmap {
 #define DT_DEBUG_INDIRECT 0
 #endif
 
+#ifndef DL_LAZY_PLT
+#define DL_LAZY_PLT 0
+#endif
+
 #ifndef DT_DEBUG_INDIRECT_REL
 #define DT_DEBUG_INDIRECT_REL 0
 #endif
@@ -106,6 +110,7 @@ struct fdpic_dummy_loadmap {
 typedef void (*stage2_func)(unsigned char *, size_t *);
 
 hidden void *__dlsym(void *restrict, const char *restrict, void *restrict);
+hidden int __dlsym_many(void *restrict, const char *const *restrict, void **restrict, size_t);
 
 hidden void __dl_seterr(const char *, ...);
 hidden int __dl_invalid_handle(void *);
@@ -113,6 +118,11 @@ hidden void __dl_vseterr(const char *, va_list);
 
 hidden ptrdiff_t __tlsdesc_static(), __tlsdesc_dynamic();
 
+hidden int __dl_qnx_array_owned(void (**)(void), int);
+
+hidden void __dl_lazy_plt_resolve();
+hidden void *__dl_lazy_plt_fixup(void *, size_t);
+
 hidden extern int __malloc_replaced;
 hidden extern int __aligned_alloc_replaced;
 hidden void __malloc_donate(char *, char *);
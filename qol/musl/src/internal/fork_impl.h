@@ -11,11 +11,15 @@ extern hidden volatile int *const __syslog_lockptr;
 extern hidden volatile int *const __timezone_lockptr;
 
 extern hidden volatile int *const __bump_lockptr;
+extern hidden volatile int *const __map_cache_lockptr;
 
 extern hidden volatile int *const __vmlock_lockptr;
 
 hidden void __malloc_atfork(int);
 hidden void __ldso_atfork(int);
 hidden void __pthread_key_atfork(int);
+hidden void __qnx_shimstats_atfork(int);
+hidden void __qnx_stats_atfork(int);
+hidden void __qnx_sync_atfork(int);
 
 hidden void __post_Fork(int);
@@ -58,6 +58,16 @@ struct pthread {
 	volatile int killlock[1];
 	char *dlerror_buf;
 	void *stdio_locks;
+	void *malloc_tcache;
+	void *qnx_shimstats;
+	uint32_t qnx_stats[4];
+	unsigned qnx_sigmask_gen, qnx_sigmask_known;
+	uint64_t qnx_sigmask;
+	struct {
+		void *env;
+		unsigned gen;
+		uint64_t mask;
+	} qnx_sigjmp[8];
 
 	/* Part 3 -- the positions of these fields relative to
 	 * the end of the structure is external and internal ABI. */
@@ -145,6 +155,10 @@ hidden void __reset_tls();
 
 hidden void __membarrier_init(void);
 hidden void __dl_thread_cleanup(void);
+hidden void __malloc_thread_exit(void);
+hidden void __qnx_shimstats_thread_exit(void);
+hidden void __qnx_stats_thread_exit(void);
+hidden int __thread_map_put(void *, size_t, size_t);
 hidden void __testcancel();
 hidden void __do_cleanup_push(struct __ptcb *);
 hidden void __do_cleanup_pop(struct __ptcb *);
@@ -0,0 +1,31 @@
+#ifndef QNX_AFL_H
+#define QNX_AFL_H
+
+#include <features.h>
+#include <stddef.h>
+
+/* LD_QNX_AFL_FORKSRV: where to start the AFL fork server without help
+ * from the harness, see qnxsupport/afl.c. __qnx_afl_point is called
+ * with 0 when _init_libc is done and with the name after each dlopen
+ * that succeeds. */
+extern hidden const char *__qnx_afl_forksrv;
+hidden void __qnx_afl_point(const char *);
+
+/* Intel PT coverage of fork server children (LD_QNX_AFL_PT), see
+ * qnxsupport/aflpt.c. */
+hidden int __qnx_afl_pt_init(unsigned char *, unsigned);
+hidden int __qnx_afl_pt_attach(int);
+hidden void __qnx_afl_pt_collect(void);
+hidden void __qnx_afl_pt_detach(void);
+
+/* QNX_AFL_SNAPSHOT: reset the process between persistent runs, see
+ * qnxsupport/aflsnap.c. */
+hidden int __qnx_afl_snap_take(void);
+hidden void __qnx_afl_snap_restore(void *, size_t);
+
+/* QNX_AFL_ARENA: a bump heap emptied between persistent runs, see
+ * qnxsupport/aflarena.c. */
+hidden int __qnx_afl_arena_start(void);
+hidden void __qnx_afl_arena_reset(void);
+
+#endif
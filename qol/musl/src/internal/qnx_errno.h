@@ -0,0 +1,29 @@
+#ifndef QNX_ERRNO_H
+#define QNX_ERRNO_H
+
+#include <features.h>
+
+/* QNX numbering of errno, see qnxsupport/qerrno.c */
+#define QNX_ERRNO_LINUX_MAX 134
+#define QNX_ERRNO_QNX_MAX 266
+
+hidden extern const unsigned short __qnx_errno_from_linux_tab[];
+hidden extern const unsigned char __qnx_errno_to_linux_tab[];
+
+/* The QNX view of errno, what __errno_location last saw it hold, and
+ * whether errno may have changed since __get_errno_ptr read it. */
+hidden extern int __qnx_errno, __qnx_errno_seen, __qnx_errno_dirty;
+
+static inline int __qnx_errno_from_linux(int e)
+{
+	return (unsigned)e < QNX_ERRNO_LINUX_MAX ?
+		__qnx_errno_from_linux_tab[e] : e;
+}
+
+static inline int __qnx_errno_to_linux(int e)
+{
+	return (unsigned)e < QNX_ERRNO_QNX_MAX ?
+		__qnx_errno_to_linux_tab[e] : e;
+}
+
+#endif
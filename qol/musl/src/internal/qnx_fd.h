@@ -0,0 +1,11 @@
+#ifndef QNX_FD_H
+#define QNX_FD_H
+
+#include <features.h>
+
+/* Called once fd has been closed or replaced by close, dup2, dup3 or
+ * a stream close, for the state qnxsupport keeps per fd number (the
+ * QNX_SOCK_RECVBATCH buffers of sockmsg.c). A no-op without them. */
+hidden void __qnx_fd_replaced(int);
+
+#endif
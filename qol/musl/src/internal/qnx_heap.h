@@ -0,0 +1,41 @@
+#ifndef QNX_HEAP_H
+#define QNX_HEAP_H
+
+#include <features.h>
+#include <stddef.h>
+
+/* A heap mode in front of the malloc backend. Once __qnx_heap is set,
+ * the public malloc, free, realloc, aligned_alloc and malloc_usable_size
+ * go through it for good; it owns the blocks it made and passes every
+ * other block to the backend's __libc_* functions. The internal
+ * __libc_malloc users (the loader, locales, atexit) never see it. */
+struct qnx_heap {
+	void *(*malloc)(size_t);
+	void (*free)(void *);
+	void *(*realloc)(void *, size_t);
+	void *(*aligned_alloc)(size_t, size_t);
+	size_t (*usable_size)(void *);
+};
+
+extern hidden const struct qnx_heap *__qnx_heap;
+
+/* QNX_HEAP_CHECK: guard page slots, canaries and a free quarantine, see
+ * qnxsupport/qheap.c. __qnx_heap_where tells the crash trace which
+ * guarded block a faulting address belongs to. */
+struct qnx_heap_where {
+	const void *block;
+	size_t size;
+	const char *what;
+};
+
+hidden void __qnx_heap_check_init(void);
+hidden int __qnx_heap_where(const void *, struct qnx_heap_where *);
+
+/* QNX_HEAP_PROFILE: sampled allocation stacks for pprof, see
+ * qnxsupport/qheapprof.c. */
+hidden void __qnx_heap_profile_init(void);
+
+/* Reports a heap error on stderr as "<who>: <what> <p>" and crashes. */
+hidden void __qnx_heap_die(const char *, const char *, void *);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef QNX_MALLOC_H
+#define QNX_MALLOC_H
+
+#include <features.h>
+#include <stddef.h>
+
+/* The knobs and statistics of the malloc backend behind QNX mallopt,
+ * mallinfo and _malloc_stats, see qnxsupport/qmalloc.c. The tcache
+ * backend has them; with any other, __malloc_tune fails and
+ * __malloc_info reports nothing. */
+enum {
+	MALLOC_TUNE_ARENA,	/* bytes mapped at once for small spans */
+	MALLOC_TUNE_TRIM,	/* bytes of freed large blocks kept mapped */
+	MALLOC_TUNE_TRIM_BLOCKS,	/* and how many of them */
+	MALLOC_TUNE_HOLD,	/* nonzero: never give memory back */
+	MALLOC_TUNE_RELEASE,	/* unmap the memory kept so far */
+};
+
+struct malloc_info {
+	size_t arena;		/* mapped for small classes */
+	size_t arena_free;	/* of which free, on the shared lists */
+	size_t arena_overhead;	/* of which headers and span tails */
+	size_t free_objects;	/* small objects on the shared lists */
+	size_t large, large_bytes;	/* live large blocks */
+	size_t kept, kept_bytes;	/* freed large blocks kept mapped */
+};
+
+/* Returns 0 on success, -1 for a knob the backend does not have. */
+hidden int __malloc_tune(int, size_t);
+hidden void __malloc_info(struct malloc_info *);
+
+#endif
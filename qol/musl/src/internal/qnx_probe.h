@@ -0,0 +1,58 @@
+#ifndef QNX_PROBE_H
+#define QNX_PROBE_H
+
+/* Static probe points of the "qol" provider, as .note.stapsdt entries
+ * in the format of systemtap's <sys/sdt.h>, so that bpftrace, perf and
+ * gdb find them by name (bpftrace -l 'usdt:/lib/libc.so:qol:*'). A
+ * probe is one nop, which a tracer replaces with a breakpoint while it
+ * is attached. The note only tells the tracer where the arguments are,
+ * in whatever register or stack slot they already were, so that an
+ * idle probe costs the nop and at most keeping its arguments live. */
+
+/* Size in bytes, negative for signed types, as the note gives it. */
+#define _QNX_PROBE_SIZE(x) \
+	((__typeof__((x)+0))-1 < (__typeof__((x)+0))0 ? \
+	 -(int)sizeof((x)+0) : (int)sizeof((x)+0))
+
+#define _QNX_PROBE_ARG(n, x) \
+	[_qs##n] "n" (_QNX_PROBE_SIZE(x)), [_qa##n] "nor" ((x)+0)
+
+#define _QNX_PROBE(name, args, ...) \
+	__asm__ __volatile__ ( \
+		"990: nop\n" \
+		".pushsection .note.stapsdt,\"\",\"note\"\n" \
+		".balign 4\n" \
+		".4byte 992f-991f, 994f-993f, 3\n" \
+		"991: .asciz \"stapsdt\"\n" \
+		"992: .balign 4\n" \
+		"993: .dc.a 990b, _.stapsdt.base, 0\n" \
+		".asciz \"qol\"\n" \
+		".asciz \"" #name "\"\n" \
+		".asciz \"" args "\"\n" \
+		"994: .balign 4\n" \
+		".popsection\n" \
+		".ifndef _.stapsdt.base\n" \
+		".pushsection .stapsdt.base,\"aG\",\"progbits\"," \
+			".stapsdt.base,comdat\n" \
+		".weak _.stapsdt.base\n" \
+		".hidden _.stapsdt.base\n" \
+		"_.stapsdt.base: .space 1\n" \
+		".size _.stapsdt.base, 1\n" \
+		".popsection\n" \
+		".endif\n" \
+		: : __VA_ARGS__)
+
+#define _QNX_PROBE_FMT(n) "%c[_qs" #n "]@%[_qa" #n "]"
+
+#define QNX_PROBE0(name) _QNX_PROBE(name, "")
+#define QNX_PROBE1(name, a) \
+	_QNX_PROBE(name, _QNX_PROBE_FMT(1), _QNX_PROBE_ARG(1, a))
+#define QNX_PROBE2(name, a, b) \
+	_QNX_PROBE(name, _QNX_PROBE_FMT(1) " " _QNX_PROBE_FMT(2), \
+		_QNX_PROBE_ARG(1, a), _QNX_PROBE_ARG(2, b))
+#define QNX_PROBE3(name, a, b, c) \
+	_QNX_PROBE(name, _QNX_PROBE_FMT(1) " " _QNX_PROBE_FMT(2) " " \
+		_QNX_PROBE_FMT(3), _QNX_PROBE_ARG(1, a), \
+		_QNX_PROBE_ARG(2, b), _QNX_PROBE_ARG(3, c))
+
+#endif
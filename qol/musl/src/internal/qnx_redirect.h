@@ -0,0 +1,27 @@
+#ifndef QNX_REDIRECT_H
+#define QNX_REDIRECT_H
+
+/* Entries collected by the linker into the qnx_redirect section of
+ * libc.so. The dynamic linker indexes them at stage 2 and resolves
+ * every reference to name from any DSO to target instead. */
+struct qnx_redirect {
+	const char *name, *target;
+};
+
+/* Declare that QNX binaries calling func must get _qnx_func, the shim
+ * defined next to this invocation. */
+#define QNX_REDIRECT(func) \
+	static const struct qnx_redirect __qnx_redirect_##func \
+	__attribute__((__used__, __section__("qnx_redirect"), \
+		__aligned__(sizeof(void *)))) = { #func, "_qnx_" #func }
+
+/* Like QNX_REDIRECT, to _qnx_cmplog_func, but only in processes that
+ * afl-fuzz runs with a CmpLog map (see qnxsupport/aflcmplog.c), so the
+ * plain function is bound, at no cost, everywhere else. */
+#define QNX_CMPLOG_PREFIX "_qnx_cmplog_"
+#define QNX_REDIRECT_CMPLOG(func) \
+	static const struct qnx_redirect __qnx_redirect_##func \
+	__attribute__((__used__, __section__("qnx_redirect"), \
+		__aligned__(sizeof(void *)))) = { #func, QNX_CMPLOG_PREFIX #func }
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef QNX_SHIMSTATS_H
+#define QNX_SHIMSTATS_H
+
+#include <features.h>
+#include <stddef.h>
+#include "qnx_redirect.h"
+
+/* LD_QNX_SHIMSTATS: call counts and latency histograms of the redirect
+ * targets, see qnxsupport/shimstats.c. The dynamic linker calls init
+ * with the qnx_redirect section before relocating anything, then wrap
+ * with the index of each redirect and the address its target resolved
+ * to, and binds references to the returned wrapper instead. */
+hidden int __qnx_shimstats_init(const struct qnx_redirect *, size_t);
+hidden void *__qnx_shimstats_wrap(size_t, void *);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef QNX_STATICDL_H
+#define QNX_STATICDL_H
+
+#include <features.h>
+#include <stddef.h>
+
+/* DSOs linked into a static binary by qol/qnxstatic.py, which writes
+ * __qnx_static_dsos: one entry per DSO, ended by a null name, each with
+ * its exported symbols sorted by name. The layout is repeated in the
+ * table that script generates. */
+struct qnx_static_sym {
+	const char *name;
+	void *addr;
+};
+
+struct qnx_static_dso {
+	const char *name;
+	const struct qnx_static_sym *syms;
+	size_t nsyms;
+};
+
+hidden void *__qnx_static_dlopen(const char *);
+hidden void *__qnx_static_dlsym(void *, const char *);
+hidden int __qnx_static_handle(void *);
+
+#endif
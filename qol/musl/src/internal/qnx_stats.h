@@ -0,0 +1,40 @@
+#ifndef QNX_STATS_H
+#define QNX_STATS_H
+
+#include <features.h>
+#include <stdint.h>
+
+/* LD_QNX_STATS: counters of the translation layer, readable while the
+ * process runs in /dev/shm/qnx-stats.<pid>, see qnxsupport/qstats.c.
+ * The first QNX_STAT_BATCHED are frequent and counted in the thread
+ * (struct pthread qnx_stats) until a batch is added to the file; the
+ * others count events that cost a system call anyway and are added at
+ * once. The loader's lookups and redirects are copied from its own
+ * counters whenever the file is updated. */
+enum {
+	QNX_STAT_ERRNO,		/* errno translated into the QNX view */
+	QNX_STAT_SLOGF,
+	QNX_STAT_MALLOC_SLOW,	/* allocations that refilled their class */
+	QNX_STAT_BATCHED,
+	QNX_STAT_MALLOC_MAP = QNX_STAT_BATCHED,	/* mapped on their own */
+	QNX_STAT_SPAWN,
+	QNX_STAT_SPAWN_FAIL,
+	QNX_STAT_LOOKUPS,
+	QNX_STAT_REDIRECTS,
+	QNX_STAT_N
+};
+
+hidden extern int __qnx_stats_on;
+hidden void __qnx_stats_init(void);
+hidden void __qnx_stat_add(int);
+
+/* The loader's symbol lookup and redirect counts, see ldso/dynlink.c. */
+hidden void __dl_qnx_lookups(uint64_t *, uint64_t *);
+
+static inline void __qnx_stat(int i)
+{
+	if (__qnx_stats_on)
+		__qnx_stat_add(i);
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef QNX_STDIO_H
+#define QNX_STDIO_H
+
+#include "stdio_impl.h"
+
+/* QNX_STDIO_MMAP: mmap-backed FILEs for reading, see __fopen_map.c */
+hidden void __qnx_stdio_init(void);
+
+/* A FILE reading fd out of a mapping, if mode and the file allow one
+ * and the mode is on; otherwise 0, and fd is left to __fdopen. */
+hidden FILE *__fopen_map(int, const char *);
+
+/* Makes room for ungetc in a FILE with F_MAP. */
+hidden void __fmap_unget(FILE *);
+
+/* Biased locking: the first thread to lock a FILE once threads exist
+ * owns it, and from then on locks it with a plain store to bias_held
+ * and a load of bias. Another thread that wants the FILE revokes the
+ * bias for good, through bias -2 while it is at it, with membarrier
+ * standing in for the fence the owner does not do, and waits for the
+ * owner to drop bias_held; after that the FILE only takes f->lock.
+ * bias_held is the owner's tid while it holds the FILE, so it tells
+ * __unlockfile which lock to drop. */
+hidden int __stdio_bias(FILE *, int);
+hidden int __stdio_bias_try(FILE *, int);
+hidden void __stdio_bias_wake(FILE *);
+
+static inline int __bias_lock(FILE *f, int tid)
+{
+	if (f->bias != tid) return 0;
+	f->bias_held = tid;
+	__asm__ __volatile__ ("" : : : "memory");
+	if (f->bias == tid) return 1;
+	__atomic_store_n(&f->bias_held, 0, __ATOMIC_RELEASE);
+	__stdio_bias_wake(f);
+	return 0;
+}
+
+static inline void __bias_unlock(FILE *f)
+{
+	__atomic_store_n(&f->bias_held, 0, __ATOMIC_RELEASE);
+	if (f->bias < 0) __stdio_bias_wake(f);
+}
+
+#endif
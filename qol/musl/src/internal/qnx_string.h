@@ -0,0 +1,28 @@
+#ifndef QNX_STRING_H
+#define QNX_STRING_H
+
+#include <features.h>
+#include <stddef.h>
+
+/* Where an arch has faster string functions for some CPUs than for its
+ * baseline, the public ones jump through __qnx_string. It starts out
+ * with the baseline versions, so it can be used before anything ran,
+ * and __qnx_string_init points it at the best ones for the CPU: the
+ * dynamic linker calls it on entry to stage 3, _init_libc again for
+ * static programs. Nothing else writes it, and no thread exists yet
+ * either time. The asm users hardcode the offsets. */
+struct qnx_string {
+	void *(*memcpy)(void *restrict, const void *restrict, size_t);
+	void *(*memset)(void *, int, size_t);
+	void *(*memchr)(const void *, int, size_t);
+	size_t (*strlen)(const char *);
+	int (*strcmp)(const char *, const char *);
+	/* Copies and fills from this size on bypass the cache. */
+	size_t nt_threshold;
+};
+
+extern hidden struct qnx_string __qnx_string;
+
+hidden void __qnx_string_init(void);
+
+#endif
@@ -17,6 +17,7 @@
 #define F_ERR 32
 #define F_SVB 64
 #define F_APP 128
+#define F_MAP 256
 
 struct _IO_FILE {
 	unsigned flags;
@@ -45,6 +46,7 @@ struct _IO_FILE {
 	off_t shlim, shcnt;
 	FILE *prev_locked, *next_locked;
 	struct __locale_struct *locale;
+	volatile int bias, bias_held;
 };
 
 extern hidden FILE *volatile __stdin_used;
@@ -79,6 +81,7 @@ hidden size_t __fwritex(const unsigned char *, size_t, FILE *);
 hidden int __putc_unlocked(int, FILE *);
 
 hidden FILE *__fdopen(int, const char *);
+hidden FILE *__fopen(const char *restrict, const char *restrict, int);
 hidden int __fmodeflags(const char *);
 
 hidden FILE *__ofl_add(FILE *f);
@@ -1,14 +1,32 @@
 #include <dlfcn.h>
 #include "dynlink.h"
+#include "qnx_staticdl.h"
 
 static void *stub_dlsym(void *restrict p, const char *restrict s, void *restrict ra)
 {
+	void *r = __qnx_static_dlsym(p, s);
+	if (r) return r;
 	__dl_seterr("Symbol not found: %s", s);
 	return 0;
 }
 
 weak_alias(stub_dlsym, __dlsym);
 
+static int stub_dlsym_many(void *restrict p, const char *const *restrict names, void **restrict out, size_t n)
+{
+	size_t i, found = 0;
+	for (i=0; i<n; i++)
+		if ((out[i] = __qnx_static_dlsym(p, names[i]))) found++;
+	for (i=0; i<n; i++)
+		if (!out[i]) {
+			__dl_seterr("Symbol not found: %s", names[i]);
+			break;
+		}
+	return found;
+}
+
+weak_alias(stub_dlsym_many, __dlsym_many);
+
 #if _REDIR_TIME64
 weak_alias(stub_dlsym, __dlsym_redir_time64);
 #endif
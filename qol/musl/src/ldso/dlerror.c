@@ -4,6 +4,7 @@
 #include "pthread_impl.h"
 #include "dynlink.h"
 #include "atomic.h"
+#include "qnx_staticdl.h"
 
 #define malloc __libc_malloc
 #define calloc __libc_calloc
@@ -82,6 +83,7 @@ hidden void __dl_seterr(const char *fmt, ...)
 
 static int stub_invalid_handle(void *h)
 {
+	if (__qnx_static_handle(h)) return 0;
 	__dl_seterr("Invalid library handle %p", (void *)h);
 	return 1;
 }
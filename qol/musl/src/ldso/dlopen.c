@@ -1,8 +1,11 @@
 #include <dlfcn.h>
 #include "dynlink.h"
+#include "qnx_staticdl.h"
 
 static void *stub_dlopen(const char *file, int mode)
 {
+	void *p = __qnx_static_dlopen(file);
+	if (p) return p;
 	__dl_seterr("Dynamic loading not supported");
 	return 0;
 }
@@ -0,0 +1,8 @@
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include "dynlink.h"
+
+int dlsym_many(void *restrict p, const char *const *restrict names, void **restrict out, size_t n)
+{
+	return __dlsym_many(p, names, out, n);
+}
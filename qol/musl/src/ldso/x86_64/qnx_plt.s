@@ -0,0 +1,85 @@
+# Lazy PLT entry point installed in GOT[2] by the dynamic linker when
+# LD_QNX_LAZY is set. PLT0 has pushed GOT[1] (the dso) above the
+# relocation index pushed by the PLT slot; all argument registers must
+# survive until the resolved function is entered. The resolver may run
+# deferred constructors, whose AVX code would clobber the upper halves
+# of vector arguments, so the whole extended state is kept with XSAVE
+# (FXSAVE where the OS has not enabled it). The area size is read from
+# CPUID leaf 0xd on the first call.
+.data
+.align 4
+xsave_size:
+	.long -1
+
+.text
+.global __dl_lazy_plt_resolve
+.hidden __dl_lazy_plt_resolve
+.hidden __dl_lazy_plt_fixup
+.type __dl_lazy_plt_resolve,@function
+__dl_lazy_plt_resolve:
+	push %rbx
+	push %rax
+	push %rcx
+	push %rdx
+	push %rsi
+	push %rdi
+	push %r8
+	push %r9
+	push %r10
+	mov xsave_size(%rip),%eax
+	test %eax,%eax
+	jns 1f
+	mov $1,%eax
+	cpuid
+	xor %eax,%eax
+	bt $27,%ecx
+	jnc 0f
+	mov $0xd,%eax
+	xor %ecx,%ecx
+	cpuid
+	mov %ebx,%eax
+0:	mov %eax,xsave_size(%rip)
+1:	lea 64(%rsp),%rbx
+	test %eax,%eax
+	jz 2f
+	sub %rax,%rsp
+	and $-64,%rsp
+	xor %eax,%eax
+	mov %rax,512(%rsp)
+	mov %rax,520(%rsp)
+	mov %rax,528(%rsp)
+	mov %rax,536(%rsp)
+	mov %rax,544(%rsp)
+	mov %rax,552(%rsp)
+	mov %rax,560(%rsp)
+	mov %rax,568(%rsp)
+	mov $-1,%eax
+	mov $-1,%edx
+	xsave (%rsp)
+	jmp 3f
+2:	sub $512,%rsp
+	and $-64,%rsp
+	fxsave (%rsp)
+3:	mov 8(%rbx),%rdi
+	mov 16(%rbx),%rsi
+	call __dl_lazy_plt_fixup
+	mov %rax,%r11
+	cmpl $0,xsave_size(%rip)
+	je 4f
+	mov $-1,%eax
+	mov $-1,%edx
+	xrstor (%rsp)
+	jmp 5f
+4:	fxrstor (%rsp)
+5:	lea -64(%rbx),%rsp
+	pop %r10
+	pop %r9
+	pop %r8
+	pop %rdi
+	pop %rsi
+	pop %rdx
+	pop %rcx
+	pop %rax
+	pop %rbx
+	add $16,%rsp
+	jmp *%r11
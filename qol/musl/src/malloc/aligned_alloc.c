@@ -0,0 +1,8 @@
+#include <stdlib.h>
+#include "qnx_heap.h"
+
+void *aligned_alloc(size_t align, size_t len)
+{
+	if (__qnx_heap) return __qnx_heap->aligned_alloc(align, len);
+	return __libc_aligned_alloc(align, len);
+}
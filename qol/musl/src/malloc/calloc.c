@@ -3,6 +3,7 @@
 #include <string.h>
 #include <errno.h>
 #include "dynlink.h"
+#include "qnx_heap.h"
 
 static size_t mal0_clear(char *p, size_t n)
 {
@@ -38,7 +39,7 @@ void *calloc(size_t m, size_t n)
 	}
 	n *= m;
 	void *p = malloc(n);
-	if (!p || (!__malloc_replaced && __malloc_allzerop(p)))
+	if (!p || (!__malloc_replaced && !__qnx_heap && __malloc_allzerop(p)))
 		return p;
 	n = mal0_clear(p, n);
 	return memset(p, 0, n);
@@ -1,6 +1,8 @@
 #include <stdlib.h>
+#include "qnx_heap.h"
 
 void free(void *p)
 {
-	__libc_free(p);
+	if (__qnx_heap) __qnx_heap->free(p);
+	else __libc_free(p);
 }
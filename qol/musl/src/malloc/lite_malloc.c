@@ -7,6 +7,7 @@
 #include "lock.h"
 #include "syscall.h"
 #include "fork_impl.h"
+#include "qnx_heap.h"
 
 #define ALIGN 16
 
@@ -112,6 +113,7 @@ void *__libc_malloc(size_t n)
 
 static void *default_malloc(size_t n)
 {
+	if (__qnx_heap) return __qnx_heap->malloc(n);
 	return __libc_malloc_impl(n);
 }
 
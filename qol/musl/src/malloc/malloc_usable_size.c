@@ -0,0 +1,9 @@
+#include <stdlib.h>
+#include <malloc.h>
+#include "qnx_heap.h"
+
+size_t malloc_usable_size(void *p)
+{
+	if (__qnx_heap) return __qnx_heap->usable_size(p);
+	return __libc_malloc_usable_size(p);
+}
@@ -23,6 +23,8 @@
 #define malloc __libc_malloc_impl
 #define realloc __libc_realloc
 #define free __libc_free
+#define aligned_alloc __libc_aligned_alloc
+#define malloc_usable_size __libc_malloc_usable_size
 
 #define USE_MADV_FREE 0
 
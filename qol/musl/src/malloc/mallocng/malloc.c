@@ -6,6 +6,8 @@
 #include <errno.h>
 
 #include "meta.h"
+#include "qnx_probe.h"
+#include "qnx_stats.h"
 
 LOCK_OBJ_DEF;
 
@@ -177,6 +179,8 @@ static struct meta *alloc_group(int sc, size_t req)
 	int i = 0, cnt;
 	unsigned char *p;
 	struct meta *m = alloc_meta();
+	QNX_PROBE2(malloc_group, sc, req);
+	__qnx_stat(QNX_STAT_MALLOC_SLOW);
 	if (!m) return 0;
 	size_t usage = ctx.usage_by_class[sc];
 	size_t pagesize = PGSZ;
@@ -307,6 +311,8 @@ void *malloc(size_t n)
 
 	if (n >= MMAP_THRESHOLD) {
 		size_t needed = n + IB + UNIT;
+		QNX_PROBE1(malloc_map, n);
+		__qnx_stat(QNX_STAT_MALLOC_MAP);
 		void *p = mmap(0, needed, PROT_READ|PROT_WRITE,
 			MAP_PRIVATE|MAP_ANON, -1, 0);
 		if (p==MAP_FAILED) return 0;
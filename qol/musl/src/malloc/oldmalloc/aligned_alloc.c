@@ -3,7 +3,7 @@
 #include <errno.h>
 #include "malloc_impl.h"
 
-void *aligned_alloc(size_t align, size_t len)
+void *__libc_aligned_alloc(size_t align, size_t len)
 {
 	unsigned char *mem, *new;
 
@@ -19,9 +19,9 @@ void *aligned_alloc(size_t align, size_t len)
 	}
 
 	if (align <= SIZE_ALIGN)
-		return malloc(len);
+		return __libc_malloc_impl(len);
 
-	if (!(mem = malloc(len + align-1)))
+	if (!(mem = __libc_malloc_impl(len + align-1)))
 		return 0;
 
 	new = (void *)((uintptr_t)mem + align-1 & -align);
@@ -1,6 +1,8 @@
 #include <stdlib.h>
+#include "qnx_heap.h"
 
 void *realloc(void *p, size_t n)
 {
+	if (__qnx_heap) return __qnx_heap->realloc(p, n);
 	return __libc_realloc(p, n);
 }
@@ -1,4 +1,6 @@
 #include "dynlink.h"
+#include "qnx_heap.h"
 
 int __malloc_replaced;
 int __aligned_alloc_replaced;
+const struct qnx_heap *__qnx_heap;
@@ -0,0 +1,34 @@
+#include <stdlib.h>
+#include <errno.h>
+
+#include "meta.h"
+
+void *aligned_alloc(size_t align, size_t len)
+{
+	if ((align & -align) != align) {
+		errno = EINVAL;
+		return 0;
+	}
+
+	if (len > SIZE_MAX - align || align > PTRDIFF_MAX/4) {
+		errno = ENOMEM;
+		return 0;
+	}
+
+	if (DISABLE_ALIGNED_ALLOC) {
+		errno = ENOMEM;
+		return 0;
+	}
+
+	if (align <= UNIT) return malloc(len);
+
+	// the power-of-two classes up to 4096 hold objects aligned to
+	// their size.
+	if (len <= 4096 && align <= 4096) {
+		size_t n = len > align ? len : align;
+		n = (size_t)1 << (8*sizeof(long) - __builtin_clzl(n-1));
+		return malloc(n);
+	}
+
+	return large_alloc(len, align);
+}
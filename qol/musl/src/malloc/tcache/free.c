@@ -0,0 +1,39 @@
+#define _BSD_SOURCE
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <errno.h>
+
+#include "meta.h"
+
+void free(void *p)
+{
+	if (!p) return;
+
+	struct span *s = get_span(p);
+	if (s->sc == LARGE) {
+		large_free(s);
+		return;
+	}
+	assert(s->sc < NCLASS);
+
+	struct obj *o = p;
+	struct tcache *tc = __pthread_self()->malloc_tcache;
+	struct bin tmp = { 0 }, *b = tc ? &tc->bins[s->sc] : &tmp;
+	o->next = b->head;
+	b->head = o;
+	if (++b->count > (tc ? bin_limit(s->sc) : 0))
+		flush_bin(b, s->sc, tc ? b->count/2 : 1);
+}
+
+void __malloc_thread_exit(void)
+{
+	pthread_t self = __pthread_self();
+	struct tcache *tc = self->malloc_tcache;
+	if (!tc) return;
+
+	self->malloc_tcache = 0;
+	for (int sc=0; sc<NCLASS; sc++)
+		if (tc->bins[sc].count)
+			flush_bin(&tc->bins[sc], sc, tc->bins[sc].count);
+	free(tc);
+}
@@ -0,0 +1,47 @@
+#ifndef MALLOC_GLUE_H
+#define MALLOC_GLUE_H
+
+#include <stdint.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <string.h>
+#include "atomic.h"
+#include "syscall.h"
+#include "libc.h"
+#include "lock.h"
+#include "dynlink.h"
+#include "pthread_impl.h"
+
+// use macros to appropriately namespace these.
+#define size_classes __malloc_size_classes
+#define class_offsets __malloc_class_offsets
+#define ctx __malloc_context
+#define get_tcache __malloc_get_tcache
+#define fill_bin __malloc_fill_bin
+#define flush_bin __malloc_flush_bin
+#define map_aligned __malloc_map_aligned
+#define large_alloc __malloc_large_alloc
+#define large_free __malloc_large_free
+#define is_allzero __malloc_allzerop
+
+#define malloc __libc_malloc_impl
+#define realloc __libc_realloc
+#define free __libc_free
+#define aligned_alloc __libc_aligned_alloc
+#define malloc_usable_size __libc_malloc_usable_size
+
+#undef assert
+#define assert(x) do { if (!(x)) a_crash(); } while(0)
+
+#define mmap __mmap
+#define munmap __munmap
+#define mremap __mremap
+
+#define DISABLE_ALIGNED_ALLOC (__malloc_replaced && !__aligned_alloc_replaced)
+
+#ifndef PAGESIZE
+#define PAGESIZE PAGE_SIZE
+#endif
+
+#endif
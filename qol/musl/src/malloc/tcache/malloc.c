@@ -0,0 +1,331 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <errno.h>
+
+#include "meta.h"
+#include "qnx_probe.h"
+#include "qnx_stats.h"
+#include "qnx_malloc.h"
+
+const uint16_t size_classes[] = {
+	16, 32, 48, 64, 80, 96, 112, 128,
+	144, 160, 176, 192, 208, 224, 240, 256,
+	320, 384, 448, 512, 640, 768, 896, 1024,
+	1280, 1536, 1792, 2048, 2560, 3072, 3584, 4096,
+	5120, 6144, 7168, 8192, 10240, 12288, 14336, 16384,
+	20480, 24576, 28672, 32768,
+};
+
+// objects of the power-of-two classes up to 4096 are aligned to their
+// size, which is what aligned_alloc relies on.
+const uint16_t class_offsets[] = {
+	64, 64, 64, 64, 64, 64, 64, 128,
+	64, 64, 64, 64, 64, 64, 64, 256,
+	64, 64, 64, 512, 64, 64, 64, 1024,
+	64, 64, 64, 2048, 64, 64, 64, 4096,
+	64, 64, 64, 64, 64, 64, 64, 64,
+	64, 64, 64, 64,
+};
+
+struct malloc_context ctx = { .trim_blocks = 64 };
+
+// maps len bytes at an address s with s+skew a multiple of align.
+void *map_aligned(size_t len, size_t align, size_t skew)
+{
+	size_t total = len + align - PAGESIZE;
+	unsigned char *base = mmap(0, total, PROT_READ|PROT_WRITE,
+		MAP_PRIVATE|MAP_ANON, -1, 0);
+	if (base == MAP_FAILED) return 0;
+	size_t head = -(uintptr_t)(base + skew) & (align-1);
+	if (head) munmap(base, head);
+	if (total - head > len) munmap(base + head + len, total - head - len);
+	return base + head;
+}
+
+// cuts a span for class sc from the arena, mapping ctx.arena bytes of
+// new spans when it is used up.
+static int new_span(struct central *c, int sc)
+{
+	struct span *s = 0;
+
+	LOCK(ctx.arena_lock);
+	if (ctx.reserve == ctx.reserve_end) {
+		size_t n = ctx.arena ? ctx.arena : SPAN;
+		unsigned char *p = map_aligned(n, SPAN, 0);
+		if (!p && n > SPAN) p = map_aligned(n = SPAN, SPAN, 0);
+		if (p) {
+			ctx.reserve = p;
+			ctx.reserve_end = p + n;
+			ctx.spans += n / SPAN;
+		}
+	}
+	if (ctx.reserve != ctx.reserve_end) {
+		s = (void *)ctx.reserve;
+		ctx.reserve += SPAN;
+		ctx.overhead += class_offsets[sc] +
+			(SPAN - class_offsets[sc]) % size_classes[sc];
+	}
+	UNLOCK(ctx.arena_lock);
+	QNX_PROBE2(malloc_span, sc, s);
+	if (!s) return 0;
+	s->magic = SPAN_MAGIC;
+	s->sc = sc;
+	c->avail = (unsigned char *)s + class_offsets[sc];
+	c->end = (unsigned char *)s + SPAN;
+	return 1;
+}
+
+// moves up to n objects of class sc from the central list, carving new
+// ones when it runs dry, to b. returns how many it got.
+unsigned fill_bin(struct bin *b, int sc, unsigned n)
+{
+	struct central *c = &ctx.central[sc];
+	size_t size = size_classes[sc];
+	unsigned k;
+
+	QNX_PROBE2(malloc_fill, sc, n);
+	__qnx_stat(QNX_STAT_MALLOC_SLOW);
+	LOCK(c->lock);
+	for (k=0; k<n; k++) {
+		struct obj *o = c->free;
+		if (o) {
+			c->free = o->next;
+			c->nfree--;
+		} else {
+			if ((size_t)(c->end - c->avail) < size && !new_span(c, sc))
+				break;
+			o = (void *)c->avail;
+			c->avail += size;
+		}
+		o->next = b->head;
+		b->head = o;
+	}
+	UNLOCK(c->lock);
+	b->count += k;
+	return k;
+}
+
+// gives the n objects at the head of b back to the central list.
+void flush_bin(struct bin *b, int sc, unsigned n)
+{
+	struct central *c = &ctx.central[sc];
+	struct obj *head = b->head, *tail = head;
+
+	for (unsigned i=1; i<n; i++) tail = tail->next;
+	b->head = tail->next;
+	b->count -= n;
+	LOCK(c->lock);
+	tail->next = c->free;
+	c->free = head;
+	c->nfree += n;
+	UNLOCK(c->lock);
+}
+
+struct tcache *get_tcache(void)
+{
+	pthread_t self = __pthread_self();
+	struct tcache *tc = self->malloc_tcache;
+	if (tc) return tc;
+
+	// the cache is an object of its own class, taken from the
+	// central list so that it can be freed like any other.
+	struct bin b = { 0 };
+	if (!fill_bin(&b, size_to_class(sizeof *tc), 1)) return 0;
+	tc = (void *)b.head;
+	memset(tc, 0, sizeof *tc);
+	self->malloc_tcache = tc;
+	return tc;
+}
+
+// takes the smallest kept block of len to 2*len bytes off ctx.kept.
+static struct span *take_kept(size_t len)
+{
+	struct span **p, **best = 0;
+
+	for (p=&ctx.kept; *p; p=&(*p)->next)
+		if ((*p)->len >= len && (*p)->len - len <= len &&
+		    (!best || (*p)->len < (*best)->len))
+			best = p;
+	if (!best) return 0;
+	struct span *s = *best;
+	*best = s->next;
+	ctx.kept_count--;
+	ctx.kept_bytes -= s->len;
+	return s;
+}
+
+void *large_alloc(size_t n, size_t align)
+{
+	size_t off = align < SPAN_HDR ? SPAN_HDR : align < SPAN ? align : SPAN;
+	size_t a = align < SPAN ? SPAN : align;
+	if (n > PTRDIFF_MAX - off - a) {
+		errno = ENOMEM;
+		return 0;
+	}
+	size_t len = (off + n + PAGESIZE-1) & -PAGESIZE;
+	struct span *s = 0;
+
+	// kept blocks start at a multiple of SPAN, which is all that
+	// alignments below SPAN need.
+	if (ctx.kept && align < SPAN) {
+		LOCK(ctx.large_lock);
+		s = take_kept(len);
+		UNLOCK(ctx.large_lock);
+	}
+	if (s) {
+		if (s->len > len && !ctx.hold) {
+			munmap((unsigned char *)s + len, s->len - len);
+			s->len = len;
+		}
+	} else {
+		QNX_PROBE1(malloc_map, n);
+		__qnx_stat(QNX_STAT_MALLOC_MAP);
+		s = map_aligned(len, a, align < SPAN ? 0 : SPAN);
+		if (!s) return 0;
+		s->flags = 0;
+		s->len = len;
+	}
+	s->magic = SPAN_MAGIC;
+	s->sc = LARGE;
+	s->off = off;
+	LOCK(ctx.large_lock);
+	ctx.large_count++;
+	ctx.large_bytes += s->len;
+	UNLOCK(ctx.large_lock);
+	return (unsigned char *)s + off;
+}
+
+// keeps the freed large block s for reuse while the limits allow,
+// unmaps it otherwise.
+void large_free(struct span *s)
+{
+	LOCK(ctx.large_lock);
+	ctx.large_count--;
+	ctx.large_bytes -= s->len;
+	int keep = ctx.hold || (ctx.kept_count < ctx.trim_blocks &&
+		ctx.kept_bytes + s->len <= ctx.trim);
+	if (keep) {
+		// a second free of it fails get_span's check.
+		s->magic = 0;
+		s->flags |= SPAN_DIRTY;
+		s->next = ctx.kept;
+		ctx.kept = s;
+		ctx.kept_count++;
+		ctx.kept_bytes += s->len;
+	}
+	UNLOCK(ctx.large_lock);
+	if (!keep) {
+		int e = errno;
+		munmap(s, s->len);
+		errno = e;
+	}
+}
+
+void *malloc(size_t n)
+{
+	if (n > MAX_SMALL) return large_alloc(n, UNIT);
+
+	int sc = size_to_class(n);
+	struct tcache *tc = get_tcache();
+	struct bin tmp = { 0 }, *b = tc ? &tc->bins[sc] : &tmp;
+	if (!b->head && !fill_bin(b, sc, tc ? bin_limit(sc)/2 : 1)) {
+		errno = ENOMEM;
+		return 0;
+	}
+	struct obj *o = b->head;
+	b->head = o->next;
+	b->count--;
+	return o;
+}
+
+int is_allzero(void *p)
+{
+	// large allocations are fresh anonymous mappings, unless kept.
+	struct span *s = get_span(p);
+	return s->sc == LARGE && !(s->flags & SPAN_DIRTY);
+}
+
+void __malloc_donate(char *start, char *end)
+{
+	// spans have to be SPAN-aligned, which the gaps the dynamic
+	// linker finds between segments never are.
+}
+
+static void release_kept(void)
+{
+	LOCK(ctx.large_lock);
+	struct span *s = ctx.kept, *next;
+	ctx.kept = 0;
+	ctx.kept_count = ctx.kept_bytes = 0;
+	UNLOCK(ctx.large_lock);
+	for (; s; s=next) {
+		next = s->next;
+		munmap(s, s->len);
+	}
+}
+
+int __malloc_tune(int knob, size_t v)
+{
+	switch (knob) {
+	case MALLOC_TUNE_ARENA:
+		if (v > MAX_ARENA) v = MAX_ARENA;
+		LOCK(ctx.arena_lock);
+		ctx.arena = (v + SPAN-1) & -(size_t)SPAN;
+		UNLOCK(ctx.arena_lock);
+		return 0;
+	case MALLOC_TUNE_TRIM:
+	case MALLOC_TUNE_TRIM_BLOCKS:
+	case MALLOC_TUNE_HOLD:
+		LOCK(ctx.large_lock);
+		if (knob == MALLOC_TUNE_TRIM) ctx.trim = v;
+		else if (knob == MALLOC_TUNE_TRIM_BLOCKS) ctx.trim_blocks = v;
+		else ctx.hold = !!v;
+		UNLOCK(ctx.large_lock);
+		return 0;
+	case MALLOC_TUNE_RELEASE:
+		release_kept();
+		return 0;
+	}
+	return -1;
+}
+
+// objects in the bins of threads count as in use: other threads' bins
+// cannot be looked at safely.
+void __malloc_info(struct malloc_info *mi)
+{
+	*mi = (struct malloc_info){ 0 };
+	for (int sc=0; sc<NCLASS; sc++) {
+		struct central *c = &ctx.central[sc];
+		size_t size = size_classes[sc];
+		LOCK(c->lock);
+		mi->free_objects += c->nfree;
+		mi->arena_free += c->nfree*size + (c->end - c->avail)/size*size;
+		UNLOCK(c->lock);
+	}
+	LOCK(ctx.arena_lock);
+	mi->arena = ctx.spans * SPAN;
+	mi->arena_free += ctx.reserve_end - ctx.reserve;
+	mi->arena_overhead = ctx.overhead;
+	UNLOCK(ctx.arena_lock);
+	LOCK(ctx.large_lock);
+	mi->large = ctx.large_count;
+	mi->large_bytes = ctx.large_bytes;
+	mi->kept = ctx.kept_count;
+	mi->kept_bytes = ctx.kept_bytes;
+	UNLOCK(ctx.large_lock);
+}
+
+void __malloc_atfork(int who)
+{
+	// the class locks are taken before the arena lock, as in fill_bin.
+	for (int i=0; i<NCLASS+2; i++) {
+		volatile int *lock = i < NCLASS ? ctx.central[i].lock :
+			i == NCLASS ? ctx.arena_lock : ctx.large_lock;
+		if (who<0) LOCK(lock);
+		else if (who>0) lock[0] = 0;
+		else UNLOCK(lock);
+	}
+}
@@ -0,0 +1,8 @@
+#include <stdlib.h>
+#include "meta.h"
+
+size_t malloc_usable_size(void *p)
+{
+	if (!p) return 0;
+	return usable_size(get_span(p));
+}
@@ -0,0 +1,139 @@
+#ifndef MALLOC_META_H
+#define MALLOC_META_H
+
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
+#include "glue.h"
+
+/*
+ * Memory comes in spans of SPAN bytes, SPAN-aligned, with a header at
+ * the start. A small span holds objects of one size class; a large
+ * allocation is a span of its own, its own mapping, with the header in
+ * front of the user memory. Either way the header of p is found by
+ * rounding p-1 down to SPAN.
+ *
+ * Each thread keeps a bin of free objects per class in its tcache and
+ * only takes the class lock to move a batch between its bin and the
+ * class's central free list. Small spans are not returned to the
+ * kernel: their objects go back to the central lists and are reused by
+ * any thread.
+ *
+ * New spans are cut from an arena of ctx.arena bytes mapped at once.
+ * With ctx.trim or ctx.hold set, freed large allocations stay mapped
+ * on ctx.kept for reuse by later large allocations instead of being
+ * unmapped, up to ctx.trim bytes and ctx.trim_blocks blocks, or all of
+ * them with hold. These are the knobs QNX mallopt turns.
+ */
+
+#define UNIT 16
+#define SPAN (256<<10)
+#define SPAN_HDR 64
+#define SPAN_MAGIC 0x6e617073
+#define NCLASS 44
+#define MAX_SMALL 32768
+#define LARGE 0xffff
+#define MAX_ARENA (256*SPAN)
+
+/* Large span flag: the memory was used before, so calloc must clear it. */
+#define SPAN_DIRTY 1
+
+struct obj {
+	struct obj *next;
+};
+
+struct span {
+	uint32_t magic;
+	uint16_t sc;
+	uint16_t flags;
+	/* Large only: length of the mapping and of the header gap, and the
+	 * next kept block while on ctx.kept. */
+	size_t len;
+	size_t off;
+	struct span *next;
+};
+
+struct central {
+	volatile int lock[1];
+	struct obj *free;
+	/* Not yet carved part of the class's newest span. */
+	unsigned char *avail, *end;
+	size_t nfree;
+};
+
+struct bin {
+	struct obj *head;
+	unsigned count;
+};
+
+struct tcache {
+	struct bin bins[NCLASS];
+};
+
+struct malloc_context {
+	struct central central[NCLASS];
+	/* Spans not yet handed to a class; ctx.spans counts all mapped. */
+	volatile int arena_lock[1];
+	unsigned char *reserve, *reserve_end;
+	size_t arena, spans, overhead;
+	volatile int large_lock[1];
+	struct span *kept;
+	size_t kept_count, kept_bytes, trim, trim_blocks;
+	size_t large_count, large_bytes;
+	int hold;
+};
+
+__attribute__((__visibility__("hidden")))
+extern const uint16_t size_classes[], class_offsets[];
+
+__attribute__((__visibility__("hidden")))
+extern struct malloc_context ctx;
+
+__attribute__((__visibility__("hidden")))
+struct tcache *get_tcache(void);
+
+__attribute__((__visibility__("hidden")))
+void *map_aligned(size_t, size_t, size_t);
+
+__attribute__((__visibility__("hidden")))
+void *large_alloc(size_t, size_t);
+
+__attribute__((__visibility__("hidden")))
+void large_free(struct span *);
+
+__attribute__((__visibility__("hidden")))
+unsigned fill_bin(struct bin *, int, unsigned);
+
+__attribute__((__visibility__("hidden")))
+void flush_bin(struct bin *, int, unsigned);
+
+/* 16-byte classes up to 256, then four per doubling up to MAX_SMALL. */
+static inline int size_to_class(size_t n)
+{
+	if (n <= 256) return n ? (n-1)>>4 : 0;
+	int b = 8*sizeof(long)-1 - __builtin_clzl(n-1);
+	return 16 + 4*(b-8) + ((n-1)>>(b-2) & 3);
+}
+
+static inline struct span *get_span(const void *p)
+{
+	struct span *s = (void *)(((uintptr_t)p - 1) & -(uintptr_t)SPAN);
+	assert(s->magic == SPAN_MAGIC);
+	assert(!((uintptr_t)p & (UNIT-1)));
+	return s;
+}
+
+static inline size_t usable_size(const struct span *s)
+{
+	return s->sc == LARGE ? s->len - s->off : size_classes[s->sc];
+}
+
+/* How many free objects a thread keeps per class before it gives half
+ * of them back. */
+static inline unsigned bin_limit(int sc)
+{
+	unsigned n = (64<<10) / size_classes[sc];
+	return n < 8 ? 8 : n > 128 ? 128 : n;
+}
+
+#endif
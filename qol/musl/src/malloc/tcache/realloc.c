@@ -0,0 +1,60 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <string.h>
+
+#include "meta.h"
+
+// moves the pages of s to a new mapping of len bytes at a multiple of
+// SPAN; the kernel remaps them rather than copying.
+static struct span *move_large(struct span *s, size_t len)
+{
+	void *t = map_aligned(len, SPAN, 0);
+	if (!t) return 0;
+	if (mremap(s, s->len, len, MREMAP_MAYMOVE|MREMAP_FIXED, t) == MAP_FAILED) {
+		munmap(t, len);
+		return 0;
+	}
+	return t;
+}
+
+void *realloc(void *p, size_t n)
+{
+	if (!p) return malloc(n);
+
+	struct span *s = get_span(p);
+	size_t old = usable_size(s);
+
+	if (s->sc != LARGE) {
+		if (n <= old && n >= old/2) return p;
+	} else if (n > MAX_SMALL && n <= PTRDIFF_MAX - s->off - PAGESIZE) {
+		size_t len = (s->off + n + PAGESIZE-1) & -PAGESIZE, want = len;
+		struct span *t = s;
+		if (len <= s->len) {
+			// what is mapped stays while at least half of it is used.
+			if (len >= s->len/2 || ctx.hold) return p;
+			munmap((unsigned char *)s + len, s->len - len);
+		} else {
+			// a block that grows is given half as much again, so that
+			// one growing in small steps is remapped O(log n) times.
+			want = len + (len/2 & -PAGESIZE);
+			// only blocks aligned to less than SPAN can move: the
+			// others' alignment is not recorded.
+			if (mremap(s, s->len, want, 0) == MAP_FAILED)
+				t = s->off < SPAN ? move_large(s, want) : 0;
+		}
+		if (t) {
+			LOCK(ctx.large_lock);
+			ctx.large_bytes += want - t->len;
+			UNLOCK(ctx.large_lock);
+			t->len = want;
+			return (unsigned char *)t + t->off;
+		}
+	}
+
+	void *new = malloc(n);
+	if (!new) return 0;
+	memcpy(new, p, n < old ? n : old);
+	free(p);
+	return new;
+}
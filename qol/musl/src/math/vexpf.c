@@ -0,0 +1,23 @@
+#define _GNU_SOURCE
+#include <math.h>
+#include "vmath.h"
+
+static inline vd expd(vd x)
+{
+	/* Beyond ±150 the float result is 0 or inf either way. */
+	x = vd_sel(x > 150, (vd){0} + 150, x);
+	x = vd_sel(x < -150, (vd){0} - 150, x);
+	return vd_exp2(x * 0x1.71547652b82fep0);
+}
+
+void vexpf(float *y, const float *x, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i + VLEN <= n; i += VLEN) {
+		vf v = vf_load(x + i);
+		vf_store(y + i, vf_join(expd(vd_half(v, 0)), expd(vd_half(v, 1))));
+	}
+	for (; i < n; i++)
+		y[i] = expf(x[i]);
+}
@@ -0,0 +1,23 @@
+#define _GNU_SOURCE
+#include <math.h>
+#include "vmath.h"
+
+void vfloorf(float *y, const float *x, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i + VLEN <= n; i += VLEN) {
+		vf v = vf_load(x + i), t;
+		/* From 2^23 on, and for inf and NaN, x is its own floor. */
+		vi small = ((vi)v & 0x7fffffff) < 0x4b000000;
+
+		t = __builtin_convertvector(__builtin_convertvector(
+			vf_sel(small, v, (vf){0}), vi), vf);
+		t -= vf_sel(t > v, (vf){0} + 1, (vf){0});
+		/* The floor has the sign of x, which only a zero has lost. */
+		t = (vf)((vi)t | ((vi)v & (vi){0} + INT32_MIN));
+		vf_store(y + i, vf_sel(small, t, v));
+	}
+	for (; i < n; i++)
+		y[i] = floorf(x[i]);
+}
@@ -0,0 +1,29 @@
+#define _GNU_SOURCE
+#include <math.h>
+#include "vmath.h"
+
+/* Below 2^23 in magnitude, adding and taking away 2^23 with the sign of
+ * x rounds x to an integer in the current rounding mode, as lrintf does. */
+
+void vlrintf(long *y, const float *x, size_t n)
+{
+	size_t i, j;
+
+	for (i = 0; i + VLEN <= n; i += VLEN) {
+		vf v = vf_load(x + i);
+
+		vf s = (vf)(((vi)v & INT32_MIN) | 0x4b000000);
+
+		if (!vi_all(((vi)v & 0x7fffffff) < 0x4b000000)) {
+			for (j = i; j < i + VLEN; j++)
+				y[j] = lrintf(x[j]);
+			continue;
+		}
+		v = v + s - s;
+		vi r = __builtin_convertvector(v, vi);
+		for (j = 0; j < VLEN; j++)
+			y[i + j] = r[j];
+	}
+	for (; i < n; i++)
+		y[i] = lrintf(x[i]);
+}
@@ -0,0 +1,79 @@
+#ifndef _VMATH_H
+#define _VMATH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "exp2f_data.h"
+
+/* The array functions (vexpf, vpowf, vlrintf, vfloorf) go VLEN
+ * elements at a time in GCC vector types, which the compiler maps to
+ * SSE2 on x86_64 and NEON on aarch64, and take the remainder of the
+ * array, and any group that leaves their fast path, through the scalar
+ * function. vexpf and vpowf are expf and powf done two lanes at a time
+ * in double, with the same tables and hence the same error bounds. */
+
+#define VLEN 4
+
+typedef float vf __attribute__((__vector_size__(16)));
+typedef int32_t vi __attribute__((__vector_size__(16)));
+typedef double vd __attribute__((__vector_size__(16)));
+typedef int64_t vl __attribute__((__vector_size__(16)));
+typedef uint64_t vu __attribute__((__vector_size__(16)));
+typedef float vf_u __attribute__((__vector_size__(16), __aligned__(1)));
+
+static inline vf vf_load(const float *p)
+{
+	return *(const vf_u *)p;
+}
+
+static inline void vf_store(float *p, vf v)
+{
+	*(vf_u *)p = v;
+}
+
+/* A vd holds half a vf: lanes h*2 and h*2+1. */
+static inline vd vd_half(vf v, int h)
+{
+	return (vd){ v[2*h], v[2*h+1] };
+}
+
+static inline vf vf_join(vd a, vd b)
+{
+	return (vf){ a[0], a[1], b[0], b[1] };
+}
+
+/* Lanes of a where m is set, of b elsewhere. */
+static inline vd vd_sel(vl m, vd a, vd b)
+{
+	return (vd)((m & (vl)a) | (~m & (vl)b));
+}
+
+static inline vf vf_sel(vi m, vf a, vf b)
+{
+	return (vf)((m & (vi)a) | (~m & (vi)b));
+}
+
+static inline int vi_all(vi m)
+{
+	return (m[0] & m[1] & m[2] & m[3]) != 0;
+}
+
+/* 2^x for |x| < 1000, or NaN for NaN, the way exp2f and powf get it:
+ * 2^(k/N) from __exp2f_data's table times a cubic in the rest. */
+static inline vd vd_exp2(vd x)
+{
+	vd k = x + __exp2f_data.shift_scaled, r, r2, y;
+	vu ki = (vu)k, t;
+
+	k -= __exp2f_data.shift_scaled;
+	r = x - k;
+	t = (vu){ __exp2f_data.tab[ki[0] % (1 << EXP2F_TABLE_BITS)],
+		  __exp2f_data.tab[ki[1] % (1 << EXP2F_TABLE_BITS)] };
+	t += ki << (52 - EXP2F_TABLE_BITS);
+	r2 = r * r;
+	y = (__exp2f_data.poly[0] * r + __exp2f_data.poly[1]) * r2
+		+ (__exp2f_data.poly[2] * r + 1);
+	return y * (vd)t;
+}
+
+#endif
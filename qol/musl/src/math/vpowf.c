@@ -0,0 +1,52 @@
+#define _GNU_SOURCE
+#include <math.h>
+#include "vmath.h"
+#include "powf_data.h"
+
+/* The fast path of powf, for x in [FLT_MIN, inf) and finite y; groups
+ * with anything else go to powf. */
+
+#define N (1 << POWF_LOG2_TABLE_BITS)
+#define T __powf_log2_data.tab
+#define A __powf_log2_data.poly
+#define OFF 0x3f330000
+
+static inline vd powd(vf zf, vi ki, vi ii, vf yf, int h)
+{
+	vd z = vd_half(zf, h), k = vd_half(__builtin_convertvector(ki, vf), h);
+	vd invc = { T[ii[2*h]].invc, T[ii[2*h+1]].invc };
+	vd logc = { T[ii[2*h]].logc, T[ii[2*h+1]].logc };
+	vd r = z * invc - 1, r2 = r * r, y0 = logc + k, l;
+
+	/* log2(x) = log1p(z/c-1)/ln2 + log2(c) + k, as in powf. */
+	l = (A[0] * r + A[1]) * (r2 * r2) + ((A[2] * r + A[3]) * r2
+		+ (A[4] * r + y0));
+	l *= vd_half(yf, h) / POWF_SCALE;
+	l = vd_sel(l > 129, (vd){0} + 129, l);
+	l = vd_sel(l < -151, (vd){0} - 151, l);
+	return vd_exp2(l);
+}
+
+void vpowf(float *z, const float *x, const float *y, size_t n)
+{
+	size_t i, j;
+
+	for (i = 0; i + VLEN <= n; i += VLEN) {
+		vf xf = vf_load(x + i), yf = vf_load(y + i);
+		vi ix = (vi)xf, tmp = ix - OFF, top = tmp & (vi){0} + 0xff800000;
+
+		if (!vi_all((ix >= 0x00800000) & (ix < 0x7f800000) &
+			    (((vi)yf & 0x7fffffff) < 0x7f800000))) {
+			for (j = i; j < i + VLEN; j++)
+				z[j] = powf(x[j], y[j]);
+			continue;
+		}
+		vf zf = (vf)(ix - top);
+		vi ki = top >> (23 - POWF_SCALE_BITS);
+		vi ii = tmp >> (23 - POWF_LOG2_TABLE_BITS) & N - 1;
+		vf_store(z + i, vf_join(powd(zf, ki, ii, yf, 0),
+					powd(zf, ki, ii, yf, 1)));
+	}
+	for (; i < n; i++)
+		z[i] = powf(x[i], y[i]);
+}
@@ -17,6 +17,7 @@ weak_alias(dummy_lockptr, __stdio_ofl_lockptr);
 weak_alias(dummy_lockptr, __syslog_lockptr);
 weak_alias(dummy_lockptr, __timezone_lockptr);
 weak_alias(dummy_lockptr, __bump_lockptr);
+weak_alias(dummy_lockptr, __map_cache_lockptr);
 
 weak_alias(dummy_lockptr, __vmlock_lockptr);
 
@@ -31,6 +32,7 @@ static volatile int *const *const atfork_locks[] = {
 	&__syslog_lockptr,
 	&__timezone_lockptr,
 	&__bump_lockptr,
+	&__map_cache_lockptr,
 };
 
 static void dummy(int x) { }
@@ -39,6 +41,9 @@ weak_alias(dummy, __malloc_atfork);
 weak_alias(dummy, __aio_atfork);
 weak_alias(dummy, __pthread_key_atfork);
 weak_alias(dummy, __ldso_atfork);
+weak_alias(dummy, __qnx_shimstats_atfork);
+weak_alias(dummy, __qnx_stats_atfork);
+weak_alias(dummy, __qnx_sync_atfork);
 
 static void dummy_0(void) { }
 weak_alias(dummy_0, __tl_lock);
@@ -53,6 +58,7 @@ pid_t fork(void)
 	if (need_locks) {
 		__ldso_atfork(-1);
 		__pthread_key_atfork(-1);
+		__qnx_sync_atfork(-1);
 		__aio_atfork(-1);
 		__inhibit_ptc();
 		for (int i=0; i<sizeof atfork_locks/sizeof *atfork_locks; i++)
@@ -80,9 +86,12 @@ pid_t fork(void)
 				else **atfork_locks[i] = 0;
 		__release_ptc();
 		if (ret) __aio_atfork(0);
+		__qnx_sync_atfork(!ret);
 		__pthread_key_atfork(!ret);
 		__ldso_atfork(!ret);
 	}
+	__qnx_shimstats_atfork(!ret);
+	__qnx_stats_atfork(!ret);
 	__restore_sigs(&set);
 	__fork_handler(!ret);
 	if (ret<0) errno = errno_save;
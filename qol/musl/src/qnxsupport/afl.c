@@ -0,0 +1,236 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/shm.h>
+#include <sys/wait.h>
+#include "qnx_afl.h"
+
+/*
+ * AFL++ runtime for QNX harnesses, which ntox86_64-gcc builds without
+ * afl-cc: the fork server, persistent mode and the coverage map, as
+ * afl-compiler-rt provides them. The fork server starts on the first
+ * __afl_persistent_loop or __afl_manual_init call, so everything the
+ * harness did before it (libc start, relocation, codec loading) is done
+ * once, in the server. Without afl-fuzz on the other end the loop body
+ * runs once and these calls do nothing else.
+ *
+ * The old fork server protocol is used: a hello, then per run a
+ * request, the child's pid and its wait status. afl-fuzz still speaks
+ * it. A harness that calls __afl_fuzz_init first offers shared memory
+ * test cases in the hello; once afl-fuzz accepts, it writes each input
+ * into that segment (a length word, then the bytes) instead of a file.
+ * The harness itself has to carry the signature strings afl-fuzz looks
+ * for in the binary, see img-test/afl.h.
+ *
+ * An unmodified binary can get a deferred fork server from
+ * LD_QNX_AFL_FORKSRV instead: "init" starts it once _init_libc has run
+ * the constructors, just before main; a number n, after the n-th
+ * dlopen; anything else, after the dlopen of a name containing it.
+ * Children then fork from a process that has already relocated and
+ * loaded everything up to that point.
+ *
+ * Prebuilt libraries can still give coverage with LD_QNX_AFL_PT, see
+ * aflpt.c. Each new child then waits on a pipe until the server has
+ * started tracing it, so the server must start after those libraries
+ * are loaded.
+ */
+
+#define FORKSRV_FD 198
+#define MAP_SIZE (1 << 16)
+
+#define FS_OPT_ENABLED 0x80000001
+#define FS_OPT_SHDMEM_FUZZ 0x01000000
+
+static unsigned char dummy[MAP_SIZE];
+static unsigned char *area = dummy;
+static unsigned prev_loc;
+static int started, persistent, shm_fuzz;
+static uint32_t *fuzz_len;
+static unsigned char *fuzz_ptr;
+
+static void map_shm(void)
+{
+	char *id = getenv("__AFL_SHM_ID");
+	void *p;
+
+	if (id && (p = shmat(atoi(id), 0, 0)) != (void *)-1)
+		area = p;
+}
+
+static void map_shm_fuzz(void)
+{
+	char *id = getenv("__AFL_SHM_FUZZ_ID");
+	void *p;
+
+	if (id && (p = shmat(atoi(id), 0, 0)) != (void *)-1) {
+		fuzz_len = p;
+		fuzz_ptr = (unsigned char *)p + sizeof *fuzz_len;
+	}
+}
+
+/* Returns in each child; the server itself never returns. */
+static void fork_server(void)
+{
+	uint32_t hello = shm_fuzz ? FS_OPT_ENABLED | FS_OPT_SHDMEM_FUZZ : 0;
+	int status, killed, stopped = 0, pt, gate[2];
+	pid_t child = 0;
+	char c = 0;
+
+	if (write(FORKSRV_FD + 1, &hello, 4) != 4)
+		return;
+	if (hello) {
+		if (read(FORKSRV_FD, &hello, 4) != 4)
+			_exit(1);
+		if ((hello & FS_OPT_ENABLED) == FS_OPT_ENABLED &&
+		    (hello & FS_OPT_SHDMEM_FUZZ))
+			map_shm_fuzz();
+	}
+	pt = !__qnx_afl_pt_init(area, MAP_SIZE) && !pipe2(gate, O_CLOEXEC);
+	for (;;) {
+		if (read(FORKSRV_FD, &killed, 4) != 4)
+			_exit(1);
+		/* A stopped child afl-fuzz timed out and killed is reaped. */
+		if (stopped && killed) {
+			stopped = 0;
+			if (waitpid(child, &status, 0) < 0)
+				_exit(1);
+		}
+		if (!stopped) {
+			if ((child = fork()) < 0)
+				_exit(1);
+			if (!child) {
+				close(FORKSRV_FD);
+				close(FORKSRV_FD + 1);
+				if (pt) {
+					while (read(gate[0], &c, 1) < 0 &&
+					       errno == EINTR);
+					close(gate[0]);
+					close(gate[1]);
+				}
+				return;
+			}
+			if (pt) {
+				__qnx_afl_pt_attach(child);
+				write(gate[1], &c, 1);
+			}
+		} else {
+			kill(child, SIGCONT);
+			stopped = 0;
+		}
+		if (write(FORKSRV_FD + 1, &child, 4) != 4 ||
+		    waitpid(child, &status, persistent ? WUNTRACED : 0) < 0)
+			_exit(1);
+		stopped = WIFSTOPPED(status);
+		if (pt) {
+			__qnx_afl_pt_collect();
+			if (!stopped)
+				__qnx_afl_pt_detach();
+		}
+		if (write(FORKSRV_FD + 1, &status, 4) != 4)
+			_exit(1);
+	}
+}
+
+void __afl_fuzz_init(void)
+{
+	shm_fuzz = 1;
+}
+
+/* The current input, or 0 when afl-fuzz is not delivering them here. */
+unsigned char *__afl_fuzz_buf(void)
+{
+	return fuzz_ptr;
+}
+
+unsigned __afl_fuzz_size(void)
+{
+	return fuzz_len ? *fuzz_len : 0;
+}
+
+void __afl_manual_init(void)
+{
+	if (started)
+		return;
+	started = 1;
+	persistent = !!getenv("__AFL_PERSISTENT");
+	map_shm();
+	fork_server();
+}
+
+const char *__qnx_afl_forksrv;
+
+void __qnx_afl_point(const char *name)
+{
+	static unsigned long opened;
+	const char *spec = __qnx_afl_forksrv;
+	unsigned long n;
+	char *end;
+
+	if (started)
+		return;
+	if (!name) {
+		if (!strcmp(spec, "init"))
+			__afl_manual_init();
+		return;
+	}
+	n = strtoul(spec, &end, 10);
+	if (end != spec && !*end ? ++opened == n : !!strstr(name, spec))
+		__afl_manual_init();
+}
+
+/*
+ * As afl-compiler-rt: true max_cnt times in a persistent child,
+ * stopping itself between runs so the server can resume it for the
+ * next input; true once otherwise. With QNX_AFL_SNAPSHOT each run
+ * also starts from the state the first one started from, see aflsnap.c;
+ * with QNX_AFL_ARENA each run starts with an empty heap, see aflarena.c.
+ */
+int __afl_persistent_loop(unsigned max_cnt)
+{
+	static int first = 1, snap, arena;
+	static unsigned left;
+
+	if (first) {
+		__afl_manual_init();
+		if (persistent) {
+			memset(area, 0, MAP_SIZE);
+			area[0] = 1;
+			prev_loc = 0;
+		}
+		left = max_cnt;
+		first = 0;
+		/* Set before the snapshot so that it is set in it. */
+		snap = persistent;
+		if (snap && __qnx_afl_snap_take())
+			snap = 0;
+		arena = persistent && !snap && !__qnx_afl_arena_start();
+		return 1;
+	}
+	if (persistent && --left) {
+		if (snap)
+			__qnx_afl_snap_restore(&left, sizeof left);
+		else if (arena)
+			__qnx_afl_arena_reset();
+		raise(SIGSTOP);
+		area[0] = 1;
+		prev_loc = 0;
+		return 1;
+	}
+	/* Whatever runs after the loop stays out of the map. */
+	area = dummy;
+	return 0;
+}
+
+/* Edges for code built with -fsanitize-coverage=trace-pc (GCC 6+). */
+void __sanitizer_cov_trace_pc(void)
+{
+	uintptr_t pc = (uintptr_t)__builtin_return_address(0);
+	unsigned cur = (pc >> 4 ^ pc << 8) & (MAP_SIZE - 1);
+
+	area[cur ^ prev_loc]++;
+	prev_loc = cur >> 1;
+}
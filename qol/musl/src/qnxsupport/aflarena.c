@@ -0,0 +1,197 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/auxv.h>
+#include <sys/mman.h>
+#include "lock.h"
+#include "qnx_afl.h"
+#include "qnx_heap.h"
+
+/*
+ * Arena heap for persistent loops (QNX_AFL_ARENA=<MiB>, 1024 if not a
+ * number): from the first iteration on, malloc carves every block out
+ * of one bump arena and free only checks the block. Each further
+ * iteration starts by moving the bump pointer back to the start and
+ * dropping the pages the last one touched (MADV_DONTNEED), so what a
+ * codec leaks for one input is gone for the next and freeing costs
+ * nothing.
+ *
+ * A block has a header with its size and a canary in front and at
+ * least RED_ZONE bytes of RED_BYTE behind. free and realloc check both
+ * and kill the process on a mismatch: an overflow past the end, a free
+ * of something that is not a block, a double free, or a free of a block
+ * from an earlier iteration.
+ *
+ * Blocks allocated before the loop, and those allocated once the arena
+ * is full, come from the normal allocator and are handed back to it.
+ * A block allocated during an iteration must not be used after it ends.
+ * QNX_AFL_SNAPSHOT restores the whole heap anyway and takes precedence.
+ */
+
+#define ALIGN 16
+#define RED_ZONE 16
+#define RED_BYTE 0xa5
+#define LIVE 0x6c697665
+#define FREED 0x66726565
+
+struct block {
+	size_t size;
+	uint32_t canary, state;
+};
+
+static unsigned char *base, *cur, *end, *high;
+static volatile int lock[1];
+static uint32_t secret;
+
+static void die(const char *what, void *p)
+{
+	__qnx_heap_die("qnxarena", what, p);
+}
+
+static int owned(void *p)
+{
+	return (unsigned char *)p > base && (unsigned char *)p < end;
+}
+
+static uint32_t canary(void *p)
+{
+	return secret ^ (uint32_t)((uintptr_t)p >> 4);
+}
+
+static size_t span(size_t n)
+{
+	return (n + RED_ZONE + ALIGN - 1) & -ALIGN;
+}
+
+static struct block *check(void *p)
+{
+	struct block *b = (struct block *)p - 1;
+	unsigned char *r;
+	size_t n;
+
+	if ((uintptr_t)p & (ALIGN - 1) || b->canary != canary(p))
+		die("free of a bad pointer", p);
+	if (b->state != LIVE)
+		die(b->state == FREED ? "double free of" : "free of a bad pointer", p);
+	r = (unsigned char *)p + b->size;
+	for (n = span(b->size) - b->size; n--; r++)
+		if (*r != RED_BYTE)
+			die("overflow past the end of", p);
+	return b;
+}
+
+static void *arena_alloc(size_t align, size_t n)
+{
+	unsigned char *p;
+	struct block *b;
+
+	LOCK(lock);
+	p = (unsigned char *)(((uintptr_t)cur + sizeof *b + align - 1) & -align);
+	if (p >= end || n > (size_t)(end - p) || span(n) > (size_t)(end - p)) {
+		UNLOCK(lock);
+		return 0;
+	}
+	cur = p + span(n);
+	if (cur > high)
+		high = cur;
+	UNLOCK(lock);
+
+	b = (struct block *)p - 1;
+	b->size = n;
+	b->canary = canary(p);
+	b->state = LIVE;
+	memset(p + n, RED_BYTE, span(n) - n);
+	return p;
+}
+
+static void *arena_malloc(size_t n)
+{
+	void *p = arena_alloc(ALIGN, n);
+
+	return p ? p : __libc_malloc_impl(n);
+}
+
+static void arena_free(void *p)
+{
+	if (!owned(p)) {
+		__libc_free(p);
+		return;
+	}
+	check(p)->state = FREED;
+}
+
+static void *arena_realloc(void *p, size_t n)
+{
+	struct block *b;
+	void *q;
+
+	if (!p)
+		return arena_malloc(n);
+	if (!owned(p))
+		return __libc_realloc(p, n);
+	b = check(p);
+	if (n <= b->size) {
+		b->size = n;
+		memset((unsigned char *)p + n, RED_BYTE, span(n) - n);
+		return p;
+	}
+	if (!(q = arena_malloc(n)))
+		return 0;
+	memcpy(q, p, b->size);
+	b->state = FREED;
+	return q;
+}
+
+static void *arena_aligned_alloc(size_t align, size_t n)
+{
+	void *p;
+
+	if ((align & -align) != align || align > 4096)
+		return __libc_aligned_alloc(align, n);
+	p = arena_alloc(align < ALIGN ? ALIGN : align, n);
+	return p ? p : __libc_aligned_alloc(align, n);
+}
+
+static size_t arena_usable_size(void *p)
+{
+	if (!owned(p))
+		return __libc_malloc_usable_size(p);
+	return check(p)->size;
+}
+
+static const struct qnx_heap arena = {
+	arena_malloc, arena_free, arena_realloc, arena_aligned_alloc,
+	arena_usable_size,
+};
+
+int __qnx_afl_arena_start(void)
+{
+	const char *env = getenv("QNX_AFL_ARENA");
+	const unsigned char *rand;
+	char *e;
+	size_t mb;
+
+	if (!env || __qnx_heap)
+		return -1;
+	mb = strtoul(env, &e, 10);
+	if (!mb || *e)
+		mb = 1024;
+	base = mmap(0, mb << 20, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (base == MAP_FAILED)
+		return base = 0, -1;
+	cur = high = base;
+	end = base + (mb << 20);
+	secret = (uintptr_t)base * 1103515245 >> 16;
+	if ((rand = (void *)getauxval(AT_RANDOM)))
+		memcpy(&secret, rand + 12, sizeof secret);
+	__qnx_heap = &arena;
+	return 0;
+}
+
+void __qnx_afl_arena_reset(void)
+{
+	madvise(base, high - base, MADV_DONTNEED);
+	cur = high = base;
+}
@@ -0,0 +1,154 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/shm.h>
+#include "qnx_redirect.h"
+
+/*
+ * CmpLog for QNX code that cannot be rebuilt: in the process afl-fuzz
+ * starts with __AFL_CMPLOG_SHM_ID (afl-fuzz -c 0), the loader binds
+ * memcmp, bcmp, strcmp, strncmp, strcasecmp and strncasecmp calls from
+ * every library to these versions, which log both operands into the
+ * CmpLog map before comparing, as afl-compiler-rt's routine hooks do.
+ * Each call site, by return address, has its own map entry. Other
+ * processes bind the plain functions, see QNX_REDIRECT_CMPLOG.
+ */
+
+/* The parts of AFL++'s include/cmplog.h used here. */
+#define CMP_MAP_W 65536
+#define CMP_MAP_H 32
+#define CMP_MAP_RTN_H (CMP_MAP_H / 2)
+#define CMP_TYPE_RTN 1
+
+struct cmp_header {
+	unsigned hits : 6;
+	unsigned shape : 5;
+	unsigned type : 1;
+	unsigned attribute : 4;
+} __attribute__((packed));
+
+struct cmpfn_operands {
+	uint8_t v0[32], v1[32];
+	uint8_t v0_len, v1_len;
+	uint8_t unused[6];
+} __attribute__((packed));
+
+struct cmp_map {
+	struct cmp_header headers[CMP_MAP_W];
+	struct cmpfn_operands log[CMP_MAP_W][CMP_MAP_H];
+};
+
+/* Operands longer than this are logged truncated. */
+#define MAX_OPERAND 31
+/* v*_len flag for operands logged as strings (with their NUL). */
+#define STR_LEN 0x80
+
+static struct cmp_map *map;
+
+static struct cmp_map *get_map(void)
+{
+	static int tried;
+	char *id;
+	void *p;
+
+	if (!tried) {
+		tried = 1;
+		if ((id = getenv("__AFL_CMPLOG_SHM_ID")) &&
+		    (p = shmat(atoi(id), 0, 0)) != (void *)-1)
+			map = p;
+	}
+	return map;
+}
+
+static void log_rtn(uintptr_t site, const void *a, size_t la, const void *b,
+		    size_t lb, int str)
+{
+	struct cmp_map *m = get_map();
+	struct cmpfn_operands *op;
+	size_t k, l = la > lb ? la : lb;
+	unsigned hits;
+
+	if (!m || l < 2)
+		return;
+	k = (site >> 4 ^ site << 8 ^ site >> 20) & (CMP_MAP_W - 1);
+	if (m->headers[k].type != CMP_TYPE_RTN) {
+		m->headers[k].type = CMP_TYPE_RTN;
+		m->headers[k].hits = 1;
+		m->headers[k].shape = l - 1;
+		hits = 0;
+	} else {
+		hits = m->headers[k].hits++;
+		if (m->headers[k].shape < l - 1)
+			m->headers[k].shape = l - 1;
+	}
+	op = &m->log[k][hits & (CMP_MAP_RTN_H - 1)];
+	op->v0_len = (str ? STR_LEN : 0) + la;
+	op->v1_len = (str ? STR_LEN : 0) + lb;
+	memcpy(op->v0, a, la);
+	memcpy(op->v1, b, lb);
+}
+
+#define SITE ((uintptr_t)__builtin_return_address(0))
+
+static size_t min_len(size_t n)
+{
+	return n < MAX_OPERAND ? n : MAX_OPERAND;
+}
+
+int _qnx_cmplog_memcmp(const void *a, const void *b, size_t n)
+{
+	log_rtn(SITE, a, min_len(n), b, min_len(n), 0);
+	return memcmp(a, b, n);
+}
+QNX_REDIRECT_CMPLOG(memcmp);
+
+int _qnx_cmplog_bcmp(const void *a, const void *b, size_t n)
+{
+	log_rtn(SITE, a, min_len(n), b, min_len(n), 0);
+	return memcmp(a, b, n);
+}
+QNX_REDIRECT_CMPLOG(bcmp);
+
+/* A string operand: up to and with its NUL, or its first n bytes. */
+static size_t str_len(const char *s, size_t n)
+{
+	size_t l = strnlen(s, min_len(n));
+
+	return l < min_len(n) ? l + 1 : l;
+}
+
+static void log_str(uintptr_t site, const char *a, const char *b, size_t n)
+{
+	if (get_map() && a && b)
+		log_rtn(site, a, str_len(a, n), b, str_len(b, n), 1);
+}
+
+int _qnx_cmplog_strcmp(const char *a, const char *b)
+{
+	log_str(SITE, a, b, SIZE_MAX);
+	return strcmp(a, b);
+}
+QNX_REDIRECT_CMPLOG(strcmp);
+
+int _qnx_cmplog_strncmp(const char *a, const char *b, size_t n)
+{
+	log_str(SITE, a, b, n);
+	return strncmp(a, b, n);
+}
+QNX_REDIRECT_CMPLOG(strncmp);
+
+int _qnx_cmplog_strcasecmp(const char *a, const char *b)
+{
+	log_str(SITE, a, b, SIZE_MAX);
+	return strcasecmp(a, b);
+}
+QNX_REDIRECT_CMPLOG(strcasecmp);
+
+int _qnx_cmplog_strncasecmp(const char *a, const char *b, size_t n)
+{
+	log_str(SITE, a, b, n);
+	return strncasecmp(a, b, n);
+}
+QNX_REDIRECT_CMPLOG(strncasecmp);
@@ -0,0 +1,464 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <link.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include "syscall.h"
+#include "qnx_afl.h"
+
+/*
+ * Intel PT coverage for fork server children (LD_QNX_AFL_PT=<names>),
+ * for QNX libraries that come prebuilt and so have no instrumentation.
+ * The server traces each child with a per-task intel_pt event, limited
+ * to the executable segments of the loaded objects whose names contain
+ * one of the comma separated <names>: with a hardware address filter
+ * when there are few enough of them, and always by checking every
+ * decoded address, so libc and the harness stay out of the map. The
+ * trace is only parsed into packets, not followed through the code:
+ * each TIP target, mixed with the TNT bits seen since the last one, is
+ * an edge in the AFL map. A thread drains the AUX buffer as it fills;
+ * the server takes the rest once the child has stopped or exited.
+ */
+
+#define AUX_SIZE (1UL << 20)
+#define MAX_RANGES 32
+#define PT_SYSFS "/sys/bus/event_source/devices/intel_pt/"
+
+/* The parts of linux/perf_event.h used here. */
+struct pt_attr {
+	uint32_t type, size;
+	uint64_t config, sample_period, sample_type, read_format;
+	uint64_t flags;
+	uint32_t wakeup_events, bp_type;
+	uint64_t config1, config2, branch_sample_type, sample_regs_user;
+	uint32_t sample_stack_user;
+	int32_t clockid;
+	uint64_t sample_regs_intr;
+	uint32_t aux_watermark;
+	uint16_t sample_max_stack, reserved;
+};
+
+#define ATTR_DISABLED (1 << 0)
+#define ATTR_EXCLUDE_KERNEL (1 << 5)
+#define ATTR_EXCLUDE_HV (1 << 6)
+
+struct pt_page {
+	char header[1024];
+	volatile uint64_t data_head, data_tail, data_offset, data_size;
+	volatile uint64_t aux_head, aux_tail, aux_offset, aux_size;
+};
+
+#define PERF_EVENT_IOC_ENABLE 0x2400
+#define PERF_EVENT_IOC_SET_FILTER 0x40082406
+#define PERF_FLAG_FD_CLOEXEC 8
+
+struct range {
+	uintptr_t start, end;
+	size_t off;
+	const char *path;
+};
+
+struct decoder {
+	uint64_t last_ip;
+	uint32_t path;
+	unsigned prev;
+	int in, synced;
+};
+
+static struct range ranges[MAX_RANGES];
+static int nranges, nfilters, pmu_type = -1;
+static unsigned char *map;
+static unsigned map_mask;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static int fd = -1, wake = -1;
+static struct pt_page *pg;
+static unsigned char *aux;
+static unsigned char scratch[AUX_SIZE];
+static struct decoder dec;
+
+static int read_int(const char *path)
+{
+	char buf[32];
+	int f, n;
+
+	if ((f = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+		return -1;
+	n = read(f, buf, sizeof buf - 1);
+	close(f);
+	if (n <= 0)
+		return -1;
+	buf[n] = 0;
+	return atoi(buf);
+}
+
+static int wanted(const char *name, const char *names)
+{
+	size_t len;
+
+	while (*names) {
+		len = strcspn(names, ",");
+		if (len && memmem(name, strlen(name), names, len))
+			return 1;
+		names += len + !!names[len];
+	}
+	return 0;
+}
+
+static int add_ranges(struct dl_phdr_info *info, size_t size, void *names)
+{
+	int i;
+
+	(void)size;
+	if (!info->dlpi_name || !*info->dlpi_name ||
+	    !wanted(info->dlpi_name, names))
+		return 0;
+	for (i = 0; i < info->dlpi_phnum && nranges < MAX_RANGES; i++) {
+		const ElfW(Phdr) *ph = &info->dlpi_phdr[i];
+		if (ph->p_type != PT_LOAD || !(ph->p_flags & PF_X))
+			continue;
+		ranges[nranges++] = (struct range){
+			info->dlpi_addr + ph->p_vaddr,
+			info->dlpi_addr + ph->p_vaddr + ph->p_memsz,
+			ph->p_offset, info->dlpi_name
+		};
+	}
+	return 0;
+}
+
+static int in_range(uint64_t ip)
+{
+	int i;
+
+	for (i = 0; i < nranges; i++)
+		if (ip >= ranges[i].start && ip < ranges[i].end)
+			return 1;
+	return 0;
+}
+
+static void edge(struct decoder *d, uint64_t ip)
+{
+	unsigned cur;
+
+	if (!(d->in = in_range(ip)))
+		return;
+	cur = (uint32_t)((ip ^ d->path) * 0x9e3779b97f4a7c15ULL >> 32) &
+	      map_mask;
+	map[cur ^ d->prev]++;
+	d->prev = cur >> 1;
+	d->path = 0;
+}
+
+static void tnt(struct decoder *d, const unsigned char *p, int n)
+{
+	if (d->in)
+		while (n--)
+			d->path = d->path * 33 ^ *p++;
+}
+
+static const unsigned char ip_bytes[8] = { 0, 2, 4, 6, 6, 0xff, 8, 0xff };
+
+/* TIP, TIP.PGE, TIP.PGD and FUP: an opcode, then a compressed IP. */
+static long ip_packet(struct decoder *d, const unsigned char *p, size_t n)
+{
+	int kind = p[0] & 0x1f, mode = p[0] >> 5, len = ip_bytes[mode], i;
+	uint64_t v = 0;
+
+	if (len == 0xff)
+		return -1;
+	if (n < 1 + (size_t)len)
+		return 0;
+	for (i = len; i; i--)
+		v = v << 8 | p[i];
+	switch (mode) {
+	case 0:
+		if (kind == 0x01)
+			d->in = 0;
+		return 1;
+	case 1:
+		d->last_ip = (d->last_ip & ~0xffffULL) | v;
+		break;
+	case 2:
+		d->last_ip = (d->last_ip & ~0xffffffffULL) | v;
+		break;
+	case 3:
+		d->last_ip = (uint64_t)((int64_t)(v << 16) >> 16);
+		break;
+	case 4:
+		d->last_ip = (d->last_ip & ~0xffffffffffffULL) | v;
+		break;
+	case 6:
+		d->last_ip = v;
+		break;
+	}
+	if (kind == 0x0d || kind == 0x11)
+		edge(d, d->last_ip);
+	else if (kind == 0x01)
+		d->in = 0;
+	else
+		d->in = in_range(d->last_ip);
+	return 1 + len;
+}
+
+/* Length of the packet at p, 0 if it runs past n, -1 if unknown. */
+static long packet(struct decoder *d, const unsigned char *p, size_t n)
+{
+	unsigned char b = p[0];
+	size_t i;
+
+	if (b == 0x00)
+		return 1;
+	if (b == 0x02) {
+		long len;
+		if (n < 2)
+			return 0;
+		switch (p[1]) {
+		case 0x23: case 0xf3: case 0x83: case 0x62: case 0xe2:
+			len = 2;
+			if (p[1] == 0xf3)
+				d->in = 0;
+			break;
+		case 0x03: case 0x22:
+			len = 4;
+			break;
+		case 0x73: case 0xc8: case 0xa2:
+			len = 7;
+			break;
+		case 0x43:
+			len = 8;
+			break;
+		case 0xa3:
+			if (n < 8)
+				return 0;
+			tnt(d, p + 2, 6);
+			return 8;
+		case 0xc2:
+			len = 10;
+			break;
+		case 0xc3:
+			len = 11;
+			break;
+		case 0x82:
+			d->last_ip = 0;
+			len = 16;
+			break;
+		default:
+			if ((p[1] & 0x1f) != 0x12)
+				return -1;
+			len = 2 + (p[1] & 0x20 ? 8 : 4);
+		}
+		return n < (size_t)len ? 0 : len;
+	}
+	if ((b & 3) == 3) {
+		/* CYC: continued while bit 0 of the next byte is set. */
+		if (!(b & 4))
+			return 1;
+		for (i = 1; i < n; i++)
+			if (!(p[i] & 1))
+				return i + 1;
+		return 0;
+	}
+	if (b == 0x19)
+		return n < 8 ? 0 : 8;
+	if (b == 0x59 || b == 0x99)
+		return n < 2 ? 0 : 2;
+	switch (b & 0x1f) {
+	case 0x01: case 0x0d: case 0x11: case 0x1d:
+		return ip_packet(d, p, n);
+	}
+	if (!(b & 1)) {
+		tnt(d, p, 1);
+		return 1;
+	}
+	return -1;
+}
+
+static const unsigned char psb[16] = {
+	0x02, 0x82, 0x02, 0x82, 0x02, 0x82, 0x02, 0x82,
+	0x02, 0x82, 0x02, 0x82, 0x02, 0x82, 0x02, 0x82,
+};
+
+/* Returns how much was used; the rest is an incomplete packet. */
+static size_t decode(struct decoder *d, const unsigned char *p, size_t n)
+{
+	size_t i = 0;
+	long len;
+
+	while (i < n) {
+		if (!d->synced) {
+			for (; i + sizeof psb <= n; i++)
+				if (!memcmp(p + i, psb, sizeof psb))
+					break;
+			if (i + sizeof psb > n)
+				return i;
+			d->synced = 1;
+		}
+		if (!(len = packet(d, p + i, n - i)))
+			return i;
+		if (len < 0) {
+			d->synced = 0;
+			i++;
+			continue;
+		}
+		i += len;
+	}
+	return i;
+}
+
+/* Called with mutex held. */
+static void drain(void)
+{
+	uint64_t head = __atomic_load_n(&pg->aux_head, __ATOMIC_ACQUIRE);
+	uint64_t tail = pg->aux_tail;
+	size_t n = head - tail, off = tail % AUX_SIZE;
+	const unsigned char *p = aux + off;
+
+	if (!n)
+		return;
+	if (off + n > AUX_SIZE) {
+		memcpy(scratch, aux + off, AUX_SIZE - off);
+		memcpy(scratch + AUX_SIZE - off, aux, n - (AUX_SIZE - off));
+		p = scratch;
+	}
+	__atomic_store_n(&pg->aux_tail, tail + decode(&dec, p, n),
+			 __ATOMIC_RELEASE);
+}
+
+static void *drainer(void *arg)
+{
+	struct pollfd p[2] = { { wake, POLLIN }, { -1, POLLIN } };
+	uint64_t v;
+
+	(void)arg;
+	for (;;) {
+		pthread_mutex_lock(&mutex);
+		p[1].fd = fd;
+		pthread_mutex_unlock(&mutex);
+		if (poll(p, p[1].fd >= 0 ? 2 : 1, -1) < 0)
+			continue;
+		if (p[0].revents)
+			read(wake, &v, sizeof v);
+		pthread_mutex_lock(&mutex);
+		if (fd >= 0 && fd == p[1].fd && (p[1].revents & POLLIN))
+			drain();
+		pthread_mutex_unlock(&mutex);
+		/* An exited child's fd hangs up until it is detached. */
+		if (p[1].revents & POLLHUP)
+			sched_yield();
+	}
+	return 0;
+}
+
+int __qnx_afl_pt_init(unsigned char *area, unsigned size)
+{
+	const char *names = getenv("LD_QNX_AFL_PT");
+	pthread_t t;
+
+	if (!names || !*names || (pmu_type = read_int(PT_SYSFS "type")) < 0)
+		return -1;
+	dl_iterate_phdr(add_ranges, (void *)names);
+	if (!nranges)
+		return -1;
+	nfilters = read_int(PT_SYSFS "nr_addr_filters");
+	map = area;
+	map_mask = size - 1;
+	if ((wake = eventfd(0, EFD_CLOEXEC)) < 0)
+		return -1;
+	if (pthread_create(&t, 0, drainer, 0)) {
+		close(wake);
+		return -1;
+	}
+	pthread_detach(t);
+	return 0;
+}
+
+static void set_filter(int f)
+{
+	char buf[MAX_RANGES * 64], *s = buf;
+	int i;
+
+	if (nranges > nfilters)
+		return;
+	for (i = 0; i < nranges; i++)
+		s += snprintf(s, buf + sizeof buf - s, "%sfilter 0x%zx/0x%zx@%s",
+			      i ? " " : "", ranges[i].off,
+			      (size_t)(ranges[i].end - ranges[i].start),
+			      ranges[i].path);
+	ioctl(f, PERF_EVENT_IOC_SET_FILTER, buf);
+}
+
+/* Before the child runs; returns 0 or -errno, and traces nothing then. */
+int __qnx_afl_pt_attach(int pid)
+{
+	struct pt_attr a = {
+		.type = pmu_type, .size = sizeof a,
+		.flags = ATTR_DISABLED | ATTR_EXCLUDE_KERNEL | ATTR_EXCLUDE_HV,
+		.aux_watermark = AUX_SIZE / 4,
+	};
+	long page = sysconf(_SC_PAGESIZE);
+	struct pt_page *p;
+	void *b;
+	int f;
+
+	if ((f = __syscall(SYS_perf_event_open, &a, pid, -1, -1,
+			   PERF_FLAG_FD_CLOEXEC)) < 0)
+		return f;
+	if ((p = mmap(0, page, PROT_READ | PROT_WRITE, MAP_SHARED, f, 0)) ==
+	    MAP_FAILED) {
+		close(f);
+		return -errno;
+	}
+	p->aux_offset = page;
+	p->aux_size = AUX_SIZE;
+	if ((b = mmap(0, AUX_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, f,
+		      page)) == MAP_FAILED) {
+		munmap(p, page);
+		close(f);
+		return -errno;
+	}
+	set_filter(f);
+	ioctl(f, PERF_EVENT_IOC_ENABLE, 0);
+
+	pthread_mutex_lock(&mutex);
+	fd = f;
+	pg = p;
+	aux = b;
+	memset(&dec, 0, sizeof dec);
+	pthread_mutex_unlock(&mutex);
+	eventfd_write(wake, 1);
+	return 0;
+}
+
+/* The child has stopped or exited: everything it traced goes in. */
+void __qnx_afl_pt_collect(void)
+{
+	pthread_mutex_lock(&mutex);
+	if (fd >= 0) {
+		drain();
+		dec.prev = 0;
+		dec.path = 0;
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+void __qnx_afl_pt_detach(void)
+{
+	pthread_mutex_lock(&mutex);
+	if (fd >= 0) {
+		munmap(aux, AUX_SIZE);
+		munmap(pg, sysconf(_SC_PAGESIZE));
+		close(fd);
+		fd = -1;
+	}
+	pthread_mutex_unlock(&mutex);
+	eventfd_write(wake, 1);
+}
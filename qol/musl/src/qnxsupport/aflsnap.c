@@ -0,0 +1,336 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "syscall.h"
+#include "qnx_afl.h"
+
+/*
+ * Snapshot mode for persistent loops (QNX_AFL_SNAPSHOT): the state of
+ * the process when the first iteration starts is put back before each
+ * later one, so caches and leaks from one input (libimg's codec lists,
+ * the heap) do not reach the next, without a fork per input.
+ *
+ * The snapshot is a copy of every private writable mapping except the
+ * current stack, the brk, the open descriptors and their offsets, and
+ * the list of mappings. Restoring closes descriptors opened since,
+ * unmaps mappings created since, and copies back the pages that are
+ * soft-dirty (written since /proc/self/clear_refs was last cleared) or
+ * no longer present (MADV_FREE). The mallocng heap is ordinary memory
+ * and the brk, so it comes back with them. Without soft-dirty support
+ * in the kernel every page is copied back.
+ *
+ * Not restored: other threads (the iteration must not start or depend
+ * on any), descriptors closed during an iteration, signal handlers, the
+ * working directory, and anything outside the process.
+ */
+
+#define MAX_MAPS 8192
+#define MAX_FDS 1024
+#define MAPS_BUF (1 << 18)
+#define PM_CHUNK 512
+
+struct keep {
+	uintptr_t start, end;
+	size_t off, cov;
+	int save;
+};
+
+struct snap {
+	struct keep keep[MAX_MAPS];
+	int nkeep;
+	uintptr_t brk;
+	int pm, cr, sd;
+	unsigned long fds[MAX_FDS / (8 * sizeof(long))];
+	off_t pos[MAX_FDS];
+	uint64_t pagemap[PM_CHUNK];
+	char maps[MAPS_BUF];
+	char dents[4096];
+};
+
+/* Neither of these is restored, and both stay the same once set. */
+static struct snap *s;
+static unsigned char *data;
+static size_t data_len;
+
+static size_t read_maps(void)
+{
+	size_t n = 0;
+	ssize_t r;
+	int f;
+
+	if ((f = open("/proc/self/maps", O_RDONLY | O_CLOEXEC)) < 0)
+		return 0;
+	while (n < MAPS_BUF - 1 &&
+	       (r = read(f, s->maps + n, MAPS_BUF - 1 - n)) > 0)
+		n += r;
+	close(f);
+	s->maps[n] = 0;
+	return n;
+}
+
+/* Next line of s->maps: its range, and whether it may be saved. */
+static char *next_map(char *p, uintptr_t *a, uintptr_t *b, int *save)
+{
+	char *end, *name;
+
+	if (!*p)
+		return 0;
+	end = p + strcspn(p, "\n");
+	*a = strtoul(p, &p, 16);
+	*b = strtoul(p + 1, &p, 16);
+	p++;
+	*save = p[1] == 'w' && p[3] == 'p';
+	name = memchr(p, '[', end - p);
+	if (name && (!strncmp(name, "[vvar", 5) || !strncmp(name, "[vdso", 5) ||
+		     !strncmp(name, "[vsyscall", 9)))
+		*save = 0;
+	return *end ? end + 1 : end;
+}
+
+static void add(uintptr_t a, uintptr_t b, int save)
+{
+	if (a < b && s->nkeep < MAX_MAPS)
+		s->keep[s->nkeep++] = (struct keep){ a, b, 0, 0, save };
+}
+
+/* Keep [a,b), saving it except where the snapshot itself lives. */
+static void carve(uintptr_t a, uintptr_t b, int save)
+{
+	size_t ps = sysconf(_SC_PAGESIZE);
+	uintptr_t ex[2][2] = {
+		{ (uintptr_t)s, (uintptr_t)s + (sizeof *s + ps - 1) / ps * ps },
+		{ (uintptr_t)data, (uintptr_t)data + data_len },
+	};
+	int i;
+
+	if (ex[1][0] < ex[0][0]) {
+		uintptr_t t0 = ex[0][0], t1 = ex[0][1];
+		ex[0][0] = ex[1][0];
+		ex[0][1] = ex[1][1];
+		ex[1][0] = t0;
+		ex[1][1] = t1;
+	}
+	for (i = 0; i < 2 && save; i++) {
+		uintptr_t lo, hi;
+		if (ex[i][1] <= a || ex[i][0] >= b)
+			continue;
+		lo = ex[i][0] > a ? ex[i][0] : a;
+		hi = ex[i][1] < b ? ex[i][1] : b;
+		add(a, lo, 1);
+		add(lo, hi, 0);
+		a = hi;
+	}
+	add(a, b, save);
+}
+
+static int scan_fds(void (*fn)(int, int), int arg)
+{
+	int d = open("/proc/self/fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	long n, i;
+
+	if (d < 0)
+		return -1;
+	while ((n = __syscall(SYS_getdents64, d, s->dents,
+			      sizeof s->dents)) > 0) {
+		for (i = 0; i < n;) {
+			char *e = s->dents + i;
+			unsigned short reclen;
+			int fd;
+			memcpy(&reclen, e + 16, sizeof reclen);
+			i += reclen;
+			if (e[19] < '0' || e[19] > '9')
+				continue;
+			if ((fd = atoi(e + 19)) != d)
+				fn(fd, arg);
+		}
+	}
+	close(d);
+	return 0;
+}
+
+static void save_fd(int fd, int unused)
+{
+	(void)unused;
+	if (fd >= MAX_FDS)
+		return;
+	s->fds[fd / (8 * sizeof(long))] |= 1UL << fd % (8 * sizeof(long));
+	s->pos[fd] = lseek(fd, 0, SEEK_CUR);
+}
+
+static void restore_fd(int fd, int unused)
+{
+	(void)unused;
+	if (fd >= MAX_FDS ||
+	    !(s->fds[fd / (8 * sizeof(long))] & 1UL << fd % (8 * sizeof(long))))
+		close(fd);
+	else if (s->pos[fd] >= 0)
+		lseek(fd, s->pos[fd], SEEK_SET);
+}
+
+static int clear_refs(void)
+{
+	return s->cr >= 0 && pwrite(s->cr, "4", 1, 0) == 1;
+}
+
+/* Kernels without CONFIG_MEM_SOFT_DIRTY still accept the clear. */
+static int soft_dirty(void)
+{
+	size_t ps = sysconf(_SC_PAGESIZE);
+	volatile uint64_t *probe = s->pagemap;
+
+	if (s->pm < 0 || !clear_refs())
+		return 0;
+	*probe = 0;
+	return pread(s->pm, s->pagemap, 8, (uintptr_t)probe / ps * 8) == 8 &&
+	       s->pagemap[0] >> 55 & 1 && clear_refs();
+}
+
+int __qnx_afl_snap_take(void)
+{
+	uintptr_t a, b, sp = (uintptr_t)&a;
+	size_t off = 0;
+	char *p;
+	int save, i;
+
+	if (!getenv("QNX_AFL_SNAPSHOT"))
+		return -1;
+	if ((s = mmap(0, sizeof *s, PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+		return s = 0, -1;
+	s->pm = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+	s->cr = open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+	s->brk = __syscall(SYS_brk, 0);
+	scan_fds(save_fd, 0);
+
+	if (!read_maps())
+		goto fail;
+	for (p = s->maps; (p = next_map(p, &a, &b, &save));)
+		if (save && !(sp >= a && sp < b))
+			data_len += b - a;
+	if ((data = mmap(0, data_len, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0)) ==
+	    MAP_FAILED)
+		goto fail;
+	/* Mapping the copy may have changed the list; read it again. */
+	read_maps();
+	for (p = s->maps; (p = next_map(p, &a, &b, &save));)
+		carve(a, b, save && !(sp >= a && sp < b));
+	for (i = 0; i < s->nkeep; i++) {
+		struct keep *k = &s->keep[i];
+		if (!k->save)
+			continue;
+		if (off + (k->end - k->start) > data_len) {
+			k->save = 0;
+			continue;
+		}
+		k->off = off;
+		memcpy(data + off, (void *)k->start, k->end - k->start);
+		off += k->end - k->start;
+	}
+	s->sd = soft_dirty();
+	return 0;
+fail:
+	if (s->pm >= 0)
+		close(s->pm);
+	if (s->cr >= 0)
+		close(s->cr);
+	munmap(s, sizeof *s);
+	s = 0;
+	return -1;
+}
+
+/* Unmap whatever part of [a,b) was not mapped at snapshot time. */
+static void trim(uintptr_t a, uintptr_t b, int *i)
+{
+	int j;
+
+	while (*i < s->nkeep && s->keep[*i].end <= a)
+		++*i;
+	for (j = *i; a < b;) {
+		struct keep *k = &s->keep[j];
+		uintptr_t e;
+		if (j < s->nkeep && k->start <= a) {
+			e = k->end < b ? k->end : b;
+			k->cov += e - a;
+			a = e;
+			if (k->end <= a)
+				j++;
+		} else {
+			e = j < s->nkeep && k->start < b ? k->start : b;
+			munmap((void *)a, e - a);
+			a = e;
+		}
+	}
+}
+
+static void copy_dirty(struct keep *k, size_t ps)
+{
+	uintptr_t a;
+	size_t n, i;
+
+	for (a = k->start; a < k->end; a += n * ps) {
+		n = (k->end - a) / ps;
+		if (n > PM_CHUNK)
+			n = PM_CHUNK;
+		if (pread(s->pm, s->pagemap, n * 8, a / ps * 8) != (ssize_t)(n * 8)) {
+			memcpy((void *)a, data + k->off + (a - k->start), n * ps);
+			continue;
+		}
+		for (i = 0; i < n; i++) {
+			uint64_t e = s->pagemap[i];
+			/* Soft-dirty, or neither present nor swapped. */
+			if (e >> 55 & 1 || !(e >> 62))
+				memcpy((void *)(a + i * ps),
+				       data + k->off + (a + i * ps - k->start), ps);
+		}
+	}
+}
+
+/* Put the snapshot back, except for the len bytes at keep. */
+void __qnx_afl_snap_restore(void *keep, size_t len)
+{
+	size_t ps = sysconf(_SC_PAGESIZE);
+	unsigned char saved[64];
+	uintptr_t a, b, sp = (uintptr_t)&a;
+	char *p;
+	int save, i = 0;
+
+	if (!s || len > sizeof saved)
+		return;
+	memcpy(saved, keep, len);
+	scan_fds(restore_fd, 0);
+	if ((uintptr_t)__syscall(SYS_brk, 0) != s->brk)
+		__syscall(SYS_brk, s->brk);
+
+	for (i = 0; i < s->nkeep; i++)
+		s->keep[i].cov = 0;
+	i = 0;
+	if (read_maps())
+		for (p = s->maps; (p = next_map(p, &a, &b, &save));)
+			/* The stack may have grown; leave all of it. */
+			if (!(sp >= a && sp < b))
+				trim(a, b, &i);
+	for (i = 0; i < s->nkeep; i++) {
+		struct keep *k = &s->keep[i];
+		if (!k->save)
+			continue;
+		if (k->cov != k->end - k->start) {
+			/* Unmapped since: map it again and copy all of it. */
+			mmap((void *)k->start, k->end - k->start,
+			     PROT_READ | PROT_WRITE,
+			     MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+			memcpy((void *)k->start, data + k->off, k->end - k->start);
+		} else if (s->sd) {
+			copy_dirty(k, ps);
+		} else {
+			memcpy((void *)k->start, data + k->off, k->end - k->start);
+		}
+	}
+	if (s->sd)
+		clear_refs();
+	memcpy(keep, saved, len);
+}
@@ -1,32 +1,41 @@
-#include <unistd.h>
-#include <string.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include "qnx_crash.h"
 
-char *utoa(unsigned n, char *s, int base);
+#define IOV(s, n) (struct iovec){ (void *)(s), (n) }
 
+/* One writev of the whole message, built on the stack, so that a
+ * failure in a signal handler or a thread racing another prints
+ * unbroken. */
 void __assert(const char *expr, const char *file, unsigned line,
 	      const char *func)
 {
-	int fd = fileno(stderr);
-	char lbuf[10];
+	char lbuf[3 * sizeof line + 3], *p = lbuf + sizeof lbuf;
+	struct iovec iov[7];
+	unsigned l = line;
+	int n = 0;
 
-	if (utoa(line, lbuf, 10) == NULL) {
-		lbuf[0] = '?';
-		lbuf[1] = '\0';
-	}
+	*--p = ' ';
+	do *--p = '0' + l % 10;
+	while (l /= 10);
+	*--p = ':';
 
 	if (func) {
-		write(fd, "In function ", 12);
-		write(fd, func, strlen(func));
-		write(fd, " -- ", 4);
+		iov[n++] = IOV("In function ", 12);
+		iov[n++] = IOV(func, strlen(func));
+		iov[n++] = IOV(" -- ", 4);
 	}
+	iov[n++] = IOV(file, strlen(file));
+	iov[n++] = IOV(p, lbuf + sizeof lbuf - p);
+	iov[n++] = IOV(expr, strlen(expr));
+	iov[n++] = IOV(" -- assertion failed\n", 21);
+	writev(fileno(stderr), iov, n);
 
-	write(fd, file, strlen(file));
-	write(fd, ":", 1);
-	write(fd, lbuf, strlen(lbuf));
-	write(fd, " ", 1);
-	write(fd, expr, strlen(expr));
-	write(fd, " -- assertion failed\n", 21);
+	__qnx_crash_assert(expr, file, line, func,
+			   (uintptr_t)__builtin_return_address(0),
+			   (uintptr_t)iov);
 	abort();
 }
@@ -0,0 +1,261 @@
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include "pthread_impl.h"
+#include "qnx_crash.h"
+#include "qnx_heap.h"
+
+/*
+ * Crash traces for triage (QNX_CRASH_TRACE=<fd>): on SIGSEGV, SIGBUS,
+ * SIGILL, SIGFPE or SIGABRT, write the faulting frame and its callers to
+ * <fd>, then let the signal kill the process as it would have.
+ *
+ *   qnxcrash signal 11 code 1 addr 0x0
+ *   qnxcrash heap overflow past the end of 0x7f... size 100 offset 100
+ *   qnxcrash assert png.c:412 png_read_row row < height
+ *   qnxcrash frame 0 0x7f...  /usr/lib/libpng16.so.0+0x1d2c4 png_read_row+0x54
+ *   qnxcrash hash 5f0c6de42aa1b3e7
+ *
+ * Callers come from the frame pointer chain while it stays on the
+ * stack, and from scanning the stack for return addresses when the
+ * chain ends early (QNX libraries are usually built without frame
+ * pointers). Each address is given as an offset into its object, which
+ * does not depend on where it was loaded, with the nearest dynamic
+ * symbol; addr2line on the offset finds static functions too. The hash
+ * covers the objects and offsets of the top QNX_CRASH_FRAMES frames
+ * (default 5), so crashes with the same hash took the same path. The
+ * heap line is only there for a fault on a QNX_HEAP_CHECK guard slot,
+ * and the assert line, instead of the signal line, for a failed
+ * assert(): file:line, function and expression.
+ */
+
+#define MAX_FRAMES 64
+#define SCAN_LIMIT (64 << 10)
+
+static int crash_fd = -1, hash_frames = 5;
+static char altstack[1 << 16];
+
+static void out(const char *fmt, ...)
+{
+	char buf[512];
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(buf, sizeof buf, fmt, ap);
+	va_end(ap);
+	if (n > (int)sizeof buf - 1)
+		n = sizeof buf - 1;
+	if (n > 0)
+		write(crash_fd, buf, n);
+}
+
+static uint64_t fnv(uint64_t h, const void *p, size_t n)
+{
+	const unsigned char *c = p;
+
+	while (n--)
+		h = (h ^ *c++) * 0x100000001b3ULL;
+	return h;
+}
+
+static int is_code(uintptr_t a, Dl_info *info)
+{
+	return a > 4096 && dladdr((void *)a, info) && info->dli_fname;
+}
+
+/* Whether the bytes before a could be a call that returns to a. */
+static int after_call(uintptr_t a)
+{
+#if defined(__aarch64__)
+	uint32_t insn;
+
+	if (a & 3)
+		return 0;
+	insn = ((const uint32_t *)a)[-1];
+	return (insn & 0xfc000000) == 0x94000000 ||	/* bl */
+	       (insn & 0xfffffc1f) == 0xd63f0000;	/* blr */
+#elif defined(__arm__)
+	const uint16_t *t = (const uint16_t *)(a & ~1);
+	uint32_t insn;
+
+	/* Thumb return addresses have bit 0 set */
+	if (a & 1)
+		return (t[-2] & 0xf800) == 0xf000 ||	/* bl, blx */
+		       (t[-1] & 0xff87) == 0x4780;	/* blx reg */
+	if (a & 3)
+		return 0;
+	insn = ((const uint32_t *)a)[-1];
+	return (insn & 0x0f000000) == 0x0b000000 ||	/* bl */
+	       (insn & 0xfe000000) == 0xfa000000 ||	/* blx */
+	       (insn & 0x0ffffff0) == 0x012fff30;	/* blx reg */
+#else
+	const unsigned char *p = (const unsigned char *)a;
+
+	return p[-5] == 0xe8 ||
+	       (p[-2] == 0xff && (p[-1] & 0x38) == 0x10) ||
+	       (p[-3] == 0xff && (p[-2] & 0x38) == 0x10) ||
+	       (p[-6] == 0xff && (p[-5] & 0x38) == 0x10) ||
+	       (p[-7] == 0xff && (p[-6] & 0x38) == 0x10);
+#endif
+}
+
+static uintptr_t stack_top(uintptr_t sp)
+{
+	pthread_t self = __pthread_self();
+	uintptr_t top = (uintptr_t)self->stack;
+
+	if (top && sp < top && sp >= top - self->stack_size)
+		return top;
+	/* The main thread: its environment is above the first frame. */
+	if (sp < (uintptr_t)__environ)
+		return (uintptr_t)__environ;
+	return sp;
+}
+
+int __qnx_unwind(uintptr_t pc, uintptr_t fp, uintptr_t sp, uintptr_t *f,
+		 int max)
+{
+	uintptr_t top = stack_top(sp), *w;
+	Dl_info info;
+	int n = 0;
+
+	f[n++] = pc;
+	while (n < max && fp >= sp && fp + 16 <= top && !(fp & 7)) {
+		uintptr_t ret = ((uintptr_t *)fp)[1];
+		if (!is_code(ret, &info))
+			break;
+		f[n++] = ret - 1;
+		sp = fp + 16;
+		fp = ((uintptr_t *)fp)[0];
+	}
+	if (n > 2)
+		return n;
+	if (top - sp > SCAN_LIMIT)
+		top = sp + SCAN_LIMIT;
+	for (w = (uintptr_t *)sp; n < max && (uintptr_t)(w + 1) <= top; w++)
+		if (is_code(*w, &info) && after_call(*w))
+			f[n++] = *w - 1;
+	return n;
+}
+
+/* The frame lines of f, and the hash of its top frames. */
+static void trace(const uintptr_t *f, int n)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	Dl_info info;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		const char *name = "?", *sym = "?";
+		uintptr_t off = f[i], symoff = 0;
+		if (dladdr((void *)f[i], &info) && info.dli_fname) {
+			name = info.dli_fname;
+			off = f[i] - (uintptr_t)info.dli_fbase;
+			if (info.dli_sname) {
+				sym = info.dli_sname;
+				symoff = f[i] - (uintptr_t)info.dli_saddr;
+			}
+		}
+		out("qnxcrash frame %d %#lx %s+%#lx %s+%#lx\n", i, f[i], name,
+		    off, sym, symoff);
+		if (i < hash_frames) {
+			const char *base = strrchr(name, '/');
+			base = base ? base + 1 : name;
+			hash = fnv(hash, base, strlen(base));
+			hash = fnv(hash, &off, sizeof off);
+		}
+	}
+	out("qnxcrash hash %016llx\n", (unsigned long long)hash);
+}
+
+static void handler(int sig, siginfo_t *si, void *ctx)
+{
+	ucontext_t *uc = ctx;
+	uintptr_t f[MAX_FRAMES], pc = 0, fp = 0, sp = (uintptr_t)&f;
+	struct qnx_heap_where w;
+
+	/* An assertion already gave the trace of its abort. */
+	if (crash_fd < 0)
+		goto out;
+#if defined(__x86_64__)
+	pc = uc->uc_mcontext.gregs[REG_RIP];
+	fp = uc->uc_mcontext.gregs[REG_RBP];
+	sp = uc->uc_mcontext.gregs[REG_RSP];
+#elif defined(__aarch64__)
+	/* AArch64 frame records are laid out as on x86_64: the caller's
+	 * frame pointer, then the return address. */
+	pc = uc->uc_mcontext.pc;
+	fp = uc->uc_mcontext.regs[29];
+	sp = uc->uc_mcontext.sp;
+#elif defined(__arm__)
+	/* No common frame layout between ARM and Thumb code: only the
+	 * stack scan. */
+	pc = uc->uc_mcontext.arm_pc;
+	sp = uc->uc_mcontext.arm_sp;
+#endif
+	out("qnxcrash signal %d code %d addr %p\n", sig, si->si_code,
+	    si->si_addr);
+	if (__qnx_heap_where(si->si_addr, &w))
+		out("qnxcrash heap %s %p size %zu offset %td\n", w.what,
+		    w.block, w.size, (char *)si->si_addr - (char *)w.block);
+	trace(f, __qnx_unwind(pc, fp, sp, f, MAX_FRAMES));
+out:
+	/* Handler reset: a fault happens again, a sent signal is resent. */
+	if (si->si_code <= 0 || sig == SIGABRT)
+		raise(sig);
+}
+
+/*
+ * A failed assertion, just before its abort: the assertion, then the
+ * trace from the call to __assert, so that the top frames and the hash
+ * are the caller's and not those of abort. The SIGABRT that follows
+ * adds nothing.
+ */
+void __qnx_crash_assert(const char *expr, const char *file, unsigned line,
+			const char *func, uintptr_t ret, uintptr_t sp)
+{
+	uintptr_t f[MAX_FRAMES];
+	int n;
+
+	if (crash_fd < 0)
+		return;
+	out("qnxcrash assert %s:%u %s %s\n", file, line, func ? func : "?",
+	    expr);
+	/* The scan finds the return address the trace starts from. */
+	n = __qnx_unwind(ret - 1, 0, sp, f, MAX_FRAMES);
+	if (n > 1 && f[1] == f[0]) {
+		memmove(f + 1, f + 2, (n - 2) * sizeof *f);
+		n--;
+	}
+	trace(f, n);
+	crash_fd = -1;
+}
+
+void __qnx_crash_init(void)
+{
+	static const int sigs[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+	struct sigaction sa = { .sa_sigaction = handler };
+	stack_t ss = { .ss_sp = altstack, .ss_size = sizeof altstack };
+	const char *s = getenv("QNX_CRASH_TRACE");
+	size_t i;
+
+	if (!s || !*s)
+		return;
+	crash_fd = atoi(s);
+	if ((s = getenv("QNX_CRASH_FRAMES")) && *s)
+		hash_frames = atoi(s);
+	/* A stack overflow still gets its trace. */
+	sigaltstack(&ss, 0);
+	sa.sa_flags = SA_SIGINFO | SA_ONSTACK | SA_RESETHAND | SA_NODEFER;
+	sigemptyset(&sa.sa_mask);
+	for (i = 0; i < sizeof sigs / sizeof *sigs; i++)
+		sigaction(sigs[i], &sa, 0);
+}
@@ -1,4 +1,7 @@
 #include <locale.h>
+#include "locale_impl.h"
+#include "lock.h"
+#include "qnx_redirect.h"
 
 struct qnx_lconv
 	{	/* locale-specific information */
@@ -43,7 +46,7 @@ struct qnx_lconv
 	char *_Reserved[8];
 	};
 
-void convert_musl_to_qnx_lconv(const struct lconv *musl, struct qnx_lconv *qnx) {
+static void convert_musl_to_qnx_lconv(const struct lconv *musl, struct qnx_lconv *qnx) {
     qnx->decimal_point = musl->decimal_point;
     qnx->thousands_sep = musl->thousands_sep;
     qnx->grouping = musl->grouping;
@@ -88,15 +91,29 @@ void convert_musl_to_qnx_lconv(const struct lconv *musl, struct qnx_lconv *qnx)
     }
 }
 
+/*
+ * The converted lconv is kept until the calling thread's LC_NUMERIC or
+ * LC_MONETARY mapping changes (setlocale, uselocale), so the per-number
+ * localeconv() calls QNX printf code makes cost two compares. musl's
+ * lconv is the same for all locales, so a rebuild racing with a reader
+ * stores the values the reader already sees.
+ */
 struct qnx_lconv *_qnx_localeconv(void) {
     static struct qnx_lconv qnx_lconv;
-    static int initialized = 0;
+    static const struct __locale_map *numeric = LOC_MAP_FAILED;
+    static const struct __locale_map *monetary = LOC_MAP_FAILED;
+    static volatile int lock[1];
+    locale_t loc = CURRENT_LOCALE;
 
-    if (!initialized) {
-        const struct lconv *musl_lconv = localeconv();
-        convert_musl_to_qnx_lconv(musl_lconv, &qnx_lconv);
-        initialized = 1;
+    if (loc->cat[LC_NUMERIC] != numeric ||
+        loc->cat[LC_MONETARY] != monetary) {
+        LOCK(lock);
+        convert_musl_to_qnx_lconv(localeconv(), &qnx_lconv);
+        numeric = loc->cat[LC_NUMERIC];
+        monetary = loc->cat[LC_MONETARY];
+        UNLOCK(lock);
     }
 
     return &qnx_lconv;
-}
\ No newline at end of file
+}
+QNX_REDIRECT(localeconv);
@@ -0,0 +1,347 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "neutrino.h"
+#include "pthread_impl.h"
+#include "lock.h"
+
+/*
+ * Channels and connections. A process's own channels live in chans[],
+ * indexed by chid; connections live in conns[] (a coid is the fd of the
+ * open channel file, as QNX connections share the fd space) or, for
+ * side channels, in sides[] with coid _NTO_SIDE_CHANNEL | index. A
+ * connection to a channel of the same process shares its nto_chan, so
+ * a local MsgSend never maps the channel twice.
+ */
+
+#define NTO_SIDE_MAX 256
+
+static volatile int lock[1];
+static struct nto_chan *chans[NTO_CHID_MAX];
+static struct nto_chan *conns[NTO_CONN_MAX];
+static struct nto_chan *sides[NTO_SIDE_MAX];
+static int exit_hooked;
+
+int __nto_wait(volatile int *addr, int val, int ms)
+{
+	struct timespec ts = { ms / 1000, ms % 1000 * 1000000 };
+	int r = __syscall(SYS_futex, addr, FUTEX_WAIT, val, ms ? &ts : 0);
+	return r == -EAGAIN ? 0 : r;
+}
+
+void __nto_wake(volatile int *addr, int cnt)
+{
+	__wake(addr, cnt, 0);
+}
+
+static void chan_path(char *buf, pid_t pid, int chid)
+{
+	snprintf(buf, 64, NTO_PATH "%d.%d", (int)pid, chid);
+}
+
+static void unlink_channels(void)
+{
+	char path[64];
+	pid_t self = getpid();
+
+	for (int i = 1; i < NTO_CHID_MAX; i++)
+		if (chans[i] && chans[i]->pid == self) {
+			chan_path(path, self, i);
+			unlink(path);
+		}
+}
+
+void __nto_chan_put(struct nto_chan *ch)
+{
+	LOCK(lock);
+	int last = !--ch->refs;
+	UNLOCK(lock);
+	if (last) {
+		munmap(ch->shm, sizeof *ch->shm);
+		free(ch->pq);
+		free(ch);
+	}
+}
+
+/* A forked child does not own its parent's channels. */
+struct nto_chan *__nto_chan_owned(int chid)
+{
+	struct nto_chan *ch = 0;
+
+	if (chid <= 0 || chid >= NTO_CHID_MAX)
+		return 0;
+	LOCK(lock);
+	if (chans[chid] && chans[chid]->pid == getpid()) {
+		ch = chans[chid];
+		ch->refs++;
+	}
+	UNLOCK(lock);
+	return ch;
+}
+
+static struct nto_chan **conn_ent(int coid)
+{
+	if (coid & _NTO_SIDE_CHANNEL) {
+		coid &= ~_NTO_SIDE_CHANNEL;
+		return coid < NTO_SIDE_MAX ? &sides[coid] : 0;
+	}
+	return coid >= 0 && coid < NTO_CONN_MAX ? &conns[coid] : 0;
+}
+
+struct nto_chan *__nto_conn(int coid)
+{
+	struct nto_chan **ent, *ch = 0;
+
+	LOCK(lock);
+	if ((ent = conn_ent(coid)) && (ch = *ent))
+		ch->refs++;
+	UNLOCK(lock);
+	return ch;
+}
+
+int ChannelCreate_r(unsigned flags)
+{
+	char path[64];
+	struct nto_chan *ch, *old;
+	struct nto_chan_shm *shm;
+	pid_t self = getpid();
+	int chid, fd, err;
+
+	if (!(ch = calloc(1, sizeof *ch)))
+		return -ENOMEM;
+
+	LOCK(lock);
+	for (chid = 1; chid < NTO_CHID_MAX; chid++)
+		if (!chans[chid] || chans[chid]->pid != self)
+			break;
+	if (chid == NTO_CHID_MAX) {
+		UNLOCK(lock);
+		free(ch);
+		return -EAGAIN;
+	}
+	/* Left over from before a fork; the parent still owns it. */
+	old = chans[chid];
+	chans[chid] = ch;
+	ch->refs = 1;
+	ch->pid = self;
+	ch->chid = chid;
+	if (!exit_hooked)
+		exit_hooked = !atexit(unlink_channels);
+	UNLOCK(lock);
+	if (old)
+		__nto_chan_put(old);
+
+	/* O_TRUNC: a file left by a dead process with a recycled pid. */
+	chan_path(path, self, chid);
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	if (fd < 0 || ftruncate(fd, sizeof *shm) < 0)
+		goto fail;
+	shm = mmap(0, sizeof *shm, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (shm == MAP_FAILED)
+		goto fail;
+	close(fd);
+
+	shm->version = NTO_VERSION;
+	shm->pid = self;
+	shm->chid = chid;
+	shm->flags = flags;
+	for (int i = 0; i < NTO_PULSES; i++)
+		shm->pulse[i].seq = i;
+	a_store((volatile int *)&shm->magic, NTO_MAGIC);
+	ch->shm = shm;
+	return chid;
+
+fail:
+	err = errno;
+	if (fd >= 0) {
+		close(fd);
+		unlink(path);
+	}
+	LOCK(lock);
+	chans[chid] = 0;
+	UNLOCK(lock);
+	free(ch);
+	return err == ENOSPC ? -ENOMEM : -err;
+}
+
+int ChannelCreate(unsigned flags)
+{
+	return nto_ret(ChannelCreate_r(flags));
+}
+
+/*
+ * Blocked senders and receivers are woken and fail with ESRCH; the
+ * mapping goes away with the last connection still using it.
+ */
+int ChannelDestroy_r(int chid)
+{
+	char path[64];
+	struct nto_chan *ch;
+	struct nto_chan_shm *shm;
+
+	if (!(ch = __nto_chan_owned(chid)))
+		return -EINVAL;
+	LOCK(lock);
+	chans[chid] = 0;
+	ch->refs--;
+	UNLOCK(lock);
+
+	shm = ch->shm;
+	a_store(&shm->destroyed, 1);
+	__nto_wake(&shm->events, -1);
+	__nto_wake(&shm->free_seq, -1);
+	for (int i = 0; i < NTO_SLOTS; i++)
+		__nto_wake(&shm->slot[i].state, -1);
+	chan_path(path, ch->pid, chid);
+	unlink(path);
+	__nto_chan_put(ch);
+	return 0;
+}
+
+int ChannelDestroy(int chid)
+{
+	return nto_ret(ChannelDestroy_r(chid));
+}
+
+static struct nto_chan *map_remote(pid_t pid, int chid, int *fdp)
+{
+	char path[64];
+	struct nto_chan *ch;
+	struct nto_chan_shm *shm;
+	struct stat st;
+	int fd;
+
+	chan_path(path, pid, chid);
+	if ((fd = open(path, O_RDWR | O_CLOEXEC)) < 0)
+		return 0;
+	if (fstat(fd, &st) < 0 || st.st_size != sizeof *shm)
+		goto fail;
+	shm = mmap(0, sizeof *shm, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (shm == MAP_FAILED)
+		goto fail;
+	if (shm->magic != NTO_MAGIC || shm->version != NTO_VERSION ||
+	    shm->destroyed || (kill(pid, 0) < 0 && errno == ESRCH)) {
+		munmap(shm, sizeof *shm);
+		goto fail;
+	}
+	if (!(ch = calloc(1, sizeof *ch))) {
+		munmap(shm, sizeof *shm);
+		goto fail;
+	}
+	ch->shm = shm;
+	ch->pid = pid;
+	ch->chid = chid;
+	ch->refs = 1;
+	*fdp = fd;
+	return ch;
+fail:
+	close(fd);
+	return 0;
+}
+
+int ConnectAttach_r(uint32_t nd, pid_t pid, int chid, unsigned index,
+		    int flags)
+{
+	struct nto_chan *ch, **ent;
+	pid_t self = getpid();
+	int fd = -1, coid;
+
+	if (nd != ND_LOCAL_NODE)
+		return -ESRCH;
+	if (!pid)
+		pid = self;
+	if (chid <= 0 || chid >= NTO_CHID_MAX)
+		return -ESRCH;
+
+	if (pid == self) {
+		char path[64];
+		if (!(ch = __nto_chan_owned(chid)))
+			return -ESRCH;
+		chan_path(path, pid, chid);
+		if (!(index & _NTO_SIDE_CHANNEL) &&
+		    (fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+			__nto_chan_put(ch);
+			return -errno;
+		}
+	} else if (!(ch = map_remote(pid, chid, &fd))) {
+		return -ESRCH;
+	}
+
+	if (index & _NTO_SIDE_CHANNEL) {
+		if (fd >= 0)
+			close(fd);
+		index &= ~_NTO_SIDE_CHANNEL;
+		LOCK(lock);
+		for (coid = index; coid < NTO_SIDE_MAX && sides[coid]; coid++);
+		if (coid < NTO_SIDE_MAX)
+			sides[coid] = ch;
+		UNLOCK(lock);
+		if (coid == NTO_SIDE_MAX) {
+			__nto_chan_put(ch);
+			return -EAGAIN;
+		}
+		return coid | _NTO_SIDE_CHANNEL;
+	}
+
+	/* Normal connections are fds: honour index as the lowest coid. */
+	if ((unsigned)fd < index) {
+		int nfd = fcntl(fd, F_DUPFD_CLOEXEC, index);
+		close(fd);
+		fd = nfd;
+	}
+	if (fd >= 0 && !(flags & _NTO_COF_CLOEXEC))
+		fcntl(fd, F_SETFD, 0);
+	if (fd < 0 || fd >= NTO_CONN_MAX) {
+		int err = fd < 0 ? errno : EAGAIN;
+		if (fd >= 0)
+			close(fd);
+		__nto_chan_put(ch);
+		return -err;
+	}
+	LOCK(lock);
+	ent = conn_ent(fd);
+	/* A stale entry for an fd closed behind our back. */
+	if (*ent) {
+		struct nto_chan *old = *ent;
+		*ent = 0;
+		UNLOCK(lock);
+		__nto_chan_put(old);
+		LOCK(lock);
+	}
+	*ent = ch;
+	UNLOCK(lock);
+	return fd;
+}
+
+int ConnectAttach(uint32_t nd, pid_t pid, int chid, unsigned index, int flags)
+{
+	return nto_ret(ConnectAttach_r(nd, pid, chid, index, flags));
+}
+
+int ConnectDetach_r(int coid)
+{
+	struct nto_chan **ent, *ch = 0;
+
+	LOCK(lock);
+	if ((ent = conn_ent(coid)) && (ch = *ent))
+		*ent = 0;
+	UNLOCK(lock);
+	if (!ch)
+		return -EINVAL;
+	if (!(coid & _NTO_SIDE_CHANNEL))
+		close(coid);
+	__nto_chan_put(ch);
+	return 0;
+}
+
+int ConnectDetach(int coid)
+{
+	return nto_ret(ConnectDetach_r(coid));
+}
@@ -0,0 +1,455 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "resmgr.h"
+#include "pthread_impl.h"
+#include "lock.h"
+
+/*
+ * dispatch_* and resmgr_*. A dispatch handle owns one channel; every
+ * thread of a pool blocks in MsgReceive on it, so messages spread over
+ * threads with no dispatcher lock. An open binds an OCB to the client
+ * connection, keyed by the client's pid and coid, in a hash whose
+ * buckets have their own locks; each later I/O message looks its OCB
+ * up there and runs the io function for its type, between the
+ * lock_ocb and unlock_ocb functions as on QNX.
+ */
+
+#define BIND_BUCKETS 256
+#define MSG_MAX_DEFAULT 2048
+
+typedef int (*pulse_func_t)(void *, int, unsigned, void *);
+
+struct rsm_attach {
+	struct rsm_attach *next;
+	int id;
+	int ns_slot;
+	const resmgr_connect_funcs_t *connect;
+	const resmgr_io_funcs_t *io;
+	void *handle;
+	int (*other_func)(resmgr_context_t *, void *);
+};
+
+struct rsm_pulse {
+	struct rsm_pulse *next;
+	int code;
+	pulse_func_t func;
+	void *handle;
+};
+
+struct _dispatch {
+	int chid;
+	unsigned flags;
+	unsigned nparts_max, msg_max_size;
+	volatile int lock[1];
+	int next_id;
+	struct rsm_attach *attaches;
+	struct rsm_pulse *pulses;
+};
+
+struct bind {
+	struct bind *next;
+	dispatch_t *dpp;
+	pid_t pid;
+	int coid;
+	void *ocb;
+	const resmgr_io_funcs_t *io;
+};
+
+static struct {
+	volatile int lock[1];
+	struct bind *head;
+} binds[BIND_BUCKETS];
+
+static unsigned bucket(pid_t pid, int coid)
+{
+	return ((unsigned)pid * 2654435761u ^ (unsigned)coid) % BIND_BUCKETS;
+}
+
+static struct bind *bind_find(dispatch_t *dpp, pid_t pid, int coid,
+			      struct bind *out)
+{
+	unsigned h = bucket(pid, coid);
+	struct bind *b;
+
+	LOCK(binds[h].lock);
+	for (b = binds[h].head; b; b = b->next)
+		if (b->dpp == dpp && b->pid == pid && b->coid == coid) {
+			*out = *b;
+			break;
+		}
+	UNLOCK(binds[h].lock);
+	return b ? out : 0;
+}
+
+static void bind_remove(dispatch_t *dpp, pid_t pid, int coid)
+{
+	unsigned h = bucket(pid, coid);
+	struct bind **p, *b = 0;
+
+	LOCK(binds[h].lock);
+	for (p = &binds[h].head; *p; p = &(*p)->next)
+		if ((*p)->dpp == dpp && (*p)->pid == pid && (*p)->coid == coid) {
+			b = *p;
+			*p = b->next;
+			break;
+		}
+	UNLOCK(binds[h].lock);
+	free(b);
+}
+
+static struct rsm_attach *find_attach(dispatch_t *dpp, int id)
+{
+	struct rsm_attach *a;
+
+	LOCK(dpp->lock);
+	for (a = dpp->attaches; a && a->id != id; a = a->next);
+	UNLOCK(dpp->lock);
+	return a;
+}
+
+dispatch_t *dispatch_create_channel(int chid, unsigned flags)
+{
+	dispatch_t *dpp = calloc(1, sizeof *dpp);
+
+	if (!dpp)
+		return 0;
+	if (chid < 0 && (chid = ChannelCreate(_NTO_CHF_DISCONNECT |
+					      _NTO_CHF_UNBLOCK)) < 0) {
+		free(dpp);
+		return 0;
+	}
+	dpp->chid = chid;
+	dpp->flags = flags;
+	dpp->nparts_max = 1;
+	dpp->msg_max_size = MSG_MAX_DEFAULT;
+	dpp->next_id = 1;
+	return dpp;
+}
+
+int __nto_dispatch_chid(dispatch_t *dpp)
+{
+	return dpp->chid;
+}
+
+dispatch_t *dispatch_create(void)
+{
+	return dispatch_create_channel(-1, 0);
+}
+
+int dispatch_destroy(dispatch_t *dpp)
+{
+	struct rsm_attach *a, *an;
+	struct rsm_pulse *p, *pn;
+
+	for (a = dpp->attaches; a; a = an) {
+		an = a->next;
+		if (a->ns_slot >= 0)
+			__nto_ns_detach(a->ns_slot);
+		free(a);
+	}
+	for (p = dpp->pulses; p; p = pn) {
+		pn = p->next;
+		free(p);
+	}
+	ChannelDestroy(dpp->chid);
+	free(dpp);
+	return 0;
+}
+
+int resmgr_attach(dispatch_t *dpp, resmgr_attr_t *attr, const char *path,
+		  int file_type, unsigned flags,
+		  const resmgr_connect_funcs_t *connect_funcs,
+		  const resmgr_io_funcs_t *io_funcs, void *handle)
+{
+	struct rsm_attach *a = calloc(1, sizeof *a);
+
+	if (!a) {
+		errno = ENOMEM;
+		return -1;
+	}
+	a->connect = connect_funcs;
+	a->io = io_funcs;
+	a->handle = handle;
+	a->ns_slot = -1;
+
+	LOCK(dpp->lock);
+	if (attr) {
+		if (attr->nparts_max > dpp->nparts_max)
+			dpp->nparts_max = attr->nparts_max;
+		if (attr->msg_max_size > dpp->msg_max_size)
+			dpp->msg_max_size = attr->msg_max_size;
+		a->other_func = attr->other_func;
+	}
+	a->id = dpp->next_id++;
+	UNLOCK(dpp->lock);
+
+	if (path) {
+		int slot = __nto_ns_attach(path, dpp->chid, a->id, flags,
+					   file_type);
+		if (slot < 0) {
+			free(a);
+			errno = -slot;
+			return -1;
+		}
+		a->ns_slot = slot;
+	}
+
+	LOCK(dpp->lock);
+	a->next = dpp->attaches;
+	dpp->attaches = a;
+	UNLOCK(dpp->lock);
+	return a->id;
+}
+
+int resmgr_detach(dispatch_t *dpp, int id, unsigned flags)
+{
+	struct rsm_attach **p, *a = 0;
+
+	(void)flags;
+	LOCK(dpp->lock);
+	for (p = &dpp->attaches; *p; p = &(*p)->next)
+		if ((*p)->id == id) {
+			a = *p;
+			*p = a->next;
+			break;
+		}
+	UNLOCK(dpp->lock);
+	if (!a) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (a->ns_slot >= 0)
+		__nto_ns_detach(a->ns_slot);
+	free(a);
+	return 0;
+}
+
+int pulse_attach(dispatch_t *dpp, int flags, int code, pulse_func_t func,
+		 void *handle)
+{
+	struct rsm_pulse *p = malloc(sizeof *p);
+
+	(void)flags;
+	if (!p) {
+		errno = ENOMEM;
+		return -1;
+	}
+	p->code = code;
+	p->func = func;
+	p->handle = handle;
+	LOCK(dpp->lock);
+	p->next = dpp->pulses;
+	dpp->pulses = p;
+	UNLOCK(dpp->lock);
+	return code;
+}
+
+int resmgr_open_bind(resmgr_context_t *ctp, void *ocb,
+		     const resmgr_io_funcs_t *io)
+{
+	struct bind *b = malloc(sizeof *b);
+	unsigned h;
+
+	if (!b)
+		return ENOMEM;
+	if (!io) {
+		struct rsm_attach *a = find_attach(ctp->dpp, ctp->id);
+		io = a ? a->io : 0;
+	}
+	b->dpp = ctp->dpp;
+	b->pid = ctp->info.pid;
+	b->coid = ctp->info.coid;
+	b->ocb = ocb;
+	b->io = io;
+	/* A reused fd on the client side replaces what it was bound to. */
+	bind_remove(b->dpp, b->pid, b->coid);
+	h = bucket(b->pid, b->coid);
+	LOCK(binds[h].lock);
+	b->next = binds[h].head;
+	binds[h].head = b;
+	UNLOCK(binds[h].lock);
+	return EOK;
+}
+
+void *resmgr_ocb(resmgr_context_t *ctp)
+{
+	struct bind b;
+	return bind_find(ctp->dpp, ctp->info.pid, ctp->info.coid, &b) ?
+	       b.ocb : 0;
+}
+
+ssize_t resmgr_msgread(resmgr_context_t *ctp, void *msg, size_t size,
+		       size_t offset)
+{
+	return MsgRead(ctp->rcvid, msg, size, ctp->offset + offset);
+}
+
+ssize_t resmgr_msgreadv(resmgr_context_t *ctp, iov_t *iov, int parts,
+			size_t offset)
+{
+	return MsgReadv(ctp->rcvid, iov, parts, ctp->offset + offset);
+}
+
+int resmgr_msgreply(resmgr_context_t *ctp, void *msg, size_t size)
+{
+	return MsgReply(ctp->rcvid, ctp->status, msg, size);
+}
+
+int resmgr_msgreplyv(resmgr_context_t *ctp, iov_t *iov, int parts)
+{
+	return MsgReplyv(ctp->rcvid, ctp->status, iov, parts);
+}
+
+ssize_t resmgr_msgwrite(resmgr_context_t *ctp, const void *msg, size_t size,
+			size_t offset)
+{
+	return MsgWrite(ctp->rcvid, msg, size, offset);
+}
+
+dispatch_context_t *dispatch_context_alloc(dispatch_t *dpp)
+{
+	unsigned parts = dpp->nparts_max, max = dpp->msg_max_size;
+	size_t head = sizeof(resmgr_context_t) + (parts - 1) * sizeof(iov_t);
+	resmgr_context_t *ctp;
+
+	head = (head + 15) & ~(size_t)15;
+	if (!(ctp = calloc(1, head + max)))
+		return 0;
+	ctp->dpp = dpp;
+	ctp->msg = (resmgr_iomsgs_t *)((char *)ctp + head);
+	ctp->msg_max_size = max;
+	return (dispatch_context_t *)ctp;
+}
+
+void dispatch_context_free(dispatch_context_t *ctp)
+{
+	free(ctp);
+}
+
+dispatch_context_t *dispatch_block(dispatch_context_t *dctp)
+{
+	resmgr_context_t *ctp = &dctp->resmgr_context;
+
+	ctp->rcvid = MsgReceive(ctp->dpp->chid, ctp->msg, ctp->msg_max_size,
+				&ctp->info);
+	if (ctp->rcvid < 0)
+		return 0;
+	ctp->tid = ctp->info.tid;
+	ctp->offset = 0;
+	ctp->size = ctp->info.msglen;
+	return dctp;
+}
+
+static resmgr_func_t io_func(const resmgr_io_funcs_t *io, unsigned type)
+{
+	unsigned idx = type - _IO_READ;
+
+	if (!io || idx >= io->nfuncs || idx >= _RESMGR_IO_NFUNCS)
+		return 0;
+	return ((const resmgr_func_t *)&io->read)[idx];
+}
+
+static void reply(resmgr_context_t *ctp, int ret, int unhandled)
+{
+	if (ret == _RESMGR_NOREPLY)
+		return;
+	if (ret == _RESMGR_DEFAULT)
+		MsgError(ctp->rcvid, unhandled);
+	else if (ret < 0)
+		MsgReplyv(ctp->rcvid, ctp->status, ctp->iov, -ret);
+	else if (ret == EOK)
+		MsgReply(ctp->rcvid, ctp->status, 0, 0);
+	else
+		MsgError(ctp->rcvid, ret);
+}
+
+static int handle_connect(resmgr_context_t *ctp)
+{
+	struct _io_connect *c = &ctp->msg->connect;
+	struct rsm_attach *a;
+
+	if (ctp->size < (int)offsetof(struct _io_connect, path) ||
+	    !(a = find_attach(ctp->dpp, c->handle)))
+		return ENOENT;
+	ctp->id = a->id;
+	if (c->subtype != _IO_CONNECT_OPEN || !a->connect ||
+	    a->connect->nfuncs < 1 || !a->connect->open)
+		return ENOSYS;
+	/* The path is NUL terminated inside the buffer, never past it. */
+	if (offsetof(struct _io_connect, path) + c->path_len >=
+	    ctp->msg_max_size)
+		return ENAMETOOLONG;
+	c->path[c->path_len] = 0;
+	return a->connect->open(ctp, (io_open_t *)c, a->handle, 0);
+}
+
+static int handle_io(resmgr_context_t *ctp, unsigned type)
+{
+	struct bind b;
+	resmgr_func_t f, lock, unlock;
+	int ret;
+
+	if (!bind_find(ctp->dpp, ctp->info.pid, ctp->info.coid, &b))
+		return EBADF;
+
+	if (type == _IO_CLOSE) {
+		if ((f = io_func(b.io, _IO_CLOSE)))
+			f(ctp, ctp->msg, b.ocb);
+		if ((f = io_func(b.io, _IO_CLOSE_OCB)))
+			f(ctp, 0, b.ocb);
+		bind_remove(ctp->dpp, b.pid, b.coid);
+		return EOK;
+	}
+	if (!(f = io_func(b.io, type)))
+		return type == _IO_DEVCTL ? ENOTTY : ENOSYS;
+	lock = io_func(b.io, _IO_CLOSE + 1);
+	unlock = io_func(b.io, _IO_CLOSE + 2);
+	if (lock && (ret = lock(ctp, 0, b.ocb)) != EOK)
+		return ret;
+	ret = f(ctp, ctp->msg, b.ocb);
+	if (unlock)
+		unlock(ctp, 0, b.ocb);
+	return ret;
+}
+
+int dispatch_handler(dispatch_context_t *dctp)
+{
+	resmgr_context_t *ctp = &dctp->resmgr_context;
+	dispatch_t *dpp = ctp->dpp;
+	unsigned type;
+	int ret;
+
+	if (!ctp->rcvid) {
+		struct _pulse *p = (struct _pulse *)ctp->msg;
+		struct rsm_pulse *h;
+		LOCK(dpp->lock);
+		for (h = dpp->pulses; h && h->code != p->code; h = h->next);
+		UNLOCK(dpp->lock);
+		if (!h)
+			return -1;
+		h->func(ctp, p->code, 0, h->handle);
+		return 0;
+	}
+
+	ctp->status = 0;
+	ctp->id = -1;
+	type = ctp->size >= 2 ? ctp->msg->type : 0;
+	if (type == _IO_CONNECT) {
+		ret = handle_connect(ctp);
+	} else if (type >= _IO_READ && type < _IO_READ + _RESMGR_IO_NFUNCS) {
+		ret = handle_io(ctp, type);
+	} else {
+		struct rsm_attach *a;
+		LOCK(dpp->lock);
+		for (a = dpp->attaches; a && !a->other_func; a = a->next);
+		UNLOCK(dpp->lock);
+		if (!a) {
+			MsgError(ctp->rcvid, ENOSYS);
+			return -1;
+		}
+		ret = a->other_func(ctp, ctp->msg);
+	}
+	reply(ctp, ret, type == _IO_DEVCTL ? ENOTTY : ENOSYS);
+	return 0;
+}
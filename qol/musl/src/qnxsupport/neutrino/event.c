@@ -0,0 +1,743 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include "neutrino.h"
+#include "pthread_impl.h"
+#include "lock.h"
+#include "qnx_redirect.h"
+#include "../qnx_signal.h"
+#include "../qnx_time.h"
+
+/*
+ * Timers and interrupts. Each one is a descriptor, a timerfd or a UIO
+ * device (/dev/uio<n> for interrupt n), in a single epoll set that one
+ * service thread per process waits on. An expiry batch costs that
+ * thread one wakeup, after which it delivers each source's event from
+ * its own context: a pulse into the channel, a queued signal, a
+ * SIGEV_THREAD call or an InterruptWait wakeup. Timer overruns are the
+ * timerfd's expiry count less the one delivered.
+ *
+ * An interrupt with no UIO device attaches to an eventfd, so a driver
+ * for absent hardware starts and waits as if it never interrupted.
+ *
+ * ionotify arms are in the same set: each descriptor a process arms is
+ * added once, one shot, and a later arm only re-enables it, so a server
+ * that rearms thousands of connections pays for the ones that fire.
+ */
+
+#define NTO_EVENTS_MAX 1024
+#define BATCH 64
+
+struct _itimer {
+	uint64_t nsec;
+	uint64_t interval_nsec;
+};
+
+typedef const struct nto_event *(*nto_isr)(void *, int);
+
+enum { SRC_FREE, SRC_TIMER, SRC_INTR };
+
+struct source {
+	int kind;
+	int fd;
+	uint32_t gen;
+	int uio;
+	int intr;
+	int masked;
+	int overrun;
+	pid_t tid;
+	nto_isr isr;
+	void *area;
+	struct nto_event ev;
+};
+
+static struct source src[NTO_EVENTS_MAX];
+
+/* ionotify state per descriptor, keyed into the set with NOTE_KEY. */
+struct note {
+	uint32_t gen;
+	int added;
+	int armed;
+	pid_t tid;
+	struct nto_event ev;
+};
+
+#define NOTE_KEY 0x80000000u
+
+static struct note *notes;
+static int nnotes;
+static volatile int lock[1];
+static int epfd = -1;
+static pid_t svc_pid;
+static volatile int intr_count;
+
+struct thread_ev {
+	void (*fn)(union sigval);
+	union sigval value;
+};
+
+static void *notify_thread(void *p)
+{
+	struct thread_ev t = *(struct thread_ev *)p;
+
+	free(p);
+	t.fn(t.value);
+	return 0;
+}
+
+static void queue_signal(const struct nto_event *ev, pid_t tid, int code)
+{
+	siginfo_t si = { 0 };
+	int sig = __qnx_signo_to_linux(ev->un1.signo);
+
+	if (!sig)
+		return;
+	si.si_signo = sig;
+	si.si_code = code;
+	si.si_pid = getpid();
+	si.si_uid = getuid();
+	si.si_value = ev->value;
+	if (tid)
+		__syscall(SYS_rt_tgsigqueueinfo, si.si_pid, tid, sig, &si);
+	else
+		__syscall(SYS_rt_sigqueueinfo, si.si_pid, sig, &si);
+}
+
+void __nto_event_deliver(const struct nto_event *ev, pid_t tid, int code)
+{
+	struct thread_ev *t;
+	pthread_attr_t a;
+	pthread_t th;
+
+	switch (ev->sigev_notify & QNX_SIGEV_TYPE_MASK) {
+	case QNX_SIGEV_PULSE:
+		MsgSendPulsePtr_r(ev->un1.coid, ev->un2.st.priority,
+				  ev->un2.st.code, ev->value.sival_ptr);
+		break;
+	case QNX_SIGEV_SIGNAL:
+		queue_signal(ev, 0, code);
+		break;
+	case QNX_SIGEV_SIGNAL_CODE:
+		queue_signal(ev, 0, ev->un2.st.code);
+		break;
+	case QNX_SIGEV_SIGNAL_THREAD:
+		queue_signal(ev, tid, ev->un2.st.code);
+		break;
+	case QNX_SIGEV_INTR:
+		a_inc(&intr_count);
+		__nto_wake(&intr_count, -1);
+		break;
+	case QNX_SIGEV_THREAD:
+		if (!(t = malloc(sizeof *t)))
+			break;
+		t->fn = ev->un1.fn;
+		t->value = ev->value;
+		pthread_attr_init(&a);
+		pthread_attr_setdetachstate(&a, PTHREAD_CREATE_DETACHED);
+		if (pthread_create(&th, &a, notify_thread, t))
+			free(t);
+		pthread_attr_destroy(&a);
+		break;
+	}
+}
+
+static void uio_ctl(struct source *s, int32_t on)
+{
+	if (s->uio)
+		write(s->fd, &on, sizeof on);
+}
+
+static void note_fire(uint64_t key)
+{
+	int fd = (uint32_t)key & ~NOTE_KEY;
+	struct nto_event ev;
+	pid_t tid;
+
+	LOCK(lock);
+	if (fd >= nnotes || notes[fd].gen != key >> 32 || !notes[fd].armed) {
+		UNLOCK(lock);
+		return;
+	}
+	notes[fd].armed = 0;
+	ev = notes[fd].ev;
+	tid = notes[fd].tid;
+	UNLOCK(lock);
+	__nto_event_deliver(&ev, tid, SI_QUEUE);
+}
+
+static void fire(uint64_t key)
+{
+	struct source *s = &src[(uint32_t)key];
+	struct nto_event ev;
+	const struct nto_event *out;
+	uint64_t count = 0;
+	int kind, id = (uint32_t)key;
+	nto_isr isr;
+	void *area;
+	pid_t tid;
+
+	LOCK(lock);
+	if (s->kind == SRC_FREE || s->gen != key >> 32 ||
+	    read(s->fd, &count, s->uio ? 4 : 8) <= 0) {
+		UNLOCK(lock);
+		return;
+	}
+	kind = s->kind;
+	if (kind == SRC_TIMER)
+		s->overrun = count - 1 > INT_MAX ? INT_MAX : count - 1;
+	else if (!s->isr && !s->masked++)
+		uio_ctl(s, 0);
+	ev = s->ev;
+	isr = s->isr;
+	area = s->area;
+	tid = s->tid;
+	UNLOCK(lock);
+
+	if (!isr) {
+		__nto_event_deliver(&ev, tid,
+				    kind == SRC_TIMER ? SI_TIMER : SI_QUEUE);
+		return;
+	}
+	/* As after an ISR, the interrupt is live again unless masked. */
+	if ((out = isr(area, id)))
+		__nto_event_deliver(out, tid, SI_QUEUE);
+	LOCK(lock);
+	if (s->kind == SRC_INTR && s->gen == key >> 32 && !s->masked)
+		uio_ctl(s, 1);
+	UNLOCK(lock);
+}
+
+static void *service(void *arg)
+{
+	struct epoll_event e[BATCH];
+	int n, i, fd = (intptr_t)arg;
+
+	for (;;) {
+		n = epoll_wait(fd, e, BATCH, -1);
+		for (i = 0; i < n; i++) {
+			if ((uint32_t)e[i].data.u64 & NOTE_KEY)
+				note_fire(e[i].data.u64);
+			else
+				fire(e[i].data.u64);
+		}
+	}
+	return 0;
+}
+
+/*
+ * Called with lock held. A forked child starts with no timers and no
+ * service thread, so both come back here on first use.
+ */
+static int start(void)
+{
+	sigset_t all, old;
+	pthread_t t;
+	int fd, i;
+
+	if (svc_pid == getpid())
+		return 0;
+	for (i = 0; i < NTO_EVENTS_MAX; i++) {
+		if (src[i].kind != SRC_FREE) {
+			close(src[i].fd);
+			src[i].kind = SRC_FREE;
+		}
+	}
+	free(notes);
+	notes = 0;
+	nnotes = 0;
+	if (epfd >= 0)
+		close(epfd);
+	epfd = -1;
+	if ((fd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		return -errno;
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	i = pthread_create(&t, 0, service, (void *)(intptr_t)fd);
+	pthread_sigmask(SIG_SETMASK, &old, 0);
+	if (i) {
+		close(fd);
+		return -i;
+	}
+	pthread_detach(t);
+	epfd = fd;
+	svc_pid = getpid();
+	return 0;
+}
+
+int __nto_event_check(const struct nto_event *ev, int intr)
+{
+	switch (ev->sigev_notify & QNX_SIGEV_TYPE_MASK) {
+	case QNX_SIGEV_INTR:
+		return intr ? 0 : -EINVAL;
+	case QNX_SIGEV_NONE:
+	case QNX_SIGEV_PULSE:
+	case QNX_SIGEV_THREAD:
+		return 0;
+	case QNX_SIGEV_SIGNAL:
+	case QNX_SIGEV_SIGNAL_CODE:
+	case QNX_SIGEV_SIGNAL_THREAD:
+		return __qnx_signo_to_linux(ev->un1.signo) ? 0 : -EINVAL;
+	}
+	return -EINVAL;
+}
+
+/* Takes over t->fd; returns the new id or -errno. */
+static int add(const struct source *t, const struct nto_event *ev)
+{
+	struct epoll_event e = { .events = EPOLLIN };
+	struct source *s;
+	int i, ret;
+
+	LOCK(lock);
+	if ((ret = start()) < 0)
+		goto fail;
+	for (i = 0; i < NTO_EVENTS_MAX && src[i].kind != SRC_FREE; i++);
+	if (i == NTO_EVENTS_MAX) {
+		ret = -EAGAIN;
+		goto fail;
+	}
+	s = &src[i];
+	e.data.u64 = (uint64_t)(s->gen + 1) << 32 | i;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, t->fd, &e) < 0) {
+		ret = -errno;
+		goto fail;
+	}
+	*s = *t;
+	s->gen = e.data.u64 >> 32;
+	s->tid = __pthread_self()->tid;
+	if (ev) {
+		s->ev = *ev;
+		if ((ev->sigev_notify & QNX_SIGEV_TYPE_MASK) ==
+			    QNX_SIGEV_PULSE &&
+		    ev->un2.st.priority == QNX_SIGEV_PULSE_PRIO_INHERIT)
+			s->ev.un2.st.priority = __nto_priority();
+	} else if (t->kind == SRC_TIMER) {
+		/* As QNX: SIGALRM carrying the timer id. */
+		s->ev.sigev_notify = QNX_SIGEV_SIGNAL;
+		s->ev.un1.signo = __qnx_signo_from_linux(SIGALRM);
+		s->ev.value.sival_int = i;
+	}
+	uio_ctl(s, 1);
+	UNLOCK(lock);
+	return i;
+fail:
+	UNLOCK(lock);
+	close(t->fd);
+	return ret;
+}
+
+/* Called with lock held. */
+static struct source *get(int id, int kind)
+{
+	if ((unsigned)id >= NTO_EVENTS_MAX || src[id].kind != kind ||
+	    svc_pid != getpid())
+		return 0;
+	return &src[id];
+}
+
+static int destroy(int id, int kind)
+{
+	struct source *s;
+
+	LOCK(lock);
+	if (!(s = get(id, kind))) {
+		UNLOCK(lock);
+		return -EINVAL;
+	}
+	epoll_ctl(epfd, EPOLL_CTL_DEL, s->fd, 0);
+	close(s->fd);
+	s->kind = SRC_FREE;
+	UNLOCK(lock);
+	return 0;
+}
+
+int TimerCreate_r(clockid_t id, const struct nto_event *ev)
+{
+	clockid_t lid = __qnx_clock_to_linux(id);
+	struct source t = { .kind = SRC_TIMER };
+	int ret;
+
+	if (lid == -1)
+		return -EINVAL;
+	if (ev && (ret = __nto_event_check(ev, 0)) < 0)
+		return ret;
+	if ((t.fd = timerfd_create(lid, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+		return -errno;
+	return add(&t, ev);
+}
+
+int TimerCreate(clockid_t id, const struct nto_event *ev)
+{
+	return nto_ret(TimerCreate_r(id, ev));
+}
+
+int TimerDestroy_r(int id)
+{
+	return destroy(id, SRC_TIMER);
+}
+
+int TimerDestroy(int id)
+{
+	return nto_ret(TimerDestroy_r(id));
+}
+
+static int settime(int id, int flags, const struct itimerspec *new,
+		   struct itimerspec *old)
+{
+	struct source *s;
+	int ret = -EINVAL;
+
+	LOCK(lock);
+	if ((s = get(id, SRC_TIMER))) {
+		ret = timerfd_settime(s->fd, flags & QNX_TIMER_ABSTIME ?
+				      TFD_TIMER_ABSTIME : 0, new, old);
+		ret = ret < 0 ? -errno : 0;
+	}
+	UNLOCK(lock);
+	return ret;
+}
+
+static struct timespec ns_to_ts(uint64_t ns)
+{
+	return (struct timespec){ ns / 1000000000, ns % 1000000000 };
+}
+
+static uint64_t ts_to_ns(struct timespec ts)
+{
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int TimerSettime_r(int id, int flags, const struct _itimer *itime,
+		   struct _itimer *oitime)
+{
+	struct itimerspec new, old;
+	int ret;
+
+	new.it_value = ns_to_ts(itime->nsec);
+	new.it_interval = ns_to_ts(itime->interval_nsec);
+	if ((ret = settime(id, flags, &new, &old)) < 0)
+		return ret;
+	if (oitime) {
+		oitime->nsec = ts_to_ns(old.it_value);
+		oitime->interval_nsec = ts_to_ns(old.it_interval);
+	}
+	return 0;
+}
+
+int TimerSettime(int id, int flags, const struct _itimer *itime,
+		 struct _itimer *oitime)
+{
+	return nto_ret(TimerSettime_r(id, flags, itime, oitime));
+}
+
+/* QNX timer_t is an int, so every timer_* call needs its shim. */
+int _qnx_timer_create(clockid_t id, const struct nto_event *ev, int *t)
+{
+	int ret = TimerCreate(id, ev);
+
+	if (ret < 0)
+		return -1;
+	*t = ret;
+	return 0;
+}
+QNX_REDIRECT(timer_create);
+
+int _qnx_timer_delete(int t)
+{
+	return TimerDestroy(t);
+}
+QNX_REDIRECT(timer_delete);
+
+int _qnx_timer_settime(int t, int flags, const struct itimerspec *restrict new,
+		       struct itimerspec *restrict old)
+{
+	return nto_ret(settime(t, flags, new, old));
+}
+QNX_REDIRECT(timer_settime);
+
+int _qnx_timer_gettime(int t, struct itimerspec *cur)
+{
+	struct source *s;
+	int ret = -EINVAL;
+
+	LOCK(lock);
+	if ((s = get(t, SRC_TIMER)))
+		ret = timerfd_gettime(s->fd, cur) < 0 ? -errno : 0;
+	UNLOCK(lock);
+	return nto_ret(ret);
+}
+QNX_REDIRECT(timer_gettime);
+
+int _qnx_timer_getoverrun(int t)
+{
+	struct source *s;
+	int ret = -EINVAL;
+
+	LOCK(lock);
+	if ((s = get(t, SRC_TIMER)))
+		ret = s->overrun;
+	UNLOCK(lock);
+	return nto_ret(ret);
+}
+QNX_REDIRECT(timer_getoverrun);
+
+static int attach(int intr, nto_isr isr, const void *area,
+		  const struct nto_event *ev)
+{
+	struct source t = {
+		.kind = SRC_INTR, .uio = 1, .intr = intr, .isr = isr,
+		.area = (void *)area
+	};
+	char path[32];
+
+	snprintf(path, sizeof path, "/dev/uio%d", intr);
+	if ((t.fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC)) < 0) {
+		t.uio = 0;
+		if ((t.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+			return -errno;
+	}
+	return add(&t, ev);
+}
+
+int InterruptAttachEvent_r(int intr, const struct nto_event *ev,
+			   unsigned flags)
+{
+	int ret;
+
+	(void)flags;
+	if ((ret = __nto_event_check(ev, 1)) < 0)
+		return ret;
+	return attach(intr, 0, 0, ev);
+}
+
+int InterruptAttachEvent(int intr, const struct nto_event *ev, unsigned flags)
+{
+	return nto_ret(InterruptAttachEvent_r(intr, ev, flags));
+}
+
+/* The handler runs on the service thread, not at interrupt level. */
+int InterruptAttach_r(int intr, nto_isr isr, const void *area, int size,
+		      unsigned flags)
+{
+	(void)size;
+	(void)flags;
+	return attach(intr, isr, area, 0);
+}
+
+int InterruptAttach(int intr, nto_isr isr, const void *area, int size,
+		    unsigned flags)
+{
+	return nto_ret(InterruptAttach_r(intr, isr, area, size, flags));
+}
+
+int InterruptDetach_r(int id)
+{
+	return destroy(id, SRC_INTR);
+}
+
+int InterruptDetach(int id)
+{
+	return nto_ret(InterruptDetach_r(id));
+}
+
+/* id -1 names the interrupt by number alone. */
+static struct source *find_intr(int intr, int id)
+{
+	int i;
+
+	if (id != -1)
+		return get(id, SRC_INTR);
+	for (i = 0; i < NTO_EVENTS_MAX; i++)
+		if (get(i, SRC_INTR) && src[i].intr == intr)
+			return &src[i];
+	return 0;
+}
+
+int InterruptMask(int intr, int id)
+{
+	struct source *s;
+	int ret = -EINVAL;
+
+	LOCK(lock);
+	if ((s = find_intr(intr, id))) {
+		if (!s->masked++)
+			uio_ctl(s, 0);
+		ret = s->masked;
+	}
+	UNLOCK(lock);
+	return nto_ret(ret);
+}
+
+int InterruptUnmask(int intr, int id)
+{
+	struct source *s;
+	int ret = -EINVAL;
+
+	LOCK(lock);
+	if ((s = find_intr(intr, id))) {
+		if (s->masked && !--s->masked)
+			uio_ctl(s, 1);
+		ret = s->masked;
+	}
+	UNLOCK(lock);
+	return nto_ret(ret);
+}
+
+/* Any SIGEV_INTR event in the process releases one waiter. */
+int InterruptWait_r(int flags, const uint64_t *timeout)
+{
+	int c, ret;
+
+	(void)flags;
+	(void)timeout;
+	for (;;) {
+		while ((c = intr_count) > 0)
+			if (a_cas(&intr_count, c, c - 1) == c)
+				return 0;
+		if ((ret = __nto_wait(&intr_count, c, 0)) < 0 &&
+		    ret != -ETIMEDOUT)
+			return ret;
+	}
+}
+
+int InterruptWait(int flags, const uint64_t *timeout)
+{
+	return nto_ret(InterruptWait_r(flags, timeout));
+}
+
+#define NOTIFY_ACTION_POLL 0
+#define NOTIFY_ACTION_POLLARM 1
+#define NOTIFY_ACTION_TRANARM 2
+#define NOTIFY_ACTION_CONDARM 3
+#define NOTIFY_ACTION_MASK 0x3
+#define NOTIFY_COND_OBAND 0x80000000u
+#define NOTIFY_COND_OUTPUT 0x40000000u
+#define NOTIFY_COND_INPUT 0x20000000u
+#define NOTIFY_COND_MASK (NOTIFY_COND_OBAND | NOTIFY_COND_OUTPUT | \
+			  NOTIFY_COND_INPUT)
+
+static unsigned cond_events(unsigned cond)
+{
+	return (cond & NOTIFY_COND_INPUT ? POLLIN : 0) |
+	       (cond & NOTIFY_COND_OUTPUT ? POLLOUT : 0) |
+	       (cond & NOTIFY_COND_OBAND ? POLLPRI : 0);
+}
+
+/* An error or hangup meets every condition: the call would not block. */
+static unsigned events_cond(unsigned ev, unsigned want)
+{
+	unsigned c = 0;
+
+	if (ev & (POLLIN | POLLHUP | POLLERR))
+		c |= NOTIFY_COND_INPUT;
+	if (ev & (POLLOUT | POLLHUP | POLLERR))
+		c |= NOTIFY_COND_OUTPUT;
+	if (ev & POLLPRI)
+		c |= NOTIFY_COND_OBAND;
+	return c & want;
+}
+
+/* Arms fd for want, or disarms it for a null ev; returns 0 or -errno. */
+static int arm(int fd, unsigned want, int edge, const struct nto_event *ev)
+{
+	struct epoll_event e;
+	struct note *n;
+	int ret;
+
+	LOCK(lock);
+	if ((ret = start()) < 0)
+		goto out;
+	if (fd >= nnotes) {
+		int sz = nnotes ? nnotes : 64;
+		while (sz <= fd)
+			sz *= 2;
+		if (!(n = realloc(notes, sz * sizeof *n))) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		memset(n + nnotes, 0, (sz - nnotes) * sizeof *n);
+		notes = n;
+		nnotes = sz;
+	}
+	n = &notes[fd];
+	n->armed = 0;
+	e.events = ev ? cond_events(want) | EPOLLONESHOT | (edge ? EPOLLET : 0) : 0;
+	e.data.u64 = (uint64_t)(n->gen + 1) << 32 | NOTE_KEY | fd;
+	/* A closed descriptor left the set with its file; a new one with
+	 * the same number is not in it yet. */
+	if (!n->added || epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &e) < 0) {
+		if (n->added && errno != ENOENT) {
+			ret = -errno;
+			goto out;
+		}
+		n->added = 0;
+		if (ev && epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &e) < 0 &&
+		    (errno != EEXIST || epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &e) < 0)) {
+			ret = -errno;
+			goto out;
+		}
+		n->added = !!ev;
+	}
+	n->gen++;
+	if (ev) {
+		n->ev = *ev;
+		if ((ev->sigev_notify & QNX_SIGEV_TYPE_MASK) == QNX_SIGEV_PULSE &&
+		    ev->un2.st.priority == QNX_SIGEV_PULSE_PRIO_INHERIT)
+			n->ev.un2.st.priority = __nto_priority();
+		n->tid = __pthread_self()->tid;
+		n->armed = 1;
+	}
+out:
+	UNLOCK(lock);
+	return ret;
+}
+
+/*
+ * The conditions met now among those asked for, except with TRANARM,
+ * which arms without looking. POLLARM and CONDARM arm only when none
+ * is met; the event then comes once, when one is, and each later wait
+ * needs its own arm. A null event disarms.
+ */
+int ionotify(int fd, int action, int flags, const struct nto_event *ev)
+{
+	unsigned want = flags & NOTIFY_COND_MASK, met = 0;
+	int act = action & NOTIFY_ACTION_MASK, ret;
+	struct pollfd p = { .fd = fd, .events = cond_events(want) };
+
+	if (fd < 0) {
+		errno = EBADF;
+		return -1;
+	}
+	if (nto_io_fd(fd)) {
+		errno = ENOTSUP;	/* no _IO_NOTIFY to resource managers */
+		return -1;
+	}
+	if (ev && (ret = __nto_event_check(ev, 0)) < 0)
+		return nto_ret(ret);
+	if (act != NOTIFY_ACTION_TRANARM) {
+		if (poll(&p, 1, 0) < 0)
+			return -1;
+		if (p.revents & POLLNVAL) {
+			errno = EBADF;
+			return -1;
+		}
+		met = events_cond(p.revents, want);
+		if (act == NOTIFY_ACTION_POLL || met)
+			return met;
+	}
+	if ((ret = arm(fd, want, act == NOTIFY_ACTION_TRANARM, ev)) < 0)
+		return nto_ret(ret);
+	return 0;
+}
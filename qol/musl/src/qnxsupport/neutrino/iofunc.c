@@ -0,0 +1,328 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "resmgr.h"
+#include "pthread_impl.h"
+
+/*
+ * iofunc_* defaults: the POSIX-ish behaviour a resource manager gets
+ * for every io function it leaves to iofunc_func_init. The attribute
+ * lock is a recursive futex lock in the attr's own lock_tid word, with
+ * ATTR_WAITERS set while someone sleeps on it, so an uncontended
+ * lock/unlock pair is two atomics and no syscall.
+ */
+
+#define QNX_O_NONBLOCK 000200
+#define QNX_O_TRUNC 001000
+
+#define QNX_S_IFDIR 0040000
+
+#define IOFUNC_ATTR_MTIME 0x0002
+#define IOFUNC_ATTR_CTIME 0x0004
+#define IOFUNC_ATTR_ATIME 0x0008
+
+#define ATTR_WAITERS 0x40000000
+
+int iofunc_attr_lock(iofunc_attr_t *attr)
+{
+	int self = __pthread_self()->tid, v;
+
+	if ((attr->lock_tid & ~ATTR_WAITERS) == self) {
+		attr->lock_count++;
+		return EOK;
+	}
+	if (a_cas(&attr->lock_tid, 0, self)) {
+		/* Contended: whoever wins from here on keeps the flag set. */
+		while ((v = a_cas(&attr->lock_tid, 0, self | ATTR_WAITERS))) {
+			if (!(v & ATTR_WAITERS) &&
+			    a_cas(&attr->lock_tid, v, v | ATTR_WAITERS) != v)
+				continue;
+			__futexwait(&attr->lock_tid, v | ATTR_WAITERS, 1);
+		}
+	}
+	attr->lock_count = 1;
+	return EOK;
+}
+
+int iofunc_attr_unlock(iofunc_attr_t *attr)
+{
+	if ((attr->lock_tid & ~ATTR_WAITERS) != __pthread_self()->tid)
+		return EPERM;
+	if (--attr->lock_count)
+		return EOK;
+	if (a_swap(&attr->lock_tid, 0) & ATTR_WAITERS)
+		__wake(&attr->lock_tid, 1, 1);
+	return EOK;
+}
+
+int iofunc_attr_trylock(iofunc_attr_t *attr)
+{
+	int self = __pthread_self()->tid;
+
+	if ((attr->lock_tid & ~ATTR_WAITERS) == self) {
+		attr->lock_count++;
+		return EOK;
+	}
+	if (a_cas(&attr->lock_tid, 0, self))
+		return EBUSY;
+	attr->lock_count = 1;
+	return EOK;
+}
+
+int iofunc_lock_ocb_default(resmgr_context_t *ctp, void *reserved,
+			    iofunc_ocb_t *ocb)
+{
+	(void)ctp, (void)reserved;
+	return ocb && ocb->attr ? iofunc_attr_lock(ocb->attr) : EOK;
+}
+
+int iofunc_unlock_ocb_default(resmgr_context_t *ctp, void *reserved,
+			      iofunc_ocb_t *ocb)
+{
+	(void)ctp, (void)reserved;
+	return ocb && ocb->attr ? iofunc_attr_unlock(ocb->attr) : EOK;
+}
+
+void iofunc_attr_init(iofunc_attr_t *attr, uint32_t mode,
+		      iofunc_attr_t *dattr, void *info)
+{
+	(void)dattr, (void)info;
+	memset(attr, 0, sizeof *attr);
+	attr->mode = mode;
+	attr->nlink = mode & QNX_S_IFDIR ? 2 : 1;
+	attr->uid = getuid();
+	attr->gid = getgid();
+	attr->mtime = attr->atime = attr->ctime = time(0);
+}
+
+void iofunc_time_update(iofunc_attr_t *attr)
+{
+	int64_t now = time(0);
+
+	if (attr->flags & IOFUNC_ATTR_MTIME)
+		attr->mtime = now;
+	if (attr->flags & IOFUNC_ATTR_CTIME)
+		attr->ctime = now;
+	if (attr->flags & IOFUNC_ATTR_ATIME)
+		attr->atime = now;
+	attr->flags &= ~(IOFUNC_ATTR_MTIME | IOFUNC_ATTR_CTIME |
+			 IOFUNC_ATTR_ATIME);
+}
+
+int iofunc_ocb_attach(resmgr_context_t *ctp, io_open_t *msg,
+		      iofunc_ocb_t *ocb, iofunc_attr_t *attr,
+		      const resmgr_io_funcs_t *io)
+{
+	int ioflag = msg->connect.ioflag;
+
+	ocb->attr = attr;
+	ocb->ioflag = ioflag;
+	ocb->offset = 0;
+	attr->count++;
+	if (ioflag & _IO_FLAG_RD)
+		attr->rcount++;
+	if (ioflag & _IO_FLAG_WR) {
+		attr->wcount++;
+		if (ioflag & QNX_O_TRUNC) {
+			attr->nbytes = 0;
+			attr->flags |= IOFUNC_ATTR_MTIME | IOFUNC_ATTR_CTIME;
+		}
+	}
+	return resmgr_open_bind(ctp, ocb, io);
+}
+
+int iofunc_ocb_detach(resmgr_context_t *ctp, iofunc_ocb_t *ocb)
+{
+	iofunc_attr_t *attr = ocb->attr;
+
+	(void)ctp;
+	attr->count--;
+	if (ocb->ioflag & _IO_FLAG_RD)
+		attr->rcount--;
+	if (ocb->ioflag & _IO_FLAG_WR)
+		attr->wcount--;
+	return EOK;
+}
+
+int iofunc_open_default(resmgr_context_t *ctp, io_open_t *msg,
+			iofunc_attr_t *attr, void *extra)
+{
+	iofunc_ocb_t *ocb;
+	int ret;
+
+	(void)extra;
+	if (!(ocb = calloc(1, sizeof *ocb)))
+		return ENOMEM;
+	iofunc_attr_lock(attr);
+	ret = iofunc_ocb_attach(ctp, msg, ocb, attr, 0);
+	iofunc_attr_unlock(attr);
+	if (ret != EOK)
+		free(ocb);
+	return ret;
+}
+
+int iofunc_close_ocb_default(resmgr_context_t *ctp, void *reserved,
+			     iofunc_ocb_t *ocb)
+{
+	iofunc_attr_t *attr = ocb->attr;
+
+	(void)reserved;
+	iofunc_attr_lock(attr);
+	iofunc_ocb_detach(ctp, ocb);
+	iofunc_time_update(attr);
+	iofunc_attr_unlock(attr);
+	free(ocb);
+	return EOK;
+}
+
+int iofunc_close_dup_default(resmgr_context_t *ctp, io_close_t *msg,
+			     iofunc_ocb_t *ocb)
+{
+	(void)ctp, (void)msg, (void)ocb;
+	return EOK;
+}
+
+int iofunc_read_verify(resmgr_context_t *ctp, io_read_t *msg,
+		       iofunc_ocb_t *ocb, int *nonblock)
+{
+	(void)ctp, (void)msg;
+	if (!(ocb->ioflag & _IO_FLAG_RD))
+		return EBADF;
+	if (nonblock)
+		*nonblock = ocb->ioflag & QNX_O_NONBLOCK;
+	return EOK;
+}
+
+int iofunc_write_verify(resmgr_context_t *ctp, io_write_t *msg,
+			iofunc_ocb_t *ocb, int *nonblock)
+{
+	(void)ctp, (void)msg;
+	if (!(ocb->ioflag & _IO_FLAG_WR))
+		return EBADF;
+	if (nonblock)
+		*nonblock = ocb->ioflag & QNX_O_NONBLOCK;
+	return EOK;
+}
+
+/* An empty file: every read is at end of file. */
+int iofunc_read_default(resmgr_context_t *ctp, io_read_t *msg,
+			iofunc_ocb_t *ocb)
+{
+	int ret = iofunc_read_verify(ctp, msg, ocb, 0);
+
+	if (ret != EOK)
+		return ret;
+	ocb->attr->flags |= IOFUNC_ATTR_ATIME;
+	_IO_SET_READ_NBYTES(ctp, 0);
+	return _RESMGR_NPARTS(0);
+}
+
+/* A sink: every byte is accepted and dropped. */
+int iofunc_write_default(resmgr_context_t *ctp, io_write_t *msg,
+			 iofunc_ocb_t *ocb)
+{
+	int ret = iofunc_write_verify(ctp, msg, ocb, 0);
+
+	if (ret != EOK)
+		return ret;
+	ocb->attr->flags |= IOFUNC_ATTR_MTIME | IOFUNC_ATTR_CTIME;
+	_IO_SET_WRITE_NBYTES(ctp, msg->i.nbytes);
+	return _RESMGR_NPARTS(0);
+}
+
+int iofunc_stat(resmgr_context_t *ctp, iofunc_attr_t *attr,
+		struct qnx_stat *st)
+{
+	(void)ctp;
+	iofunc_time_update(attr);
+	memset(st, 0, sizeof *st);
+	st->st_ino = attr->inode;
+	st->st_size = attr->nbytes;
+	st->st_rdev = attr->rdev;
+	st->st_uid = attr->uid;
+	st->st_gid = attr->gid;
+	st->st_mode = attr->mode;
+	st->st_nlink = attr->nlink;
+	st->st_blksize = st->st_blocksize = 512;
+	st->st_blocks = st->st_nblocks = (attr->nbytes + 511) / 512;
+	st->st_mtim.tv_sec = st->__old_st_mtime = attr->mtime;
+	st->st_atim.tv_sec = st->__old_st_atime = attr->atime;
+	st->st_ctim.tv_sec = st->__old_st_ctime = attr->ctime;
+	return EOK;
+}
+
+int iofunc_stat_default(resmgr_context_t *ctp, io_stat_t *msg,
+			iofunc_ocb_t *ocb)
+{
+	iofunc_stat(ctp, ocb->attr, &msg->o);
+	return _RESMGR_PTR(ctp, &msg->o, sizeof msg->o);
+}
+
+int iofunc_lseek_default(resmgr_context_t *ctp, io_lseek_t *msg,
+			 iofunc_ocb_t *ocb)
+{
+	int64_t base, off = msg->i.offset;
+
+	switch (msg->i.whence) {
+	case SEEK_SET:
+		base = 0;
+		break;
+	case SEEK_CUR:
+		base = ocb->offset;
+		break;
+	case SEEK_END:
+		base = ocb->attr->nbytes;
+		break;
+	default:
+		return EINVAL;
+	}
+	if (base + off < 0)
+		return EINVAL;
+	ocb->offset = base + off;
+	msg->o = ocb->offset;
+	return _RESMGR_PTR(ctp, &msg->o, sizeof msg->o);
+}
+
+/* Nothing generic to do; callers fall through to their own commands. */
+int iofunc_devctl_default(resmgr_context_t *ctp, io_devctl_t *msg,
+			  iofunc_ocb_t *ocb)
+{
+	(void)ctp, (void)msg, (void)ocb;
+	return _RESMGR_DEFAULT;
+}
+
+void iofunc_func_init(unsigned nconnect, resmgr_connect_funcs_t *connect,
+		      unsigned nio, resmgr_io_funcs_t *io)
+{
+	if (nconnect > _RESMGR_CONNECT_NFUNCS)
+		nconnect = _RESMGR_CONNECT_NFUNCS;
+	if (nio > _RESMGR_IO_NFUNCS)
+		nio = _RESMGR_IO_NFUNCS;
+	if (connect) {
+		memset(connect, 0, offsetof(resmgr_connect_funcs_t, open) +
+				   nconnect * sizeof(void *));
+		connect->nfuncs = nconnect;
+		if (nconnect >= 1)
+			connect->open = (void *)iofunc_open_default;
+	}
+	if (!io)
+		return;
+	memset(io, 0, offsetof(resmgr_io_funcs_t, read) + nio * sizeof(void *));
+	io->nfuncs = nio;
+#define SET(f, fn) \
+	if (offsetof(resmgr_io_funcs_t, f) < offsetof(resmgr_io_funcs_t, read) + \
+	    io->nfuncs * sizeof(void *)) \
+		io->f = (void *)fn
+	SET(read, iofunc_read_default);
+	SET(write, iofunc_write_default);
+	SET(close_ocb, iofunc_close_ocb_default);
+	SET(stat, iofunc_stat_default);
+	SET(devctl, iofunc_devctl_default);
+	SET(lseek, iofunc_lseek_default);
+	SET(close_dup, iofunc_close_dup_default);
+	SET(lock_ocb, iofunc_lock_ocb_default);
+	SET(unlock_ocb, iofunc_unlock_ocb_default);
+#undef SET
+}
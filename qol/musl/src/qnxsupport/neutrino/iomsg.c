@@ -0,0 +1,207 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include "resmgr.h"
+#include "qnx_redirect.h"
+#include "qnx_errno.h"
+#include "../qnx_fcntl.h"
+
+/*
+ * The client half of resource manager I/O. open() of a path in the
+ * pathname space connects to the server's channel and sends it an
+ * _IO_CONNECT; the returned coid is an fd, and read, write, lseek,
+ * fstat, devctl and close on it become I/O messages, as QNX's libc
+ * does it. __nto_io_fds marks those fds so every other call costs one
+ * byte load.
+ */
+
+#define DEVDIR_TO 0x80000000u
+#define DEVDIR_FROM 0x40000000u
+
+unsigned char __nto_io_fds[NTO_CONN_MAX];
+
+int __nto_io_open(const char *path, int flags, mode_t mode)
+{
+	char buf[offsetof(struct _io_connect, path) + PATH_MAX];
+	struct _io_connect *c = (struct _io_connect *)buf;
+	unsigned file_type;
+	size_t len;
+	pid_t pid;
+	int chid, id, off, coid, err;
+
+	if ((off = __nto_ns_lookup(path, &pid, &chid, &id, &file_type)) < 0)
+		return -2;
+	if ((len = strlen(path + off) + 1) > PATH_MAX) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	if ((coid = ConnectAttach(ND_LOCAL_NODE, pid, chid, 0, 0)) < 0)
+		return -1;
+
+	memset(c, 0, offsetof(struct _io_connect, path));
+	c->type = _IO_CONNECT;
+	c->subtype = _IO_CONNECT_OPEN;
+	c->file_type = file_type;
+	c->handle = id;
+	/* QNX passes the access mode as O_RDONLY 1, O_WRONLY 2, O_RDWR 3 */
+	c->ioflag = (flags & ~3) | ((flags & 3) + 1);
+	c->mode = mode;
+	c->path_len = len;
+	memcpy(c->path, path + off, len);
+	if (MsgSend(coid, c, offsetof(struct _io_connect, path) + len,
+		    0, 0) < 0) {
+		err = errno;
+		ConnectDetach(coid);
+		errno = err;
+		return -1;
+	}
+	__nto_io_fds[coid] = 1;
+	return coid;
+}
+
+ssize_t __nto_io_read(int fd, void *buf, size_t n)
+{
+	struct _io_read m = { _IO_READ, sizeof m };
+
+	m.nbytes = n > UINT32_MAX ? UINT32_MAX : n;
+	return MsgSend(fd, &m, sizeof m, buf, m.nbytes);
+}
+
+ssize_t __nto_io_write(int fd, const void *buf, size_t n)
+{
+	struct _io_write m = { _IO_WRITE, sizeof m };
+	iov_t iov[2];
+
+	m.nbytes = n > UINT32_MAX ? UINT32_MAX : n;
+	iov[0].iov_base = &m;
+	iov[0].iov_len = sizeof m;
+	iov[1].iov_base = (void *)buf;
+	iov[1].iov_len = m.nbytes;
+	return MsgSendv(fd, iov, 2, 0, 0);
+}
+
+off_t __nto_io_lseek(int fd, off_t offset, int whence)
+{
+	struct _io_lseek m = { _IO_LSEEK, sizeof m, whence };
+	uint64_t pos;
+
+	m.offset = offset;
+	if (MsgSend(fd, &m, sizeof m, &pos, sizeof pos) < 0)
+		return -1;
+	return pos;
+}
+
+int __nto_io_fstat(int fd, struct qnx_stat *st)
+{
+	struct _io_stat m = { _IO_STAT, sizeof m };
+
+	return MsgSend(fd, &m, sizeof m, st, sizeof *st) < 0 ? -1 : 0;
+}
+
+int __nto_io_close(int fd)
+{
+	struct _io_close m = { _IO_CLOSE, sizeof m };
+	long r = MsgSend(fd, &m, sizeof m, 0, 0);
+	int err = errno;
+
+	__nto_io_fds[fd] = 0;
+	ConnectDetach(fd);
+	errno = err;
+	return r < 0 ? -1 : 0;
+}
+
+/* Returns a QNX errno value, not -1, as on QNX. Other fds go to the
+ * command table in qdevctl.c. */
+int devctl(int fd, int dcmd, void *data, size_t nbytes, int *info)
+{
+	iov_t v = { data, nbytes };
+
+	if (!nto_io_fd(fd))
+		return __qnx_errno_from_linux(
+			__qnx_devctl(fd, dcmd, data, nbytes, info));
+	return devctlv(fd, dcmd, dcmd & DEVDIR_TO ? 1 : 0,
+		       dcmd & DEVDIR_FROM ? 1 : 0, &v, &v, info);
+}
+
+/* Commands without a server get one flat buffer, as devctl does. */
+static int local_devctlv(int fd, int dcmd, int sparts, int rparts,
+			 const iov_t *sv, const iov_t *rv, size_t n, int *info)
+{
+	unsigned char buf[0x3fff];
+	size_t off;
+	int i, err;
+
+	if (n > sizeof buf)
+		n = sizeof buf;
+	for (i = off = 0; i < sparts && off < n; off += sv[i++].iov_len)
+		memcpy(buf + off, sv[i].iov_base,
+		       sv[i].iov_len < n - off ? sv[i].iov_len : n - off);
+	if ((err = __qnx_devctl(fd, dcmd, buf, n, info)))
+		return __qnx_errno_from_linux(err);
+	for (i = off = 0; i < rparts && off < n; off += rv[i++].iov_len)
+		memcpy(rv[i].iov_base, buf + off,
+		       rv[i].iov_len < n - off ? rv[i].iov_len : n - off);
+	return EOK;
+}
+
+#define DEVCTLV_PARTS 32
+
+int devctlv(int fd, int dcmd, int sparts, int rparts, const iov_t *sv,
+	    const iov_t *rv, int *info)
+{
+	struct _io_devctl m = { _IO_DEVCTL, sizeof m, dcmd };
+	struct _io_devctl_reply o;
+	iov_t s[1 + DEVCTLV_PARTS], r[1 + DEVCTLV_PARTS];
+	size_t slen = 0, rlen = 0;
+	int i;
+
+	if ((unsigned)sparts > DEVCTLV_PARTS ||
+	    (unsigned)rparts > DEVCTLV_PARTS)
+		return EINVAL;
+	for (i = 0; i < sparts; i++)
+		slen += sv[i].iov_len;
+	for (i = 0; i < rparts; i++)
+		rlen += rv[i].iov_len;
+	if (!nto_io_fd(fd))
+		return local_devctlv(fd, dcmd, sparts, rparts, sv, rv,
+				     slen > rlen ? slen : rlen, info);
+
+	m.nbytes = slen > rlen ? slen : rlen;
+	s[0].iov_base = &m;
+	s[0].iov_len = sizeof m;
+	memcpy(s + 1, sv, sparts * sizeof *sv);
+	r[0].iov_base = &o;
+	r[0].iov_len = sizeof o;
+	memcpy(r + 1, rv, rparts * sizeof *rv);
+	if (MsgSendv(fd, s, 1 + sparts, r, 1 + rparts) < 0)
+		return __qnx_errno_from_linux(errno);
+	if (info)
+		*info = o.ret_val;
+	return EOK;
+}
+
+ssize_t _qnx_read(int fd, void *buf, size_t n)
+{
+	if (nto_io_fd(fd))
+		return __nto_io_read(fd, buf, n);
+	return read(fd, buf, n);
+}
+QNX_REDIRECT(read);
+
+ssize_t _qnx_write(int fd, const void *buf, size_t n)
+{
+	if (nto_io_fd(fd))
+		return __nto_io_write(fd, buf, n);
+	return write(fd, buf, n);
+}
+QNX_REDIRECT(write);
+
+off_t _qnx_lseek(int fd, off_t offset, int whence)
+{
+	if (nto_io_fd(fd))
+		return __nto_io_lseek(fd, offset, whence);
+	return lseek(fd, offset, whence);
+}
+QNX_REDIRECT(lseek);
@@ -0,0 +1,740 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "neutrino.h"
+#include "pthread_impl.h"
+
+/*
+ * MsgSend and friends. The sender owns a slot from claim to free; the
+ * receiver only moves it from NTO_SEND to NTO_RECV and, once replied,
+ * to NTO_REPLY. A cross-process sender polls the receiving process for
+ * liveness while it sleeps, since nothing else would wake it if that
+ * process died holding its slot.
+ */
+
+#define NTO_PRIO_DEFAULT 10
+#define NTO_LIVENESS_MS 1000
+#define NTO_SPIN 2000
+
+/* Position in an iov list. */
+struct cur {
+	const struct iovec *v;
+	size_t n, off;
+};
+
+static void cur_init(struct cur *c, const struct iovec *v, size_t n,
+		     size_t skip)
+{
+	c->v = v;
+	c->n = n;
+	c->off = 0;
+	while (c->n && skip >= c->v->iov_len) {
+		skip -= c->v->iov_len;
+		c->v++, c->n--;
+	}
+	c->off = skip;
+}
+
+static void cur_advance(struct cur *c, size_t k)
+{
+	while (c->n && k) {
+		size_t room = c->v->iov_len - c->off;
+		if (k < room) {
+			c->off += k;
+			return;
+		}
+		k -= room;
+		c->v++, c->n--;
+		c->off = 0;
+	}
+	while (c->n && c->v->iov_len == c->off) {
+		c->v++, c->n--;
+		c->off = 0;
+	}
+}
+
+/* Up to max segments covering at most len bytes; returns their total. */
+static size_t cur_take(const struct cur *c, struct iovec *out, int *cnt,
+		       int max, size_t len)
+{
+	size_t total = 0, off = c->off;
+	int k = 0;
+
+	for (size_t i = 0; i < c->n && k < max && total < len; i++, off = 0) {
+		size_t room = c->v[i].iov_len - off;
+		if (!room)
+			continue;
+		if (room > len - total)
+			room = len - total;
+		out[k].iov_base = (char *)c->v[i].iov_base + off;
+		out[k++].iov_len = room;
+		total += room;
+	}
+	*cnt = k;
+	return total;
+}
+
+static size_t iov_total(const struct iovec *v, size_t n)
+{
+	size_t t = 0;
+	while (n--)
+		t += v++->iov_len;
+	return t;
+}
+
+/* Both lists in this address space. */
+static size_t copy_local(struct cur *d, struct cur *s, size_t len)
+{
+	size_t done = 0;
+
+	while (len && d->n && s->n) {
+		size_t k = d->v->iov_len - d->off;
+		size_t sk = s->v->iov_len - s->off;
+		if (k > sk)
+			k = sk;
+		if (k > len)
+			k = len;
+		memcpy((char *)d->v->iov_base + d->off,
+		       (char *)s->v->iov_base + s->off, k);
+		cur_advance(d, k);
+		cur_advance(s, k);
+		done += k;
+		len -= k;
+	}
+	return done;
+}
+
+/* Between a local list and one in process pid; returns -errno. */
+static ssize_t copy_peer(pid_t pid, struct cur *local, struct cur *remote,
+			 size_t len, int write)
+{
+	struct iovec l[16], r[16];
+	size_t done = 0;
+	int ln, rn;
+
+	while (len && local->n && remote->n) {
+		size_t k = cur_take(local, l, &ln, 16, len);
+		size_t rk = cur_take(remote, r, &rn, 16, k);
+		if (rk < k)
+			cur_take(local, l, &ln, 16, rk);
+		ssize_t ret = write ? process_vm_writev(pid, l, ln, r, rn, 0)
+				    : process_vm_readv(pid, l, ln, r, rn, 0);
+		if (ret <= 0)
+			return ret < 0 ? -errno : -EFAULT;
+		cur_advance(local, ret);
+		cur_advance(remote, ret);
+		done += ret;
+		len -= ret;
+	}
+	return done;
+}
+
+/* Copy message bytes [off, off + len) of a received slot into dst. */
+static ssize_t slot_read(struct nto_slot *s, size_t off,
+			 const struct iovec *dst, size_t dn, size_t len)
+{
+	struct cur d, src;
+	size_t done = 0;
+
+	if (off >= s->slen)
+		return 0;
+	if (len > s->slen - off)
+		len = s->slen - off;
+	cur_init(&d, dst, dn, 0);
+
+	if (s->pid == getpid()) {
+		cur_init(&src, s->lsiov, s->nsiov, off);
+		return copy_local(&d, &src, len);
+	}
+	if (off < NTO_INLINE) {
+		struct iovec in = { s->data + off, NTO_INLINE - off };
+		cur_init(&src, &in, 1, 0);
+		done = copy_local(&d, &src, len);
+		if (done == len || !d.n)
+			return done;
+	}
+	cur_init(&src, s->siov, s->nsiov, off + done);
+	ssize_t ret = copy_peer(s->pid, &d, &src, len - done, 0);
+	return ret < 0 ? ret : (ssize_t)(done + ret);
+}
+
+/* Write into the sender's reply buffers at off. */
+static ssize_t slot_write(struct nto_slot *s, size_t off,
+			  const struct iovec *src, size_t sn, size_t len)
+{
+	struct cur d, sc;
+
+	if (off >= s->rlen)
+		return 0;
+	if (len > s->rlen - off)
+		len = s->rlen - off;
+	cur_init(&sc, src, sn, 0);
+	if (s->pid == getpid()) {
+		cur_init(&d, s->lriov, s->nriov, off);
+		return copy_local(&d, &sc, len);
+	}
+	cur_init(&d, s->riov, s->nriov, off);
+	return copy_peer(s->pid, &sc, &d, len, 1);
+}
+
+/*
+ * A round trip is usually shorter than a futex sleep and wake, so
+ * spin briefly for *p to leave val before sleeping; not on a single
+ * CPU, where the peer cannot run while we spin.
+ */
+static int spin(volatile int *p, int val)
+{
+	static int spins = -1;
+
+	if (spins < 0)
+		spins = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? NTO_SPIN : 0;
+	for (int i = 0; i < spins; i++) {
+		if (*p != val)
+			return 1;
+		a_spin();
+	}
+	return 0;
+}
+
+int __nto_priority(void)
+{
+	struct sched_param sp;
+	int policy;
+
+	if (pthread_getschedparam(pthread_self(), &policy, &sp) ||
+	    policy == SCHED_OTHER || !sp.sched_priority)
+		return NTO_PRIO_DEFAULT;
+	return sp.sched_priority;
+}
+
+static int peer_gone(struct nto_chan *ch)
+{
+	return ch->shm->destroyed ||
+	       (ch->pid != getpid() && kill(ch->pid, 0) < 0 && errno == ESRCH);
+}
+
+static struct nto_slot *claim_slot(struct nto_chan *ch)
+{
+	struct nto_chan_shm *shm = ch->shm;
+
+	for (;;) {
+		int seq = shm->free_seq, start = shm->hint;
+		for (int i = 0; i < NTO_SLOTS; i++) {
+			int idx = (start + i) % NTO_SLOTS;
+			struct nto_slot *s = &shm->slot[idx];
+			if (s->state == NTO_FREE &&
+			    a_cas(&s->state, NTO_FREE, NTO_CLAIMED) == NTO_FREE) {
+				shm->hint = (idx + 1) % NTO_SLOTS;
+				return s;
+			}
+		}
+		if (peer_gone(ch))
+			return 0;
+		a_inc(&shm->free_waiters);
+		__nto_wait(&shm->free_seq, seq, NTO_LIVENESS_MS);
+		a_dec(&shm->free_waiters);
+	}
+}
+
+static void free_slot(struct nto_chan_shm *shm, struct nto_slot *s)
+{
+	s->gen++;
+	a_store(&s->state, NTO_FREE);
+	a_inc(&shm->free_seq);
+	if (shm->free_waiters)
+		__nto_wake(&shm->free_seq, 1);
+}
+
+static int send_common(int coid, const iov_t *siov, size_t sparts,
+		       const iov_t *riov, size_t rparts, long *status)
+{
+	struct nto_chan *ch;
+	struct nto_chan_shm *shm;
+	struct nto_slot *s;
+	size_t slen = iov_total(siov, sparts), rlen = iov_total(riov, rparts);
+	int local, st, err;
+
+	if (!(ch = __nto_conn(coid)))
+		return -EBADF;
+	shm = ch->shm;
+	local = ch->pid == getpid();
+	if (slen > UINT32_MAX || rlen > UINT32_MAX ||
+	    sparts > UINT16_MAX || rparts > UINT16_MAX ||
+	    (!local && ((sparts > NTO_IOV_MAX && slen > NTO_INLINE) ||
+			(rparts > NTO_IOV_MAX && rlen > NTO_INLINE)))) {
+		err = -E2BIG;
+		goto out;
+	}
+	if (!(s = claim_slot(ch))) {
+		err = -ESRCH;
+		goto out;
+	}
+
+	s->pid = getpid();
+	s->tid = __pthread_self()->tid;
+	s->coid = coid;
+	s->err = 0;
+	s->status = 0;
+	s->slen = slen;
+	s->rlen = rlen;
+	s->replied = 0;
+	s->priority = __nto_priority();
+	s->nsiov = sparts;
+	s->nriov = rparts;
+	if (local) {
+		s->lsiov = siov;
+		s->lriov = riov;
+	} else {
+		struct iovec in = { s->data, NTO_INLINE };
+		struct cur d, src;
+		/* Longer lists only ever reach the inline bytes. */
+		s->nsiov = sparts <= NTO_IOV_MAX ? sparts : 0;
+		s->nriov = rparts <= NTO_IOV_MAX ? rparts : 0;
+		memcpy(s->siov, siov, s->nsiov * sizeof *siov);
+		memcpy(s->riov, riov, s->nriov * sizeof *riov);
+		cur_init(&d, &in, 1, 0);
+		cur_init(&src, siov, sparts, 0);
+		copy_local(&d, &src, NTO_INLINE);
+	}
+	s->seq = a_fetch_add(&shm->send_seq, 1);
+	a_store(&s->state, NTO_SEND);
+	a_inc(&shm->events);
+	if (shm->waiters)
+		__nto_wake(&shm->events, 1);
+
+	while ((st = s->state) != NTO_REPLY) {
+		if (peer_gone(ch) && (st == NTO_RECV || st == NTO_SEND) &&
+		    a_cas(&s->state, st, NTO_CLAIMED) == st) {
+			free_slot(shm, s);
+			err = -ESRCH;
+			goto out;
+		}
+		if (!spin(&s->state, st))
+			__nto_wait(&s->state, st, local ? 0 : NTO_LIVENESS_MS);
+	}
+
+	if (s->replied) {
+		struct iovec in = { s->data, s->replied };
+		struct cur d, src;
+		cur_init(&d, riov, rparts, 0);
+		cur_init(&src, &in, 1, 0);
+		copy_local(&d, &src, s->replied);
+	}
+	err = -s->err;
+	*status = s->status;
+	free_slot(shm, s);
+out:
+	__nto_chan_put(ch);
+	return err;
+}
+
+long MsgSendv_r(int coid, const iov_t *siov, size_t sparts,
+		const iov_t *riov, size_t rparts)
+{
+	long status;
+	int err = send_common(coid, siov, sparts, riov, rparts, &status);
+	return err ? err : status;
+}
+
+long MsgSendv(int coid, const iov_t *siov, size_t sparts,
+	      const iov_t *riov, size_t rparts)
+{
+	long status;
+	int err = send_common(coid, siov, sparts, riov, rparts, &status);
+	if (err) {
+		errno = -err;
+		return -1;
+	}
+	return status;
+}
+
+long MsgSend_r(int coid, const void *smsg, size_t sbytes, void *rmsg,
+	       size_t rbytes)
+{
+	iov_t s = { (void *)smsg, sbytes }, r = { rmsg, rbytes };
+	return MsgSendv_r(coid, &s, 1, &r, 1);
+}
+
+long MsgSend(int coid, const void *smsg, size_t sbytes, void *rmsg,
+	     size_t rbytes)
+{
+	iov_t s = { (void *)smsg, sbytes }, r = { rmsg, rbytes };
+	return MsgSendv(coid, &s, 1, &r, 1);
+}
+
+long MsgSendsv(int coid, const void *smsg, size_t sbytes, const iov_t *riov,
+	       size_t rparts)
+{
+	iov_t s = { (void *)smsg, sbytes };
+	return MsgSendv(coid, &s, 1, riov, rparts);
+}
+
+long MsgSendvs(int coid, const iov_t *siov, size_t sparts, void *rmsg,
+	       size_t rbytes)
+{
+	iov_t r = { rmsg, rbytes };
+	return MsgSendv(coid, siov, sparts, &r, 1);
+}
+
+/* Cancellation points on QNX; nothing here is, so these are aliases. */
+long MsgSendnc(int coid, const void *smsg, size_t sbytes, void *rmsg,
+	       size_t rbytes)
+{
+	return MsgSend(coid, smsg, sbytes, rmsg, rbytes);
+}
+
+long MsgSendvnc(int coid, const iov_t *siov, size_t sparts,
+		const iov_t *riov, size_t rparts)
+{
+	return MsgSendv(coid, siov, sparts, riov, rparts);
+}
+
+/* Highest priority waiting sender, oldest first within a priority. */
+static int pick_sender(struct nto_chan_shm *shm)
+{
+	int best = -1;
+
+	for (int i = 0; i < NTO_SLOTS; i++) {
+		struct nto_slot *s = &shm->slot[i];
+		if (s->state != NTO_SEND)
+			continue;
+		if (best < 0 || s->priority > shm->slot[best].priority ||
+		    (s->priority == shm->slot[best].priority &&
+		     (int)(s->seq - shm->slot[best].seq) < 0))
+			best = i;
+	}
+	return best;
+}
+
+static void fill_info(struct _msg_info *info, struct nto_chan *ch,
+		      struct nto_slot *s, size_t msglen)
+{
+	memset(info, 0, sizeof *info);
+	info->pid = s->pid;
+	info->tid = s->tid;
+	info->chid = ch->chid;
+	info->scoid = s->pid;
+	info->coid = s->coid;
+	info->priority = s->priority;
+	info->msglen = msglen;
+	info->srcmsglen = s->slen;
+	info->dstmsglen = s->rlen;
+}
+
+static long deliver_pulse(struct nto_chan *ch, const iov_t *riov,
+			  size_t rparts, struct _msg_info *info)
+{
+	struct nto_pulse_cell c;
+	struct _pulse p = { .type = _PULSE_TYPE, .subtype = _PULSE_SUBTYPE };
+	struct iovec in = { &p, sizeof p };
+	struct cur d, src;
+
+	if (__nto_pulse_take(ch, &c) < 0)
+		return -EAGAIN;
+	p.code = c.code;
+	p.value.sival_ptr = (void *)(uintptr_t)c.value;
+	p.scoid = c.pid;
+	cur_init(&d, riov, rparts, 0);
+	cur_init(&src, &in, 1, 0);
+	copy_local(&d, &src, sizeof p);
+	if (info) {
+		memset(info, 0, sizeof *info);
+		info->pid = c.pid;
+		info->chid = ch->chid;
+		info->scoid = c.pid;
+		info->priority = c.priority;
+		info->msglen = info->srcmsglen = sizeof p;
+	}
+	return 0;
+}
+
+/*
+ * Pulses and messages are taken in priority order, a pulse before a
+ * message of the same priority. Returns 0 for a pulse, as QNX does.
+ */
+static long receive(int chid, const iov_t *riov, size_t rparts,
+		    struct _msg_info *info, int pulses_only)
+{
+	struct nto_chan *ch;
+	struct nto_chan_shm *shm;
+	struct nto_slot *s;
+	ssize_t n;
+	long rcvid;
+	int idx, prio;
+
+	if (!(ch = __nto_chan_owned(chid)))
+		return -ESRCH;
+	shm = ch->shm;
+
+	for (;;) {
+		int ev = shm->events;
+		prio = __nto_pulse_peek(ch);
+		idx = pulses_only ? -1 : pick_sender(shm);
+		if (prio >= 0 && (idx < 0 || prio >= shm->slot[idx].priority)) {
+			if (!deliver_pulse(ch, riov, rparts, info)) {
+				__nto_chan_put(ch);
+				return 0;
+			}
+			continue;
+		}
+		if (idx >= 0) {
+			s = &shm->slot[idx];
+			if (a_cas(&s->state, NTO_SEND, NTO_RECV) == NTO_SEND)
+				break;
+			continue;
+		}
+		if (shm->destroyed) {
+			__nto_chan_put(ch);
+			return -ESRCH;
+		}
+		if (spin(&shm->events, ev))
+			continue;
+		a_inc(&shm->waiters);
+		int r = __nto_wait(&shm->events, ev, 0);
+		a_dec(&shm->waiters);
+		if (r == -EINTR) {
+			__nto_chan_put(ch);
+			return -EINTR;
+		}
+	}
+
+	n = slot_read(s, 0, riov, rparts, iov_total(riov, rparts));
+	if (n < 0) {
+		/* The sender gets the fault too, as from the QNX kernel. */
+		s->err = -n;
+		s->status = -1;
+		a_store(&s->state, NTO_REPLY);
+		__nto_wake(&s->state, 1);
+		__nto_chan_put(ch);
+		return n;
+	}
+	if (info)
+		fill_info(info, ch, s, n);
+	rcvid = NTO_RCVID(s->gen, chid, idx);
+	__nto_chan_put(ch);
+	return rcvid;
+}
+
+long MsgReceivev_r(int chid, const iov_t *riov, size_t rparts,
+		   struct _msg_info *info)
+{
+	return receive(chid, riov, rparts, info, 0);
+}
+
+long MsgReceivev(int chid, const iov_t *riov, size_t rparts,
+		 struct _msg_info *info)
+{
+	return nto_ret(MsgReceivev_r(chid, riov, rparts, info));
+}
+
+long MsgReceive_r(int chid, void *msg, size_t bytes, struct _msg_info *info)
+{
+	iov_t r = { msg, bytes };
+	return MsgReceivev_r(chid, &r, 1, info);
+}
+
+long MsgReceive(int chid, void *msg, size_t bytes, struct _msg_info *info)
+{
+	iov_t r = { msg, bytes };
+	return nto_ret(MsgReceivev_r(chid, &r, 1, info));
+}
+
+/* The received slot rcvid names, with a reference on its channel. */
+static struct nto_slot *lookup(long rcvid, struct nto_chan **chp)
+{
+	struct nto_chan *ch;
+	struct nto_slot *s;
+
+	rcvid = (int)rcvid;
+	if (rcvid <= 0 || !(ch = __nto_chan_owned(NTO_RCVID_CHID(rcvid))))
+		return 0;
+	s = &ch->shm->slot[NTO_RCVID_SLOT(rcvid)];
+	if (s->state != NTO_RECV ||
+	    (s->gen & 0x7fff) != (uint32_t)NTO_RCVID_GEN(rcvid)) {
+		__nto_chan_put(ch);
+		return 0;
+	}
+	*chp = ch;
+	return s;
+}
+
+static int reply_common(long rcvid, int err, long status, const iov_t *iov,
+			size_t parts)
+{
+	struct nto_chan *ch;
+	struct nto_slot *s;
+	size_t len = iov_total(iov, parts);
+	int ret = 0;
+
+	if (!(s = lookup(rcvid, &ch)))
+		return -ESRCH;
+	/* Claimed so a second reply to the same rcvid cannot race this. */
+	if (a_cas(&s->state, NTO_RECV, NTO_CLAIMED) != NTO_RECV) {
+		__nto_chan_put(ch);
+		return -ESRCH;
+	}
+	if (len > s->rlen)
+		len = s->rlen;
+	if (len && s->pid != getpid() && len <= NTO_INLINE) {
+		struct iovec in = { s->data, len };
+		struct cur d, src;
+		cur_init(&d, &in, 1, 0);
+		cur_init(&src, iov, parts, 0);
+		copy_local(&d, &src, len);
+		s->replied = len;
+	} else if (len) {
+		ssize_t n = slot_write(s, 0, iov, parts, len);
+		if (n < 0) {
+			ret = n;
+			err = EFAULT;
+		}
+	}
+	s->err = err;
+	s->status = status;
+	a_store(&s->state, NTO_REPLY);
+	__nto_wake(&s->state, 1);
+	__nto_chan_put(ch);
+	return ret;
+}
+
+int MsgReplyv_r(long rcvid, long status, const iov_t *riov, size_t rparts)
+{
+	return reply_common(rcvid, 0, status, riov, rparts);
+}
+
+int MsgReplyv(long rcvid, long status, const iov_t *riov, size_t rparts)
+{
+	return nto_ret(reply_common(rcvid, 0, status, riov, rparts));
+}
+
+int MsgReply_r(long rcvid, long status, const void *msg, size_t bytes)
+{
+	iov_t r = { (void *)msg, bytes };
+	return reply_common(rcvid, 0, status, &r, 1);
+}
+
+int MsgReply(long rcvid, long status, const void *msg, size_t bytes)
+{
+	iov_t r = { (void *)msg, bytes };
+	return nto_ret(reply_common(rcvid, 0, status, &r, 1));
+}
+
+/* MsgError with EOK unblocks the sender with a status of 0. */
+int MsgError_r(long rcvid, int error)
+{
+	return reply_common(rcvid, error, error ? -1 : 0, 0, 0);
+}
+
+int MsgError(long rcvid, int error)
+{
+	return nto_ret(MsgError_r(rcvid, error));
+}
+
+ssize_t MsgReadv_r(long rcvid, const iov_t *riov, size_t rparts,
+		   size_t offset)
+{
+	struct nto_chan *ch;
+	struct nto_slot *s;
+	ssize_t n;
+
+	if (!(s = lookup(rcvid, &ch)))
+		return -ESRCH;
+	n = slot_read(s, offset, riov, rparts, iov_total(riov, rparts));
+	__nto_chan_put(ch);
+	return n;
+}
+
+ssize_t MsgReadv(long rcvid, const iov_t *riov, size_t rparts, size_t offset)
+{
+	return nto_ret(MsgReadv_r(rcvid, riov, rparts, offset));
+}
+
+ssize_t MsgRead_r(long rcvid, void *msg, size_t bytes, size_t offset)
+{
+	iov_t r = { msg, bytes };
+	return MsgReadv_r(rcvid, &r, 1, offset);
+}
+
+ssize_t MsgRead(long rcvid, void *msg, size_t bytes, size_t offset)
+{
+	iov_t r = { msg, bytes };
+	return nto_ret(MsgReadv_r(rcvid, &r, 1, offset));
+}
+
+ssize_t MsgWritev_r(long rcvid, const iov_t *iov, size_t parts,
+		    size_t offset)
+{
+	struct nto_chan *ch;
+	struct nto_slot *s;
+	ssize_t n;
+
+	if (!(s = lookup(rcvid, &ch)))
+		return -ESRCH;
+	n = slot_write(s, offset, iov, parts, iov_total(iov, parts));
+	__nto_chan_put(ch);
+	return n;
+}
+
+ssize_t MsgWritev(long rcvid, const iov_t *iov, size_t parts, size_t offset)
+{
+	return nto_ret(MsgWritev_r(rcvid, iov, parts, offset));
+}
+
+ssize_t MsgWrite_r(long rcvid, const void *msg, size_t bytes, size_t offset)
+{
+	iov_t w = { (void *)msg, bytes };
+	return MsgWritev_r(rcvid, &w, 1, offset);
+}
+
+ssize_t MsgWrite(long rcvid, const void *msg, size_t bytes, size_t offset)
+{
+	iov_t w = { (void *)msg, bytes };
+	return nto_ret(MsgWritev_r(rcvid, &w, 1, offset));
+}
+
+int MsgInfo_r(long rcvid, struct _msg_info *info)
+{
+	struct nto_chan *ch;
+	struct nto_slot *s;
+
+	if (!(s = lookup(rcvid, &ch)))
+		return -ESRCH;
+	fill_info(info, ch, s, s->slen);
+	__nto_chan_put(ch);
+	return 0;
+}
+
+int MsgInfo(long rcvid, struct _msg_info *info)
+{
+	return nto_ret(MsgInfo_r(rcvid, info));
+}
+
+long MsgReceivePulsev_r(int chid, const iov_t *riov, size_t rparts,
+			struct _msg_info *info)
+{
+	return receive(chid, riov, rparts, info, 1);
+}
+
+long MsgReceivePulsev(int chid, const iov_t *riov, size_t rparts,
+		      struct _msg_info *info)
+{
+	return nto_ret(receive(chid, riov, rparts, info, 1));
+}
+
+long MsgReceivePulse_r(int chid, void *pulse, size_t bytes,
+		       struct _msg_info *info)
+{
+	iov_t r = { pulse, bytes };
+	return receive(chid, &r, 1, info, 1);
+}
+
+long MsgReceivePulse(int chid, void *pulse, size_t bytes,
+		     struct _msg_info *info)
+{
+	iov_t r = { pulse, bytes };
+	return nto_ret(receive(chid, &r, 1, info, 1));
+}
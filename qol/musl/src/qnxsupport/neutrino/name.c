@@ -0,0 +1,382 @@
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "resmgr.h"
+#include "pthread_impl.h"
+#include "lock.h"
+
+/*
+ * name_attach and name_open. Names live in a hash table shared by
+ * every QOL process (/dev/shm/qnx-names), open addressed by the name
+ * hash, each entry giving the server's pid and chid. Writers serialise
+ * on a lock word holding the owner's pid, so a writer that died inside
+ * does not wedge the rest, and make the table generation odd while they
+ * change it. Readers take no lock: they retry while the generation is
+ * odd or moved under them.
+ *
+ * Each process caches the names it resolved with the generation they
+ * were found at. While the table is unchanged name_open is one load
+ * and ConnectAttach; a cached server that has died since fails
+ * ConnectAttach and sends the name back through the table.
+ */
+
+#define NAME_PATH "/dev/shm/qnx-names"
+#define NAME_MAGIC 0x4d4e544e		/* "NTNM" */
+#define NAME_VERSION 1
+#define NAME_ENTRIES 1024		/* power of two */
+#define NAME_LEN 128
+#define NAME_CACHE 64			/* power of two */
+
+#define NAME_FLAG_DETACH_SAVEDPP 0x0001
+#define NAME_FLAG_ATTACH_GLOBAL 0x0002
+
+/* An entry goes FREE -> LIVE <-> GONE, so probes stop at FREE only. */
+enum { NAME_FREE, NAME_LIVE, NAME_GONE };
+
+struct name_ent {
+	volatile int state;
+	uint32_t hash;
+	pid_t pid;
+	int chid;
+	char name[NAME_LEN];
+};
+
+struct name_table {
+	volatile int magic;
+	uint32_t version;
+	volatile int lock;		/* writer's pid, 0 when free */
+	volatile int gen;		/* odd while a writer changes entries */
+	struct name_ent ent[NAME_ENTRIES];
+};
+
+typedef struct _name_attach {
+	dispatch_t *dpp;
+	int chid;
+	int mntid;
+	int zero[2];
+} name_attach_t;
+
+int name_detach(name_attach_t *, unsigned);
+
+struct name_cached {
+	int gen;
+	uint32_t hash;
+	pid_t pid;
+	int chid;
+	char name[NAME_LEN];
+};
+
+static struct name_table *names;
+static volatile int lock[1];
+static struct name_cached cache[NAME_CACHE];
+static name_attach_t *attached[NAME_ENTRIES];
+static int exit_hooked;
+
+static struct name_table *name_map(void)
+{
+	struct name_table *t;
+	struct stat st;
+	int fd;
+
+	if (names)
+		return names;
+	LOCK(lock);
+	if (names)
+		goto out;
+	fd = open(NAME_PATH, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+	if (fd < 0)
+		goto out;
+	if (fstat(fd, &st) < 0 ||
+	    (st.st_size < (off_t)sizeof *t && ftruncate(fd, sizeof *t) < 0)) {
+		close(fd);
+		goto out;
+	}
+	t = mmap(0, sizeof *t, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (t == MAP_FAILED)
+		goto out;
+	/* The creator stores the version before the magic. */
+	if (t->magic != NAME_MAGIC &&
+	    a_cas(&t->magic, 0, -1) == 0) {
+		t->version = NAME_VERSION;
+		a_store(&t->magic, NAME_MAGIC);
+	}
+	while (t->magic == -1)
+		__nto_wait(&t->magic, -1, 1);
+	if (t->magic != NAME_MAGIC || t->version != NAME_VERSION) {
+		munmap(t, sizeof *t);
+		errno = EINVAL;
+		goto out;
+	}
+	names = t;
+out:
+	UNLOCK(lock);
+	return names;
+}
+
+static int dead(pid_t pid)
+{
+	return kill(pid, 0) < 0 && errno == ESRCH;
+}
+
+static void table_lock(struct name_table *t)
+{
+	int self = getpid(), owner;
+
+	while ((owner = a_cas(&t->lock, 0, self))) {
+		if (dead(owner) && a_cas(&t->lock, owner, self) == owner) {
+			/* Its update was cut short: end it for readers. */
+			if (t->gen & 1)
+				a_inc(&t->gen);
+			break;
+		}
+		__nto_wait(&t->lock, owner, 10);
+	}
+	a_inc(&t->gen);
+}
+
+static void table_unlock(struct name_table *t)
+{
+	a_inc(&t->gen);
+	a_store(&t->lock, 0);
+	__nto_wake(&t->lock, 1);
+}
+
+static uint32_t name_hash(const char *s)
+{
+	uint32_t h = 2166136261u;
+
+	while (*s)
+		h = (h ^ (unsigned char)*s++) * 16777619u;
+	return h;
+}
+
+/* QNX also takes the name's full path under /dev/name. */
+static const char *name_key(const char *path)
+{
+	static const char *const dirs[] = {
+		"/dev/name/local/", "/dev/name/global/"
+	};
+
+	for (int i = 0; i < 2; i++)
+		if (!strncmp(path, dirs[i], strlen(dirs[i])))
+			return path + strlen(dirs[i]);
+	return path;
+}
+
+/* Slot of a live name, -1 if none; called with the lock or in a retry loop. */
+static int find(struct name_table *t, const char *name, uint32_t h)
+{
+	for (unsigned i = 0; i < NAME_ENTRIES; i++) {
+		unsigned slot = (h + i) & (NAME_ENTRIES - 1);
+		struct name_ent *e = &t->ent[slot];
+		int st = e->state;
+		if (st == NAME_FREE)
+			break;
+		if (st == NAME_LIVE && e->hash == h &&
+		    !strncmp(e->name, name, NAME_LEN))
+			return slot;
+	}
+	return -1;
+}
+
+static void detach_all(void)
+{
+	for (int i = 0; i < NAME_ENTRIES; i++)
+		if (attached[i])
+			name_detach(attached[i], NAME_FLAG_DETACH_SAVEDPP);
+}
+
+static int name_register(const char *name, int chid)
+{
+	struct name_table *t;
+	uint32_t h = name_hash(name);
+	pid_t self = getpid();
+	int slot, hole = -1;
+
+	if (!(t = name_map()))
+		return -errno;
+	table_lock(t);
+	if ((slot = find(t, name, h)) >= 0) {
+		if (!dead(t->ent[slot].pid)) {
+			table_unlock(t);
+			return -EEXIST;
+		}
+		hole = slot;
+	} else {
+		for (unsigned i = 0; i < NAME_ENTRIES && hole < 0; i++) {
+			unsigned s = (h + i) & (NAME_ENTRIES - 1);
+			if (t->ent[s].state != NAME_LIVE)
+				hole = s;
+		}
+	}
+	if (hole >= 0) {
+		struct name_ent *e = &t->ent[hole];
+		e->state = NAME_GONE;
+		e->hash = h;
+		e->pid = self;
+		e->chid = chid;
+		strncpy(e->name, name, NAME_LEN);
+		a_store(&e->state, NAME_LIVE);
+	}
+	table_unlock(t);
+	return hole >= 0 ? hole : -ENOSPC;
+}
+
+static void name_unregister(int slot, int chid)
+{
+	struct name_table *t = names;
+	struct name_ent *e = &t->ent[slot];
+
+	table_lock(t);
+	if (e->state == NAME_LIVE && e->pid == getpid() && e->chid == chid)
+		a_store(&e->state, NAME_GONE);
+	table_unlock(t);
+}
+
+name_attach_t *name_attach(dispatch_t *dpp, const char *path, unsigned flags)
+{
+	const char *name = name_key(path);
+	name_attach_t *a;
+	dispatch_t *own = 0;
+	int chid, slot;
+
+	(void)flags;	/* one node: local and global names are one table */
+	if (!*name || *name == '/' || strlen(name) >= NAME_LEN) {
+		errno = EINVAL;
+		return 0;
+	}
+	if (!(a = calloc(1, sizeof *a)))
+		return 0;
+	if (!dpp) {
+		if ((chid = ChannelCreate(_NTO_CHF_DISCONNECT |
+					  _NTO_CHF_COID_DISCONNECT |
+					  _NTO_CHF_UNBLOCK)) < 0 ||
+		    !(own = dispatch_create_channel(chid, DISPATCH_FLAG_NOLOCK))) {
+			if (chid >= 0)
+				ChannelDestroy(chid);
+			free(a);
+			return 0;
+		}
+		dpp = own;
+	}
+	a->dpp = dpp;
+	a->chid = __nto_dispatch_chid(dpp);
+	if ((slot = name_register(name, a->chid)) < 0) {
+		if (own)
+			dispatch_destroy(own);
+		free(a);
+		errno = -slot;
+		return 0;
+	}
+	a->mntid = slot;
+	LOCK(lock);
+	attached[slot] = a;
+	if (!exit_hooked)
+		exit_hooked = !atexit(detach_all);
+	UNLOCK(lock);
+	return a;
+}
+
+int name_detach(name_attach_t *a, unsigned flags)
+{
+	int mine;
+
+	if (!a || (unsigned)a->mntid >= NAME_ENTRIES) {
+		errno = EINVAL;
+		return -1;
+	}
+	LOCK(lock);
+	if ((mine = attached[a->mntid] == a))
+		attached[a->mntid] = 0;
+	UNLOCK(lock);
+	if (!mine) {
+		errno = EINVAL;
+		return -1;
+	}
+	name_unregister(a->mntid, a->chid);
+	if (!(flags & NAME_FLAG_DETACH_SAVEDPP))
+		dispatch_destroy(a->dpp);
+	free(a);
+	return 0;
+}
+
+/* The server of name: from the cache while the table is unchanged. */
+static int resolve(const char *name, uint32_t h, int fresh, pid_t *pid,
+		   int *chid)
+{
+	struct name_table *t;
+	struct name_cached *c = &cache[h & (NAME_CACHE - 1)];
+	int gen, slot, owner;
+
+	if (!(t = name_map()))
+		return 0;
+	gen = t->gen;
+	LOCK(lock);
+	if (!fresh && !(gen & 1) && c->gen == gen && c->hash == h &&
+	    !strncmp(c->name, name, NAME_LEN)) {
+		*pid = c->pid;
+		*chid = c->chid;
+		UNLOCK(lock);
+		return 1;
+	}
+	UNLOCK(lock);
+
+	for (;;) {
+		while ((gen = t->gen) & 1) {
+			if ((owner = t->lock) && dead(owner)) {
+				table_lock(t);
+				table_unlock(t);
+				continue;
+			}
+			__nto_wait(&t->gen, gen, 1);
+		}
+		if ((slot = find(t, name, h)) >= 0) {
+			*pid = t->ent[slot].pid;
+			*chid = t->ent[slot].chid;
+		}
+		if (t->gen == gen)
+			break;
+	}
+	if (slot < 0 || dead(*pid))
+		return 0;
+	LOCK(lock);
+	c->gen = gen;
+	c->hash = h;
+	c->pid = *pid;
+	c->chid = *chid;
+	strncpy(c->name, name, NAME_LEN);
+	UNLOCK(lock);
+	return 1;
+}
+
+int name_open(const char *path, int flags)
+{
+	const char *name = name_key(path);
+	uint32_t h = name_hash(name);
+	pid_t pid;
+	int chid, coid;
+
+	(void)flags;
+	if (strlen(name) >= NAME_LEN) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	for (int fresh = 0; fresh < 2; fresh++) {
+		if (!resolve(name, h, fresh, &pid, &chid))
+			break;
+		if ((coid = ConnectAttach(ND_LOCAL_NODE, pid, chid, 0, 0)) >= 0)
+			return coid;
+	}
+	errno = ENOENT;
+	return -1;
+}
+
+int name_close(int coid)
+{
+	return ConnectDetach(coid);
+}
@@ -0,0 +1,192 @@
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "resmgr.h"
+#include "pthread_impl.h"
+#include "lock.h"
+
+/*
+ * Pathname space. resmgr_attach registers a path in a table shared by
+ * every QOL process (/dev/shm/qnx-ns), mapping it to the server's pid,
+ * chid and attach id; open() looks paths up there before falling back
+ * to the Linux filesystem. Entries are claimed by CAS on their state,
+ * and entries of dead servers are reused. A process that has never
+ * seen the table retries mapping it at most once a second, so plain
+ * programs pay one clock read per open.
+ */
+
+#define NS_PATH "/dev/shm/qnx-ns"
+#define NS_MAGIC 0x534e544e		/* "NTNS" */
+#define NS_ENTRIES 64
+#define NS_PATH_MAX 256
+
+enum { NS_FREE, NS_BUSY, NS_LIVE };
+
+struct ns_ent {
+	volatile int state;
+	pid_t pid;
+	int chid;
+	int id;
+	unsigned flags;
+	unsigned file_type;
+	char path[NS_PATH_MAX];
+};
+
+struct ns_table {
+	volatile int magic;
+	volatile int live;
+	struct ns_ent ent[NS_ENTRIES];
+};
+
+static struct ns_table *ns;
+static volatile int lock[1];
+static time_t ns_retry;
+static int exit_hooked;
+
+static struct ns_table *ns_map(int create)
+{
+	struct ns_table *t;
+	struct timespec now;
+	int fd;
+
+	if (ns)
+		return ns;
+	if (!create) {
+		clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+		if (now.tv_sec < ns_retry)
+			return 0;
+		ns_retry = now.tv_sec + 1;
+	}
+	LOCK(lock);
+	if (ns)
+		goto out;
+	fd = open(NS_PATH, O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0666);
+	if (fd < 0)
+		goto out;
+	/* Growing an existing table is harmless, shrinking never happens. */
+	if (create && ftruncate(fd, sizeof *t) < 0) {
+		close(fd);
+		goto out;
+	}
+	t = mmap(0, sizeof *t, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (t == MAP_FAILED)
+		goto out;
+	if (t->magic != NS_MAGIC && !(create &&
+	    (a_cas(&t->magic, 0, NS_MAGIC) == 0 || t->magic == NS_MAGIC))) {
+		munmap(t, sizeof *t);
+		goto out;
+	}
+	ns = t;
+out:
+	UNLOCK(lock);
+	return ns;
+}
+
+static int dead(struct ns_ent *e)
+{
+	return kill(e->pid, 0) < 0 && errno == ESRCH;
+}
+
+static void detach_all(void)
+{
+	pid_t self = getpid();
+
+	for (int i = 0; i < NS_ENTRIES; i++)
+		if (ns->ent[i].state == NS_LIVE && ns->ent[i].pid == self)
+			__nto_ns_detach(i);
+}
+
+int __nto_ns_attach(const char *path, int chid, int id, unsigned flags,
+		    unsigned file_type)
+{
+	struct ns_table *t;
+	size_t len = strlen(path);
+
+	if (path[0] != '/' || len >= NS_PATH_MAX)
+		return -EINVAL;
+	if (!(t = ns_map(1)))
+		return -errno;
+	while (len > 1 && path[len - 1] == '/')
+		len--;
+
+	for (int i = 0; i < NS_ENTRIES; i++) {
+		struct ns_ent *e = &t->ent[i];
+		int st = e->state;
+		if ((st == NS_FREE || (st == NS_LIVE && dead(e))) &&
+		    a_cas(&e->state, st, NS_BUSY) == st) {
+			if (st == NS_LIVE)
+				a_dec(&t->live);
+			e->pid = getpid();
+			e->chid = chid;
+			e->id = id;
+			e->flags = flags;
+			e->file_type = file_type;
+			memcpy(e->path, path, len);
+			e->path[len] = 0;
+			a_inc(&t->live);
+			a_store(&e->state, NS_LIVE);
+			LOCK(lock);
+			if (!exit_hooked)
+				exit_hooked = !atexit(detach_all);
+			UNLOCK(lock);
+			return i;
+		}
+	}
+	return -ENOSPC;
+}
+
+void __nto_ns_detach(int slot)
+{
+	struct ns_ent *e = &ns->ent[slot];
+
+	if (a_cas(&e->state, NS_LIVE, NS_BUSY) == NS_LIVE) {
+		a_dec(&ns->live);
+		a_store(&e->state, NS_FREE);
+	}
+}
+
+/*
+ * Longest registered prefix of path: exact for plain attaches, path
+ * components below it too for _RESMGR_FLAG_DIR ones.
+ */
+int __nto_ns_lookup(const char *path, pid_t *pid, int *chid, int *id,
+		    unsigned *file_type)
+{
+	struct ns_table *t;
+	size_t best = 0;
+	int found = -1;
+
+	if (path[0] != '/' || !(t = ns_map(0)) || !t->live)
+		return -1;
+	for (int i = 0; i < NS_ENTRIES; i++) {
+		struct ns_ent *e = &t->ent[i];
+		size_t len;
+		if (e->state != NS_LIVE)
+			continue;
+		len = strlen(e->path);
+		if (len <= best || strncmp(path, e->path, len))
+			continue;
+		if (path[len] && !(path[len] == '/' && (e->flags & _RESMGR_FLAG_DIR)) &&
+		    !(len == 1 && (e->flags & _RESMGR_FLAG_DIR)))
+			continue;
+		if (dead(e))
+			continue;
+		*pid = e->pid;
+		*chid = e->chid;
+		*id = e->id;
+		*file_type = e->file_type;
+		best = len;
+		found = i;
+	}
+	if (found < 0)
+		return -1;
+	while (path[best] == '/')
+		best++;
+	return best;
+}
@@ -0,0 +1,279 @@
+#ifndef QNX_NEUTRINO_H
+#define QNX_NEUTRINO_H
+
+#include <features.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/*
+ * Neutrino message passing emulation, see channel.c and msg.c.
+ *
+ * A channel is a file under /dev/shm (qnx-ch.<pid>.<chid>) holding a
+ * header and a fixed array of send slots. A sender claims a free slot,
+ * describes its message there and sleeps on the slot's state word; a
+ * receiver takes the slot, copies the message straight out of the
+ * sender's buffers and, on reply, writes straight into them. Only the
+ * state words are shared futexes, there is no broker process.
+ *
+ * Buffers are reached with memcpy when both sides are one process and
+ * with process_vm_readv/writev otherwise. The first NTO_INLINE bytes of
+ * a cross-process message, and a reply of at most that size, also
+ * travel through the slot, so small messages work without ptrace
+ * access to the peer.
+ */
+
+typedef struct iovec iov_t;
+
+#define NTO_MAGIC 0x4843544e		/* "NTCH" */
+#define NTO_VERSION 2
+
+#define NTO_SLOTS 64			/* must stay <= 64, see rcvid */
+#define NTO_INLINE 4096
+#define NTO_IOV_MAX 8
+#define NTO_CHID_MAX 1024
+#define NTO_CONN_MAX 1024		/* fd coids below this */
+#define NTO_PULSES 1024			/* power of two */
+
+#define NTO_PATH "/dev/shm/qnx-ch."
+
+/* ChannelCreate/ConnectAttach flags */
+#define _NTO_CHF_FIXED_PRIORITY 0x0001
+#define _NTO_CHF_UNBLOCK 0x0002
+#define _NTO_CHF_THREAD_DEATH 0x0004
+#define _NTO_CHF_DISCONNECT 0x0008
+#define _NTO_CHF_NET_MSG 0x0010
+#define _NTO_CHF_SENDER_LEN 0x0020
+#define _NTO_CHF_COID_DISCONNECT 0x0040
+#define _NTO_CHF_REPLY_LEN 0x0080
+#define _NTO_CHF_PRIVATE 0x0800
+
+#define _NTO_COF_CLOEXEC 0x0001
+#define _NTO_SIDE_CHANNEL 0x40000000
+
+#define ND_LOCAL_NODE 0
+
+#define EOK 0
+
+/* Slot states */
+enum {
+	NTO_FREE,
+	NTO_CLAIMED,	/* a sender is filling it in */
+	NTO_SEND,	/* waiting for MsgReceive */
+	NTO_RECV,	/* received, waiting for MsgReply */
+	NTO_REPLY,	/* replied, sender copies out and frees it */
+};
+
+struct nto_slot {
+	volatile int state;
+	uint32_t gen;
+	pid_t pid;
+	int tid;
+	int coid;
+	int err;			/* MsgError value, 0 on MsgReply */
+	long status;
+	uint32_t slen;			/* total send bytes */
+	uint32_t rlen;			/* total reply buffer bytes */
+	uint32_t replied;		/* reply bytes left in data[] */
+	uint32_t seq;			/* send order, FIFO within a priority */
+	int16_t priority;
+	uint16_t nsiov, nriov;
+	/* The sender's own arrays when both sides are one process, else a
+	 * copy of them (pointing into the sender's address space). */
+	const struct iovec *lsiov, *lriov;
+	struct iovec siov[NTO_IOV_MAX];
+	struct iovec riov[NTO_IOV_MAX];
+	char data[NTO_INLINE];
+};
+
+/*
+ * Pulse queue cell: seq is the bounded MPSC ring protocol word (equal
+ * to the position when free for it, position + 1 once written).
+ */
+struct nto_pulse_cell {
+	volatile uint32_t seq;
+	int16_t priority;
+	int8_t code;
+	pid_t pid;
+	uint64_t value;
+};
+
+struct nto_chan_shm {
+	uint32_t magic, version;
+	pid_t pid;
+	int chid;
+	unsigned flags;
+	volatile int events;		/* bumped per send, receivers wait here */
+	volatile int waiters;		/* receivers blocked on events */
+	volatile int free_seq;		/* bumped when a slot is freed */
+	volatile int free_waiters;
+	volatile int destroyed;
+	volatile int hint;		/* where the next free slot scan starts */
+	volatile int send_seq;
+	volatile uint32_t pulse_tail;	/* producers claim here */
+	volatile uint32_t pulse_head;	/* owner only */
+	struct nto_slot slot[NTO_SLOTS];
+	struct nto_pulse_cell pulse[NTO_PULSES];
+};
+
+/* What a connection or the owning process maps; see channel.c */
+struct nto_chan {
+	struct nto_chan_shm *shm;
+	pid_t pid;
+	int chid;
+	int refs;
+	volatile int plock[1];
+	struct nto_pulse_heap *pq;	/* owner only, see pulse.c */
+};
+
+struct _pulse {
+	uint16_t type;
+	uint16_t subtype;
+	int8_t code;
+	uint8_t zero[3];
+	union {
+		int sival_int;
+		void *sival_ptr;
+	} value;
+	int32_t scoid;
+};
+
+#define _PULSE_TYPE 0
+#define _PULSE_SUBTYPE 0
+
+struct _msg_info {
+	uint32_t nd;
+	uint32_t srcnd;
+	pid_t pid;
+	int32_t tid;
+	int32_t chid;
+	int32_t scoid;
+	int32_t coid;
+	int16_t priority;
+	int16_t flags;
+	int32_t msglen;
+	int32_t srcmsglen;
+	int32_t dstmsglen;
+	uint32_t reserved;
+};
+
+/*
+ * rcvid layout: slot generation in bits 16-30, chid in bits 6-15,
+ * slot in bits 0-5. It stays below 2^31 so callers that keep it in an
+ * int, as QNX 7.0 code does, get it back intact.
+ */
+#define NTO_RCVID(gen, chid, slot) \
+	((long)(((gen) & 0x7fff) << 16 | (chid) << 6 | (slot)))
+#define NTO_RCVID_GEN(r) (((r) >> 16) & 0x7fff)
+#define NTO_RCVID_CHID(r) (((r) >> 6) & 0x3ff)
+#define NTO_RCVID_SLOT(r) ((r) & 0x3f)
+
+#define QNX_SIGEV_NONE 0
+#define QNX_SIGEV_SIGNAL 1
+#define QNX_SIGEV_SIGNAL_CODE 2
+#define QNX_SIGEV_SIGNAL_THREAD 3
+#define QNX_SIGEV_PULSE 4
+#define QNX_SIGEV_UNBLOCK 5
+#define QNX_SIGEV_INTR 6
+#define QNX_SIGEV_THREAD 7
+#define QNX_SIGEV_TYPE_MASK 0xff
+
+#define QNX_SIGEV_PULSE_PRIO_INHERIT (-1)
+#define QNX_TIMER_ABSTIME 0x80000000
+
+/* QNX struct sigevent */
+struct nto_event {
+	int sigev_notify;
+	union {
+		int signo;
+		int coid;
+		int id;
+		void (*fn)(union sigval);
+	} un1;
+	union sigval value;
+	union {
+		struct {
+			short code;
+			short priority;
+		} st;
+		void *attr;
+	} un2;
+};
+
+int ChannelCreate(unsigned);
+int ChannelDestroy(int);
+int ConnectAttach(uint32_t, pid_t, int, unsigned, int);
+int ConnectDetach(int);
+long MsgSend(int, const void *, size_t, void *, size_t);
+long MsgSendv(int, const iov_t *, size_t, const iov_t *, size_t);
+long MsgReceive(int, void *, size_t, struct _msg_info *);
+int MsgReply(long, long, const void *, size_t);
+int MsgReplyv(long, long, const iov_t *, size_t);
+int MsgError(long, int);
+ssize_t MsgRead(long, void *, size_t, size_t);
+ssize_t MsgReadv(long, const iov_t *, size_t, size_t);
+ssize_t MsgWrite(long, const void *, size_t, size_t);
+int MsgSendPulse(int, int, int, int);
+int MsgSendPulsePtr_r(int, int, int, void *);
+int devctl(int, int, void *, size_t, int *);
+int devctlv(int, int, int, int, const iov_t *, const iov_t *, int *);
+
+/* Process-local channel and connection tables, see channel.c. Both
+ * lookups take a reference that __nto_chan_put drops. */
+hidden struct nto_chan *__nto_chan_owned(int chid);
+hidden struct nto_chan *__nto_conn(int coid);
+hidden void __nto_chan_put(struct nto_chan *);
+
+/* Queued pulses for the owner of ch, see pulse.c. __nto_pulse_peek
+ * returns the best queued priority or -1; __nto_pulse_take returns 0
+ * or -EAGAIN when another thread got there first. */
+hidden int __nto_pulse_peek(struct nto_chan *);
+hidden int __nto_pulse_take(struct nto_chan *, struct nto_pulse_cell *);
+
+/* Sending an event from any thread of the process that registered it,
+ * see event.c: code is the si_code a signal gets. __nto_event_check
+ * returns 0 or -EINVAL, intr saying whether SIGEV_INTR is allowed. */
+hidden void __nto_event_deliver(const struct nto_event *, pid_t, int);
+hidden int __nto_event_check(const struct nto_event *, int);
+
+/* The calling thread's priority as QNX would report it, see msg.c */
+hidden int __nto_priority(void);
+
+/*
+ * Client side of resource manager I/O, see iomsg.c. The QNX file
+ * shims hand an fd to the __nto_io_* call when nto_io_fd says it is a
+ * connection opened through the pathname space; __nto_io_open returns
+ * -2 for a path no resource manager has registered.
+ */
+struct qnx_stat;
+extern hidden unsigned char __nto_io_fds[NTO_CONN_MAX];
+hidden int __nto_io_open(const char *, int, mode_t);
+hidden ssize_t __nto_io_read(int, void *, size_t);
+hidden ssize_t __nto_io_write(int, const void *, size_t);
+hidden off_t __nto_io_lseek(int, off_t, int);
+hidden int __nto_io_close(int);
+hidden int __nto_io_fstat(int, struct qnx_stat *);
+
+static inline int nto_io_fd(int fd)
+{
+	return (unsigned)fd < NTO_CONN_MAX && __nto_io_fds[fd];
+}
+
+/* Shared futex wait, relative timeout in ms (0 = none); returns -errno */
+hidden int __nto_wait(volatile int *, int, int);
+hidden void __nto_wake(volatile int *, int);
+
+/* The kernel calls are written as their _r form, returning -errno;
+ * the plain entry point goes through this. */
+static inline long nto_ret(long ret)
+{
+	if (ret < 0) {
+		errno = -ret;
+		return -1;
+	}
+	return ret;
+}
+
+#endif
@@ -0,0 +1,191 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include "neutrino.h"
+#include "pthread_impl.h"
+#include "lock.h"
+
+/*
+ * Pulses. Senders, in any process, append to the channel's bounded
+ * MPSC ring with one CAS on pulse_tail and publish the cell through
+ * its seq word, then bump the channel's events futex: no lock and at
+ * most one wake per pulse. The owning process is the single consumer.
+ * A receiving thread moves every published cell into a process-local
+ * heap under plock and takes the best one, so delivery follows QNX
+ * order (higher priority first, FIFO within a priority) even though
+ * the ring itself is FIFO.
+ */
+
+#define MASK (NTO_PULSES - 1)
+
+struct nto_pulse_heap {
+	int n;
+	struct nto_pulse_cell e[NTO_PULSES];	/* seq holds the ring position */
+};
+
+static int before(const struct nto_pulse_cell *a,
+		  const struct nto_pulse_cell *b)
+{
+	if (a->priority != b->priority)
+		return a->priority > b->priority;
+	return (int32_t)(a->seq - b->seq) < 0;
+}
+
+static void heap_push(struct nto_pulse_heap *h, const struct nto_pulse_cell *c)
+{
+	int i = h->n++;
+
+	while (i) {
+		int up = (i - 1) / 2;
+		if (!before(c, &h->e[up]))
+			break;
+		h->e[i] = h->e[up];
+		i = up;
+	}
+	h->e[i] = *c;
+}
+
+static void heap_pop(struct nto_pulse_heap *h, struct nto_pulse_cell *out)
+{
+	struct nto_pulse_cell last = h->e[--h->n];
+	int i = 0;
+
+	*out = h->e[0];
+	for (;;) {
+		int k = 2 * i + 1;
+		if (k >= h->n)
+			break;
+		if (k + 1 < h->n && before(&h->e[k + 1], &h->e[k]))
+			k++;
+		if (!before(&h->e[k], &last))
+			break;
+		h->e[i] = h->e[k];
+		i = k;
+	}
+	h->e[i] = last;
+}
+
+/* Called with plock held. */
+static void drain(struct nto_chan *ch)
+{
+	struct nto_chan_shm *shm = ch->shm;
+	struct nto_pulse_heap *h = ch->pq;
+	uint32_t pos = shm->pulse_head;
+
+	while (h->n < NTO_PULSES) {
+		struct nto_pulse_cell *c = &shm->pulse[pos & MASK], t;
+		if (c->seq != pos + 1)
+			break;
+		t = *c;
+		t.seq = pos;
+		heap_push(h, &t);
+		a_store((volatile int *)&c->seq, pos + NTO_PULSES);
+		pos++;
+	}
+	shm->pulse_head = pos;
+}
+
+static int ring_empty(struct nto_chan *ch)
+{
+	uint32_t pos = ch->shm->pulse_head;
+	return ch->shm->pulse[pos & MASK].seq != pos + 1;
+}
+
+int __nto_pulse_peek(struct nto_chan *ch)
+{
+	int prio = -1;
+
+	if ((!ch->pq || !ch->pq->n) && ring_empty(ch))
+		return -1;
+	LOCK(ch->plock);
+	if (!ch->pq)
+		ch->pq = calloc(1, sizeof *ch->pq);
+	if (ch->pq) {
+		drain(ch);
+		if (ch->pq->n)
+			prio = ch->pq->e[0].priority;
+	}
+	UNLOCK(ch->plock);
+	return prio;
+}
+
+int __nto_pulse_take(struct nto_chan *ch, struct nto_pulse_cell *out)
+{
+	int ret = -EAGAIN;
+
+	LOCK(ch->plock);
+	if (ch->pq) {
+		drain(ch);
+		if (ch->pq->n) {
+			heap_pop(ch->pq, out);
+			ret = 0;
+		}
+	}
+	UNLOCK(ch->plock);
+	return ret;
+}
+
+static int send_pulse(int coid, int priority, int code, uint64_t value)
+{
+	struct nto_chan *ch;
+	struct nto_chan_shm *shm;
+	struct nto_pulse_cell *c;
+	uint32_t pos;
+
+	if (priority == -1)
+		priority = __nto_priority();
+	if (priority < 0 || priority > 255)
+		return -EINVAL;
+	if (!(ch = __nto_conn(coid)))
+		return -EBADF;
+	shm = ch->shm;
+	if (shm->destroyed) {
+		__nto_chan_put(ch);
+		return -ESRCH;
+	}
+
+	for (;;) {
+		pos = shm->pulse_tail;
+		c = &shm->pulse[pos & MASK];
+		int32_t dif = c->seq - pos;
+		if (!dif) {
+			if (a_cas((volatile int *)&shm->pulse_tail, pos,
+				  pos + 1) == (int)pos)
+				break;
+		} else if (dif < 0) {
+			/* Full: the receiver is NTO_PULSES behind. */
+			__nto_chan_put(ch);
+			return -EAGAIN;
+		}
+	}
+	c->priority = priority;
+	c->code = code;
+	c->pid = getpid();
+	c->value = value;
+	a_store((volatile int *)&c->seq, pos + 1);
+
+	a_inc(&shm->events);
+	if (shm->waiters)
+		__nto_wake(&shm->events, 1);
+	__nto_chan_put(ch);
+	return 0;
+}
+
+int MsgSendPulse_r(int coid, int priority, int code, int value)
+{
+	return send_pulse(coid, priority, code, (uint64_t)(unsigned)value);
+}
+
+int MsgSendPulse(int coid, int priority, int code, int value)
+{
+	return nto_ret(MsgSendPulse_r(coid, priority, code, value));
+}
+
+int MsgSendPulsePtr_r(int coid, int priority, int code, void *value)
+{
+	return send_pulse(coid, priority, code, (uintptr_t)value);
+}
+
+int MsgSendPulsePtr(int coid, int priority, int code, void *value)
+{
+	return nto_ret(MsgSendPulsePtr_r(coid, priority, code, value));
+}
@@ -0,0 +1,311 @@
+#ifndef QNX_RESMGR_H
+#define QNX_RESMGR_H
+
+#include <pthread.h>
+#include <time.h>
+#include "neutrino.h"
+#include "../qnx_stat.h"
+
+/*
+ * Resource manager framework emulation, see dispatch.c, iofunc.c,
+ * namespace.c and threadpool.c; the client side of the I/O messages
+ * is iomsg.c. Structure layouts follow the QNX 7 x86_64 headers, as
+ * resource managers allocate attrs and OCBs themselves and read
+ * contexts and messages directly.
+ */
+
+/* I/O message types; io functions are indexed by type - _IO_READ */
+#define _IO_CONNECT 0x100
+#define _IO_READ 0x101
+#define _IO_WRITE 0x102
+#define _IO_CLOSE_OCB 0x103
+#define _IO_STAT 0x104
+#define _IO_NOTIFY 0x105
+#define _IO_DEVCTL 0x106
+#define _IO_UNBLOCK 0x107
+#define _IO_PATHCONF 0x108
+#define _IO_LSEEK 0x109
+#define _IO_CHMOD 0x10a
+#define _IO_CHOWN 0x10b
+#define _IO_UTIME 0x10c
+#define _IO_OPENFD 0x10d
+#define _IO_FDINFO 0x10e
+#define _IO_LOCK 0x10f
+#define _IO_SPACE 0x110
+#define _IO_SHUTDOWN 0x111
+#define _IO_MMAP 0x112
+#define _IO_MSG 0x113
+#define _IO_DUP 0x115
+#define _IO_CLOSE 0x116
+#define _IO_SYNC 0x119
+
+#define _IO_CONNECT_OPEN 0x01
+
+#define _IO_FLAG_RD 0x01
+#define _IO_FLAG_WR 0x02
+
+/* Handler return values */
+#define _RESMGR_NPARTS(n) (-(n))
+#define _RESMGR_ERRNO(e) (e)
+#define _RESMGR_DEFAULT (-0x7fffffff)
+#define _RESMGR_NOREPLY (-0x7fffffff - 1)
+#define _RESMGR_STATUS(c, s) ((c)->status = (s))
+#define _RESMGR_PTR(c, p, s) \
+	((c)->iov[0].iov_base = (void *)(p), (c)->iov[0].iov_len = (s), \
+	 _RESMGR_NPARTS(1))
+#define _IO_SET_READ_NBYTES(c, n) ((c)->status = (n))
+#define _IO_SET_WRITE_NBYTES(c, n) ((c)->status = (n))
+
+#define _RESMGR_FLAG_BEFORE 0x0001
+#define _RESMGR_FLAG_AFTER 0x0002
+#define _RESMGR_FLAG_DIR 0x0004
+
+#define _FTYPE_ANY 0
+#define _FTYPE_FILE 1
+
+#define DISPATCH_FLAG_NOLOCK 0x01
+
+#define POOL_FLAG_EXIT_SELF 0x01
+#define POOL_FLAG_USE_SELF 0x02
+
+struct _io_connect {
+	uint16_t type;
+	uint16_t subtype;
+	uint32_t file_type;
+	uint16_t reply_max;
+	uint16_t entry_max;
+	uint32_t key;
+	uint32_t handle;
+	uint32_t ioflag;
+	uint32_t mode;
+	uint16_t sflag;
+	uint16_t access;
+	uint16_t zero;
+	uint16_t path_len;
+	uint8_t eflag;
+	uint8_t extra_type;
+	uint16_t extra_len;
+	char path[1];
+};
+
+struct _io_read {
+	uint16_t type;
+	uint16_t combine_len;
+	uint32_t nbytes;
+	uint32_t xtype;
+	uint32_t zero;
+};
+
+struct _io_write {
+	uint16_t type;
+	uint16_t combine_len;
+	uint32_t nbytes;
+	uint32_t xtype;
+	uint32_t zero;
+	/* data follows */
+};
+
+struct _io_close {
+	uint16_t type;
+	uint16_t combine_len;
+};
+
+struct _io_stat {
+	uint16_t type;
+	uint16_t combine_len;
+	uint32_t zero;
+};
+
+struct _io_lseek {
+	uint16_t type;
+	uint16_t combine_len;
+	int16_t whence;
+	uint16_t zero;
+	uint64_t offset;
+};
+
+struct _io_devctl {
+	uint16_t type;
+	uint16_t combine_len;
+	int32_t dcmd;
+	uint32_t nbytes;
+	int32_t zero;
+	/* data follows */
+};
+
+struct _io_devctl_reply {
+	uint32_t zero;
+	int32_t ret_val;
+	uint32_t nbytes;
+	int32_t zero2;
+	/* data follows */
+};
+
+typedef union { struct _io_connect connect; } io_open_t;
+typedef union { struct _io_read i; } io_read_t;
+typedef union { struct _io_write i; } io_write_t;
+typedef union { struct _io_close i; } io_close_t;
+typedef union { struct _io_stat i; struct qnx_stat o; } io_stat_t;
+typedef union { struct _io_lseek i; uint64_t o; } io_lseek_t;
+typedef union {
+	struct _io_devctl i;
+	struct _io_devctl_reply o;
+} io_devctl_t;
+
+typedef union _resmgr_iomsgs {
+	uint16_t type;
+	struct _io_connect connect;
+	io_read_t read;
+	io_write_t write;
+	io_close_t close;
+	io_stat_t stat;
+	io_lseek_t lseek;
+	io_devctl_t devctl;
+} resmgr_iomsgs_t;
+
+typedef struct _dispatch dispatch_t;
+
+typedef struct _resmgr_context {
+	long rcvid;
+	struct _msg_info info;
+	resmgr_iomsgs_t *msg;
+	dispatch_t *dpp;
+	int id;
+	unsigned tid;
+	unsigned msg_max_size;
+	int status;
+	int offset;
+	int size;
+	iov_t iov[1];
+} resmgr_context_t;
+
+typedef union _dispatch_context {
+	resmgr_context_t resmgr_context;
+} dispatch_context_t;
+
+typedef struct _resmgr_attr {
+	unsigned flags;
+	unsigned nparts_max;
+	unsigned msg_max_size;
+	int (*other_func)(resmgr_context_t *, void *);
+	unsigned reserved[4];
+} resmgr_attr_t;
+
+struct _iofunc_mount;
+
+typedef struct _iofunc_attr {
+	struct _iofunc_mount *mount;
+	uint32_t flags;
+	volatile int32_t lock_tid;
+	uint16_t lock_count;
+	uint16_t count;
+	uint16_t rcount;
+	uint16_t wcount;
+	uint16_t rlocks;
+	uint16_t wlocks;
+	void *mmap_list;
+	void *lock_list;
+	void *list;
+	uint32_t list_size;
+	uint64_t nbytes;
+	uint64_t inode;
+	uint32_t uid;
+	uint32_t gid;
+	int64_t mtime;
+	int64_t atime;
+	int64_t ctime;
+	uint32_t mode;
+	uint32_t nlink;
+	uint32_t rdev;
+} iofunc_attr_t;
+
+typedef struct _iofunc_ocb {
+	iofunc_attr_t *attr;
+	int32_t ioflag;
+	uint64_t offset;
+	uint16_t sflag;
+	uint16_t flags;
+	void *reserved;
+} iofunc_ocb_t;
+
+typedef int (*resmgr_func_t)(resmgr_context_t *, void *, void *);
+
+typedef struct _resmgr_connect_funcs {
+	unsigned nfuncs;
+	int (*open)(resmgr_context_t *, io_open_t *, void *, void *);
+	int (*unlink)(resmgr_context_t *, void *, void *, void *);
+	int (*rename)(resmgr_context_t *, void *, void *, void *);
+	int (*mknod)(resmgr_context_t *, void *, void *, void *);
+	int (*readlink)(resmgr_context_t *, void *, void *, void *);
+	int (*link)(resmgr_context_t *, void *, void *, void *);
+	int (*unblock)(resmgr_context_t *, void *, void *, void *);
+	int (*mount)(resmgr_context_t *, void *, void *, void *);
+} resmgr_connect_funcs_t;
+
+#define _RESMGR_CONNECT_NFUNCS 8
+
+/* In message type order from _IO_READ; see io_func() in dispatch.c */
+typedef struct _resmgr_io_funcs {
+	unsigned nfuncs;
+	int (*read)(resmgr_context_t *, io_read_t *, void *);
+	int (*write)(resmgr_context_t *, io_write_t *, void *);
+	int (*close_ocb)(resmgr_context_t *, void *, void *);
+	int (*stat)(resmgr_context_t *, io_stat_t *, void *);
+	resmgr_func_t notify;
+	int (*devctl)(resmgr_context_t *, io_devctl_t *, void *);
+	resmgr_func_t unblock;
+	resmgr_func_t pathconf;
+	int (*lseek)(resmgr_context_t *, io_lseek_t *, void *);
+	resmgr_func_t chmod;
+	resmgr_func_t chown;
+	resmgr_func_t utime;
+	resmgr_func_t openfd;
+	resmgr_func_t fdinfo;
+	resmgr_func_t lock;
+	resmgr_func_t space;
+	resmgr_func_t shutdown;
+	resmgr_func_t mmap;
+	resmgr_func_t msg;
+	resmgr_func_t reserved;
+	resmgr_func_t dup;
+	int (*close_dup)(resmgr_context_t *, io_close_t *, void *);
+	int (*lock_ocb)(resmgr_context_t *, void *, void *);
+	int (*unlock_ocb)(resmgr_context_t *, void *, void *);
+	resmgr_func_t sync;
+} resmgr_io_funcs_t;
+
+#define _RESMGR_IO_NFUNCS 25
+
+typedef struct _thread_pool_attr {
+	void *handle;
+	dispatch_context_t *(*block_func)(dispatch_context_t *);
+	void (*unblock_func)(dispatch_context_t *);
+	int (*handler_func)(dispatch_context_t *);
+	dispatch_context_t *(*context_alloc)(void *);
+	void (*context_free)(dispatch_context_t *);
+	pthread_attr_t *attr;
+	unsigned short lo_water;
+	unsigned short increment;
+	unsigned short hi_water;
+	unsigned short maximum;
+	unsigned reserved[8];
+} thread_pool_attr_t;
+
+/* Path registration, see namespace.c. __nto_ns_lookup fills the
+ * server's pid, chid and attach id and returns the offset of the path
+ * relative to the registered prefix, or -1. */
+hidden int __nto_ns_attach(const char *, int, int, unsigned, unsigned);
+hidden void __nto_ns_detach(int);
+hidden int __nto_ns_lookup(const char *, pid_t *, int *, int *, unsigned *);
+
+/* The channel a dispatch handle receives on, for name_attach (name.c) */
+hidden int __nto_dispatch_chid(dispatch_t *);
+
+dispatch_t *dispatch_create_channel(int, unsigned);
+int dispatch_destroy(dispatch_t *);
+int resmgr_open_bind(resmgr_context_t *, void *, const resmgr_io_funcs_t *);
+int iofunc_attr_lock(iofunc_attr_t *);
+int iofunc_attr_unlock(iofunc_attr_t *);
+int iofunc_close_ocb_default(resmgr_context_t *, void *, iofunc_ocb_t *);
+
+#endif
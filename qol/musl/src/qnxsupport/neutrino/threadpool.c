@@ -0,0 +1,153 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include "resmgr.h"
+#include "pthread_impl.h"
+
+/*
+ * thread_pool_*. Every worker runs block_func (MsgReceive, normally)
+ * then handler_func. The channel is the pool's only queue: each worker
+ * pulls the next message from it directly, so there is nothing to hand
+ * over or steal between workers. The pool counts the threads blocked at
+ * any time: when a worker takes a message and leaves fewer than
+ * lo_water blocked, it starts increment more (up to maximum) before
+ * handling it, and a worker that finds more than hi_water blocked
+ * after a message exits. Both counts are plain atomics, a new thread
+ * reserving its place in total by CAS, so workers never take a lock
+ * between messages. New threads count as blocked from the moment they
+ * are created, so several workers waking at once do not all grow the
+ * pool.
+ */
+
+typedef struct _thread_pool {
+	thread_pool_attr_t attr;
+	unsigned flags;
+	volatile int idle;
+	volatile int total;
+	volatile int shutdown;
+} thread_pool_t;
+
+static void *worker(void *arg);
+
+/* Reserve a place under maximum; 0 if the pool is full. */
+static int reserve(thread_pool_t *pool)
+{
+	int t;
+
+	while ((t = pool->total) < pool->attr.maximum)
+		if (a_cas(&pool->total, t, t + 1) == t)
+			return 1;
+	return 0;
+}
+
+/* Start a thread in a place already reserved. */
+static int spawn(thread_pool_t *pool)
+{
+	pthread_t t;
+	int ret;
+
+	a_inc(&pool->idle);
+	if ((ret = pthread_create(&t, pool->attr.attr, worker, pool))) {
+		a_dec(&pool->idle);
+		a_dec(&pool->total);
+		return ret;
+	}
+	pthread_detach(t);
+	return 0;
+}
+
+static void grow(thread_pool_t *pool)
+{
+	for (int i = 0; i < pool->attr.increment &&
+	     pool->idle < pool->attr.lo_water; i++)
+		if (!reserve(pool) || spawn(pool))
+			break;
+}
+
+/* A worker's life; a NULL from block_func (channel gone) ends it. */
+static void run(thread_pool_t *pool)
+{
+	thread_pool_attr_t *a = &pool->attr;
+	dispatch_context_t *ctp = a->context_alloc(a->handle);
+
+	if (!ctp)
+		a_dec(&pool->idle);
+	while (ctp) {
+		dispatch_context_t *got = a->block_func(ctp);
+		if (a_fetch_add(&pool->idle, -1) - 1 < a->lo_water && got)
+			grow(pool);
+		if (got)
+			a->handler_func(got);
+		if (!got || pool->shutdown || pool->idle > a->hi_water)
+			break;
+		a_inc(&pool->idle);
+	}
+	if (ctp && a->context_free)
+		a->context_free(ctp);
+
+	if (a_fetch_add(&pool->total, -1) == 1 && pool->shutdown)
+		free(pool);
+}
+
+static void *worker(void *arg)
+{
+	run(arg);
+	return 0;
+}
+
+thread_pool_t *thread_pool_create(thread_pool_attr_t *attr, unsigned flags)
+{
+	thread_pool_t *pool;
+	thread_pool_attr_t *a;
+
+	if (!attr || !attr->block_func || !attr->handler_func ||
+	    !attr->context_alloc) {
+		errno = EINVAL;
+		return 0;
+	}
+	if (!(pool = calloc(1, sizeof *pool))) {
+		errno = ENOMEM;
+		return 0;
+	}
+	pool->attr = *attr;
+	pool->flags = flags;
+	a = &pool->attr;
+	if (!a->maximum)
+		a->maximum = 1;
+	if (!a->increment)
+		a->increment = 1;
+	if (a->lo_water > a->maximum)
+		a->lo_water = a->maximum;
+	if (a->hi_water < a->lo_water)
+		a->hi_water = a->lo_water;
+	return pool;
+}
+
+int thread_pool_start(void *p)
+{
+	thread_pool_t *pool = p;
+	unsigned n = pool->attr.lo_water ? pool->attr.lo_water : 1;
+	int ret = 0;
+
+	if (pool->flags & POOL_FLAG_USE_SELF)
+		n--;
+	while (n-- && !ret && reserve(pool))
+		ret = spawn(pool);
+	if (ret)
+		return ret;
+
+	if (pool->flags & POOL_FLAG_USE_SELF) {
+		a_inc(&pool->total);
+		a_inc(&pool->idle);
+		run(pool);
+	}
+	if (pool->flags & POOL_FLAG_EXIT_SELF)
+		pthread_exit(0);
+	return EOK;
+}
+
+/* Workers leave after the message they are handling or waiting for. */
+int thread_pool_destroy(thread_pool_t *pool)
+{
+	a_store(&pool->shutdown, 1);
+	return 0;
+}
@@ -0,0 +1,364 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../dirent/__dirent.h"
+#include "syscall.h"
+#include "qnx_path.h"
+
+/*
+ * QNX_PROC_BOOT=<archive> serves /proc/boot, the files of the QNX boot
+ * image, out of a cpio archive in the "newc" format (what
+ * "find . | cpio -o -H newc" writes). The archive is mapped read-only
+ * once at startup and indexed by name in one anonymous mapping; stat,
+ * access and readdir answer from the index without system calls, and
+ * open copies the member into a sealed memfd, so that the fd can be
+ * read, mapped and passed on like any other. Nothing can be created or
+ * written. Directories can be listed but not opened, and symbolic links
+ * are listed but not followed.
+ */
+
+struct bent {
+	const char *name, *data;
+	size_t len, size;
+	uint32_t ino, mode, uid, gid, nlink, mtime;
+};
+
+static struct bent *ents;
+static size_t nents;
+
+#define CPIO_HDR 110
+#define BOOT_BLKSIZE 4096
+
+static int hex8(const char *p, uint32_t *v)
+{
+	int i, c;
+
+	for (*v = i = 0; i < 8; i++) {
+		c = p[i];
+		if (c >= '0' && c <= '9')
+			c -= '0';
+		else if ((c | 32) >= 'a' && (c | 32) <= 'f')
+			c = (c | 32) - 'a' + 10;
+		else
+			return 0;
+		*v = *v << 4 | c;
+	}
+	return 1;
+}
+
+/* Counts the members of the archive, filling out if it is not 0. */
+static size_t parse(const char *map, size_t size, struct bent *out)
+{
+	uint32_t f[13];
+	size_t pos = 0, n = 0, hlen, dlen;
+	const char *h, *name;
+	int i;
+
+	while (size - pos >= CPIO_HDR) {
+		h = map + pos;
+		if (memcmp(h, "07070", 5) || (h[5] != '1' && h[5] != '2'))
+			break;
+		for (i = 0; i < 13; i++)
+			if (!hex8(h + 6 + 8 * i, &f[i]))
+				return n;
+		/* ino mode uid gid nlink mtime filesize ... namesize */
+		hlen = CPIO_HDR + f[11] + 3 & -4;
+		dlen = f[6];
+		if (!f[11] || hlen > size - pos || dlen > size - pos - hlen)
+			break;
+		name = h + CPIO_HDR;
+		if (f[11] == 11 && !memcmp(name, "TRAILER!!!", 11))
+			break;
+		if (out) {
+			struct bent *b = &out[n];
+			size_t len = f[11] - 1;
+			while (len && *name == '/')
+				name++, len--;
+			while (len >= 2 && name[0] == '.' && name[1] == '/')
+				name += 2, len -= 2;
+			if (len == 1 && *name == '.')
+				len = 0;
+			while (len && name[len - 1] == '/')
+				len--;
+			b->name = name;
+			b->len = len;
+			b->data = h + hlen;
+			b->size = dlen;
+			b->ino = f[0];
+			b->mode = f[1];
+			b->uid = f[2];
+			b->gid = f[3];
+			b->nlink = f[4];
+			b->mtime = f[5];
+		}
+		n++;
+		pos += hlen + dlen;
+		pos = pos + 3 & -4;
+		if (pos > size)
+			break;
+	}
+	return n;
+}
+
+static int namecmp(const char *a, size_t al, const char *b, size_t bl)
+{
+	int c = memcmp(a, b, al < bl ? al : bl);
+	return c ? c : (al > bl) - (al < bl);
+}
+
+static int bentcmp(const void *a, const void *b)
+{
+	const struct bent *x = a, *y = b;
+	return namecmp(x->name, x->len, y->name, y->len);
+}
+
+void __qnx_bootfs_init(void)
+{
+	const char *s = getenv("QNX_PROC_BOOT");
+	struct stat st;
+	char *map;
+	size_t n, i;
+	int fd;
+
+	if (!s || !*s || (fd = open(s, O_RDONLY | O_CLOEXEC)) < 0)
+		return;
+	if (fstat(fd, &st) || !st.st_size ||
+	    (map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) ==
+		    MAP_FAILED) {
+		close(fd);
+		return;
+	}
+	close(fd);
+
+	/* One spare entry for the top directory, if the archive has none. */
+	n = parse(map, st.st_size, 0);
+	ents = mmap(0, (n + 1) * sizeof *ents, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ents == MAP_FAILED) {
+		ents = 0;
+		munmap(map, st.st_size);
+		return;
+	}
+	parse(map, st.st_size, ents);
+	for (i = 0; i < n && ents[i].len; i++);
+	if (i == n) {
+		ents[n].name = "";
+		ents[n].mode = S_IFDIR | 0555;
+		ents[n].nlink = 2;
+		n++;
+	}
+	qsort(ents, n, sizeof *ents, bentcmp);
+	nents = n;
+}
+
+static const struct bent *find(const char *name, size_t len)
+{
+	size_t lo = 0, hi = nents, mid;
+	int c;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		c = namecmp(ents[mid].name, ents[mid].len, name, len);
+		if (!c)
+			return &ents[mid];
+		if (c < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return 0;
+}
+
+/* Whether path is in /proc/boot, and if so its name in the archive,
+ * with ".", ".." and repeated slashes taken out. */
+static int boot_name(const char *p, char *buf, size_t *len)
+{
+	static const char pre[2][5] = { "proc", "boot" };
+	size_t n = 0, l;
+	const char *s;
+	int i;
+
+	if (!ents || *p != '/')
+		return 0;
+	for (i = 0; i < 2; i++) {
+		while (*p == '/')
+			p++;
+		for (s = p; *s && *s != '/'; s++);
+		if (s - p != 4 || memcmp(p, pre[i], 4))
+			return 0;
+		p = s;
+	}
+	for (;; p = s) {
+		while (*p == '/')
+			p++;
+		if (!*p)
+			break;
+		for (s = p; *s && *s != '/'; s++);
+		l = s - p;
+		if (l == 1 && *p == '.')
+			continue;
+		if (l == 2 && p[0] == '.' && p[1] == '.') {
+			/* Leaving /proc/boot is up to the host. */
+			if (!n)
+				return 0;
+			while (n && buf[n - 1] != '/')
+				n--;
+			if (n)
+				n--;
+			continue;
+		}
+		if (n + l + 1 >= PATH_MAX)
+			return 0;
+		if (n)
+			buf[n++] = '/';
+		memcpy(buf + n, p, l);
+		n += l;
+	}
+	*len = n;
+	return 1;
+}
+
+static void bent_stat(const struct bent *b, struct qnx_stat *st)
+{
+	memset(st, 0, sizeof *st);
+	st->st_ino = b->ino;
+	st->st_size = b->size;
+	st->st_uid = b->uid;
+	st->st_gid = b->gid;
+	st->st_mode = b->mode;
+	st->st_nlink = b->nlink;
+	st->__old_st_mtime = st->__old_st_atime = st->__old_st_ctime =
+		b->mtime;
+	st->st_mtim.tv_sec = st->st_atim.tv_sec = st->st_ctim.tv_sec =
+		b->mtime;
+	st->st_blocksize = st->st_blksize = BOOT_BLKSIZE;
+	st->st_nblocks = (b->size + BOOT_BLKSIZE - 1) / BOOT_BLKSIZE;
+	st->st_blocks = (b->size + 511) / 512;
+}
+
+int __qnx_bootfs_open(const char *path, int flags)
+{
+	char name[PATH_MAX];
+	const struct bent *b;
+	size_t len, off;
+	ssize_t n;
+	int fd;
+
+	if (!boot_name(path, name, &len))
+		return -2;
+	if (!(b = find(name, len)))
+		return __syscall_ret(flags & O_CREAT ? -EROFS : -ENOENT);
+	if ((flags & (O_CREAT | O_EXCL)) == (O_CREAT | O_EXCL))
+		return __syscall_ret(-EEXIST);
+	if ((flags & O_ACCMODE) != O_RDONLY || flags & O_TRUNC)
+		return __syscall_ret(-EROFS);
+	if (S_ISLNK(b->mode))
+		return __syscall_ret(-ELOOP);
+	if (S_ISDIR(b->mode))
+		return __syscall_ret(-EISDIR);
+	if (flags & O_DIRECTORY)
+		return __syscall_ret(-ENOTDIR);
+
+	fd = memfd_create("proc-boot", MFD_ALLOW_SEALING |
+			  (flags & O_CLOEXEC ? MFD_CLOEXEC : 0));
+	if (fd < 0)
+		return -1;
+	for (off = 0; off < b->size; off += n) {
+		if ((n = pwrite(fd, b->data + off, b->size - off, off)) < 0) {
+			__syscall(SYS_close, fd);
+			return -1;
+		}
+	}
+	fchmod(fd, b->mode & 07777);
+	fcntl(fd, F_ADD_SEALS,
+	      F_SEAL_SEAL | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE);
+	return fd;
+}
+
+int __qnx_bootfs_stat(const char *path, struct qnx_stat *buf)
+{
+	char name[PATH_MAX];
+	const struct bent *b;
+	size_t len;
+
+	if (!boot_name(path, name, &len))
+		return -2;
+	if (!(b = find(name, len)))
+		return __syscall_ret(-ENOENT);
+	if (buf)
+		bent_stat(b, buf);
+	return 0;
+}
+
+int __qnx_bootfs_access(const char *path, int amode)
+{
+	int ret = __qnx_bootfs_stat(path, 0);
+
+	if (ret || !(amode & W_OK))
+		return ret;
+	return __syscall_ret(-EROFS);
+}
+
+/* A DIR for a directory in the archive has fd -1, the index of the
+ * directory in __qnx_pad and the index to go on from in tell. */
+int __qnx_bootfs_opendir(const char *path, DIR **dir)
+{
+	char name[PATH_MAX];
+	const struct bent *b;
+	size_t len;
+
+	if (!boot_name(path, name, &len))
+		return -2;
+	if (!(b = find(name, len)))
+		return __syscall_ret(-ENOENT);
+	if (!S_ISDIR(b->mode))
+		return __syscall_ret(-ENOTDIR);
+	if (!(*dir = calloc(1, sizeof **dir)))
+		return -1;
+	(*dir)->fd = -1;
+	(*dir)->__qnx_pad = b - ents;
+	(*dir)->tell = b - ents + 1;
+	return 0;
+}
+
+/* The first entry of dir at index pos or later: its name, relative to
+ * dir, and stat, and the index to go on from; -1 if there is none. The
+ * entries of a directory come after it, among all its descendants. */
+long __qnx_bootfs_next(DIR *dir, long pos, const char **name, size_t *len,
+		       struct qnx_stat *st)
+{
+	const struct bent *d = &ents[dir->__qnx_pad], *e;
+	size_t pl = d->len, cl;
+	int c;
+
+	for (; pos >= 0 && pos < nents; pos++) {
+		e = &ents[pos];
+		if (!e->len)
+			continue;
+		if (pl) {
+			c = memcmp(e->name, d->name, e->len < pl ? e->len : pl);
+			if (c > 0)
+				break;
+			if (c < 0 || e->len <= pl || e->name[pl] < '/')
+				continue;
+			if (e->name[pl] > '/')
+				break;
+			cl = pl + 1;
+		} else {
+			cl = 0;
+		}
+		if (memchr(e->name + cl, '/', e->len - cl))
+			continue;
+		*name = e->name + cl;
+		*len = e->len - cl;
+		bent_stat(e, st);
+		return pos + 1;
+	}
+	return -1;
+}
@@ -1,15 +1,25 @@
+#define _GNU_SOURCE
 #include "features.h"
+#include <ctype.h>
 #include <stdio.h>
+#include <string.h>
 
 typedef const short *_Ctype_t;
 
 #define _IMPLICIT_EXTERN
 #define _XTLS_QUAL
 
+/*
+ * QNX code compiled against the Dinkumware headers calls the
+ * _Tls_setup_<name> hook before touching <name> whenever the hook is
+ * non-null. Our tables are process-wide and never change, so every
+ * hook is a null constant: the check always takes the direct path, and
+ * both the hooks and the table pointers land in read-only data.
+ */
 #define _XTLS_SETUP(name) _Tls_setup_##name
-#define _TLS_DEFINE_INIT(scope, type, name) scope _XTLS_QUAL type name
+#define _TLS_DEFINE_INIT(scope, type, name) scope _XTLS_QUAL type const name
 #define _TLS_DEFINE_NO_INIT(scope, type, name) \
-	scope int (*_XTLS_SETUP(name))(void) = 0
+	scope int (*const _XTLS_SETUP(name))(void) = 0
 #define _TLS_DATA_DEF(scope, type, name, init)      \
 	_TLS_DEFINE_INIT(scope, type, name) = init; \
 	_TLS_DEFINE_NO_INIT(scope, type, name)
@@ -119,3 +129,51 @@ typedef struct { /* pointer to state-machine table */
 
 _TLS_DATA_DEF(_IMPLICIT_EXTERN, _Statab, _Mbstate,
 	      { { 0 } }); /* 0: UTF8, &tab0[1]: 1-to-1 */
+
+/*
+ * Buffer-wide extensions for text-heavy callers. The case conversions
+ * work on 16 bytes at a time with GCC vector types, which become SSE2
+ * on x86_64 and NEON on aarch64. Like the tables above they only know
+ * about ASCII.
+ */
+typedef unsigned char qnx_v16 __attribute__((__vector_size__(16)));
+
+static void case_buf(char *dst, const char *src, size_t n, unsigned char first)
+{
+	const qnx_v16 lo = (qnx_v16){ 0 } + first, span = (qnx_v16){ 0 } + 26;
+	const qnx_v16 bit = (qnx_v16){ 0 } + 0x20;
+	qnx_v16 v, in;
+
+	for (; n >= 16; n -= 16, src += 16, dst += 16) {
+		memcpy(&v, src, 16);
+		in = (qnx_v16)(v - lo < span);
+		v ^= in & bit;
+		memcpy(dst, &v, 16);
+	}
+	for (; n; n--, src++, dst++) {
+		unsigned char c = *src;
+		*dst = c ^ ((unsigned char)(c - first) < 26) << 5;
+	}
+}
+
+void qnx_toupper_buf(char *dst, const char *src, size_t n)
+{
+	case_buf(dst, src, n, 'a');
+}
+
+void qnx_tolower_buf(char *dst, const char *src, size_t n)
+{
+	case_buf(dst, src, n, 'A');
+}
+
+/* Length of the prefix of s whose characters all have a class bit of
+ * mask set (_LO, _UP, _DI, ... as in _Ctype). */
+size_t qnx_ctype_span(const char *s, size_t n, int mask)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		if (!(ctyp_tab[1 + (unsigned char)s[i]] & mask))
+			break;
+	return i;
+}
@@ -0,0 +1,172 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include "qnx_fcntl.h"
+#include "qnx_proc.h"
+
+/*
+ * devctl on fds that are not resource manager connections. Commands are
+ * looked up by dcmd in a table sorted by it and either run through a
+ * handler or passed to the Linux ioctl the entry names. The fd type is
+ * not part of the key: Linux already fails a tty command on a file with
+ * ENOTTY, and finding the type would cost every call an fstat. Sizes
+ * are checked against the one encoded in dcmd, as QNX's servers do.
+ * Handlers return a Linux errno value; devctl translates it. Commands
+ * that take an array, like DCMD_PROC_MAPINFO, have a handler that is
+ * given the size and sets info itself.
+ */
+
+#define DEVDIR_TO 0x80000000u
+#define DEVDIR_FROM 0x40000000u
+#define DIOF(class, cmd, size) (DEVDIR_FROM | (size) << 16 | (class) << 8 | (cmd))
+#define DIOT(class, cmd, size) (DEVDIR_TO | (size) << 16 | (class) << 8 | (cmd))
+#define DIOTF(class, cmd, size) (DIOT(class, cmd, size) | DEVDIR_FROM)
+#define DCMD_SIZE(dcmd) ((dcmd) >> 16 & 0x3fff)
+
+/* <sys/dcmd_all.h> */
+#define _DCMD_ALL 0x01
+#define DCMD_ALL_GETFLAGS DIOF(_DCMD_ALL, 1, 4)
+#define DCMD_ALL_SETFLAGS DIOT(_DCMD_ALL, 2, 4)
+#define DCMD_ALL_GETOWN DIOF(_DCMD_ALL, 4, 4)
+#define DCMD_ALL_SETOWN DIOT(_DCMD_ALL, 5, 4)
+
+/* <sys/procfs.h>, on /proc/<pid>/as; see qproc.c */
+#define _DCMD_PROC 0x08
+#define DCMD_PROC_INFO DIOF(_DCMD_PROC, 1, sizeof(struct qnx_debug_process))
+#define DCMD_PROC_MAPINFO DIOF(_DCMD_PROC, 2, sizeof(struct qnx_mapinfo))
+#define DCMD_PROC_STATUS DIOF(_DCMD_PROC, 7, sizeof(struct qnx_debug_thread))
+#define DCMD_PROC_TIDSTATUS DIOTF(_DCMD_PROC, 7, sizeof(struct qnx_debug_thread))
+
+/* QNX's ioctl passes these BSD-style requests to devctl unchanged;
+ * <sys/dcmd_chr.h> names the window size ones DCMD_CHR_GETSIZE and
+ * DCMD_CHR_SETSIZE. */
+#define QNX_TIOCSWINSZ DIOT('t', 103, 8)
+#define QNX_TIOCGWINSZ DIOF('t', 104, 8)
+#define QNX_TIOCSPGRP DIOT('t', 118, 4)
+#define QNX_TIOCGPGRP DIOF('t', 119, 4)
+#define QNX_FIONBIO DIOT('f', 126, 4)
+#define QNX_FIONREAD DIOF('f', 127, 4)
+
+int tcgetsize(int, int *, int *);
+int tcsetsize(int, int, int);
+
+struct qnx_winsize {
+	unsigned short ws_row, ws_col, ws_xpixel, ws_ypixel;
+};
+
+static int dc_getflags(int fd, void *data, unsigned long arg)
+{
+	int r = fcntl(fd, F_GETFL);
+
+	if (r < 0)
+		return errno;
+	*(int *)data = __qnx_oflags_from_linux(r);
+	return 0;
+}
+
+static int dc_setflags(int fd, void *data, unsigned long arg)
+{
+	int r = fcntl(fd, F_SETFL, __qnx_oflags_to_linux(*(int *)data));
+
+	return r < 0 ? errno : 0;
+}
+
+static int dc_getown(int fd, void *data, unsigned long arg)
+{
+	int r;
+
+	errno = 0;
+	r = fcntl(fd, F_GETOWN);
+	if (r == -1 && errno)
+		return errno;
+	*(int *)data = r;
+	return 0;
+}
+
+static int dc_setown(int fd, void *data, unsigned long arg)
+{
+	return fcntl(fd, F_SETOWN, *(int *)data) < 0 ? errno : 0;
+}
+
+/* Through tcgetsize, which keeps the answer until the next SIGWINCH. */
+static int dc_getsize(int fd, void *data, unsigned long arg)
+{
+	struct qnx_winsize *ws = data;
+	int rows, cols;
+
+	if (tcgetsize(fd, &rows, &cols))
+		return errno;
+	ws->ws_row = rows;
+	ws->ws_col = cols;
+	ws->ws_xpixel = ws->ws_ypixel = 0;
+	return 0;
+}
+
+static int dc_setsize(int fd, void *data, unsigned long arg)
+{
+	struct qnx_winsize *ws = data;
+
+	return tcsetsize(fd, ws->ws_row, ws->ws_col) ? errno : 0;
+}
+
+/* The QNX and Linux argument are the same int. */
+static int dc_ioctl(int fd, void *data, unsigned long arg)
+{
+	return ioctl(fd, arg, data) < 0 ? errno : 0;
+}
+
+static const struct dcmd_ent {
+	unsigned dcmd;
+	int (*fn)(int, void *, unsigned long);
+	unsigned long arg;
+	int (*array)(int, void *, size_t, int *);
+} dcmd_tab[] = {
+	/* Sorted by dcmd. */
+	{ DCMD_ALL_GETFLAGS, dc_getflags },
+	{ DCMD_ALL_GETOWN, dc_getown },
+	{ QNX_FIONREAD, dc_ioctl, FIONREAD },
+	{ QNX_TIOCGPGRP, dc_ioctl, TIOCGPGRP },
+	{ QNX_TIOCGWINSZ, dc_getsize },
+	{ DCMD_PROC_MAPINFO, .array = __qnx_proc_mapinfo },
+	{ DCMD_PROC_STATUS, __qnx_proc_status, 0 },
+	{ DCMD_PROC_INFO, __qnx_proc_info },
+	{ DCMD_ALL_SETFLAGS, dc_setflags },
+	{ DCMD_ALL_SETOWN, dc_setown },
+	{ QNX_FIONBIO, dc_ioctl, FIONBIO },
+	{ QNX_TIOCSPGRP, dc_ioctl, TIOCSPGRP },
+	{ QNX_TIOCSWINSZ, dc_setsize },
+	{ DCMD_PROC_TIDSTATUS, __qnx_proc_status, 1 },
+};
+
+int __qnx_devctl(int fd, unsigned dcmd, void *data, size_t nbytes,
+		 int *info)
+{
+	size_t lo = 0, hi = sizeof dcmd_tab / sizeof *dcmd_tab, mid;
+	const struct dcmd_ent *e;
+	int r;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		e = &dcmd_tab[mid];
+		if (e->dcmd == dcmd)
+			goto found;
+		if (e->dcmd < dcmd)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return fcntl(fd, F_GETFD) < 0 ? EBADF : ENOTTY;
+
+found:
+	if (e->array)
+		return e->array(fd, data, nbytes, info);
+	if (nbytes < DCMD_SIZE(dcmd))
+		return EINVAL;
+	if ((r = e->fn(fd, data, e->arg)))
+		return r;
+	if (info)
+		*info = 0;
+	return 0;
+}
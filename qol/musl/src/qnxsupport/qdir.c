@@ -1,11 +1,28 @@
+#define _GNU_SOURCE
 #include <stddef.h>
+#include <stdarg.h>
 #include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <stdint.h>
 #include <string.h>
+#include "../dirent/__dirent.h"
+#include "syscall.h"
+#include "qnx_redirect.h"
+#include "qnx_stat.h"
+#include "qnx_path.h"
 
 #define D_GETFLAG 1
 #define D_SETFLAG 2
-#define QNX_ENOSYS 89
+
+#define D_FLAG_FILTER 0x00000001
+#define D_FLAG_STAT 0x00000002
+#define D_FLAG_RESOLVE 0x00000004
+
+#define _DTYPE_NONE 0
+#define _DTYPE_STAT 1
+#define _DTYPE_LSTAT 2
 
 struct qnx_dirent {
 	uint64_t d_ino;
@@ -15,27 +32,172 @@ struct qnx_dirent {
 	char d_name[1];
 };
 
+struct qnx_dirent_extra_stat {
+	uint16_t d_datalen;
+	uint16_t d_type;
+	uint32_t d_reserved;
+	struct qnx_stat d_stat;
+};
+
+/*
+ * D_FLAG_FILTER only matters for union mounts, which Linux directories
+ * never present, so it is accepted and has no effect. D_FLAG_STAT makes
+ * _qnx_readdir append a stat extra (lstat, or stat with D_FLAG_RESOLVE)
+ * to each entry, looked up relative to the directory fd while the batch
+ * is converted.
+ */
 int dircntl(DIR *dir, int cmd, ...)
 {
-	return 0;
+	va_list ap;
+	int old = dir->qnx_flags;
+
+	switch (cmd) {
+	case D_GETFLAG:
+		return old;
+	case D_SETFLAG:
+		va_start(ap, cmd);
+		dir->qnx_flags = va_arg(ap, int) &
+				 (D_FLAG_FILTER | D_FLAG_STAT | D_FLAG_RESOLVE);
+		va_end(ap);
+		return old;
+	}
+	errno = ENOSYS;
+	return -1;
 }
 
-struct qnx_dirent *_qnx_readdir(DIR *dir)
+/*
+ * QNX readdir serves entries in QNX layout out of the DIR's own buffer.
+ * Each refill reads a getdents64 batch into the tail of dir->buf and
+ * converts the whole batch forward into QNX records at the start of the
+ * buffer. A QNX record is at most 8 + extra bytes longer than the kernel
+ * record it replaces and kernel records are at least 24 bytes, so
+ * reading at most sizeof buf * 24 / (32 + extra) bytes into the end of
+ * the buffer keeps the output from overtaking input that has not been
+ * converted yet. A DIR must not be mixed between readdir and
+ * _qnx_readdir.
+ */
+#define QNX_DIR_INPUT(extra) \
+	(sizeof(((DIR *)0)->buf) * 24 / (32 + (extra)) & -8)
+
+struct linux_dirent64 {
+	uint64_t d_ino;
+	int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+static int qnx_dir_fill(DIR *dir)
 {
-	struct dirent local;
-	struct dirent *raw = readdir(dir);
-	if (!raw)
-		return NULL;
+	int want_stat = dir->qnx_flags & D_FLAG_STAT;
+	size_t in_len = want_stat
+		? QNX_DIR_INPUT(sizeof(struct qnx_dirent_extra_stat))
+		: QNX_DIR_INPUT(0);
+	char *in = dir->buf + sizeof dir->buf - in_len;
+	char *out = dir->buf;
+	int len, pos, reclen;
 
-	memcpy(&local, raw, sizeof(struct dirent));
+	len = __syscall(SYS_getdents64, dir->fd, in, in_len);
+	if (len <= 0) {
+		if (len < 0 && len != -ENOENT)
+			errno = -len;
+		return 0;
+	}
+	for (pos = 0; pos < len; pos += reclen) {
+		struct linux_dirent64 *ld = (void *)(in + pos);
+		struct qnx_dirent *qd = (void *)out;
+		uint64_t ino = ld->d_ino;
+		int64_t off = ld->d_off;
+		size_t room, base, namelen;
 
-	struct qnx_dirent *new = (void *)raw;
+		reclen = ld->d_reclen;
+		/* The name and its NUL fill the record up to at most 7
+		 * bytes of alignment padding, so only the tail needs to be
+		 * searched. */
+		room = reclen - offsetof(struct linux_dirent64, d_name);
+		base = room > 8 ? room - 8 : 0;
+		namelen = base + strnlen(ld->d_name + base, room - base);
 
-	new->d_ino = local.d_ino;
-	new->d_offset = local.d_off;
-	new->d_reclen = local.d_reclen;
-	new->d_namelen = strlen(local.d_name);
-	strcpy(new->d_name, local.d_name);
+		memmove(qd->d_name, ld->d_name, namelen);
+		qd->d_name[namelen] = 0;
+		qd->d_ino = ino;
+		qd->d_offset = off;
+		qd->d_namelen = namelen;
+		qd->d_reclen = offsetof(struct qnx_dirent, d_name) + namelen + 1
+			       + 7 & -8;
+		if (want_stat) {
+			struct qnx_dirent_extra_stat *ex =
+				(void *)(out + qd->d_reclen);
+			int resolve = dir->qnx_flags & D_FLAG_RESOLVE;
+			if (!_qnx_stat_fields(dir->fd, qd->d_name,
+					      resolve ? 0 : AT_SYMLINK_NOFOLLOW,
+					      STATX_BASIC_STATS, &ex->d_stat)) {
+				ex->d_datalen = sizeof ex->d_stat;
+				ex->d_type = resolve ? _DTYPE_STAT : _DTYPE_LSTAT;
+				ex->d_reserved = 0;
+				qd->d_reclen += sizeof *ex;
+			}
+		}
+		out += qd->d_reclen;
+	}
+	dir->buf_pos = 0;
+	dir->buf_end = out - dir->buf;
+	return 1;
+}
+
+/* The same for a directory in QNX_PROC_BOOT, from its index. */
+static int qnx_bootdir_fill(DIR *dir)
+{
+	int want_stat = dir->qnx_flags & D_FLAG_STAT;
+	char *out = dir->buf, *end = dir->buf + sizeof dir->buf;
+	long pos = dir->tell, next;
+	struct qnx_stat st;
+	const char *name;
+	size_t namelen, reclen;
+
+	while ((next = __qnx_bootfs_next(dir, pos, &name, &namelen, &st)) >= 0) {
+		struct qnx_dirent *qd = (void *)out;
+
+		reclen = offsetof(struct qnx_dirent, d_name) + namelen + 1
+			 + 7 & -8;
+		if (reclen + (want_stat ? sizeof(struct qnx_dirent_extra_stat)
+					: 0) > end - out)
+			break;
+		memcpy(qd->d_name, name, namelen);
+		qd->d_name[namelen] = 0;
+		qd->d_ino = st.st_ino;
+		qd->d_offset = next;
+		qd->d_namelen = namelen;
+		qd->d_reclen = reclen;
+		if (want_stat) {
+			struct qnx_dirent_extra_stat *ex = (void *)(out + reclen);
+			ex->d_datalen = sizeof ex->d_stat;
+			ex->d_type = dir->qnx_flags & D_FLAG_RESOLVE
+				? _DTYPE_STAT : _DTYPE_LSTAT;
+			ex->d_reserved = 0;
+			ex->d_stat = st;
+			qd->d_reclen += sizeof *ex;
+		}
+		out += qd->d_reclen;
+		pos = next;
+	}
+	if (out == dir->buf)
+		return 0;
+	dir->buf_pos = 0;
+	dir->buf_end = out - dir->buf;
+	return 1;
+}
 
-	return new;
+struct qnx_dirent *_qnx_readdir(DIR *dir)
+{
+	struct qnx_dirent *de;
+
+	if (dir->buf_pos >= dir->buf_end &&
+	    !(dir->fd < 0 ? qnx_bootdir_fill(dir) : qnx_dir_fill(dir)))
+		return NULL;
+	de = (void *)(dir->buf + dir->buf_pos);
+	dir->buf_pos += de->d_reclen;
+	dir->tell = de->d_offset;
+	return de;
 }
+QNX_REDIRECT(readdir);
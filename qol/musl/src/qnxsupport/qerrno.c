@@ -0,0 +1,82 @@
+#include <string.h>
+#include "qnx_errno.h"
+#include "qnx_stats.h"
+#include "qnx_redirect.h"
+
+/*
+ * QNX code sees errno through __get_errno_ptr, in QNX numbering; libc
+ * keeps Linux numbering in errno itself. Both directions are a table
+ * lookup, and neither costs anything while no error happens:
+ *   - everything in libc that sets or reads errno goes through
+ *     __errno_location, which marks the QNX view stale, so the next
+ *     __get_errno_ptr translates errno into it;
+ *   - a value QNX code stored into the view is copied back, translated,
+ *     into errno by the next __errno_location, so libc (perror, %m)
+ *     sees it and "errno = 0; call(); if (errno)" works either way.
+ * Numbers without a counterpart map to EINVAL; numbers beyond either
+ * table are passed through.
+ */
+
+int __qnx_errno, __qnx_errno_seen, __qnx_errno_dirty;
+
+/* Indexed by Linux errno. */
+const unsigned short __qnx_errno_from_linux_tab[QNX_ERRNO_LINUX_MAX] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17,
+	18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33,
+	34, 45, 78, 46, 89, 93, 90, 22, 35, 36, 37, 38, 39, 40, 41, 42,
+	43, 44, 50, 51, 52, 53, 54, 55, 22, 57, 60, 61, 62, 63, 64, 65,
+	66, 67, 68, 69, 70, 71, 74, 73, 77, 79, 80, 81, 82, 83, 84, 85,
+	86, 87, 88, 91, 92, 94, 238, 239, 240, 241, 242, 243, 244, 103,
+	246, 247, 248, 249, 250, 251, 252, 253, 254, 255, 256, 257, 258,
+	259, 260, 261, 264, 265, 237, 236, 122, 117, 118, 119, 120, 121,
+	49, 123, 124, 47, 126, 127, 128, 129, 58, 95, 132, 133,
+};
+
+/* Indexed by QNX errno; QNX ENOTSUP (48), EDEADLOCK (56) and the old
+ * socket EOPNOTSUPP (245) have no Linux number of their own. */
+const unsigned char __qnx_errno_to_linux_tab[QNX_ERRNO_QNX_MAX] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17,
+	18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33,
+	34, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 35, 37, 125, 95,
+	122, 52, 53, 54, 55, 56, 57, 35, 59, 130, 22, 60, 61, 62, 63,
+	64, 65, 66, 67, 68, 69, 70, 71, 22, 73, 72, 22, 22, 74, 36, 75,
+	76, 77, 78, 79, 80, 81, 82, 83, 84, 38, 40, 85, 86, 39, 87, 131,
+	22, 22, 22, 22, 22, 22, 22, 95, 22, 22, 22, 22, 22, 22, 22, 22,
+	22, 22, 22, 22, 22, 117, 118, 119, 120, 121, 116, 123, 124, 22,
+	126, 127, 128, 129, 22, 22, 132, 133, 22, 22, 22, 22, 22, 22,
+	22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22,
+	22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22,
+	22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22,
+	22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22,
+	22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22,
+	22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22,
+	115, 114, 88, 89, 90, 91, 92, 93, 94, 95, 96, 97, 98, 99, 100,
+	101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111, 22, 22,
+	112, 113,
+};
+
+#undef errno
+extern int errno;
+
+int *__get_errno_ptr(void)
+{
+	if (__qnx_errno_dirty) {
+		__qnx_errno_dirty = 0;
+		__qnx_errno = __qnx_errno_seen = __qnx_errno_from_linux(errno);
+		__qnx_stat(QNX_STAT_ERRNO);
+	}
+	return &__qnx_errno;
+}
+
+char *_qnx_strerror(int e)
+{
+	return strerror(__qnx_errno_to_linux(e));
+}
+QNX_REDIRECT(strerror);
+
+int _qnx_strerror_r(int e, char *buf, size_t len)
+{
+	return __qnx_errno_from_linux(strerror_r(__qnx_errno_to_linux(e), buf,
+						 len));
+}
+QNX_REDIRECT(strerror_r);
@@ -1,6 +1,12 @@
 #include "syscall.h"
 #include <stdarg.h>
 #include <fcntl.h>
+#include <limits.h>
+#include "qnx_redirect.h"
+#include "qnx_fcntl.h"
+#include "qnx_path.h"
+#include "qnx_proc.h"
+#include "neutrino/neutrino.h"
 
 #define QNX_O_RDONLY 000000 /*  Read-only mode  */
 #define QNX_O_WRONLY 000001 /*  Write-only mode */
@@ -15,60 +21,133 @@
 #define QNX_O_EXCL 002000 /*  Exclusive open          */
 #define QNX_O_NOCTTY 004000 /*  Don't assign a controlling terminal */
 
-static int qnx_flag_to_linux(mode_t f)
+/*
+ * Open flag translation. The access mode bits are the same on both
+ * systems; the other QNX flags all live in bits 3-11 and are mapped
+ * through two small tables built at compile time. The reverse direction
+ * (fcntl(F_GETFL)) only needs the status flags, tested one by one.
+ * Linux has no separate O_RSYNC, and its O_SYNC includes O_DSYNC.
+ */
+#define QNX_OFLAGS_LO(i)                        \
+	(((i) & 001 ? O_APPEND : 0) |           \
+	 ((i) & 002 ? O_DSYNC : 0) |            \
+	 ((i) & 004 ? O_SYNC : 0) |             \
+	 ((i) & 010 ? O_RSYNC : 0))
+#define QNX_OFLAGS_HI(i)                        \
+	(((i) & 001 ? O_NONBLOCK : 0) |         \
+	 ((i) & 002 ? O_CREAT : 0) |            \
+	 ((i) & 004 ? O_TRUNC : 0) |            \
+	 ((i) & 010 ? O_EXCL : 0) |             \
+	 ((i) & 020 ? O_NOCTTY : 0))
+
+#define R4(m, b) m(b), m(b + 1), m(b + 2), m(b + 3)
+#define R16(m, b) R4(m, b), R4(m, b + 4), R4(m, b + 8), R4(m, b + 12)
+
+/* QNX bits 3-6 and 7-11 */
+static const int qnx_oflags_lo[16] = { R16(QNX_OFLAGS_LO, 0) };
+static const int qnx_oflags_hi[32] = { R16(QNX_OFLAGS_HI, 0),
+				       R16(QNX_OFLAGS_HI, 16) };
+
+#undef R16
+#undef R4
+
+int __qnx_oflags_to_linux(int f)
+{
+	return (f & O_ACCMODE) | qnx_oflags_lo[f >> 3 & 017] |
+	       qnx_oflags_hi[f >> 7 & 037];
+}
+
+int __qnx_oflags_from_linux(int f)
 {
-	int ret = 0;
-
-#define CONV_MODE(n)       \
-	if (f & QNX_O_##n) \
-	ret |= O_##n
-
-	CONV_MODE(RDONLY);
-	CONV_MODE(WRONLY);
-	CONV_MODE(RDONLY);
-	CONV_MODE(WRONLY);
-	CONV_MODE(RDWR);
-	CONV_MODE(NONBLOCK);
-	CONV_MODE(APPEND);
-	CONV_MODE(DSYNC);
-	CONV_MODE(RSYNC);
-	CONV_MODE(SYNC);
-	CONV_MODE(CREAT);
-	CONV_MODE(TRUNC);
-	CONV_MODE(EXCL);
-	CONV_MODE(NOCTTY);
-
-#undef CONV_MODE
-
-	return ret;
+	/* Linux O_SYNC holds O_DSYNC's bit, so it is tested whole first. */
+	return (f & O_ACCMODE) |
+	       ((f & O_SYNC) == O_SYNC ? QNX_O_SYNC :
+		f & O_DSYNC ? QNX_O_DSYNC : 0) |
+	       (f & O_APPEND ? QNX_O_APPEND : 0) |
+	       (f & O_NONBLOCK ? QNX_O_NONBLOCK : 0);
 }
 
+/* Paths a resource manager has registered go to it instead, paths in
+ * /proc/boot to QNX_PROC_BOOT and /proc/<pid>/as to qproc.c, before
+ * they are mapped to host paths. */
 int _qnx_open(const char *filename, int flags, ...)
 {
+	char buf[PATH_MAX];
 	mode_t mode = 0;
+	int fd;
 
-	va_list ap;
-	va_start(ap, flags);
-	mode = va_arg(ap, mode_t);
-	va_end(ap);
-	flags = qnx_flag_to_linux(flags);
+	if (flags & QNX_O_CREAT) {
+		va_list ap;
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+	if ((fd = __nto_io_open(filename, flags, mode)) != -2)
+		return fd;
+	flags = __qnx_oflags_to_linux(flags);
+	if ((fd = __qnx_bootfs_open(filename, flags)) != -2 ||
+	    (fd = __qnx_proc_open(filename, flags)) != -2)
+		return fd;
+	if (!(filename = __qnx_path_map(filename, buf)))
+		return -1;
 	return open(filename, flags, mode);
 }
+QNX_REDIRECT(open);
 
 int _qnx_openat(int dirfd, const char *filename, int flags, ...)
 {
-    mode_t mode = 0;
-
-    va_list ap;
-    va_start(ap, flags);
-    mode = va_arg(ap, mode_t);
-    va_end(ap);
-    flags = qnx_flag_to_linux(flags);
-    return openat(dirfd, filename, flags, mode);
+	char buf[PATH_MAX];
+	mode_t mode = 0;
+	int fd;
+
+	if (flags & QNX_O_CREAT) {
+		va_list ap;
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+	flags = __qnx_oflags_to_linux(flags);
+	if ((fd = __qnx_bootfs_open(filename, flags)) != -2 ||
+	    (fd = __qnx_proc_open(filename, flags)) != -2)
+		return fd;
+	if (!(filename = __qnx_path_map(filename, buf)))
+		return -1;
+	return openat(dirfd, filename, flags, mode);
 }
+QNX_REDIRECT(openat);
+
+/* Only the file status flags differ; other commands pass through. */
+int _qnx_fcntl(int fd, int cmd, ...)
+{
+	unsigned long arg;
+	va_list ap;
+	int ret;
+
+	va_start(ap, cmd);
+	arg = va_arg(ap, unsigned long);
+	va_end(ap);
+
+	switch (cmd) {
+	case F_GETFL:
+		ret = fcntl(fd, F_GETFL);
+		return ret < 0 ? ret : __qnx_oflags_from_linux(ret);
+	case F_SETFL:
+		return fcntl(fd, F_SETFL, __qnx_oflags_to_linux(arg));
+	}
+	return fcntl(fd, cmd, arg);
+}
+QNX_REDIRECT(fcntl);
 
 int _qnx_creat(const char *filename, mode_t mode)
 {
+    char buf[PATH_MAX];
+    int fd;
+
+    if ((fd = __qnx_bootfs_open(filename, O_CREAT|O_WRONLY|O_TRUNC)) != -2)
+        return fd;
+    if (!(filename = __qnx_path_map(filename, buf)))
+        return -1;
     return creat(filename, mode);
 }
+QNX_REDIRECT(creat);
 
@@ -0,0 +1,417 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/auxv.h>
+#include <sys/mman.h>
+#include "atomic.h"
+#include "lock.h"
+#include "qnx_heap.h"
+
+/*
+ * Heap checking for QNX code that cannot be rebuilt with ASan
+ * (QNX_HEAP_CHECK=<n>), set up before any constructor runs:
+ *
+ * - One allocation in n (none for 0) of up to SLOT_PAGES pages goes to
+ *   a slot of its own in a pool of QNX_HEAP_SLOTS (default 256), placed
+ *   so that it ends where the slot's guard page starts. Reading or
+ *   writing past the end faults there at once; after free the slot's
+ *   pages are made inaccessible until it is reused, least recently
+ *   freed first, so a use after free faults too. With QNX_CRASH_TRACE
+ *   the trace says which block the address belongs to. The count is
+ *   global and not random, so a run can be repeated.
+ * - Every other block has a header with its size and a canary and at
+ *   least RED_ZONE bytes of RED_BYTE behind it, checked on free and
+ *   realloc. The process is killed on an overflow, a double free or a
+ *   pointer that is not a block.
+ * - Freed blocks of up to QUAR_BLOCK bytes are filled with FREE_BYTE and
+ *   held in a quarantine of QNX_HEAP_QUARANTINE KiB (default 4096) and
+ *   at most QUAR_MAX blocks before the allocator gets them back. A write
+ *   to one in the meantime is found when it leaves.
+ *
+ * realloc always moves the block, so stale pointers to the old one hit
+ * the quarantine or a freed slot.
+ */
+
+#define ALIGN 16
+#define RED_ZONE 16
+#define RED_BYTE 0xa5
+#define FREE_BYTE 0xdf
+#define LIVE 1
+#define FREED 2
+#define SLOT_PAGES 4
+#define QUAR_MAX 4096
+#define QUAR_BLOCK (64 << 10)
+
+struct block {
+	size_t size;
+	uint32_t canary;
+	unsigned char state, shift, pad[2];
+};
+
+struct slot {
+	unsigned char *p;
+	size_t size;
+	int state, next;
+};
+
+static volatile int lock[1];
+static uint32_t secret;
+static unsigned rate;
+static volatile int tick;
+
+static unsigned char *pool, *pool_end;
+static struct slot *slots;
+static size_t page;
+static int nslots, free_head = -1, free_tail = -1;
+
+static struct {
+	void *p[QUAR_MAX];
+	size_t head, count, bytes, max;
+} quar;
+
+void __qnx_heap_die(const char *who, const char *what, void *p)
+{
+	static const char hex[] = "0123456789abcdef";
+	char buf[128], *s = buf;
+	uintptr_t a = (uintptr_t)p;
+	int i;
+
+	s = stpcpy(s, who);
+	s = stpcpy(s, ": ");
+	s = stpcpy(s, what);
+	s = stpcpy(s, " 0x");
+	for (i = 2 * sizeof a - 1; i >= 0; i--)
+		*s++ = hex[a >> 4 * i & 15];
+	*s++ = '\n';
+	write(2, buf, s - buf);
+	a_crash();
+}
+
+static void die(const char *what, void *p)
+{
+	__qnx_heap_die("qnxheap", what, p);
+}
+
+static uint32_t canary(void *p)
+{
+	return secret ^ (uint32_t)((uintptr_t)p >> 4);
+}
+
+static size_t slot_size(void)
+{
+	return (SLOT_PAGES + 1) * page;
+}
+
+/* The pages of slot i that block p, with its header, lives in. */
+static unsigned char *slot_pages(int i, void *p, size_t *len)
+{
+	unsigned char *guard = pool + i * slot_size() + SLOT_PAGES * page;
+	unsigned char *start = (unsigned char *)
+		((uintptr_t)((struct block *)p - 1) & -page);
+
+	*len = guard - start;
+	return start;
+}
+
+static void red_zone(unsigned char *p, size_t n, size_t len)
+{
+	memset(p + n, RED_BYTE, len - n);
+}
+
+static void check_red_zone(unsigned char *p, size_t n, size_t len)
+{
+	for (size_t i = n; i < len; i++)
+		if (p[i] != RED_BYTE)
+			die("overflow past the end of", p);
+}
+
+static void *slot_alloc(size_t n, size_t align)
+{
+	unsigned char *start, *p;
+	struct block *b;
+	size_t len;
+	int i;
+
+	if (align < ALIGN)
+		align = ALIGN;
+	if (align > page || n > SLOT_PAGES * page - sizeof *b - align)
+		return 0;
+	LOCK(lock);
+	if ((i = free_head) < 0) {
+		UNLOCK(lock);
+		return 0;
+	}
+	if ((free_head = slots[i].next) < 0)
+		free_tail = -1;
+	UNLOCK(lock);
+
+	p = pool + i * slot_size() + SLOT_PAGES * page;
+	p = (unsigned char *)((uintptr_t)(p - n) & -align);
+	start = slot_pages(i, p, &len);
+	if (mprotect(start, len, PROT_READ | PROT_WRITE)) {
+		LOCK(lock);
+		slots[i].next = free_head;
+		free_head = i;
+		if (free_tail < 0)
+			free_tail = i;
+		UNLOCK(lock);
+		return 0;
+	}
+	b = (struct block *)p - 1;
+	b->size = n;
+	b->canary = canary(p);
+	b->state = LIVE;
+	red_zone(p, n, start + len - p);
+	slots[i].p = p;
+	slots[i].size = n;
+	slots[i].state = LIVE;
+	return p;
+}
+
+static int in_pool(void *p)
+{
+	return (unsigned char *)p >= pool && (unsigned char *)p < pool_end;
+}
+
+static void slot_free(void *p)
+{
+	int i = ((unsigned char *)p - pool) / slot_size();
+	unsigned char *start;
+	size_t len;
+
+	if (slots[i].p != p || slots[i].state != LIVE)
+		die(slots[i].p == p ? "double free of" : "free of a bad pointer",
+		    p);
+	start = slot_pages(i, p, &len);
+	check_red_zone(p, slots[i].size, start + len - (unsigned char *)p);
+	slots[i].state = FREED;
+	mprotect(start, len, PROT_NONE);
+	LOCK(lock);
+	slots[i].next = -1;
+	if (free_tail >= 0)
+		slots[free_tail].next = i;
+	else
+		free_head = i;
+	free_tail = i;
+	UNLOCK(lock);
+}
+
+static size_t block_len(size_t n)
+{
+	return (n + RED_ZONE + ALIGN - 1) & -ALIGN;
+}
+
+static struct block *check(void *p)
+{
+	struct block *b = (struct block *)p - 1;
+
+	if ((uintptr_t)p & (ALIGN - 1) || b->canary != canary(p))
+		die("free of a bad pointer", p);
+	if (b->state != LIVE)
+		die(b->state == FREED ? "double free of" : "free of a bad pointer",
+		    p);
+	check_red_zone(p, b->size, block_len(b->size));
+	return b;
+}
+
+static void *base_of(void *p, struct block *b)
+{
+	return (unsigned char *)p - ((size_t)1 << b->shift);
+}
+
+static void release(void *p)
+{
+	struct block *b = (struct block *)p - 1;
+	unsigned char *c = p;
+	size_t n;
+
+	for (n = 0; n < b->size; n++)
+		if (c[n] != FREE_BYTE)
+			die("write after free to", c + n);
+	__libc_free(base_of(p, b));
+}
+
+static void quarantine(void *p, struct block *b)
+{
+	void *out[8];
+	int n = 0;
+
+	if (b->size > QUAR_BLOCK || b->size > quar.max) {
+		__libc_free(base_of(p, b));
+		return;
+	}
+	memset(p, FREE_BYTE, b->size);
+	LOCK(lock);
+	while (quar.count &&
+	       (quar.count == QUAR_MAX || quar.bytes + b->size > quar.max)) {
+		void *q = quar.p[quar.head];
+		quar.head = (quar.head + 1) % QUAR_MAX;
+		quar.count--;
+		quar.bytes -= ((struct block *)q - 1)->size;
+		out[n++] = q;
+		if (n == sizeof out / sizeof *out)
+			break;
+	}
+	quar.p[(quar.head + quar.count++) % QUAR_MAX] = p;
+	quar.bytes += b->size;
+	UNLOCK(lock);
+	while (n)
+		release(out[--n]);
+}
+
+static void *block_alloc(size_t align, size_t n)
+{
+	unsigned char *base, *p;
+	struct block *b;
+	int shift = 4;
+
+	if (n > PTRDIFF_MAX - 2 * align - RED_ZONE) {
+		errno = ENOMEM;
+		return 0;
+	}
+	if (align > ALIGN) {
+		while ((size_t)1 << shift < align)
+			shift++;
+		base = __libc_aligned_alloc(align, align + block_len(n));
+	} else {
+		base = __libc_malloc_impl(ALIGN + block_len(n));
+	}
+	if (!base)
+		return 0;
+	p = base + ((size_t)1 << shift);
+	b = (struct block *)p - 1;
+	b->size = n;
+	b->canary = canary(p);
+	b->state = LIVE;
+	b->shift = shift;
+	red_zone(p, n, block_len(n));
+	return p;
+}
+
+static void *alloc(size_t align, size_t n)
+{
+	void *p;
+
+	if (rate && (unsigned)a_fetch_add(&tick, 1) % rate == 0 &&
+	    (p = slot_alloc(n, align)))
+		return p;
+	return block_alloc(align, n);
+}
+
+static void *check_malloc(size_t n)
+{
+	return alloc(ALIGN, n);
+}
+
+static void check_free(void *p)
+{
+	if (!p)
+		return;
+	if (in_pool(p)) {
+		slot_free(p);
+		return;
+	}
+	struct block *b = check(p);
+	b->state = FREED;
+	quarantine(p, b);
+}
+
+static size_t check_usable_size(void *p)
+{
+	if (!p)
+		return 0;
+	if (in_pool(p)) {
+		int i = ((unsigned char *)p - pool) / slot_size();
+		if (slots[i].p != p || slots[i].state != LIVE)
+			die("size of a bad pointer", p);
+		return slots[i].size;
+	}
+	return check(p)->size;
+}
+
+static void *check_realloc(void *p, size_t n)
+{
+	size_t old;
+	void *q;
+
+	if (!p)
+		return check_malloc(n);
+	old = check_usable_size(p);
+	if (!(q = check_malloc(n)))
+		return 0;
+	memcpy(q, p, old < n ? old : n);
+	check_free(p);
+	return q;
+}
+
+static void *check_aligned_alloc(size_t align, size_t n)
+{
+	if ((align & -align) != align || align > PTRDIFF_MAX / 4)
+		return __libc_aligned_alloc(align, n);
+	return alloc(align, n);
+}
+
+static const struct qnx_heap check_heap = {
+	check_malloc, check_free, check_realloc, check_aligned_alloc,
+	check_usable_size,
+};
+
+void __qnx_heap_check_init(void)
+{
+	const char *s = getenv("QNX_HEAP_CHECK");
+	const unsigned char *rand;
+
+	if (!s || !*s || __qnx_heap)
+		return;
+	rate = strtoul(s, 0, 10);
+	quar.max = 4096 << 10;
+	if ((s = getenv("QNX_HEAP_QUARANTINE")) && *s)
+		quar.max = strtoul(s, 0, 10) << 10;
+	nslots = 256;
+	if ((s = getenv("QNX_HEAP_SLOTS")) && *s)
+		nslots = atoi(s);
+	page = getpagesize();
+	if (rate && nslots > 0) {
+		size_t len = nslots * slot_size();
+		pool = mmap(0, len + nslots * sizeof *slots, PROT_NONE,
+			    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (pool == MAP_FAILED) {
+			pool = 0;
+			rate = 0;
+		} else {
+			pool_end = pool + len;
+			slots = (void *)pool_end;
+			mprotect(slots, nslots * sizeof *slots,
+				 PROT_READ | PROT_WRITE);
+			for (int i = 0; i < nslots; i++)
+				slots[i].next = i + 1 < nslots ? i + 1 : -1;
+			free_head = 0;
+			free_tail = nslots - 1;
+		}
+	}
+	secret = (uintptr_t)&secret * 1103515245 >> 16;
+	if ((rand = (void *)getauxval(AT_RANDOM)))
+		memcpy(&secret, rand + 12, sizeof secret);
+	__qnx_heap = &check_heap;
+}
+
+int __qnx_heap_where(const void *addr, struct qnx_heap_where *w)
+{
+	const unsigned char *a = addr;
+	int i;
+
+	if (!pool || !in_pool((void *)a))
+		return 0;
+	i = (a - pool) / slot_size();
+	if (!slots[i].p)
+		return 0;
+	w->block = slots[i].p;
+	w->size = slots[i].size;
+	w->what = slots[i].state == FREED ? "use after free of" :
+		  a >= slots[i].p + slots[i].size ? "overflow past the end of" :
+		  a < slots[i].p ? "underflow before" : "access to";
+	return 1;
+}
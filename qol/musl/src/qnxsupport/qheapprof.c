@@ -0,0 +1,308 @@
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/auxv.h>
+#include <sys/mman.h>
+#include "atomic.h"
+#include "lock.h"
+#include "qnx_crash.h"
+#include "qnx_heap.h"
+
+/*
+ * Sampling heap profiler (QNX_HEAP_PROFILE=<path>): the allocation in
+ * which the next sample point falls is sampled, and the distances
+ * between points are exponentially distributed with a mean of
+ * QNX_HEAP_PROFILE_RATE bytes (default 512 KiB), as in tcmalloc, so an
+ * n-byte block is sampled with probability 1 - exp(-n/rate). That is
+ * what pprof assumes when it scales samples back up. A sampled block's
+ * stack is recorded as crash traces get theirs (see crash.c), without
+ * the frames inside libc. The profile is
+ * written to <path>.<pid> at exit, and also on QNX_HEAP_PROFILE_SIGNAL
+ * (a Linux signal number) if set, in the legacy heap_v2 text format of
+ * gperftools that pprof reads:
+ *
+ *   pprof -sample_index=inuse_space <program> <path>.<pid>
+ *
+ * Each stack has its sampled objects and bytes still in use and ever
+ * allocated. The mappings are
+ * appended, so pprof finds the QNX libraries to symbolize against.
+ * Sampled blocks are looked up in a table on free, which is bounded
+ * (MAX_LIVE); allocations beyond it only count as allocated.
+ */
+
+#define MAX_DEPTH 32
+#define MAX_STACKS 8192
+#define MAX_LIVE 65536
+
+struct stack {
+	uint64_t hash;
+	int depth;
+	uintptr_t pc[MAX_DEPTH];
+	size_t inuse_objs, inuse_bytes, alloc_objs, alloc_bytes;
+};
+
+struct live {
+	void *p;
+	size_t size;
+	struct stack *st;
+};
+
+static const char *path;
+static unsigned rate;
+static volatile int left;
+static uint64_t rng;
+static volatile int lock[1];
+static struct stack *stacks;
+static struct live *live;
+static size_t nstacks, nlive;
+static void *libc_base;
+
+static size_t hash_ptr(void *p)
+{
+	uintptr_t a = (uintptr_t)p >> 4;
+
+	return (a ^ a >> 17) * 0x9e3779b97f4a7c15ULL >> 20 & (MAX_LIVE - 1);
+}
+
+static struct stack *find_stack(const uintptr_t *pc, int depth)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+	size_t i;
+
+	for (i = 0; i < (size_t)depth; i++)
+		h = (h ^ pc[i]) * 0x100000001b3ULL;
+	for (i = h; stacks[i % MAX_STACKS].depth; i++) {
+		struct stack *s = &stacks[i % MAX_STACKS];
+		if (s->hash == h && s->depth == depth &&
+		    !memcmp(s->pc, pc, depth * sizeof *pc))
+			return s;
+	}
+	if (nstacks >= MAX_STACKS * 7 / 8)
+		return 0;
+	nstacks++;
+	stacks[i % MAX_STACKS].hash = h;
+	stacks[i % MAX_STACKS].depth = depth;
+	memcpy(stacks[i % MAX_STACKS].pc, pc, depth * sizeof *pc);
+	return &stacks[i % MAX_STACKS];
+}
+
+/* With the lock held. */
+static void keep(void *p, size_t n, struct stack *st)
+{
+	size_t i;
+
+	if (nlive >= MAX_LIVE * 3 / 4)
+		return;
+	for (i = hash_ptr(p); live[i].p; i = (i + 1) % MAX_LIVE)
+		;
+	live[i] = (struct live){ p, n, st };
+	nlive++;
+	st->inuse_objs++;
+	st->inuse_bytes += n;
+}
+
+static int interval(void)
+{
+	double d;
+
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	d = -log(((rng >> 11) + 1) * 0x1p-53) * rate;
+	return d < INT_MAX / 2 ? (int)d + 1 : INT_MAX / 2;
+}
+
+/* Whether the next sample point is in the next n bytes. Threads race
+ * for the count, which only makes the distances a little less exact. */
+static int due(size_t n)
+{
+	if (n < INT_MAX / 2 && a_fetch_add(&left, -(int)n) > (int)n)
+		return 0;
+	a_store(&left, interval());
+	return 1;
+}
+
+static void record(void *p, size_t n)
+{
+	uintptr_t f[MAX_DEPTH + 16];
+	struct stack *st;
+	Dl_info info;
+	int depth, skip;
+
+	depth = __qnx_unwind((uintptr_t)record,
+			     (uintptr_t)__builtin_frame_address(0),
+			     (uintptr_t)f, f, sizeof f / sizeof *f);
+	for (skip = 0; skip < depth - 1; skip++)
+		if (!dladdr((void *)f[skip], &info) ||
+		    info.dli_fbase != libc_base)
+			break;
+	depth -= skip;
+	if (depth > MAX_DEPTH)
+		depth = MAX_DEPTH;
+
+	LOCK(lock);
+	if ((st = find_stack(f + skip, depth))) {
+		st->alloc_objs++;
+		st->alloc_bytes += n;
+		keep(p, n, st);
+	}
+	UNLOCK(lock);
+}
+
+/* Drops p from the sampled blocks if it is one. With the lock held. */
+static void forget(void *p)
+{
+	size_t i, j, k;
+
+	for (i = hash_ptr(p); live[i].p != p; i = (i + 1) % MAX_LIVE)
+		if (!live[i].p)
+			return;
+	live[i].st->inuse_objs--;
+	live[i].st->inuse_bytes -= live[i].size;
+	nlive--;
+	/* Backward shift deletion keeps every probe run unbroken. */
+	for (j = i; live[j = (j + 1) % MAX_LIVE].p;) {
+		k = hash_ptr(live[j].p);
+		if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+			live[i] = live[j];
+			i = j;
+		}
+	}
+	live[i].p = 0;
+}
+
+static void *prof_malloc(size_t n)
+{
+	void *p = __libc_malloc_impl(n);
+
+	if (p && due(n))
+		record(p, n);
+	return p;
+}
+
+static void prof_forget(void *p)
+{
+	if (p && nlive) {
+		LOCK(lock);
+		forget(p);
+		UNLOCK(lock);
+	}
+}
+
+static void prof_free(void *p)
+{
+	prof_forget(p);
+	__libc_free(p);
+}
+
+/* As a free and a new allocation, each sampled on its own. */
+static void *prof_realloc(void *p, size_t n)
+{
+	void *q;
+
+	if (!(q = __libc_realloc(p, n)))
+		return 0;
+	prof_forget(p);
+	if (due(n))
+		record(q, n);
+	return q;
+}
+
+static void *prof_aligned_alloc(size_t align, size_t n)
+{
+	void *p = __libc_aligned_alloc(align, n);
+
+	if (p && due(n))
+		record(p, n);
+	return p;
+}
+
+static const struct qnx_heap prof_heap = {
+	prof_malloc, prof_free, prof_realloc, prof_aligned_alloc,
+	__libc_malloc_usable_size,
+};
+
+static void dump(void)
+{
+	size_t io = 0, ib = 0, ao = 0, ab = 0, i;
+	char name[4096], buf[4096];
+	ssize_t n;
+	int fd, maps;
+	int j;
+
+	snprintf(name, sizeof name, "%s.%d", path, getpid());
+	if ((fd = open(name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0)
+		return;
+	for (i = 0; i < MAX_STACKS; i++) {
+		io += stacks[i].inuse_objs;
+		ib += stacks[i].inuse_bytes;
+		ao += stacks[i].alloc_objs;
+		ab += stacks[i].alloc_bytes;
+	}
+	dprintf(fd, "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%u\n", io, ib,
+		ao, ab, rate);
+	for (i = 0; i < MAX_STACKS; i++) {
+		struct stack *s = &stacks[i];
+		if (!s->alloc_objs)
+			continue;
+		dprintf(fd, "%zu: %zu [%zu: %zu] @", s->inuse_objs,
+			s->inuse_bytes, s->alloc_objs, s->alloc_bytes);
+		for (j = 0; j < s->depth; j++)
+			dprintf(fd, " %#lx", (unsigned long)s->pc[j]);
+		dprintf(fd, "\n");
+	}
+	dprintf(fd, "\nMAPPED_LIBRARIES:\n");
+	if ((maps = open("/proc/self/maps", O_RDONLY | O_CLOEXEC)) >= 0) {
+		while ((n = read(maps, buf, sizeof buf)) > 0)
+			write(fd, buf, n);
+		close(maps);
+	}
+	close(fd);
+}
+
+static void on_signal(int sig)
+{
+	dump();
+}
+
+void __qnx_heap_profile_init(void)
+{
+	const char *s = getenv("QNX_HEAP_PROFILE");
+	struct sigaction sa = { .sa_handler = on_signal,
+				.sa_flags = SA_RESTART };
+	size_t r = 512 << 10;
+	Dl_info info;
+
+	if (!s || !*s || __qnx_heap)
+		return;
+	path = s;
+	if ((s = getenv("QNX_HEAP_PROFILE_RATE")) && *s && strtoul(s, 0, 10))
+		r = strtoul(s, 0, 10);
+	rate = r < 1U << 30 ? r : 1U << 30;
+	rng = (uintptr_t)&rng * 0x9e3779b97f4a7c15ULL | 1;
+	if ((s = (void *)getauxval(AT_RANDOM)))
+		memcpy(&rng, s, sizeof rng);
+	rng |= 1;
+	left = interval();
+	stacks = mmap(0, MAX_STACKS * sizeof *stacks + MAX_LIVE * sizeof *live,
+		      PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (stacks == MAP_FAILED)
+		return;
+	live = (void *)(stacks + MAX_STACKS);
+	if (dladdr((void *)dump, &info))
+		libc_base = info.dli_fbase;
+	atexit(dump);
+	if ((s = getenv("QNX_HEAP_PROFILE_SIGNAL")) && *s) {
+		sigemptyset(&sa.sa_mask);
+		sigaction(atoi(s), &sa, 0);
+	}
+	__qnx_heap = &prof_heap;
+}
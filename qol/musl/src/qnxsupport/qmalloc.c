@@ -0,0 +1,166 @@
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include "qnx_malloc.h"
+#include "qnx_redirect.h"
+
+/*
+ * QNX mallopt, mallinfo and _malloc_stats over the knobs and counters
+ * of the malloc backend (see src/internal/qnx_malloc.h). The QNX
+ * commands become the nearest knob the tcache backend has:
+ *
+ * - MALLOC_ARENA_SIZE: how much is mapped at once for small objects,
+ *   rounded up to whole 256 KiB spans.
+ * - MALLOC_ARENA_CACHE_MAXSZ and MALLOC_ARENA_CACHE_MAXBLK: the bytes
+ *   and the number of freed large blocks (over 32 KiB) kept mapped for
+ *   reuse rather than unmapped, none by default;
+ *   MALLOC_ARENA_CACHE_FREE_NOW unmaps them.
+ * - MALLOC_MEMORY_HOLD and MALLOC_MONOTONIC_GROWTH: nothing is given
+ *   back, freed large blocks are all kept and realloc does not shrink.
+ *
+ * The debugging commands are accepted and do nothing. Small memory is
+ * never returned to the kernel in any case. With mallocng the tuning
+ * commands fail with EINVAL and the statistics are zero.
+ */
+
+#define MALLOC_VERIFY 1
+#define MALLOC_VERIFY_ON 2
+#define MALLOC_STATS 3
+#define MALLOC_FREE_CHECK 4
+#define MALLOC_ARENA_SIZE 5
+#define MALLOC_MONOTONIC_GROWTH 6
+#define MALLOC_MEMORY_HOLD 7
+#define MALLOC_ARENA_CACHE_MAXBLK 8
+#define MALLOC_ARENA_CACHE_MAXSZ 9
+#define MALLOC_ARENA_CACHE_FREE_NOW 10
+
+struct qnx_mallinfo {
+	int arena;
+	int ordblks;
+	int smblks;
+	int hblks;
+	int hblkhd;
+	int usmblks;
+	int fsmblks;
+	int uordblks;
+	int fordblks;
+	int keepcost;
+};
+
+struct qnx_malloc_stats {
+	unsigned m_small_freemem;
+	unsigned m_freemem;
+	unsigned m_small_overhead;
+	unsigned m_overhead;
+	unsigned m_small_allocmem;
+	unsigned m_allocmem;
+	unsigned m_pages;
+	unsigned m_hblocks;
+	unsigned m_blocks;
+	unsigned m_small_blocks;
+	unsigned m_mallocs;
+	unsigned m_frees;
+	unsigned m_reallocs;
+	unsigned m_callocs;
+};
+
+static int dummy_tune(int knob, size_t v)
+{
+	return -1;
+}
+weak_alias(dummy_tune, __malloc_tune);
+
+static void dummy_info(struct malloc_info *mi)
+{
+	memset(mi, 0, sizeof *mi);
+}
+weak_alias(dummy_info, __malloc_info);
+
+static int clamp(size_t n)
+{
+	return n > INT_MAX ? INT_MAX : n;
+}
+
+static unsigned uclamp(size_t n)
+{
+	return n > UINT_MAX ? UINT_MAX : n;
+}
+
+int _qnx_mallopt(int cmd, intptr_t value)
+{
+	int r;
+
+	if (value < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	switch (cmd) {
+	case MALLOC_VERIFY:
+	case MALLOC_VERIFY_ON:
+	case MALLOC_STATS:
+	case MALLOC_FREE_CHECK:
+		return 0;
+	case MALLOC_ARENA_SIZE:
+		r = __malloc_tune(MALLOC_TUNE_ARENA, value);
+		break;
+	case MALLOC_MONOTONIC_GROWTH:
+	case MALLOC_MEMORY_HOLD:
+		r = __malloc_tune(MALLOC_TUNE_HOLD, value);
+		break;
+	case MALLOC_ARENA_CACHE_MAXBLK:
+		r = __malloc_tune(MALLOC_TUNE_TRIM_BLOCKS, value);
+		break;
+	case MALLOC_ARENA_CACHE_MAXSZ:
+		r = __malloc_tune(MALLOC_TUNE_TRIM, value);
+		break;
+	case MALLOC_ARENA_CACHE_FREE_NOW:
+		r = __malloc_tune(MALLOC_TUNE_RELEASE, value);
+		break;
+	default:
+		r = -1;
+	}
+	if (r) errno = EINVAL;
+	return r;
+}
+QNX_REDIRECT(mallopt);
+
+/* Small objects are the "small blocks" and large allocations the
+ * "header blocks" of the SVID layout; the arena is the small spans. */
+struct qnx_mallinfo _qnx_mallinfo(void)
+{
+	struct malloc_info mi;
+	__malloc_info(&mi);
+	size_t used = mi.arena - mi.arena_free - mi.arena_overhead;
+	return (struct qnx_mallinfo){
+		.arena = clamp(mi.arena),
+		.ordblks = clamp(mi.free_objects + mi.kept),
+		.hblks = clamp(mi.large),
+		.hblkhd = clamp(mi.large_bytes),
+		.uordblks = clamp(used),
+		.fordblks = clamp(mi.arena_free + mi.kept_bytes),
+		.keepcost = clamp(mi.kept_bytes),
+	};
+}
+QNX_REDIRECT(mallinfo);
+
+/* The allocator does not count calls; those fields are 0. */
+int _qnx__malloc_stats(struct qnx_malloc_stats *st)
+{
+	struct malloc_info mi;
+	__malloc_info(&mi);
+	size_t used = mi.arena - mi.arena_free - mi.arena_overhead;
+	*st = (struct qnx_malloc_stats){
+		.m_small_freemem = uclamp(mi.arena_free),
+		.m_freemem = uclamp(mi.kept_bytes),
+		.m_small_overhead = uclamp(mi.arena_overhead),
+		.m_small_allocmem = uclamp(used),
+		.m_allocmem = uclamp(mi.large_bytes),
+		.m_pages = uclamp((mi.arena + mi.large_bytes + mi.kept_bytes) / 4096),
+		.m_hblocks = uclamp(mi.large),
+		.m_blocks = uclamp(mi.large + mi.kept),
+		.m_small_blocks = uclamp(mi.free_objects),
+	};
+	return 0;
+}
+QNX_REDIRECT(_malloc_stats);
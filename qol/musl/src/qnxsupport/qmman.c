@@ -0,0 +1,269 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysinfo.h>
+#include "qnx_redirect.h"
+#include "qnx_fcntl.h"
+#include "qnx_phys.h"
+
+/*
+ * mmap and the QNX shared and typed memory calls. QNX keeps
+ * MAP_SHARED, MAP_PRIVATE and MAP_FIXED where Linux has them but puts
+ * MAP_ANON at 0x80000, which Linux reads as MAP_SYNC, so every QNX
+ * mapping goes through a flag translation. MAP_PHYS | MAP_ANON memory
+ * comes from the fake physical address space in qphys.c, so that
+ * mem_offset can give its address.
+ *
+ * Other physically contiguous memory (SHMCTL_PHYS, typed memory opened
+ * with POSIX_TYPED_MEM_ALLOCATE*) is ordinary memory here; what is
+ * worth keeping is that such buffers are big, so they get huge pages. A
+ * SHM_ANON object sized to a multiple of 2M by shm_ctl is moved to a
+ * MFD_HUGETLB memfd when the kernel has huge pages to reserve for it,
+ * and allocating typed memory mappings use MAP_HUGETLB the same way,
+ * falling back to MADV_HUGEPAGE. Named objects stay in /dev/shm, as
+ * other processes find them by name there.
+ */
+
+#define QNX_PROT_NOCACHE 0x0800
+
+#define QNX_MAP_SHARED 0x00000001
+#define QNX_MAP_PRIVATE 0x00000002
+#define QNX_MAP_FIXED 0x00000010
+#define QNX_MAP_STACK 0x00001000
+#define QNX_MAP_PHYS 0x00010000
+#define QNX_MAP_ANON 0x00080000
+
+#define SHMCTL_ANON 0x0001
+#define SHMCTL_PHYS 0x0004
+
+#define QNX_SHM_ANON ((const char *)1)
+
+#define POSIX_TYPED_MEM_ALLOCATE 0x01
+#define POSIX_TYPED_MEM_ALLOCATE_CONTIG 0x02
+
+#define HUGE_SIZE (2UL << 20)
+
+/* What marks an allocating typed memory fd: an empty memfd sealed shut. */
+#define TMEM_SEALS (F_SEAL_SEAL | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE)
+
+#define SHM_ANON_NAME "qnx-shm-anon"
+#define TMEM_PATH "/dev/shm/qnx-tmem"
+
+struct qnx_typed_mem_info {
+	size_t posix_tmi_length;
+};
+
+static int linux_mflags(int flags)
+{
+	int f = flags & (QNX_MAP_SHARED | QNX_MAP_PRIVATE);
+
+	if (flags & QNX_MAP_FIXED)
+		f |= MAP_FIXED;
+	if (flags & QNX_MAP_ANON)
+		f |= MAP_ANONYMOUS;
+	if (flags & QNX_MAP_STACK)
+		f |= MAP_STACK;
+	return f;
+}
+
+static int tmem_fd(int fd)
+{
+	return fd >= 0 && fcntl(fd, F_GET_SEALS) == TMEM_SEALS;
+}
+
+/* Fresh memory for a mapping of allocating typed memory. */
+static void *map_huge(void *addr, size_t len, int prot, int flags)
+{
+	void *p = MAP_FAILED;
+
+	if (len >= HUGE_SIZE && !(len & (HUGE_SIZE - 1)))
+		p = mmap(addr, len, prot, flags | MAP_ANONYMOUS | MAP_HUGETLB,
+			 -1, 0);
+	if (p == MAP_FAILED) {
+		p = mmap(addr, len, prot, flags | MAP_ANONYMOUS, -1, 0);
+		if (p != MAP_FAILED && len >= HUGE_SIZE)
+			madvise(p, len, MADV_HUGEPAGE);
+	}
+	return p;
+}
+
+void *_qnx_mmap(void *addr, size_t len, int prot, int flags, int fd,
+		off_t off)
+{
+	int f = linux_mflags(flags);
+
+	prot &= ~QNX_PROT_NOCACHE;
+	if ((flags & (QNX_MAP_PHYS | QNX_MAP_ANON | QNX_MAP_FIXED)) ==
+	    (QNX_MAP_PHYS | QNX_MAP_ANON))
+		return __qnx_phys_anon(len);
+	if (!(f & MAP_ANONYMOUS) && tmem_fd(fd))
+		return map_huge(addr, len, prot, f);
+	return mmap(addr, len, prot, f, fd, off);
+}
+QNX_REDIRECT(mmap);
+
+void *_qnx_mmap64(void *addr, size_t len, int prot, int flags, int fd,
+		  off_t off)
+{
+	return _qnx_mmap(addr, len, prot, flags, fd, off);
+}
+QNX_REDIRECT(mmap64);
+
+int _qnx_munmap(void *addr, size_t len)
+{
+	return __qnx_phys_unmap(addr, len) ? 0 : munmap(addr, len);
+}
+QNX_REDIRECT(munmap);
+
+int _qnx_mprotect(void *addr, size_t len, int prot)
+{
+	return mprotect(addr, len, prot & ~QNX_PROT_NOCACHE);
+}
+QNX_REDIRECT(mprotect);
+
+int _qnx_shm_open(const char *name, int flags, mode_t mode)
+{
+	int lflags = __qnx_oflags_to_linux(flags);
+
+	if (name == QNX_SHM_ANON)
+		return memfd_create(SHM_ANON_NAME, MFD_CLOEXEC);
+	return shm_open(name, lflags, mode);
+}
+QNX_REDIRECT(shm_open);
+
+static int shm_anon(int fd)
+{
+	char link[32], target[sizeof "/memfd:" SHM_ANON_NAME];
+	ssize_t n;
+
+	snprintf(link, sizeof link, "/proc/self/fd/%d", fd);
+	n = readlink(link, target, sizeof target);
+	return n == sizeof target - 1 && !memcmp(target, "/memfd:" SHM_ANON_NAME,
+						  n);
+}
+
+/* Swap an empty SHM_ANON memfd for a huge page one of the same size. */
+static int shm_huge(int fd, uint64_t size)
+{
+	int hfd, fdflags;
+	void *p;
+
+	if ((hfd = memfd_create(SHM_ANON_NAME, MFD_HUGETLB)) < 0)
+		return -1;
+	/* Reserves the pages, so later faults cannot SIGBUS. */
+	if (ftruncate(hfd, size) < 0 ||
+	    (p = mmap(0, size, PROT_READ, MAP_SHARED, hfd, 0)) == MAP_FAILED) {
+		close(hfd);
+		return -1;
+	}
+	munmap(p, size);
+	fdflags = fcntl(fd, F_GETFD);
+	if (dup3(hfd, fd, fdflags & FD_CLOEXEC ? O_CLOEXEC : 0) < 0) {
+		close(hfd);
+		return -1;
+	}
+	close(hfd);
+	return 0;
+}
+
+/*
+ * SHMCTL_ANON sizes the object; SHMCTL_PHYS alone would name device
+ * memory at paddr, which there is none of.
+ */
+int shm_ctl(int fd, int flags, uint64_t paddr, uint64_t size)
+{
+	struct stat st;
+
+	(void)paddr;
+	if (!(flags & SHMCTL_ANON)) {
+		errno = flags & SHMCTL_PHYS ? ENOSYS : EINVAL;
+		return -1;
+	}
+	if (size > INT64_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (fstat(fd, &st) < 0)
+		return -1;
+	if (!st.st_size && size >= HUGE_SIZE && !(size & (HUGE_SIZE - 1)) &&
+	    shm_anon(fd) && !shm_huge(fd, size))
+		return 0;
+	return ftruncate(fd, size);
+}
+
+/* The special (cache attribute) argument has nothing to set here. */
+int shm_ctl_special(int fd, int flags, uint64_t paddr, uint64_t size,
+		    unsigned special)
+{
+	(void)special;
+	return shm_ctl(fd, flags, paddr, size);
+}
+
+/*
+ * Allocating typed memory gives fresh memory for every mmap, so its fd
+ * is only a marker. Opened without an allocate flag a pool maps as one
+ * region shared by all its users: a sparse /dev/shm file as large as
+ * RAM.
+ */
+int posix_typed_mem_open(const char *name, int oflag, int tflag)
+{
+	struct sysinfo si;
+	struct stat st;
+	char path[NAME_MAX];
+	uint64_t ram;
+	int acc = __qnx_oflags_to_linux(oflag) & O_ACCMODE, fd, i;
+
+	if (name[0] != '/' ||
+	    strlen(name) >= sizeof path - sizeof TMEM_PATH) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (tflag & (POSIX_TYPED_MEM_ALLOCATE |
+		     POSIX_TYPED_MEM_ALLOCATE_CONTIG)) {
+		if ((fd = memfd_create("qnx-tmem", MFD_ALLOW_SEALING)) < 0)
+			return -1;
+		if (fcntl(fd, F_ADD_SEALS, TMEM_SEALS) < 0) {
+			close(fd);
+			return -1;
+		}
+		return fd;
+	}
+
+	snprintf(path, sizeof path, TMEM_PATH "%s", name);
+	for (i = sizeof TMEM_PATH - 1; path[i]; i++)
+		if (path[i] == '/')
+			path[i] = '.';
+	if ((fd = open(path, acc | O_CREAT, 0666)) < 0)
+		return -1;
+	sysinfo(&si);
+	ram = (uint64_t)si.totalram * si.mem_unit;
+	if (acc != O_RDONLY && fstat(fd, &st) == 0 && st.st_size < ram &&
+	    ftruncate(fd, ram) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int posix_typed_mem_get_info(int fd, struct qnx_typed_mem_info *info)
+{
+	struct sysinfo si;
+	struct stat st;
+
+	if (tmem_fd(fd)) {
+		sysinfo(&si);
+		info->posix_tmi_length = (uint64_t)si.freeram * si.mem_unit;
+		return 0;
+	}
+	if (fstat(fd, &st) < 0)
+		return errno;
+	info->posix_tmi_length = st.st_size;
+	return 0;
+}
@@ -0,0 +1,646 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <mqueue.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "pthread_impl.h"
+#include "lock.h"
+#include "qnx_redirect.h"
+#include "qnx_fcntl.h"
+#include "qnx_time.h"
+#include "neutrino/neutrino.h"
+
+/*
+ * QNX message queues, in user space. QNX serves them from the mqueue
+ * resource manager under /dev/mqueue, with an attribute layout and
+ * limits of its own; Linux kernel queues cost a system call per
+ * message and cap mq_maxmsg low. Here a queue is a file under /dev/shm
+ * (qnx-mq.<name>, so that other processes find it by name) mapped by
+ * every process that opens it: a header, one FIFO bucket per priority
+ * and maxmsg message cells, each linked into a bucket or the free
+ * list. A bitmap of the non-empty buckets gives the best priority with
+ * one clz.
+ *
+ * Everything is under one lock word in the header, so a send or
+ * receive that neither blocks nor wakes anyone is two uncontended
+ * atomics and a copy. Blocked senders and receivers sleep on sequence
+ * words that are only bumped, and woken, while someone waits on them.
+ *
+ * An mq_notify registration is the pid of the registering process in
+ * the header. A thread of that process sleeps on notify_seq and sends
+ * the event from there, as a pulse or SIGEV_THREAD only means something
+ * in the process that asked for it.
+ */
+
+#define QNX_MQ_PRIO_MAX 32
+
+#define MQ_MAGIC 0x514d544e		/* "NTMQ" */
+#define MQ_VERSION 1
+#define MQ_PATH "/dev/shm/qnx-mq."
+#define MQ_FD_MAX 1024
+#define MQ_CELLS 4096			/* offset of the first cell */
+
+/* What an mq_open without attributes gets, as from QNX's mqueue */
+#define MQ_DEF_MAXMSG 1024
+#define MQ_DEF_MSGSIZE 4096
+
+struct qnx_mq_attr {
+	long mq_maxmsg;
+	long mq_msgsize;
+	long mq_flags;
+	long mq_curmsgs;
+	long mq_sendwait;
+	long mq_recvwait;
+};
+
+struct mq_cell {
+	int32_t next;
+	uint32_t len;
+	char data[];
+};
+
+struct mq_shm {
+	uint32_t magic, version;
+	uint32_t maxmsg, msgsize, stride;
+	volatile int lock;		/* 0 free, 1 held, 2 contended */
+	volatile int curmsgs;
+	volatile uint32_t prios;	/* bit p: bucket p is not empty */
+	int32_t free;			/* free cell list, -1 when full */
+	volatile int recv_seq;		/* bumped per send while recv_waiters */
+	volatile int recv_waiters;
+	volatile int send_seq;		/* bumped per receive while send_waiters */
+	volatile int send_waiters;
+	volatile int notify_pid;	/* mq_notify registrant, 0 if none */
+	volatile int notify_seq;	/* bumped when it fires or is dropped */
+	struct {
+		int32_t head, tail;
+	} bucket[QNX_MQ_PRIO_MAX];
+};
+
+/* A descriptor: the queue's fd, indexing mqs[] */
+struct mq {
+	struct mq_shm *shm;
+	size_t size;
+	int flags;			/* Linux O_ACCMODE and O_NONBLOCK */
+	volatile int refs;		/* the descriptor, a notify thread */
+	volatile int notify;		/* armed: the notify_seq it waits on + 1 */
+	struct nto_event ev;
+};
+
+static volatile int lock[1];
+static struct mq *mqs[MQ_FD_MAX];
+
+static struct mq_cell *cell(struct mq_shm *q, int32_t i)
+{
+	return (struct mq_cell *)((char *)q + MQ_CELLS + (size_t)i * q->stride);
+}
+
+static void qlock(volatile int *l)
+{
+	if (!a_cas(l, 0, 1))
+		return;
+	while (a_swap(l, 2))
+		__nto_wait(l, 2, 0);
+}
+
+static void qunlock(volatile int *l)
+{
+	if (a_swap(l, 0) == 2)
+		__nto_wake(l, 1);
+}
+
+static void undo_wait(void *waiters)
+{
+	a_dec(waiters);
+}
+
+static struct mq *mq_get(mqd_t mqd)
+{
+	return (unsigned)mqd < MQ_FD_MAX ? mqs[mqd] : 0;
+}
+
+static void mq_put(struct mq *m)
+{
+	if (a_fetch_add(&m->refs, -1) == 1) {
+		munmap(m->shm, m->size);
+		free(m);
+	}
+}
+
+/* /dev/shm path of a queue name; QNX takes names with or without a '/'. */
+static int mq_path(char *buf, size_t size, const char *name)
+{
+	size_t n, i;
+
+	while (*name == '/')
+		name++;
+	if (!*name)
+		return -ENOENT;
+	n = strlen(name);
+	if (n > NAME_MAX - sizeof MQ_PATH || sizeof MQ_PATH + n >= size)
+		return -ENAMETOOLONG;
+	memcpy(buf, MQ_PATH, sizeof MQ_PATH - 1);
+	for (i = 0; i <= n; i++)
+		buf[sizeof MQ_PATH - 1 + i] = name[i] == '/' ? '.' : name[i];
+	return 0;
+}
+
+static size_t mq_size(long maxmsg, long msgsize, uint32_t *stride)
+{
+	uint64_t s;
+
+	if (maxmsg <= 0 || msgsize <= 0 || maxmsg > INT32_MAX ||
+	    msgsize > INT32_MAX - 64)
+		return 0;
+	s = (sizeof(struct mq_cell) + msgsize + 15) & -16;
+	if (s * maxmsg > (SIZE_MAX >> 2) - MQ_CELLS)
+		return 0;
+	*stride = s;
+	return MQ_CELLS + s * maxmsg;
+}
+
+/*
+ * A new queue is built under a private name and linked into place, so
+ * openers only ever see it whole; -EEXIST when another one won.
+ */
+static int mq_create(const char *path, mode_t mode,
+		     const struct qnx_mq_attr *attr, struct mq *m)
+{
+	char tmp[sizeof MQ_PATH + NAME_MAX + 16];
+	struct mq_shm *q;
+	long maxmsg = attr ? attr->mq_maxmsg : MQ_DEF_MAXMSG;
+	long msgsize = attr ? attr->mq_msgsize : MQ_DEF_MSGSIZE;
+	uint32_t stride;
+	size_t size = mq_size(maxmsg, msgsize, &stride);
+	int fd, err;
+
+	if (!size)
+		return -EINVAL;
+	snprintf(tmp, sizeof tmp, "%s.%d", path, __pthread_self()->tid);
+	fd = open(tmp, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+	if (fd < 0)
+		return -errno;
+	if (ftruncate(fd, size) < 0 ||
+	    (q = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+		      0)) == MAP_FAILED) {
+		err = errno;
+		goto fail;
+	}
+	q->version = MQ_VERSION;
+	q->maxmsg = maxmsg;
+	q->msgsize = msgsize;
+	q->stride = stride;
+	for (int i = 0; i < QNX_MQ_PRIO_MAX; i++)
+		q->bucket[i].head = q->bucket[i].tail = -1;
+	for (int32_t i = 0; i < maxmsg; i++)
+		cell(q, i)->next = i + 1 < maxmsg ? i + 1 : -1;
+	q->free = 0;
+	a_store((volatile int *)&q->magic, MQ_MAGIC);
+	if (link(tmp, path) < 0) {
+		err = errno;
+		munmap(q, size);
+		goto fail;
+	}
+	unlink(tmp);
+	m->shm = q;
+	m->size = size;
+	return fd;
+
+fail:
+	close(fd);
+	unlink(tmp);
+	return -err;
+}
+
+static int mq_map(int fd, struct mq *m)
+{
+	struct stat st;
+	struct mq_shm *q;
+	uint32_t stride;
+
+	if (fstat(fd, &st) < 0)
+		return -errno;
+	if (st.st_size < MQ_CELLS)
+		return -EINVAL;
+	q = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (q == MAP_FAILED)
+		return -errno;
+	if (q->magic != MQ_MAGIC || q->version != MQ_VERSION ||
+	    mq_size(q->maxmsg, q->msgsize, &stride) != (size_t)st.st_size ||
+	    stride != q->stride) {
+		munmap(q, st.st_size);
+		return -EINVAL;
+	}
+	m->shm = q;
+	m->size = st.st_size;
+	return 0;
+}
+
+mqd_t _qnx_mq_open(const char *name, int oflag, ...)
+{
+	char path[sizeof MQ_PATH + NAME_MAX];
+	const struct qnx_mq_attr *attr = 0;
+	int lflags = __qnx_oflags_to_linux(oflag), fd, r;
+	mode_t mode = 0;
+	struct mq *m, *old;
+	va_list ap;
+
+	if (lflags & O_CREAT) {
+		va_start(ap, oflag);
+		mode = va_arg(ap, mode_t);
+		attr = va_arg(ap, const struct qnx_mq_attr *);
+		va_end(ap);
+	}
+	if ((r = mq_path(path, sizeof path, name)) < 0) {
+		errno = -r;
+		return -1;
+	}
+	if (!(m = calloc(1, sizeof *m)))
+		return -1;
+
+	for (;;) {
+		if (!(lflags & O_EXCL) &&
+		    (fd = open(path, O_RDWR | O_CLOEXEC)) >= 0) {
+			r = mq_map(fd, m);
+			break;
+		}
+		if (!(lflags & O_CREAT) || (!(lflags & O_EXCL) && errno != ENOENT)) {
+			free(m);
+			return -1;
+		}
+		fd = mq_create(path, mode, attr, m);
+		r = fd < 0 ? fd : 0;
+		if (fd != -EEXIST || (lflags & O_EXCL))
+			break;
+	}
+	if (r == 0 && fd >= MQ_FD_MAX)
+		r = -EMFILE;
+	if (r < 0) {
+		if (fd >= 0) {
+			if (m->shm)
+				munmap(m->shm, m->size);
+			close(fd);
+		}
+		free(m);
+		errno = -r;
+		return -1;
+	}
+	m->flags = lflags & (O_ACCMODE | O_NONBLOCK);
+	m->refs = 1;
+
+	/* An fd number last used by a queue that was close()d, not mq_close()d */
+	LOCK(lock);
+	old = mqs[fd];
+	mqs[fd] = m;
+	UNLOCK(lock);
+	if (old)
+		mq_put(old);
+	return fd;
+}
+QNX_REDIRECT(mq_open);
+
+/* Drops the process's registration if m holds it; the thread exits. */
+static void drop_notify(struct mq *m)
+{
+	struct mq_shm *q = m->shm;
+
+	if (!m->notify)
+		return;
+	qlock(&q->lock);
+	if (a_swap(&m->notify, 0) && q->notify_pid == getpid())
+		q->notify_pid = 0;
+	q->notify_seq++;
+	qunlock(&q->lock);
+	__nto_wake(&q->notify_seq, -1);
+}
+
+int _qnx_mq_close(mqd_t mqd)
+{
+	struct mq *m = 0;
+
+	LOCK(lock);
+	if ((unsigned)mqd < MQ_FD_MAX) {
+		m = mqs[mqd];
+		mqs[mqd] = 0;
+	}
+	UNLOCK(lock);
+	if (!m) {
+		errno = EBADF;
+		return -1;
+	}
+	drop_notify(m);
+	close(mqd);
+	mq_put(m);
+	return 0;
+}
+QNX_REDIRECT(mq_close);
+
+int _qnx_mq_unlink(const char *name)
+{
+	char path[sizeof MQ_PATH + NAME_MAX];
+	int r;
+
+	if ((r = mq_path(path, sizeof path, name)) < 0) {
+		errno = -r;
+		return -1;
+	}
+	return unlink(path);
+}
+QNX_REDIRECT(mq_unlink);
+
+static int mq_send_at(mqd_t mqd, const char *msg, size_t len, unsigned prio,
+		      clockid_t clk, const struct timespec *at)
+{
+	struct mq *m = mq_get(mqd);
+	struct mq_shm *q;
+	struct mq_cell *c;
+	int32_t i;
+	int seq, r, wake, notify;
+
+	if (!m || (m->flags & O_ACCMODE) == O_RDONLY) {
+		errno = EBADF;
+		return -1;
+	}
+	q = m->shm;
+	if (len > q->msgsize) {
+		errno = EMSGSIZE;
+		return -1;
+	}
+	if (prio >= QNX_MQ_PRIO_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	qlock(&q->lock);
+	while ((i = q->free) < 0) {
+		if (m->flags & O_NONBLOCK) {
+			qunlock(&q->lock);
+			errno = EAGAIN;
+			return -1;
+		}
+		seq = q->send_seq;
+		a_inc(&q->send_waiters);
+		qunlock(&q->lock);
+		pthread_cleanup_push(undo_wait, (void *)&q->send_waiters);
+		r = __timedwait_cp(&q->send_seq, seq, clk, at, 0);
+		pthread_cleanup_pop(1);
+		if (r == ETIMEDOUT || r == EINTR || r == EINVAL) {
+			errno = r;
+			return -1;
+		}
+		qlock(&q->lock);
+	}
+	c = cell(q, i);
+	q->free = c->next;
+	c->next = -1;
+	c->len = len;
+	memcpy(c->data, msg, len);
+	if (q->bucket[prio].tail < 0) {
+		q->bucket[prio].head = i;
+		q->prios |= 1u << prio;
+	} else {
+		cell(q, q->bucket[prio].tail)->next = i;
+	}
+	q->bucket[prio].tail = i;
+	/* As POSIX: only into an empty queue no receiver is waiting on. */
+	notify = !q->curmsgs++ && q->notify_pid && !q->recv_waiters;
+	if (notify) {
+		q->notify_pid = 0;
+		q->notify_seq++;
+	}
+	if ((wake = q->recv_waiters))
+		q->recv_seq++;
+	qunlock(&q->lock);
+	if (wake)
+		__nto_wake(&q->recv_seq, 1);
+	if (notify)
+		__nto_wake(&q->notify_seq, -1);
+	return 0;
+}
+
+static ssize_t mq_recv_at(mqd_t mqd, char *msg, size_t len, unsigned *prio,
+			  clockid_t clk, const struct timespec *at)
+{
+	struct mq *m = mq_get(mqd);
+	struct mq_shm *q;
+	struct mq_cell *c;
+	int32_t i;
+	int p, seq, r, wake;
+	uint32_t n;
+
+	if (!m || (m->flags & O_ACCMODE) == O_WRONLY) {
+		errno = EBADF;
+		return -1;
+	}
+	q = m->shm;
+	if (len < q->msgsize) {
+		errno = EMSGSIZE;
+		return -1;
+	}
+
+	qlock(&q->lock);
+	while (!q->prios) {
+		if (m->flags & O_NONBLOCK) {
+			qunlock(&q->lock);
+			errno = EAGAIN;
+			return -1;
+		}
+		seq = q->recv_seq;
+		a_inc(&q->recv_waiters);
+		qunlock(&q->lock);
+		pthread_cleanup_push(undo_wait, (void *)&q->recv_waiters);
+		r = __timedwait_cp(&q->recv_seq, seq, clk, at, 0);
+		pthread_cleanup_pop(1);
+		if (r == ETIMEDOUT || r == EINTR || r == EINVAL) {
+			errno = r;
+			return -1;
+		}
+		qlock(&q->lock);
+	}
+	p = 31 - a_clz_32(q->prios);
+	i = q->bucket[p].head;
+	c = cell(q, i);
+	if ((q->bucket[p].head = c->next) < 0) {
+		q->bucket[p].tail = -1;
+		q->prios &= ~(1u << p);
+	}
+	n = c->len;
+	memcpy(msg, c->data, n);
+	c->next = q->free;
+	q->free = i;
+	q->curmsgs--;
+	if ((wake = q->send_waiters))
+		q->send_seq++;
+	qunlock(&q->lock);
+	if (wake)
+		__nto_wake(&q->send_seq, 1);
+	if (prio)
+		*prio = p;
+	return n;
+}
+
+int _qnx_mq_send(mqd_t mqd, const char *msg, size_t len, unsigned prio)
+{
+	return mq_send_at(mqd, msg, len, prio, CLOCK_REALTIME, 0);
+}
+QNX_REDIRECT(mq_send);
+
+int _qnx_mq_timedsend(mqd_t mqd, const char *msg, size_t len, unsigned prio,
+		      const struct qnx_timespec *at)
+{
+	struct timespec ts;
+	return mq_send_at(mqd, msg, len, prio, CLOCK_REALTIME,
+			  __qnx_timespec_to_linux(at, &ts));
+}
+QNX_REDIRECT(mq_timedsend);
+
+int mq_timedsend_monotonic(mqd_t mqd, const char *msg, size_t len,
+			   unsigned prio, const struct qnx_timespec *at)
+{
+	struct timespec ts;
+	return mq_send_at(mqd, msg, len, prio, CLOCK_MONOTONIC,
+			  __qnx_timespec_to_linux(at, &ts));
+}
+
+ssize_t _qnx_mq_receive(mqd_t mqd, char *msg, size_t len, unsigned *prio)
+{
+	return mq_recv_at(mqd, msg, len, prio, CLOCK_REALTIME, 0);
+}
+QNX_REDIRECT(mq_receive);
+
+ssize_t _qnx_mq_timedreceive(mqd_t mqd, char *msg, size_t len, unsigned *prio,
+			     const struct qnx_timespec *at)
+{
+	struct timespec ts;
+	return mq_recv_at(mqd, msg, len, prio, CLOCK_REALTIME,
+			  __qnx_timespec_to_linux(at, &ts));
+}
+QNX_REDIRECT(mq_timedreceive);
+
+ssize_t mq_timedreceive_monotonic(mqd_t mqd, char *msg, size_t len,
+				  unsigned *prio, const struct qnx_timespec *at)
+{
+	struct timespec ts;
+	return mq_recv_at(mqd, msg, len, prio, CLOCK_MONOTONIC,
+			  __qnx_timespec_to_linux(at, &ts));
+}
+
+int _qnx_mq_getattr(mqd_t mqd, struct qnx_mq_attr *attr)
+{
+	struct mq *m = mq_get(mqd);
+	struct mq_shm *q;
+
+	if (!m) {
+		errno = EBADF;
+		return -1;
+	}
+	q = m->shm;
+	*attr = (struct qnx_mq_attr){
+		.mq_maxmsg = q->maxmsg,
+		.mq_msgsize = q->msgsize,
+		.mq_flags = __qnx_oflags_from_linux(m->flags & O_NONBLOCK),
+		.mq_curmsgs = q->curmsgs,
+		.mq_sendwait = q->send_waiters,
+		.mq_recvwait = q->recv_waiters,
+	};
+	return 0;
+}
+QNX_REDIRECT(mq_getattr);
+
+/* Only O_NONBLOCK can change, as the size of a queue is fixed. */
+int _qnx_mq_setattr(mqd_t mqd, const struct qnx_mq_attr *new,
+		    struct qnx_mq_attr *old)
+{
+	struct mq *m = mq_get(mqd);
+
+	if (!m) {
+		errno = EBADF;
+		return -1;
+	}
+	if (old)
+		_qnx_mq_getattr(mqd, old);
+	m->flags = (m->flags & ~O_NONBLOCK) |
+		   (__qnx_oflags_to_linux(new->mq_flags) & O_NONBLOCK);
+	return 0;
+}
+QNX_REDIRECT(mq_setattr);
+
+static void *notify_thread(void *p)
+{
+	struct mq *m = p;
+	struct mq_shm *q = m->shm;
+	int seq = m->notify - 1;
+
+	while (q->notify_seq == seq)
+		__nto_wait(&q->notify_seq, seq, 0);
+	/* Fired, unless drop_notify got there first. */
+	if (a_cas(&m->notify, seq + 1, 0) == seq + 1)
+		__nto_event_deliver(&m->ev, 0, SI_MESGQ);
+	mq_put(m);
+	return 0;
+}
+
+int _qnx_mq_notify(mqd_t mqd, const struct nto_event *ev)
+{
+	struct mq *m = mq_get(mqd);
+	struct mq_shm *q;
+	pid_t self = getpid(), pid;
+	pthread_attr_t a;
+	pthread_t th;
+	int r;
+
+	if (!m) {
+		errno = EBADF;
+		return -1;
+	}
+	q = m->shm;
+	if (!ev) {
+		drop_notify(m);
+		return 0;
+	}
+	if (__nto_event_check(ev, 0) < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	qlock(&q->lock);
+	/* A registrant that died without mq_close keeps nobody out. */
+	if ((pid = q->notify_pid) &&
+	    !(pid != self && kill(pid, 0) < 0 && errno == ESRCH)) {
+		qunlock(&q->lock);
+		errno = EBUSY;
+		return -1;
+	}
+	q->notify_pid = self;
+	m->ev = *ev;
+	if ((ev->sigev_notify & QNX_SIGEV_TYPE_MASK) == QNX_SIGEV_PULSE &&
+	    ev->un2.st.priority == QNX_SIGEV_PULSE_PRIO_INHERIT)
+		m->ev.un2.st.priority = __nto_priority();
+	m->notify = q->notify_seq + 1;
+	qunlock(&q->lock);
+
+	a_inc(&m->refs);
+	pthread_attr_init(&a);
+	pthread_attr_setdetachstate(&a, PTHREAD_CREATE_DETACHED);
+	r = pthread_create(&th, &a, notify_thread, m);
+	pthread_attr_destroy(&a);
+	if (r) {
+		drop_notify(m);
+		mq_put(m);
+		errno = EAGAIN;
+		return -1;
+	}
+	return 0;
+}
+QNX_REDIRECT(mq_notify);
@@ -0,0 +1,18 @@
+#ifndef QNX_CRASH_H
+#define QNX_CRASH_H
+
+#include <features.h>
+#include <stdint.h>
+
+/* QNX_CRASH_TRACE: fatal signal traces for triage, see crash.c */
+hidden void __qnx_crash_init(void);
+
+/* Up to max frames from pc, fp and sp into f, as the trace gives them:
+ * pc, then return addresses minus one. */
+hidden int __qnx_unwind(uintptr_t, uintptr_t, uintptr_t, uintptr_t *, int);
+
+/* The crash trace of a failed assert, before it aborts. */
+hidden void __qnx_crash_assert(const char *, const char *, unsigned,
+			       const char *, uintptr_t, uintptr_t);
+
+#endif
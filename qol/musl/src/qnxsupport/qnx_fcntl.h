@@ -0,0 +1,14 @@
+#ifndef QNX_FCNTL_H
+#define QNX_FCNTL_H
+
+#include <features.h>
+
+/* QNX <-> Linux open(2)/fcntl(F_GETFL) flag conversion, see qfcntl.c */
+hidden int __qnx_oflags_to_linux(int);
+hidden int __qnx_oflags_from_linux(int);
+
+/* devctl on an fd that is not a resource manager connection, see
+ * qdevctl.c; returns a Linux errno value. */
+hidden int __qnx_devctl(int, unsigned, void *, __SIZE_TYPE__, int *);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef QNX_PATH_H
+#define QNX_PATH_H
+
+#include <features.h>
+#include <stddef.h>
+#include <dirent.h>
+#include "qnx_stat.h"
+
+/* QNX_PATHMAP: QNX path prefixes mapped to host paths, see qpath.c */
+hidden void __qnx_path_init(void);
+
+/* path itself, or its host path written to buf (PATH_MAX bytes); 0 with
+ * errno ENAMETOOLONG if the host path does not fit. */
+hidden const char *__qnx_path_map(const char *, char *);
+
+/* QNX_PROC_BOOT: /proc/boot served from a cpio archive, see qbootfs.c.
+ * Like __nto_io_open, these return -2 for paths outside /proc/boot and
+ * leave them to the caller. open takes Linux flags. */
+hidden void __qnx_bootfs_init(void);
+hidden int __qnx_bootfs_open(const char *, int);
+hidden int __qnx_bootfs_stat(const char *, struct qnx_stat *);
+hidden int __qnx_bootfs_access(const char *, int);
+hidden int __qnx_bootfs_opendir(const char *, DIR **);
+hidden long __qnx_bootfs_next(DIR *, long, const char **, size_t *,
+			      struct qnx_stat *);
+
+#endif
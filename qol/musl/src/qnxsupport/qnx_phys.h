@@ -0,0 +1,11 @@
+#ifndef QNX_PHYS_H
+#define QNX_PHYS_H
+
+#include <features.h>
+#include <stddef.h>
+
+/* Fake physical memory for MAP_PHYS and device mappings, see qphys.c */
+hidden void *__qnx_phys_anon(size_t len);
+hidden int __qnx_phys_unmap(void *addr, size_t len);
+
+#endif
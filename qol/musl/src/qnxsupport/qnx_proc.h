@@ -0,0 +1,65 @@
+#ifndef QNX_PROC_H
+#define QNX_PROC_H
+
+#include <features.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "qnx_signal.h"
+
+/* QNX 7 procfs_info (debug_process_t), 272 bytes. */
+struct qnx_debug_process {
+	int32_t pid, parent;
+	uint32_t flags, umask;
+	int32_t child, sibling, pgrp, sid;
+	uint64_t base_address, initial_stack;
+	uint32_t uid, gid, euid, egid, suid, sgid;
+	qnx_sigset_t sig_ignore, sig_queue, sig_pending;
+	uint32_t num_chancons, num_fdcons, num_threads, num_timers;
+	uint64_t start_time, utime, stime, cutime, cstime;
+	uint8_t priority, reserved2[7];
+	uint8_t extsched[8];
+	uint64_t pls, sigstub, canstub, private_mem;
+	uint32_t appid, type_id;
+	uint64_t reserved[8];
+};
+
+/* QNX 7 procfs_status (debug_thread_t), 216 bytes; the fields past
+ * sig_pending that Linux has nothing for are opaque here. */
+struct qnx_debug_thread {
+	int32_t pid, tid;
+	uint32_t flags;
+	uint16_t why, what;
+	uint64_t ip, sp, stkbase, tls;
+	uint32_t stksize, tid_flags;
+	uint8_t priority, real_priority, policy, state;
+	int16_t syscall;
+	uint16_t last_cpu;
+	uint32_t timeout;
+	int32_t last_chid;
+	qnx_sigset_t sig_blocked, sig_pending;
+	uint64_t info[6], blocked[2];
+	uint64_t start_time, sutime;
+	uint8_t extsched[8];
+	uint64_t nsec_since_block;
+	uint64_t reserved[4];
+};
+
+/* QNX procfs_mapinfo, 40 bytes. */
+struct qnx_mapinfo {
+	uint64_t vaddr, size;
+	uint32_t flags, dev;
+	int64_t offset;
+	uint64_t ino;
+};
+
+/* /proc/<pid>/as and /proc/<pid>/ctl, see qproc.c. Like
+ * __qnx_bootfs_open, returns -2 for other paths; flags are Linux's. */
+hidden int __qnx_proc_open(const char *, int);
+
+/* DCMD_PROC_* handlers of the devctl table in qdevctl.c; return a
+ * Linux errno value. */
+hidden int __qnx_proc_info(int, void *, unsigned long);
+hidden int __qnx_proc_status(int, void *, unsigned long);
+hidden int __qnx_proc_mapinfo(int, void *, size_t, int *);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef QNX_SCHED_H
+#define QNX_SCHED_H
+
+#include <features.h>
+#include <stdint.h>
+#include "qnx_time.h"
+
+#define QNX_SCHED_FIFO 1
+#define QNX_SCHED_RR 2
+#define QNX_SCHED_OTHER 3
+#define QNX_SCHED_SPORADIC 4
+
+/* QNX struct sched_param: 48 bytes on 64-bit targets, 40 on armle-v7.
+ * It differs from musl's only past sched_priority, the one field
+ * either side uses. */
+struct qnx_sched_param {
+	int32_t sched_priority;
+	int32_t sched_curpriority;
+	union {
+		int32_t reserved[8];
+		struct {
+			int32_t __ss_low_priority;
+			int32_t __ss_max_repl;
+			struct qnx_timespec __ss_repl_period;
+			struct qnx_timespec __ss_init_budget;
+		} __ss;
+	} __ss_un;
+};
+
+/* QNX -> Linux scheduling policy and priority, see qthread.c */
+hidden int __qnx_policy_to_linux(int);
+hidden int __qnx_prio_to_linux(int policy, int prio);
+
+/* QNX runmask bits <-> Linux CPU sets, see qthread.c */
+hidden void __qnx_cpu_init(void);
+hidden int __qnx_cpus(const unsigned short **);
+hidden int __qnx_runmask_to_linux(const unsigned *, int, void *);
+hidden void __qnx_runmask_from_linux(const void *, unsigned *, int);
+
+/* The system page, see syspage.c */
+hidden void __qnx_syspage_init(void);
+
+#endif
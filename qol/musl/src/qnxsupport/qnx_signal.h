@@ -0,0 +1,25 @@
+#ifndef QNX_SIGNAL_H
+#define QNX_SIGNAL_H
+
+#include <features.h>
+#include <stdint.h>
+#include <signal.h>
+
+typedef struct {
+	uint32_t __bits[2];
+} qnx_sigset_t;
+
+/* QNX <-> Linux signal number and signal set conversion, see signal.c */
+hidden int __qnx_signo_to_linux(int);
+hidden int __qnx_signo_from_linux(int);
+hidden void __qnx_sigset_to_linux(const qnx_sigset_t *, sigset_t *);
+hidden void __qnx_sigset_from_linux(const sigset_t *, qnx_sigset_t *);
+
+/* Notes that the calling thread's signal mask may have changed, see
+ * sigjump.c */
+hidden void __qnx_sigmask_changed(void);
+
+/* Count of window size changes, or -1 if they cannot be seen. */
+hidden int __qnx_winch_gen(void);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef QNX_SOCK_H
+#define QNX_SOCK_H
+
+#include <features.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+struct qnx_sockaddr {
+	uint8_t sa_len;
+	uint8_t sa_family;
+	char sa_data[14];
+};
+
+/* QNX <-> Linux socket address and flag conversion, see sock.c */
+hidden int __qnx_sa_to_linux(const void *, socklen_t,
+			     struct sockaddr_storage *);
+hidden void __qnx_sa_from_linux(const struct sockaddr_storage *, socklen_t,
+				void *, socklen_t *);
+hidden int __qnx_msg_flags_to_linux(int);
+hidden int __qnx_msg_flags_from_linux(int);
+
+/* Receive coalescing (QNX_SOCK_RECVBATCH), see sockmsg.c; returns -2
+ * when the call must go to the kernel directly. */
+struct iovec;
+hidden ssize_t __qnx_recv_batched(int, const struct iovec *, int,
+				  struct sockaddr_storage *, socklen_t *,
+				  int *);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef QNX_STACK_H
+#define QNX_STACK_H
+
+#include <features.h>
+
+/* Main thread stack bounds for stackavail(), see stackavail.c */
+hidden void __qnx_stack_init(void);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef QNX_STAT_H
+#define QNX_STAT_H
+
+#include <stdint.h>
+#include "qnx_time.h"
+
+typedef uint64_t qnx_ino_t;
+typedef uint64_t qnx_off_t;
+typedef uint32_t qnx_dev_t;
+typedef uint32_t qnx_uid_t;
+typedef uint32_t qnx_gid_t;
+typedef uint32_t qnx__Time32t;
+typedef uint32_t qnx_mode_t;
+typedef uint32_t qnx_nlink_t;
+typedef uint32_t qnx_blksize_t;
+typedef uint64_t qnx_blkcnt_t;
+
+struct qnx_stat {
+	qnx_ino_t st_ino;
+	qnx_off_t st_size;
+	qnx_dev_t st_dev;
+	qnx_dev_t st_rdev;
+	qnx_uid_t st_uid;
+	qnx_gid_t st_gid;
+	qnx__Time32t __old_st_mtime;
+	qnx__Time32t __old_st_atime;
+	qnx__Time32t __old_st_ctime;
+	qnx_mode_t st_mode;
+	qnx_nlink_t st_nlink;
+	qnx_blksize_t st_blocksize;
+	uint32_t st_nblocks;
+	qnx_blksize_t st_blksize;
+	qnx_blkcnt_t st_blocks;
+	struct qnx_timespec st_mtim;
+	struct qnx_timespec st_atim;
+	struct qnx_timespec st_ctim;
+};
+
+int _qnx_stat_fields(int, const char *restrict, int, unsigned,
+		     struct qnx_stat *restrict);
+
+#endif
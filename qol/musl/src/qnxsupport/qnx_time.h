@@ -0,0 +1,31 @@
+#ifndef QNX_TIME_H
+#define QNX_TIME_H
+
+#include <features.h>
+#include <stdint.h>
+#include <time.h>
+#include "qnx_arch.h"
+
+/* struct timespec as QNX programs of this architecture see it */
+struct qnx_timespec {
+	qnx_time_t tv_sec;
+	long tv_nsec;
+};
+
+/* t as a struct timespec held in buf, or 0 for a null t */
+static inline struct timespec *__qnx_timespec_to_linux(const struct qnx_timespec *t,
+						       struct timespec *buf)
+{
+	if (!t)
+		return 0;
+	*buf = (struct timespec){ t->tv_sec, t->tv_nsec };
+	return buf;
+}
+
+/* QNX -> Linux clock id, -1 if there is none, see qtime.c */
+hidden clockid_t __qnx_clock_to_linux(clockid_t);
+
+/* ClockCycles rate, known once __qnx_syspage_init has run */
+hidden uint64_t __qnx_cycles_per_sec(void);
+
+#endif
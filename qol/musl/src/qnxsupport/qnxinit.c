@@ -1,18 +1,43 @@
 #include "libc.h"
 #include "locale_impl.h"
 #include "stdio.h"
+#include "dynlink.h"
 #include <stddef.h>
+#include <stdlib.h>
+#include "qnx_sched.h"
+#include "qnx_afl.h"
+#include "qnx_crash.h"
+#include "qnx_stack.h"
+#include "qnx_heap.h"
+#include "qnx_string.h"
+#include "qnx_stdio.h"
+#include "qnx_path.h"
+#include "qnx_stats.h"
 
 void _init_libc(int argc, char *argv[], char *arge[], void *auxv,
 		void (*exit_func)(void))
 {
+	__qnx_string_init();
 	__init_libc(arge, argv[0]);
+	__qnx_cpu_init();
+	__qnx_syspage_init();
+	__qnx_stack_init();
+	__qnx_heap_check_init();
+	__qnx_heap_profile_init();
+	__qnx_crash_init();
+	__qnx_stdio_init();
+	__qnx_path_init();
+	__qnx_bootfs_init();
+	__qnx_stats_init();
 
 	void (*f)(void) = __libc_start_init;
 	__asm__ ( "" : "+r"(f) : : "memory" );
 	f();
 
 	CURRENT_LOCALE = C_LOCALE;
+
+	if (__qnx_afl_forksrv)
+		__qnx_afl_point(0);
 }
 
 void _preinit_array(void (**start)(void), void (**end)(void))
@@ -23,33 +48,34 @@ void _preinit_array(void (**start)(void), void (**end)(void))
 	}
 }
 
-void _init_array(void (**start)(void), void (**end)(void))
-{
-	// printf("init_array: start %p, end %p\n", start, end);
-	// void (**f)(void);
-	// for (f = start; f < end; f++) {
-	// 	(*f)();
-	// }
-}
-void _fini_array(void (**start)(void), void (**end)(void))
+static int stub_array_owned(void (**start)(void), int fini)
 {
-	// printf("fini_array: start %p, end %p\n", start, end);
-	// void (**f)(void);
-	// for (f = start; f < end; f++) {
-	// 	atexit(*f);
-	// }
+	return 0;
 }
 
-int *__get_errno_ptr(void)
+weak_alias(stub_array_owned, __dl_qnx_array_owned);
+
+/* The dynamic linker runs the init and fini arrays of everything it
+ * loaded, including the program, so these only have work to do for
+ * arrays it does not know about, e.g. in a static link. */
+void _init_array(void (**start)(void), void (**end)(void))
 {
-	return &errno;
+	void (**f)(void);
+	if (start == end || __dl_qnx_array_owned(start, 0))
+		return;
+	for (f = start; f < end; f++) {
+		(*f)();
+	}
 }
 
-int tcgetsize(int filedes, int *prows, int *pcols)
+void _fini_array(void (**start)(void), void (**end)(void))
 {
-	if (prows != NULL)
-		*prows = 24;
-	if (pcols != NULL)
-		*pcols = 80;
-	return 0;
+	void (**f)(void);
+	if (start == end || __dl_qnx_array_owned(start, 1))
+		return;
+	/* atexit runs handlers in reverse order of registration, which
+	 * is the order fini arrays are run in. */
+	for (f = start; f < end; f++) {
+		atexit(*f);
+	}
 }
@@ -0,0 +1,240 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../dirent/__dirent.h"
+#include "stdio_impl.h"
+#include "qnx_redirect.h"
+#include "qnx_path.h"
+
+/*
+ * QNX_PATHMAP=<file> maps QNX path prefixes to host paths, so that a
+ * QNX program finds /proc/boot, /etc/system/config and the like without
+ * a chroot. Each line of the file is "<qnx prefix> <host prefix>", both
+ * absolute; blank lines and lines starting with # are skipped, and a
+ * later line for the same prefix replaces an earlier one. A prefix
+ * matches whole components only, and the longest one wins; "/" maps
+ * every absolute path that no longer prefix maps. /dev/shmem, where QNX
+ * keeps shm_open objects, is always mapped to /dev/shm, where Linux
+ * keeps them, unless the file says otherwise.
+ *
+ * The file is read once at startup into a trie with a node per path
+ * component, in one anonymous mapping pointing into the file's own
+ * mapping, neither ever freed. Lookups walk the trie without locking
+ * or allocating and write the host path into the caller's buffer.
+ * Relative paths are left alone: a directory fd opened through the map
+ * already names the host directory. ".." is resolved by the host after
+ * the mapping, so "/proc/boot/.." is the parent of the host directory.
+ */
+
+struct pnode {
+	const char *name, *host;
+	size_t len, hlen;
+	struct pnode *child, *next;
+};
+
+static struct pnode builtin[3] = {
+	{ .child = &builtin[1] },
+	{ .name = "dev", .len = 3, .child = &builtin[2] },
+	{ .name = "shmem", .len = 5, .host = "/dev/shm", .hlen = 8 },
+};
+
+static struct pnode *const root = builtin, *nodes;
+static size_t nnodes, maxnodes;
+
+static struct pnode *child(struct pnode *n, const char *name, size_t len,
+			   int add)
+{
+	struct pnode *c;
+
+	for (c = n->child; c; c = c->next)
+		if (c->len == len && !memcmp(c->name, name, len))
+			return c;
+	if (!add || nnodes == maxnodes)
+		return 0;
+	c = &nodes[nnodes++];
+	c->name = name;
+	c->len = len;
+	c->next = n->child;
+	n->child = c;
+	return c;
+}
+
+static void add(const char *q, const char *qe, const char *h, const char *he)
+{
+	struct pnode *n = root;
+	const char *s;
+
+	while (q < qe) {
+		if (*q == '/') {
+			q++;
+			continue;
+		}
+		for (s = q; s < qe && *s != '/'; s++);
+		if (!(n = child(n, q, s - q, 1)))
+			return;
+		q = s;
+	}
+	while (he > h && he[-1] == '/')
+		he--;
+	n->host = h;
+	n->hlen = he - h;
+}
+
+static const char *token(const char *p, const char *e)
+{
+	while (p < e && *p != ' ' && *p != '\t' && *p != '\r')
+		p++;
+	return p;
+}
+
+static const char *blanks(const char *p, const char *e)
+{
+	while (p < e && (*p == ' ' || *p == '\t' || *p == '\r'))
+		p++;
+	return p;
+}
+
+void __qnx_path_init(void)
+{
+	const char *s = getenv("QNX_PATHMAP"), *p, *e, *le, *q, *qe, *h;
+	struct stat st;
+	char *map;
+	int fd;
+
+	if (!s || !*s || (fd = open(s, O_RDONLY | O_CLOEXEC)) < 0)
+		return;
+	if (fstat(fd, &st) || !st.st_size ||
+	    (map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) ==
+		    MAP_FAILED) {
+		close(fd);
+		return;
+	}
+	close(fd);
+
+	/* Every component takes at least two bytes of the file. */
+	maxnodes = st.st_size / 2 + 1;
+	nodes = mmap(0, maxnodes * sizeof *nodes, PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (nodes == MAP_FAILED) {
+		munmap(map, st.st_size);
+		return;
+	}
+
+	for (p = map, e = map + st.st_size; p < e; p = le + 1) {
+		if (!(le = memchr(p, '\n', e - p)))
+			le = e;
+		q = blanks(p, le);
+		qe = token(q, le);
+		h = blanks(qe, le);
+		if (q < le && *q == '/' && h < le && *h == '/')
+			add(q, qe, h, token(h, le));
+	}
+}
+
+const char *__qnx_path_map(const char *path, char *buf)
+{
+	struct pnode *n = root, *best;
+	const char *p = path, *rest = path, *s;
+	size_t l;
+
+	if (*path != '/')
+		return path;
+	best = n->host ? n : 0;
+	for (;;) {
+		while (*p == '/')
+			p++;
+		for (s = p; *s && *s != '/'; s++);
+		if (s == p || !(n = child(n, p, s - p, 0)))
+			break;
+		p = s;
+		if (n->host) {
+			best = n;
+			rest = p;
+		}
+	}
+	if (!best)
+		return path;
+
+	l = strlen(rest);
+	if (best->hlen + l >= PATH_MAX) {
+		errno = ENAMETOOLONG;
+		return 0;
+	}
+	memcpy(buf, best->host, best->hlen);
+	memcpy(buf + best->hlen, rest, l + 1);
+	if (!*buf) {
+		buf[0] = '/';
+		buf[1] = 0;
+	}
+	return buf;
+}
+
+/* Shims that only need the path mapped, or served from QNX_PROC_BOOT;
+ * the QNX and Linux versions agree on everything else. */
+FILE *_qnx_fopen(const char *restrict filename, const char *restrict mode)
+{
+	char buf[PATH_MAX];
+	FILE *f;
+	int fd;
+
+	if (!strchr("rwa", *mode)) {
+		errno = EINVAL;
+		return 0;
+	}
+	if ((fd = __qnx_bootfs_open(filename, __fmodeflags(mode))) != -2) {
+		if (fd < 0)
+			return 0;
+		if (!(f = fdopen(fd, mode)))
+			close(fd);
+		return f;
+	}
+	if (!(filename = __qnx_path_map(filename, buf)))
+		return 0;
+	return fopen(filename, mode);
+}
+QNX_REDIRECT(fopen);
+
+DIR *_qnx_opendir(const char *name)
+{
+	char buf[PATH_MAX];
+	DIR *dir;
+	int ret;
+
+	if ((ret = __qnx_bootfs_opendir(name, &dir)) != -2)
+		return ret ? 0 : dir;
+	if (!(name = __qnx_path_map(name, buf)))
+		return 0;
+	return opendir(name);
+}
+QNX_REDIRECT(opendir);
+
+int _qnx_closedir(DIR *dir)
+{
+	if (dir->fd < 0) {
+		free(dir);
+		return 0;
+	}
+	return closedir(dir);
+}
+QNX_REDIRECT(closedir);
+
+int _qnx_access(const char *filename, int amode)
+{
+	char buf[PATH_MAX];
+	int ret;
+
+	if ((ret = __qnx_bootfs_access(filename, amode)) != -2)
+		return ret;
+	if (!(filename = __qnx_path_map(filename, buf)))
+		return -1;
+	return access(filename, amode);
+}
+QNX_REDIRECT(access);
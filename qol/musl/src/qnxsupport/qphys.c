@@ -0,0 +1,288 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "lock.h"
+#include "qnx_phys.h"
+
+/*
+ * A fake physical address space, so that driver-style code can run:
+ * mmap_device_memory of an address gives memory that stays the same
+ * for that address, and mem_offset of memory from MAP_PHYS | MAP_ANON
+ * gives its address back.
+ *
+ * Backing pages come from one sparse memfd, mapped whole on first use;
+ * a radix table indexed by physical page number (three levels of 4096
+ * entries, for 48-bit addresses) holds each bound page's index in it.
+ * Pages are bound in runs, in the order they are first touched, so a
+ * range bound in one go is contiguous in the window and maps without a
+ * system call. Only ranges whose pages were bound separately need the
+ * pieces mapped next to each other. MAP_PHYS memory draws addresses
+ * from above 1 TiB, clear of anything a device would use; its pages
+ * are given back to the kernel on munmap, whereas device memory keeps
+ * its contents for the life of the process, as a device would.
+ */
+
+#define PAGE 4096UL
+#define RADIX_BITS 12
+#define RADIX (1 << RADIX_BITS)
+#define PHYS_BITS 48
+#define WINDOW_SIZE (16UL << 30)
+#define ANON_BASE (1ULL << 40)
+
+#define QNX_MAP_FIXED 0x00000010
+#define QNX_PROT_NOCACHE 0x0800
+
+struct run {
+	uint64_t back, phys, len;
+	int anon;
+};
+
+static uint32_t **radix[RADIX];
+static char *window;
+static int back_fd = -1;
+static uint64_t back_next, anon_next = ANON_BASE;
+static struct run *runs;
+static size_t nruns, runs_cap;
+static volatile int lock[1];
+
+static int init(void)
+{
+	int fd;
+	void *p;
+
+	if (window)
+		return 0;
+	if ((fd = memfd_create("qnx-phys", MFD_CLOEXEC)) < 0)
+		return -1;
+	if (ftruncate(fd, WINDOW_SIZE) < 0 ||
+	    (p = mmap(0, WINDOW_SIZE, PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_NORESERVE, fd, 0)) == MAP_FAILED) {
+		close(fd);
+		errno = ENOMEM;
+		return -1;
+	}
+	back_fd = fd;
+	window = p;
+	return 0;
+}
+
+/* The entry for page frame pfn: backing page index + 1, or 0. */
+static uint32_t *entry(uint64_t pfn, int create)
+{
+	uint32_t ***top = &radix[pfn >> 2 * RADIX_BITS & (RADIX - 1)];
+	uint32_t **mid;
+
+	if (!*top && !(create && (*top = calloc(RADIX, sizeof **top))))
+		return 0;
+	mid = &(*top)[pfn >> RADIX_BITS & (RADIX - 1)];
+	if (!*mid && !(create && (*mid = calloc(RADIX, sizeof **mid))))
+		return 0;
+	return &(*mid)[pfn & (RADIX - 1)];
+}
+
+static int add_run(uint64_t back, uint64_t phys, uint64_t len, int anon)
+{
+	if (nruns && runs[nruns - 1].anon == anon &&
+	    runs[nruns - 1].back + runs[nruns - 1].len == back &&
+	    runs[nruns - 1].phys + runs[nruns - 1].len == phys) {
+		runs[nruns - 1].len += len;
+		return 0;
+	}
+	if (nruns == runs_cap) {
+		size_t cap = runs_cap ? 2 * runs_cap : 64;
+		struct run *r = realloc(runs, cap * sizeof *r);
+		if (!r)
+			return -1;
+		runs = r;
+		runs_cap = cap;
+	}
+	runs[nruns++] = (struct run){ back, phys, len, anon };
+	return 0;
+}
+
+/* Back every unbound page of [pfn, pfn + n), consecutively. */
+static int bind(uint64_t pfn, uint64_t n, int anon)
+{
+	for (uint64_t i = 0; i < n; i++) {
+		uint32_t *e = entry(pfn + i, 1);
+		if (!e) {
+			errno = ENOMEM;
+			return -1;
+		}
+		if (*e)
+			continue;
+		if (back_next + PAGE > WINDOW_SIZE ||
+		    add_run(back_next, (pfn + i) * PAGE, PAGE, anon) < 0) {
+			errno = ENOMEM;
+			return -1;
+		}
+		*e = back_next / PAGE + 1;
+		back_next += PAGE;
+	}
+	return 0;
+}
+
+/*
+ * Window address for the range, or, for a fixed address or pages bound
+ * apart, the pieces mapped side by side.
+ */
+static void *map_frames(uint64_t pfn, uint64_t n, void *fixed, int prot)
+{
+	uint32_t first = *entry(pfn, 0);
+	char *base = fixed;
+	uint64_t i, j;
+
+	for (i = 1; i < n && *entry(pfn + i, 0) == first + i; i++);
+	if (i == n && !fixed)
+		return window + (uint64_t)(first - 1) * PAGE;
+
+	if (!base && (base = mmap(0, n * PAGE, PROT_NONE,
+				  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) ==
+		     MAP_FAILED)
+		return 0;
+	for (i = 0; i < n; i = j) {
+		uint32_t b = *entry(pfn + i, 0);
+		for (j = i + 1; j < n && *entry(pfn + j, 0) == b + (j - i); j++);
+		if (mmap(base + i * PAGE, (j - i) * PAGE, prot,
+			 MAP_SHARED | MAP_FIXED, back_fd,
+			 (uint64_t)(b - 1) * PAGE) == MAP_FAILED) {
+			if (!fixed)
+				munmap(base, n * PAGE);
+			return 0;
+		}
+	}
+	return base;
+}
+
+static void *phys_map(uint64_t phys, size_t len, int anon, void *fixed,
+		      int prot)
+{
+	uint64_t pfn = phys / PAGE, n;
+	char *p = 0;
+
+	if (!len || phys >= 1ULL << PHYS_BITS ||
+	    len > (1ULL << PHYS_BITS) - phys ||
+	    (fixed && (uintptr_t)fixed % PAGE != phys % PAGE)) {
+		errno = EINVAL;
+		return MAP_FAILED;
+	}
+	if (fixed)
+		fixed = (char *)fixed - phys % PAGE;
+	n = (phys % PAGE + len + PAGE - 1) / PAGE;
+	LOCK(lock);
+	if (init() == 0 && bind(pfn, n, anon) == 0 &&
+	    !(p = map_frames(pfn, n, fixed, prot)))
+		errno = ENOMEM;
+	UNLOCK(lock);
+	return p ? p + phys % PAGE : MAP_FAILED;
+}
+
+/* The run holding window offset back, or 0. */
+static struct run *find_run(uint64_t back)
+{
+	size_t lo = 0, hi = nruns;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (back < runs[mid].back)
+			hi = mid;
+		else if (back >= runs[mid].back + runs[mid].len)
+			lo = mid + 1;
+		else
+			return &runs[mid];
+	}
+	return 0;
+}
+
+void *__qnx_phys_anon(size_t len)
+{
+	uint64_t phys;
+
+	len = (len + PAGE - 1) & ~(PAGE - 1);
+	LOCK(lock);
+	phys = anon_next;
+	anon_next += len;
+	UNLOCK(lock);
+	return phys_map(phys, len, 1, 0, PROT_READ | PROT_WRITE);
+}
+
+/* 1 if addr is in the window; MAP_PHYS pages are freed, others kept. */
+int __qnx_phys_unmap(void *addr, size_t len)
+{
+	uint64_t back, end;
+
+	if (!window || (char *)addr < window ||
+	    (char *)addr >= window + WINDOW_SIZE)
+		return 0;
+	back = ((char *)addr - window) & ~(PAGE - 1);
+	end = (char *)addr - window + len;
+	LOCK(lock);
+	while (back < end) {
+		struct run *r = find_run(back);
+		uint64_t stop = r ? r->back + r->len : end;
+		if (stop > end)
+			stop = end;
+		if (r && r->anon)
+			fallocate(back_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+				  back, stop - back);
+		back = stop;
+	}
+	UNLOCK(lock);
+	return 1;
+}
+
+/* Without MAP_FIXED the window's own read-write pages are returned. */
+void *mmap_device_memory(void *addr, size_t len, int prot, int flags,
+			 uint64_t physical)
+{
+	prot &= ~QNX_PROT_NOCACHE;
+	return phys_map(physical, len, 0, flags & QNX_MAP_FIXED ? addr : 0,
+			prot);
+}
+
+int munmap_device_memory(void *addr, size_t len)
+{
+	return __qnx_phys_unmap(addr, len) ? 0 : munmap(addr, len);
+}
+
+/*
+ * Window memory maps back through its run. Any other memory is taken
+ * as identity mapped a page at a time, which is all callers need to go
+ * on, though mmap_device_memory of that address is not the same memory.
+ */
+int mem_offset64(const void *addr, int fd, size_t len, off_t *offset,
+		 size_t *contig_len)
+{
+	const char *p = addr;
+	struct run *r = 0;
+
+	(void)fd;
+	LOCK(lock);
+	if (window && p >= window && p < window + WINDOW_SIZE &&
+	    (r = find_run(p - window))) {
+		uint64_t back = p - window;
+		*offset = r->phys + (back - r->back);
+		if (contig_len)
+			*contig_len = r->back + r->len - back < len ?
+				      r->back + r->len - back : len;
+	}
+	UNLOCK(lock);
+	if (r)
+		return 0;
+	*offset = (uintptr_t)p;
+	if (contig_len) {
+		size_t page = PAGE - (uintptr_t)p % PAGE;
+		*contig_len = page < len ? page : len;
+	}
+	return 0;
+}
+
+int mem_offset(const void *addr, int fd, size_t len, off_t *offset,
+	       size_t *contig_len)
+{
+	return mem_offset64(addr, fd, len, offset, contig_len);
+}
@@ -0,0 +1,487 @@
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/sysmacros.h>
+#include "lock.h"
+#include "qnx_proc.h"
+#include "qnx_sched.h"
+#include "qnx_signal.h"
+
+/*
+ * QNX process introspection for pidin, hogs and the like:
+ * /proc/<pid>/as (and /proc/<pid>/ctl) and the DCMD_PROC_INFO,
+ * DCMD_PROC_STATUS, DCMD_PROC_TIDSTATUS and DCMD_PROC_MAPINFO devctls
+ * on it, answered from Linux /proc/<pid>/{stat,status,task,maps}.
+ *
+ * "as" opens the Linux /proc/<pid>/mem, so that reading it reads the
+ * process's memory as on QNX; where ptrace rules forbid that, and for
+ * "ctl", the fd is the /proc/<pid> directory, which still answers the
+ * devctls. Either way readlink of the fd names the pid.
+ *
+ * What the devctls return is parsed once per TICK_NS for the last
+ * process asked about and served from there: a tool that asks for
+ * every thread of a process in turn reads the task directory once per
+ * sample, not once per thread. Thread ids are the Linux tids, as
+ * everywhere in QOL. Linux cannot tell what a sleeping thread waits
+ * for, so every interruptible sleep is STATE_CONDVAR.
+ */
+
+#define TICK_NS 100000000ull
+
+#define STATE_DEAD 0
+#define STATE_RUNNING 1
+#define STATE_STOPPED 3
+#define STATE_WAITPAGE 9
+#define STATE_CONDVAR 14
+
+#define QNX_PROT_READ 0x0100
+#define QNX_PROT_WRITE 0x0200
+#define QNX_PROT_EXEC 0x0400
+#define QNX_MAP_SHARED 0x00000001
+#define QNX_MAP_PRIVATE 0x00000002
+#define QNX_MAP_STACK 0x00001000
+#define QNX_MAP_ANON 0x00080000
+
+/* Fields of /proc/<pid>/stat, by their number in proc(5). */
+enum {
+	F_PPID = 4, F_PGRP, F_SESSION,
+	F_UTIME = 14, F_STIME, F_CUTIME, F_CSTIME,
+	F_NICE = 19, F_THREADS,
+	F_START = 22,
+	F_STARTCODE = 26, F_STARTSTACK = 28,
+	F_SIGNAL = 31, F_BLOCKED,
+	F_CPU = 39, F_RTPRIO, F_POLICY,
+	F_N
+};
+
+struct stat_fields {
+	char state;
+	unsigned long long f[F_N];
+};
+
+static volatile int lock[1];
+static struct {
+	pid_t pid;
+	uint64_t tick;
+	int have_info, have_threads, have_maps;
+	struct qnx_debug_process info;
+	struct qnx_debug_thread *threads;
+	size_t nthreads, cthreads;
+	struct qnx_mapinfo *maps;
+	size_t nmaps, cmaps;
+} cache;
+
+int __qnx_proc_open(const char *path, int flags)
+{
+	char buf[64], *end;
+	long pid;
+	int fd;
+
+	if (strncmp(path, "/proc/", 6))
+		return -2;
+	path += 6;
+	if (!strncmp(path, "self/", 5)) {
+		pid = getpid();
+		end = (char *)path + 4;
+	} else {
+		pid = strtol(path, &end, 10);
+		if (end == path || pid <= 0 || *end != '/')
+			return -2;
+	}
+	if (strcmp(end, "/as") && strcmp(end, "/ctl"))
+		return -2;
+
+	if (!strcmp(end, "/as")) {
+		snprintf(buf, sizeof buf, "/proc/%ld/mem", pid);
+		fd = open(buf, (flags & O_ACCMODE) | O_CLOEXEC);
+		if (fd >= 0 || (errno != EACCES && errno != EPERM))
+			return fd;
+	}
+	snprintf(buf, sizeof buf, "/proc/%ld", pid);
+	return open(buf, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+/* The pid of an fd from __qnx_proc_open, or 0. */
+static pid_t fd_pid(int fd)
+{
+	char link[32], target[64], *end;
+	ssize_t n;
+	long pid;
+
+	snprintf(link, sizeof link, "/proc/self/fd/%d", fd);
+	n = readlink(link, target, sizeof target - 1);
+	if (n < 7 || memcmp(target, "/proc/", 6))
+		return 0;
+	target[n] = 0;
+	pid = strtol(target + 6, &end, 10);
+	if (pid <= 0 || (*end && strcmp(end, "/mem")))
+		return 0;
+	return pid;
+}
+
+static ssize_t slurp(const char *path, char *buf, size_t size)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	ssize_t n;
+
+	if (fd < 0)
+		return -1;
+	n = read(fd, buf, size - 1);
+	close(fd);
+	if (n >= 0)
+		buf[n] = 0;
+	return n;
+}
+
+static int read_stat(const char *path, struct stat_fields *st)
+{
+	char buf[1024], *p;
+	int i;
+
+	if (slurp(path, buf, sizeof buf) < 0)
+		return errno == ENOENT ? ESRCH : errno;
+	/* The command name in parentheses may hold anything. */
+	if (!(p = strrchr(buf, ')')) || p[1] != ' ')
+		return EIO;
+	st->state = p[2];
+	p += 3;
+	memset(st->f, 0, sizeof st->f);
+	for (i = 4; i < F_N && *p; i++)
+		st->f[i] = strtoull(p, &p, 10);
+	return 0;
+}
+
+static uint64_t ticks_ns(unsigned long long t)
+{
+	return t * (1000000000ull / sysconf(_SC_CLK_TCK));
+}
+
+/* CLOCK_REALTIME at boot, for start times given since boot. */
+static uint64_t boot_ns(void)
+{
+	struct timespec rt, bt;
+
+	clock_gettime(CLOCK_REALTIME, &rt);
+	clock_gettime(CLOCK_BOOTTIME, &bt);
+	return (rt.tv_sec - bt.tv_sec) * 1000000000ull + rt.tv_nsec -
+	       bt.tv_nsec;
+}
+
+/* Linux signal n is bit n-1 of v. */
+static void sigset_bits(unsigned long long v, qnx_sigset_t *set)
+{
+	sigset_t ls;
+
+	sigemptyset(&ls);
+	for (int sig = 1; sig <= 64 && sig < _NSIG; sig++)
+		if (v >> (sig - 1) & 1)
+			sigaddset(&ls, sig);
+	__qnx_sigset_from_linux(&ls, set);
+}
+
+/* The value after "name:" on a line of /proc/<pid>/status. */
+static const char *status_field(const char *buf, const char *name)
+{
+	size_t l = strlen(name);
+	const char *p = buf;
+
+	for (;;) {
+		if (!strncmp(p, name, l) && p[l] == ':')
+			return p + l + 1;
+		if (!(p = strchr(p, '\n')))
+			return 0;
+		p++;
+	}
+}
+
+static int priority(const struct stat_fields *st, uint8_t *policy)
+{
+	switch (st->f[F_POLICY]) {
+	case SCHED_FIFO:
+		*policy = QNX_SCHED_FIFO;
+		return st->f[F_RTPRIO];
+	case SCHED_RR:
+		*policy = QNX_SCHED_RR;
+		return st->f[F_RTPRIO];
+	}
+	/* QNX runs ordinary threads at 10; nice moves them around it. */
+	long nice = (long long)st->f[F_NICE];
+	*policy = QNX_SCHED_OTHER;
+	return nice > 9 ? 1 : 10 - nice;
+}
+
+static int load_info(pid_t pid)
+{
+	struct qnx_debug_process *pi = &cache.info;
+	struct stat_fields st;
+	char path[64], buf[4096];
+	const char *v;
+	unsigned ids[8];
+	uint8_t policy;
+	int err;
+
+	snprintf(path, sizeof path, "/proc/%d/stat", pid);
+	if ((err = read_stat(path, &st)))
+		return err;
+	snprintf(path, sizeof path, "/proc/%d/status", pid);
+	if (slurp(path, buf, sizeof buf) < 0)
+		return errno == ENOENT ? ESRCH : errno;
+
+	memset(pi, 0, sizeof *pi);
+	pi->pid = pid;
+	pi->parent = st.f[F_PPID];
+	pi->pgrp = st.f[F_PGRP];
+	pi->sid = st.f[F_SESSION];
+	pi->base_address = st.f[F_STARTCODE];
+	pi->initial_stack = st.f[F_STARTSTACK];
+	if ((v = status_field(buf, "Umask")))
+		pi->umask = strtoul(v, 0, 8);
+	if ((v = status_field(buf, "Uid")) &&
+	    sscanf(v, "%u %u %u", ids, ids + 1, ids + 2) == 3) {
+		pi->uid = ids[0];
+		pi->euid = ids[1];
+		pi->suid = ids[2];
+	}
+	if ((v = status_field(buf, "Gid")) &&
+	    sscanf(v, "%u %u %u", ids, ids + 1, ids + 2) == 3) {
+		pi->gid = ids[0];
+		pi->egid = ids[1];
+		pi->sgid = ids[2];
+	}
+	if ((v = status_field(buf, "SigIgn")))
+		sigset_bits(strtoull(v, 0, 16), &pi->sig_ignore);
+	if ((v = status_field(buf, "ShdPnd")))
+		sigset_bits(strtoull(v, 0, 16), &pi->sig_queue);
+	if ((v = status_field(buf, "SigPnd")))
+		sigset_bits(strtoull(v, 0, 16), &pi->sig_pending);
+	if ((v = status_field(buf, "RssAnon")))
+		pi->private_mem = strtoull(v, 0, 10) << 10;
+	pi->num_threads = st.f[F_THREADS];
+	pi->start_time = boot_ns() + ticks_ns(st.f[F_START]);
+	pi->utime = ticks_ns(st.f[F_UTIME]);
+	pi->stime = ticks_ns(st.f[F_STIME]);
+	pi->cutime = ticks_ns(st.f[F_CUTIME]);
+	pi->cstime = ticks_ns(st.f[F_CSTIME]);
+	pi->priority = priority(&st, &policy);
+	return 0;
+}
+
+static int by_tid(const void *a, const void *b)
+{
+	const struct qnx_debug_thread *x = a, *y = b;
+
+	return (x->tid > y->tid) - (x->tid < y->tid);
+}
+
+static int load_threads(pid_t pid)
+{
+	struct qnx_debug_thread *t;
+	struct stat_fields st;
+	struct dirent *de;
+	char path[64];
+	uint64_t boot = boot_ns();
+	DIR *d;
+	long tid;
+
+	snprintf(path, sizeof path, "/proc/%d/task", pid);
+	if (!(d = opendir(path)))
+		return errno == ENOENT ? ESRCH : errno;
+	cache.nthreads = 0;
+	while ((de = readdir(d))) {
+		if ((tid = strtol(de->d_name, 0, 10)) <= 0)
+			continue;
+		snprintf(path, sizeof path, "/proc/%d/task/%ld/stat", pid, tid);
+		/* A thread that exited in between is left out. */
+		if (read_stat(path, &st))
+			continue;
+		if (cache.nthreads == cache.cthreads) {
+			size_t n = cache.cthreads ? 2 * cache.cthreads : 64;
+			if (!(t = realloc(cache.threads, n * sizeof *t))) {
+				closedir(d);
+				return ENOMEM;
+			}
+			cache.threads = t;
+			cache.cthreads = n;
+		}
+		t = &cache.threads[cache.nthreads++];
+		memset(t, 0, sizeof *t);
+		t->pid = pid;
+		t->tid = tid;
+		t->priority = t->real_priority = priority(&st, &t->policy);
+		switch (st.state) {
+		case 'R':
+			t->state = STATE_RUNNING;
+			break;
+		case 'D':
+			t->state = STATE_WAITPAGE;
+			break;
+		case 'T':
+		case 't':
+			t->state = STATE_STOPPED;
+			break;
+		case 'Z':
+		case 'X':
+			t->state = STATE_DEAD;
+			break;
+		default:
+			t->state = STATE_CONDVAR;
+		}
+		t->last_cpu = st.f[F_CPU];
+		sigset_bits(st.f[F_BLOCKED], &t->sig_blocked);
+		sigset_bits(st.f[F_SIGNAL], &t->sig_pending);
+		t->start_time = boot + ticks_ns(st.f[F_START]);
+		t->sutime = ticks_ns(st.f[F_UTIME] + st.f[F_STIME]);
+	}
+	closedir(d);
+	qsort(cache.threads, cache.nthreads, sizeof *cache.threads, by_tid);
+	return 0;
+}
+
+static int load_maps(pid_t pid)
+{
+	struct qnx_mapinfo *m;
+	char path[64], line[PATH_MAX + 128], perm[8];
+	unsigned long long lo, hi, off, ino;
+	unsigned maj, min;
+	int name;
+	FILE *f;
+
+	snprintf(path, sizeof path, "/proc/%d/maps", pid);
+	if (!(f = fopen(path, "re")))
+		return errno == ENOENT ? ESRCH : errno;
+	cache.nmaps = 0;
+	while (fgets(line, sizeof line, f)) {
+		name = 0;
+		if (sscanf(line, "%llx-%llx %4s %llx %x:%x %llu %n", &lo, &hi,
+			   perm, &off, &maj, &min, &ino, &name) < 7)
+			continue;
+		if (cache.nmaps == cache.cmaps) {
+			size_t n = cache.cmaps ? 2 * cache.cmaps : 256;
+			if (!(m = realloc(cache.maps, n * sizeof *m))) {
+				fclose(f);
+				return ENOMEM;
+			}
+			cache.maps = m;
+			cache.cmaps = n;
+		}
+		m = &cache.maps[cache.nmaps++];
+		memset(m, 0, sizeof *m);
+		m->vaddr = lo;
+		m->size = hi - lo;
+		m->flags = (perm[0] == 'r' ? QNX_PROT_READ : 0) |
+			   (perm[1] == 'w' ? QNX_PROT_WRITE : 0) |
+			   (perm[2] == 'x' ? QNX_PROT_EXEC : 0) |
+			   (perm[3] == 's' ? QNX_MAP_SHARED : QNX_MAP_PRIVATE);
+		if (!ino)
+			m->flags |= QNX_MAP_ANON;
+		if (!strncmp(line + name, "[stack", 6))
+			m->flags |= QNX_MAP_STACK;
+		m->dev = makedev(maj, min);
+		m->offset = off;
+		m->ino = ino;
+	}
+	fclose(f);
+	return 0;
+}
+
+/* Takes the lock and starts over the cache for a new process or tick.
+ * Returns the pid of fd, or 0 (unlocked) with *err set. */
+static pid_t begin(int fd, int *err)
+{
+	struct timespec now;
+	pid_t pid = fd_pid(fd);
+	uint64_t tick;
+
+	if (!pid) {
+		*err = ENOTTY;
+		return 0;
+	}
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+	tick = (now.tv_sec * 1000000000ull + now.tv_nsec) / TICK_NS;
+	LOCK(lock);
+	if (cache.pid != pid || cache.tick != tick) {
+		cache.pid = pid;
+		cache.tick = tick;
+		cache.have_info = cache.have_threads = cache.have_maps = 0;
+	}
+	return pid;
+}
+
+int __qnx_proc_info(int fd, void *data, unsigned long arg)
+{
+	int err = 0;
+	pid_t pid = begin(fd, &err);
+
+	if (!pid)
+		return err;
+	if (!cache.have_info && !(err = load_info(pid)))
+		cache.have_info = 1;
+	if (!err)
+		memcpy(data, &cache.info, sizeof cache.info);
+	UNLOCK(lock);
+	return err;
+}
+
+/* DCMD_PROC_TIDSTATUS (arg 1): the thread with the smallest tid not
+ * below the one in data, or ESRCH past the last. DCMD_PROC_STATUS
+ * (arg 0): the main thread. */
+int __qnx_proc_status(int fd, void *data, unsigned long arg)
+{
+	struct qnx_debug_thread *ts = data;
+	int err = 0;
+	pid_t pid = begin(fd, &err), want = arg ? ts->tid : pid;
+	size_t lo = 0, hi, mid;
+
+	if (!pid)
+		return err;
+	if (!cache.have_threads && !(err = load_threads(pid)))
+		cache.have_threads = 1;
+	if (!err) {
+		for (hi = cache.nthreads; lo < hi;) {
+			mid = lo + (hi - lo) / 2;
+			if (cache.threads[mid].tid < want)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo < cache.nthreads && (arg || cache.threads[lo].tid == want))
+			memcpy(ts, &cache.threads[lo], sizeof *ts);
+		else
+			err = ESRCH;
+	}
+	UNLOCK(lock);
+	return err;
+}
+
+/* As many mappings as fit in nbytes; *info is how many there are. */
+int __qnx_proc_mapinfo(int fd, void *data, size_t nbytes, int *info)
+{
+	int err = 0;
+	pid_t pid = begin(fd, &err);
+	size_t n;
+
+	if (!pid)
+		return err;
+	if (!cache.have_maps && !(err = load_maps(pid)))
+		cache.have_maps = 1;
+	if (!err) {
+		n = nbytes / sizeof *cache.maps;
+		if (n > cache.nmaps)
+			n = cache.nmaps;
+		memcpy(data, cache.maps, n * sizeof *cache.maps);
+		if (info)
+			*info = cache.nmaps;
+	}
+	UNLOCK(lock);
+	return err;
+}
@@ -1,95 +1,189 @@
+#define _GNU_SOURCE
 #include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include "syscall.h"
+#include "qnx_redirect.h"
+#include "qnx_stat.h"
+#include "qnx_path.h"
+#include "neutrino/neutrino.h"
 
-typedef uint64_t qnx_ino_t;
-typedef uint64_t qnx_off_t;
-typedef uint32_t qnx_dev_t;
-typedef uint32_t qnx_uid_t;
-typedef uint32_t qnx_gid_t;
-typedef uint32_t qnx__Time32t;
-typedef uint32_t qnx_mode_t;
-typedef uint32_t qnx_nlink_t;
-typedef uint32_t qnx_blksize_t;
-typedef uint64_t qnx_blkcnt_t;
+/*
+ * Linux reports st_blocks in 512 byte units, which is also what QNX
+ * uses for st_blocks. st_nblocks counts blocks of st_blocksize bytes.
+ * Linux has no separate "medium block size"; its st_blksize is the
+ * filesystem block size for local filesystems, so it is used for both
+ * st_blocksize and st_blksize (the size QNX tools use for read buffers).
+ */
+static uint32_t qnx_nblocks(uint64_t blocks512, uint32_t blksize)
+{
+	if (blksize < 512)
+		return blocks512;
+	return (blocks512 * 512 + blksize - 1) / blksize;
+}
 
-struct qnx_stat {
-	qnx_ino_t st_ino;
-	qnx_off_t st_size;
-	qnx_dev_t st_dev;
-	qnx_dev_t st_rdev;
-	qnx_uid_t st_uid;
-	qnx_gid_t st_gid;
-	qnx__Time32t __old_st_mtime;
-	qnx__Time32t __old_st_atime;
-	qnx__Time32t __old_st_ctime;
-	qnx_mode_t st_mode;
-	qnx_nlink_t st_nlink;
-	qnx_blksize_t st_blocksize;
-	uint32_t st_nblocks;
-	qnx_blksize_t st_blksize;
-	qnx_blkcnt_t st_blocks;
-	struct timespec st_mtim;
-	struct timespec st_atim;
-	struct timespec st_ctim;
-};
+/* What a kernel without statx returns, in the form statx_to_qnx takes,
+ * so that there is one conversion for both. */
+static void stat_to_statx(const struct stat *st, struct statx *stx)
+{
+	stx->stx_ino = st->st_ino;
+	stx->stx_size = st->st_size;
+	stx->stx_dev_major = major(st->st_dev);
+	stx->stx_dev_minor = minor(st->st_dev);
+	stx->stx_rdev_major = major(st->st_rdev);
+	stx->stx_rdev_minor = minor(st->st_rdev);
+	stx->stx_uid = st->st_uid;
+	stx->stx_gid = st->st_gid;
+	stx->stx_atime.tv_sec = st->st_atim.tv_sec;
+	stx->stx_atime.tv_nsec = st->st_atim.tv_nsec;
+	stx->stx_mtime.tv_sec = st->st_mtim.tv_sec;
+	stx->stx_mtime.tv_nsec = st->st_mtim.tv_nsec;
+	stx->stx_ctime.tv_sec = st->st_ctim.tv_sec;
+	stx->stx_ctime.tv_nsec = st->st_ctim.tv_nsec;
+	stx->stx_mode = st->st_mode;
+	stx->stx_nlink = st->st_nlink;
+	stx->stx_blksize = st->st_blksize;
+	stx->stx_blocks = st->st_blocks;
+}
 
-static void linux_stat_to_qnx(struct stat *lstat, struct qnx_stat *qstat)
+/* Inlined, so that fstat's constant mask folds the tests away. */
+static inline __attribute__((always_inline))
+void statx_to_qnx(const struct statx *stx, unsigned mask,
+		  struct qnx_stat *qstat)
 {
-	qstat->st_ino = lstat->st_ino;
-	qstat->st_size = lstat->st_size;
-	qstat->st_dev = lstat->st_dev;
-	qstat->st_rdev = lstat->st_rdev;
-	qstat->st_uid = lstat->st_uid;
-	qstat->st_gid = lstat->st_gid;
-	qstat->__old_st_atime = lstat->st_atim.tv_sec;
-	qstat->__old_st_mtime = lstat->st_mtim.tv_sec;
-	qstat->__old_st_ctime = lstat->st_ctim.tv_sec;
-	qstat->st_mode = lstat->st_mode;
-	qstat->st_nlink = lstat->st_nlink;
-	// TODO: block size is actual block size, not prefered IO size
-	qstat->st_blocksize = lstat->st_blksize;
-	qstat->st_nblocks = lstat->st_blocks;
-	qstat->st_blksize = lstat->st_blksize;
-	// TODO: blocks is computed in 512 Bytes blocks
-	qstat->st_blocks = lstat->st_blocks;
-	qstat->st_mtim = lstat->st_mtim;
-	qstat->st_atim = lstat->st_atim;
-	qstat->st_ctim = lstat->st_ctim;
+	if (mask & STATX_INO)
+		qstat->st_ino = stx->stx_ino;
+	if (mask & STATX_SIZE)
+		qstat->st_size = stx->stx_size;
+	qstat->st_dev = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+	qstat->st_rdev = makedev(stx->stx_rdev_major, stx->stx_rdev_minor);
+	if (mask & STATX_UID)
+		qstat->st_uid = stx->stx_uid;
+	if (mask & STATX_GID)
+		qstat->st_gid = stx->stx_gid;
+	if (mask & STATX_ATIME) {
+		qstat->__old_st_atime = stx->stx_atime.tv_sec;
+		qstat->st_atim.tv_sec = stx->stx_atime.tv_sec;
+		qstat->st_atim.tv_nsec = stx->stx_atime.tv_nsec;
+	}
+	if (mask & STATX_MTIME) {
+		qstat->__old_st_mtime = stx->stx_mtime.tv_sec;
+		qstat->st_mtim.tv_sec = stx->stx_mtime.tv_sec;
+		qstat->st_mtim.tv_nsec = stx->stx_mtime.tv_nsec;
+	}
+	if (mask & STATX_CTIME) {
+		qstat->__old_st_ctime = stx->stx_ctime.tv_sec;
+		qstat->st_ctim.tv_sec = stx->stx_ctime.tv_sec;
+		qstat->st_ctim.tv_nsec = stx->stx_ctime.tv_nsec;
+	}
+	if (mask & (STATX_TYPE|STATX_MODE))
+		qstat->st_mode = stx->stx_mode;
+	if (mask & STATX_NLINK)
+		qstat->st_nlink = stx->stx_nlink;
+	qstat->st_blocksize = stx->stx_blksize;
+	qstat->st_blksize = stx->stx_blksize;
+	if (mask & STATX_BLOCKS) {
+		qstat->st_blocks = stx->stx_blocks;
+		qstat->st_nblocks = qnx_nblocks(stx->stx_blocks,
+						stx->stx_blksize);
+	}
 }
 
-int _qnx_stat(const char *restrict path, struct qnx_stat *restrict buf)
+/*
+ * Fill only the fields of buf selected by mask (STATX_* bits); the
+ * others are left untouched. The kernel is asked for just those
+ * fields, which lets filesystems skip work such as revalidating
+ * attributes on network mounts. st_dev, st_rdev, st_blocksize and
+ * st_blksize are always filled. Kernels without statx fall back to a
+ * full fstatat. Absolute paths are served from QNX_PROC_BOOT or go
+ * through the QNX_PATHMAP mapping.
+ */
+int _qnx_stat_fields(int fd, const char *restrict path, int flags,
+		     unsigned mask, struct qnx_stat *restrict buf)
 {
+	char pbuf[PATH_MAX];
+	struct statx stx;
 	struct stat local;
-	int ret = stat(path, &local);
+	int ret;
+
+	if ((ret = __qnx_bootfs_stat(path, buf)) != -2)
+		return ret;
+	if (!(path = __qnx_path_map(path, pbuf)))
+		return -1;
+	ret = __syscall(SYS_statx, fd, path, flags | AT_NO_AUTOMOUNT,
+			mask, &stx);
+	if (ret == -ENOSYS) {
+		if ((ret = fstatat(fd, path, &local, flags)))
+			return ret;
+		stat_to_statx(&local, &stx);
+		mask = STATX_BASIC_STATS;
+	}
 	if (!ret && buf)
-		linux_stat_to_qnx(&local, buf);
-	return ret;
+		statx_to_qnx(&stx, mask, buf);
+	return __syscall_ret(ret);
 }
 
+int _qnx_stat(const char *restrict path, struct qnx_stat *restrict buf)
+{
+	return _qnx_stat_fields(AT_FDCWD, path, 0, STATX_BASIC_STATS, buf);
+}
+QNX_REDIRECT(stat);
+
 int _qnx_lstat(const char *restrict path, struct qnx_stat *restrict buf)
 {
-	struct stat local;
-	int ret = lstat(path, &local);
-	if (!ret && buf)
-		linux_stat_to_qnx(&local, buf);
-	return ret;
+	return _qnx_stat_fields(AT_FDCWD, path, AT_SYMLINK_NOFOLLOW,
+				STATX_BASIC_STATS, buf);
 }
+QNX_REDIRECT(lstat);
 
+/* The commonest of these, with nothing to look up: an fd has no path
+ * for QNX_PROC_BOOT or QNX_PATHMAP, so it goes straight to statx and a
+ * conversion specialized for STATX_BASIC_STATS. */
 int _qnx_fstat(const int fd, struct qnx_stat *restrict buf)
 {
+	struct statx stx;
 	struct stat local;
-	int ret = fstat(fd, &local);
-	if (!ret && buf)
-		linux_stat_to_qnx(&local, buf);
-	return ret;
+	int ret;
+
+	if (fd < 0)
+		return __syscall_ret(-EBADF);
+	if (!buf)
+		return __syscall_ret(-EFAULT);
+	if (nto_io_fd(fd))
+		return __nto_io_fstat(fd, buf);
+	ret = __syscall(SYS_statx, fd, "", AT_EMPTY_PATH | AT_NO_AUTOMOUNT,
+			STATX_BASIC_STATS, &stx);
+	if (ret == -ENOSYS) {
+		if ((ret = fstat(fd, &local)))
+			return ret;
+		stat_to_statx(&local, &stx);
+		ret = 0;
+	}
+	if (!ret)
+		statx_to_qnx(&stx, STATX_BASIC_STATS, buf);
+	return __syscall_ret(ret);
 }
+QNX_REDIRECT(fstat);
 
 int _qnx_fstatat(const int fd, const char *path, struct qnx_stat *buf,
 		 int flags)
 {
-	struct stat local;
-	int ret = fstatat(fd, path, &local, flags);
-	if (!ret && buf)
-		linux_stat_to_qnx(&local, buf);
-	return ret;
+	return _qnx_stat_fields(fd, path, flags, STATX_BASIC_STATS, buf);
 }
+QNX_REDIRECT(fstatat);
+
+/* struct qnx_stat already has the 64-bit ino and size of QNX's struct
+ * stat64, so the *64 names are the same functions; without these they
+ * would reach musl's versions, with the Linux layout, through the
+ * loader's LFS64 fallback. */
+weak_alias(_qnx_stat, _qnx_stat64);
+weak_alias(_qnx_lstat, _qnx_lstat64);
+weak_alias(_qnx_fstat, _qnx_fstat64);
+weak_alias(_qnx_fstatat, _qnx_fstatat64);
+QNX_REDIRECT(stat64);
+QNX_REDIRECT(lstat64);
+QNX_REDIRECT(fstat64);
+QNX_REDIRECT(fstatat64);
@@ -0,0 +1,176 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "pthread_impl.h"
+#include "fork_impl.h"
+#include "qnx_stats.h"
+
+/*
+ * LD_QNX_STATS: a page of process-wide counters for qolstat.py to watch
+ * while the program runs, in /dev/shm/qnx-stats.<pid>, left behind when
+ * it exits. Forked children start a file of their own.
+ *
+ * Counting must cost next to nothing where it happens (errno
+ * translation, slogf, the allocator), so a thread counts the frequent
+ * events in its own struct pthread and adds them to the shared page,
+ * which every thread would otherwise contend on, STAT_BATCH at a time
+ * and when it exits. A reader sees those counters up to STAT_BATCH - 1
+ * behind per thread.
+ *
+ * File format (native endian, read by qolstat.py):
+ *     header   char magic[8] "qnxstat1"; u32 nstats, pid, names, data;
+ *              u32 pad[4]
+ *     names    nstats char[32] at offset names
+ *     values   nstats u64 at offset data
+ */
+
+#define STAT_NAME 32
+#define STAT_BATCH 64
+
+struct stat_hdr {
+	char magic[8];
+	uint32_t nstats, pid, names, data;
+	uint32_t pad[4];
+};
+
+static const char stat_names[QNX_STAT_N][STAT_NAME] = {
+	[QNX_STAT_ERRNO] = "errno",
+	[QNX_STAT_SLOGF] = "slogf",
+	[QNX_STAT_MALLOC_SLOW] = "malloc_slow",
+	[QNX_STAT_MALLOC_MAP] = "malloc_map",
+	[QNX_STAT_SPAWN] = "spawn",
+	[QNX_STAT_SPAWN_FAIL] = "spawn_fail",
+	[QNX_STAT_LOOKUPS] = "lookups",
+	[QNX_STAT_REDIRECTS] = "redirects",
+};
+
+typedef char stat_batched_fit[QNX_STAT_BATCHED <=
+	sizeof ((struct pthread *)0)->qnx_stats /
+	sizeof ((struct pthread *)0)->qnx_stats[0] ? 1 : -1];
+
+#define STAT_DATA (sizeof(struct stat_hdr) + QNX_STAT_N * STAT_NAME + 63 & -64)
+#define STAT_SIZE (STAT_DATA + QNX_STAT_N * sizeof(uint64_t))
+
+int __qnx_stats_on;
+static struct stat_hdr *hdr;
+static uint64_t *vals;
+
+static void dummy_lookups(uint64_t *lookups, uint64_t *redirects)
+{
+	*lookups = *redirects = 0;
+}
+weak_alias(dummy_lookups, __dl_qnx_lookups);
+
+/* A new stats file for this process, or a private mapping if the file
+ * cannot be made, as in shimstats.c. */
+static struct stat_hdr *map_stats(void)
+{
+	char path[40];
+	struct stat_hdr *h = MAP_FAILED;
+	int fd, e = errno;
+
+	snprintf(path, sizeof path, "/dev/shm/qnx-stats.%d", getpid());
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd >= 0) {
+		if (!ftruncate(fd, STAT_SIZE))
+			h = mmap(0, STAT_SIZE, PROT_READ | PROT_WRITE,
+				 MAP_SHARED, fd, 0);
+		close(fd);
+	}
+	if (h == MAP_FAILED)
+		h = mmap(0, STAT_SIZE, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	errno = e;
+	if (h == MAP_FAILED)
+		return 0;
+	h->nstats = QNX_STAT_N;
+	h->pid = getpid();
+	h->names = sizeof *h;
+	h->data = STAT_DATA;
+	memcpy((char *)h + h->names, stat_names, sizeof stat_names);
+	memcpy(h->magic, "qnxstat1", 8);
+	return h;
+}
+
+static void publish_loader(void)
+{
+	uint64_t lookups, redirects;
+
+	__dl_qnx_lookups(&lookups, &redirects);
+	vals[QNX_STAT_LOOKUPS] = lookups;
+	vals[QNX_STAT_REDIRECTS] = redirects;
+}
+
+static void flush(pthread_t self)
+{
+	for (int i = 0; i < QNX_STAT_BATCHED; i++) {
+		if (self->qnx_stats[i])
+			__atomic_fetch_add(&vals[i], self->qnx_stats[i],
+					   __ATOMIC_RELAXED);
+		self->qnx_stats[i] = 0;
+	}
+	publish_loader();
+}
+
+void __qnx_stat_add(int i)
+{
+	pthread_t self;
+
+	if (i >= QNX_STAT_BATCHED) {
+		__atomic_fetch_add(&vals[i], 1, __ATOMIC_RELAXED);
+		publish_loader();
+		return;
+	}
+	self = __pthread_self();
+	if (++self->qnx_stats[i] >= STAT_BATCH)
+		flush(self);
+}
+
+static void stats_exit(void)
+{
+	flush(__pthread_self());
+}
+
+void __qnx_stats_init(void)
+{
+	char *s = getenv("LD_QNX_STATS");
+
+	if (!s || !*s || !(hdr = map_stats()))
+		return;
+	vals = (uint64_t *)((char *)hdr + hdr->data);
+	publish_loader();
+	atexit(stats_exit);
+	a_store(&__qnx_stats_on, 1);
+}
+
+void __qnx_stats_thread_exit(void)
+{
+	if (__qnx_stats_on)
+		flush(__pthread_self());
+}
+
+/* The child counts from zero, in a file of its own, or not at all
+ * rather than into its parent's. */
+void __qnx_stats_atfork(int who)
+{
+	struct stat_hdr *old = hdr;
+
+	if (who != 1 || !hdr)
+		return;
+	if (!(hdr = map_stats())) {
+		hdr = old;
+		__qnx_stats_on = 0;
+		return;
+	}
+	munmap(old, STAT_SIZE);
+	vals = (uint64_t *)((char *)hdr + hdr->data);
+	memset(__pthread_self()->qnx_stats, 0,
+	       sizeof __pthread_self()->qnx_stats);
+	publish_loader();
+}
@@ -0,0 +1,1056 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include "pthread_impl.h"
+#include "lock.h"
+#include "fork_impl.h"
+#include "qnx_redirect.h"
+#include "qnx_time.h"
+#include "neutrino/neutrino.h"
+
+/*
+ * QNX mutexes and condition variables. QNX programs embed them as an
+ * 8-byte sync_t, where musl's are 40 and 48 bytes, so they cannot be
+ * passed through; they are implemented here on the sync_t itself.
+ *
+ * A mutex's __owner is a Linux PI futex word: 0 when free, else the
+ * owner's tid, with _NTO_SYNC_WAITING being FUTEX_WAITERS. An
+ * uncontended lock or unlock is one CAS; contention goes to
+ * FUTEX_LOCK_PI, so a low priority owner runs at the priority of the
+ * highest waiter, as QNX's default PTHREAD_PRIO_INHERIT asks.
+ * PTHREAD_PRIO_NONE mutexes use plain FUTEX_WAIT on the same word.
+ * The static initializer's _NTO_SYNC_INITIALIZER owner counts as free,
+ * so PTHREAD_MUTEX_INITIALIZER needs no initialisation step. __count
+ * holds the _NTO_SYNC_* flags over the recursion depth.
+ *
+ * A process-private condvar's waiters queue, oldest first, on nodes on
+ * their own stacks, in a table hashed by the condvar's address, and
+ * each sleeps on its own node, so a signal only ever releases a thread
+ * that was already waiting; __owner is 1 while any is queued, and
+ * signals without it make no system call. A process-shared one, which
+ * that table cannot reach across processes, sleeps on __owner as a
+ * sequence number in steps of 2 whose low bit says a thread has waited
+ * since the last broadcast. __count holds the QNX clock id and, as for
+ * mutexes, whether it is process shared; the static initializer's
+ * negative count reads as private.
+ *
+ * Read-write locks, barriers and spin locks also keep QNX's layout, and
+ * any static initializer's bytes read as a free lock. A rwlock's
+ * __active is the lock word: the number of readers, RW_WRITER when
+ * write-locked, RW_WAITING when a thread sleeps on it. Lock and unlock
+ * are one CAS unless a thread waits; as in musl, readers are not held
+ * back behind waiting writers. A barrier's __bcond.__owner counts the
+ * completed rounds and is what waiters sleep on. A spin lock's __owner
+ * is 0 free, 1 locked, 2 locked with sleepers: after a short spin a
+ * contended thread sleeps in the kernel instead of burning its slice
+ * against a holder preempted on an oversubscribed host.
+ */
+
+typedef struct {
+	volatile int __count;
+	volatile unsigned __owner;
+} sync_t;
+
+struct qnx_sync_attr {
+	int __protocol;
+	int __flags;
+	int __prioceiling;
+	int __clockid;
+	int __count;
+	int __reserved[3];
+};
+
+#define _NTO_SYNC_NONRECURSIVE 0x80000000
+#define _NTO_SYNC_NOERRORCHECK 0x40000000
+#define _NTO_SYNC_PRIOCEILING 0x20000000
+#define _NTO_SYNC_PRIONONE 0x10000000
+#define _NTO_SYNC_COUNTMASK 0x0fffffff
+#define SYNC_SHARED 0x08000000	/* ours, inside the count bits */
+#define SYNC_DEPTH 0x07ffffff
+
+#define _NTO_SYNC_INITIALIZER 0xffffffffu
+#define _NTO_SYNC_DESTROYED 0xfffffffeu
+#define _NTO_SYNC_WAITING 0x80000000u
+#define OWNER_TID 0x3fffffffu
+
+#define QNX_PTHREAD_MUTEX_NORMAL 0
+#define QNX_PTHREAD_MUTEX_ERRORCHECK 1
+#define QNX_PTHREAD_MUTEX_RECURSIVE 2
+#define QNX_PTHREAD_MUTEX_DEFAULT 3
+#define QNX_PTHREAD_PRIO_INHERIT 0
+#define QNX_PTHREAD_PRIO_NONE 1
+#define QNX_PTHREAD_PRIO_PROTECT 2
+#define QNX_PTHREAD_RECURSIVE_ENABLE 1
+#define QNX_PTHREAD_PROCESS_SHARED 1
+
+#define QNX_CLOCK_REALTIME 0
+#define QNX_CLOCK_MONOTONIC 2
+
+/* struct qnx_sync_attr __flags */
+#define ATTR_SHARED 0x1
+#define ATTR_RECURSIVE 0x2
+#define ATTR_NOERRORCHECK 0x4
+
+struct qnx_rwlock {
+	volatile int __active;
+	volatile int __blockedwriters;
+	volatile int __blockedreaders;
+	int __heavy;		/* ours: ATTR_SHARED */
+	sync_t __lock;
+	sync_t __rcond;
+	sync_t __wcond;
+	unsigned __owner;	/* ours: the writer's tid */
+	unsigned __spare;
+};
+
+struct qnx_barrier {
+	unsigned __barrier;	/* threads per round */
+	volatile unsigned __count;	/* arrived in this round */
+	sync_t __lock;		/* ours: __count holds SYNC_SHARED */
+	sync_t __bcond;		/* ours: __owner counts rounds */
+};
+
+/* pthread_rwlockattr_t and pthread_barrierattr_t; only pshared */
+struct qnx_pshared_attr {
+	int __flags;
+};
+
+#define RW_WRITER 0x7fffffff
+#define RW_WAITING 0x80000000u
+#define SPINS 100
+
+#define QNX_PTHREAD_BARRIER_SERIAL_THREAD (-1)
+
+static int priv(int count)
+{
+	return count & SYNC_SHARED ? 0 : FUTEX_PRIVATE;
+}
+
+static int pi_lock(sync_t *m, const struct timespec *at)
+{
+	int r;
+
+	do r = __syscall(SYS_futex, &m->__owner,
+			 FUTEX_LOCK_PI | priv(m->__count), 0, at);
+	while (r == -EINTR);
+	return -r;
+}
+
+static int plain_lock(sync_t *m, unsigned tid, clockid_t clk,
+		      const struct timespec *at)
+{
+	unsigned v;
+	int r;
+
+	for (;;) {
+		v = m->__owner;
+		if ((!v || v == _NTO_SYNC_INITIALIZER) &&
+		    a_cas((volatile int *)&m->__owner, v,
+			  tid | _NTO_SYNC_WAITING) == (int)v)
+			return 0;
+		if (v == _NTO_SYNC_DESTROYED)
+			return EINVAL;
+		if (!(v & _NTO_SYNC_WAITING) &&
+		    a_cas((volatile int *)&m->__owner, v,
+			  v | _NTO_SYNC_WAITING) != (int)v)
+			continue;
+		r = __timedwait((volatile int *)&m->__owner,
+				v | _NTO_SYNC_WAITING, clk, at,
+				!(m->__count & SYNC_SHARED));
+		if (r == ETIMEDOUT || r == EINVAL)
+			return r;
+	}
+}
+
+/* Already free, owned by the caller, or neither (EBUSY). */
+static int fast_lock(sync_t *m, unsigned tid)
+{
+	unsigned v = a_cas((volatile int *)&m->__owner, 0, tid);
+
+	if (v == _NTO_SYNC_INITIALIZER)
+		v = a_cas((volatile int *)&m->__owner, v, tid);
+	if (!v || v == _NTO_SYNC_INITIALIZER)
+		return 0;
+	if (v == _NTO_SYNC_DESTROYED)
+		return EINVAL;
+	if ((v & OWNER_TID) != tid)
+		return EBUSY;
+	if (m->__count & _NTO_SYNC_NONRECURSIVE)
+		return EDEADLK;
+	if ((m->__count & SYNC_DEPTH) == SYNC_DEPTH)
+		return EAGAIN;
+	m->__count++;
+	return 0;
+}
+
+static int mutex_lock(sync_t *m, clockid_t clk, const struct timespec *at)
+{
+	unsigned tid = __pthread_self()->tid;
+	struct timespec rt, now;
+	int r = fast_lock(m, tid);
+
+	if (r != EBUSY)
+		return r;
+	if (m->__count & _NTO_SYNC_PRIONONE)
+		return plain_lock(m, tid, clk, at);
+	/* FUTEX_LOCK_PI only takes CLOCK_REALTIME deadlines. */
+	if (at && clk != CLOCK_REALTIME) {
+		clock_gettime(clk, &now);
+		clock_gettime(CLOCK_REALTIME, &rt);
+		rt.tv_sec += at->tv_sec - now.tv_sec;
+		rt.tv_nsec += at->tv_nsec - now.tv_nsec;
+		if (rt.tv_nsec < 0)
+			rt.tv_nsec += 1000000000, rt.tv_sec--;
+		else if (rt.tv_nsec >= 1000000000)
+			rt.tv_nsec -= 1000000000, rt.tv_sec++;
+		at = &rt;
+	}
+	return pi_lock(m, at);
+}
+
+static int mutex_unlock(sync_t *m)
+{
+	unsigned tid = __pthread_self()->tid;
+
+	if ((m->__owner & OWNER_TID) != tid || m->__owner == _NTO_SYNC_DESTROYED)
+		return EPERM;
+	if (m->__count & SYNC_DEPTH) {
+		m->__count--;
+		return 0;
+	}
+	if (m->__count & _NTO_SYNC_PRIONONE) {
+		if (a_swap((volatile int *)&m->__owner, 0) & _NTO_SYNC_WAITING)
+			__wake(&m->__owner, 1, !(m->__count & SYNC_SHARED));
+		return 0;
+	}
+	if ((unsigned)a_cas((volatile int *)&m->__owner, tid, 0) != tid)
+		__syscall(SYS_futex, &m->__owner,
+			  FUTEX_UNLOCK_PI | priv(m->__count));
+	return 0;
+}
+
+static int mutex_init(sync_t *m, const struct qnx_sync_attr *a)
+{
+	int count = _NTO_SYNC_NONRECURSIVE;
+
+	if (a) {
+		if (a->__flags & ATTR_RECURSIVE)
+			count = 0;
+		if (a->__flags & ATTR_NOERRORCHECK)
+			count |= _NTO_SYNC_NOERRORCHECK;
+		if (a->__flags & ATTR_SHARED)
+			count |= SYNC_SHARED;
+		if (a->__protocol == QNX_PTHREAD_PRIO_NONE)
+			count |= _NTO_SYNC_PRIONONE;
+		/* There is no ceiling protocol to map it to; it inherits. */
+		else if (a->__protocol == QNX_PTHREAD_PRIO_PROTECT)
+			count |= _NTO_SYNC_PRIOCEILING;
+	}
+	m->__count = count;
+	m->__owner = 0;
+	return 0;
+}
+
+static int mutex_destroy(sync_t *m)
+{
+	unsigned v = m->__owner;
+
+	if (v && v != _NTO_SYNC_INITIALIZER && v != _NTO_SYNC_DESTROYED)
+		return EBUSY;
+	m->__owner = _NTO_SYNC_DESTROYED;
+	return 0;
+}
+
+static clockid_t cond_clock(sync_t *c)
+{
+	return (c->__count & ~SYNC_SHARED) == QNX_CLOCK_MONOTONIC ?
+	       CLOCK_MONOTONIC : CLOCK_REALTIME;
+}
+
+static int cond_private(sync_t *c)
+{
+	return c->__count < 0 || !(c->__count & SYNC_SHARED);
+}
+
+#define CW_BUCKETS 64
+#define CW_WAITING 0
+#define CW_SIGNALED 1
+
+struct cwaiter {
+	struct cwaiter *prev, *next;
+	sync_t *c;
+	volatile int state;
+};
+
+static struct cwbucket {
+	volatile int lock[1];
+	struct cwaiter *head, *tail;
+} cw_tab[CW_BUCKETS];
+
+static struct cwbucket *cw_bucket(sync_t *c)
+{
+	return &cw_tab[((uintptr_t)c >> 3) % CW_BUCKETS];
+}
+
+static void cw_unlink(struct cwbucket *b, struct cwaiter *w)
+{
+	if (w->prev) w->prev->next = w->next;
+	else b->head = w->next;
+	if (w->next) w->next->prev = w->prev;
+	else b->tail = w->prev;
+}
+
+/* Called with b locked: __owner goes to 0 with c's last waiter. */
+static void cw_update(struct cwbucket *b, sync_t *c)
+{
+	struct cwaiter *w;
+
+	for (w = b->head; w && w->c != c; w = w->next);
+	if (!w) c->__owner = 0;
+}
+
+/* The wakes are issued under the bucket lock, which every waiter takes
+ * before it returns, so they never reach a node that has left. */
+static int cond_wait(sync_t *c, sync_t *m, const struct timespec *at)
+{
+	unsigned tid = __pthread_self()->tid, v;
+	struct cwaiter w = { .c = c, .state = CW_WAITING };
+	struct cwbucket *b = 0;
+	int depth, r = 0;
+
+	if ((m->__owner & OWNER_TID) != tid)
+		return EPERM;
+	if (cond_private(c)) {
+		b = cw_bucket(c);
+		LOCK(b->lock);
+		w.prev = b->tail;
+		if (b->tail) b->tail->next = &w;
+		else b->head = &w;
+		b->tail = &w;
+		c->__owner = 1;
+		UNLOCK(b->lock);
+	} else {
+		for (;;) {
+			v = c->__owner;
+			if ((v & 1) ||
+			    a_cas((volatile int *)&c->__owner, v, v | 1) == (int)v)
+				break;
+		}
+		v |= 1;
+	}
+	depth = m->__count & SYNC_DEPTH;
+	m->__count &= ~SYNC_DEPTH;
+	mutex_unlock(m);
+	if (b) {
+		while (w.state == CW_WAITING) {
+			r = __timedwait(&w.state, CW_WAITING, cond_clock(c), at, 1);
+			if (r == ETIMEDOUT || r == EINVAL)
+				break;
+		}
+		LOCK(b->lock);
+		if (w.state == CW_WAITING) {
+			cw_unlink(b, &w);
+			cw_update(b, c);
+		} else {
+			r = 0;
+		}
+		UNLOCK(b->lock);
+	} else {
+		r = __timedwait((volatile int *)&c->__owner, v, cond_clock(c),
+				at, 0);
+	}
+	mutex_lock(m, CLOCK_REALTIME, 0);
+	m->__count |= depth;
+	return r == ETIMEDOUT || r == EINVAL ? r : 0;
+}
+
+static int cond_signal(sync_t *c, int all)
+{
+	unsigned v = c->__owner;
+	struct cwbucket *b;
+	struct cwaiter *w, *next;
+
+	if (!(v & 1))
+		return 0;
+	if (cond_private(c)) {
+		b = cw_bucket(c);
+		LOCK(b->lock);
+		for (w = b->head; w; w = next) {
+			next = w->next;
+			if (w->c != c)
+				continue;
+			cw_unlink(b, w);
+			w->state = CW_SIGNALED;
+			__wake(&w->state, 1, 1);
+			if (!all)
+				break;
+		}
+		cw_update(b, c);
+		UNLOCK(b->lock);
+		return 0;
+	}
+	if (all) {
+		while ((unsigned)a_cas((volatile int *)&c->__owner, v,
+				       (v + 2) & ~1u) != v)
+			v = c->__owner;
+		__wake(&c->__owner, -1, 0);
+		return 0;
+	}
+	a_fetch_add((volatile int *)&c->__owner, 2);
+	__wake(&c->__owner, 1, 0);
+	return 0;
+}
+
+/* The other threads' waiters are gone in the child. */
+void __qnx_sync_atfork(int who)
+{
+	int i;
+
+	for (i = 0; i < CW_BUCKETS; i++) {
+		if (who < 0) {
+			LOCK(cw_tab[i].lock);
+		} else if (who) {
+			cw_tab[i].lock[0] = 0;
+			cw_tab[i].head = cw_tab[i].tail = 0;
+		} else {
+			UNLOCK(cw_tab[i].lock);
+		}
+	}
+}
+
+int _qnx_pthread_mutex_init(sync_t *m, const struct qnx_sync_attr *a)
+{
+	return mutex_init(m, a);
+}
+QNX_REDIRECT(pthread_mutex_init);
+
+int _qnx_pthread_mutex_destroy(sync_t *m)
+{
+	return mutex_destroy(m);
+}
+QNX_REDIRECT(pthread_mutex_destroy);
+
+int _qnx_pthread_mutex_lock(sync_t *m)
+{
+	return mutex_lock(m, CLOCK_REALTIME, 0);
+}
+QNX_REDIRECT(pthread_mutex_lock);
+
+int _qnx_pthread_mutex_trylock(sync_t *m)
+{
+	return fast_lock(m, __pthread_self()->tid);
+}
+QNX_REDIRECT(pthread_mutex_trylock);
+
+int _qnx_pthread_mutex_timedlock(sync_t *m, const struct qnx_timespec *at)
+{
+	struct timespec ts;
+	return mutex_lock(m, CLOCK_REALTIME, __qnx_timespec_to_linux(at, &ts));
+}
+QNX_REDIRECT(pthread_mutex_timedlock);
+
+int pthread_mutex_timedlock_monotonic(sync_t *m, const struct qnx_timespec *at)
+{
+	struct timespec ts;
+	return mutex_lock(m, CLOCK_MONOTONIC, __qnx_timespec_to_linux(at, &ts));
+}
+
+int _qnx_pthread_mutex_unlock(sync_t *m)
+{
+	return mutex_unlock(m);
+}
+QNX_REDIRECT(pthread_mutex_unlock);
+
+int _qnx_pthread_mutexattr_init(struct qnx_sync_attr *a)
+{
+	memset(a, 0, sizeof *a);
+	a->__protocol = QNX_PTHREAD_PRIO_INHERIT;
+	return 0;
+}
+QNX_REDIRECT(pthread_mutexattr_init);
+
+int _qnx_pthread_mutexattr_destroy(struct qnx_sync_attr *a)
+{
+	(void)a;
+	return 0;
+}
+QNX_REDIRECT(pthread_mutexattr_destroy);
+
+int _qnx_pthread_mutexattr_settype(struct qnx_sync_attr *a, int type)
+{
+	a->__flags &= ~(ATTR_RECURSIVE | ATTR_NOERRORCHECK);
+	switch (type) {
+	case QNX_PTHREAD_MUTEX_NORMAL:
+		a->__flags |= ATTR_NOERRORCHECK;
+		break;
+	case QNX_PTHREAD_MUTEX_RECURSIVE:
+		a->__flags |= ATTR_RECURSIVE;
+		break;
+	case QNX_PTHREAD_MUTEX_ERRORCHECK:
+	case QNX_PTHREAD_MUTEX_DEFAULT:
+		break;
+	default:
+		return EINVAL;
+	}
+	return 0;
+}
+QNX_REDIRECT(pthread_mutexattr_settype);
+
+int _qnx_pthread_mutexattr_gettype(const struct qnx_sync_attr *a, int *type)
+{
+	if (a->__flags & ATTR_RECURSIVE)
+		*type = QNX_PTHREAD_MUTEX_RECURSIVE;
+	else if (a->__flags & ATTR_NOERRORCHECK)
+		*type = QNX_PTHREAD_MUTEX_NORMAL;
+	else
+		*type = QNX_PTHREAD_MUTEX_ERRORCHECK;
+	return 0;
+}
+QNX_REDIRECT(pthread_mutexattr_gettype);
+
+int _qnx_pthread_mutexattr_setrecursive(struct qnx_sync_attr *a, int r)
+{
+	if (r == QNX_PTHREAD_RECURSIVE_ENABLE)
+		a->__flags |= ATTR_RECURSIVE;
+	else if (!r)
+		a->__flags &= ~ATTR_RECURSIVE;
+	else
+		return EINVAL;
+	return 0;
+}
+QNX_REDIRECT(pthread_mutexattr_setrecursive);
+
+int _qnx_pthread_mutexattr_getrecursive(const struct qnx_sync_attr *a,
+					int *r)
+{
+	*r = a->__flags & ATTR_RECURSIVE ? QNX_PTHREAD_RECURSIVE_ENABLE : 0;
+	return 0;
+}
+QNX_REDIRECT(pthread_mutexattr_getrecursive);
+
+int _qnx_pthread_mutexattr_setprotocol(struct qnx_sync_attr *a, int p)
+{
+	if (p < QNX_PTHREAD_PRIO_INHERIT || p > QNX_PTHREAD_PRIO_PROTECT)
+		return EINVAL;
+	a->__protocol = p;
+	return 0;
+}
+QNX_REDIRECT(pthread_mutexattr_setprotocol);
+
+int _qnx_pthread_mutexattr_getprotocol(const struct qnx_sync_attr *a,
+				       int *p)
+{
+	*p = a->__protocol;
+	return 0;
+}
+QNX_REDIRECT(pthread_mutexattr_getprotocol);
+
+int _qnx_pthread_mutexattr_setprioceiling(struct qnx_sync_attr *a, int c)
+{
+	a->__prioceiling = c;
+	return 0;
+}
+QNX_REDIRECT(pthread_mutexattr_setprioceiling);
+
+int _qnx_pthread_mutexattr_getprioceiling(const struct qnx_sync_attr *a,
+					  int *c)
+{
+	*c = a->__prioceiling;
+	return 0;
+}
+QNX_REDIRECT(pthread_mutexattr_getprioceiling);
+
+int _qnx_pthread_mutexattr_setpshared(struct qnx_sync_attr *a, int s)
+{
+	if (s == QNX_PTHREAD_PROCESS_SHARED)
+		a->__flags |= ATTR_SHARED;
+	else if (!s)
+		a->__flags &= ~ATTR_SHARED;
+	else
+		return EINVAL;
+	return 0;
+}
+QNX_REDIRECT(pthread_mutexattr_setpshared);
+
+int _qnx_pthread_mutexattr_getpshared(const struct qnx_sync_attr *a, int *s)
+{
+	*s = a->__flags & ATTR_SHARED ? QNX_PTHREAD_PROCESS_SHARED : 0;
+	return 0;
+}
+QNX_REDIRECT(pthread_mutexattr_getpshared);
+
+int _qnx_pthread_cond_init(sync_t *c, const struct qnx_sync_attr *a)
+{
+	c->__count = QNX_CLOCK_REALTIME;
+	if (a) {
+		c->__count = a->__clockid;
+		if (a->__flags & ATTR_SHARED)
+			c->__count |= SYNC_SHARED;
+	}
+	c->__owner = 0;
+	return 0;
+}
+QNX_REDIRECT(pthread_cond_init);
+
+int _qnx_pthread_cond_destroy(sync_t *c)
+{
+	c->__owner = _NTO_SYNC_DESTROYED;
+	return 0;
+}
+QNX_REDIRECT(pthread_cond_destroy);
+
+int _qnx_pthread_cond_wait(sync_t *c, sync_t *m)
+{
+	return cond_wait(c, m, 0);
+}
+QNX_REDIRECT(pthread_cond_wait);
+
+int _qnx_pthread_cond_timedwait(sync_t *c, sync_t *m,
+				const struct qnx_timespec *at)
+{
+	struct timespec ts;
+	return cond_wait(c, m, __qnx_timespec_to_linux(at, &ts));
+}
+QNX_REDIRECT(pthread_cond_timedwait);
+
+int _qnx_pthread_cond_signal(sync_t *c)
+{
+	return cond_signal(c, 0);
+}
+QNX_REDIRECT(pthread_cond_signal);
+
+int _qnx_pthread_cond_broadcast(sync_t *c)
+{
+	return cond_signal(c, 1);
+}
+QNX_REDIRECT(pthread_cond_broadcast);
+
+int _qnx_pthread_condattr_init(struct qnx_sync_attr *a)
+{
+	memset(a, 0, sizeof *a);
+	a->__clockid = QNX_CLOCK_REALTIME;
+	return 0;
+}
+QNX_REDIRECT(pthread_condattr_init);
+
+int _qnx_pthread_condattr_destroy(struct qnx_sync_attr *a)
+{
+	(void)a;
+	return 0;
+}
+QNX_REDIRECT(pthread_condattr_destroy);
+
+int _qnx_pthread_condattr_setclock(struct qnx_sync_attr *a, clockid_t id)
+{
+	if (id != QNX_CLOCK_REALTIME && id != QNX_CLOCK_MONOTONIC)
+		return EINVAL;
+	a->__clockid = id;
+	return 0;
+}
+QNX_REDIRECT(pthread_condattr_setclock);
+
+int _qnx_pthread_condattr_getclock(const struct qnx_sync_attr *a,
+				   clockid_t *id)
+{
+	*id = a->__clockid;
+	return 0;
+}
+QNX_REDIRECT(pthread_condattr_getclock);
+
+int _qnx_pthread_condattr_setpshared(struct qnx_sync_attr *a, int s)
+{
+	return _qnx_pthread_mutexattr_setpshared(a, s);
+}
+QNX_REDIRECT(pthread_condattr_setpshared);
+
+int _qnx_pthread_condattr_getpshared(const struct qnx_sync_attr *a, int *s)
+{
+	return _qnx_pthread_mutexattr_getpshared(a, s);
+}
+QNX_REDIRECT(pthread_condattr_getpshared);
+
+static int rw_private(const struct qnx_rwlock *rw)
+{
+	return !(rw->__heavy & ATTR_SHARED);
+}
+
+static inline int rw_tryrdlock(struct qnx_rwlock *rw)
+{
+	int v, n;
+
+	do {
+		v = rw->__active;
+		n = v & RW_WRITER;
+		if (n == RW_WRITER)
+			return rw->__owner == __pthread_self()->tid ? EDEADLK : EBUSY;
+		if (n == RW_WRITER - 1)
+			return EAGAIN;
+	} while (a_cas(&rw->__active, v, v + 1) != v);
+	return 0;
+}
+
+static inline int rw_trywrlock(struct qnx_rwlock *rw)
+{
+	unsigned tid = __pthread_self()->tid;
+	int v = a_cas(&rw->__active, 0, RW_WRITER);
+
+	if (v)
+		return (v & RW_WRITER) == RW_WRITER && rw->__owner == tid ?
+		       EDEADLK : EBUSY;
+	rw->__owner = tid;
+	return 0;
+}
+
+/* Sleep until the lock word changes from what made the caller wait. */
+static int rw_wait(struct qnx_rwlock *rw, volatile int *blocked, int v,
+		   const struct timespec *at)
+{
+	int r;
+
+	a_inc(blocked);
+	a_cas(&rw->__active, v, v | RW_WAITING);
+	r = __timedwait(&rw->__active, v | RW_WAITING, CLOCK_REALTIME, at,
+			rw_private(rw));
+	a_dec(blocked);
+	return r == EINTR ? 0 : r;
+}
+
+static int rw_rdlock(struct qnx_rwlock *rw, const struct timespec *at)
+{
+	int r = rw_tryrdlock(rw), spins = SPINS, v;
+
+	if (r != EBUSY)
+		return r;
+	while (spins-- && rw->__active &&
+	       !rw->__blockedreaders && !rw->__blockedwriters)
+		a_spin();
+	while ((r = rw_tryrdlock(rw)) == EBUSY) {
+		v = rw->__active;
+		if ((v & RW_WRITER) != RW_WRITER)
+			continue;
+		if ((r = rw_wait(rw, &rw->__blockedreaders, v, at)))
+			return r;
+	}
+	return r;
+}
+
+static int rw_wrlock(struct qnx_rwlock *rw, const struct timespec *at)
+{
+	int r = rw_trywrlock(rw), spins = SPINS, v;
+
+	if (r != EBUSY)
+		return r;
+	while (spins-- && rw->__active &&
+	       !rw->__blockedreaders && !rw->__blockedwriters)
+		a_spin();
+	while ((r = rw_trywrlock(rw)) == EBUSY) {
+		if (!(v = rw->__active))
+			continue;
+		if ((r = rw_wait(rw, &rw->__blockedwriters, v, at)))
+			return r;
+	}
+	return r;
+}
+
+static int rw_unlock(struct qnx_rwlock *rw)
+{
+	int v = rw->__active, n, next = 0;
+
+	if ((v & RW_WRITER) == RW_WRITER) {
+		if (rw->__owner != __pthread_self()->tid)
+			return EPERM;
+		/* Cleared first: the next writer sets it once it is in. */
+		rw->__owner = 0;
+		v = a_swap(&rw->__active, 0);
+	} else do {
+		v = rw->__active;
+		n = v & RW_WRITER;
+		if (!n)
+			return EPERM;
+		next = n == 1 ? 0 : v - 1;
+	} while (a_cas(&rw->__active, v, next) != v);
+	/* The last one out wakes everyone, readers may all get in. */
+	if (!next && (v < 0 || rw->__blockedreaders || rw->__blockedwriters))
+		__wake(&rw->__active, -1, rw_private(rw));
+	return 0;
+}
+
+int _qnx_pthread_rwlock_init(struct qnx_rwlock *rw,
+			     const struct qnx_pshared_attr *a)
+{
+	memset(rw, 0, sizeof *rw);
+	if (a && (a->__flags & ATTR_SHARED))
+		rw->__heavy = ATTR_SHARED;
+	return 0;
+}
+QNX_REDIRECT(pthread_rwlock_init);
+
+int _qnx_pthread_rwlock_destroy(struct qnx_rwlock *rw)
+{
+	return rw->__active & RW_WRITER ? EBUSY : 0;
+}
+QNX_REDIRECT(pthread_rwlock_destroy);
+
+int _qnx_pthread_rwlock_rdlock(struct qnx_rwlock *rw)
+{
+	return rw_rdlock(rw, 0);
+}
+QNX_REDIRECT(pthread_rwlock_rdlock);
+
+int _qnx_pthread_rwlock_tryrdlock(struct qnx_rwlock *rw)
+{
+	return rw_tryrdlock(rw);
+}
+QNX_REDIRECT(pthread_rwlock_tryrdlock);
+
+int _qnx_pthread_rwlock_timedrdlock(struct qnx_rwlock *rw,
+				    const struct qnx_timespec *at)
+{
+	struct timespec ts;
+	return rw_rdlock(rw, __qnx_timespec_to_linux(at, &ts));
+}
+QNX_REDIRECT(pthread_rwlock_timedrdlock);
+
+int _qnx_pthread_rwlock_wrlock(struct qnx_rwlock *rw)
+{
+	return rw_wrlock(rw, 0);
+}
+QNX_REDIRECT(pthread_rwlock_wrlock);
+
+int _qnx_pthread_rwlock_trywrlock(struct qnx_rwlock *rw)
+{
+	return rw_trywrlock(rw);
+}
+QNX_REDIRECT(pthread_rwlock_trywrlock);
+
+int _qnx_pthread_rwlock_timedwrlock(struct qnx_rwlock *rw,
+				    const struct qnx_timespec *at)
+{
+	struct timespec ts;
+	return rw_wrlock(rw, __qnx_timespec_to_linux(at, &ts));
+}
+QNX_REDIRECT(pthread_rwlock_timedwrlock);
+
+int _qnx_pthread_rwlock_unlock(struct qnx_rwlock *rw)
+{
+	return rw_unlock(rw);
+}
+QNX_REDIRECT(pthread_rwlock_unlock);
+
+static int pshared_set(struct qnx_pshared_attr *a, int s)
+{
+	if (s != 0 && s != QNX_PTHREAD_PROCESS_SHARED)
+		return EINVAL;
+	a->__flags = s ? ATTR_SHARED : 0;
+	return 0;
+}
+
+int _qnx_pthread_rwlockattr_init(struct qnx_pshared_attr *a)
+{
+	a->__flags = 0;
+	return 0;
+}
+QNX_REDIRECT(pthread_rwlockattr_init);
+
+int _qnx_pthread_rwlockattr_destroy(struct qnx_pshared_attr *a)
+{
+	(void)a;
+	return 0;
+}
+QNX_REDIRECT(pthread_rwlockattr_destroy);
+
+int _qnx_pthread_rwlockattr_setpshared(struct qnx_pshared_attr *a, int s)
+{
+	return pshared_set(a, s);
+}
+QNX_REDIRECT(pthread_rwlockattr_setpshared);
+
+int _qnx_pthread_rwlockattr_getpshared(const struct qnx_pshared_attr *a,
+				       int *s)
+{
+	*s = a->__flags & ATTR_SHARED ? QNX_PTHREAD_PROCESS_SHARED : 0;
+	return 0;
+}
+QNX_REDIRECT(pthread_rwlockattr_getpshared);
+
+int _qnx_pthread_barrier_init(struct qnx_barrier *b,
+			      const struct qnx_pshared_attr *a, unsigned count)
+{
+	if (!count)
+		return EINVAL;
+	memset(b, 0, sizeof *b);
+	b->__barrier = count;
+	if (a && (a->__flags & ATTR_SHARED))
+		b->__lock.__count = SYNC_SHARED;
+	return 0;
+}
+QNX_REDIRECT(pthread_barrier_init);
+
+int _qnx_pthread_barrier_destroy(struct qnx_barrier *b)
+{
+	return b->__count ? EBUSY : 0;
+}
+QNX_REDIRECT(pthread_barrier_destroy);
+
+/* The round is read before arriving, and the last to arrive resets the
+ * count before it starts the next round, so a thread that goes straight
+ * into the next round never counts in this one. */
+int _qnx_pthread_barrier_wait(struct qnx_barrier *b)
+{
+	volatile int *round = (volatile int *)&b->__bcond.__owner;
+	int priv = !(b->__lock.__count & SYNC_SHARED), seq = *round;
+	int spins = SPINS;
+
+	if ((unsigned)a_fetch_add((volatile int *)&b->__count, 1) + 1 ==
+	    b->__barrier) {
+		a_store((volatile int *)&b->__count, 0);
+		a_inc(round);
+		__wake(round, -1, priv);
+		return QNX_PTHREAD_BARRIER_SERIAL_THREAD;
+	}
+	while (spins-- && *round == seq)
+		a_spin();
+	while (*round == seq)
+		__wait(round, 0, seq, priv);
+	return 0;
+}
+QNX_REDIRECT(pthread_barrier_wait);
+
+int _qnx_pthread_barrierattr_init(struct qnx_pshared_attr *a)
+{
+	a->__flags = 0;
+	return 0;
+}
+QNX_REDIRECT(pthread_barrierattr_init);
+
+int _qnx_pthread_barrierattr_destroy(struct qnx_pshared_attr *a)
+{
+	(void)a;
+	return 0;
+}
+QNX_REDIRECT(pthread_barrierattr_destroy);
+
+int _qnx_pthread_barrierattr_setpshared(struct qnx_pshared_attr *a, int s)
+{
+	return pshared_set(a, s);
+}
+QNX_REDIRECT(pthread_barrierattr_setpshared);
+
+int _qnx_pthread_barrierattr_getpshared(const struct qnx_pshared_attr *a,
+					int *s)
+{
+	return _qnx_pthread_rwlockattr_getpshared(a, s);
+}
+QNX_REDIRECT(pthread_barrierattr_getpshared);
+
+int _qnx_pthread_spin_init(sync_t *s, int pshared)
+{
+	s->__count = pshared == QNX_PTHREAD_PROCESS_SHARED ? SYNC_SHARED : 0;
+	s->__owner = 0;
+	return 0;
+}
+QNX_REDIRECT(pthread_spin_init);
+
+int _qnx_pthread_spin_destroy(sync_t *s)
+{
+	return s->__owner ? EBUSY : 0;
+}
+QNX_REDIRECT(pthread_spin_destroy);
+
+int _qnx_pthread_spin_trylock(sync_t *s)
+{
+	return a_cas((volatile int *)&s->__owner, 0, 1) ? EBUSY : 0;
+}
+QNX_REDIRECT(pthread_spin_trylock);
+
+int _qnx_pthread_spin_lock(sync_t *s)
+{
+	volatile int *w = (volatile int *)&s->__owner;
+	int spins = SPINS;
+
+	if (!a_cas(w, 0, 1))
+		return 0;
+	while (spins--) {
+		if (!*w && !a_cas(w, 0, 1))
+			return 0;
+		a_spin();
+	}
+	/* Taken with a swap to 2, it stays marked for the wake on unlock. */
+	while (a_swap(w, 2))
+		__wait(w, 0, 2, !(s->__count & SYNC_SHARED));
+	return 0;
+}
+QNX_REDIRECT(pthread_spin_lock);
+
+int _qnx_pthread_spin_unlock(sync_t *s)
+{
+	if (a_swap((volatile int *)&s->__owner, 0) == 2)
+		__wake(&s->__owner, 1, !(s->__count & SYNC_SHARED));
+	return 0;
+}
+QNX_REDIRECT(pthread_spin_unlock);
+
+/* The Sync* kernel calls behind them. */
+int SyncMutexLock_r(sync_t *m)
+{
+	return -mutex_lock(m, CLOCK_REALTIME, 0);
+}
+
+int SyncMutexLock(sync_t *m)
+{
+	return nto_ret(SyncMutexLock_r(m));
+}
+
+int SyncMutexUnlock_r(sync_t *m)
+{
+	return -mutex_unlock(m);
+}
+
+int SyncMutexUnlock(sync_t *m)
+{
+	return nto_ret(SyncMutexUnlock_r(m));
+}
+
+int SyncCondvarWait_r(sync_t *c, sync_t *m)
+{
+	return -cond_wait(c, m, 0);
+}
+
+int SyncCondvarWait(sync_t *c, sync_t *m)
+{
+	return nto_ret(SyncCondvarWait_r(c, m));
+}
+
+int SyncCondvarSignal_r(sync_t *c, int all)
+{
+	return -cond_signal(c, all);
+}
+
+int SyncCondvarSignal(sync_t *c, int all)
+{
+	return nto_ret(SyncCondvarSignal_r(c, all));
+}
+
+int SyncDestroy_r(sync_t *s)
+{
+	return -mutex_destroy(s);
+}
+
+int SyncDestroy(sync_t *s)
+{
+	return nto_ret(SyncDestroy_r(s));
+}
+
+/* An owner that dies is not noticed, so the event is never delivered. */
+int SyncMutexEvent_r(sync_t *m, const void *event)
+{
+	(void)event;
+	return m->__owner == _NTO_SYNC_DESTROYED ? -EINVAL : EOK;
+}
+
+int SyncMutexEvent(sync_t *m, const void *event)
+{
+	return nto_ret(SyncMutexEvent_r(m, event));
+}
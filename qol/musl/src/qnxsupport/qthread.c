@@ -0,0 +1,448 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <sys/prctl.h>
+#include "syscall.h"
+#include "qnx_redirect.h"
+#include "qnx_sched.h"
+#include "neutrino/neutrino.h"
+
+/*
+ * QNX pthread_attr_t. QNX programs allocate the QNX layout (104 bytes
+ * on 64-bit targets, flags and policy values of its own) and set it
+ * through these shims, which store it as it is: every setter is a field
+ * store. It is turned into a musl attribute only in pthread_create.
+ * Its struct sched_param (qnx_sched.h) is read in place.
+ */
+
+struct qnx_pthread_attr {
+	int __flags;
+	size_t __stacksize;
+	void *__stackaddr;
+	void (*__exitfunc)(void *status);
+	int __policy;
+	struct qnx_sched_param __param;
+	unsigned __guardsize;
+	unsigned __prealloc;
+	int __spare[2];
+};
+
+#define QNX_PTHREAD_CREATE_DETACHED 0x01
+#define QNX_PTHREAD_EXPLICIT_SCHED 0x02
+#define QNX_PTHREAD_SCOPE_PROCESS 0x04
+
+#define QNX_GUARDSIZE 4096
+
+/* SCHED_SPORADIC has no Linux counterpart; round robin is closest. */
+int __qnx_policy_to_linux(int policy)
+{
+	switch (policy) {
+	case QNX_SCHED_FIFO:
+		return SCHED_FIFO;
+	case QNX_SCHED_RR:
+	case QNX_SCHED_SPORADIC:
+		return SCHED_RR;
+	case QNX_SCHED_OTHER:
+		return SCHED_OTHER;
+	}
+	return -1;
+}
+
+/* QNX priorities run to 255, Linux real time ones to 99. */
+int __qnx_prio_to_linux(int policy, int prio)
+{
+	if (policy == SCHED_OTHER)
+		return 0;
+	return prio < 1 ? 1 : prio > 99 ? 99 : prio;
+}
+
+int _qnx_pthread_attr_init(struct qnx_pthread_attr *a)
+{
+	memset(a, 0, sizeof *a);
+	a->__policy = QNX_SCHED_RR;
+	a->__param.sched_priority = 10;
+	a->__guardsize = QNX_GUARDSIZE;
+	return 0;
+}
+QNX_REDIRECT(pthread_attr_init);
+
+int _qnx_pthread_attr_destroy(struct qnx_pthread_attr *a)
+{
+	(void)a;
+	return 0;
+}
+QNX_REDIRECT(pthread_attr_destroy);
+
+static int set_flag(struct qnx_pthread_attr *a, int flag, int v)
+{
+	if (v & ~flag)
+		return EINVAL;
+	a->__flags = (a->__flags & ~flag) | v;
+	return 0;
+}
+
+int _qnx_pthread_attr_setdetachstate(struct qnx_pthread_attr *a, int v)
+{
+	return set_flag(a, QNX_PTHREAD_CREATE_DETACHED, v);
+}
+QNX_REDIRECT(pthread_attr_setdetachstate);
+
+int _qnx_pthread_attr_getdetachstate(const struct qnx_pthread_attr *a,
+				     int *v)
+{
+	*v = a->__flags & QNX_PTHREAD_CREATE_DETACHED;
+	return 0;
+}
+QNX_REDIRECT(pthread_attr_getdetachstate);
+
+int _qnx_pthread_attr_setinheritsched(struct qnx_pthread_attr *a, int v)
+{
+	return set_flag(a, QNX_PTHREAD_EXPLICIT_SCHED, v);
+}
+QNX_REDIRECT(pthread_attr_setinheritsched);
+
+int _qnx_pthread_attr_getinheritsched(const struct qnx_pthread_attr *a,
+				      int *v)
+{
+	*v = a->__flags & QNX_PTHREAD_EXPLICIT_SCHED;
+	return 0;
+}
+QNX_REDIRECT(pthread_attr_getinheritsched);
+
+int _qnx_pthread_attr_setscope(struct qnx_pthread_attr *a, int v)
+{
+	/* Every Linux thread is a system scope thread. */
+	return v ? ENOTSUP : set_flag(a, QNX_PTHREAD_SCOPE_PROCESS, v);
+}
+QNX_REDIRECT(pthread_attr_setscope);
+
+int _qnx_pthread_attr_getscope(const struct qnx_pthread_attr *a, int *v)
+{
+	*v = a->__flags & QNX_PTHREAD_SCOPE_PROCESS;
+	return 0;
+}
+QNX_REDIRECT(pthread_attr_getscope);
+
+int _qnx_pthread_attr_setschedpolicy(struct qnx_pthread_attr *a, int v)
+{
+	if (__qnx_policy_to_linux(v) < 0)
+		return EINVAL;
+	a->__policy = v;
+	return 0;
+}
+QNX_REDIRECT(pthread_attr_setschedpolicy);
+
+int _qnx_pthread_attr_getschedpolicy(const struct qnx_pthread_attr *a,
+				     int *v)
+{
+	*v = a->__policy;
+	return 0;
+}
+QNX_REDIRECT(pthread_attr_getschedpolicy);
+
+int _qnx_pthread_attr_setschedparam(struct qnx_pthread_attr *a,
+				    const struct qnx_sched_param *p)
+{
+	a->__param = *p;
+	return 0;
+}
+QNX_REDIRECT(pthread_attr_setschedparam);
+
+int _qnx_pthread_attr_getschedparam(const struct qnx_pthread_attr *a,
+				    struct qnx_sched_param *p)
+{
+	*p = a->__param;
+	return 0;
+}
+QNX_REDIRECT(pthread_attr_getschedparam);
+
+int _qnx_pthread_attr_setstacksize(struct qnx_pthread_attr *a, size_t v)
+{
+	if (v < PTHREAD_STACK_MIN)
+		return EINVAL;
+	a->__stacksize = v;
+	return 0;
+}
+QNX_REDIRECT(pthread_attr_setstacksize);
+
+int _qnx_pthread_attr_getstacksize(const struct qnx_pthread_attr *a,
+				   size_t *v)
+{
+	*v = a->__stacksize;
+	return 0;
+}
+QNX_REDIRECT(pthread_attr_getstacksize);
+
+/* QNX takes stackaddr, like setstack, as the lowest address. */
+int _qnx_pthread_attr_setstackaddr(struct qnx_pthread_attr *a, void *v)
+{
+	a->__stackaddr = v;
+	return 0;
+}
+QNX_REDIRECT(pthread_attr_setstackaddr);
+
+int _qnx_pthread_attr_getstackaddr(const struct qnx_pthread_attr *a,
+				   void **v)
+{
+	*v = a->__stackaddr;
+	return 0;
+}
+QNX_REDIRECT(pthread_attr_getstackaddr);
+
+int _qnx_pthread_attr_setstack(struct qnx_pthread_attr *a, void *addr,
+			       size_t size)
+{
+	if (size < PTHREAD_STACK_MIN)
+		return EINVAL;
+	a->__stackaddr = addr;
+	a->__stacksize = size;
+	return 0;
+}
+QNX_REDIRECT(pthread_attr_setstack);
+
+int _qnx_pthread_attr_getstack(const struct qnx_pthread_attr *a,
+			       void **addr, size_t *size)
+{
+	*addr = a->__stackaddr;
+	*size = a->__stacksize;
+	return 0;
+}
+QNX_REDIRECT(pthread_attr_getstack);
+
+int _qnx_pthread_attr_setguardsize(struct qnx_pthread_attr *a, size_t v)
+{
+	if (v > UINT32_MAX)
+		return EINVAL;
+	a->__guardsize = v;
+	return 0;
+}
+QNX_REDIRECT(pthread_attr_setguardsize);
+
+int _qnx_pthread_attr_getguardsize(const struct qnx_pthread_attr *a,
+				   size_t *v)
+{
+	*v = a->__guardsize;
+	return 0;
+}
+QNX_REDIRECT(pthread_attr_getguardsize);
+
+/*
+ * The one conversion. An explicit real time policy the process may
+ * not use on Linux (no CAP_SYS_NICE or RLIMIT_RTPRIO) falls back to
+ * inheriting, since QNX lets any process pick priorities below 64.
+ */
+int _qnx_pthread_create(pthread_t *restrict t,
+			const struct qnx_pthread_attr *restrict a,
+			void *(*fn)(void *), void *arg)
+{
+	pthread_attr_t la;
+	int ret;
+
+	if (!a)
+		return pthread_create(t, 0, fn, arg);
+	pthread_attr_init(&la);
+	if (a->__flags & QNX_PTHREAD_CREATE_DETACHED)
+		pthread_attr_setdetachstate(&la, PTHREAD_CREATE_DETACHED);
+	if (a->__stackaddr)
+		pthread_attr_setstack(&la, a->__stackaddr, a->__stacksize);
+	else if (a->__stacksize)
+		pthread_attr_setstacksize(&la, a->__stacksize);
+	pthread_attr_setguardsize(&la, a->__guardsize);
+	if (a->__flags & QNX_PTHREAD_EXPLICIT_SCHED) {
+		int policy = __qnx_policy_to_linux(a->__policy);
+		struct sched_param sp = {
+			.sched_priority = __qnx_prio_to_linux(
+				policy, a->__param.sched_priority)
+		};
+		pthread_attr_setinheritsched(&la, PTHREAD_EXPLICIT_SCHED);
+		pthread_attr_setschedpolicy(&la, policy);
+		pthread_attr_setschedparam(&la, &sp);
+	}
+	ret = pthread_create(t, &la, fn, arg);
+	if (ret == EPERM && (a->__flags & QNX_PTHREAD_EXPLICIT_SCHED)) {
+		pthread_attr_setinheritsched(&la, PTHREAD_INHERIT_SCHED);
+		ret = pthread_create(t, &la, fn, arg);
+	}
+	return ret;
+}
+QNX_REDIRECT(pthread_create);
+
+/*
+ * Runmasks. QNX numbers CPUs 0 to n - 1; here bit i is the i-th CPU the
+ * process was allowed at startup, so a mask means the same cores inside
+ * a cpuset or with CPUs offline. The table is filled once, in
+ * _init_libc, and only read after that, so spawn can use it in the
+ * vfork child.
+ */
+
+#define RMSK_WORDS (CPU_SETSIZE / 32)
+
+static unsigned short cpu_map[CPU_SETSIZE];
+static int ncpu;
+
+void __qnx_cpu_init(void)
+{
+	cpu_set_t set;
+	int i, n = 0;
+
+	if (__syscall(SYS_sched_getaffinity, 0, sizeof set, &set) < 0)
+		return;
+	for (i = 0; i < CPU_SETSIZE; i++)
+		if (CPU_ISSET(i, &set))
+			cpu_map[n++] = i;
+	ncpu = n;
+}
+
+int __qnx_cpus(const unsigned short **map)
+{
+	*map = cpu_map;
+	return ncpu;
+}
+
+/* Returns the number of CPUs in the set; bits past the last CPU drop. */
+int __qnx_runmask_to_linux(const unsigned *mask, int words, void *set)
+{
+	int i, n = 0;
+
+	CPU_ZERO((cpu_set_t *)set);
+	for (i = 0; i < words * 32 && i < ncpu; i++) {
+		if (mask[i / 32] >> i % 32 & 1) {
+			CPU_SET(cpu_map[i], (cpu_set_t *)set);
+			n++;
+		}
+	}
+	return n;
+}
+
+void __qnx_runmask_from_linux(const void *set, unsigned *mask, int words)
+{
+	int i;
+
+	memset(mask, 0, words * sizeof *mask);
+	for (i = 0; i < words * 32 && i < ncpu; i++)
+		if (CPU_ISSET(cpu_map[i], (const cpu_set_t *)set))
+			mask[i / 32] |= 1u << i % 32;
+}
+
+#define _NTO_TCTL_IO 1
+#define _NTO_TCTL_THREADS_HOLD 2
+#define _NTO_TCTL_THREADS_CONT 3
+#define _NTO_TCTL_RUNMASK 4
+#define _NTO_TCTL_ALIGN_FAULT 5
+#define _NTO_TCTL_RUNMASK_GET_AND_SET 6
+#define _NTO_TCTL_RUNMASK_GET_AND_SET_INHERIT 10
+#define _NTO_TCTL_NAME 11
+#define _NTO_TCTL_IO_PRIV 14
+
+struct _thread_name {
+	int new_name_len;
+	int name_buf_len;
+	char name_buf[];
+};
+
+static int nonzero(const unsigned *mask, int words)
+{
+	while (words--)
+		if (mask[words])
+			return 1;
+	return 0;
+}
+
+/*
+ * Old masks are read back before the new one is set, so one call both
+ * sets and returns, as QNX does; a zero mask leaves the runmask alone.
+ */
+static int runmask(unsigned *mask, int words)
+{
+	unsigned old[RMSK_WORDS];
+	cpu_set_t set;
+	int ret;
+
+	if (words < 1 || words > RMSK_WORDS)
+		return -EINVAL;
+	if ((ret = __syscall(SYS_sched_getaffinity, 0, sizeof set, &set)) < 0)
+		return ret;
+	__qnx_runmask_from_linux(&set, old, words);
+	if (nonzero(mask, words)) {
+		if (!__qnx_runmask_to_linux(mask, words, &set))
+			return -EINVAL;
+		if ((ret = __syscall(SYS_sched_setaffinity, 0, sizeof set,
+				     &set)) < 0)
+			return ret;
+	}
+	memcpy(mask, old, words * sizeof *mask);
+	return 0;
+}
+
+/* Linux keeps no name past 15 bytes and has no way to clear one. */
+static int thread_name(struct _thread_name *tn)
+{
+	char old[16] = { 0 }, new[16];
+	int ret, n;
+
+	if ((ret = __syscall(SYS_prctl, PR_GET_NAME, old)) < 0)
+		return ret;
+	if (tn->new_name_len > 0) {
+		n = tn->new_name_len < 15 ? tn->new_name_len : 15;
+		memcpy(new, tn->name_buf, n);
+		new[n] = 0;
+		if ((ret = __syscall(SYS_prctl, PR_SET_NAME, new)) < 0)
+			return ret;
+	}
+	if (tn->name_buf_len > 0) {
+		n = strnlen(old, tn->name_buf_len - 1);
+		memcpy(tn->name_buf, old, n);
+		tn->name_buf[n] = 0;
+	}
+	return 0;
+}
+
+/*
+ * The inherit mask is taken and handed back but has no effect of its
+ * own: Linux threads and children inherit the runmask itself.
+ */
+int ThreadCtl_r(int cmd, void *data)
+{
+	unsigned mask;
+	int *size;
+	int ret;
+
+	if (!ncpu)
+		__qnx_cpu_init();
+	switch (cmd) {
+	case _NTO_TCTL_IO:
+	case _NTO_TCTL_IO_PRIV:
+#ifdef SYS_iopl
+		return __syscall(SYS_iopl, 3);
+#else
+		return 0;
+#endif
+	case _NTO_TCTL_ALIGN_FAULT:
+		return 0;
+	case _NTO_TCTL_RUNMASK:
+		mask = (uintptr_t)data;
+		return mask ? runmask(&mask, 1) : -EINVAL;
+	case _NTO_TCTL_RUNMASK_GET_AND_SET:
+		return runmask(data, 1);
+	case _NTO_TCTL_RUNMASK_GET_AND_SET_INHERIT:
+		size = data;
+		if ((ret = runmask((unsigned *)(size + 1), *size)) < 0)
+			return ret;
+		memcpy((unsigned *)(size + 1) + *size, size + 1,
+		       *size * sizeof(unsigned));
+		return 0;
+	case _NTO_TCTL_NAME:
+		return thread_name(data);
+	}
+	return -ENOSYS;
+}
+
+int ThreadCtl(int cmd, void *data)
+{
+	return nto_ret(ThreadCtl_r(cmd, data));
+}
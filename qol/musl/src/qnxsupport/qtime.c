@@ -1,9 +1,23 @@
 #define _GNU_SOURCE
 #include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/timex.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include "qnx_redirect.h"
+#include "qnx_time.h"
+
+#define QNX_CLOCK_REALTIME 0
+#define QNX_CLOCK_SOFTTIME 1
+#define QNX_CLOCK_MONOTONIC 2
+#define QNX_CLOCK_PROCESS_CPUTIME_ID 3
+#define QNX_CLOCK_THREAD_CPUTIME_ID 4
 
 struct qnx_timeval {
-	long tv_sec;
-	int tv_usec;
+	qnx_time_t tv_sec;
+	int32_t tv_usec;
 };
 
 static struct timeval qnx_timeval_to_linux(struct qnx_timeval t)
@@ -13,26 +27,191 @@ static struct timeval qnx_timeval_to_linux(struct qnx_timeval t)
 	return ret;
 }
 
+/* The utimes family straight to utimensat: a null times is "now" for
+ * both, and an out of range tv_usec is an out of range tv_nsec. */
+static int qnx_utimens(int fd, const char *path, const struct qnx_timeval *tv,
+		       int flags)
+{
+	struct timespec ts[2];
+
+	if (tv)
+		for (int i = 0; i < 2; i++)
+			ts[i] = (struct timespec){
+				tv[i].tv_sec,
+				tv[i].tv_usec >= 0 && tv[i].tv_usec < 1000000 ?
+					tv[i].tv_usec * 1000 : -1
+			};
+	return utimensat(fd, path, tv ? ts : 0, flags);
+}
+
 int _qnx_utimes(const char *filename, const struct qnx_timeval times[2])
 {
-	struct timeval t[2];
+	return qnx_utimens(AT_FDCWD, filename, times, 0);
+}
+QNX_REDIRECT(utimes);
 
-	t[0] = qnx_timeval_to_linux(times[0]);
-	t[1] = qnx_timeval_to_linux(times[1]);
+int _qnx_lutimes(const char *filename, const struct qnx_timeval times[2])
+{
+	return qnx_utimens(AT_FDCWD, filename, times, AT_SYMLINK_NOFOLLOW);
+}
+QNX_REDIRECT(lutimes);
 
-	return utimes(filename, t);
+int _qnx_futimes(int fd, const struct qnx_timeval times[2])
+{
+	return qnx_utimens(fd, 0, times, 0);
 }
+QNX_REDIRECT(futimes);
 
+/* clock_gettime goes through the vDSO, so none of these enter the kernel. */
 int _qnx_gettimeofday(struct qnx_timeval *when, void *not_used)
 {
-	struct timeval t = qnx_timeval_to_linux(*when);
+	struct timespec ts;
 
-	return gettimeofday(&t, not_used);
+	if (!when)
+		return 0;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	when->tv_sec = ts.tv_sec;
+	when->tv_usec = ts.tv_nsec / 1000;
+	return 0;
 }
+QNX_REDIRECT(gettimeofday);
 
+/* A null when leaves the time alone, as the time zone is never set. */
 int _qnx_settimeofday(const struct qnx_timeval *when, void *not_used)
 {
-	struct timeval t = qnx_timeval_to_linux(*when);
+	struct timeval t;
 
+	if (!when)
+		return 0;
+	t = qnx_timeval_to_linux(*when);
 	return settimeofday(&t, 0);
 }
+QNX_REDIRECT(settimeofday);
+
+/* QNX and Linux number their clocks differently. */
+clockid_t __qnx_clock_to_linux(clockid_t id)
+{
+	switch (id) {
+	case QNX_CLOCK_REALTIME:
+	case QNX_CLOCK_SOFTTIME:
+		return CLOCK_REALTIME;
+	case QNX_CLOCK_MONOTONIC:
+		return CLOCK_MONOTONIC;
+	case QNX_CLOCK_PROCESS_CPUTIME_ID:
+		return CLOCK_PROCESS_CPUTIME_ID;
+	case QNX_CLOCK_THREAD_CPUTIME_ID:
+		return CLOCK_THREAD_CPUTIME_ID;
+	}
+	/* Per-process and per-thread CPU clocks from clock_getcpuclockid */
+	return id < 0 ? id : -1;
+}
+
+int _qnx_clock_gettime(clockid_t id, struct qnx_timespec *qts)
+{
+	clockid_t lid = __qnx_clock_to_linux(id);
+	struct timespec ts;
+
+	if (lid == -1) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (clock_gettime(lid, &ts))
+		return -1;
+	qts->tv_sec = ts.tv_sec;
+	qts->tv_nsec = ts.tv_nsec;
+	return 0;
+}
+QNX_REDIRECT(clock_gettime);
+
+int ClockTime(clockid_t id, const uint64_t *new, uint64_t *old)
+{
+	clockid_t lid = __qnx_clock_to_linux(id);
+	struct timespec ts;
+
+	if (lid == -1) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (old) {
+		if (clock_gettime(lid, &ts))
+			return -1;
+		*old = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	}
+	if (new) {
+		ts.tv_sec = *new / 1000000000ULL;
+		ts.tv_nsec = *new % 1000000000ULL;
+		if (clock_settime(lid, &ts))
+			return -1;
+	}
+	return 0;
+}
+
+/* Free-running cycle counter, as QNX reads it: the TSC on x86, the
+ * virtual counter on ARM. Its rate is SYSPAGE_ENTRY(qtime)->cycles_per_sec. */
+uint64_t ClockCycles(void)
+{
+	return qnx_cycles();
+}
+
+struct _clockperiod {
+	uint32_t nsec;
+	int32_t fract;
+};
+
+/*
+ * Linux timers are not tick based, so the period QNX programs read is
+ * the clock's resolution and the one they set has nothing to change:
+ * it is accepted, because programs that ask for a finer tick only want
+ * timers that fire on time, which they get anyway.
+ */
+int ClockPeriod(clockid_t id, const struct _clockperiod *new,
+		struct _clockperiod *old, int reserved)
+{
+	clockid_t lid = __qnx_clock_to_linux(id);
+	struct timespec ts;
+
+	if (lid == -1) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (old) {
+		if (clock_getres(lid, &ts))
+			return -1;
+		old->nsec = ts.tv_nsec;
+		old->fract = 0;
+	}
+	return 0;
+}
+
+struct _clockadjust {
+	uint32_t tick_count;
+	int32_t tick_nsec_inc;
+};
+
+/*
+ * QNX slews the realtime clock by tick_nsec_inc on each of the next
+ * tick_count ticks; a single shot adjtimex slews it by the same total
+ * at the kernel's own rate. The adjustment still to go comes back as
+ * one tick of all of it.
+ */
+int ClockAdjust(clockid_t id, const struct _clockadjust *new,
+		struct _clockadjust *old)
+{
+	struct timex tx = { .modes = ADJ_OFFSET_SS_READ };
+
+	if (id != QNX_CLOCK_REALTIME) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (new) {
+		tx.modes = ADJ_OFFSET_SINGLESHOT;
+		tx.offset = (int64_t)new->tick_count * new->tick_nsec_inc / 1000;
+	}
+	if (adjtimex(&tx) < 0)
+		return -1;
+	if (old) {
+		old->tick_count = tx.offset != 0;
+		old->tick_nsec_inc = tx.offset * 1000;
+	}
+	return 0;
+}
@@ -0,0 +1,59 @@
+#include <errno.h>
+#include <sys/ioctl.h>
+#include "qnx_signal.h"
+
+/*
+ * QNX console tools ask for the window size as often as once per line
+ * of output, so the answer is kept per fd until the next SIGWINCH (see
+ * __qnx_winch_gen). Without a way to see SIGWINCH every call asks the
+ * terminal. A terminal that does not know its size gets QNX's 24x80.
+ */
+#define TTY_CACHE 64
+
+static struct {
+	int gen;
+	unsigned short rows, cols;
+} tty_cache[TTY_CACHE];
+
+int tcgetsize(int fd, int *prows, int *pcols)
+{
+	struct winsize ws;
+	int gen = __qnx_winch_gen();
+	int cache = gen >= 0 && (unsigned)fd < TTY_CACHE;
+
+	/* Entries hold gen + 1, so a zeroed one never matches. */
+	if (cache && tty_cache[fd].gen == gen + 1) {
+		ws.ws_row = tty_cache[fd].rows;
+		ws.ws_col = tty_cache[fd].cols;
+	} else {
+		if (ioctl(fd, TIOCGWINSZ, &ws))
+			return -1;
+		if (!ws.ws_row)
+			ws.ws_row = 24;
+		if (!ws.ws_col)
+			ws.ws_col = 80;
+		if (cache) {
+			tty_cache[fd].rows = ws.ws_row;
+			tty_cache[fd].cols = ws.ws_col;
+			tty_cache[fd].gen = gen + 1;
+		}
+	}
+	if (prows)
+		*prows = ws.ws_row;
+	if (pcols)
+		*pcols = ws.ws_col;
+	return 0;
+}
+
+int tcsetsize(int fd, int rows, int cols)
+{
+	struct winsize ws;
+
+	if (ioctl(fd, TIOCGWINSZ, &ws))
+		return -1;
+	ws.ws_row = rows;
+	ws.ws_col = cols;
+	if ((unsigned)fd < TTY_CACHE)
+		tty_cache[fd].gen = 0;
+	return ioctl(fd, TIOCSWINSZ, &ws);
+}
@@ -0,0 +1,286 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "pthread_impl.h"
+#include "fork_impl.h"
+#include "qnx_shimstats.h"
+#include "qnx_probe.h"
+
+/*
+ * LD_QNX_SHIMSTATS: the dynamic linker binds every redirected symbol to
+ * a wrapper of its own, which counts the calls to the shim and how long
+ * each took, so that the shims on a program's hot paths can be found.
+ * Results go to /dev/shm/qnx-shimstats.<pid>, which can be read while
+ * the program runs and is left behind when it exits; shimstats.py
+ * prints it. Forked children start a file of their own.
+ *
+ * Counts are kept per thread: a thread takes one of SHIM_SLOTS - 1
+ * private slots on its first call and gives it back when it exits, and
+ * only threads that find none free use the last slot, with atomic adds.
+ * A slot's record for a shim holds the number of calls, their total
+ * time and a log-linear histogram of their times in ns: values below 16
+ * have a bucket each, then every power of two is split into 8, which
+ * keeps each bucket within 12.5% of the values in it, up to 2^40 ns.
+ *
+ * A wrapper goes through __qnx_shim_entry (x86_64/shimtramp.s), which
+ * calls __qnx_shim_enter with the arguments saved. That pushes the
+ * return address and clock onto a per-thread stack and has the shim
+ * return to __qnx_shim_return, which calls __qnx_shim_leave to time
+ * the call and pop the real return address. Entries are found by the
+ * address of the return address, so one left behind by longjmp is
+ * dropped when a caller further out returns. When the stack is full,
+ * calls go to the shim unwrapped and are not counted.
+ *
+ * File format (native endian, read by shimstats.py):
+ *     header   char magic[8] "qnxshim1"; u32 nshims, nslots, nbuckets,
+ *              pid, names, data; u32 pad[8]
+ *     names    nshims char[48] at offset names
+ *     records  at offset data, nslots x nshims of
+ *              {u64 calls, ns, hist[nbuckets]}, slot major
+ */
+
+#define SHIM_SLOTS 64
+#define SHIM_SHARED (SHIM_SLOTS - 1)
+#define SHIM_BUCKETS (16 + 36 * 8)
+#define SHIM_DEPTH 256
+#define SHIM_NAME 48
+#define SHIM_STUB 32
+
+struct shim_hdr {
+	char magic[8];
+	uint32_t nshims, nslots, nbuckets, pid, names, data;
+	uint32_t pad[8];
+};
+
+struct shim_rec {
+	uint64_t calls, ns, hist[SHIM_BUCKETS];
+};
+
+struct shim_thread {
+	int slot;
+	int top;
+	struct {
+		uintptr_t ret, *where;
+		uint64_t t0;
+		size_t idx;
+	} f[SHIM_DEPTH];
+};
+
+hidden uintptr_t __qnx_shim_enter(unsigned, uintptr_t *);
+hidden uintptr_t __qnx_shim_leave(uintptr_t *);
+extern hidden char __qnx_shim_entry[], __qnx_shim_return[];
+
+static const struct qnx_redirect *shims;
+static size_t nshims, map_size;
+static struct shim_hdr *hdr;
+static uintptr_t *targets;
+static unsigned char *stubs;
+static volatile int slot_used[SHIM_SHARED];
+
+static uint64_t now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static unsigned bucket(uint64_t v)
+{
+	int e;
+
+	if (v < 16)
+		return v;
+	e = 63 - __builtin_clzll(v);
+	if (e >= 40)
+		return SHIM_BUCKETS - 1;
+	return 16 + (e - 4) * 8 + (v >> (e - 3) & 7);
+}
+
+/* A new stats file for this process, or a private mapping of the same
+ * layout if the file cannot be made, so that the counters, and a
+ * parent's file after fork, are never left dangling. */
+static struct shim_hdr *map_stats(void)
+{
+	char path[40];
+	struct shim_hdr *h = MAP_FAILED;
+	size_t i;
+	int fd;
+
+	snprintf(path, sizeof path, "/dev/shm/qnx-shimstats.%d", getpid());
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd >= 0) {
+		if (!ftruncate(fd, map_size))
+			h = mmap(0, map_size, PROT_READ | PROT_WRITE,
+				 MAP_SHARED, fd, 0);
+		close(fd);
+	}
+	if (h == MAP_FAILED)
+		h = mmap(0, map_size, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (h == MAP_FAILED)
+		return 0;
+
+	h->nshims = nshims;
+	h->nslots = SHIM_SLOTS;
+	h->nbuckets = SHIM_BUCKETS;
+	h->pid = getpid();
+	h->names = sizeof *h;
+	h->data = sizeof *h + nshims * SHIM_NAME + 63 & -64;
+	for (i = 0; i < nshims; i++)
+		strncpy((char *)h + h->names + i * SHIM_NAME, shims[i].name,
+			SHIM_NAME - 1);
+	memcpy(h->magic, "qnxshim1", 8);
+	return h;
+}
+
+int __qnx_shimstats_init(const struct qnx_redirect *r, size_t n)
+{
+#ifdef __x86_64__
+	size_t code = n * SHIM_STUB + PAGE_SIZE - 1 & -PAGE_SIZE, i;
+	unsigned char *c;
+	uint32_t idx;
+	void *entry = __qnx_shim_entry;
+
+	shims = r;
+	nshims = n;
+	map_size = sizeof *hdr + n * SHIM_NAME + 63 & -64;
+	map_size += SHIM_SLOTS * n * sizeof(struct shim_rec);
+	stubs = mmap(0, code + n * sizeof *targets, PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (stubs == MAP_FAILED)
+		return -1;
+	targets = (void *)(stubs + code);
+	for (i = 0; i < n; i++) {
+		/* mov $i,%r11d; jmp *0(%rip); .quad __qnx_shim_entry */
+		c = stubs + i * SHIM_STUB;
+		idx = i;
+		*c++ = 0x41; *c++ = 0xbb;
+		memcpy(c, &idx, 4); c += 4;
+		*c++ = 0xff; *c++ = 0x25;
+		memset(c, 0, 4); c += 4;
+		memcpy(c, &entry, 8);
+	}
+	if (mprotect(stubs, code, PROT_READ | PROT_EXEC) ||
+	    !(hdr = map_stats())) {
+		munmap(stubs, code + n * sizeof *targets);
+		return -1;
+	}
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+void *__qnx_shimstats_wrap(size_t idx, void *target)
+{
+	if (!hdr || idx >= nshims)
+		return 0;
+	targets[idx] = (uintptr_t)target;
+	return stubs + idx * SHIM_STUB;
+}
+
+static struct shim_thread *thread_start(pthread_t self)
+{
+	struct shim_thread *t;
+	int e = errno, i;
+
+	t = mmap(0, sizeof *t, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	errno = e;
+	if (t == MAP_FAILED)
+		return 0;
+	for (i = 0; i < SHIM_SHARED && a_cas(&slot_used[i], 0, 1); i++);
+	t->slot = i;
+	self->qnx_shimstats = t;
+	return t;
+}
+
+uintptr_t __qnx_shim_enter(unsigned idx, uintptr_t *ret)
+{
+	pthread_t self = __pthread_self();
+	struct shim_thread *t = self->qnx_shimstats;
+	int i;
+
+	if ((!t && !(t = thread_start(self))) || t->top == SHIM_DEPTH)
+		return targets[idx];
+	/* Taken before it is filled in, so that a signal handler's calls
+	 * go above it. */
+	i = t->top++;
+	__asm__ __volatile__ ("" : : : "memory");
+	t->f[i].ret = *ret;
+	t->f[i].where = ret;
+	t->f[i].idx = idx;
+	t->f[i].t0 = now();
+	QNX_PROBE1(shim_entry, shims[idx].target);
+	*ret = (uintptr_t)__qnx_shim_return;
+	return targets[idx];
+}
+
+uintptr_t __qnx_shim_leave(uintptr_t *where)
+{
+	uint64_t ns = now();
+	struct shim_thread *t = __pthread_self()->qnx_shimstats;
+	struct shim_rec *r;
+	uintptr_t ret;
+	unsigned b;
+	int i = t->top;
+
+	while (i-- && t->f[i].where != where);
+	if (i < 0)
+		a_crash();
+	ns -= t->f[i].t0;
+	ret = t->f[i].ret;
+	r = (void *)((char *)hdr + hdr->data);
+	r += t->slot * nshims + t->f[i].idx;
+	__asm__ __volatile__ ("" : : : "memory");
+	t->top = i;
+	QNX_PROBE2(shim_return, shims[t->f[i].idx].target, ns);
+
+	b = bucket(ns);
+	if (t->slot < SHIM_SHARED) {
+		r->calls++;
+		r->ns += ns;
+		r->hist[b]++;
+	} else {
+		__atomic_fetch_add(&r->calls, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&r->ns, ns, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&r->hist[b], 1, __ATOMIC_RELAXED);
+	}
+	return ret;
+}
+
+void __qnx_shimstats_thread_exit(void)
+{
+	pthread_t self = __pthread_self();
+	struct shim_thread *t = self->qnx_shimstats;
+
+	if (!t)
+		return;
+	self->qnx_shimstats = 0;
+	if (t->slot < SHIM_SHARED)
+		a_store(&slot_used[t->slot], 0);
+	munmap(t, sizeof *t);
+}
+
+/* The child's only thread keeps its slot; the others' are free. */
+void __qnx_shimstats_atfork(int who)
+{
+	struct shim_thread *t = __pthread_self()->qnx_shimstats;
+	struct shim_hdr *old = hdr;
+	int i;
+
+	if (who != 1 || !hdr)
+		return;
+	if (!(hdr = map_stats()))
+		hdr = old;
+	else
+		munmap(old, map_size);
+	for (i = 0; i < SHIM_SHARED; i++)
+		slot_used[i] = t && t->slot == i;
+}
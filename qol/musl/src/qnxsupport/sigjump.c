@@ -1,9 +1,100 @@
 #include <setjmp.h>
+#include <signal.h>
+#include "pthread_impl.h"
+#include "qnx_redirect.h"
+#include "qnx_signal.h"
+
+/*
+ * QNX sigsetjmp is a macro, __sigjmp_prolog(env, msk) and then
+ * setjmp(env), and siglongjmp restores what the prolog saved before it
+ * jumps. What a QNX jmp_buf keeps past the registers differs between
+ * targets, and musl's setjmp lays out the start of it its own way, so
+ * the flag and mask are kept beside the buffer instead: in a few slots
+ * of the calling thread, keyed by the buffer's address. The oldest
+ * slot goes when all are taken, and a jump to it then leaves the mask
+ * alone, as this did before.
+ *
+ * Each thread counts the changes to its mask that QOL sees: QNX
+ * sigprocmask and pthread_sigmask, and the entry to a QNX signal
+ * handler. While the count stands, sigsetjmp takes the mask it read
+ * last, and siglongjmp knows the mask is still the saved one. An error
+ * handler that longjmps back without touching the mask then makes no
+ * system call at all. A change made past QOL, by native code calling
+ * Linux's sigprocmask, is not seen.
+ */
+
+#define SLOTS (sizeof ((struct pthread *)0)->qnx_sigjmp / \
+	       sizeof ((struct pthread *)0)->qnx_sigjmp[0])
+
+void __qnx_sigmask_changed(void)
+{
+	__pthread_self()->qnx_sigmask_gen++;
+}
+
+/* QNX handlers count a change on entry and again on return, so the
+ * mask read stays right whenever the count it is filed under does. */
+static uint64_t current_mask(pthread_t self)
+{
+	unsigned gen = self->qnx_sigmask_gen;
+	uint64_t mask;
+
+	if (self->qnx_sigmask_known == gen + 1)
+		return self->qnx_sigmask;
+	__syscall(SYS_rt_sigprocmask, SIG_BLOCK, 0, &mask, _NSIG/8);
+	self->qnx_sigmask = mask;
+	self->qnx_sigmask_known = gen + 1;
+	return mask;
+}
+
+/* The slot of env, else a free one, else the one filed longest ago. */
+static int slot_of(pthread_t self, void *env, unsigned gen)
+{
+	int i, old = 0;
+
+	for (i = 0; i < SLOTS; i++)
+		if (self->qnx_sigjmp[i].env == env)
+			return i;
+	for (i = 0; i < SLOTS; i++) {
+		if (!self->qnx_sigjmp[i].env)
+			return i;
+		if (gen - self->qnx_sigjmp[i].gen > gen - self->qnx_sigjmp[old].gen)
+			old = i;
+	}
+	return old;
+}
 
 void __sigjmp_prolog(sigjmp_buf env, int msk)
 {
-    // this function is just a prolog
-    //
-    // Without its implementation,
-    // some programs still work.
+	pthread_t self = __pthread_self();
+	unsigned gen = self->qnx_sigmask_gen;
+	int i = slot_of(self, env, gen);
+
+	if (!msk) {
+		if (self->qnx_sigjmp[i].env == env)
+			self->qnx_sigjmp[i].env = 0;
+		return;
+	}
+	self->qnx_sigjmp[i].mask = current_mask(self);
+	self->qnx_sigjmp[i].gen = gen;
+	self->qnx_sigjmp[i].env = env;
+}
+
+_Noreturn void _qnx_siglongjmp(sigjmp_buf env, int val)
+{
+	pthread_t self = __pthread_self();
+
+	for (int i = 0; i < SLOTS; i++) {
+		if (self->qnx_sigjmp[i].env != env)
+			continue;
+		if (self->qnx_sigjmp[i].gen != self->qnx_sigmask_gen) {
+			__syscall(SYS_rt_sigprocmask, SIG_SETMASK,
+				  &self->qnx_sigjmp[i].mask, 0, _NSIG/8);
+			self->qnx_sigmask = self->qnx_sigjmp[i].mask;
+			self->qnx_sigjmp[i].gen = ++self->qnx_sigmask_gen;
+			self->qnx_sigmask_known = self->qnx_sigmask_gen + 1;
+		}
+		break;
+	}
+	longjmp(env, val);
 }
+QNX_REDIRECT(siglongjmp);
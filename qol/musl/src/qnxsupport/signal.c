@@ -1,9 +1,12 @@
+#define _GNU_SOURCE
 #include <stdint.h>
-#include <sys/signal.h>
-
-typedef struct {
-	uint32_t __bits[2];
-} qnx_sigset_t;
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include "atomic.h"
+#include "qnx_redirect.h"
+#include "qnx_signal.h"
 
 #undef sa_handler
 #undef sa_sigaction
@@ -17,31 +20,365 @@ struct qnx_sigaction {
 	qnx_sigset_t sa_mask;
 };
 
-void qnx_sigaction_to_linux(const struct qnx_sigaction *qnx_sa,
-			    struct sigaction *linux_sa)
+#define QNX_SA_NOCLDSTOP 0x0001
+#define QNX_SA_SIGINFO 0x0002
+#define QNX_SA_RESETHAND 0x0004
+#define QNX_SA_ONSTACK 0x0008
+#define QNX_SA_NODEFER 0x0010
+#define QNX_SA_NOCLDWAIT 0x0020
+
+/*
+ * QNX numbers its signals the System V way, Linux does not. Index is
+ * the QNX number, value the Linux one; 0 means no Linux counterpart
+ * (SIGEMT, and the QNX-internal signals above SIGRTMAX). QNX real-time
+ * signals 41-56 map onto musl's SIGRTMIN (35) upwards.
+ */
+#define QNX_SIGRTMIN 41
+#define QNX_SIGRTMAX 56
+#define LINUX_SIGRTMIN 35
+
+static const unsigned char qnx_to_linux_sig[65] = {
+	[1] = SIGHUP,	  [2] = SIGINT,	    [3] = SIGQUIT,   [4] = SIGILL,
+	[5] = SIGTRAP,	  [6] = SIGABRT,    [7] = 0,	     [8] = SIGFPE,
+	[9] = SIGKILL,	  [10] = SIGBUS,    [11] = SIGSEGV,  [12] = SIGSYS,
+	[13] = SIGPIPE,	  [14] = SIGALRM,   [15] = SIGTERM,  [16] = SIGUSR1,
+	[17] = SIGUSR2,	  [18] = SIGCHLD,   [19] = SIGPWR,   [20] = SIGWINCH,
+	[21] = SIGURG,	  [22] = SIGIO,	    [23] = SIGSTOP,  [24] = SIGTSTP,
+	[25] = SIGCONT,	  [26] = SIGTTIN,   [27] = SIGTTOU,  [28] = SIGVTALRM,
+	[29] = SIGPROF,	  [30] = SIGXCPU,   [31] = SIGXFSZ,
+#define RT(n) [QNX_SIGRTMIN + n] = LINUX_SIGRTMIN + n
+	RT(0), RT(1), RT(2),  RT(3),  RT(4),  RT(5),  RT(6),  RT(7),
+	RT(8), RT(9), RT(10), RT(11), RT(12), RT(13), RT(14), RT(15),
+#undef RT
+};
+
+static unsigned char linux_to_qnx_sig[65];
+
+/*
+ * Signal sets are permuted a byte at a time: each table row holds, for
+ * one byte position of the source mask, the destination mask of every
+ * possible byte value. Eight loads and ORs convert a whole set. The
+ * tables are derived from qnx_to_linux_sig on first use; concurrent
+ * first users compute identical contents, so no lock is needed.
+ */
+static uint64_t sigset_to_linux_tab[8][256];
+static uint64_t sigset_from_linux_tab[8][256];
+static volatile int sig_tables_ready;
+
+static void build_sig_tables(void)
+{
+	int q, l, pos, v, b;
+
+	for (q = 1; q < 65; q++)
+		if ((l = qnx_to_linux_sig[q]))
+			linux_to_qnx_sig[l] = q;
+	for (pos = 0; pos < 8; pos++) {
+		for (v = 0; v < 256; v++) {
+			uint64_t to = 0, from = 0;
+			for (b = 0; b < 8; b++) {
+				int sig = pos * 8 + b + 1;
+				if (!(v & 1 << b))
+					continue;
+				if ((l = qnx_to_linux_sig[sig]))
+					to |= 1ULL << (l - 1);
+				if ((q = linux_to_qnx_sig[sig]))
+					from |= 1ULL << (q - 1);
+			}
+			sigset_to_linux_tab[pos][v] = to;
+			sigset_from_linux_tab[pos][v] = from;
+		}
+	}
+	a_store(&sig_tables_ready, 1);
+}
+
+static inline void sig_tables(void)
+{
+	if (!sig_tables_ready)
+		build_sig_tables();
+}
+
+static uint64_t permute_set(uint64_t m, uint64_t (*tab)[256])
+{
+	uint64_t r = 0;
+	for (int pos = 0; m; pos++, m >>= 8)
+		r |= tab[pos][m & 0xff];
+	return r;
+}
+
+int __qnx_signo_to_linux(int sig)
+{
+	return sig > 0 && sig < 65 ? qnx_to_linux_sig[sig] : 0;
+}
+
+int __qnx_signo_from_linux(int sig)
+{
+	sig_tables();
+	return sig > 0 && sig < 65 ? linux_to_qnx_sig[sig] : 0;
+}
+
+void __qnx_sigset_to_linux(const qnx_sigset_t *q, sigset_t *l)
+{
+	uint64_t m = q->__bits[0] | (uint64_t)q->__bits[1] << 32;
+
+	sig_tables();
+	sigemptyset(l);
+	m = permute_set(m, sigset_to_linux_tab);
+	memcpy(l, &m, sizeof m);
+}
+
+void __qnx_sigset_from_linux(const sigset_t *l, qnx_sigset_t *q)
+{
+	uint64_t m;
+
+	sig_tables();
+	memcpy(&m, l, sizeof m);
+	m = permute_set(m, sigset_from_linux_tab);
+	q->__bits[0] = m;
+	q->__bits[1] = m >> 32;
+}
+
+static int qnx_sa_flags_to_linux(int f)
+{
+	return (f & QNX_SA_NOCLDSTOP ? SA_NOCLDSTOP : 0) |
+	       (f & QNX_SA_SIGINFO ? SA_SIGINFO : 0) |
+	       (f & QNX_SA_RESETHAND ? SA_RESETHAND : 0) |
+	       (f & QNX_SA_ONSTACK ? SA_ONSTACK : 0) |
+	       (f & QNX_SA_NODEFER ? SA_NODEFER : 0) |
+	       (f & QNX_SA_NOCLDWAIT ? SA_NOCLDWAIT : 0);
+}
+
+static int linux_sa_flags_to_qnx(int f)
+{
+	return (f & SA_NOCLDSTOP ? QNX_SA_NOCLDSTOP : 0) |
+	       (f & SA_SIGINFO ? QNX_SA_SIGINFO : 0) |
+	       (f & SA_RESETHAND ? QNX_SA_RESETHAND : 0) |
+	       (f & SA_ONSTACK ? QNX_SA_ONSTACK : 0) |
+	       (f & SA_NODEFER ? QNX_SA_NODEFER : 0) |
+	       (f & SA_NOCLDWAIT ? QNX_SA_NOCLDWAIT : 0);
+}
+
+/*
+ * QNX handlers expect QNX signal numbers, and QNX siginfo_t has
+ * si_code and si_errno in the opposite order, so handlers run behind a
+ * trampoline. The handler table is indexed by Linux signal number and
+ * only ever updated with single pointer stores.
+ */
+struct qnx_siginfo {
+	int si_signo;
+	int si_code;
+	int si_errno;
+	char __data[sizeof(siginfo_t) - 3 * sizeof(int)];
+};
+
+static void *volatile qnx_handlers[_NSIG];
+
+/*
+ * Window size changes, for the tcgetsize cache: winch_gen counts
+ * SIGWINCHs seen, by qnx_winch while the program leaves the signal at
+ * SIG_DFL (which ignores it, as qnx_winch does apart from counting) and
+ * by the trampolines once it has a handler. winch_state is 0 before the
+ * first __qnx_winch_gen, 1 while changes are counted and -1 when they
+ * cannot be (ignored, or a handler installed behind our back).
+ */
+static volatile int winch_gen, winch_state;
+
+static void qnx_winch(int lsig)
+{
+	a_inc(&winch_gen);
+}
+
+static void qnx_trampoline(int lsig, siginfo_t *si, void *uc)
+{
+	void *h = qnx_handlers[lsig];
+	int qsig = __qnx_signo_from_linux(lsig);
+	struct qnx_siginfo qsi;
+
+	__qnx_sigmask_changed();
+	if (lsig == SIGWINCH)
+		a_inc(&winch_gen);
+	if (!si) {
+		((void (*)(int))h)(qsig);
+	} else {
+		qsi.si_signo = qsig;
+		qsi.si_code = si->si_code;
+		qsi.si_errno = si->si_errno;
+		memcpy(qsi.__data, (char *)si + 3 * sizeof(int), sizeof qsi.__data);
+		((void (*)(int, void *, void *))h)(qsig, &qsi, uc);
+	}
+	/* The kernel puts the interrupted mask back on return. */
+	__qnx_sigmask_changed();
+}
+
+static void qnx_trampoline_plain(int lsig)
+{
+	__qnx_sigmask_changed();
+	if (lsig == SIGWINCH)
+		a_inc(&winch_gen);
+	((void (*)(int))qnx_handlers[lsig])(__qnx_signo_from_linux(lsig));
+	__qnx_sigmask_changed();
+}
+
+int __qnx_winch_gen(void)
 {
-	linux_sa->__sa_handler.sa_handler = qnx_sa->__sa_un.sa_handler;
-	linux_sa->sa_flags = qnx_sa->sa_flags;
-	// copy 64 bits data
-	*(uint64_t *)&(linux_sa->sa_mask) = *(uint64_t *)&(qnx_sa->sa_mask);
+	struct sigaction sa;
+	void *h;
+
+	if (winch_state)
+		return winch_state > 0 ? winch_gen : -1;
+	winch_state = -1;
+	if (sigaction(SIGWINCH, 0, &sa))
+		return -1;
+	h = (void *)sa.__sa_handler.sa_handler;
+	if (h == (void *)SIG_DFL) {
+		sa.__sa_handler.sa_handler = qnx_winch;
+		sa.sa_flags = SA_RESTART;
+		sigemptyset(&sa.sa_mask);
+		if (sigaction(SIGWINCH, &sa, 0))
+			return -1;
+	} else if (h != (void *)qnx_trampoline &&
+		   h != (void *)qnx_trampoline_plain) {
+		return -1;
+	}
+	winch_state = 1;
+	return winch_gen;
 }
 
-void linux_sigaction_to_qnx(const struct sigaction *linux_sa,
-			    struct qnx_sigaction *qnx_sa)
+static int is_special_handler(void *h)
 {
-	qnx_sa->__sa_un.sa_handler = linux_sa->__sa_handler.sa_handler;
-	qnx_sa->sa_flags = linux_sa->sa_flags;
-	// copy 64 bits data
-	*(uint64_t *)&(qnx_sa->sa_mask) = *(uint64_t *)&(linux_sa->sa_mask);
+	return h == (void *)SIG_DFL || h == (void *)SIG_IGN ||
+	       h == (void *)SIG_ERR;
 }
 
 int _qnx_sigaction(int signum, const struct qnx_sigaction *act,
-		  struct qnx_sigaction *oldact)
+		   struct qnx_sigaction *oldact)
 {
 	struct sigaction linux_act, linux_oldact;
-	qnx_sigaction_to_linux(act, &linux_act);
-	int ret = sigaction(signum, &linux_act, oldact ? &linux_oldact : 0);
-	if (oldact)
-		linux_sigaction_to_qnx(&linux_oldact, oldact);
+	int lsig = __qnx_signo_to_linux(signum);
+	void *prev;
+
+	if (!lsig) {
+		errno = EINVAL;
+		return -1;
+	}
+	prev = qnx_handlers[lsig];
+	if (act) {
+		void *h = (void *)act->__sa_un.sa_handler;
+		memset(&linux_act, 0, sizeof linux_act);
+		linux_act.sa_flags = qnx_sa_flags_to_linux(act->sa_flags);
+		__qnx_sigset_to_linux(&act->sa_mask, &linux_act.sa_mask);
+		if (lsig == SIGWINCH && winch_state > 0 &&
+		    h == (void *)SIG_DFL) {
+			linux_act.__sa_handler.sa_handler = qnx_winch;
+			linux_act.sa_flags |= SA_RESTART;
+		} else if (is_special_handler(h)) {
+			if (lsig == SIGWINCH && winch_state > 0)
+				winch_state = -1;
+			linux_act.__sa_handler.sa_handler = (void (*)(int))h;
+		} else {
+			qnx_handlers[lsig] = h;
+			if (linux_act.sa_flags & SA_SIGINFO)
+				linux_act.__sa_handler.sa_sigaction = qnx_trampoline;
+			else
+				linux_act.__sa_handler.sa_handler = qnx_trampoline_plain;
+		}
+	}
+	if (sigaction(lsig, act ? &linux_act : 0, oldact ? &linux_oldact : 0)) {
+		/* The handler was stored first so the trampoline never sees
+		 * a stale one; a rejected call must not leave it there. */
+		qnx_handlers[lsig] = prev;
+		return -1;
+	}
+	if (oldact) {
+		void *h = (void *)linux_oldact.__sa_handler.sa_handler;
+		if (h == (void *)qnx_trampoline ||
+		    h == (void *)qnx_trampoline_plain)
+			h = prev;
+		else if (h == (void *)qnx_winch)
+			h = (void *)SIG_DFL;
+		oldact->__sa_un.sa_handler = (void (*)(int))h;
+		oldact->sa_flags = linux_sa_flags_to_qnx(linux_oldact.sa_flags);
+		__qnx_sigset_from_linux(&linux_oldact.sa_mask, &oldact->sa_mask);
+	}
+	return 0;
+}
+QNX_REDIRECT(sigaction);
+
+void (*_qnx_signal(int sig, void (*func)(int)))(int)
+{
+	struct qnx_sigaction sa = { .__sa_un.sa_handler = func }, old;
+
+	if (_qnx_sigaction(sig, &sa, &old))
+		return SIG_ERR;
+	return old.__sa_un.sa_handler;
+}
+QNX_REDIRECT(signal);
+
+static int qnx_mask_op(int how, const qnx_sigset_t *set, qnx_sigset_t *old,
+		       int thread)
+{
+	sigset_t lset, lold;
+	int ret;
+
+	if (set) {
+		__qnx_sigset_to_linux(set, &lset);
+		__qnx_sigmask_changed();
+	}
+	ret = pthread_sigmask(how, set ? &lset : 0, old ? &lold : 0);
+	if (!ret && old)
+		__qnx_sigset_from_linux(&lold, old);
+	if (!thread && ret) {
+		errno = ret;
+		return -1;
+	}
+	return ret;
+}
+
+int _qnx_sigprocmask(int how, const qnx_sigset_t *set, qnx_sigset_t *old)
+{
+	return qnx_mask_op(how, set, old, 0);
+}
+QNX_REDIRECT(sigprocmask);
+
+int _qnx_pthread_sigmask(int how, const qnx_sigset_t *set,
+			 qnx_sigset_t *old)
+{
+	return qnx_mask_op(how, set, old, 1);
+}
+QNX_REDIRECT(pthread_sigmask);
+
+int _qnx_sigwait(const qnx_sigset_t *set, int *sig)
+{
+	sigset_t lset;
+	int lsig, ret;
+
+	__qnx_sigset_to_linux(set, &lset);
+	ret = sigwait(&lset, &lsig);
+	if (!ret)
+		*sig = __qnx_signo_from_linux(lsig);
 	return ret;
 }
+QNX_REDIRECT(sigwait);
+
+int _qnx_kill(pid_t pid, int sig)
+{
+	int lsig = __qnx_signo_to_linux(sig);
+
+	if (sig && !lsig) {
+		errno = EINVAL;
+		return -1;
+	}
+	return kill(pid, lsig);
+}
+QNX_REDIRECT(kill);
+
+int _qnx_raise(int sig)
+{
+	int lsig = __qnx_signo_to_linux(sig);
+
+	if (!lsig) {
+		errno = EINVAL;
+		return -1;
+	}
+	return raise(lsig);
+}
+QNX_REDIRECT(raise);
@@ -1,16 +1,231 @@
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "pthread_impl.h"
+#include "atomic.h"
+#include "lock.h"
+#include "qnx_probe.h"
+#include "qnx_stats.h"
+
+/*
+ * slogf backend. Callers format into a slot of a shared ring and
+ * return; the slot is claimed with a single atomic add, so loggers
+ * never take a lock. A detached writer thread drains finished slots in
+ * batches with one write() each, and whatever is left is drained at
+ * exit. Output goes to stdout unless QNX_SLOG_FD or QNX_SLOG_FILE say
+ * otherwise. Messages above QNX_SLOG_SEVERITY are dropped before they
+ * are formatted. QNX_SLOG_SYNC writes each message from the caller
+ * instead of starting the writer thread.
+ */
+
+#define _SLOG_SHUTDOWN 0
+#define _SLOG_DEBUG2 7
+
+#define SLOG_NREC 256
+#define SLOG_MSG_MAX 224
+#define SLOG_OUTBUF 8192
+
+struct slog_rec {
+	volatile int seq;
+	int code;
+	int severity;
+	int len;
+	struct timespec ts;
+	char msg[SLOG_MSG_MAX];
+};
+
+static struct slog_rec slog_ring[SLOG_NREC];
+#define SLOT(i) (&slog_ring[(unsigned)(i) % SLOG_NREC])
+static volatile int slog_tail, slog_head;
+static volatile int slog_lock[1];
+static volatile int slog_wsleep;
+
+static volatile int slog_state; /* 0 unset, 1 initializing, 2 ready */
+static int slog_fd = 1;
+static int slog_maxsev = _SLOG_DEBUG2;
+static int slog_sync;
+static volatile int slog_writer;
+
+static void slog_drain_all(void);
+
+static int slog_fmt_rec(char *out, size_t n, const struct slog_rec *r)
+{
+	int len = snprintf(out, n, "SLOG %lld.%06ld [%d] [%d] ",
+			   (long long)r->ts.tv_sec, r->ts.tv_nsec / 1000,
+			   r->code, r->severity);
+	if (len < 0 || (size_t)len >= n)
+		return 0;
+	if ((size_t)(len + r->len + 1) > n)
+		return 0;
+	memcpy(out + len, r->msg, r->len);
+	len += r->len;
+	out[len++] = '\n';
+	return len;
+}
+
+/*
+ * Write out the published records at the head of the ring. Only one
+ * thread drains at a time; producers are never blocked by it except
+ * when the ring is full. Returns the number of records written.
+ */
+static int slog_drain(void)
+{
+	char out[SLOG_OUTBUF];
+	unsigned head, start;
+	int used, len, n = 0;
+
+	LOCK(slog_lock);
+	head = start = slog_head;
+	for (;;) {
+		used = 0;
+		while (head - start < SLOG_NREC) {
+			struct slog_rec *r = SLOT(head);
+			if ((unsigned)r->seq != head + 1)
+				break;
+			len = slog_fmt_rec(out + used, sizeof out - used, r);
+			if (!len && used)
+				break;
+			used += len;
+			head++;
+		}
+		if (!used)
+			break;
+		for (int off = 0; off < used;) {
+			ssize_t w = write(slog_fd, out + off, used - off);
+			if (w <= 0)
+				break;
+			off += w;
+		}
+		for (; start != head; start++)
+			a_store(&SLOT(start)->seq, start + SLOG_NREC);
+		n += head - slog_head;
+		a_store(&slog_head, head);
+	}
+	UNLOCK(slog_lock);
+	return n;
+}
+
+static void slog_drain_all(void)
+{
+	while (slog_drain())
+		;
+}
+
+static void *slog_writer_main(void *arg)
+{
+	(void)arg;
+	for (;;) {
+		if (slog_drain())
+			continue;
+		a_store(&slog_wsleep, 1);
+		if ((unsigned)SLOT(slog_head)->seq != (unsigned)slog_head + 1)
+			__futexwait(&slog_wsleep, 1, 1);
+		a_store(&slog_wsleep, 0);
+	}
+	return 0;
+}
+
+static void slog_start_writer(void)
+{
+	pthread_attr_t attr;
+	pthread_t td;
+
+	if (slog_sync || a_cas(&slog_writer, 0, 1))
+		return;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	pthread_attr_setstacksize(&attr, 2 * SLOG_OUTBUF + 16384);
+	if (pthread_create(&td, &attr, slog_writer_main, 0))
+		slog_sync = 1;
+	pthread_attr_destroy(&attr);
+}
+
+/* The writer does not survive fork; the child starts its own. */
+static void slog_atfork_child(void)
+{
+	slog_lock[0] = 0;
+	slog_wsleep = 0;
+	slog_writer = 0;
+}
+
+static void slog_init(void)
+{
+	const char *s;
+
+	if (a_cas(&slog_state, 0, 1)) {
+		while (slog_state != 2)
+			a_spin();
+		return;
+	}
+	for (int i = 0; i < SLOG_NREC; i++)
+		slog_ring[i].seq = i;
+	if ((s = getenv("QNX_SLOG_SEVERITY")) && *s)
+		slog_maxsev = atoi(s);
+	if ((s = getenv("QNX_SLOG_FD")) && *s)
+		slog_fd = atoi(s);
+	if ((s = getenv("QNX_SLOG_FILE")) && *s) {
+		int fd = open(s, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+			      0644);
+		if (fd >= 0)
+			slog_fd = fd;
+	}
+	slog_sync = (s = getenv("QNX_SLOG_SYNC")) && *s;
+	atexit(slog_drain_all);
+	pthread_atfork(0, 0, slog_atfork_child);
+	a_store(&slog_state, 2);
+}
+
+int vslogf(int code, int severity, const char *fmt, va_list ap)
+{
+	struct slog_rec *r;
+	unsigned pos;
+	int len;
+
+	if (slog_state != 2)
+		slog_init();
+	if (severity > slog_maxsev)
+		return 0;
+
+	pos = a_fetch_add(&slog_tail, 1);
+	r = SLOT(pos);
+	while ((unsigned)r->seq != pos)
+		if (!slog_drain())
+			a_spin();
+
+	clock_gettime(CLOCK_REALTIME, &r->ts);
+	r->code = code;
+	r->severity = severity;
+	len = vsnprintf(r->msg, sizeof r->msg, fmt, ap);
+	if (len < 0)
+		len = 0;
+	r->len = len < (int)sizeof r->msg ? len : (int)sizeof r->msg - 1;
+	QNX_PROBE3(slogf, code, severity, r->msg);
+	__qnx_stat(QNX_STAT_SLOGF);
+	a_store(&r->seq, pos + 1);
+
+	if (!slog_sync && !slog_writer)
+		slog_start_writer();
+	if (slog_sync || severity == _SLOG_SHUTDOWN) {
+		slog_drain();
+	} else if (slog_wsleep) {
+		a_store(&slog_wsleep, 0);
+		__wake(&slog_wsleep, 1, 1);
+	}
+	return len;
+}
 
 int slogf(int code, int severity, const char *fmt, ...)
 {
 	int ret;
 	va_list ap;
 
-	printf("SLOG [%d] [%d] ", code, severity);
 	va_start(ap, fmt);
-	ret = vprintf(fmt, ap);
+	ret = vslogf(code, severity, fmt, ap);
 	va_end(ap);
-	putchar('\n');
-
 	return ret;
 }
@@ -0,0 +1,323 @@
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "atomic.h"
+#include "lock.h"
+
+/*
+ * slog2 emulation. Each registered buffer set is one file under
+ * /dev/shm (slog2.<set name>.<pid>) holding a header and one ring per
+ * buffer, so logging is a memcpy into shared memory, and slog2info.py
+ * can read the rings from outside while the program runs. The files are
+ * removed at exit unless QNX_SLOG2_KEEP is set.
+ *
+ * A ring is an array of 64-byte slots. A record takes one or more
+ * consecutive slots, reserved with one atomic add on the ring's tail,
+ * and starts with a header whose pos field is written last: readers
+ * accept a record only if pos matches its slot's absolute position.
+ * Old records are overwritten, never waited for. A reservation that
+ * would run past the end of the ring is turned into a padding record
+ * whose len is its size in slots, and the writer tries again.
+ */
+
+#define SLOG2_MAX_BUFFERS 4
+#define SLOG2_DISCARD_NEWLINE 0x1
+
+#define SLOG2_SHUTDOWN 0
+#define SLOG2_DEBUG2 7
+
+typedef void *slog2_buffer_t;
+
+typedef struct {
+	uint32_t buffer_size_in_pages;
+	const char *buffer_name;
+} slog2_buffer_config_t;
+
+typedef struct {
+	int num_buffers;
+	uint8_t verbosity_level;
+	const char *buffer_set_name;
+	slog2_buffer_config_t buffer_config[SLOG2_MAX_BUFFERS];
+	uint32_t max_retries;
+} slog2_buffer_set_config_t;
+
+#define SLOG2_MAGIC 0x32474c53 /* "SLG2" */
+#define SLOG2_VERSION 1
+#define SLOG2_SLOT 64
+#define SLOG2_NAME_MAX 64
+#define SLOG2_REC_MAX 1024
+#define SLOG2_PAGE 4096
+
+struct slog2_rec {
+	volatile uint32_t pos;
+	uint16_t code;
+	uint8_t severity;
+	uint8_t kind; /* 0 message, 1 padding */
+	uint32_t len;
+	uint32_t __pad;
+	uint64_t ts_ns;
+	char data[];
+};
+
+#define SLOG2_PAD 1
+
+struct slog2_buf {
+	char name[SLOG2_NAME_MAX];
+	uint32_t nslots;
+	uint32_t offset; /* of the ring, from the start of the file */
+	volatile int verbosity;
+	volatile int tail;
+	uint32_t flags;
+	uint32_t __pad[3];
+};
+
+struct slog2_set {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t nbuf;
+	uint32_t pid;
+	char name[SLOG2_NAME_MAX];
+	struct slog2_buf buf[SLOG2_MAX_BUFFERS];
+};
+
+#define SLOG2_MAX_SETS 8
+
+/* What a slog2_buffer_t points to. */
+struct slog2_handle {
+	struct slog2_buf *b;
+	char *ring;
+};
+
+static struct {
+	struct slog2_set *set;
+	size_t size;
+	char path[96];
+	struct slog2_handle h[SLOG2_MAX_BUFFERS];
+} slog2_sets[SLOG2_MAX_SETS];
+static int slog2_nsets;
+static volatile int slog2_lock[1];
+static slog2_buffer_t slog2_default;
+static int slog2_exit_registered;
+
+static void slog2_cleanup(void)
+{
+	if (getenv("QNX_SLOG2_KEEP"))
+		return;
+	for (int i = 0; i < slog2_nsets; i++)
+		if (slog2_sets[i].path[0])
+			unlink(slog2_sets[i].path);
+}
+
+static void *slog2_map(const char *name, size_t size, char *path, size_t n)
+{
+	void *p = MAP_FAILED;
+	int fd;
+
+	snprintf(path, n, "/dev/shm/slog2.%s.%d", name, getpid());
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd >= 0) {
+		if (!ftruncate(fd, size))
+			p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+				 fd, 0);
+		close(fd);
+		if (p == MAP_FAILED)
+			unlink(path);
+	}
+	if (p == MAP_FAILED) {
+		/* No /dev/shm: still log, just not visible from outside. */
+		path[0] = 0;
+		p = mmap(0, size, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	}
+	return p == MAP_FAILED ? 0 : p;
+}
+
+int slog2_register(slog2_buffer_set_config_t *config,
+		   slog2_buffer_t *handles, uint32_t flags)
+{
+	struct slog2_set *set;
+	size_t size, off;
+	int n, i, slot;
+
+	if (!config || !handles || config->num_buffers < 1 ||
+	    config->num_buffers > SLOG2_MAX_BUFFERS)
+		return -1;
+	n = config->num_buffers;
+	off = (sizeof *set + SLOG2_PAGE - 1) & -SLOG2_PAGE;
+	size = off;
+	for (i = 0; i < n; i++) {
+		uint32_t pages = config->buffer_config[i].buffer_size_in_pages;
+		size += (size_t)(pages ? pages : 1) * SLOG2_PAGE;
+	}
+
+	LOCK(slog2_lock);
+	if (slog2_nsets == SLOG2_MAX_SETS) {
+		UNLOCK(slog2_lock);
+		return -1;
+	}
+	slot = slog2_nsets;
+	set = slog2_map(config->buffer_set_name ? config->buffer_set_name
+						: "default",
+			size, slog2_sets[slot].path,
+			sizeof slog2_sets[slot].path);
+	if (!set) {
+		UNLOCK(slog2_lock);
+		return -1;
+	}
+	set->version = SLOG2_VERSION;
+	set->nbuf = n;
+	set->pid = getpid();
+	snprintf(set->name, sizeof set->name, "%s",
+		 config->buffer_set_name ? config->buffer_set_name : "");
+	for (i = 0; i < n; i++) {
+		struct slog2_buf *b = &set->buf[i];
+		uint32_t pages = config->buffer_config[i].buffer_size_in_pages;
+		const char *name = config->buffer_config[i].buffer_name;
+		snprintf(b->name, sizeof b->name, "%s", name ? name : "");
+		b->nslots = (pages ? pages : 1) * (SLOG2_PAGE / SLOG2_SLOT);
+		b->offset = off;
+		b->verbosity = config->verbosity_level;
+		b->flags = flags;
+		slog2_sets[slot].h[i].b = b;
+		slog2_sets[slot].h[i].ring = (char *)set + off;
+		handles[i] = &slog2_sets[slot].h[i];
+		off += (size_t)b->nslots * SLOG2_SLOT;
+	}
+	a_store((volatile int *)&set->magic, SLOG2_MAGIC);
+	slog2_sets[slot].set = set;
+	slog2_sets[slot].size = size;
+	slog2_nsets++;
+	if (!slog2_exit_registered) {
+		slog2_exit_registered = 1;
+		atexit(slog2_cleanup);
+	}
+	UNLOCK(slog2_lock);
+	return 0;
+}
+
+int slog2_set_verbosity(slog2_buffer_t buffer, uint8_t verbosity)
+{
+	if (!buffer)
+		return -1;
+	a_store(&((struct slog2_handle *)buffer)->b->verbosity, verbosity);
+	return 0;
+}
+
+slog2_buffer_t slog2_set_default_buffer(slog2_buffer_t buffer)
+{
+	slog2_buffer_t old = slog2_default;
+	if (buffer != (slog2_buffer_t)-1)
+		slog2_default = buffer;
+	return old;
+}
+
+int slog2_reset(void)
+{
+	LOCK(slog2_lock);
+	slog2_cleanup();
+	for (int i = 0; i < slog2_nsets; i++) {
+		munmap(slog2_sets[i].set, slog2_sets[i].size);
+		slog2_sets[i].set = 0;
+		slog2_sets[i].path[0] = 0;
+	}
+	slog2_nsets = 0;
+	slog2_default = 0;
+	UNLOCK(slog2_lock);
+	return 0;
+}
+
+static int slog2_put(slog2_buffer_t buffer, uint16_t code, uint8_t severity,
+		     const char *data, size_t len)
+{
+	struct slog2_handle *h = buffer ? buffer : slog2_default;
+	struct slog2_buf *b;
+	struct slog2_rec *r;
+	struct timespec ts;
+	uint32_t need, pos, idx;
+
+	if (!h)
+		return -1;
+	b = h->b;
+	if (severity > b->verbosity)
+		return 0;
+	if ((b->flags & SLOG2_DISCARD_NEWLINE) && len && data[len - 1] == '\n')
+		len--;
+	if (len > SLOG2_REC_MAX - sizeof *r)
+		len = SLOG2_REC_MAX - sizeof *r;
+	need = (sizeof *r + len + SLOG2_SLOT - 1) / SLOG2_SLOT;
+	if (need > b->nslots)
+		return -1;
+
+	for (;;) {
+		pos = a_fetch_add(&b->tail, need);
+		idx = pos % b->nslots;
+		if (idx + need <= b->nslots)
+			break;
+		/* Would wrap: turn the slots into padding and retry. */
+		r = (struct slog2_rec *)(h->ring + (size_t)idx * SLOG2_SLOT);
+		r->pos = pos - b->nslots;
+		a_barrier();
+		r->kind = SLOG2_PAD;
+		r->len = need;
+		a_barrier();
+		r->pos = pos;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	r = (struct slog2_rec *)(h->ring + (size_t)idx * SLOG2_SLOT);
+	r->pos = pos - b->nslots;
+	a_barrier();
+	r->code = code;
+	r->severity = severity;
+	r->kind = 0;
+	r->len = len;
+	r->ts_ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	memcpy(r->data, data, len);
+	a_barrier();
+	r->pos = pos;
+	return 0;
+}
+
+int vslog2f(slog2_buffer_t buffer, uint16_t code, uint8_t severity,
+	    const char *format, va_list ap)
+{
+	struct slog2_handle *h = buffer ? buffer : slog2_default;
+	char msg[SLOG2_REC_MAX];
+	int len;
+
+	/* Check the level before paying for the formatting. */
+	if (!h)
+		return -1;
+	if (severity > h->b->verbosity)
+		return 0;
+	len = vsnprintf(msg, sizeof msg, format, ap);
+	if (len < 0)
+		return -1;
+	if (len >= (int)sizeof msg)
+		len = sizeof msg - 1;
+	return slog2_put(h, code, severity, msg, len);
+}
+
+int slog2f(slog2_buffer_t buffer, uint16_t code, uint8_t severity,
+	   const char *format, ...)
+{
+	int ret;
+	va_list ap;
+
+	va_start(ap, format);
+	ret = vslog2f(buffer, code, severity, format, ap);
+	va_end(ap);
+	return ret;
+}
+
+int slog2c(slog2_buffer_t buffer, uint16_t code, uint8_t severity,
+	   const char *data)
+{
+	return slog2_put(buffer, code, severity, data, strlen(data));
+}
@@ -1,16 +1,495 @@
+#define _GNU_SOURCE
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "qnx_errno.h"
+#include "qnx_redirect.h"
+#include "qnx_sock.h"
 
-extern int _qnx_bind(int sockfd, const struct sockaddr *addr, socklen_t addrlen);
-extern int _qnx_connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen);
-extern void _qnx_freeaddrinfo(struct addrinfo *res);
-extern int _qnx_getaddrinfo(const char *node, const char *service,
-                            const struct addrinfo *hints, struct addrinfo **res);
-extern struct hostent *_qnx_gethostbyname(const char *name);
-extern int _qnx_getsockname(int sockfd, struct sockaddr *addr, socklen_t *addrlen);
-extern int _qnx_getsockopt(int sockfd, int level, int optname,
-                           void *optval, socklen_t *optlen);
-extern int _qnx_listen(int sockfd, int backlog);
-extern ssize_t _qnx_recv(int sockfd, void *buf, size_t len, int flags);
-extern ssize_t _qnx_send(int sockfd, const void *buf, size_t len, int flags);
-extern int _qnx_socket(int domain, int type, int protocol);
\ No newline at end of file
+/*
+ * QNX networking is BSD derived: socket addresses start with a length
+ * byte and a one byte family, and the address family, socket level,
+ * option, message flag, addrinfo flag and EAI numbering all differ from
+ * Linux. Addresses and option values are converted into buffers on the
+ * caller's stack; only getaddrinfo allocates, because its result
+ * outlives the call.
+ */
+
+#define QNX_AF_UNSPEC 0
+#define QNX_AF_LOCAL 1
+#define QNX_AF_INET 2
+#define QNX_AF_INET6 24
+
+#define QNX_SOCK_CLOEXEC 0x10000000
+#define QNX_SOCK_NONBLOCK 0x20000000
+#define QNX_SOCK_TYPE_MASK 0x0fffffff
+
+#define QNX_SOL_SOCKET 0xffff
+#define QNX_SO_ERROR 0x1007
+
+/* BSD field order: ai_canonname comes before ai_addr. */
+struct qnx_addrinfo {
+	int ai_flags;
+	int ai_family;
+	int ai_socktype;
+	int ai_protocol;
+	socklen_t ai_addrlen;
+	char *ai_canonname;
+	struct qnx_sockaddr *ai_addr;
+	struct qnx_addrinfo *ai_next;
+};
+
+struct qnx_flag_map {
+	int qnx, linux;
+};
+
+#define NELEM(a) (sizeof (a) / sizeof *(a))
+
+static int map_to_linux(const struct qnx_flag_map *m, size_t n, int v)
+{
+	for (size_t i = 0; i < n; i++)
+		if (m[i].qnx == v)
+			return m[i].linux;
+	return -1;
+}
+
+static int map_from_linux(const struct qnx_flag_map *m, size_t n, int v)
+{
+	for (size_t i = 0; i < n; i++)
+		if (m[i].linux == v)
+			return m[i].qnx;
+	return -1;
+}
+
+static int bits_to_linux(const struct qnx_flag_map *m, size_t n, int v)
+{
+	int ret = 0;
+	for (size_t i = 0; i < n; i++)
+		if (v & m[i].qnx)
+			ret |= m[i].linux;
+	return ret;
+}
+
+static int bits_from_linux(const struct qnx_flag_map *m, size_t n, int v)
+{
+	int ret = 0;
+	for (size_t i = 0; i < n; i++)
+		if (v & m[i].linux)
+			ret |= m[i].qnx;
+	return ret;
+}
+
+static const struct qnx_flag_map af_map[] = {
+	{ QNX_AF_UNSPEC, AF_UNSPEC },
+	{ QNX_AF_LOCAL, AF_UNIX },
+	{ QNX_AF_INET, AF_INET },
+	{ QNX_AF_INET6, AF_INET6 },
+};
+
+static int af_to_linux(int af)
+{
+	int ret = map_to_linux(af_map, NELEM(af_map), af);
+	return ret < 0 ? af + 1000 : ret; /* unknown: make it fail */
+}
+
+static int af_from_linux(int af)
+{
+	int ret = map_from_linux(af_map, NELEM(af_map), af);
+	return ret < 0 ? af : ret;
+}
+
+static const struct qnx_flag_map msg_map[] = {
+	{ 0x1, MSG_OOB },	 { 0x2, MSG_PEEK },	  { 0x4, MSG_DONTROUTE },
+	{ 0x8, MSG_EOR },	 { 0x10, MSG_TRUNC },	  { 0x20, MSG_CTRUNC },
+	{ 0x40, MSG_WAITALL },	 { 0x80, MSG_DONTWAIT },  { 0x400, MSG_NOSIGNAL },
+	{ 0x2000, MSG_WAITFORONE },
+};
+
+int __qnx_msg_flags_to_linux(int f)
+{
+	return bits_to_linux(msg_map, NELEM(msg_map), f);
+}
+
+int __qnx_msg_flags_from_linux(int f)
+{
+	return bits_from_linux(msg_map, NELEM(msg_map), f);
+}
+
+#define MSG_TO_LINUX(f) __qnx_msg_flags_to_linux(f)
+
+int __qnx_sa_to_linux(const void *qsa, socklen_t qlen,
+		      struct sockaddr_storage *lsa)
+{
+	const struct qnx_sockaddr *q = qsa;
+
+	if (qlen < 2 || qlen > sizeof *lsa) {
+		errno = EINVAL;
+		return -1;
+	}
+	memcpy(lsa, qsa, qlen);
+	lsa->ss_family = af_to_linux(q->sa_family);
+	return 0;
+}
+
+void __qnx_sa_from_linux(const struct sockaddr_storage *lsa,
+			 socklen_t llen, void *qsa, socklen_t *qlen)
+{
+	struct sockaddr_storage tmp;
+	struct qnx_sockaddr *q = (void *)&tmp;
+
+	if (!qsa || !qlen)
+		return;
+	if (llen > sizeof tmp)
+		llen = sizeof tmp;
+	memcpy(&tmp, lsa, llen);
+	if (llen >= 2) {
+		q->sa_family = af_from_linux(lsa->ss_family);
+		q->sa_len = llen > 255 ? 255 : llen;
+	}
+	memcpy(qsa, &tmp, *qlen < llen ? *qlen : llen);
+	*qlen = llen;
+}
+
+static int socktype_to_linux(int type)
+{
+	return (type & QNX_SOCK_TYPE_MASK) |
+	       (type & QNX_SOCK_CLOEXEC ? SOCK_CLOEXEC : 0) |
+	       (type & QNX_SOCK_NONBLOCK ? SOCK_NONBLOCK : 0);
+}
+
+int _qnx_socket(int domain, int type, int protocol)
+{
+	return socket(af_to_linux(domain), socktype_to_linux(type), protocol);
+}
+QNX_REDIRECT(socket);
+
+int _qnx_socketpair(int domain, int type, int protocol, int fd[2])
+{
+	return socketpair(af_to_linux(domain), socktype_to_linux(type),
+			  protocol, fd);
+}
+QNX_REDIRECT(socketpair);
+
+int _qnx_bind(int sockfd, const struct sockaddr *addr, socklen_t addrlen)
+{
+	struct sockaddr_storage sa;
+
+	if (__qnx_sa_to_linux(addr, addrlen, &sa))
+		return -1;
+	return bind(sockfd, (void *)&sa, addrlen);
+}
+QNX_REDIRECT(bind);
+
+int _qnx_connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen)
+{
+	struct sockaddr_storage sa;
+
+	if (__qnx_sa_to_linux(addr, addrlen, &sa))
+		return -1;
+	return connect(sockfd, (void *)&sa, addrlen);
+}
+QNX_REDIRECT(connect);
+
+int _qnx_listen(int sockfd, int backlog)
+{
+	return listen(sockfd, backlog);
+}
+QNX_REDIRECT(listen);
+
+int _qnx_accept4(int sockfd, struct sockaddr *addr, socklen_t *addrlen,
+		 int flags)
+{
+	struct sockaddr_storage sa;
+	socklen_t len = sizeof sa;
+	int fd;
+
+	fd = accept4(sockfd, addr ? (void *)&sa : 0, addr ? &len : 0,
+		     socktype_to_linux(flags));
+	if (fd >= 0)
+		__qnx_sa_from_linux(&sa, len, addr, addrlen);
+	return fd;
+}
+QNX_REDIRECT(accept4);
+
+int _qnx_accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen)
+{
+	return _qnx_accept4(sockfd, addr, addrlen, 0);
+}
+QNX_REDIRECT(accept);
+
+int _qnx_getsockname(int sockfd, struct sockaddr *addr, socklen_t *addrlen)
+{
+	struct sockaddr_storage sa;
+	socklen_t len = sizeof sa;
+	int ret;
+
+	if ((ret = getsockname(sockfd, (void *)&sa, &len)) == 0)
+		__qnx_sa_from_linux(&sa, len, addr, addrlen);
+	return ret;
+}
+QNX_REDIRECT(getsockname);
+
+int _qnx_getpeername(int sockfd, struct sockaddr *addr, socklen_t *addrlen)
+{
+	struct sockaddr_storage sa;
+	socklen_t len = sizeof sa;
+	int ret;
+
+	if ((ret = getpeername(sockfd, (void *)&sa, &len)) == 0)
+		__qnx_sa_from_linux(&sa, len, addr, addrlen);
+	return ret;
+}
+QNX_REDIRECT(getpeername);
+
+ssize_t _qnx_send(int sockfd, const void *buf, size_t len, int flags)
+{
+	return send(sockfd, buf, len, MSG_TO_LINUX(flags));
+}
+QNX_REDIRECT(send);
+
+ssize_t _qnx_recv(int sockfd, void *buf, size_t len, int flags)
+{
+	if (!flags) {
+		struct iovec iov = { buf, len };
+		int mflags;
+		ssize_t ret = __qnx_recv_batched(sockfd, &iov, 1, 0, 0, &mflags);
+		if (ret != -2)
+			return ret;
+	}
+	return recv(sockfd, buf, len, MSG_TO_LINUX(flags));
+}
+QNX_REDIRECT(recv);
+
+ssize_t _qnx_sendto(int sockfd, const void *buf, size_t len, int flags,
+		    const struct sockaddr *addr, socklen_t addrlen)
+{
+	struct sockaddr_storage sa;
+
+	if (addr && __qnx_sa_to_linux(addr, addrlen, &sa))
+		return -1;
+	return sendto(sockfd, buf, len, MSG_TO_LINUX(flags),
+		      addr ? (void *)&sa : 0, addrlen);
+}
+QNX_REDIRECT(sendto);
+
+ssize_t _qnx_recvfrom(int sockfd, void *buf, size_t len, int flags,
+		      struct sockaddr *addr, socklen_t *addrlen)
+{
+	struct sockaddr_storage sa;
+	socklen_t salen = sizeof sa;
+	ssize_t ret = -2;
+
+	if (!flags) {
+		struct iovec iov = { buf, len };
+		int mflags;
+		ret = __qnx_recv_batched(sockfd, &iov, 1, &sa, &salen, &mflags);
+	}
+	if (ret == -2)
+		ret = recvfrom(sockfd, buf, len, MSG_TO_LINUX(flags),
+			       addr ? (void *)&sa : 0, addr ? &salen : 0);
+	if (ret >= 0 && addr)
+		__qnx_sa_from_linux(&sa, salen, addr, addrlen);
+	return ret;
+}
+QNX_REDIRECT(recvfrom);
+
+/*
+ * Socket options: the level and option numbers are looked up per
+ * level. Options not listed, and levels other than these three, pass
+ * through unchanged (IPPROTO_TCP numbering matches for the common
+ * options).
+ */
+static const struct qnx_flag_map sol_socket_map[] = {
+	{ 0x0001, SO_DEBUG },	  { 0x0002, SO_ACCEPTCONN },
+	{ 0x0004, SO_REUSEADDR }, { 0x0008, SO_KEEPALIVE },
+	{ 0x0010, SO_DONTROUTE }, { 0x0020, SO_BROADCAST },
+	{ 0x0080, SO_LINGER },	  { 0x0100, SO_OOBINLINE },
+	{ 0x0200, SO_REUSEPORT }, { 0x0400, SO_TIMESTAMP },
+	{ 0x1001, SO_SNDBUF },	  { 0x1002, SO_RCVBUF },
+	{ 0x1003, SO_SNDLOWAT },  { 0x1004, SO_RCVLOWAT },
+	{ 0x1005, SO_SNDTIMEO },  { 0x1006, SO_RCVTIMEO },
+	{ 0x1007, SO_ERROR },	  { 0x1008, SO_TYPE },
+};
+
+static const struct qnx_flag_map ipproto_ip_map[] = {
+	{ 1, IP_OPTIONS },	    { 2, IP_HDRINCL },
+	{ 3, IP_TOS },		    { 4, IP_TTL },
+	{ 9, IP_MULTICAST_IF },	    { 10, IP_MULTICAST_TTL },
+	{ 11, IP_MULTICAST_LOOP },  { 12, IP_ADD_MEMBERSHIP },
+	{ 13, IP_DROP_MEMBERSHIP },
+};
+
+static const struct qnx_flag_map ipproto_ipv6_map[] = {
+	{ 4, IPV6_UNICAST_HOPS },  { 9, IPV6_MULTICAST_IF },
+	{ 10, IPV6_MULTICAST_HOPS }, { 11, IPV6_MULTICAST_LOOP },
+	{ 12, IPV6_JOIN_GROUP },   { 13, IPV6_LEAVE_GROUP },
+	{ 27, IPV6_V6ONLY },
+};
+
+static int sockopt_to_linux(int *level, int *optname)
+{
+	const struct qnx_flag_map *m;
+	size_t n;
+	int opt;
+
+	switch (*level) {
+	case QNX_SOL_SOCKET:
+		*level = SOL_SOCKET;
+		m = sol_socket_map, n = NELEM(sol_socket_map);
+		break;
+	case IPPROTO_IP:
+		m = ipproto_ip_map, n = NELEM(ipproto_ip_map);
+		break;
+	case IPPROTO_IPV6:
+		m = ipproto_ipv6_map, n = NELEM(ipproto_ipv6_map);
+		break;
+	default:
+		return 0;
+	}
+	if ((opt = map_to_linux(m, n, *optname)) < 0) {
+		errno = ENOPROTOOPT;
+		return -1;
+	}
+	*optname = opt;
+	return 0;
+}
+
+int _qnx_setsockopt(int sockfd, int level, int optname, const void *optval,
+		    socklen_t optlen)
+{
+	if (sockopt_to_linux(&level, &optname))
+		return -1;
+	return setsockopt(sockfd, level, optname, optval, optlen);
+}
+QNX_REDIRECT(setsockopt);
+
+int _qnx_getsockopt(int sockfd, int level, int optname, void *optval,
+		    socklen_t *optlen)
+{
+	int qnx_level = level, qnx_opt = optname, ret;
+
+	if (sockopt_to_linux(&level, &optname))
+		return -1;
+	ret = getsockopt(sockfd, level, optname, optval, optlen);
+	/* A pending error, as after a non-blocking connect, is an errno. */
+	if (!ret && qnx_level == QNX_SOL_SOCKET && qnx_opt == QNX_SO_ERROR &&
+	    *optlen >= sizeof(int))
+		*(int *)optval = __qnx_errno_from_linux(*(int *)optval);
+	return ret;
+}
+QNX_REDIRECT(getsockopt);
+
+/* Name resolution */
+
+static const struct qnx_flag_map ai_flag_map[] = {
+	{ 0x001, AI_PASSIVE },	   { 0x002, AI_CANONNAME },
+	{ 0x004, AI_NUMERICHOST }, { 0x008, AI_NUMERICSERV },
+	{ 0x100, AI_ALL },	   { 0x400, AI_ADDRCONFIG },
+	{ 0x800, AI_V4MAPPED },
+};
+
+static const struct qnx_flag_map eai_map[] = {
+	{ 2, EAI_AGAIN },   { 3, EAI_BADFLAGS }, { 4, EAI_FAIL },
+	{ 5, EAI_FAMILY },  { 6, EAI_MEMORY },	 { 8, EAI_NONAME },
+	{ 9, EAI_SERVICE }, { 10, EAI_SOCKTYPE }, { 11, EAI_SYSTEM },
+	{ 14, EAI_OVERFLOW },
+};
+
+static int eai_from_linux(int e)
+{
+	int q = map_from_linux(eai_map, NELEM(eai_map), e);
+	return q < 0 ? 4 /* EAI_FAIL */ : q;
+}
+
+/*
+ * The whole result list goes into one allocation: the entries, then
+ * their addresses, then the canonical name. It must therefore be freed
+ * from its head, which is what callers pass to freeaddrinfo anyway.
+ */
+int _qnx_getaddrinfo(const char *node, const char *service,
+		     const struct addrinfo *hints, struct addrinfo **res)
+{
+	const struct qnx_addrinfo *qh = (const void *)hints;
+	struct addrinfo lh, *lres, *p;
+	struct qnx_addrinfo *out;
+	struct sockaddr_storage *addrs;
+	size_t n = 0, canon = 0, i;
+	int ret;
+
+	if (qh) {
+		memset(&lh, 0, sizeof lh);
+		lh.ai_flags = bits_to_linux(ai_flag_map, NELEM(ai_flag_map),
+					    qh->ai_flags);
+		lh.ai_family = af_to_linux(qh->ai_family);
+		lh.ai_socktype = qh->ai_socktype;
+		lh.ai_protocol = qh->ai_protocol;
+	}
+	if ((ret = getaddrinfo(node, service, qh ? &lh : 0, &lres)))
+		return eai_from_linux(ret);
+
+	for (p = lres; p; p = p->ai_next)
+		n++;
+	if (lres->ai_canonname)
+		canon = strlen(lres->ai_canonname) + 1;
+	out = malloc(n * (sizeof *out + sizeof *addrs) + canon);
+	if (!out) {
+		freeaddrinfo(lres);
+		return 6; /* EAI_MEMORY */
+	}
+	addrs = (void *)(out + n);
+	for (i = 0, p = lres; p; p = p->ai_next, i++) {
+		socklen_t len = sizeof *addrs;
+		out[i].ai_flags = bits_from_linux(ai_flag_map,
+						  NELEM(ai_flag_map),
+						  p->ai_flags);
+		out[i].ai_family = af_from_linux(p->ai_family);
+		out[i].ai_socktype = p->ai_socktype;
+		out[i].ai_protocol = p->ai_protocol;
+		__qnx_sa_from_linux((void *)p->ai_addr, p->ai_addrlen, &addrs[i],
+			      &len);
+		out[i].ai_addrlen = len;
+		out[i].ai_addr = (void *)&addrs[i];
+		out[i].ai_canonname = 0;
+		out[i].ai_next = i + 1 < n ? &out[i + 1] : 0;
+	}
+	if (canon) {
+		out[0].ai_canonname = (char *)(addrs + n);
+		memcpy(out[0].ai_canonname, lres->ai_canonname, canon);
+	}
+	freeaddrinfo(lres);
+	*res = (void *)out;
+	return 0;
+}
+QNX_REDIRECT(getaddrinfo);
+
+void _qnx_freeaddrinfo(struct addrinfo *res)
+{
+	free(res);
+}
+QNX_REDIRECT(freeaddrinfo);
+
+const char *_qnx_gai_strerror(int ecode)
+{
+	return gai_strerror(map_to_linux(eai_map, NELEM(eai_map), ecode));
+}
+QNX_REDIRECT(gai_strerror);
+
+/* struct hostent has the same layout; only h_addrtype needs mapping. */
+struct hostent *_qnx_gethostbyname(const char *name)
+{
+	static struct hostent h;
+	struct hostent *l = gethostbyname(name);
+
+	if (!l)
+		return 0;
+	h = *l;
+	h.h_addrtype = af_from_linux(l->h_addrtype);
+	return &h;
+}
+QNX_REDIRECT(gethostbyname);
@@ -0,0 +1,451 @@
+#define _GNU_SOURCE
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "atomic.h"
+#include "lock.h"
+#include "qnx_fd.h"
+#include "qnx_redirect.h"
+#include "qnx_sock.h"
+#include "neutrino/neutrino.h"
+
+/*
+ * sendmsg/recvmsg and their batched forms. QNX struct msghdr has no
+ * padding after msg_iovlen or msg_controllen, and its cmsghdr is
+ * {len, level, type} padded to 16 bytes where Linux has {len, pad,
+ * level, type}: control messages keep their size and offsets, only
+ * the headers are rewritten. Translated headers, addresses and control
+ * data live on the stack.
+ */
+
+struct qnx_msghdr {
+	void *msg_name;
+	socklen_t msg_namelen;
+	struct iovec *msg_iov;
+	int msg_iovlen;
+	void *msg_control;
+	socklen_t msg_controllen;
+	int msg_flags;
+};
+
+struct qnx_mmsghdr {
+	struct qnx_msghdr msg_hdr;
+	unsigned msg_len;
+};
+
+struct qnx_cmsghdr {
+	socklen_t cmsg_len;
+	int cmsg_level;
+	int cmsg_type;
+};
+
+#define QNX_SOL_SOCKET 0xffff
+#define QNX_SCM_TIMESTAMP 0x08
+
+#define CTL_MAX 512 /* control data per sendmsg/recvmsg */
+#define MMSG_BATCH 16 /* messages translated per sendmmsg/recvmmsg call */
+#define MMSG_CTL 128 /* control data per message in a batch */
+
+static void cmsg_to_linux(const struct qnx_cmsghdr *q, struct cmsghdr *l)
+{
+	struct cmsghdr h = { 0 };
+
+	h.cmsg_len = q->cmsg_len;
+	h.cmsg_level = q->cmsg_level;
+	h.cmsg_type = q->cmsg_type;
+	if (q->cmsg_level == QNX_SOL_SOCKET) {
+		h.cmsg_level = SOL_SOCKET;
+		if (q->cmsg_type == QNX_SCM_TIMESTAMP)
+			h.cmsg_type = SCM_TIMESTAMP;
+	}
+	memcpy(l, &h, sizeof h);
+}
+
+static void cmsg_from_linux(const struct cmsghdr *l, struct qnx_cmsghdr *q)
+{
+	struct qnx_cmsghdr h = { l->cmsg_len, l->cmsg_level, l->cmsg_type };
+
+	if (l->cmsg_level == SOL_SOCKET) {
+		h.cmsg_level = QNX_SOL_SOCKET;
+		if (l->cmsg_type == SCM_TIMESTAMP)
+			h.cmsg_type = QNX_SCM_TIMESTAMP;
+	}
+	memcpy(q, &h, sizeof h);
+	memset((char *)q + sizeof h, 0,
+	       CMSG_ALIGN(sizeof(struct cmsghdr)) - sizeof h);
+}
+
+/* Copy len bytes of control data, converting each header. */
+static int ctl_convert(const char *src, char *dst, size_t len, int to_linux)
+{
+	size_t off = 0, hdr = CMSG_ALIGN(sizeof(struct cmsghdr)), clen;
+
+	memcpy(dst, src, len);
+	while (len - off >= hdr) {
+		if (to_linux) {
+			struct qnx_cmsghdr q;
+			memcpy(&q, src + off, sizeof q);
+			clen = q.cmsg_len;
+			cmsg_to_linux(&q, (struct cmsghdr *)(dst + off));
+		} else {
+			const struct cmsghdr *l = (const void *)(src + off);
+			clen = l->cmsg_len;
+			cmsg_from_linux(l, (struct qnx_cmsghdr *)(dst + off));
+		}
+		if (clen < hdr || clen > len - off) {
+			errno = EINVAL;
+			return -1;
+		}
+		off += CMSG_ALIGN(clen);
+	}
+	return 0;
+}
+
+static int msg_to_linux(const struct qnx_msghdr *q, struct msghdr *l,
+			struct sockaddr_storage *sa, void *ctl, size_t ctlmax,
+			int recv)
+{
+	memset(l, 0, sizeof *l);
+	if (q->msg_name) {
+		if (recv) {
+			l->msg_namelen = sizeof *sa;
+		} else {
+			if (__qnx_sa_to_linux(q->msg_name, q->msg_namelen, sa))
+				return -1;
+			l->msg_namelen = q->msg_namelen;
+		}
+		l->msg_name = sa;
+	}
+	l->msg_iov = q->msg_iov;
+	l->msg_iovlen = q->msg_iovlen;
+	if (q->msg_control && q->msg_controllen) {
+		if (q->msg_controllen > ctlmax) {
+			errno = ENOBUFS;
+			return -1;
+		}
+		if (!recv && ctl_convert(q->msg_control, ctl,
+					 q->msg_controllen, 1))
+			return -1;
+		l->msg_control = ctl;
+		l->msg_controllen = q->msg_controllen;
+	}
+	return 0;
+}
+
+static void msg_from_linux(const struct msghdr *l, struct qnx_msghdr *q)
+{
+	if (q->msg_name)
+		__qnx_sa_from_linux(l->msg_name, l->msg_namelen, q->msg_name,
+				    &q->msg_namelen);
+	if (l->msg_control) {
+		ctl_convert(l->msg_control, q->msg_control, l->msg_controllen,
+			    0);
+		q->msg_controllen = l->msg_controllen;
+	} else {
+		q->msg_controllen = 0;
+	}
+	q->msg_flags = __qnx_msg_flags_from_linux(l->msg_flags);
+}
+
+ssize_t _qnx_sendmsg(int fd, const struct qnx_msghdr *msg, int flags)
+{
+	struct sockaddr_storage sa;
+	size_t ctl[CTL_MAX / sizeof(size_t)];
+	struct msghdr l;
+
+	if (msg_to_linux(msg, &l, &sa, ctl, sizeof ctl, 0))
+		return -1;
+	return sendmsg(fd, &l, __qnx_msg_flags_to_linux(flags));
+}
+QNX_REDIRECT(sendmsg);
+
+ssize_t _qnx_recvmsg(int fd, struct qnx_msghdr *msg, int flags)
+{
+	struct sockaddr_storage sa;
+	size_t ctl[CTL_MAX / sizeof(size_t)];
+	struct msghdr l;
+	ssize_t ret;
+
+	if (!flags && !msg->msg_controllen) {
+		socklen_t salen = sizeof sa;
+		int mflags = 0;
+		ret = __qnx_recv_batched(fd, msg->msg_iov, msg->msg_iovlen,
+					 &sa, &salen, &mflags);
+		if (ret != -2) {
+			if (ret >= 0) {
+				if (msg->msg_name)
+					__qnx_sa_from_linux(&sa, salen,
+							    msg->msg_name,
+							    &msg->msg_namelen);
+				msg->msg_flags =
+					__qnx_msg_flags_from_linux(mflags);
+			}
+			return ret;
+		}
+	}
+	if (msg_to_linux(msg, &l, &sa, ctl, sizeof ctl, 1))
+		return -1;
+	ret = recvmsg(fd, &l, __qnx_msg_flags_to_linux(flags));
+	if (ret >= 0)
+		msg_from_linux(&l, msg);
+	return ret;
+}
+QNX_REDIRECT(recvmsg);
+
+/*
+ * The vector is converted MMSG_BATCH entries at a time, each chunk
+ * going to the kernel in one call. A message that cannot be converted
+ * ends the batch; it is reported as the error only if nothing was
+ * transferred before it, as sendmmsg/recvmmsg do.
+ */
+struct mmsg_chunk {
+	struct mmsghdr l[MMSG_BATCH];
+	struct sockaddr_storage sa[MMSG_BATCH];
+	size_t ctl[MMSG_BATCH][MMSG_CTL / sizeof(size_t)];
+};
+
+static unsigned mmsg_prepare(struct mmsg_chunk *c, struct qnx_mmsghdr *q,
+			     unsigned n, int recv)
+{
+	unsigned i;
+
+	if (n > MMSG_BATCH)
+		n = MMSG_BATCH;
+	for (i = 0; i < n; i++)
+		if (msg_to_linux(&q[i].msg_hdr, &c->l[i].msg_hdr, &c->sa[i],
+				 c->ctl[i], sizeof c->ctl[i], recv))
+			break;
+	return i;
+}
+
+int _qnx_sendmmsg(int fd, struct qnx_mmsghdr *msgvec, unsigned vlen,
+		  unsigned flags)
+{
+	struct mmsg_chunk c;
+	unsigned total = 0, n;
+	int lflags = __qnx_msg_flags_to_linux(flags), ret, i;
+
+	while (total < vlen) {
+		n = mmsg_prepare(&c, msgvec + total, vlen - total, 0);
+		if (!n)
+			break;
+		ret = sendmmsg(fd, c.l, n, lflags);
+		if (ret < 0)
+			break;
+		for (i = 0; i < ret; i++)
+			msgvec[total + i].msg_len = c.l[i].msg_len;
+		total += ret;
+		if ((unsigned)ret < n || n < MMSG_BATCH)
+			break;
+	}
+	return total || !vlen ? (int)total : -1;
+}
+QNX_REDIRECT(sendmmsg);
+
+int _qnx_recvmmsg(int fd, struct qnx_mmsghdr *msgvec, unsigned vlen,
+		  unsigned flags, struct timespec *timeout)
+{
+	struct mmsg_chunk c;
+	unsigned total = 0, n;
+	int lflags = __qnx_msg_flags_to_linux(flags), ret, i;
+
+	while (total < vlen) {
+		n = mmsg_prepare(&c, msgvec + total, vlen - total, 1);
+		if (!n)
+			break;
+		ret = recvmmsg(fd, c.l, n, lflags, timeout);
+		if (ret < 0)
+			break;
+		for (i = 0; i < ret; i++) {
+			msg_from_linux(&c.l[i].msg_hdr,
+				       &msgvec[total + i].msg_hdr);
+			msgvec[total + i].msg_len = c.l[i].msg_len;
+		}
+		total += ret;
+		if ((unsigned)ret < n || n < MMSG_BATCH)
+			break;
+		/* Later chunks must not wait once something has arrived. */
+		if (lflags & MSG_WAITFORONE)
+			lflags |= MSG_DONTWAIT;
+	}
+	return total || !vlen ? (int)total : -1;
+}
+QNX_REDIRECT(recvmmsg);
+
+/*
+ * Opt-in receive coalescing (QNX_SOCK_RECVBATCH=<n>, 2 to 64). A plain
+ * recv/recvfrom/recvmsg on a datagram socket pulls up to n waiting
+ * datagrams with one recvmmsg(MSG_WAITFORONE) and serves the next
+ * calls from that buffer. Datagrams held here are invisible to poll
+ * and select, so this only suits daemons that block in recv.
+ */
+#define RB_MAXFD 1024
+#define RB_MAXN 64
+#define RB_DGRAM 65536
+
+struct rb_meta {
+	int len, flags;
+	socklen_t salen;
+	struct sockaddr_storage sa;
+};
+
+struct rbatch {
+	volatile int lock[1];
+	volatile int stale;
+	int dgram; /* 0 unknown, 1 datagram socket, -1 not batched */
+	int next, count;
+	struct rb_meta meta[RB_MAXN];
+	char data[];
+};
+
+/* An fd that is no datagram socket, remembered without a buffer. */
+#define RB_STREAM ((struct rbatch *)-1)
+
+static struct rbatch *volatile rb_tab[RB_MAXFD];
+static int rb_n = -1;
+
+static struct rbatch *rb_get(int fd)
+{
+	struct rbatch *rb = rb_tab[fd], *old;
+	int type;
+	socklen_t tl = sizeof type;
+
+	if (rb)
+		return rb;
+	if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &tl)) {
+		if (errno == EBADF)
+			return 0;
+		type = -1;
+	}
+	if (type != SOCK_DGRAM) {
+		old = a_cas_p(&rb_tab[fd], 0, RB_STREAM);
+		return old ? old : RB_STREAM;
+	}
+	rb = calloc(1, sizeof *rb + (size_t)rb_n * RB_DGRAM);
+	if (!rb)
+		return 0;
+	rb->dgram = 1;
+	old = a_cas_p(&rb_tab[fd], 0, rb);
+	if (old) {
+		free(rb);
+		rb = old;
+	}
+	return rb;
+}
+
+static ssize_t rb_fill(int fd, struct rbatch *rb)
+{
+	struct mmsghdr vec[RB_MAXN];
+	struct iovec iov[RB_MAXN];
+	int i, r;
+
+	for (i = 0; i < rb_n; i++) {
+		iov[i].iov_base = rb->data + (size_t)i * RB_DGRAM;
+		iov[i].iov_len = RB_DGRAM;
+		vec[i].msg_hdr = (struct msghdr){
+			.msg_name = &rb->meta[i].sa,
+			.msg_namelen = sizeof rb->meta[i].sa,
+			.msg_iov = &iov[i],
+			.msg_iovlen = 1,
+		};
+	}
+	r = recvmmsg(fd, vec, rb_n, MSG_WAITFORONE, 0);
+	if (r < 0)
+		return r;
+	for (i = 0; i < r; i++) {
+		rb->meta[i].len = vec[i].msg_len;
+		rb->meta[i].flags = vec[i].msg_hdr.msg_flags;
+		rb->meta[i].salen = vec[i].msg_hdr.msg_namelen;
+	}
+	rb->next = 0;
+	rb->count = r;
+	return r;
+}
+
+ssize_t __qnx_recv_batched(int fd, const struct iovec *iov, int iovcnt,
+			   struct sockaddr_storage *sa, socklen_t *salen,
+			   int *mflags)
+{
+	struct rbatch *rb;
+	struct rb_meta *m;
+	const char *src;
+	size_t done = 0;
+	int type;
+	socklen_t tl = sizeof type;
+
+	if (rb_n < 0) {
+		const char *s = getenv("QNX_SOCK_RECVBATCH");
+		int n = s ? atoi(s) : 0;
+		rb_n = n < 2 ? 0 : n > RB_MAXN ? RB_MAXN : n;
+	}
+	if (!rb_n || fd < 0 || fd >= RB_MAXFD || iovcnt < 0)
+		return -2;
+	if (!(rb = rb_get(fd)) || rb == RB_STREAM || rb->dgram < 0)
+		return -2;
+
+	LOCK(rb->lock);
+	if (rb->stale) {
+		/* The fd was closed or replaced since the buffer was
+		 * filled, see __qnx_fd_replaced. */
+		rb->stale = 0;
+		rb->dgram = 0;
+		rb->next = rb->count = 0;
+	}
+	if (!rb->dgram) {
+		if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &tl) ||
+		    type != SOCK_DGRAM) {
+			rb->dgram = -1;
+			UNLOCK(rb->lock);
+			return -2;
+		}
+		rb->dgram = 1;
+	}
+	if (rb->next == rb->count && rb_fill(fd, rb) < 0) {
+		UNLOCK(rb->lock);
+		return -1;
+	}
+	m = &rb->meta[rb->next];
+	src = rb->data + (size_t)rb->next++ * RB_DGRAM;
+	for (int i = 0; i < iovcnt && done < (size_t)m->len; i++) {
+		size_t k = m->len - done;
+		if (k > iov[i].iov_len)
+			k = iov[i].iov_len;
+		memcpy(iov[i].iov_base, src + done, k);
+		done += k;
+	}
+	*mflags = m->flags | (done < (size_t)m->len ? MSG_TRUNC : 0);
+	if (sa) {
+		memcpy(sa, &m->sa, m->salen);
+		*salen = m->salen;
+	}
+	UNLOCK(rb->lock);
+	return done;
+}
+
+/* Whatever closes or replaces an fd drops what was buffered for it,
+ * and what was known of its socket type. */
+void __qnx_fd_replaced(int fd)
+{
+	struct rbatch *rb;
+
+	if (fd < 0 || fd >= RB_MAXFD || !(rb = rb_tab[fd]))
+		return;
+	if (rb == RB_STREAM)
+		a_cas_p(&rb_tab[fd], RB_STREAM, 0);
+	else
+		a_store(&rb->stale, 1);
+}
+
+/* Closing a resource manager connection is a message to the server. */
+int _qnx_close(int fd)
+{
+	if (nto_io_fd(fd)) {
+		__qnx_fd_replaced(fd);
+		return __nto_io_close(fd);
+	}
+	return close(fd);
+}
+QNX_REDIRECT(close);
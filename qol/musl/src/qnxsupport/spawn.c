@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include "features.h"
 #include "sys/resource.h"
 #include "sys/wait.h"
@@ -5,119 +6,567 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <signal.h>
 #include <errno.h>
-
-#define _SIGMAX 64
-#define NSIG (_SIGMAX + 1)
+#include <fcntl.h>
+#include <spawn.h>
+#include <sched.h>
+#include <limits.h>
+#include "syscall.h"
+#include "pthread_impl.h"
+#include "lock.h"
+#include "qnx_redirect.h"
+#include "qnx_probe.h"
+#include "qnx_stats.h"
+#include "qnx_fcntl.h"
+#include "qnx_fd.h"
+#include "qnx_signal.h"
+#include "qnx_sched.h"
 
 // clang-format off
-#define POSIX_SPAWN_SETPGROUP		0x00000001	/* set process group */
-#define POSIX_SPAWN_SETSIGMASK		0x00000002	/* set mask to sigmask */
-#define POSIX_SPAWN_SETSIGDEF		0x00000004	/* set members of sigdefault to SIG_DFL */
-#define POSIX_SPAWN_SETSCHEDULER	0x00000040	/* set members of sigignore to SIG_IGN */
-#define POSIX_SPAWN_SETSCHEDPARAM	0x00000400	/* Set the scheduling policy */
-#define POSIX_SPAWN_RESETIDS		0x0000
-
-#define POSIX_SPAWN_SETSIGIGN		0x00000008	/* set members of sigignore to SIG_IGN */
-#define POSIX_SPAWN_SETMPART		0x00000010	/* associate process with a set of memory partitions */
-#define POSIX_SPAWN_SETSPART		0x00000020	/* associate process with a scheduler partition */
-#define POSIX_SPAWN_SETND			0x00000100	/* spawn to remote node */
-#define POSIX_SPAWN_EXPLICIT_CPU	0x00000800	/* Set the CPU affinity/runmask */
-#define POSIX_SPAWN_SETSTACKMAX		0x00001000	/* Set the stack max */
-#define POSIX_SPAWN_NOZOMBIE		0x00002000	/* Process will not zombie on death  */
-#define POSIX_SPAWN_ALIGN_DEFAULT	0x00000000	/* Use system default settings for alignment */
-#define POSIX_SPAWN_ALIGN_FAULT		0x01000000	/* Try to always fault data misalignment references */
-#define POSIX_SPAWN_ALIGN_NOFAULT	0x02000000	/* Don't fault on misalignment, and attempt to fix it (may be slow) */
-
-#define SPAWN_SETGROUP			POSIX_SPAWN_SETPGROUP
-#define SPAWN_SETSIGMASK		POSIX_SPAWN_SETSIGMASK
-#define SPAWN_SETSIGDEF			POSIX_SPAWN_SETSIGDEF
-#define SPAWN_SETSIGIGN			POSIX_SPAWN_SETSIGIGN
-#define SPAWN_SETMEMPART		POSIX_SPAWN_SETMPART
-#define SPAWN_SETSCHEDPART		POSIX_SPAWN_SETSPART
+#define QNX_POSIX_SPAWN_SETPGROUP		0x00000001	/* set process group */
+#define QNX_POSIX_SPAWN_SETSIGMASK		0x00000002	/* set mask to sigmask */
+#define QNX_POSIX_SPAWN_SETSIGDEF		0x00000004	/* set members of sigdefault to SIG_DFL */
+#define QNX_POSIX_SPAWN_SETSCHEDULER	0x00000040	/* set members of sigignore to SIG_IGN */
+#define QNX_POSIX_SPAWN_SETSCHEDPARAM	0x00000400	/* Set the scheduling policy */
+#define QNX_POSIX_SPAWN_RESETIDS		0x0000
+
+#define QNX_POSIX_SPAWN_SETSIGIGN		0x00000008	/* set members of sigignore to SIG_IGN */
+#define QNX_POSIX_SPAWN_SETMPART		0x00000010	/* associate process with a set of memory partitions */
+#define QNX_POSIX_SPAWN_SETSPART		0x00000020	/* associate process with a scheduler partition */
+#define QNX_POSIX_SPAWN_SETND			0x00000100	/* spawn to remote node */
+#define QNX_POSIX_SPAWN_EXPLICIT_CPU	0x00000800	/* Set the CPU affinity/runmask */
+#define QNX_POSIX_SPAWN_SETSTACKMAX		0x00001000	/* Set the stack max */
+#define QNX_POSIX_SPAWN_NOZOMBIE		0x00002000	/* Process will not zombie on death  */
+#define QNX_POSIX_SPAWN_ALIGN_DEFAULT	0x00000000	/* Use system default settings for alignment */
+#define QNX_POSIX_SPAWN_ALIGN_FAULT		0x01000000	/* Try to always fault data misalignment references */
+#define QNX_POSIX_SPAWN_ALIGN_NOFAULT	0x02000000	/* Don't fault on misalignment, and attempt to fix it (may be slow) */
+
+#define SPAWN_SETGROUP			QNX_POSIX_SPAWN_SETPGROUP
+#define SPAWN_SETSIGMASK		QNX_POSIX_SPAWN_SETSIGMASK
+#define SPAWN_SETSIGDEF			QNX_POSIX_SPAWN_SETSIGDEF
+#define SPAWN_SETSIGIGN			QNX_POSIX_SPAWN_SETSIGIGN
+#define SPAWN_SETMEMPART		QNX_POSIX_SPAWN_SETMPART
+#define SPAWN_SETSCHEDPART		QNX_POSIX_SPAWN_SETSPART
 #define SPAWN_TCSETPGROUP		0x00000080	/* Start a new terminal group */
-#define SPAWN_SETND				POSIX_SPAWN_SETND
+#define SPAWN_SETND				QNX_POSIX_SPAWN_SETND
 #define SPAWN_SETSID			0x00000200	/* Make new process a session leader */
-#define SPAWN_EXPLICIT_SCHED	POSIX_SPAWN_SETSCHEDPARAM
-#define SPAWN_EXPLICIT_CPU		POSIX_SPAWN_EXPLICIT_CPU
-#define SPAWN_SETSTACKMAX		POSIX_SPAWN_SETSTACKMAX
-#define SPAWN_NOZOMBIE			POSIX_SPAWN_NOZOMBIE
+#define SPAWN_EXPLICIT_SCHED	QNX_POSIX_SPAWN_SETSCHEDPARAM
+#define SPAWN_EXPLICIT_CPU		QNX_POSIX_SPAWN_EXPLICIT_CPU
+#define SPAWN_SETSTACKMAX		QNX_POSIX_SPAWN_SETSTACKMAX
+#define SPAWN_NOZOMBIE			QNX_POSIX_SPAWN_NOZOMBIE
 #define SPAWN_DEBUG				0x00004000	/* Debug process */
 #define SPAWN_HOLD				0x00008000	/* Hold a process for Debug */
 #define SPAWN_EXEC				0x00010000	/* Cause the spawn to act like exec() */
 #define SPAWN_SEARCH_PATH		0x00020000	/* Search envar PATH for executable */
 #define SPAWN_CHECK_SCRIPT		0x00040000	/* Allow starting a shell passing file as script */
-#define SPAWN_ALIGN_DEFAULT		POSIX_SPAWN_ALIGN_DEFAULT
-#define SPAWN_ALIGN_FAULT		POSIX_SPAWN_ALIGN_FAULT
-#define SPAWN_ALIGN_NOFAULT		POSIX_SPAWN_ALIGN_NOFAULT
+#define SPAWN_ALIGN_DEFAULT		QNX_POSIX_SPAWN_ALIGN_DEFAULT
+#define SPAWN_ALIGN_FAULT		QNX_POSIX_SPAWN_ALIGN_FAULT
+#define SPAWN_ALIGN_NOFAULT		QNX_POSIX_SPAWN_ALIGN_NOFAULT
 #define SPAWN_ALIGN_MASK		0x03000000	/* Mask for align fault states below */
 #define SPAWN_PADDR64_SAFE		0x04000000	/* Memory physically located >4G is allowed */
 // clang-format on
 
+#define SPAWN_FDCLOSED (-1)
+
 struct inheritance {
 	uint32_t flags;
 	pid_t pgroup;
-	sigset_t sigmask;
-	sigset_t sigdefault;
-	sigset_t sigignore;
+	qnx_sigset_t sigmask;
+	qnx_sigset_t sigdefault;
+	qnx_sigset_t sigignore;
 	uint32_t stack_max;
 	int32_t policy;
 	uint32_t nd;
 	uint32_t runmask;
-	char param[48];
+	struct qnx_sched_param param;
 };
 
-pid_t spawn(const char *path, int fd_count, const int fd_map[],
-	    const struct inheritance *inherit, char *const argv[],
-	    char *const envp[])
+/*
+ * Child side of the attributes posix_spawn has no equivalent for. This
+ * runs in the CLONE_VM|CLONE_VFORK child, sharing memory with the
+ * blocked parent, so it only issues raw syscalls.
+ */
+static int apply_child_attrs(const struct inheritance *inherit)
 {
-	// pass the arguments to the kernel, call fork, and then call execve
-	// the kernel will create a new process, and then call execve
+	int ret;
+
+	if (inherit->flags & SPAWN_SETSIGIGN) {
+		struct sigaction sa = { .sa_handler = SIG_IGN };
+		for (int w = 0; w < 2; w++) {
+			uint32_t bits = inherit->sigignore.__bits[w];
+			for (; bits; bits &= bits - 1) {
+				int sig = 32 * w + __builtin_ctz(bits) + 1;
+				if ((sig = __qnx_signo_to_linux(sig)))
+					__libc_sigaction(sig, &sa, 0);
+			}
+		}
+	}
+	if (inherit->flags & SPAWN_SETSTACKMAX) {
+		struct rlimit rl = { inherit->stack_max, RLIM_INFINITY };
+		ret = __syscall(SYS_prlimit64, 0, RLIMIT_STACK, &rl, 0);
+		if (ret)
+			return ret;
+	}
+	if ((inherit->flags & SPAWN_EXPLICIT_CPU) && inherit->runmask) {
+		cpu_set_t set;
+		if (!__qnx_runmask_to_linux(&inherit->runmask, 1, &set))
+			return -EINVAL;
+		ret = __syscall(SYS_sched_setaffinity, 0, sizeof set, &set);
+		if (ret)
+			return ret;
+	}
+	if (inherit->flags & SPAWN_EXPLICIT_SCHED) {
+		int policy = __qnx_policy_to_linux(inherit->policy);
+		struct sched_param sp = { 0 };
+		if (policy < 0)
+			return -EINVAL;
+		sp.sched_priority = __qnx_prio_to_linux(policy,
+			inherit->param.sched_priority);
+		ret = __syscall(SYS_sched_setscheduler, 0, policy, &sp);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
 
-	// create a new process
-	pid_t pid;
+#define CLOSE_RANGE_CLOEXEC (1U << 2)
 
-	if (inherit->flags & SPAWN_EXEC)
-		pid = 0;
-	else
-		pid = fork();
+/*
+ * Mark every fd from fd up close-on-exec, so that only the fd_map
+ * entries reach the new image. The descriptors stay open until the
+ * exec: posix_spawn's error pipe is one of them. Kernels without
+ * CLOSE_RANGE_CLOEXEC (before 5.11) get one fcntl per possible fd.
+ */
+static void cloexec_from(int fd)
+{
+	struct rlimit rl;
+
+	if (!__syscall(SYS_close_range, fd, ~0U, CLOSE_RANGE_CLOEXEC))
+		return;
+	if (__syscall(SYS_prlimit64, 0, RLIMIT_NOFILE, 0, &rl))
+		return;
+	for (; fd < rl.rlim_cur; fd++) {
+		int fl = __syscall(SYS_fcntl, fd, F_GETFD);
+		if (fl >= 0 && !(fl & FD_CLOEXEC))
+			__syscall(SYS_fcntl, fd, F_SETFD, fl | FD_CLOEXEC);
+	}
+}
+
+/*
+ * One step of an fd_map: dup2(src, dst), or close(dst) when src is
+ * SPAWN_FDCLOSED. src == dst only clears FD_CLOEXEC.
+ */
+struct fd_move {
+	int src, dst;
+};
+
+/*
+ * Order the fd_map as a parallel assignment: fd i is overwritten only
+ * once no pending entry still reads it. What is left when nothing can
+ * move is a set of cycles; each is broken by first copying one member to
+ * a scratch fd above fd_count and every source, so there are at most
+ * 3 * fd_count / 2 steps. Returns them in a malloced array with their
+ * number in *n, or 0 with -errno in *n.
+ */
+static struct fd_move *fd_plan(int fd_count, const int fd_map[], int *n)
+{
+	struct fd_move *mv;
+	int *src, *readers, scratch = fd_count, left = 0, i;
+
+	if (!(mv = malloc(fd_count * (2 * sizeof *mv + 2 * sizeof *src)))) {
+		*n = -ENOMEM;
+		return 0;
+	}
+	src = (int *)(mv + 2 * fd_count);
+	readers = src + fd_count;
+	*n = 0;
+	for (i = 0; i < fd_count; i++)
+		readers[i] = 0;
+	for (i = 0; i < fd_count; i++) {
+		src[i] = fd_map[i];
+		if (src[i] < 0 && src[i] != SPAWN_FDCLOSED) {
+			free(mv);
+			*n = -EBADF;
+			return 0;
+		}
+		if (src[i] >= scratch)
+			scratch = src[i] + 1;
+		if (src[i] == i) {
+			mv[(*n)++] = (struct fd_move){ i, i };
+			src[i] = INT_MIN;
+			continue;
+		}
+		if ((unsigned)src[i] < (unsigned)fd_count)
+			readers[src[i]]++;
+		left++;
+	}
+	while (left) {
+		int moved = 0;
+		for (i = 0; i < fd_count; i++) {
+			if (src[i] == INT_MIN || readers[i])
+				continue;
+			mv[(*n)++] = (struct fd_move){ src[i], i };
+			if ((unsigned)src[i] < (unsigned)fd_count)
+				readers[src[i]]--;
+			src[i] = INT_MIN;
+			left--;
+			moved = 1;
+		}
+		if (moved)
+			continue;
+		/* Every pending target is still read: free one. */
+		for (i = 0; src[i] == INT_MIN; i++)
+			;
+		mv[(*n)++] = (struct fd_move){ i, scratch };
+		for (int j = 0; j < fd_count; j++)
+			if (src[j] == i)
+				src[j] = scratch;
+		readers[i] = 0;
+		scratch++;
+	}
+	return mv;
+}
+
+/* Apply fd_map to this process (SPAWN_EXEC); 0 or -errno. */
+static int fd_apply(int fd_count, const int fd_map[])
+{
+	struct fd_move *mv;
+	int n, ret = 0;
+
+	if (!(mv = fd_plan(fd_count, fd_map, &n)))
+		return n;
+	for (int i = 0; i < n && !ret; i++) {
+		if (mv[i].src == SPAWN_FDCLOSED) {
+			__syscall(SYS_close, mv[i].dst);
+			__qnx_fd_replaced(mv[i].dst);
+		} else if (mv[i].src != mv[i].dst) {
+			ret = __syscall(SYS_dup3, mv[i].src, mv[i].dst, 0);
+			ret = ret < 0 ? ret : 0;
+			__qnx_fd_replaced(mv[i].dst);
+		} else {
+			ret = __syscall(SYS_fcntl, mv[i].src, F_GETFD);
+			if (ret >= 0)
+				ret = __syscall(SYS_fcntl, mv[i].src, F_SETFD,
+						ret & ~FD_CLOEXEC);
+		}
+	}
+	free(mv);
+	if (!ret)
+		cloexec_from(fd_count);
+	return ret;
+}
+
+/* The fd_map as posix_spawn file actions, which run in order. */
+static int spawn_fd_actions(posix_spawn_file_actions_t *fa, int fd_count,
+			    const int fd_map[])
+{
+	struct fd_move *mv;
+	int n, ret = 0;
+
+	if (!(mv = fd_plan(fd_count, fd_map, &n)))
+		return -n;
+	for (int i = 0; i < n && !ret; i++) {
+		if (mv[i].src == SPAWN_FDCLOSED)
+			ret = posix_spawn_file_actions_addclose(fa, mv[i].dst);
+		else
+			ret = posix_spawn_file_actions_adddup2(fa, mv[i].src,
+							       mv[i].dst);
+	}
+	free(mv);
+	return ret;
+}
+
+struct spawn_ctx {
+	const char *path;
+	const struct inheritance *inherit;
+	int fd_count;
+};
+
+/*
+ * Installed as the posix_spawn exec function. posix_spawn hands the
+ * path argument through untouched, so it carries the spawn_ctx. The
+ * file actions have already laid out fds 0 to fd_count - 1.
+ */
+static int spawn_exec(const char *ctxp, char *const argv[], char *const envp[])
+{
+	const struct spawn_ctx *ctx = (const void *)ctxp;
+	int ret = apply_child_attrs(ctx->inherit);
 
-	if (pid != 0)
-		return pid;
+	if (ret) {
+		errno = -ret;
+		return -1;
+	}
+	if (ctx->fd_count > 0)
+		cloexec_from(ctx->fd_count);
+	return execve(ctx->path, argv, envp);
+}
+
+/* SPAWN_EXEC: apply the attributes to this process and replace it. */
+static pid_t spawn_exec_self(const char *path, int fd_count,
+			     const int fd_map[],
+			     const struct inheritance *inherit,
+			     char *const argv[], char *const envp[])
+{
+	sigset_t set;
+	int ret;
 
-	// child process
 	if (inherit->flags & SPAWN_SETGROUP)
 		setpgid(0, inherit->pgroup);
-	if (inherit->flags & SPAWN_SETSIGMASK)
-		sigprocmask(SIG_SETMASK, &inherit->sigmask, 0);
 	if (inherit->flags & SPAWN_SETSID)
 		setsid();
-	if (inherit->flags & SPAWN_SETSTACKMAX)
-		setrlimit(RLIMIT_STACK, &(struct rlimit){ inherit->stack_max,
-							  RLIM_INFINITY });
-
-	if (inherit->flags & SPAWN_SETSIGDEF)
-		for (int i = 1; i < NSIG; i++)
-			if (sigismember(&inherit->sigdefault, i))
-				signal(i, SIG_DFL);
-	if (inherit->flags & SPAWN_SETSIGIGN)
-		for (int i = 1; i < NSIG; i++)
-			if (sigismember(&inherit->sigignore, i))
-				signal(i, SIG_IGN);
-
-	// keep fd
-	for (int i = 0; i < fd_count; i++) {
-		if (fd_map[i] != i) {
-			dup2(fd_map[i], i);
-			close(fd_map[i]);
+	if (inherit->flags & SPAWN_SETSIGDEF) {
+		struct sigaction sa = { .sa_handler = SIG_DFL };
+		for (int w = 0; w < 2; w++) {
+			uint32_t bits = inherit->sigdefault.__bits[w];
+			for (; bits; bits &= bits - 1) {
+				int sig = 32 * w + __builtin_ctz(bits) + 1;
+				if ((sig = __qnx_signo_to_linux(sig)))
+					sigaction(sig, &sa, 0);
+			}
 		}
 	}
-
-	// call execve
+	if ((ret = apply_child_attrs(inherit))) {
+		errno = -ret;
+		return -1;
+	}
+	if (fd_count > 0 && (ret = fd_apply(fd_count, fd_map))) {
+		errno = -ret;
+		return -1;
+	}
+	if (inherit->flags & SPAWN_SETSIGMASK) {
+		__qnx_sigset_to_linux(&inherit->sigmask, &set);
+		sigprocmask(SIG_SETMASK, &set, 0);
+	}
 	execve(path, argv, envp);
+	return -1;
+}
+
+/*
+ * SPAWN_SEARCH_PATH resolution. Process managers respawn the same few
+ * helpers over and over, so resolved names are cached together with a
+ * hash of the PATH they were found in. A cached entry is used only if
+ * PATH is unchanged and the file is still executable.
+ */
+#define PATH_CACHE_SIZE 16
+
+static struct path_cache_entry {
+	uint32_t path_hash;
+	char name[NAME_MAX + 1];
+	char file[PATH_MAX];
+} path_cache[PATH_CACHE_SIZE];
+static unsigned path_cache_next;
+static volatile int path_cache_lock[1];
+
+static uint32_t path_hash(const char *s)
+{
+	uint32_t h = 2166136261u;
+	for (; *s; s++)
+		h = (h ^ (unsigned char)*s) * 16777619u;
+	return h;
+}
+
+static int search_path(const char *name, char *buf)
+{
+	const char *path = getenv("PATH"), *p, *z;
+	size_t l = strnlen(name, NAME_MAX + 1);
+	uint32_t h;
+	unsigned i;
+
+	if (l > NAME_MAX)
+		return -ENAMETOOLONG;
+	if (!path)
+		path = "/usr/local/bin:/bin:/usr/bin";
+	h = path_hash(path);
+
+	LOCK(path_cache_lock);
+	for (i = 0; i < PATH_CACHE_SIZE; i++) {
+		struct path_cache_entry *e = &path_cache[i];
+		if (e->path_hash == h && !strcmp(e->name, name)) {
+			strcpy(buf, e->file);
+			break;
+		}
+	}
+	UNLOCK(path_cache_lock);
+	if (i < PATH_CACHE_SIZE && !access(buf, X_OK))
+		return 0;
+
+	for (p = path; ; p = z + 1) {
+		z = strchrnul(p, ':');
+		if (z - p + l + 2 <= PATH_MAX) {
+			memcpy(buf, p, z - p);
+			buf[z - p] = '/';
+			memcpy(buf + (z - p) + (z > p), name, l + 1);
+			if (!access(buf, X_OK)) {
+				LOCK(path_cache_lock);
+				struct path_cache_entry *e =
+					&path_cache[path_cache_next++ % PATH_CACHE_SIZE];
+				e->path_hash = h;
+				strcpy(e->name, name);
+				strcpy(e->file, buf);
+				UNLOCK(path_cache_lock);
+				return 0;
+			}
+		}
+		if (!*z)
+			return -ENOENT;
+	}
+}
+
+/*
+ * SPAWN_NOZOMBIE: children are recorded in a fixed table of pids and
+ * reaped in batches, either from a SIGCHLD handler installed on first
+ * use (only while SIGCHLD is still at SIG_DFL, so an application handler
+ * is never replaced) or, failing that, by the next SPAWN_NOZOMBIE
+ * spawn(). The table is lock-free so that the handler can use it.
+ */
+#define NOZOMBIE_MAX 256
+
+static volatile int nozombie_pids[NOZOMBIE_MAX];
+static volatile int nozombie_handler;
+
+static void nozombie_reap(void)
+{
+	for (int i = 0; i < NOZOMBIE_MAX; i++) {
+		int pid = nozombie_pids[i];
+		if (pid && __syscall(SYS_wait4, pid, 0, WNOHANG, 0) == pid)
+			a_cas(&nozombie_pids[i], pid, 0);
+	}
+}
+
+static void nozombie_sigchld(int sig)
+{
+	int old_errno = errno;
+	nozombie_reap();
+	errno = old_errno;
+}
+
+static void nozombie_add(pid_t pid)
+{
+	struct sigaction sa;
+
+	if (!a_swap(&nozombie_handler, 1) && !sigaction(SIGCHLD, 0, &sa) &&
+	    sa.sa_handler == SIG_DFL) {
+		sa.sa_handler = nozombie_sigchld;
+		sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+		sigemptyset(&sa.sa_mask);
+		sigaction(SIGCHLD, &sa, 0);
+	}
+	for (int i = 0; i < NOZOMBIE_MAX; i++)
+		if (!a_cas(&nozombie_pids[i], 0, pid))
+			return;
+}
+
+/*
+ * The child half of spawn() and posix_spawn() on top of musl's
+ * posix_spawn, which creates the child with CLONE_VM|CLONE_VFORK instead
+ * of copying the page tables with fork. Returns 0 or an errno value.
+ */
+static int spawn_inherit(pid_t *pid, const char *path,
+			 const posix_spawn_file_actions_t *fap, int fd_count,
+			 const struct inheritance *inherit, char *const argv[],
+			 char *const envp[])
+{
+	posix_spawnattr_t attr;
+	struct spawn_ctx ctx;
+	sigset_t set, chld, oldmask;
+	short flags = 0;
+	int ret;
+
+	posix_spawnattr_init(&attr);
+	if (inherit->flags & SPAWN_SETGROUP) {
+		flags |= POSIX_SPAWN_SETPGROUP;
+		posix_spawnattr_setpgroup(&attr, inherit->pgroup);
+	}
+	if (inherit->flags & SPAWN_SETSID)
+		flags |= POSIX_SPAWN_SETSID;
+	if (inherit->flags & SPAWN_SETSIGMASK) {
+		flags |= POSIX_SPAWN_SETSIGMASK;
+		__qnx_sigset_to_linux(&inherit->sigmask, &set);
+		posix_spawnattr_setsigmask(&attr, &set);
+	}
+	if (inherit->flags & SPAWN_SETSIGDEF) {
+		flags |= POSIX_SPAWN_SETSIGDEF;
+		__qnx_sigset_to_linux(&inherit->sigdefault, &set);
+		posix_spawnattr_setsigdefault(&attr, &set);
+	}
+	posix_spawnattr_setflags(&attr, flags);
+	ctx.path = path;
+	ctx.inherit = inherit;
+	ctx.fd_count = fd_count;
+	attr.__fn = (void *)spawn_exec;
+
+	if (inherit->flags & SPAWN_NOZOMBIE) {
+		/* Keep SIGCHLD pending until the pid is in the table. */
+		sigemptyset(&chld);
+		sigaddset(&chld, SIGCHLD);
+		pthread_sigmask(SIG_BLOCK, &chld, &oldmask);
+		nozombie_reap();
+		/* The child would inherit the blocked SIGCHLD otherwise. */
+		if (!(inherit->flags & SPAWN_SETSIGMASK)) {
+			posix_spawnattr_setsigmask(&attr, &oldmask);
+			posix_spawnattr_setflags(&attr,
+						 flags | POSIX_SPAWN_SETSIGMASK);
+		}
+	}
+	ret = posix_spawn(pid, (const char *)&ctx, fap, &attr, argv, envp);
+	QNX_PROBE3(spawn, path, ret ? -1 : *pid, ret);
+	__qnx_stat(ret ? QNX_STAT_SPAWN_FAIL : QNX_STAT_SPAWN);
+	if (inherit->flags & SPAWN_NOZOMBIE) {
+		if (!ret)
+			nozombie_add(*pid);
+		pthread_sigmask(SIG_SETMASK, &oldmask, 0);
+	}
+	posix_spawnattr_destroy(&attr);
+	return ret;
+}
 
-	// will not reach here
+/*
+ * QNX spawn(). A null envp inherits the caller's environment, as on
+ * QNX. The runmask and scheduling policy are applied in the child
+ * before exec.
+ */
+pid_t spawn(const char *path, int fd_count, const int fd_map[],
+	    const struct inheritance *inherit, char *const argv[],
+	    char *const envp[])
+{
+	static const struct inheritance none;
+	posix_spawn_file_actions_t fa, *fap = 0;
+	pid_t pid;
+	int ret = 0;
+	char file[PATH_MAX];
+
+	if (!inherit)
+		inherit = &none;
+	if (!envp)
+		envp = __environ;
+	if ((inherit->flags & SPAWN_SEARCH_PATH) && !strchr(path, '/')) {
+		if (!*path || (ret = search_path(path, file))) {
+			errno = *path ? -ret : ENOENT;
+			return -1;
+		}
+		path = file;
+	}
+	if (inherit->flags & SPAWN_EXEC)
+		return spawn_exec_self(path, fd_count, fd_map, inherit, argv,
+				       envp);
+
+	if (fd_count > 0) {
+		fap = &fa;
+		posix_spawn_file_actions_init(fap);
+		ret = spawn_fd_actions(fap, fd_count, fd_map);
+	}
+	if (!ret)
+		ret = spawn_inherit(&pid, path, fap, fd_count, inherit, argv,
+				    envp);
+	if (fap)
+		posix_spawn_file_actions_destroy(fap);
+	if (ret) {
+		errno = ret;
+		return -1;
+	}
+	return pid;
 }
 
 #define DOIT_CVT_L2V(arg0, argv, envv_assignment)                     \
@@ -162,23 +611,23 @@ pid_t spawn(const char *path, int fd_count, const int fd_map[],
 #define P_OVERLAY 2
 #define P_NOWAITO 3
 
-int spawnve(int mode, const char *path, char *const argv[], char *const envp[])
+static int spawn_mode(int mode, uint32_t flags, const char *path,
+		      char *const argv[], char *const envp[])
 {
 	pid_t pid;
-	struct inheritance attr;
+	struct inheritance attr = { .flags = flags };
 
 	switch (mode) {
 	case P_WAIT:
 	case P_NOWAIT:
-		attr.flags = 0;
 		break;
 
 	case P_OVERLAY:
-		attr.flags = SPAWN_EXEC;
+		attr.flags |= SPAWN_EXEC;
 		break;
 
 	case P_NOWAITO:
-		attr.flags = SPAWN_NOZOMBIE;
+		attr.flags |= SPAWN_NOZOMBIE;
 		break;
 
 	default:
@@ -197,14 +646,26 @@ int spawnve(int mode, const char *path, char *const argv[], char *const envp[])
 	return pid;
 }
 
-weak_alias(spawnve, spawnvpe);
+int spawnve(int mode, const char *path, char *const argv[], char *const envp[])
+{
+	return spawn_mode(mode, 0, path, argv, envp);
+}
+
+int spawnvpe(int mode, const char *file, char *const argv[],
+	     char *const envp[])
+{
+	return spawn_mode(mode, SPAWN_SEARCH_PATH, file, argv, envp);
+}
 
 int spawnv(int mode, const char *path, char *const argv[])
 {
 	return spawnve(mode, path, argv, 0);
 }
 
-weak_alias(spawnv, spawnvp);
+int spawnvp(int mode, const char *file, char *const argv[])
+{
+	return spawnvpe(mode, file, argv, 0);
+}
 
 int spawnl(int mode, const char *path, const char *arg0, ...)
 {
@@ -214,7 +675,13 @@ int spawnl(int mode, const char *path, const char *arg0, ...)
 	return spawnve(mode, path, argv, 0);
 }
 
-weak_alias(spawnl, spawnlp);
+int spawnlp(int mode, const char *file, const char *arg0, ...)
+{
+	char **argv;
+
+	CVT_L2V(arg0, argv);
+	return spawnvpe(mode, file, argv, 0);
+}
 
 int spawnle(int mode, const char *path, const char *arg0, ...)
 {
@@ -224,4 +691,269 @@ int spawnle(int mode, const char *path, const char *arg0, ...)
 	CVT_L2V_ENV(arg0, argv, envv);
 	return spawnve(mode, path, argv, envv);
 }
-weak_alias(spawnle, spawnlpe);
+
+int spawnlpe(int mode, const char *file, const char *arg0, ...)
+{
+	char **argv;
+	char **envv;
+
+	CVT_L2V_ENV(arg0, argv, envv);
+	return spawnvpe(mode, file, argv, envv);
+}
+
+/*
+ * QNX posix_spawn. QNX's posix_spawnattr_t and posix_spawn_file_actions_t
+ * are a pointer to an object that init allocates, which is too small to
+ * hold musl's; here the attribute object is the struct inheritance that
+ * spawn() takes, so the QNX extensions (runmask, stack maximum, ignored
+ * signals, NOZOMBIE) go through the same child path, and the file
+ * actions object is musl's.
+ */
+struct qnx_spawnattr {
+	struct inheritance inherit;
+	unsigned nparts;
+};
+
+typedef struct {
+	struct qnx_spawnattr *__attr;
+} qnx_posix_spawnattr_t;
+
+typedef struct {
+	posix_spawn_file_actions_t *__fa;
+} qnx_posix_spawn_file_actions_t;
+
+/* What posix_spawn takes of the spawn() flags. */
+#define QNX_POSIX_SPAWN_FLAGS \
+	(SPAWN_SETGROUP | SPAWN_SETSIGMASK | SPAWN_SETSIGDEF | \
+	 SPAWN_SETSIGIGN | SPAWN_SETMEMPART | SPAWN_SETSCHEDPART | \
+	 QNX_POSIX_SPAWN_SETSCHEDULER | SPAWN_TCSETPGROUP | SPAWN_SETND | \
+	 SPAWN_SETSID | SPAWN_EXPLICIT_SCHED | SPAWN_EXPLICIT_CPU | \
+	 SPAWN_SETSTACKMAX | SPAWN_NOZOMBIE | SPAWN_ALIGN_MASK | \
+	 SPAWN_PADDR64_SAFE)
+
+static int qnx_posix_spawn(pid_t *pid, const char *path,
+			   const qnx_posix_spawn_file_actions_t *fa,
+			   const qnx_posix_spawnattr_t *attr, int search,
+			   char *const argv[], char *const envp[])
+{
+	struct inheritance inherit = { 0 };
+	char file[PATH_MAX];
+	pid_t child;
+	int ret;
+
+	if ((attr && !attr->__attr) || (fa && !fa->__fa))
+		return EINVAL;
+	if (attr)
+		inherit = attr->__attr->inherit;
+	inherit.flags &= QNX_POSIX_SPAWN_FLAGS;
+	/* SETSCHEDULER takes the policy too; SETSCHEDPARAM alone keeps ours. */
+	if (inherit.flags & QNX_POSIX_SPAWN_SETSCHEDULER) {
+		inherit.flags |= SPAWN_EXPLICIT_SCHED;
+	} else if (inherit.flags & SPAWN_EXPLICIT_SCHED) {
+		int policy = __syscall(SYS_sched_getscheduler, 0);
+		inherit.policy = policy == SCHED_FIFO ? QNX_SCHED_FIFO :
+				 policy == SCHED_RR ? QNX_SCHED_RR :
+				 QNX_SCHED_OTHER;
+	}
+	if (search && !strchr(path, '/')) {
+		if (!*path)
+			return ENOENT;
+		if ((ret = search_path(path, file)))
+			return -ret;
+		path = file;
+	}
+	ret = spawn_inherit(&child, path, fa ? fa->__fa : 0, 0, &inherit,
+			    argv, envp);
+	if (!ret && pid)
+		*pid = child;
+	return ret;
+}
+
+int _qnx_posix_spawn(pid_t *pid, const char *path,
+		     const qnx_posix_spawn_file_actions_t *fa,
+		     const qnx_posix_spawnattr_t *attr, char *const argv[],
+		     char *const envp[])
+{
+	return qnx_posix_spawn(pid, path, fa, attr, 0, argv, envp);
+}
+QNX_REDIRECT(posix_spawn);
+
+int _qnx_posix_spawnp(pid_t *pid, const char *file,
+		      const qnx_posix_spawn_file_actions_t *fa,
+		      const qnx_posix_spawnattr_t *attr, char *const argv[],
+		      char *const envp[])
+{
+	return qnx_posix_spawn(pid, file, fa, attr, 1, argv, envp);
+}
+QNX_REDIRECT(posix_spawnp);
+
+int _qnx_posix_spawnattr_init(qnx_posix_spawnattr_t *attr)
+{
+	if (!(attr->__attr = calloc(1, sizeof *attr->__attr)))
+		return ENOMEM;
+	return 0;
+}
+QNX_REDIRECT(posix_spawnattr_init);
+
+int _qnx_posix_spawnattr_destroy(qnx_posix_spawnattr_t *attr)
+{
+	if (!attr->__attr)
+		return EINVAL;
+	free(attr->__attr);
+	attr->__attr = 0;
+	return 0;
+}
+QNX_REDIRECT(posix_spawnattr_destroy);
+
+/*
+ * The accessors. GET and SET define a getter and setter of one field of
+ * the struct inheritance; the flag words are handled by hand below.
+ */
+#define SPAWNATTR_GET(name, type, field) \
+	int _qnx_posix_spawnattr_get##name(const qnx_posix_spawnattr_t *attr, \
+					   type *v) \
+	{ \
+		if (!attr->__attr) \
+			return EINVAL; \
+		*v = attr->__attr->inherit.field; \
+		return 0; \
+	} \
+	QNX_REDIRECT(posix_spawnattr_get##name)
+
+#define SPAWNATTR_SET(name, type, field) \
+	int _qnx_posix_spawnattr_set##name(qnx_posix_spawnattr_t *attr, \
+					   type v) \
+	{ \
+		if (!attr->__attr) \
+			return EINVAL; \
+		attr->__attr->inherit.field = v; \
+		return 0; \
+	} \
+	QNX_REDIRECT(posix_spawnattr_set##name)
+
+#define SPAWNATTR_SETP(name, type, field) \
+	int _qnx_posix_spawnattr_set##name(qnx_posix_spawnattr_t *attr, \
+					   const type *v) \
+	{ \
+		if (!attr->__attr) \
+			return EINVAL; \
+		attr->__attr->inherit.field = *v; \
+		return 0; \
+	} \
+	QNX_REDIRECT(posix_spawnattr_set##name)
+
+SPAWNATTR_GET(xflags, uint32_t, flags);
+SPAWNATTR_SET(xflags, uint32_t, flags);
+SPAWNATTR_GET(pgroup, pid_t, pgroup);
+SPAWNATTR_SET(pgroup, pid_t, pgroup);
+SPAWNATTR_GET(sigmask, qnx_sigset_t, sigmask);
+SPAWNATTR_SETP(sigmask, qnx_sigset_t, sigmask);
+SPAWNATTR_GET(sigdefault, qnx_sigset_t, sigdefault);
+SPAWNATTR_SETP(sigdefault, qnx_sigset_t, sigdefault);
+SPAWNATTR_GET(sigignore, qnx_sigset_t, sigignore);
+SPAWNATTR_SETP(sigignore, qnx_sigset_t, sigignore);
+SPAWNATTR_GET(schedparam, struct qnx_sched_param, param);
+SPAWNATTR_SETP(schedparam, struct qnx_sched_param, param);
+SPAWNATTR_GET(schedpolicy, int, policy);
+SPAWNATTR_SET(schedpolicy, int, policy);
+SPAWNATTR_GET(runmask, uint32_t, runmask);
+SPAWNATTR_SET(runmask, uint32_t, runmask);
+SPAWNATTR_GET(stackmax, uint32_t, stack_max);
+SPAWNATTR_SET(stackmax, uint32_t, stack_max);
+SPAWNATTR_GET(node, uint32_t, nd);
+SPAWNATTR_SET(node, uint32_t, nd);
+
+/* The POSIX flags are the low half of the QNX flag word. */
+int _qnx_posix_spawnattr_getflags(const qnx_posix_spawnattr_t *attr,
+				  short *flags)
+{
+	if (!attr->__attr)
+		return EINVAL;
+	*flags = attr->__attr->inherit.flags;
+	return 0;
+}
+QNX_REDIRECT(posix_spawnattr_getflags);
+
+int _qnx_posix_spawnattr_setflags(qnx_posix_spawnattr_t *attr, short flags)
+{
+	uint32_t *f;
+
+	if (!attr->__attr)
+		return EINVAL;
+	f = &attr->__attr->inherit.flags;
+	*f = (*f & 0xffff0000) | (unsigned short)flags;
+	return 0;
+}
+QNX_REDIRECT(posix_spawnattr_setflags);
+
+/*
+ * Memory and scheduler partitions do not exist on Linux. Adding one is
+ * accepted, and only counted, so that launchers written for them run.
+ */
+int _qnx_posix_spawnattr_addpartid(qnx_posix_spawnattr_t *attr,
+				   uint32_t partid)
+{
+	(void)partid;
+	if (!attr->__attr)
+		return EINVAL;
+	attr->__attr->nparts++;
+	return 0;
+}
+QNX_REDIRECT(posix_spawnattr_addpartid);
+
+int _qnx_posix_spawnattr_addpartition(qnx_posix_spawnattr_t *attr,
+				      const char *name, ...)
+{
+	if (!attr->__attr || !name)
+		return EINVAL;
+	attr->__attr->nparts++;
+	return 0;
+}
+QNX_REDIRECT(posix_spawnattr_addpartition);
+
+int _qnx_posix_spawn_file_actions_init(qnx_posix_spawn_file_actions_t *fa)
+{
+	if (!(fa->__fa = malloc(sizeof *fa->__fa)))
+		return ENOMEM;
+	return posix_spawn_file_actions_init(fa->__fa);
+}
+QNX_REDIRECT(posix_spawn_file_actions_init);
+
+int _qnx_posix_spawn_file_actions_destroy(qnx_posix_spawn_file_actions_t *fa)
+{
+	if (!fa->__fa)
+		return EINVAL;
+	posix_spawn_file_actions_destroy(fa->__fa);
+	free(fa->__fa);
+	fa->__fa = 0;
+	return 0;
+}
+QNX_REDIRECT(posix_spawn_file_actions_destroy);
+
+int _qnx_posix_spawn_file_actions_addclose(qnx_posix_spawn_file_actions_t *fa,
+					   int fd)
+{
+	return fa->__fa ? posix_spawn_file_actions_addclose(fa->__fa, fd) :
+			  EINVAL;
+}
+QNX_REDIRECT(posix_spawn_file_actions_addclose);
+
+int _qnx_posix_spawn_file_actions_adddup2(qnx_posix_spawn_file_actions_t *fa,
+					  int fd, int newfd)
+{
+	return fa->__fa ?
+		posix_spawn_file_actions_adddup2(fa->__fa, fd, newfd) :
+		EINVAL;
+}
+QNX_REDIRECT(posix_spawn_file_actions_adddup2);
+
+int _qnx_posix_spawn_file_actions_addopen(qnx_posix_spawn_file_actions_t *fa,
+					  int fd, const char *path, int oflag,
+					  mode_t mode)
+{
+	return fa->__fa ?
+		posix_spawn_file_actions_addopen(fa->__fa, fd, path,
+			__qnx_oflags_to_linux(oflag), mode) :
+		EINVAL;
+}
+QNX_REDIRECT(posix_spawn_file_actions_addopen);
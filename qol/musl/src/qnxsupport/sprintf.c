@@ -1,5 +1,6 @@
 #include <stdarg.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,7 +8,15 @@
 #define FLAG_ABORT_ON_OVERFLOW 1
 #define FLAG_TERMINATE 2
 
+/*
+ * Fortified printf entry points. os is the compiler's idea of the size
+ * of the destination object, (size_t)-1 when it does not know, which
+ * is the common case and goes straight to the unchecked function.
+ */
+#define OS_UNKNOWN ((size_t)-1)
+
 int __vsprintf_chk(char *str, int flag, size_t os, const char *format, va_list ap);
+int __vsnprintf_chk(char *str, size_t size, int flag, size_t os, const char *format, va_list ap);
 
 int __sprintf_chk(char *str, int flag, size_t os, const char *format, ...) {
     va_list ap;
@@ -18,34 +27,29 @@ int __sprintf_chk(char *str, int flag, size_t os, const char *format, ...) {
 }
 
 int __vsprintf_chk(char *str, int flag, size_t os, const char *format, va_list ap) {
-    size_t buf_size = os;
-    int ret = vsnprintf(str, buf_size, format, ap);
-    
-    if (ret >= (int)buf_size) {
-        if (flag & FLAG_ABORT_ON_OVERFLOW) {
-            abort();
-        } else {
-            str[buf_size-1] = '\0';
-        }
-    }
+    if (os == OS_UNKNOWN)
+        return vsprintf(str, format, ap);
+    if (!os)
+        abort();
+
+    /* One bounded pass; a result that did not fit would have overflowed. */
+    int ret = vsnprintf(str, os > INT_MAX ? INT_MAX : os, format, ap);
+    if (ret >= 0 && (size_t)ret >= os && (flag & FLAG_ABORT_ON_OVERFLOW))
+        abort();
     return ret;
 }
 
+int __vsnprintf_chk(char *str, size_t size, int flag, size_t os, const char *format, va_list ap) {
+    (void)flag;
+    if (os != OS_UNKNOWN && size > os)
+        abort();
+    return vsnprintf(str, size, format, ap);
+}
+
 int __snprintf_chk(char *str, size_t size, int flag, size_t os, const char *format, ...) {
     va_list ap;
     va_start(ap, format);
-    int ret = vsnprintf(str, size, format, ap);
+    int ret = __vsnprintf_chk(str, size, flag, os, format, ap);
     va_end(ap);
-
-    if (ret < 0) {
-        str[0] = '\0';
-        abort();
-    } else if ((size_t)ret >= size) {
-        if (flag & FLAG_TERMINATE) {
-            str[size-1] = '\0';
-        } else {
-            abort();
-        }
-    }
     return ret;
-}
\ No newline at end of file
+}
@@ -1,5 +1,50 @@
+#include <elf.h>
 #include <stdint.h>
+#include <sys/resource.h>
+#include "libc.h"
+#include "pthread_impl.h"
+#include "qnx_stack.h"
 
-uint64_t __stackavail(void) {
-    return 0xffffffffffffffff;
-}
\ No newline at end of file
+/*
+ * QNX stackavail(): bytes left between the caller's stack pointer and
+ * the guard page of the current stack. Threads know their stack from
+ * pthread_create; the main thread's is worked out once at startup, from
+ * the top of the initial stack (where the kernel put the program's
+ * file name) and RLIMIT_STACK. Outside either, on a signal stack say,
+ * the answer is 0, which sends callers down their heap paths.
+ */
+#define DEFAULT_MAIN_STACK (8 << 20)
+
+static uintptr_t main_low, main_high;
+
+void __qnx_stack_init(void)
+{
+	struct rlimit rl;
+	uintptr_t top = 0, page = PAGE_SIZE;
+	size_t *a;
+
+	for (a = libc.auxv; a && *a; a += 2)
+		if (*a == AT_EXECFN)
+			top = a[1];
+	if (!top)
+		top = (uintptr_t)a;
+	top = (top + page - 1) & -page;
+	if (getrlimit(RLIMIT_STACK, &rl) || rl.rlim_cur == RLIM_INFINITY ||
+	    rl.rlim_cur > top)
+		rl.rlim_cur = DEFAULT_MAIN_STACK;
+	main_high = top;
+	main_low = top - rl.rlim_cur + page;
+}
+
+uint64_t __stackavail(void)
+{
+	pthread_t self = __pthread_self();
+	uintptr_t sp = (uintptr_t)__builtin_frame_address(0);
+	uintptr_t low = main_low, high = main_high;
+
+	if (self->stack) {
+		high = (uintptr_t)self->stack;
+		low = high - self->stack_size;
+	}
+	return sp > low && sp <= high ? sp - low : 0;
+}
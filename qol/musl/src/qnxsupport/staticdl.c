@@ -0,0 +1,68 @@
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <string.h>
+#include "qnx_staticdl.h"
+
+/*
+ * dlopen and dlsym in static binaries, where the dynamic linker is not
+ * linked and the stubs in src/ldso call these instead. qnxstatic.py
+ * links a QNX program's plugins (libimg's codecs) into the binary with
+ * their symbols renamed, and lists them in __qnx_static_dsos; dlopen of
+ * a name whose last component matches an entry returns that entry as
+ * the handle. Without the table, as in any other static binary, all of
+ * this fails as before.
+ */
+
+extern const struct qnx_static_dso __qnx_static_dsos[]
+	__attribute__((__weak__));
+
+static const char *base(const char *s)
+{
+	const char *p = strrchr(s, '/');
+	return p ? p+1 : s;
+}
+
+hidden void *__qnx_static_dlopen(const char *file)
+{
+	const struct qnx_static_dso *d;
+	if (!__qnx_static_dsos || !file) return 0;
+	for (d=__qnx_static_dsos; d->name; d++)
+		if (!strcmp(base(d->name), base(file)))
+			return (void *)d;
+	return 0;
+}
+
+hidden int __qnx_static_handle(void *p)
+{
+	const struct qnx_static_dso *d;
+	if (!__qnx_static_dsos) return 0;
+	for (d=__qnx_static_dsos; d->name; d++)
+		if (p == d) return 1;
+	return 0;
+}
+
+static int cmp_sym(const void *k, const void *s)
+{
+	return strcmp(k, ((const struct qnx_static_sym *)s)->name);
+}
+
+static void *find(const struct qnx_static_dso *d, const char *s)
+{
+	const struct qnx_static_sym *sym;
+	sym = bsearch(s, d->syms, d->nsyms, sizeof *d->syms, cmp_sym);
+	return sym ? sym->addr : 0;
+}
+
+/* RTLD_DEFAULT and RTLD_NEXT look through every DSO in table order;
+ * the program's own symbols are not in the table. */
+hidden void *__qnx_static_dlsym(void *p, const char *s)
+{
+	const struct qnx_static_dso *d;
+	void *r;
+	if (__qnx_static_handle(p)) return find(p, s);
+	if (!__qnx_static_dsos || (p != RTLD_DEFAULT && p != RTLD_NEXT))
+		return 0;
+	for (d=__qnx_static_dsos; d->name; d++)
+		if ((r = find(d, s))) return r;
+	return 0;
+}
@@ -1,25 +1,104 @@
-char *itoa(int n, char *s, int base)
+#include <string.h>
+#include <limits.h>
+
+/*
+ * QNX (Watcom) integer to string conversions. Bases 2 to 36 use
+ * lowercase letters for digits above 9; a minus sign is only written
+ * for negative values in base 10, other bases print the value as
+ * unsigned. An invalid base yields an empty string.
+ *
+ * Digits are generated backwards into a scratch buffer and copied out
+ * once: base 10 two digits per division, powers of two by shift and
+ * mask.
+ */
+
+static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+static const char pairs[200] =
+	"00010203040506070809101112131415161718192021222324"
+	"25262728293031323334353637383940414243444546474849"
+	"50515253545556575859606162636465666768697071727374"
+	"75767778798081828384858687888990919293949596979899";
+
+static char *fmt_u(unsigned long long n, char *p, int base)
+{
+	if (base == 10) {
+		while (n >= 100) {
+			unsigned r = n % 100;
+			n /= 100;
+			p -= 2;
+			memcpy(p, pairs + 2 * r, 2);
+		}
+		if (n >= 10) {
+			p -= 2;
+			memcpy(p, pairs + 2 * n, 2);
+		} else {
+			*--p = '0' + n;
+		}
+	} else if (!(base & (base - 1))) {
+		int shift = __builtin_ctz(base);
+		do
+			*--p = digits[n & (base - 1)];
+		while (n >>= shift);
+	} else {
+		do
+			*--p = digits[n % base];
+		while (n /= base);
+	}
+	return p;
+}
+
+static char *convert(unsigned long long n, int neg, char *s, int base)
 {
-	int i, sign;
-	if ((sign = n) < 0)
-		n = -n;
-	i = 0;
-	do {
-		s[i++] = n % base + '0';
-	} while ((n /= base) > 0);
-	if (sign < 0)
-		s[i++] = '-';
-	s[i] = '\0';
+	char tmp[66], *end = tmp + sizeof tmp, *p;
+
+	if (base < 2 || base > 36) {
+		*s = 0;
+		return s;
+	}
+	p = fmt_u(n, end, base);
+	if (neg)
+		*--p = '-';
+	memcpy(s, p, end - p);
+	s[end - p] = 0;
 	return s;
 }
 
+/* mask keeps negative values in other bases to the width of the type. */
+static char *convert_signed(long long n, unsigned long long mask, char *s,
+			    int base)
+{
+	if (base == 10 && n < 0)
+		return convert(-(unsigned long long)n, 1, s, base);
+	return convert((unsigned long long)n & mask, 0, s, base);
+}
+
+char *itoa(int n, char *s, int base)
+{
+	return convert_signed(n, UINT_MAX, s, base);
+}
+
+char *ltoa(long n, char *s, int base)
+{
+	return convert_signed(n, ULONG_MAX, s, base);
+}
+
+char *lltoa(long long n, char *s, int base)
+{
+	return convert_signed(n, ULLONG_MAX, s, base);
+}
+
 char *utoa(unsigned n, char *s, int base)
 {
-	int i;
-	i = 0;
-	do {
-		s[i++] = n % base + '0';
-	} while ((n /= base) > 0);
-	s[i] = '\0';
-	return s;
+	return convert(n, 0, s, base);
+}
+
+char *ultoa(unsigned long n, char *s, int base)
+{
+	return convert(n, 0, s, base);
+}
+
+char *ulltoa(unsigned long long n, char *s, int base)
+{
+	return convert(n, 0, s, base);
 }
@@ -0,0 +1,209 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "qnx_sched.h"
+#include "qnx_time.h"
+
+/*
+ * The system page. QNX programs read the CPU count, the CPU entries and
+ * the ClockCycles rate straight out of *_syspage_ptr through the
+ * SYSPAGE_ENTRY macros. Here it is one page of libc, filled once in
+ * _init_libc from what Linux says about the CPUs this process may run
+ * on, and then made read-only as it is on QNX. _syspage_ptr points at
+ * it from the start so that a program's copy of the pointer is valid
+ * even in code that runs before _init_libc.
+ *
+ * Only the entries the headers offer accessors for that mean something
+ * here are filled: cpuinfo, qtime and strings. The others are empty,
+ * which a reader sees as entry_size 0.
+ */
+
+#define MAX_CPU 64			/* QNX's own limit */
+#define CALIBRATE_NS 250000
+
+struct syspage_entry_info {
+	uint16_t entry_off;
+	uint16_t entry_size;
+};
+
+struct syspage_array_info {
+	uint32_t entry_off;
+	uint32_t entry_size;
+	uint32_t element_size;
+};
+
+struct syspage_entry {
+	uint16_t size;
+	uint16_t total_size;
+	uint16_t type;
+	uint16_t num_cpu;
+	struct syspage_entry_info system_private, old_asinfo, meminfo, hwinfo,
+		old_cpuinfo, old_cacheattr, qtime, callout, callin,
+		typed_strings, strings, old_intrinfo, smp, pminfo,
+		old_mdriver;
+	long spare0[1];
+	uint64_t un[20];		/* the architecture's entries, empty */
+	struct syspage_array_info asinfo, cpuinfo, cacheattr, intrinfo,
+		mdriver;
+};
+
+struct cpuinfo_entry {
+	uint32_t cpu;
+	uint32_t speed;			/* MHz */
+	uint32_t flags;
+	uint32_t smp_hwcoreid;
+	uint64_t idle_history;
+	uint64_t spare[1];
+	uint16_t name;			/* offset into strings */
+	uint8_t ins_cache;
+	uint8_t data_cache;
+};
+
+struct qtime_entry {
+	uint64_t cycles_per_sec;
+	volatile uint64_t nsec_tod_adjust;
+	volatile uint64_t nsec;
+	uint32_t nsec_inc;
+	uint32_t boot_time;		/* seconds since the epoch */
+	struct {
+		uint32_t tick_count;
+		int32_t tick_nsec_inc;
+	} adjust;
+	uint32_t timer_rate;
+	int32_t timer_scale;
+	uint32_t timer_load;
+	int32_t intr;
+	uint32_t epoch;
+	uint32_t flags;
+	uint32_t rr_interval_mul;
+	uint32_t spare0;
+	volatile uint64_t nsec_stable;
+	uint32_t spare[4];
+};
+
+#define ALIGN8(x) (((x) + 7) & ~7u)
+#define QTIME_OFF ALIGN8(sizeof(struct syspage_entry))
+#define STRINGS_OFF (QTIME_OFF + sizeof(struct qtime_entry))
+#define STRINGS_SIZE ALIGN8(sizeof QNX_CPU_NAME + 1)
+#define CPUINFO_OFF (STRINGS_OFF + STRINGS_SIZE)
+
+static union {
+	struct syspage_entry hdr;
+	unsigned char b[4096];
+} page __attribute__((aligned(4096)));
+
+typedef char page_fits[CPUINFO_OFF + MAX_CPU * sizeof(struct cpuinfo_entry)
+		       <= sizeof page ? 1 : -1];
+
+struct syspage_entry *_syspage_ptr = &page.hdr;
+
+static uint64_t cycles_per_sec;
+
+uint64_t __qnx_cycles_per_sec(void)
+{
+	return cycles_per_sec;
+}
+
+static uint64_t now(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* The counter against CLOCK_MONOTONIC_RAW, for a TSC nothing states the
+ * rate of. The result is rounded to 10 kHz, well above what a quarter
+ * millisecond can resolve. */
+static uint64_t calibrate(void)
+{
+	uint64_t t0, t1, c0, c1;
+
+	t0 = now(CLOCK_MONOTONIC_RAW);
+	c0 = qnx_cycles();
+	do t1 = now(CLOCK_MONOTONIC_RAW);
+	while (t1 - t0 < CALIBRATE_NS);
+	c1 = qnx_cycles();
+	return ((c1 - c0) * 100000 / (t1 - t0) + 5) / 10 * 10000;
+}
+
+/* A number from a sysfs file of CPU n, 0 if there is none. */
+static unsigned long cpu_value(int n, const char *file)
+{
+	char path[80], buf[24];
+	ssize_t len;
+	int fd;
+
+	snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d/%s", n, file);
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+		return 0;
+	len = read(fd, buf, sizeof buf - 1);
+	close(fd);
+	if (len <= 0)
+		return 0;
+	buf[len] = 0;
+	return strtoul(buf, 0, 10);
+}
+
+void __qnx_syspage_init(void)
+{
+	struct syspage_entry *h = &page.hdr;
+	struct qtime_entry *qt = (void *)(page.b + QTIME_OFF);
+	struct cpuinfo_entry *ci = (void *)(page.b + CPUINFO_OFF);
+	const unsigned short *map;
+	uint64_t mono, real;
+	unsigned long khz;
+	int n;
+
+	if (h->size)
+		return;
+	if (!(cycles_per_sec = qnx_cycles_per_sec()))
+		cycles_per_sec = calibrate();
+
+	if ((n = __qnx_cpus(&map)) <= 0) {
+		static const unsigned short cpu0;
+		map = &cpu0;
+		n = 1;
+	}
+	if (n > MAX_CPU)
+		n = MAX_CPU;
+	for (int i = 0; i < n; i++) {
+		khz = cpu_value(map[i], "cpufreq/cpuinfo_max_freq");
+		ci[i] = (struct cpuinfo_entry){
+			.cpu = i,
+			.speed = khz ? khz / 1000 : cycles_per_sec / 1000000,
+			.smp_hwcoreid = cpu_value(map[i], "topology/core_id"),
+			.name = 1,
+		};
+	}
+
+	mono = now(CLOCK_MONOTONIC);
+	real = now(CLOCK_REALTIME);
+	*qt = (struct qtime_entry){
+		.cycles_per_sec = cycles_per_sec,
+		.nsec_tod_adjust = real - mono,
+		.nsec = mono,
+		.nsec_inc = 1000000,
+		.boot_time = (real - mono) / 1000000000,
+		.nsec_stable = mono,
+	};
+	memcpy(page.b + STRINGS_OFF + 1, QNX_CPU_NAME, sizeof QNX_CPU_NAME);
+
+	h->type = QNX_SYSPAGE_TYPE;
+	h->num_cpu = n;
+	h->qtime = (struct syspage_entry_info){ QTIME_OFF, sizeof *qt };
+	h->strings = (struct syspage_entry_info){ STRINGS_OFF, STRINGS_SIZE };
+	h->old_cpuinfo = (struct syspage_entry_info){
+		CPUINFO_OFF, n * sizeof *ci
+	};
+	h->cpuinfo = (struct syspage_array_info){
+		CPUINFO_OFF, n * sizeof *ci, sizeof *ci
+	};
+	h->total_size = CPUINFO_OFF + n * sizeof *ci;
+	h->size = sizeof *h;
+	mprotect(page.b, sizeof page, PROT_READ);
+}
@@ -0,0 +1,66 @@
+/* Wrappers of LD_QNX_SHIMSTATS, see shimstats.c. A wrapper enters with
+ * %r11d holding its index and the caller's arguments untouched;
+ * __qnx_shim_enter returns the function to go on to and replaces the
+ * return address with __qnx_shim_return, which __qnx_shim_leave maps
+ * back to the one it replaced. */
+.text
+.global __qnx_shim_entry
+.hidden __qnx_shim_entry
+.type   __qnx_shim_entry,@function
+__qnx_shim_entry:
+	push %rax
+	push %rdi
+	push %rsi
+	push %rdx
+	push %rcx
+	push %r8
+	push %r9
+	sub $128,%rsp
+	movdqu %xmm0,(%rsp)
+	movdqu %xmm1,16(%rsp)
+	movdqu %xmm2,32(%rsp)
+	movdqu %xmm3,48(%rsp)
+	movdqu %xmm4,64(%rsp)
+	movdqu %xmm5,80(%rsp)
+	movdqu %xmm6,96(%rsp)
+	movdqu %xmm7,112(%rsp)
+	mov %r11d,%edi
+	lea 184(%rsp),%rsi
+	call __qnx_shim_enter
+	mov %rax,%r11
+	movdqu (%rsp),%xmm0
+	movdqu 16(%rsp),%xmm1
+	movdqu 32(%rsp),%xmm2
+	movdqu 48(%rsp),%xmm3
+	movdqu 64(%rsp),%xmm4
+	movdqu 80(%rsp),%xmm5
+	movdqu 96(%rsp),%xmm6
+	movdqu 112(%rsp),%xmm7
+	add $128,%rsp
+	pop %r9
+	pop %r8
+	pop %rcx
+	pop %rdx
+	pop %rsi
+	pop %rdi
+	pop %rax
+	jmp *%r11
+
+.global __qnx_shim_return
+.hidden __qnx_shim_return
+.type   __qnx_shim_return,@function
+__qnx_shim_return:
+	push %rax
+	push %rdx
+	sub $32,%rsp
+	movdqu %xmm0,(%rsp)
+	movdqu %xmm1,16(%rsp)
+	lea 40(%rsp),%rdi
+	call __qnx_shim_leave
+	mov %rax,%r11
+	movdqu (%rsp),%xmm0
+	movdqu 16(%rsp),%xmm1
+	add $32,%rsp
+	pop %rdx
+	pop %rax
+	jmp *%r11
@@ -0,0 +1,125 @@
+#include "stdio_impl.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "libc.h"
+#include "qnx_stdio.h"
+
+/* QNX_STDIO_MMAP: fopen maps read-only opens of regular files of at
+ * least that many bytes, never of ones smaller than a buffer. From the
+ * first read on, the rest of the mapping is the read buffer, so fread
+ * is one memcpy out of it and getc never leaves the macro. The file
+ * must not shrink while it is open: reading past its new end is
+ * SIGBUS. */
+
+static size_t map_min;
+
+struct map {
+	unsigned char *data;
+	size_t size, pos;
+};
+
+/* buf only holds what ungetc pushes back. */
+struct map_FILE {
+	FILE f;
+	struct map m;
+	unsigned char buf[UNGET];
+};
+
+/* m->pos is the file offset of f->rend. */
+static size_t map_read(FILE *f, unsigned char *buf, size_t len)
+{
+	struct map *m = f->cookie;
+	size_t rem = m->pos < m->size ? m->size - m->pos : 0;
+
+	if (!rem) {
+		f->flags |= F_EOF;
+		return 0;
+	}
+	if (len > rem) len = rem;
+	memcpy(buf, m->data + m->pos, len);
+	f->rpos = m->data + m->pos + len;
+	f->rend = m->data + m->size;
+	m->pos = m->size;
+	return len;
+}
+
+static off_t map_seek(FILE *f, off_t off, int whence)
+{
+	struct map *m = f->cookie;
+	off_t base = whence == SEEK_SET ? 0 : whence == SEEK_CUR ? m->pos : m->size;
+
+	if (whence > 2U || off < -base) {
+		errno = EINVAL;
+		return -1;
+	}
+	return m->pos = base + off;
+}
+
+static int map_close(FILE *f)
+{
+	struct map *m = f->cookie;
+
+	__munmap(m->data, m->size);
+	return __stdio_close(f);
+}
+
+/* getdelim and the scanf family put back the byte they just read, which
+ * only needs the mapping writable, but ungetc may put back another one,
+ * and the data must still be there after a seek back. So ungetc first
+ * gives up the rest of the mapping, to have its bytes in buf. */
+void __fmap_unget(FILE *f)
+{
+	struct map *m = f->cookie;
+
+	if ((uintptr_t)f->rpos - (uintptr_t)m->data > m->size) return;
+	m->pos -= f->rend - f->rpos;
+	f->rpos = f->rend = f->buf;
+}
+
+FILE *__fopen_map(int fd, const char *mode)
+{
+	struct map_FILE *mf;
+	struct stat st;
+	void *data;
+
+	if (!map_min || *mode != 'r' || strchr(mode, '+')) return 0;
+	if (__fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size < map_min)
+		return 0;
+	data = __mmap(0, st.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED) return 0;
+	if (!(mf = malloc(sizeof *mf))) {
+		__munmap(data, st.st_size);
+		return 0;
+	}
+	memset(&mf->f, 0, sizeof mf->f);
+	mf->m.data = data;
+	mf->m.size = st.st_size;
+	mf->m.pos = 0;
+
+	mf->f.flags = F_NOWR | F_MAP;
+	mf->f.fd = fd;
+	mf->f.buf = mf->buf + UNGET;
+	mf->f.lbf = EOF;
+	mf->f.cookie = &mf->m;
+	mf->f.read = map_read;
+	mf->f.write = __stdio_write;
+	mf->f.seek = map_seek;
+	mf->f.close = map_close;
+
+	if (!libc.threaded) mf->f.lock = -1;
+
+	return __ofl_add(&mf->f);
+}
+
+void __qnx_stdio_init(void)
+{
+	const char *s = getenv("QNX_STDIO_MMAP");
+
+	if (!s || !*s) return;
+	map_min = strtoull(s, 0, 10);
+	if (map_min < BUFSIZ) map_min = BUFSIZ;
+}
@@ -1,11 +1,71 @@
 #include "stdio_impl.h"
 #include "pthread_impl.h"
+#include "qnx_stdio.h"
+#include <sys/membarrier.h>
+
+/* Makes f biased to tid if no thread has it yet, or revokes the bias of
+ * the thread that has; returns whether f is now biased to tid. */
+int __stdio_bias(FILE *f, int tid)
+{
+	int b, h;
+
+	for (;;) {
+		b = f->bias;
+		if (b == tid) return 1;
+		if (b == -1) return 0;
+		if (b == -2) {
+			__futexwait(&f->bias, -2, 1);
+			continue;
+		}
+		if (a_cas(&f->bias, b, b ? -2 : tid) == b) break;
+	}
+	if (!b) return 1;
+
+	/* After the barrier the owner either sees the revocation or has
+	 * its bias_held store visible here. */
+	__membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+	while ((h = f->bias_held))
+		__futexwait(&f->bias_held, h, 1);
+	a_store(&f->bias, -1);
+	__wake(&f->bias, -1, 1);
+	return 0;
+}
+
+/* As __stdio_bias, for ftrylockfile: never waits, and returns -1 if
+ * it would, leaving a bias whose owner holds the FILE in place. */
+int __stdio_bias_try(FILE *f, int tid)
+{
+	int b = f->bias;
+
+	if (b == tid || b == -1) return b == tid;
+	if (b == -2 || b && f->bias_held) return -1;
+	if (a_cas(&f->bias, b, b ? -2 : tid) != b) return -1;
+	if (!b) return 1;
+
+	__membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+	if (f->bias_held) {
+		/* The owner got in first; give it its bias back. */
+		a_store(&f->bias, b);
+		__wake(&f->bias, -1, 1);
+		return -1;
+	}
+	a_store(&f->bias, -1);
+	__wake(&f->bias, -1, 1);
+	return 0;
+}
+
+void __stdio_bias_wake(FILE *f)
+{
+	__wake(&f->bias_held, 1, 1);
+}
 
 int __lockfile(FILE *f)
 {
 	int owner = f->lock, tid = __pthread_self()->tid;
-	if ((owner & ~MAYBE_WAITERS) == tid)
+	if ((owner & ~MAYBE_WAITERS) == tid || f->bias_held == tid)
 		return 0;
+	if (__bias_lock(f, tid) || __stdio_bias(f, tid) && __bias_lock(f, tid))
+		return 1;
 	owner = a_cas(&f->lock, 0, tid);
 	if (!owner) return 1;
 	while ((owner = a_cas(&f->lock, 0, tid|MAYBE_WAITERS))) {
@@ -18,6 +78,10 @@ int __lockfile(FILE *f)
 
 void __unlockfile(FILE *f)
 {
+	if (f->bias_held && f->bias_held == __pthread_self()->tid) {
+		__bias_unlock(f);
+		return;
+	}
 	if (a_swap(&f->lock, 0) & MAYBE_WAITERS)
 		__wake(&f->lock, 1, 1);
 }
@@ -1,5 +1,6 @@
 #include "stdio_impl.h"
 #include "aio_impl.h"
+#include "qnx_fd.h"
 
 static int dummy(int fd)
 {
@@ -8,7 +9,15 @@ static int dummy(int fd)
 
 weak_alias(dummy, __aio_close);
 
+static void dummy_fd(int fd)
+{
+}
+
+weak_alias(dummy_fd, __qnx_fd_replaced);
+
 int __stdio_close(FILE *f)
 {
-	return syscall(SYS_close, __aio_close(f->fd));
+	int r = syscall(SYS_close, __aio_close(f->fd));
+	if (!r) __qnx_fd_replaced(f->fd);
+	return r;
 }
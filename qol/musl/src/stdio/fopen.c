@@ -2,8 +2,11 @@
 #include <fcntl.h>
 #include <string.h>
 #include <errno.h>
+#include "qnx_stdio.h"
 
-FILE *fopen(const char *restrict filename, const char *restrict mode)
+/* freopen passes 0 for map: it takes over the new FILE's ops, not its
+ * buffer. */
+FILE *__fopen(const char *restrict filename, const char *restrict mode, int map)
 {
 	FILE *f;
 	int fd;
@@ -23,9 +26,15 @@ FILE *fopen(const char *restrict filename, const char *restrict mode)
 	if (flags & O_CLOEXEC)
 		__syscall(SYS_fcntl, fd, F_SETFD, FD_CLOEXEC);
 
+	if (map && (f = __fopen_map(fd, mode))) return f;
 	f = __fdopen(fd, mode);
 	if (f) return f;
 
 	__syscall(SYS_close, fd);
 	return 0;
 }
+
+FILE *fopen(const char *restrict filename, const char *restrict mode)
+{
+	return __fopen(filename, mode, 1);
+}
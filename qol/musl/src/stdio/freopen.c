@@ -26,7 +26,7 @@ FILE *freopen(const char *restrict filename, const char *restrict mode, FILE *re
 		if (syscall(SYS_fcntl, f->fd, F_SETFL, fl) < 0)
 			goto fail;
 	} else {
-		f2 = fopen(filename, mode);
+		f2 = __fopen(filename, mode, 0);
 		if (!f2) goto fail;
 		if (f2->fd == f->fd) f2->fd = -1; /* avoid closing in fclose */
 		else if (__dup3(f2->fd, f->fd, fl&O_CLOEXEC)<0) goto fail2;
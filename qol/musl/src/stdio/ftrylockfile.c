@@ -1,5 +1,6 @@
 #include "stdio_impl.h"
 #include "pthread_impl.h"
+#include "qnx_stdio.h"
 #include <limits.h>
 
 void __do_orphaned_stdio_locks()
@@ -39,7 +40,8 @@ int ftrylockfile(FILE *f)
 		return 0;
 	}
 	if (owner < 0) f->lock = owner = 0;
-	if (owner || a_cas(&f->lock, 0, tid))
+	/* A bias of another thread would let it in without f->lock. */
+	if (owner || __stdio_bias_try(f, tid) < 0 || a_cas(&f->lock, 0, tid))
 		return -1;
 	__register_locked_file(f, self);
 	return 0;
@@ -1,13 +1,20 @@
 #include "stdio_impl.h"
 #include "pthread_impl.h"
+#include "qnx_stdio.h"
 
 #ifdef __GNUC__
 __attribute__((__noinline__))
 #endif
 static int locking_getc(FILE *f)
 {
+	int tid = __pthread_self()->tid, c;
+	if (__bias_lock(f, tid) || __stdio_bias(f, tid) && __bias_lock(f, tid)) {
+		c = getc_unlocked(f);
+		__bias_unlock(f);
+		return c;
+	}
 	if (a_cas(&f->lock, 0, MAYBE_WAITERS-1)) __lockfile(f);
-	int c = getc_unlocked(f);
+	c = getc_unlocked(f);
 	if (a_swap(&f->lock, 0) & MAYBE_WAITERS)
 		__wake(&f->lock, 1, 1);
 	return c;
@@ -1,11 +1,18 @@
 #include "stdio_impl.h"
 #include "pthread_impl.h"
+#include "qnx_stdio.h"
 
 #ifdef __GNUC__
 __attribute__((__noinline__))
 #endif
 static int locking_putc(int c, FILE *f)
 {
+	int tid = __pthread_self()->tid;
+	if (__bias_lock(f, tid) || __stdio_bias(f, tid) && __bias_lock(f, tid)) {
+		c = putc_unlocked(c, f);
+		__bias_unlock(f);
+		return c;
+	}
 	if (a_cas(&f->lock, 0, MAYBE_WAITERS-1)) __lockfile(f);
 	c = putc_unlocked(c, f);
 	if (a_swap(&f->lock, 0) & MAYBE_WAITERS)
@@ -1,4 +1,5 @@
 #include "stdio_impl.h"
+#include "qnx_stdio.h"
 
 int ungetc(int c, FILE *f)
 {
@@ -7,6 +8,7 @@ int ungetc(int c, FILE *f)
 	FLOCK(f);
 
 	if (!f->rpos) __toread(f);
+	if (f->flags & F_MAP) __fmap_unget(f);
 	if (!f->rpos || f->rpos <= f->buf - UNGET) {
 		FUNLOCK(f);
 		return EOF;
@@ -1,4 +1,5 @@
 #include "stdio_impl.h"
+#include "qnx_stdio.h"
 #include "locale_impl.h"
 #include <wchar.h>
 #include <limits.h>
@@ -17,6 +18,7 @@ wint_t ungetwc(wint_t c, FILE *f)
 	*ploc = f->locale;
 
 	if (!f->rpos) __toread(f);
+	if (f->flags & F_MAP) __fmap_unget(f);
 	if (!f->rpos || c == WEOF || (l = wcrtomb((void *)mbc, c, 0)) < 0 ||
 	    f->rpos < f->buf - UNGET + l) {
 		FUNLOCK(f);
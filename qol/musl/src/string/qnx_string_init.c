@@ -0,0 +1,6 @@
+#include "qnx_string.h"
+
+/* Archs with one version of each string function have nothing to pick. */
+void __qnx_string_init(void)
+{
+}
@@ -0,0 +1,50 @@
+#include <string.h>
+#include <stdint.h>
+#include "qnx_string.h"
+
+/* As in strlen, loads are aligned and the bytes before src masked off;
+ * a match past the end of the range only counts as none. Nothing is
+ * read for an empty range. */
+
+typedef char v16 __attribute__((__vector_size__(16), __may_alias__));
+typedef char v32 __attribute__((__vector_size__(32), __may_alias__));
+
+hidden void *__memchr_sse2(const void *src, int c, size_t n)
+{
+	uintptr_t a = (uintptr_t)src & 15;
+	const v16 *p = (const void *)((uintptr_t)src - a);
+	v16 k = (v16){0} + (char)c;
+	size_t left = n + a < n ? SIZE_MAX : n + a;
+	unsigned m;
+
+	if (!n) return 0;
+	m = __builtin_ia32_pmovmskb128(*p == k) & -1U << a;
+	for (; !m; m = __builtin_ia32_pmovmskb128(*++p == k)) {
+		if (left <= 16) return 0;
+		left -= 16;
+	}
+	return (size_t)__builtin_ctz(m) < left ? (char *)p + __builtin_ctz(m) : 0;
+}
+
+__attribute__((__target__("avx2")))
+hidden void *__memchr_avx2(const void *src, int c, size_t n)
+{
+	uintptr_t a = (uintptr_t)src & 31;
+	const v32 *p = (const void *)((uintptr_t)src - a);
+	v32 k = (v32){0} + (char)c;
+	size_t left = n + a < n ? SIZE_MAX : n + a;
+	unsigned m;
+
+	if (!n) return 0;
+	m = __builtin_ia32_pmovmskb256(*p == k) & -1U << a;
+	for (; !m; m = __builtin_ia32_pmovmskb256(*++p == k)) {
+		if (left <= 32) return 0;
+		left -= 32;
+	}
+	return (size_t)__builtin_ctz(m) < left ? (char *)p + __builtin_ctz(m) : 0;
+}
+
+void *memchr(const void *src, int c, size_t n)
+{
+	return __qnx_string.memchr(src, c, n);
+}
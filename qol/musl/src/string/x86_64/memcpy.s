@@ -1,8 +1,14 @@
 .global memcpy
 .global __memcpy_fwd
 .hidden __memcpy_fwd
+.global __memcpy_avx2
+.hidden __memcpy_avx2
+.hidden __qnx_string
 .type memcpy,@function
 memcpy:
+	jmp *__qnx_string(%rip)
+
+.type __memcpy_fwd,@function
 __memcpy_fwd:
 	mov %rdi,%rax
 	cmp $8,%rdx
@@ -23,3 +29,107 @@ __memcpy_fwd:
 	dec %edx
 	jnz 2b
 1:	ret
+
+.type __memcpy_avx2,@function
+__memcpy_avx2:
+	mov %rdi,%rax
+	cmp $32,%rdx
+	jb 3f
+	cmp $64,%rdx
+	ja 1f
+	vmovdqu (%rsi),%ymm0
+	vmovdqu -32(%rsi,%rdx),%ymm1
+	vmovdqu %ymm0,(%rdi)
+	vmovdqu %ymm1,-32(%rdi,%rdx)
+	vzeroupper
+	ret
+
+	# The first and last 32 bytes go unaligned, after the loop, the
+	# middle in aligned stores.
+1:	vmovdqu (%rsi),%ymm4
+	vmovdqu -32(%rsi,%rdx),%ymm5
+	lea -32(%rdi,%rdx),%r8
+	mov %edi,%ecx
+	and $31,%ecx
+	sub $32,%rcx
+	sub %rcx,%rsi
+	sub %rcx,%rdi
+	add %rcx,%rdx
+	cmp __qnx_string+40(%rip),%rdx
+	jae 2f
+
+1:	cmp $128,%rdx
+	jb 4f
+	vmovdqu (%rsi),%ymm0
+	vmovdqu 32(%rsi),%ymm1
+	vmovdqu 64(%rsi),%ymm2
+	vmovdqu 96(%rsi),%ymm3
+	vmovdqa %ymm0,(%rdi)
+	vmovdqa %ymm1,32(%rdi)
+	vmovdqa %ymm2,64(%rdi)
+	vmovdqa %ymm3,96(%rdi)
+	sub $-128,%rsi
+	sub $-128,%rdi
+	add $-128,%rdx
+	jmp 1b
+4:	cmp $32,%rdx
+	jbe 1f
+	vmovdqu (%rsi),%ymm0
+	vmovdqa %ymm0,(%rdi)
+	add $32,%rsi
+	add $32,%rdi
+	sub $32,%rdx
+	jmp 4b
+1:	vmovdqu %ymm4,(%rax)
+	vmovdqu %ymm5,(%r8)
+	vzeroupper
+	ret
+
+2:	vmovdqu (%rsi),%ymm0
+	vmovdqu 32(%rsi),%ymm1
+	vmovdqu 64(%rsi),%ymm2
+	vmovdqu 96(%rsi),%ymm3
+	vmovntdq %ymm0,(%rdi)
+	vmovntdq %ymm1,32(%rdi)
+	vmovntdq %ymm2,64(%rdi)
+	vmovntdq %ymm3,96(%rdi)
+	sub $-128,%rsi
+	sub $-128,%rdi
+	add $-128,%rdx
+	cmp $128,%rdx
+	jae 2b
+	sfence
+	jmp 4b
+
+3:	cmp $16,%edx
+	jb 1f
+	vmovdqu (%rsi),%xmm0
+	vmovdqu -16(%rsi,%rdx),%xmm1
+	vmovdqu %xmm0,(%rdi)
+	vmovdqu %xmm1,-16(%rdi,%rdx)
+	ret
+1:	cmp $8,%edx
+	jb 1f
+	mov (%rsi),%rcx
+	mov -8(%rsi,%rdx),%r8
+	mov %rcx,(%rdi)
+	mov %r8,-8(%rdi,%rdx)
+	ret
+1:	cmp $4,%edx
+	jb 1f
+	mov (%rsi),%ecx
+	mov -4(%rsi,%rdx),%r8d
+	mov %ecx,(%rdi)
+	mov %r8d,-4(%rdi,%rdx)
+	ret
+1:	test %edx,%edx
+	jz 1f
+	mov %edx,%r9d
+	shr %r9d
+	movzbl (%rsi),%ecx
+	movzbl (%rsi,%r9),%r10d
+	movzbl -1(%rsi,%rdx),%r8d
+	mov %cl,(%rdi)
+	mov %r10b,(%rdi,%r9)
+	mov %r8b,-1(%rdi,%rdx)
+1:	ret
@@ -1,6 +1,15 @@
 .global memset
+.global __memset_rep
+.hidden __memset_rep
+.global __memset_avx2
+.hidden __memset_avx2
+.hidden __qnx_string
 .type memset,@function
 memset:
+	jmp *__qnx_string+8(%rip)
+
+.type __memset_rep,@function
+__memset_rep:
 	movzbq %sil,%rax
 	mov $0x101010101010101,%r8
 	imul %r8,%rax
@@ -70,3 +79,79 @@ memset:
 	sub %rdx,%rcx
 	add %rdx,%rdi
 	jmp 1b
+
+.type __memset_avx2,@function
+__memset_avx2:
+	mov %rdi,%rax
+	movzbl %sil,%ecx
+	mov $0x101010101010101,%r8
+	imul %r8,%rcx
+	cmp $32,%rdx
+	jb 3f
+	vmovq %rcx,%xmm0
+	vpbroadcastq %xmm0,%ymm0
+	vmovdqu %ymm0,(%rdi)
+	vmovdqu %ymm0,-32(%rdi,%rdx)
+	cmp $64,%rdx
+	jbe 1f
+
+	lea (%rdi,%rdx),%r8
+	add $32,%rdi
+	and $-32,%rdi
+	sub %rdi,%r8
+	cmp __qnx_string+40(%rip),%rdx
+	jae 2f
+4:	cmp $128,%r8
+	jb 4f
+	vmovdqa %ymm0,(%rdi)
+	vmovdqa %ymm0,32(%rdi)
+	vmovdqa %ymm0,64(%rdi)
+	vmovdqa %ymm0,96(%rdi)
+	sub $-128,%rdi
+	add $-128,%r8
+	jmp 4b
+4:	cmp $32,%r8
+	jbe 1f
+	vmovdqa %ymm0,(%rdi)
+	add $32,%rdi
+	sub $32,%r8
+	jmp 4b
+1:	vzeroupper
+	ret
+
+2:	vmovntdq %ymm0,(%rdi)
+	vmovntdq %ymm0,32(%rdi)
+	vmovntdq %ymm0,64(%rdi)
+	vmovntdq %ymm0,96(%rdi)
+	sub $-128,%rdi
+	add $-128,%r8
+	cmp $128,%r8
+	jae 2b
+	sfence
+	jmp 4b
+
+3:	cmp $16,%edx
+	jb 1f
+	vmovq %rcx,%xmm0
+	vpunpcklqdq %xmm0,%xmm0,%xmm0
+	vmovdqu %xmm0,(%rdi)
+	vmovdqu %xmm0,-16(%rdi,%rdx)
+	ret
+1:	cmp $8,%edx
+	jb 1f
+	mov %rcx,(%rdi)
+	mov %rcx,-8(%rdi,%rdx)
+	ret
+1:	cmp $4,%edx
+	jb 1f
+	mov %ecx,(%rdi)
+	mov %ecx,-4(%rdi,%rdx)
+	ret
+1:	test %edx,%edx
+	jz 1f
+	mov %cl,(%rdi)
+	mov %cl,-1(%rdi,%rdx)
+	cmp $2,%edx
+	jbe 1f
+	mov %cl,1(%rdi)
+1:	ret
@@ -0,0 +1,82 @@
+#include <stdint.h>
+#include <string.h>
+#include "qnx_string.h"
+
+hidden void *__memcpy_fwd(void *restrict, const void *restrict, size_t);
+hidden void *__memcpy_avx2(void *restrict, const void *restrict, size_t);
+hidden void *__memset_rep(void *, int, size_t);
+hidden void *__memset_avx2(void *, int, size_t);
+hidden void *__memchr_sse2(const void *, int, size_t);
+hidden void *__memchr_avx2(const void *, int, size_t);
+hidden size_t __strlen_sse2(const char *);
+hidden size_t __strlen_avx2(const char *);
+hidden int __strcmp_sse2(const char *, const char *);
+hidden int __strcmp_avx2(const char *, const char *);
+
+struct qnx_string __qnx_string = {
+	.memcpy = __memcpy_fwd,
+	.memset = __memset_rep,
+	.memchr = __memchr_sse2,
+	.strlen = __strlen_sse2,
+	.strcmp = __strcmp_sse2,
+	.nt_threshold = SIZE_MAX,
+};
+
+static void cpuid(unsigned leaf, unsigned sub, unsigned r[4])
+{
+	__asm__ ("cpuid" : "=a"(r[0]), "=b"(r[1]), "=c"(r[2]), "=d"(r[3])
+		: "a"(leaf), "c"(sub));
+}
+
+/* Size of the largest cache, from the deterministic cache parameters
+ * leaf, which Intel and AMD lay out the same way; 0 if there is none. */
+static size_t last_level_cache(void)
+{
+	unsigned r[4], leaf, i;
+	size_t size, max = 0;
+
+	cpuid(0, 0, r);
+	if (r[1] == 0x756e6547 && r[0] >= 4) { /* "Genu"ineIntel */
+		leaf = 4;
+	} else {
+		cpuid(0x80000000, 0, r);
+		if (r[0] < 0x8000001d) return 0;
+		cpuid(0x80000001, 0, r);
+		if (!(r[2] & 1<<22)) return 0;
+		leaf = 0x8000001d;
+	}
+	for (i = 0; i < 16; i++) {
+		cpuid(leaf, i, r);
+		if (!(r[0] & 31)) break;
+		size = (size_t)((r[1] >> 22) + 1) * ((r[1] >> 12 & 1023) + 1)
+			* ((r[1] & 4095) + 1) * ((size_t)r[2] + 1);
+		if (size > max) max = size;
+	}
+	return max;
+}
+
+void __qnx_string_init(void)
+{
+	unsigned r[4], lo, hi;
+	size_t llc;
+
+	cpuid(0, 0, r);
+	if (r[0] < 7) return;
+	/* AVX needs the OS to save the ymm state: OSXSAVE, then XCR0. */
+	cpuid(1, 0, r);
+	if ((r[2] & (1<<27 | 1<<28)) != (1<<27 | 1<<28)) return;
+	__asm__ ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	if ((lo & 6) != 6) return;
+	cpuid(7, 0, r);
+	if (!(r[1] & 1<<5)) return;
+
+	__qnx_string.memcpy = __memcpy_avx2;
+	__qnx_string.memset = __memset_avx2;
+	__qnx_string.memchr = __memchr_avx2;
+	__qnx_string.strlen = __strlen_avx2;
+	__qnx_string.strcmp = __strcmp_avx2;
+	/* What does not fit in most of the cache would only evict what
+	 * the caller still needs from it. */
+	if ((llc = last_level_cache()))
+		__qnx_string.nt_threshold = llc / 4 * 3;
+}
@@ -0,0 +1,62 @@
+#include <string.h>
+#include <stdint.h>
+#include "qnx_string.h"
+
+/* The strings are rarely aligned alike, so loads are unaligned, and a
+ * block that would reach into the next page of either string is done
+ * bytewise instead. */
+
+#define PAGE 4096
+
+typedef char v16 __attribute__((__vector_size__(16), __may_alias__, __aligned__(1)));
+typedef char v32 __attribute__((__vector_size__(32), __may_alias__, __aligned__(1)));
+
+static int crosses(const char *l, const char *r, size_t n)
+{
+	return ((uintptr_t)l & PAGE-1) > PAGE-n || ((uintptr_t)r & PAGE-1) > PAGE-n;
+}
+
+static int diff(const char *l, const char *r, size_t i)
+{
+	return (unsigned char)l[i] - (unsigned char)r[i];
+}
+
+hidden int __strcmp_sse2(const char *l, const char *r)
+{
+	unsigned m;
+	size_t i;
+
+	for (;; l += 16, r += 16) {
+		if (crosses(l, r, 16)) {
+			for (i = 0; i < 16; i++)
+				if (l[i] != r[i] || !l[i]) return diff(l, r, i);
+			continue;
+		}
+		v16 a = *(const v16 *)l, b = *(const v16 *)r;
+		if ((m = __builtin_ia32_pmovmskb128((a != b) | (a == (v16){0}))))
+			return diff(l, r, __builtin_ctz(m));
+	}
+}
+
+__attribute__((__target__("avx2")))
+hidden int __strcmp_avx2(const char *l, const char *r)
+{
+	unsigned m;
+	size_t i;
+
+	for (;; l += 32, r += 32) {
+		if (crosses(l, r, 32)) {
+			for (i = 0; i < 32; i++)
+				if (l[i] != r[i] || !l[i]) return diff(l, r, i);
+			continue;
+		}
+		v32 a = *(const v32 *)l, b = *(const v32 *)r;
+		if ((m = __builtin_ia32_pmovmskb256((a != b) | (a == (v32){0}))))
+			return diff(l, r, __builtin_ctz(m));
+	}
+}
+
+int strcmp(const char *l, const char *r)
+{
+	return __qnx_string.strcmp(l, r);
+}
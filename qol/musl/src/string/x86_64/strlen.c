@@ -0,0 +1,35 @@
+#include <string.h>
+#include <stdint.h>
+#include "qnx_string.h"
+
+/* Aligned vector loads never cross into a page the string does not
+ * reach into; the bytes before s in the first one are masked off. */
+
+typedef char v16 __attribute__((__vector_size__(16), __may_alias__));
+typedef char v32 __attribute__((__vector_size__(32), __may_alias__));
+
+hidden size_t __strlen_sse2(const char *s)
+{
+	const v16 *p = (const void *)((uintptr_t)s & -16);
+	unsigned m = __builtin_ia32_pmovmskb128(*p == (v16){0});
+
+	for (m &= -1U << ((uintptr_t)s & 15); !m;
+	     m = __builtin_ia32_pmovmskb128(*++p == (v16){0}));
+	return (const char *)p + __builtin_ctz(m) - s;
+}
+
+__attribute__((__target__("avx2")))
+hidden size_t __strlen_avx2(const char *s)
+{
+	const v32 *p = (const void *)((uintptr_t)s & -32);
+	unsigned m = __builtin_ia32_pmovmskb256(*p == (v32){0});
+
+	for (m &= -1U << ((uintptr_t)s & 31); !m;
+	     m = __builtin_ia32_pmovmskb256(*++p == (v32){0}));
+	return (const char *)p + __builtin_ctz(m) - s;
+}
+
+size_t strlen(const char *s)
+{
+	return __qnx_string.strlen(s);
+}
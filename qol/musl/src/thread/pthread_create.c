@@ -3,6 +3,7 @@
 #include "stdio_impl.h"
 #include "libc.h"
 #include "lock.h"
+#include "fork_impl.h"
 #include <sys/mman.h>
 #include <string.h>
 #include <stddef.h>
@@ -15,8 +16,71 @@ weak_alias(dummy_0, __release_ptc);
 weak_alias(dummy_0, __pthread_tsd_run_dtors);
 weak_alias(dummy_0, __do_orphaned_stdio_locks);
 weak_alias(dummy_0, __dl_thread_cleanup);
+weak_alias(dummy_0, __malloc_thread_exit);
+weak_alias(dummy_0, __qnx_shimstats_thread_exit);
+weak_alias(dummy_0, __qnx_stats_thread_exit);
 weak_alias(dummy_0, __membarrier_init);
 
+/*
+ * Stacks of threads that have gone, kept for new threads that need a
+ * mapping of the same size and guard, so that a process creating and
+ * joining short-lived threads stops mapping and unmapping one each
+ * time. The oldest of MAP_CACHE goes when a new one comes in. A
+ * detached thread files its own mapping on the way out, while it still
+ * holds the thread list lock, which the kernel only releases once the
+ * thread is gone: a mapping taken from the cache is used after that
+ * lock has been seen free.
+ */
+#define MAP_CACHE 16
+#define MAP_CACHE_MAX (8 << 20)
+
+static struct {
+	unsigned char *base;
+	size_t size, guard;
+} map_cache[MAP_CACHE];
+static int map_cached;
+static volatile int map_cache_lock[1];
+volatile int *const __map_cache_lockptr = map_cache_lock;
+
+int __thread_map_put(void *base, size_t size, size_t guard)
+{
+	void *old = 0;
+	size_t old_size;
+
+	if (size > MAP_CACHE_MAX) return 0;
+	LOCK(map_cache_lock);
+	if (map_cached == MAP_CACHE) {
+		old = map_cache[0].base;
+		old_size = map_cache[0].size;
+		memmove(map_cache, map_cache+1, --map_cached * sizeof *map_cache);
+	}
+	map_cache[map_cached].base = base;
+	map_cache[map_cached].size = size;
+	map_cache[map_cached].guard = guard;
+	map_cached++;
+	UNLOCK(map_cache_lock);
+	if (old) __munmap(old, old_size);
+	return 1;
+}
+
+static unsigned char *map_get(size_t size, size_t guard)
+{
+	unsigned char *map = 0;
+	int i;
+
+	LOCK(map_cache_lock);
+	for (i = map_cached; i--; ) {
+		if (map_cache[i].size == size && map_cache[i].guard == guard) {
+			map = map_cache[i].base;
+			memmove(map_cache+i, map_cache+i+1,
+				(--map_cached - i) * sizeof *map_cache);
+			break;
+		}
+	}
+	UNLOCK(map_cache_lock);
+	return map;
+}
+
 static int tl_lock_count;
 static int tl_lock_waiters;
 
@@ -138,6 +202,13 @@ _Noreturn void __pthread_exit(void *result)
 
 	__do_orphaned_stdio_locks();
 	__dl_thread_cleanup();
+	__malloc_thread_exit();
+	__qnx_shimstats_thread_exit();
+	__qnx_stats_thread_exit();
+
+	/* Filed while the locks still count, before the unlink below. */
+	int cached = state==DT_DETACHED && self->map_base &&
+		__thread_map_put(self->map_base, self->map_size, self->guard_size);
 
 	/* Last, unlink thread from the list. This change will not be visible
 	 * until the lock is released, which only happens after SYS_exit
@@ -160,6 +231,10 @@ _Noreturn void __pthread_exit(void *result)
 		if (self->robust_list.off)
 			__syscall(SYS_set_robust_list, 0, 3*sizeof(long));
 
+		/* The stack stays mapped for the next thread. */
+		if (cached)
+			for (;;) __syscall(SYS_exit, 0);
+
 		/* The following call unmaps the thread's stack mapping
 		 * and then exits without touching the stack. */
 		__unmapself(self->map_base, self->map_size);
@@ -291,7 +366,12 @@ int __pthread_create(pthread_t *restrict res, const pthread_attr_t *restrict att
 	}
 
 	if (!tsd) {
-		if (guard) {
+		if ((map = map_get(size, guard))) {
+			/* The thread that had it may still be leaving. */
+			__tl_sync(0);
+			memset(map + size - libc.tls_size - __pthread_tsd_size,
+				0, libc.tls_size + __pthread_tsd_size);
+		} else if (guard) {
 			map = __mmap(0, size, PROT_NONE, MAP_PRIVATE|MAP_ANON, -1, 0);
 			if (map == MAP_FAILED) goto fail;
 			if (__mprotect(map+guard, size-guard, PROT_READ|PROT_WRITE)
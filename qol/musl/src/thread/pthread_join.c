@@ -7,6 +7,12 @@ static void dummy1(pthread_t t)
 }
 weak_alias(dummy1, __tl_sync);
 
+static int dummy2(void *base, size_t size, size_t guard)
+{
+	return 0;
+}
+weak_alias(dummy2, __thread_map_put);
+
 static int __pthread_timedjoin_np(pthread_t t, void **res, const struct timespec *at)
 {
 	int state, cs, r = 0;
@@ -21,7 +27,8 @@ static int __pthread_timedjoin_np(pthread_t t, void **res, const struct timespec
 	if (r == ETIMEDOUT || r == EINVAL) return r;
 	__tl_sync(t);
 	if (res) *res = t->result;
-	if (t->map_base) __munmap(t->map_base, t->map_size);
+	if (t->map_base && !__thread_map_put(t->map_base, t->map_size, t->guard_size))
+		__munmap(t->map_base, t->map_size);
 	return 0;
 }
 
@@ -2,6 +2,7 @@
 #include <errno.h>
 #include "aio_impl.h"
 #include "syscall.h"
+#include "qnx_fd.h"
 
 static int dummy(int fd)
 {
@@ -10,10 +11,17 @@ static int dummy(int fd)
 
 weak_alias(dummy, __aio_close);
 
+static void dummy_fd(int fd)
+{
+}
+
+weak_alias(dummy_fd, __qnx_fd_replaced);
+
 int close(int fd)
 {
 	fd = __aio_close(fd);
 	int r = __syscall_cp(SYS_close, fd);
 	if (r == -EINTR) r = 0;
+	if (!r) __qnx_fd_replaced(fd);
 	return __syscall_ret(r);
 }
@@ -2,6 +2,13 @@
 #include <errno.h>
 #include <fcntl.h>
 #include "syscall.h"
+#include "qnx_fd.h"
+
+static void dummy_fd(int fd)
+{
+}
+
+weak_alias(dummy_fd, __qnx_fd_replaced);
 
 int dup2(int old, int new)
 {
@@ -16,5 +23,6 @@ int dup2(int old, int new)
 		while ((r=__syscall(SYS_dup3, old, new, 0))==-EBUSY);
 	}
 #endif
+	if (r >= 0 && old != new) __qnx_fd_replaced(new);
 	return __syscall_ret(r);
 }
@@ -3,6 +3,13 @@
 #include <errno.h>
 #include <fcntl.h>
 #include "syscall.h"
+#include "qnx_fd.h"
+
+static void dummy_fd(int fd)
+{
+}
+
+weak_alias(dummy_fd, __qnx_fd_replaced);
 
 int __dup3(int old, int new, int flags)
 {
@@ -20,6 +27,7 @@ int __dup3(int old, int new, int flags)
 #else
 	while ((r=__syscall(SYS_dup3, old, new, flags))==-EBUSY);
 #endif
+	if (r >= 0) __qnx_fd_replaced(new);
 	return __syscall_ret(r);
 }
 
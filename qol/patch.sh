@@ -2,24 +2,27 @@
 
 set -e
 
-if [ $# -ne 1 ]; then
-	echo "Usage: $0 <program> (program in qnx target path)"
+if [ $# -lt 1 ]; then
+	echo "Usage: $0 <program>... (programs in qnx target path)"
 	exit 1
 fi
 
 SCRIPT_DIR=${BASH_SOURCE%/*}
 
 DIST=$(realpath ${SCRIPT_DIR}/dist)
-SRC=$1
-PROG=$DIST/$(basename "$SRC")
+QNXPATCH=$SCRIPT_DIR/qnxpatch
 
 MUSL_SO=$(realpath $SCRIPT_DIR/musl/lib/libc.so)
 
-cp "$SRC" $DIST
-
-if file "$PROG" | grep -q "interpreter"; then
-	chmod +x "$PROG"
-	patchelf --set-interpreter "$MUSL_SO" "$PROG"
+if [ ! -x $QNXPATCH -o $QNXPATCH.c -nt $QNXPATCH ]; then
+	cc -O2 -o $QNXPATCH $QNXPATCH.c
 fi
-patchelf --replace-needed libc.so.4 "$MUSL_SO" "$PROG"
-patchelf --add-rpath $DIST "$PROG"
+
+PROGS=()
+for SRC in "$@"; do
+	cp "$SRC" $DIST
+	PROGS+=("$DIST/$(basename "$SRC")")
+done
+
+# Interpreter, libc.so.4 and rpath, for every program in one pass.
+$QNXPATCH -l "$MUSL_SO" -r $DIST "${PROGS[@]}"
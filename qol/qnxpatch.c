@@ -0,0 +1,245 @@
+/*
+ * qnxpatch: point QNX binaries at the QOL libc in one pass.
+ *
+ * Usage: qnxpatch [-m] [-a arch] [-j jobs] [-l libc] [-r rpath] path...
+ *
+ * For every ELF file given, or found below a directory given, this does
+ * what patch.sh used to do with three patchelf runs:
+ *   - the interpreter, if there is one, becomes libc (and the file is
+ *     made executable);
+ *   - a DT_NEEDED libc.so.4 becomes libc, and with -m so does one of
+ *     libm.so.3, whose functions libc has too;
+ *   - rpath is added to DT_RUNPATH (or to DT_RPATH if the file only
+ *     has that).
+ * libc defaults to /opt/qol/lib/libc.so and rpath to its directory.
+ * Only files of the QNX architecture given with -a (x86_64, the
+ * default, aarch64le or armle-v7) are touched, since libc is built for
+ * one of them.
+ *
+ * The new strings do not fit where the old ones were, so .dynstr and
+ * .dynamic are copied, with the changes, to a new read-write PT_LOAD
+ * appended to the file. That takes the program header slot of PT_NOTE,
+ * which nothing reads at run time. DT_STRTAB, DT_STRSZ, PT_DYNAMIC and
+ * PT_INTERP are pointed at the copies. The old sections stay where they
+ * were, so string offsets in the symbol and version tables still hold.
+ * The segment is aligned to 64K on aarch64, whose Linux kernels may use
+ * 64K pages. Each file is written once, to a temporary file renamed
+ * over it.
+ * Files that already match are left alone.
+ *
+ * Build: cc -O2 -o qnxpatch qnxpatch.c
+ */
+#define _GNU_SOURCE
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define QNX_LIBC "libc.so.4"
+#define QNX_LIBM "libm.so.3"
+#define PAGE_MAX 65536
+
+static const struct target {
+	const char *name;
+	int machine, class;
+	size_t page;
+} targets[] = {
+	{ "x86_64", EM_X86_64, ELFCLASS64, 4096 },
+	{ "aarch64le", EM_AARCH64, ELFCLASS64, 65536 },
+	{ "armle-v7", EM_ARM, ELFCLASS32, 4096 },
+};
+static const struct target *target = &targets[0];
+
+static const char *libc = "/opt/qol/lib/libc.so";
+static char *rpath;
+static int libm;
+
+static char **files;
+static size_t nfiles, files_cap;
+
+static size_t align_up(size_t v, size_t a)
+{
+	return (v + a - 1) / a * a;
+}
+
+/* Whether a DT_NEEDED name is to become libc. */
+static int is_qnx_lib(const char *s)
+{
+	return !strcmp(s, QNX_LIBC) || (libm && !strcmp(s, QNX_LIBM));
+}
+
+static int has_dir(const char *list, const char *dir)
+{
+	size_t l = strlen(dir);
+
+	for (const char *p = list; p; p = strchr(p, ':')) {
+		if (*p == ':')
+			p++;
+		if (!strncmp(p, dir, l) && (p[l] == ':' || !p[l]))
+			return 1;
+	}
+	return 0;
+}
+
+static int write_file(const char *path, const unsigned char *a, size_t alen,
+		      size_t pad, const unsigned char *b, size_t blen,
+		      mode_t mode)
+{
+	char tmp[4096];
+	static const unsigned char zero[PAGE_MAX];
+	int fd;
+
+	snprintf(tmp, sizeof tmp, "%s.qnxpatch", path);
+	if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, mode)) < 0)
+		return -1;
+	if (write(fd, a, alen) != (ssize_t)alen ||
+	    write(fd, zero, pad) != (ssize_t)pad ||
+	    write(fd, b, blen) != (ssize_t)blen || fchmod(fd, mode) ||
+	    close(fd) || rename(tmp, path)) {
+		unlink(tmp);
+		return -1;
+	}
+	return 0;
+}
+
+#define ELFN(x) Elf32_##x
+#define PATCH_ELF patch32
+#include "qnxpatch_elf.h"
+#undef ELFN
+#undef PATCH_ELF
+#define ELFN(x) Elf64_##x
+#define PATCH_ELF patch64
+#include "qnxpatch_elf.h"
+
+/* 0 patched, 1 nothing to do or not a dynamic ELF of the target, -1 error. */
+static int patch(const char *path)
+{
+	unsigned char *f;
+	struct stat st;
+	int fd, ret;
+
+	if ((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st)) {
+		perror(path);
+		return -1;
+	}
+	if (st.st_size < EI_NIDENT) {
+		close(fd);
+		return 1;
+	}
+	f = malloc(st.st_size);
+	if (!f || read(fd, f, st.st_size) != st.st_size) {
+		perror(path);
+		close(fd);
+		free(f);
+		return -1;
+	}
+	close(fd);
+
+	if (memcmp(f, ELFMAG, SELFMAG) || f[EI_CLASS] != target->class)
+		ret = 1;
+	else if (target->class == ELFCLASS32)
+		ret = patch32(path, f, &st);
+	else
+		ret = patch64(path, f, &st);
+	free(f);
+	return ret;
+}
+
+static int collect(const char *path, const struct stat *st, int type,
+		   struct FTW *ftw)
+{
+	(void)st;
+	(void)ftw;
+	if (type != FTW_F)
+		return 0;
+	if (nfiles == files_cap) {
+		files_cap = files_cap ? 2 * files_cap : 256;
+		if (!(files = realloc(files, files_cap * sizeof *files)))
+			return -1;
+	}
+	return (files[nfiles++] = strdup(path)) ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+	int jobs = sysconf(_SC_NPROCESSORS_ONLN), opt, status, failed = 0;
+	size_t patched = 0, i;
+	pid_t pid;
+
+	while ((opt = getopt(argc, argv, "a:j:l:mr:")) != -1) {
+		switch (opt) {
+		case 'a':
+			for (target = 0, i = 0; i < sizeof targets / sizeof *targets; i++)
+				if (!strcmp(optarg, targets[i].name))
+					target = &targets[i];
+			if (!target) {
+				fprintf(stderr, "%s: unknown architecture %s\n",
+					argv[0], optarg);
+				return 1;
+			}
+			break;
+		case 'j':
+			jobs = atoi(optarg);
+			break;
+		case 'l':
+			libc = optarg;
+			break;
+		case 'm':
+			libm = 1;
+			break;
+		case 'r':
+			rpath = optarg;
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind == argc)
+		goto usage;
+	if (!rpath)
+		rpath = dirname(strdup(libc));
+	for (; optind < argc; optind++)
+		if (nftw(argv[optind], collect, 64, FTW_PHYS)) {
+			perror(argv[optind]);
+			return 1;
+		}
+	if (jobs < 1)
+		jobs = 1;
+
+	/* Worker w takes every jobs-th file; each exits with its count. */
+	for (int w = 0; w < jobs; w++) {
+		if ((pid = fork()) < 0) {
+			perror("fork");
+			return 1;
+		}
+		if (!pid) {
+			int mine = 0, bad = 0;
+			for (size_t i = w; i < nfiles; i += jobs) {
+				int r = patch(files[i]);
+				mine += r == 0;
+				bad |= r < 0;
+			}
+			_exit(bad ? 255 : mine > 254 ? 254 : mine);
+		}
+	}
+	while (wait(&status) > 0) {
+		if (!WIFEXITED(status) || WEXITSTATUS(status) == 255)
+			failed = 1;
+		else
+			patched += WEXITSTATUS(status);
+	}
+	printf("qnxpatch: %zu of %zu files patched%s\n", patched, nfiles,
+	       failed ? ", some failed" : "");
+	return failed;
+usage:
+	fprintf(stderr, "Usage: %s [-m] [-a x86_64|aarch64le|armle-v7] [-j jobs] [-l libc] [-r rpath] path...\n",
+		argv[0]);
+	return 1;
+}
@@ -0,0 +1,162 @@
+/*
+ * The ELF class dependent half of qnxpatch.c, included once per class
+ * with ELFN (Elf32_ or Elf64_ types) and PATCH_ELF (the function name)
+ * defined.
+ */
+
+/* File offset of vaddr, or -1 outside every PT_LOAD. */
+static long ELFN(v2off)(ELFN(Phdr) *ph, int n, ELFN(Addr) v)
+{
+	for (int i = 0; i < n; i++)
+		if (ph[i].p_type == PT_LOAD && v >= ph[i].p_vaddr &&
+		    v < ph[i].p_vaddr + ph[i].p_filesz)
+			return ph[i].p_offset + (v - ph[i].p_vaddr);
+	return -1;
+}
+
+/* 0 patched, 1 nothing to do or not a dynamic ELF of the target, -1 error. */
+static int PATCH_ELF(const char *path, unsigned char *f, const struct stat *st)
+{
+	unsigned char *blob;
+	ELFN(Ehdr) *eh;
+	ELFN(Phdr) *ph, *interp = 0, *dynph = 0, *slot = 0;
+	ELFN(Dyn) *dyn, *nd;
+	size_t ndyn, strsz = 0, blen, off, i, dynoff, maxend = 0;
+	size_t libc_at = 0, rpath_at = 0, page = target->page;
+	long stroff = -1;
+	int n, need_interp = 0, need_needed = 0, rpath_tag = 0, add_tag = 1;
+	const char *old_rpath = 0;
+	char *new_rpath = 0;
+	int ret = -1;
+
+	eh = (ELFN(Ehdr) *)f;
+	if (st->st_size < (off_t)sizeof *eh ||
+	    eh->e_machine != target->machine ||
+	    (eh->e_type != ET_EXEC && eh->e_type != ET_DYN) ||
+	    eh->e_phoff + (size_t)eh->e_phnum * sizeof *ph > (size_t)st->st_size)
+		return 1;
+	ph = (ELFN(Phdr) *)(f + eh->e_phoff);
+	n = eh->e_phnum;
+	for (i = 0; i < (size_t)n; i++) {
+		if (ph[i].p_type == PT_INTERP)
+			interp = &ph[i];
+		else if (ph[i].p_type == PT_DYNAMIC)
+			dynph = &ph[i];
+		else if ((ph[i].p_type == PT_NOTE || ph[i].p_type == PT_NULL) &&
+			 !slot)
+			slot = &ph[i];
+		else if (ph[i].p_type == PT_LOAD &&
+			 ph[i].p_vaddr + ph[i].p_memsz > maxend)
+			maxend = ph[i].p_vaddr + ph[i].p_memsz;
+	}
+	if (!dynph || dynph->p_offset + dynph->p_filesz > (size_t)st->st_size)
+		return 1;
+	dyn = (ELFN(Dyn) *)(f + dynph->p_offset);
+	ndyn = dynph->p_filesz / sizeof *dyn;
+	for (i = 0; i < ndyn && dyn[i].d_tag != DT_NULL; i++) {
+		if (dyn[i].d_tag == DT_STRTAB)
+			stroff = ELFN(v2off)(ph, n, dyn[i].d_un.d_ptr);
+		else if (dyn[i].d_tag == DT_STRSZ)
+			strsz = dyn[i].d_un.d_val;
+	}
+	ndyn = i;
+	if (stroff < 0 || stroff + strsz > (size_t)st->st_size) {
+		fprintf(stderr, "%s: no usable DT_STRTAB\n", path);
+		return -1;
+	}
+
+	/* What has to change. */
+	if (interp && interp->p_offset + interp->p_filesz <= (size_t)st->st_size)
+		need_interp = strncmp((char *)f + interp->p_offset, libc,
+				      interp->p_filesz) != 0;
+	for (i = 0; i < ndyn; i++) {
+		const char *s = dyn[i].d_un.d_val < strsz ?
+			(char *)f + stroff + dyn[i].d_un.d_val : "";
+		if (dyn[i].d_tag == DT_NEEDED && is_qnx_lib(s))
+			need_needed = 1;
+		else if (dyn[i].d_tag == DT_RUNPATH ||
+			 (dyn[i].d_tag == DT_RPATH && !rpath_tag)) {
+			rpath_tag = dyn[i].d_tag;
+			old_rpath = s;
+		}
+	}
+	if (old_rpath) {
+		add_tag = 0;
+		if (!has_dir(old_rpath, rpath) &&
+		    asprintf(&new_rpath, "%s%s%s", old_rpath,
+			     *old_rpath ? ":" : "", rpath) < 0)
+			goto out;
+	} else {
+		new_rpath = strdup(rpath);
+	}
+	if (!need_interp && !need_needed && !new_rpath) {
+		ret = 1;
+		goto out;
+	}
+	if (!slot) {
+		fprintf(stderr, "%s: no PT_NOTE or PT_NULL header to reuse\n",
+			path);
+		goto out;
+	}
+
+	/* The new segment: strings, then the dynamic array. */
+	blen = strsz;
+	libc_at = blen;
+	blen += strlen(libc) + 1;
+	if (new_rpath) {
+		rpath_at = blen;
+		blen += strlen(new_rpath) + 1;
+	}
+	dynoff = align_up(blen, 16);
+	blen = dynoff + (ndyn + add_tag + 1) * sizeof *dyn;
+	if (!(blob = calloc(1, blen)))
+		goto out;
+	memcpy(blob, f + stroff, strsz);
+	strcpy((char *)blob + libc_at, libc);
+	if (new_rpath)
+		strcpy((char *)blob + rpath_at, new_rpath);
+
+	off = align_up(st->st_size, page);
+	maxend = align_up(maxend, page);
+	nd = (ELFN(Dyn) *)(blob + dynoff);
+	for (i = 0; i < ndyn; i++) {
+		nd[i] = dyn[i];
+		if (nd[i].d_tag == DT_STRTAB)
+			nd[i].d_un.d_ptr = maxend;
+		else if (nd[i].d_tag == DT_STRSZ)
+			nd[i].d_un.d_val = dynoff;
+		else if (nd[i].d_tag == DT_NEEDED && dyn[i].d_un.d_val < strsz &&
+			 is_qnx_lib((char *)f + stroff + dyn[i].d_un.d_val))
+			nd[i].d_un.d_val = libc_at;
+		else if (nd[i].d_tag == rpath_tag && new_rpath)
+			nd[i].d_un.d_val = rpath_at;
+	}
+	if (add_tag)
+		nd[i++] = (ELFN(Dyn)){ .d_tag = DT_RUNPATH, .d_un.d_val = rpath_at };
+	nd[i] = (ELFN(Dyn)){ .d_tag = DT_NULL };
+
+	*slot = (ELFN(Phdr)){
+		.p_type = PT_LOAD, .p_flags = PF_R | PF_W,
+		.p_offset = off, .p_vaddr = maxend, .p_paddr = maxend,
+		.p_filesz = blen, .p_memsz = blen, .p_align = page,
+	};
+	dynph->p_offset = off + dynoff;
+	dynph->p_vaddr = dynph->p_paddr = maxend + dynoff;
+	dynph->p_filesz = dynph->p_memsz = blen - dynoff;
+	if (need_interp) {
+		interp->p_offset = off + libc_at;
+		interp->p_vaddr = interp->p_paddr = maxend + libc_at;
+		interp->p_filesz = interp->p_memsz = strlen(libc) + 1;
+	}
+
+	if (write_file(path, f, st->st_size, off - st->st_size, blob, blen,
+		       interp ? st->st_mode | 0111 : st->st_mode)) {
+		perror(path);
+	} else {
+		ret = 0;
+	}
+	free(blob);
+out:
+	free(new_rpath);
+	return ret;
+}
@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""Link a QNX program, its libraries and its plugins into one static-PIE.
+
+Usage: qnxstatic.py -o OUTPUT [-m MUSL] [-p NAME=INPUT[,INPUT]...]...
+                    INPUT...
+
+INPUTs are QNX objects and static archives (as ntox86_64-gcc builds and
+the SDP ships them); they are linked with the QOL crt and libc.a from
+MUSL (default: the musl dir next to this script) instead of the QNX
+libc, so the result needs neither the dynamic linker nor any DSO.
+Every reference to a function the QOL libc.so would redirect for QNX
+binaries (see musl/src/internal/qnx_redirect.h) is renamed first to
+its _qnx_ shim, as the loader would bind it; the shims are taken from
+the _qnx_ functions libc.a defines. CmpLog redirects are left on the
+plain function.
+
+Each -p names a plugin the program dlopens (e.g. img_codec_png.so) and
+the objects or archives it is built from. A plugin is linked whole into
+one relocatable object, and its exported symbols are renamed so that
+plugins defining the same names do not clash. A generated table,
+__qnx_static_dsos (see musl/src/internal/qnx_staticdl.h), maps each
+plugin name to its symbols, and the static dlopen and dlsym of the QOL
+libc serve it. Plugin constructors run at startup instead of at
+dlopen.
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+CMPLOG_PREFIX = "_qnx_cmplog_"
+
+
+def run(*cmd, **kw):
+    try:
+        return subprocess.run(cmd, check=True, capture_output=True, text=True, **kw).stdout
+    except subprocess.CalledProcessError as e:
+        sys.exit(f"{cmd[0]}: {e.stderr.strip() or 'failed'}")
+
+
+def redirects(libc):
+    """{name: _qnx_name} for every redirect shim libc.a defines."""
+    out = {}
+    for line in run("nm", "-g", "--defined-only", libc).splitlines():
+        f = line.split()
+        if len(f) == 3 and f[1] in "TW" and f[2].startswith("_qnx_") \
+                and not f[2].startswith(CMPLOG_PREFIX):
+            out[f[2][len("_qnx_"):]] = f[2]
+    return out
+
+
+def write_syms(path, renames):
+    with open(path, "w") as f:
+        for old, new in sorted(renames.items()):
+            f.write(f"{old} {new}\n")
+
+
+def plugin(work, idx, name, inputs, redir):
+    """Link one plugin into an object; its exported names and symbols."""
+    obj = os.path.join(work, f"plugin{idx}.o")
+    run("ld", "-r", "-o", obj, "--whole-archive", *inputs)
+    exports = []
+    for line in run("nm", "-g", "--defined-only", obj).splitlines():
+        f = line.split()
+        if len(f) == 3 and f[1] in "TWDRBV":
+            exports.append(f[2])
+    renames = {s: f"__qnx_static_{idx}_{s}" for s in exports}
+    for s, t in redir.items():
+        renames.setdefault(s, t)
+    syms = os.path.join(work, f"plugin{idx}.syms")
+    write_syms(syms, renames)
+    run("objcopy", f"--redefine-syms={syms}", obj)
+    return obj, sorted((s, renames[s]) for s in exports)
+
+
+def table(work, plugins):
+    """The __qnx_static_dsos table, compiled."""
+    src = ["#include <stddef.h>",
+           "struct qnx_static_sym { const char *name; void *addr; };",
+           "struct qnx_static_dso { const char *name; "
+           "const struct qnx_static_sym *syms; size_t nsyms; };"]
+    for i, (name, syms) in enumerate(plugins):
+        for j, (_, sym) in enumerate(syms):
+            src.append(f'extern char s{i}_{j}[] __asm__("{sym}");')
+        src.append(f"static const struct qnx_static_sym syms{i}[] = {{")
+        src.extend(f'\t{{ "{s}", s{i}_{j} }},' for j, (s, _) in enumerate(syms))
+        src.append("\t{ 0 }\n};")
+    src.append("const struct qnx_static_dso __qnx_static_dsos[] = {")
+    src.extend(f'\t{{ "{name}", syms{i}, {len(syms)} }},'
+               for i, (name, syms) in enumerate(plugins))
+    src.append("\t{ 0 }\n};")
+    c = os.path.join(work, "dsos.c")
+    with open(c, "w") as f:
+        f.write("\n".join(src) + "\n")
+    obj = os.path.join(work, "dsos.o")
+    run("cc", "-O2", "-fPIE", "-c", "-o", obj, c)
+    return obj
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description="Link a QNX program into a static QOL binary")
+    parser.add_argument("-o", "--output", required=True, help="binary to write")
+    parser.add_argument("-m", "--musl", default=os.path.join(here, "musl"),
+                        help="built QOL musl tree (lib/rcrt1.o, lib/libc.a)")
+    parser.add_argument("-p", "--plugin", action="append", default=[], metavar="NAME=INPUT,...",
+                        help="plugin dlopened as NAME, built from these objects or archives")
+    parser.add_argument("inputs", nargs="+", help="QNX objects and static archives")
+    args = parser.parse_args()
+
+    lib = os.path.join(args.musl, "lib")
+    libc = os.path.join(lib, "libc.a")
+    redir = redirects(libc)
+    plugins, objs = [], []
+    with tempfile.TemporaryDirectory() as work:
+        syms = os.path.join(work, "redirect.syms")
+        write_syms(syms, redir)
+        inputs = []
+        for i, path in enumerate(args.inputs):
+            out = os.path.join(work, f"{i}-{os.path.basename(path)}")
+            run("objcopy", f"--redefine-syms={syms}", path, out)
+            inputs.append(out)
+        for i, spec in enumerate(args.plugin):
+            name, sep, files = spec.partition("=")
+            if not sep or not files:
+                sys.exit(f"-p {spec}: expected NAME=INPUT[,INPUT]...")
+            obj, exports = plugin(work, i, name, files.split(","), redir)
+            objs.append(obj)
+            plugins.append((name, exports))
+        if plugins:
+            objs.append(table(work, plugins))
+
+        libgcc = run("cc", "-print-libgcc-file-name").strip()
+        run("cc", "-static-pie", "-nostdlib", "-o", args.output,
+            os.path.join(lib, "rcrt1.o"), os.path.join(lib, "crti.o"),
+            *[p for p in inputs if not p.endswith(".a")], *objs,
+            "-Wl,--start-group", *[p for p in inputs if p.endswith(".a")],
+            libc, libgcc, "-Wl,--end-group", os.path.join(lib, "crtn.o"))
+    print(f"{args.output}: {len(args.inputs)} inputs, {len(plugins)} plugins, "
+          f"{len(redir)} redirects")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""Watch the translation layer counters of programs run with LD_QNX_STATS
+set.
+
+Usage: qolstat.py [-a] [-n N] [-w SECS] [FILE...]
+
+Without FILEs, every /dev/shm/qnx-stats.* file is read, skipping those
+of processes that have exited unless -a is given. Each process is one
+line of counters: errno translations, slogf calls, allocator refills
+and own mappings, spawns and failed spawns, and the loader's symbol
+lookups and redirects. A process that also runs with LD_QNX_SHIMSTATS
+gets its N most called shims below it (-n 0 for none).
+
+-w reprints every SECS seconds, like top, with the counts per second
+since the last print.
+
+File format (native endian, see musl/src/qnxsupport/qstats.c):
+    header   char magic[8] "qnxstat1"; u32 nstats, pid, names, data;
+             u32 pad[4]
+    names    nstats char[32] at offset names
+    values   nstats u64 at offset data
+"""
+
+import argparse
+import glob
+import mmap
+import os
+import struct
+import sys
+import time
+
+import shimstats
+
+MAGIC = b"qnxstat1"
+HDR = struct.Struct("=8s4I16x")
+NAME = 32
+
+
+def open_stats(path):
+    try:
+        with open(path, "rb") as f:
+            m = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    except (OSError, ValueError) as e:
+        print(f"warning: {path}: {e}", file=sys.stderr)
+        return None
+    if len(m) < HDR.size or m[:8] != MAGIC:
+        print(f"warning: {path}: not a qnx-stats file", file=sys.stderr)
+        return None
+    _, nstats, pid, names, data = HDR.unpack_from(m, 0)
+    if data + 8 * nstats > len(m):
+        print(f"warning: {path}: truncated", file=sys.stderr)
+        return None
+    return {"map": m, "path": path, "pid": pid, "nstats": nstats, "data": data,
+            "names": [shimstats.cstr(m[names + i * NAME:names + (i + 1) * NAME])
+                      for i in range(nstats)]}
+
+
+def values(st):
+    return list(struct.unpack_from(f"={st['nstats']}Q", st["map"], st["data"]))
+
+
+def alive(pid):
+    try:
+        os.kill(pid, 0)
+    except ProcessLookupError:
+        return False
+    except PermissionError:
+        pass
+    return True
+
+
+def shim_calls(pid):
+    """Calls per shim name, if the process keeps shimstats."""
+    path = f"/dev/shm/qnx-shimstats.{pid}"
+    if not os.path.exists(path):
+        return None
+    st = shimstats.open_stats(path)
+    if not st:
+        return None
+    return {name: t[0] for name, t in zip(st["names"], shimstats.totals(st))}
+
+
+def dump(stats, top, prev, secs):
+    names = stats[0]["names"]
+    print(f"{'pid':>8} " + " ".join(f"{n:>12}" for n in names))
+    cur = []
+    for st in stats:
+        v, shims = values(st), shim_calls(st["pid"]) if top else None
+        cur.append((v, shims))
+        old = prev.get(st["pid"]) if prev else None
+        if old:
+            row = [(a - b) / secs for a, b in zip(v, old[0])]
+            print(f"{st['pid']:8d} " + " ".join(f"{x:12.1f}" for x in row))
+        else:
+            print(f"{st['pid']:8d} " + " ".join(f"{x:12d}" for x in v))
+        if not shims:
+            continue
+        base = old[1] if old and old[1] else {}
+        rows = sorted(((c - base.get(n, 0), n) for n, c in shims.items()), reverse=True)
+        for c, n in rows[:top]:
+            if c > 0:
+                print(f"{'':8} {c / secs:12.1f}  {n}" if old else f"{'':8} {c:12d}  {n}")
+    return {st["pid"]: c for st, c in zip(stats, cur)}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Watch QOL translation layer counters")
+    parser.add_argument("-a", "--all", action="store_true", help="include exited processes")
+    parser.add_argument("-n", "--top", type=int, default=5, help="shims to print per process")
+    parser.add_argument("-w", "--watch", type=float, metavar="SECS", help="reprint every SECS seconds")
+    parser.add_argument("files", nargs="*", help="stats files (default /dev/shm/qnx-stats.*)")
+    args = parser.parse_args()
+
+    def load():
+        paths = args.files or sorted(glob.glob("/dev/shm/qnx-stats.*"))
+        stats = [s for s in map(open_stats, paths) if s]
+        return [s for s in stats if args.files or args.all or alive(s["pid"])]
+
+    stats = load()
+    if not stats:
+        print("no qnx-stats files found", file=sys.stderr)
+        return 1
+    prev = dump(stats, args.top, None, 1)
+    while args.watch:
+        time.sleep(args.watch)
+        stats = load() or stats
+        print()
+        prev = dump(stats, args.top, prev, args.watch)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Print the shim call counts and latencies of programs run with
+LD_QNX_SHIMSTATS set.
+
+Usage: shimstats.py [-n N] [-w SECS] [FILE...]
+
+Without FILEs, every /dev/shm/qnx-shimstats.* file is read; the files
+are left behind when the programs exit. For each process, shims are
+printed most total time first as "calls total_ms mean_ns p50 p99 max
+name", the percentiles being bucket upper bounds (within 12.5%).
+-w reprints every SECS seconds, with the counts since the last print.
+
+File format (native endian, see musl/src/qnxsupport/shimstats.c):
+    header   char magic[8] "qnxshim1"; u32 nshims, nslots, nbuckets,
+             pid, names, data; u32 pad[8]
+    names    nshims char[48] at offset names
+    records  at offset data, nslots x nshims of
+             {u64 calls, ns, hist[nbuckets]}, slot major
+"""
+
+import argparse
+import glob
+import mmap
+import struct
+import sys
+import time
+
+MAGIC = b"qnxshim1"
+HDR = struct.Struct("=8s6I32x")
+NAME = 48
+
+
+def cstr(b):
+    return b.split(b"\0", 1)[0].decode(errors="replace")
+
+
+def bucket_high(b):
+    """The largest value in histogram bucket b, in ns."""
+    if b < 16:
+        return b
+    e, m = (b - 16) // 8 + 4, (b - 16) % 8
+    return ((9 + m) << (e - 3)) - 1
+
+
+def open_stats(path):
+    try:
+        with open(path, "rb") as f:
+            m = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    except (OSError, ValueError) as e:
+        print(f"warning: {path}: {e}", file=sys.stderr)
+        return None
+    if len(m) < HDR.size or m[:8] != MAGIC:
+        print(f"warning: {path}: not a shimstats file", file=sys.stderr)
+        return None
+    _, nshims, nslots, nbuckets, pid, names, data = HDR.unpack_from(m, 0)
+    rec = struct.Struct(f"={2 + nbuckets}Q")
+    if data + nslots * nshims * rec.size > len(m):
+        print(f"warning: {path}: truncated", file=sys.stderr)
+        return None
+    return {"map": m, "path": path, "pid": pid, "nshims": nshims, "nslots": nslots,
+            "nbuckets": nbuckets, "data": data, "rec": rec,
+            "names": [cstr(m[names + i * NAME:names + (i + 1) * NAME]) for i in range(nshims)]}
+
+
+def totals(st):
+    """Per shim [calls, ns, hist...], summed over the slots."""
+    m, rec, n = st["map"], st["rec"], st["nshims"]
+    out = [[0] * (2 + st["nbuckets"]) for _ in range(n)]
+    for slot in range(st["nslots"]):
+        for i in range(n):
+            off = st["data"] + (slot * n + i) * rec.size
+            if not struct.unpack_from("=Q", m, off)[0]:
+                continue
+            t = out[i]
+            for j, v in enumerate(rec.unpack_from(m, off)):
+                t[j] += v
+    return out
+
+
+def percentile(hist, calls, q):
+    want, seen = calls * q, 0
+    for b, c in enumerate(hist):
+        seen += c
+        if c and seen >= want:
+            return bucket_high(b)
+    return 0
+
+
+def dump(st, top, prev):
+    cur = totals(st)
+    rows = []
+    for i, t in enumerate(cur):
+        d = [a - b for a, b in zip(t, prev[i])] if prev else t
+        if d[0] > 0:
+            rows.append((d, st["names"][i]))
+    rows.sort(key=lambda r: -r[0][1])
+    print(f"pid {st['pid']} ({st['path']})")
+    print(f"{'calls':>12} {'total_ms':>10} {'mean_ns':>9} {'p50':>9} {'p99':>9} {'max':>11}  name")
+    for d, name in rows[:top]:
+        calls, ns, hist = d[0], d[1], d[2:]
+        last = max((b for b, c in enumerate(hist) if c), default=0)
+        print(f"{calls:12d} {ns / 1e6:10.3f} {ns / calls:9.0f} {percentile(hist, calls, 0.5):9d} "
+              f"{percentile(hist, calls, 0.99):9d} {bucket_high(last):11d}  {name}")
+    return cur
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Print QOL shim call statistics")
+    parser.add_argument("-n", "--top", type=int, default=30, help="shims to print per process")
+    parser.add_argument("-w", "--watch", type=float, metavar="SECS", help="reprint every SECS seconds")
+    parser.add_argument("files", nargs="*", help="stats files (default /dev/shm/qnx-shimstats.*)")
+    args = parser.parse_args()
+
+    paths = args.files or sorted(glob.glob("/dev/shm/qnx-shimstats.*"))
+    stats = [s for s in map(open_stats, paths) if s]
+    if not stats:
+        print("no shimstats files found", file=sys.stderr)
+        return 1
+    prev = [dump(s, args.top, None) for s in stats]
+    while args.watch:
+        time.sleep(args.watch)
+        prev = [dump(s, args.top, p) for s, p in zip(stats, prev)]
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Print the slog2 buffers written by QNX programs running under QOL.
+
+Usage: slog2info.py [-b BUFFER] [-w] [FILE...]
+
+Without FILEs, every /dev/shm/slog2.* file is read. Buffers are kept
+after the program exits only if it ran with QNX_SLOG2_KEEP set.
+Records are printed oldest first as "time set.buffer code severity msg";
+-w keeps polling and prints new records as they arrive.
+
+File format (little endian, see musl/src/qnxsupport/slog2.c):
+    set header  u32 magic, version, nbuf, pid; char name[64]
+    buffers     {char name[64]; u32 nslots, offset; i32 verbosity,
+                 tail; u32 flags, pad[3]}[4]
+    rings       nslots 64-byte slots at offset; records start at a slot
+                with {u32 pos; u16 code; u8 severity, kind; u32 len, pad;
+                u64 ts_ns} followed by len bytes of text (kind 0) or
+                covering len slots of padding (kind 1)
+"""
+
+import argparse
+import glob
+import mmap
+import struct
+import sys
+import time
+
+SLOG2_MAGIC = 0x32474C53
+SLOT = 64
+MAX_BUFFERS = 4
+SET_HDR = struct.Struct("<4I64s")
+BUF_DESC = struct.Struct("<64s2I2i4I")
+REC_HDR = struct.Struct("<IHBBIIQ")
+SEVERITY = ["SHUTDOWN", "CRITICAL", "ERROR", "WARNING", "NOTICE", "INFO", "DEBUG1", "DEBUG2"]
+
+
+def cstr(b):
+    return b.split(b"\0", 1)[0].decode(errors="replace")
+
+
+def open_set(path):
+    try:
+        with open(path, "rb") as f:
+            m = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    except (OSError, ValueError) as e:
+        print(f"warning: {path}: {e}", file=sys.stderr)
+        return None
+    magic, version, nbuf, pid, name = SET_HDR.unpack_from(m, 0)
+    if magic != SLOG2_MAGIC or version != 1 or not 0 < nbuf <= MAX_BUFFERS:
+        print(f"warning: {path}: not a slog2 buffer set", file=sys.stderr)
+        return None
+    bufs = []
+    for i in range(nbuf):
+        d = BUF_DESC.unpack_from(m, SET_HDR.size + i * BUF_DESC.size)
+        bufs.append({"name": cstr(d[0]), "nslots": d[1], "offset": d[2],
+                     "desc": SET_HDR.size + i * BUF_DESC.size, "next": None})
+    return {"map": m, "name": cstr(name), "pid": pid, "bufs": bufs}
+
+
+def tail_of(m, buf):
+    return BUF_DESC.unpack_from(m, buf["desc"])[4] & 0xFFFFFFFF
+
+
+def read_records(m, buf, start, tail):
+    """Yield (pos, record) for valid records in [start, tail)."""
+    nslots = buf["nslots"]
+    pos = start
+    while (tail - pos) & 0xFFFFFFFF and ((tail - pos) & 0xFFFFFFFF) <= nslots:
+        off = buf["offset"] + (pos % nslots) * SLOT
+        rpos, code, sev, kind, length, _, ts = REC_HDR.unpack_from(m, off)
+        if rpos != pos:
+            pos = (pos + 1) & 0xFFFFFFFF
+            continue
+        if kind == 1:
+            pos = (pos + max(1, length)) & 0xFFFFFFFF
+            continue
+        length = min(length, nslots * SLOT - (off - buf["offset"]) - REC_HDR.size)
+        text = bytes(m[off + REC_HDR.size:off + REC_HDR.size + length])
+        yield pos, (ts, code, sev, text.decode(errors="replace"))
+        pos = (pos + (REC_HDR.size + length + SLOT - 1) // SLOT) & 0xFFFFFFFF
+
+
+def dump(sets, only):
+    out = []
+    for s in sets:
+        for buf in s["bufs"]:
+            if only and buf["name"] != only:
+                continue
+            tail = tail_of(s["map"], buf)
+            start = buf["next"]
+            if start is None or ((tail - start) & 0xFFFFFFFF) > buf["nslots"]:
+                start = (tail - buf["nslots"]) & 0xFFFFFFFF if tail > buf["nslots"] else 0
+            for _, rec in read_records(s["map"], buf, start, tail):
+                out.append((rec, f"{s['name']}.{buf['name']}"))
+            buf["next"] = tail
+    out.sort(key=lambda r: r[0][0])
+    for (ts, code, sev, text), where in out:
+        stamp = time.strftime("%b %d %H:%M:%S", time.localtime(ts // 10**9))
+        sevname = SEVERITY[sev] if sev < len(SEVERITY) else str(sev)
+        print(f"{stamp}.{ts % 10**9 // 10**6:03d} {where} {code} {sevname} {text}")
+    sys.stdout.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Print QOL slog2 buffers")
+    parser.add_argument("-b", "--buffer", help="only print this buffer name")
+    parser.add_argument("-w", "--watch", action="store_true", help="keep printing new records")
+    parser.add_argument("files", nargs="*", help="buffer set files (default /dev/shm/slog2.*)")
+    args = parser.parse_args()
+
+    paths = args.files or sorted(glob.glob("/dev/shm/slog2.*"))
+    sets = [s for s in map(open_set, paths) if s]
+    if not sets:
+        print("no slog2 buffers found", file=sys.stderr)
+        return 1
+    dump(sets, args.buffer)
+    while args.watch:
+        time.sleep(0.2)
+        dump(sets, args.buffer)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())